@@ -0,0 +1,142 @@
+#include "../example_common.h"
+
+#include "audio/audio_mixer.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,         // width
+    720,          // height
+    4,            // MSAA samples
+    "audio_mixer" // window title / process name
+};
+
+namespace
+{
+    const u32 k_sample_rate = 48000;
+    const u32 k_num_groups = 8;
+    const u32 k_bench_seconds = 10;
+    const u32 k_voice_counts[] = {16, 64, 256, 1024};
+    const u32 k_mix_frames = mixer::MIXER_BLOCK_FRAMES * 4;
+
+    struct mix_result
+    {
+        u32 voices;
+        f32 ms;
+        f32 realtime; // seconds of audio mixed per second on one core
+    };
+    mix_result* s_results = nullptr;
+
+    // a few seconds of detuned sines at different rates, so voices resample and loop at different points
+    mixer::sound* create_tone(mixer::mixer_context* m, f32 hz, u32 channels, u32 rate)
+    {
+        u32  frames = rate * 2 + rate / 7;
+        f32* samples = (f32*)pen::memory_alloc(frames * channels * sizeof(f32));
+
+        for (u32 i = 0; i < frames; ++i)
+            for (u32 c = 0; c < channels; ++c)
+                samples[i * channels + c] = sinf(2.0f * (f32)M_PI * hz * (1.0f + c * 0.01f) * (f32)i / (f32)rate) * 0.1f;
+
+        mixer::sound* s = mixer::create_sound(m, samples, frames, channels, rate, true);
+        pen::memory_free(samples);
+
+        return s;
+    }
+
+    void benchmark(u32 num_voices)
+    {
+        mixer::mixer_context* m = mixer::create_mixer(k_sample_rate);
+
+        mixer::sound* sounds[] = {create_tone(m, 220.0f, 1, 44100), create_tone(m, 330.0f, 2, 48000),
+                                  create_tone(m, 440.0f, 2, 22050), create_tone(m, 550.0f, 1, 32000)};
+
+        mixer::group* groups[k_num_groups];
+        for (u32 i = 0; i < k_num_groups; ++i)
+        {
+            groups[i] = mixer::create_group(m);
+            mixer::group_add_dsp(groups[i], DSP_FFT);
+
+            mixer::dsp* eq = mixer::group_add_dsp(groups[i], DSP_THREE_BAND_EQ);
+            mixer::dsp_set_three_band_eq(eq, 3.0f, -2.0f, 1.0f);
+
+            mixer::dsp* gain = mixer::group_add_dsp(groups[i], DSP_GAIN);
+            mixer::dsp_set_gain(gain, -6.0f);
+
+            mixer::group_set_pitch(groups[i], 1.0f + i * 0.05f);
+        }
+
+        for (u32 i = 0; i < num_voices; ++i)
+        {
+            mixer::voice* v = mixer::play_sound(m, sounds[i % PEN_ARRAY_SIZE(sounds)]);
+            mixer::voice_set_group(v, groups[i % k_num_groups]);
+            mixer::voice_set_position(v, i * 13);
+        }
+
+        // mixed a little at a time like the audio thread, into a small buffer that stays in cache
+        static f32 output[k_mix_frames * 2];
+        u32        total_frames = k_sample_rate * k_bench_seconds;
+
+        static pen::timer* timer = pen::timer_create();
+        pen::timer_start(timer);
+
+        for (u32 f = 0; f < total_frames; f += k_mix_frames)
+            mixer::mix(m, output, k_mix_frames);
+
+        mix_result r;
+        r.voices = num_voices;
+        r.ms = pen::timer_elapsed_ms(timer);
+        r.realtime = (f32)(k_bench_seconds * 1000) / r.ms;
+        sb_push(s_results, r);
+
+        PEN_LOG("audio mixer: %i voices, %is mixed in %.2f ms, %.1fx realtime\n", num_voices, k_bench_seconds, r.ms,
+                r.realtime);
+
+        mixer::destroy_mixer(m);
+    }
+} // namespace
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    clear_scene(scene);
+
+    for (u32 i = 0; i < PEN_ARRAY_SIZE(k_voice_counts); ++i)
+        benchmark(k_voice_counts[i]);
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    ImGui::Begin("Audio Mixer", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    ImGui::Text("%i groups with fft, eq and gain, %is of %ihz stereo per run", k_num_groups, k_bench_seconds,
+                k_sample_rate);
+    ImGui::Separator();
+
+    ImGui::Columns(4);
+    ImGui::Text("Voices");
+    ImGui::NextColumn();
+    ImGui::Text("Time (ms)");
+    ImGui::NextColumn();
+    ImGui::Text("x Realtime");
+    ImGui::NextColumn();
+    ImGui::Text("Voices / Core");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (u32 i = 0; i < sb_count(s_results); ++i)
+    {
+        const mix_result& r = s_results[i];
+
+        ImGui::Text("%i", r.voices);
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", r.ms);
+        ImGui::NextColumn();
+        ImGui::Text("%.1f", r.realtime);
+        ImGui::NextColumn();
+        ImGui::Text("%.0f", r.voices * r.realtime);
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+    ImGui::End();
+}
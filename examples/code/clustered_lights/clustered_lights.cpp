@@ -0,0 +1,178 @@
+#include "../example_common.h"
+
+#include "ecs/ecs_light_clusters.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,              // width
+    720,               // height
+    4,                 // MSAA samples
+    "clustered_lights" // window title / process name
+};
+
+namespace
+{
+    const u32 k_max_lights = MAX_CLUSTERED_LIGHTS;
+    const u32 k_history = 120;
+    const f32 k_scene_size = 200.0f;
+
+    u32 s_lights_start = 0;
+    s32 s_num_lights = 2048;
+    f32 s_light_radius = 8.0f;
+    f32 s_time = 0.0f;
+
+    vec4f s_anim[k_max_lights]; // xyz = orbit centre, w = phase
+
+    f32 s_bin_history[k_history] = {0};
+    u32 s_bin_pos = 0;
+} // namespace
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    pmfx::init("data/configs/clustered_lights.jsn");
+
+    clear_scene(scene);
+
+    cam.zoom = 400.0f;
+    cam.rot = vec2f(-0.6f, 0.4f);
+
+    material_resource* default_material = get_material_resource(PEN_HASH("default_material"));
+    geometry_resource* box_resource = get_geometry_resource(PEN_HASH("cube"));
+
+    // floor
+    u32 floor = get_new_entity(scene);
+    scene->names[floor] = "floor";
+    scene->transforms[floor].translation = vec3f(0.0f, -1.0f, 0.0f);
+    scene->transforms[floor].rotation = quat();
+    scene->transforms[floor].scale = vec3f(k_scene_size, 1.0f, k_scene_size);
+    scene->entities[floor] |= CMP_TRANSFORM;
+    scene->parents[floor] = floor;
+    instantiate_geometry(box_resource, scene, floor);
+    instantiate_material(default_material, scene, floor);
+    instantiate_model_cbuffer(scene, floor);
+
+    // pillars to catch the lights
+    const s32 rows = 16;
+    f32       spacing = k_scene_size * 2.0f / (f32)rows;
+    for (s32 i = 0; i < rows; ++i)
+    {
+        for (s32 j = 0; j < rows; ++j)
+        {
+            f32 h = 5.0f + (f32)(rand() % 255) / 255.0f * 30.0f;
+
+            u32 pillar = get_new_entity(scene);
+            scene->names[pillar] = "pillar";
+            scene->transforms[pillar].translation =
+                vec3f(-k_scene_size + spacing * ((f32)i + 0.5f), h, -k_scene_size + spacing * ((f32)j + 0.5f));
+            scene->transforms[pillar].rotation = quat();
+            scene->transforms[pillar].scale = vec3f(spacing * 0.2f, h, spacing * 0.2f);
+            scene->entities[pillar] |= CMP_TRANSFORM;
+            scene->parents[pillar] = pillar;
+            instantiate_geometry(box_resource, scene, pillar);
+            instantiate_material(default_material, scene, pillar);
+            instantiate_model_cbuffer(scene, pillar);
+        }
+    }
+
+    // a directional light from the forward light buffer plus lots of small point and spot lights
+    u32 sun = get_new_entity(scene);
+    scene->names[sun] = "sun";
+    scene->transforms[sun].rotation = quat();
+    scene->transforms[sun].scale = vec3f::one();
+    scene->entities[sun] |= CMP_TRANSFORM;
+    instantiate_light(scene, sun);
+    scene->lights[sun].colour = vec3f(0.05f, 0.05f, 0.08f);
+    scene->lights[sun].direction = normalised(vec3f(0.5f, 1.0f, 0.3f));
+    scene->lights[sun].type = LIGHT_TYPE_DIR;
+
+    for (u32 i = 0; i < k_max_lights; ++i)
+    {
+        f32 rx = (f32)(rand() % 255) / 255.0f;
+        f32 rz = (f32)(rand() % 255) / 255.0f;
+
+        u32 light = get_new_entity(scene);
+        scene->names[light] = "light";
+        scene->transforms[light].translation = vec3f::zero();
+        scene->transforms[light].rotation = quat();
+        scene->transforms[light].scale = vec3f::one();
+        scene->entities[light] |= CMP_TRANSFORM;
+
+        instantiate_light(scene, light);
+
+        ImColor col = ImColor::HSV((f32)(rand() % 255) / 255.0f, 0.8f, 1.0f);
+        scene->lights[light].colour = vec3f(col.Value.x, col.Value.y, col.Value.z);
+        scene->lights[light].radius = s_light_radius;
+
+        // every 4th light is a spot pointing down
+        if (i % 4 == 0)
+        {
+            scene->lights[light].type = LIGHT_TYPE_SPOT;
+            scene->lights[light].cos_cutoff = 0.2f;
+            scene->lights[light].spot_falloff = 0.05f;
+        }
+        else
+        {
+            scene->lights[light].type = LIGHT_TYPE_POINT;
+        }
+
+        s_anim[i] = vec4f((rx * 2.0f - 1.0f) * k_scene_size, 4.0f + (f32)(i % 7), (rz * 2.0f - 1.0f) * k_scene_size,
+                          (f32)(rand() % 255) / 255.0f * 6.28f);
+
+        if (i == 0)
+            s_lights_start = light;
+    }
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    s_time += dt;
+
+    // lights orbit their own centre
+    for (u32 i = 0; i < k_max_lights; ++i)
+    {
+        u32 n = s_lights_start + i;
+
+        if ((s32)i >= s_num_lights)
+        {
+            scene->entities[n] &= ~CMP_LIGHT;
+            continue;
+        }
+
+        f32 a = s_anim[i].w + s_time;
+        scene->transforms[n].translation = s_anim[i].xyz + vec3f(sin(a), 0.0f, cos(a)) * 10.0f;
+        scene->entities[n] |= CMP_TRANSFORM | CMP_LIGHT;
+        scene->lights[n].radius = s_light_radius;
+    }
+
+    ecs_light_clusters* lc = scene->light_clusters;
+
+    ImGui::Begin("Clustered Lights", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::SliderInt("Lights", &s_num_lights, 0, k_max_lights);
+    ImGui::SliderFloat("Light Radius", &s_light_radius, 1.0f, 50.0f);
+
+    if (lc)
+    {
+        // binning runs on the render view from last frame
+        s_bin_history[s_bin_pos] = lc->stats.bin_ms;
+        s_bin_pos = (s_bin_pos + 1) % k_history;
+
+        f32 avg = 0.0f;
+        for (u32 i = 0; i < k_history; ++i)
+            avg += s_bin_history[i];
+        avg /= (f32)k_history;
+
+        const light_cluster_stats& st = lc->stats;
+
+        ImGui::Separator();
+        ImGui::Text("Grid: %i x %i x %i (%i clusters)", LIGHT_CLUSTER_DIM_X, LIGHT_CLUSTER_DIM_Y, LIGHT_CLUSTER_DIM_Z,
+                    LIGHT_CLUSTER_COUNT);
+        ImGui::Text("Point Lights: %i, Spot Lights: %i", st.num_point_lights, st.num_spot_lights);
+        ImGui::Text("Occupied Clusters: %i, Max Lights Per Cluster: %i", st.occupied_clusters, st.max_cluster_lights);
+        ImGui::Text("Light Indices: %i, Overflow: %i", st.num_indices, st.overflow);
+        ImGui::Text("Bin (ms): %.3f avg %.3f (%i workers)", st.bin_ms, avg, pen::jobs_get_num_workers());
+    }
+
+    ImGui::End();
+}
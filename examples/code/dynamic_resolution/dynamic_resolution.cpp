@@ -0,0 +1,64 @@
+#include "../example_common.h"
+
+using namespace put;
+using namespace put::ecs;
+
+pen::window_creation_params pen_window{
+    1280,                // width
+    720,                 // height
+    4,                   // MSAA samples
+    "dynamic_resolution" // window title / process name
+};
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    // ray marched post process chain, heavy enough per pixel to push frame time over budget
+    pmfx::init("data/configs/pp_demo.jsn");
+
+    ecs::editor_enable_camera(false);
+
+    pmfx::dynamic_resolution_params dp;
+    dp.enabled = true;
+    dp.target_ms = 8.0f;
+    pmfx::set_dynamic_resolution(dp);
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    // animate camera
+    static bool start = true;
+
+    if (start)
+    {
+        cam.pos = vec3f(0.0f, 0.0f, 0.0f);
+        start = false;
+    }
+
+    cam.pos += vec3f::unit_x();
+
+    cam.view.set_row(2, vec4f(0.0f, 0.0f, 1.0f, cam.pos.x));
+    cam.view.set_row(1, vec4f(0.0f, 1.0f, 0.0f, cam.pos.y));
+    cam.view.set_row(0, vec4f(1.0f, 0.0f, 0.0f, cam.pos.z));
+    cam.view.set_row(3, vec4f(0.0f, 0.0f, 0.0f, 1.0f));
+
+    cam.flags |= CF_INVALIDATED;
+
+    // targets are drawn into a sub rect at the chosen scale and blit_post_process upscales to the back buffer
+    pmfx::dynamic_resolution_params dp = pmfx::get_dynamic_resolution_params();
+
+    f32 s = pmfx::get_dynamic_resolution_scale();
+
+    ImGui::Begin("Dynamic Resolution", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    bool changed = ImGui::Checkbox("Enabled", &dp.enabled);
+    changed |= ImGui::SliderFloat("Target (ms)", &dp.target_ms, 1.0f, 33.3f);
+    changed |= ImGui::SliderFloat("Min Scale", &dp.min_scale, 0.25f, 1.0f);
+
+    ImGui::Text("Scale: %.3f, %i x %i", s, (s32)(pen_window.width * s), (s32)(pen_window.height * s));
+    ImGui::Text("History is in the pmfx dev ui under Dynamic Resolution");
+
+    ImGui::End();
+
+    if (changed)
+        pmfx::set_dynamic_resolution(dp);
+}
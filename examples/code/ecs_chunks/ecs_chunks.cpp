@@ -0,0 +1,240 @@
+#include "../example_common.h"
+
+#include "ecs/ecs_chunks.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,        // width
+    720,         // height
+    4,           // MSAA samples
+    "ecs_chunks" // window title / process name
+};
+
+namespace
+{
+    const u32 k_num_entities = 100000;
+    const u32 k_history = 120;
+
+    // separate scenes with the same entities which are not registered for update or render so only the benchmark
+    // touches them, one keeps the soa layout and one stores its components in chunks
+    ecs_scene* s_soa = nullptr;
+    ecs_scene* s_chunks = nullptr;
+
+    u32 s_num_geometry = 0;
+    u32 s_num_lights = 0;
+
+    struct timings
+    {
+        f32 history[k_history] = {0};
+        u32 pos = 0;
+
+        void add(f32 ms)
+        {
+            history[pos] = ms;
+            pos = (pos + 1) % k_history;
+        }
+
+        f32 avg()
+        {
+            f32 a = 0.0f;
+            for (u32 i = 0; i < k_history; ++i)
+                a += history[i];
+            return a / (f32)k_history;
+        }
+    };
+
+    enum e_bench_system
+    {
+        BENCH_TRANSFORMS,
+        BENCH_BOUNDS,
+        BENCH_COUNT
+    };
+
+    timings s_soa_timings[BENCH_COUNT];
+    timings s_chunk_timings[BENCH_COUNT];
+
+    const vec3f k_corners[] = {vec3f(0.0f, 0.0f, 0.0f), vec3f(1.0f, 0.0f, 0.0f), vec3f(0.0f, 1.0f, 0.0f),
+                               vec3f(0.0f, 0.0f, 1.0f), vec3f(1.0f, 1.0f, 0.0f), vec3f(0.0f, 1.0f, 1.0f),
+                               vec3f(1.0f, 0.0f, 1.0f), vec3f(1.0f, 1.0f, 1.0f)};
+
+    pen_inline void transform_bounds(mat4& wm, cmp_bounding_volume& bv)
+    {
+        vec3f min = bv.min_extents;
+        vec3f size = bv.max_extents - min;
+
+        bv.transformed_max_extents = -vec3f::flt_max();
+        bv.transformed_min_extents = vec3f::flt_max();
+
+        for (u32 c = 0; c < 8; ++c)
+        {
+            vec3f p = wm.transform_vector(min + size * k_corners[c]);
+            bv.transformed_max_extents = vec3f::vmax(bv.transformed_max_extents, p);
+            bv.transformed_min_extents = vec3f::vmin(bv.transformed_min_extents, p);
+        }
+    }
+
+    pen_inline void transform_entity(cmp_transform& t, mat4& local, mat4& world)
+    {
+        mat4 rot, scale, translation;
+        t.rotation.get_matrix(rot);
+        scale = mat::create_scale(t.scale);
+        translation = mat::create_translation(t.translation);
+        local = translation * rot * scale;
+        world = local;
+    }
+
+    void chunk_transforms(ecs_chunk_view& view, void* user_data)
+    {
+        cmp_transform* transforms = (cmp_transform*)view.components[0];
+        mat4*          local = (mat4*)view.components[1];
+        mat4*          world = (mat4*)view.components[2];
+
+        for (u32 i = 0; i < view.count; ++i)
+            transform_entity(transforms[i], local[i], world[i]);
+    }
+
+    void chunk_bounds(ecs_chunk_view& view, void* user_data)
+    {
+        mat4*                world = (mat4*)view.components[0];
+        cmp_bounding_volume* bounds = (cmp_bounding_volume*)view.components[1];
+
+        for (u32 i = 0; i < view.count; ++i)
+            transform_bounds(world[i], bounds[i]);
+    }
+
+    void soa_transforms(ecs_scene* scene)
+    {
+        for (u32 n = 0; n < scene->num_entities; ++n)
+        {
+            if (!(scene->entities[n] & CMP_TRANSFORM))
+                continue;
+
+            transform_entity(scene->transforms[n], scene->local_matrices[n], scene->world_matrices[n]);
+        }
+    }
+
+    void soa_bounds(ecs_scene* scene)
+    {
+        for (u32 n = 0; n < scene->num_entities; ++n)
+        {
+            if (!(scene->entities[n] & CMP_GEOMETRY))
+                continue;
+
+            transform_bounds(scene->world_matrices[n], scene->bounding_volumes[n]);
+        }
+    }
+
+    // mostly transform only entities with a sparse mix of geometry and lights, geometry has flags and bounds only
+    // so the benchmark measures storage and iteration without any render resources. flags are set before writing
+    // components so chunked entities are created in their final archetype
+    void create_bench_entities(ecs_scene* scene)
+    {
+        s_num_geometry = 0;
+        s_num_lights = 0;
+
+        for (u32 i = 0; i < k_num_entities; ++i)
+        {
+            u32 e = get_new_entity(scene);
+
+            f32 x = (f32)(i % 317);
+            f32 z = (f32)(i / 317);
+
+            scene->entities[e] |= CMP_TRANSFORM;
+            scene->transforms[e].translation = vec3f(x, 0.0f, z);
+            scene->transforms[e].rotation = quat();
+            scene->transforms[e].scale = vec3f::one();
+
+            if (i % 4 == 0)
+            {
+                scene->entities[e] |= CMP_GEOMETRY;
+                scene->bounding_volumes[e].min_extents = -vec3f::one();
+                scene->bounding_volumes[e].max_extents = vec3f::one();
+                ++s_num_geometry;
+            }
+            else if (i % 20 == 1)
+            {
+                scene->entities[e] |= CMP_LIGHT;
+                scene->lights[e].colour = vec3f::one();
+                scene->lights[e].type = LIGHT_TYPE_POINT;
+                ++s_num_lights;
+            }
+        }
+    }
+
+    void memory_ui(const c8* name, const ecs_chunk_memory_stats& ms)
+    {
+        const f32 mb = 1024.0f * 1024.0f;
+        f32       total = (f32)(ms.soa_bytes + ms.chunk_bytes) / mb;
+
+        ImGui::Text("    %s: %.2f mb (soa %.2f mb, chunks %.2f mb)", name, total, (f32)ms.soa_bytes / mb,
+                    (f32)ms.chunk_bytes / mb);
+    }
+} // namespace
+
+void example_setup(ecs_scene* scene, camera& cam)
+{
+    clear_scene(scene);
+
+    s_soa = new ecs_scene();
+    resize_scene_buffers(s_soa, k_num_entities);
+    create_bench_entities(s_soa);
+
+    // chunk storage is enabled before creating entities so they are written straight into chunks
+    s_chunks = new ecs_scene();
+    resize_scene_buffers(s_chunks, k_num_entities);
+    enable_chunk_storage(s_chunks, true);
+    create_bench_entities(s_chunks);
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    static pen::timer* timer = pen::timer_create();
+
+    static const u32 transform_query[] = {get_component_index(s_chunks, &s_chunks->transforms),
+                                          get_component_index(s_chunks, &s_chunks->local_matrices),
+                                          get_component_index(s_chunks, &s_chunks->world_matrices)};
+
+    // cbuffer is queried to filter geometry entities, only world matrices and bounds are accessed
+    static const u32 bounds_query[] = {get_component_index(s_chunks, &s_chunks->world_matrices),
+                                       get_component_index(s_chunks, &s_chunks->bounding_volumes),
+                                       get_component_index(s_chunks, &s_chunks->cbuffer)};
+
+    pen::timer_start(timer);
+    soa_transforms(s_soa);
+    s_soa_timings[BENCH_TRANSFORMS].add(pen::timer_elapsed_ms(timer));
+
+    pen::timer_start(timer);
+    soa_bounds(s_soa);
+    s_soa_timings[BENCH_BOUNDS].add(pen::timer_elapsed_ms(timer));
+
+    pen::timer_start(timer);
+    u32 transforms_visited = for_each_chunk(s_chunks, transform_query, 3, chunk_transforms, nullptr);
+    s_chunk_timings[BENCH_TRANSFORMS].add(pen::timer_elapsed_ms(timer));
+
+    pen::timer_start(timer);
+    u32 bounds_visited = for_each_chunk(s_chunks, bounds_query, 3, chunk_bounds, nullptr);
+    s_chunk_timings[BENCH_BOUNDS].add(pen::timer_elapsed_ms(timer));
+
+    ecs_chunk_memory_stats soa_ms = get_chunk_memory_stats(s_soa);
+    ecs_chunk_memory_stats chunk_ms = get_chunk_memory_stats(s_chunks);
+
+    ImGui::Begin("ECS Chunk Storage");
+    ImGui::Text("Entities: %i, Geometry: %i, Lights: %i", s_chunks->num_entities, s_num_geometry, s_num_lights);
+    ImGui::Text("Archetypes: %i, Chunks: %i", chunk_ms.num_archetypes, chunk_ms.num_chunks);
+
+    // totals include every component, entities and the free list stay soa in the chunked scene
+    ImGui::Separator();
+    ImGui::Text("Total Memory");
+    memory_ui("soa scene", soa_ms);
+    memory_ui("chunk scene", chunk_ms);
+
+    ImGui::Separator();
+    ImGui::Text("Transforms (ms): soa %.3f, chunks %.3f (%i entities)", s_soa_timings[BENCH_TRANSFORMS].avg(),
+                s_chunk_timings[BENCH_TRANSFORMS].avg(), transforms_visited);
+    ImGui::Text("Bounds (ms): soa %.3f, chunks %.3f (%i entities)", s_soa_timings[BENCH_BOUNDS].avg(),
+                s_chunk_timings[BENCH_BOUNDS].avg(), bounds_visited);
+
+    ImGui::End();
+}
@@ -0,0 +1,253 @@
+#include "../example_common.h"
+
+#include "ecs/ecs_lod.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,       // width
+    720,        // height
+    4,          // MSAA samples
+    "mesh_lods" // window title / process name
+};
+
+namespace
+{
+    const s32 k_rows = 96;
+    const s32 k_segments = 128;
+    const s32 k_field_dim = 16;
+    const f32 k_spacing = 12.0f;
+
+    struct lod_measure
+    {
+        geometry_lod_stats stats;
+        f32                frame_ms = 0.0f;
+        bool               valid = false;
+    };
+
+    lod_measure s_measure[2]; // lods off, lods on
+
+    vec3f rock_position(f32 u, f32 v)
+    {
+        f32 theta = v * M_PI;
+        f32 phi = u * M_TWO_PI;
+
+        vec3f n = vec3f(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+
+        // lumpy, with finer ridges on top which only the higher lods can keep
+        f32 d = 1.0f + 0.15f * sin(n.x * 5.0f) * sin(n.z * 4.0f) + 0.04f * sin(n.y * 23.0f + n.x * 17.0f);
+        return n * d;
+    }
+
+    geometry_resource* create_rock_geometry()
+    {
+        u32 num_verts = (k_rows + 1) * (k_segments + 1);
+        u32 num_indices = k_rows * k_segments * 6;
+
+        vertex_model* v = (vertex_model*)pen::memory_alloc(sizeof(vertex_model) * num_verts);
+        vec4f*        p = (vec4f*)pen::memory_alloc(sizeof(vec4f) * num_verts);
+        u16*          indices = (u16*)pen::memory_alloc(sizeof(u16) * num_indices);
+
+        f32 du = 1.0f / (f32)k_segments;
+        f32 dv = 1.0f / (f32)k_rows;
+
+        vec3f min_extents = vec3f::flt_max();
+        vec3f max_extents = -vec3f::flt_max();
+
+        u32 vi = 0;
+        for (s32 r = 0; r <= k_rows; ++r)
+        {
+            for (s32 s = 0; s <= k_segments; ++s)
+            {
+                f32 u = (f32)s * du;
+                f32 vv = (f32)r * dv;
+
+                vec3f pos = rock_position(u, vv);
+                vec3f t = rock_position(u + du, vv) - rock_position(u - du, vv);
+                vec3f b = rock_position(u, vv + dv) - rock_position(u, vv - dv);
+                vec3f n = normalised(cross(t, b));
+
+                // poles collapse the tangent
+                if (mag(t) < 0.0001f)
+                    n = normalised(pos);
+
+                v[vi].pos = vec4f(pos, 1.0f);
+                v[vi].normal = vec4f(n, 1.0f);
+                v[vi].uv12 = vec4f(u, vv, 0.0f, 0.0f);
+                v[vi].tangent = vec4f(normalised(t), 1.0f);
+                v[vi].bitangent = vec4f(cross(n, normalised(t)), 1.0f);
+
+                p[vi] = v[vi].pos;
+
+                min_extents = min_union(min_extents, pos);
+                max_extents = max_union(max_extents, pos);
+
+                vi++;
+            }
+        }
+
+        u32 ii = 0;
+        for (s32 r = 0; r < k_rows; ++r)
+        {
+            for (s32 s = 0; s < k_segments; ++s)
+            {
+                u16 a = r * (k_segments + 1) + s;
+                u16 b = a + 1;
+                u16 c = a + k_segments + 1;
+                u16 d = c + 1;
+
+                indices[ii++] = a;
+                indices[ii++] = c;
+                indices[ii++] = b;
+
+                indices[ii++] = c;
+                indices[ii++] = d;
+                indices[ii++] = b;
+            }
+        }
+
+        geometry_resource* gr = new geometry_resource;
+        gr->geometry_name = "rock";
+        gr->hash = PEN_HASH("rock");
+        gr->file_hash = PEN_HASH("mesh_lods");
+        gr->filename = "mesh_lods";
+        gr->submesh_index = 0;
+        gr->p_skin = nullptr;
+        gr->num_vertices = num_verts;
+        gr->num_indices = num_indices;
+        gr->vertex_size = sizeof(vertex_model);
+        gr->index_type = PEN_FORMAT_R16_UINT;
+        gr->min_extents = min_extents;
+        gr->max_extents = max_extents;
+        gr->cpu_vertex_buffer = v;
+        gr->cpu_position_buffer = p;
+        gr->cpu_index_buffer = indices;
+        gr->index_buffer = PEN_INVALID_HANDLE;
+        gr->position_buffer = PEN_INVALID_HANDLE;
+
+        pen::buffer_creation_params bcp;
+        bcp.usage_flags = PEN_USAGE_DEFAULT;
+        bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
+        bcp.cpu_access_flags = 0;
+        bcp.buffer_size = sizeof(vertex_model) * num_verts;
+        bcp.data = (void*)v;
+
+        gr->vertex_buffer = pen::renderer_create_buffer(bcp);
+
+        // simplifies and creates the index buffer
+        generate_geometry_lods(gr);
+
+        add_geometry_resource(gr);
+        return gr;
+    }
+} // namespace
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    clear_scene(scene);
+
+    cam.zoom = 60.0f;
+    cam.rot = vec2f(-0.3f, 0.6f);
+
+    material_resource* default_material = get_material_resource(PEN_HASH("default_material"));
+    geometry_resource* box = get_geometry_resource(PEN_HASH("cube"));
+    geometry_resource* rock = create_rock_geometry();
+
+    f32 half = (f32)k_field_dim * k_spacing * 0.5f;
+
+    // light
+    u32 light = get_new_entity(scene);
+    scene->names[light] = "sun";
+    scene->transforms[light].rotation = quat();
+    scene->transforms[light].scale = vec3f::one();
+    scene->entities[light] |= CMP_TRANSFORM;
+    instantiate_light(scene, light);
+    scene->lights[light].colour = vec3f(0.8f, 0.8f, 0.7f);
+    scene->lights[light].direction = normalised(vec3f(0.5f, 1.0f, 0.3f));
+    scene->lights[light].type = LIGHT_TYPE_DIR;
+    scene->lights[light].shadow_map = true;
+
+    // ground
+    u32 ground = get_new_entity(scene);
+    scene->names[ground] = "ground";
+    scene->transforms[ground].translation = vec3f(0.0f, -1.0f, 0.0f);
+    scene->transforms[ground].rotation = quat();
+    scene->transforms[ground].scale = vec3f(half, 1.0f, half);
+    scene->entities[ground] |= CMP_TRANSFORM;
+    scene->parents[ground] = ground;
+    instantiate_geometry(box, scene, ground);
+    instantiate_material(default_material, scene, ground);
+    instantiate_model_cbuffer(scene, ground);
+
+    // field of rocks stretching away from the camera so every level is in view
+    for (s32 i = 0; i < k_field_dim; ++i)
+    {
+        for (s32 j = 0; j < k_field_dim; ++j)
+        {
+            f32 s = 2.0f + (f32)(rand() % 255) / 255.0f * 3.0f;
+
+            u32 n = get_new_entity(scene);
+            scene->names[n] = "rock";
+            scene->transforms[n].translation =
+                vec3f(-half + k_spacing * ((f32)i + 0.5f), s * 0.5f, -half + k_spacing * ((f32)j + 0.5f));
+            scene->transforms[n].rotation = quat(0.0f, (f32)(rand() % 255) / 255.0f * M_TWO_PI, 0.0f);
+            scene->transforms[n].scale = vec3f(s);
+            scene->entities[n] |= CMP_TRANSFORM;
+            scene->parents[n] = n;
+            instantiate_geometry(rock, scene, n);
+            instantiate_material(default_material, scene, n);
+            instantiate_model_cbuffer(scene, n);
+        }
+    }
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    geometry_lod_params&      lp = scene->geometry_lods;
+    const geometry_lod_stats& st = scene->geometry_stats;
+
+    // keep the last frame measured in each mode to compare
+    lod_measure& m = s_measure[lp.enabled ? 1 : 0];
+    m.stats = st;
+    m.frame_ms = dt * 1000.0f;
+    m.valid = true;
+
+    ImGui::Begin("Mesh LODs", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    geometry_resource* rock = get_geometry_resource(PEN_HASH("rock"));
+    if (rock)
+    {
+        for (u32 l = 0; l < rock->num_lods; ++l)
+            ImGui::Text("lod %i: %i triangles, error %.4f", l, rock->lods[l].num_indices / 3, rock->lods[l].error);
+
+        ImGui::Separator();
+    }
+
+    ImGui::Checkbox("Geometry LOD", &lp.enabled);
+    ImGui::SliderFloat("Pixel Error", &lp.pixel_error, 0.1f, 16.0f);
+    ImGui::SliderFloat("Hysteresis", &lp.hysteresis, 0.0f, 0.9f);
+    ImGui::SliderInt("Shadow Bias", (s32*)&lp.shadow_bias, 0, MAX_GEOMETRY_LODS - 1);
+
+    ImGui::Separator();
+
+    for (u32 l = 0; l < MAX_GEOMETRY_LODS; ++l)
+        ImGui::Text("lod %i draws: %i", l, st.lod_draws[l]);
+
+    static const c8* k_mode_names[] = {"LOD off", "LOD on"};
+    for (u32 i = 0; i < 2; ++i)
+    {
+        const lod_measure& lm = s_measure[i];
+        if (!lm.valid)
+            continue;
+
+        ImGui::Separator();
+        ImGui::Text("%s", k_mode_names[i]);
+        ImGui::Text("    draws: %i, triangles: %i (lod 0: %i)", lm.stats.draws, lm.stats.triangles,
+                    lm.stats.full_triangles);
+        ImGui::Text("    shadow triangles: %i (lod 0: %i)", lm.stats.shadow_triangles, lm.stats.shadow_full_triangles);
+        ImGui::Text("    record: %.3f (ms), frame: %.3f (ms)", lm.stats.record_ms, lm.frame_ms);
+    }
+
+    ImGui::End();
+}
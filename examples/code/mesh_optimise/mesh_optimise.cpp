@@ -0,0 +1,89 @@
+#include "../example_common.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,           // width
+    720,            // height
+    4,              // MSAA samples
+    "mesh_optimise" // window title / process name
+};
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    clear_scene(scene);
+
+    material_resource* default_material = get_material_resource(PEN_HASH("default_material"));
+    geometry_resource* box = get_geometry_resource(PEN_HASH("cube"));
+
+    // light
+    u32 light = get_new_entity(scene);
+    scene->names[light] = "front_light";
+    scene->id_name[light] = PEN_HASH("front_light");
+    scene->lights[light].colour = vec3f::one();
+    scene->lights[light].direction = vec3f::one();
+    scene->lights[light].type = LIGHT_TYPE_DIR;
+    scene->transforms[light].translation = vec3f::zero();
+    scene->transforms[light].rotation = quat();
+    scene->transforms[light].scale = vec3f::one();
+    scene->entities[light] |= CMP_LIGHT;
+    scene->entities[light] |= CMP_TRANSFORM;
+
+    // ground
+    u32 ground = get_new_entity(scene);
+    scene->names[ground] = "ground";
+    scene->transforms[ground].translation = vec3f::zero();
+    scene->transforms[ground].rotation = quat();
+    scene->transforms[ground].scale = vec3f(50.0f, 1.0f, 50.0f);
+    scene->entities[ground] |= CMP_TRANSFORM;
+    scene->parents[ground] = ground;
+    instantiate_geometry(box, scene, ground);
+    instantiate_material(default_material, scene, ground);
+    instantiate_model_cbuffer(scene, ground);
+
+    // triangles and vertices are reordered as they load, acmr and atvr before and after are kept per submesh
+    u32 lucy = load_pmm("data/models/lucy.pmm", scene, PMM_ALL | PMM_OPTIMISE_MESHES);
+    scene->transforms[lucy].scale = vec3f(0.07f);
+    scene->transforms[lucy].rotation = quat(0.0f, -M_PI / 4.0f, 0.0f);
+    scene->transforms[lucy].translation = vec3f(-4.0f, 0.65f, 0.0f);
+    scene->entities[lucy] |= CMP_TRANSFORM;
+
+    u32 head = load_pmm("data/models/head_smooth.pmm", scene, PMM_ALL | PMM_OPTIMISE_MESHES);
+    scene->transforms[head].translation = vec3f(4.0f, 4.0f, 0.0f);
+    scene->entities[head] |= CMP_TRANSFORM;
+
+    const geometry_load_stats& st = get_geometry_load_stats();
+    PEN_LOG("mesh optimise: %i of %i geometries, load %.3f ms (optimise %.3f ms)\n", st.num_optimised,
+            st.num_geometries, st.load_ms, st.optimise_ms);
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    const geometry_load_stats& st = get_geometry_load_stats();
+
+    ImGui::Begin("Mesh Optimise", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    ImGui::Text("Geometries: %i (%i optimised)", st.num_geometries, st.num_optimised);
+    ImGui::Text("Load (ms): %.3f, of which optimising: %.3f", st.load_ms, st.optimise_ms);
+
+    ImGui::Separator();
+    ImGui::Text("Fifo cache of 16, acmr best case 0.5, atvr best case 1.0");
+
+    for (u32 n = 0; n < scene->num_entities; ++n)
+    {
+        if (!(scene->entities[n] & CMP_GEOMETRY))
+            continue;
+
+        geometry_resource* gr = get_geometry_resource(scene->id_geometry[n]);
+        if (!gr || !gr->optimised)
+            continue;
+
+        const mesh_optimise_stats& os = gr->optimise_stats;
+        ImGui::Text("%s %i: %i triangles, acmr %.3f -> %.3f, atvr %.3f -> %.3f", gr->geometry_name.c_str(),
+                    gr->submesh_index, gr->num_indices / 3, os.acmr_before, os.acmr_after, os.atvr_before,
+                    os.atvr_after);
+    }
+
+    ImGui::End();
+}
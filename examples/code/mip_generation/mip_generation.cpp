@@ -0,0 +1,217 @@
+#include "../example_common.h"
+
+#include "mip_generator.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,            // width
+    720,             // height
+    4,               // MSAA samples
+    "mip_generation" // window title / process name
+};
+
+namespace
+{
+    struct mip_format
+    {
+        const c8* name;
+        u32       format;
+        u32       block_size;
+        u32       flags;
+    };
+
+    const mip_format k_formats[] = {{"RGBA8", PEN_TEX_FORMAT_RGBA8_UNORM, 4, 0},
+                                    {"RGBA8 sRGB", PEN_TEX_FORMAT_RGBA8_UNORM, 4, mips::MIP_SRGB},
+                                    {"R8", PEN_TEX_FORMAT_R8_UNORM, 1, 0},
+                                    {"RGBA16F", PEN_TEX_FORMAT_R16G16B16A16_FLOAT, 8, 0},
+                                    {"R32F", PEN_TEX_FORMAT_R32_FLOAT, 4, 0}};
+
+    const c8* k_filter_names[] = {"Box", "Kaiser", "Max"};
+
+    struct mip_result
+    {
+        const c8*       format;
+        const c8*       filter;
+        const c8*       shape;
+        u32             texels; // top level
+        mips::mip_stats stats;
+    };
+    mip_result* s_results = nullptr;
+
+    u32 s_texture = PEN_INVALID_HANDLE;
+
+    void fill_top_level(pen::texture_creation_params& tcp)
+    {
+        u32 depth = tcp.collection_type == pen::TEXTURE_COLLECTION_VOLUME ? tcp.num_arrays : 1;
+        u32 num_texels = tcp.width * tcp.height * depth;
+
+        tcp.data_size = num_texels * tcp.block_size;
+        tcp.data = pen::memory_alloc(tcp.data_size);
+
+        // rings with some noise so every filter has detail to work on
+        u32 seed = 1;
+        for (u32 i = 0; i < num_texels; ++i)
+        {
+            u32 x = i % tcp.width;
+            u32 y = (i / tcp.width) % tcp.height;
+
+            seed = seed * 1664525 + 1013904223;
+            f32 n = (f32)(seed >> 24) / 255.0f;
+            f32 r = sqrtf((f32)(x * x + y * y)) * 0.1f;
+            f32 v = (sinf(r) * 0.5f + 0.5f) * 0.8f + n * 0.2f;
+
+            switch (tcp.format)
+            {
+                case PEN_TEX_FORMAT_RGBA8_UNORM:
+                {
+                    u8* t = (u8*)tcp.data + i * 4;
+                    t[0] = (u8)(v * 255.0f);
+                    t[1] = (u8)(n * 255.0f);
+                    t[2] = (u8)((1.0f - v) * 255.0f);
+                    t[3] = 255;
+                }
+                break;
+                case PEN_TEX_FORMAT_R8_UNORM:
+                    ((u8*)tcp.data)[i] = (u8)(v * 255.0f);
+                    break;
+                case PEN_TEX_FORMAT_R16G16B16A16_FLOAT:
+                {
+                    f16* t = (f16*)tcp.data + i * 4;
+                    t[0] = float_to_half(v * 4.0f);
+                    t[1] = float_to_half(n);
+                    t[2] = float_to_half(1.0f - v);
+                    t[3] = float_to_half(1.0f);
+                }
+                break;
+                case PEN_TEX_FORMAT_R32_FLOAT:
+                    ((f32*)tcp.data)[i] = v;
+                    break;
+            }
+        }
+    }
+
+    pen::texture_creation_params make_tcp(const mip_format& fmt, u32 collection_type, u32 w, u32 h, u32 a)
+    {
+        pen::texture_creation_params tcp;
+        tcp.collection_type = collection_type;
+        tcp.width = w;
+        tcp.height = h;
+        tcp.format = fmt.format;
+        tcp.num_mips = 1;
+        tcp.num_arrays = a;
+        tcp.sample_count = 1;
+        tcp.sample_quality = 0;
+        tcp.usage = PEN_USAGE_DEFAULT;
+        tcp.bind_flags = PEN_BIND_SHADER_RESOURCE;
+        tcp.cpu_access_flags = 0;
+        tcp.flags = 0;
+        tcp.block_size = fmt.block_size;
+        tcp.pixels_per_block = 1;
+        tcp.data = nullptr;
+        tcp.data_size = 0;
+
+        fill_top_level(tcp);
+
+        return tcp;
+    }
+
+    void benchmark(const c8* shape, u32 collection_type, u32 w, u32 h, u32 a)
+    {
+        for (u32 f = 0; f < PEN_ARRAY_SIZE(k_formats); ++f)
+        {
+            for (u32 filter = 0; filter < PEN_ARRAY_SIZE(k_filter_names); ++filter)
+            {
+                pen::texture_creation_params tcp = make_tcp(k_formats[f], collection_type, w, h, a);
+
+                mips::mip_params mp;
+                mp.filter = filter;
+                mp.flags = k_formats[f].flags;
+
+                mip_result r;
+                r.format = k_formats[f].name;
+                r.filter = k_filter_names[filter];
+                r.shape = shape;
+                r.texels = w * h * a;
+
+                void* top_data = tcp.data;
+                mips::generate(tcp, mp, &r.stats);
+                pen::memory_free(top_data);
+
+                PEN_LOG("mips: %s %s %s, %i mips, %.2f ms, %.2f mtexels/s\n", shape, r.format, r.filter,
+                        r.stats.num_mips, r.stats.ms, (f32)r.texels / (r.stats.ms * 1000.0f));
+
+                // keep the kaiser rgba8 srgb chain to look at
+                if (s_texture == PEN_INVALID_HANDLE && filter == mips::FILTER_KAISER && k_formats[f].flags)
+                    s_texture = pen::renderer_create_texture(tcp);
+
+                pen::memory_free(tcp.data);
+
+                sb_push(s_results, r);
+            }
+        }
+    }
+} // namespace
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    clear_scene(scene);
+
+    // generated here on load with the worker pool, the window only shows the results
+    benchmark("2048x2048", pen::TEXTURE_COLLECTION_NONE, 2048, 2048, 1);
+    benchmark("512x512x6 cube", pen::TEXTURE_COLLECTION_CUBE, 512, 512, 6);
+    benchmark("128^3 volume", pen::TEXTURE_COLLECTION_VOLUME, 128, 128, 128);
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    ImGui::Begin("Mip Generation", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    ImGui::Text("Workers: %i + calling thread", pen::jobs_get_num_workers());
+    ImGui::Separator();
+
+    ImGui::Columns(6);
+    ImGui::Text("Texture");
+    ImGui::NextColumn();
+    ImGui::Text("Format");
+    ImGui::NextColumn();
+    ImGui::Text("Filter");
+    ImGui::NextColumn();
+    ImGui::Text("Mips");
+    ImGui::NextColumn();
+    ImGui::Text("Time (ms)");
+    ImGui::NextColumn();
+    ImGui::Text("Source MTexels/s");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (u32 i = 0; i < sb_count(s_results); ++i)
+    {
+        const mip_result& r = s_results[i];
+
+        ImGui::Text("%s", r.shape);
+        ImGui::NextColumn();
+        ImGui::Text("%s", r.format);
+        ImGui::NextColumn();
+        ImGui::Text("%s", r.filter);
+        ImGui::NextColumn();
+        ImGui::Text("%i", r.stats.num_mips);
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", r.stats.ms);
+        ImGui::NextColumn();
+        ImGui::Text("%.1f", (f32)r.texels / (r.stats.ms * 1000.0f));
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+
+    if (is_valid(s_texture))
+    {
+        ImGui::Separator();
+        ImGui::Text("RGBA8 sRGB, Kaiser");
+        ImGui::Image(IMG(s_texture), ImVec2(256, 256));
+    }
+
+    ImGui::End();
+}
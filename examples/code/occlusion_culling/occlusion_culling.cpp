@@ -0,0 +1,267 @@
+#include "../example_common.h"
+
+#include "ecs/ecs_occlusion.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,               // width
+    720,                // height
+    4,                  // MSAA samples
+    "occlusion_culling" // window title / process name
+};
+
+namespace
+{
+    const s32 k_blocks = 12;
+    const f32 k_block_size = 20.0f;
+    const f32 k_street_width = 8.0f;
+    const u32 k_props_per_block = 6;
+    const u32 k_sweep_steps = 64;
+
+    u32  s_buildings_start = 0;
+    u32  s_num_buildings = 0;
+    bool s_occlusion = true;
+    bool s_show_buffer = false;
+
+    struct sweep_report
+    {
+        u32  candidates = 0;   // passed frustum cull, summed over steps
+        u32  occluded = 0;
+        f32  raster_ms = 0.0f; // per step average
+        f32  test_ms = 0.0f;
+        bool valid = false;
+    };
+    sweep_report s_report;
+
+    bool frustum_cull(ecs_scene* scene, camera& cam, u32 n)
+    {
+        vec3f& min = scene->bounding_volumes[n].transformed_min_extents;
+        vec3f& max = scene->bounding_volumes[n].transformed_max_extents;
+
+        vec3f pos = min + (max - min) * 0.5f;
+        f32   radius = scene->bounding_volumes[n].radius;
+
+        for (s32 i = 0; i < 6; ++i)
+            if (maths::point_plane_distance(pos, cam.camera_frustum.p[i], cam.camera_frustum.n[i]) > radius)
+                return true;
+
+        return false;
+    }
+
+    void set_occluders(ecs_scene* scene, bool enable)
+    {
+        for (u32 i = 0; i < s_num_buildings; ++i)
+        {
+            if (enable)
+                add_occluder(scene, s_buildings_start + i);
+            else
+                remove_occluder(scene, s_buildings_start + i);
+        }
+    }
+
+    void headless_sweep(ecs_scene* scene, const camera& main_camera)
+    {
+        // spin a street level camera through 360 degrees using only the cpu path, no views are rendered
+        camera cam;
+        camera_create_perspective(&cam, main_camera.fov, main_camera.aspect, main_camera.near_plane,
+                                  main_camera.far_plane);
+
+        cam.focus = vec3f(k_street_width * 0.5f, 2.0f, k_street_width * 0.5f);
+        cam.zoom = 0.1f;
+
+        static pen::timer* timer = pen::timer_create();
+
+        s_report = sweep_report();
+        for (u32 s = 0; s < k_sweep_steps; ++s)
+        {
+            cam.rot = vec2f(0.0f, (f32)s / (f32)k_sweep_steps * M_TWO_PI);
+            camera_update_look_at(&cam);
+            camera_update_frustum(&cam);
+
+            update_occlusion(scene, &cam);
+            s_report.raster_ms += scene->occlusion->stats.raster_ms;
+
+            pen::timer_start(timer);
+            for (u32 n = 0; n < scene->num_entities; ++n)
+            {
+                if (!(scene->entities[n] & CMP_GEOMETRY))
+                    continue;
+
+                if (frustum_cull(scene, cam, n))
+                    continue;
+
+                s_report.candidates++;
+
+                vec3f& min = scene->bounding_volumes[n].transformed_min_extents;
+                vec3f& max = scene->bounding_volumes[n].transformed_max_extents;
+
+                if (is_occluded(scene, min, max))
+                    s_report.occluded++;
+            }
+            s_report.test_ms += pen::timer_elapsed_ms(timer);
+        }
+
+        s_report.raster_ms /= (f32)k_sweep_steps;
+        s_report.test_ms /= (f32)k_sweep_steps;
+        s_report.valid = true;
+
+        f32 pc = s_report.candidates ? (f32)s_report.occluded / (f32)s_report.candidates * 100.0f : 0.0f;
+        PEN_LOG("occlusion sweep: %i steps, %i candidates, %i occluded (%.1f%%), raster %.3f ms, test %.3f ms\n",
+                k_sweep_steps, s_report.candidates, s_report.occluded, pc, s_report.raster_ms, s_report.test_ms);
+    }
+} // namespace
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    pmfx::init("data/configs/occlusion_culling.jsn");
+
+    clear_scene(scene);
+
+    cam.focus = vec3f(k_street_width * 0.5f, 2.0f, k_street_width * 0.5f);
+    cam.zoom = 30.0f;
+    cam.rot = vec2f(-0.1f, 0.4f);
+
+    material_resource* default_material = get_material_resource(PEN_HASH("default_material"));
+    geometry_resource* box_resource = get_geometry_resource(PEN_HASH("cube"));
+    geometry_resource* sphere_resource = get_geometry_resource(PEN_HASH("sphere"));
+
+    f32 pitch = k_block_size + k_street_width;
+    f32 half = (f32)k_blocks * pitch * 0.5f;
+
+    // ground
+    u32 ground = get_new_entity(scene);
+    scene->names[ground] = "ground";
+    scene->transforms[ground].translation = vec3f(0.0f, -1.0f, 0.0f);
+    scene->transforms[ground].rotation = quat();
+    scene->transforms[ground].scale = vec3f(half, 1.0f, half);
+    scene->entities[ground] |= CMP_TRANSFORM;
+    scene->parents[ground] = ground;
+    instantiate_geometry(box_resource, scene, ground);
+    instantiate_material(default_material, scene, ground);
+    instantiate_model_cbuffer(scene, ground);
+
+    // buildings are the occluders, they use their own cube mesh as the proxy
+    for (s32 i = 0; i < k_blocks; ++i)
+    {
+        for (s32 j = 0; j < k_blocks; ++j)
+        {
+            f32   h = 10.0f + (f32)(rand() % 255) / 255.0f * 40.0f;
+            vec3f centre = vec3f(-half + pitch * ((f32)i + 0.5f), h, -half + pitch * ((f32)j + 0.5f));
+
+            u32 building = get_new_entity(scene);
+            scene->names[building] = "building";
+            scene->transforms[building].translation = centre;
+            scene->transforms[building].rotation = quat();
+            scene->transforms[building].scale = vec3f(k_block_size * 0.5f, h, k_block_size * 0.5f);
+            scene->entities[building] |= CMP_TRANSFORM;
+            scene->parents[building] = building;
+            instantiate_geometry(box_resource, scene, building);
+            instantiate_material(default_material, scene, building);
+            instantiate_model_cbuffer(scene, building);
+
+            if (s_num_buildings == 0)
+                s_buildings_start = building;
+
+            s_num_buildings++;
+        }
+    }
+
+    // props along the streets which are hidden behind the buildings from most view points
+    for (s32 i = 0; i < k_blocks; ++i)
+    {
+        for (s32 j = 0; j < k_blocks; ++j)
+        {
+            for (u32 p = 0; p < k_props_per_block; ++p)
+            {
+                f32 t = (f32)(rand() % 255) / 255.0f;
+                f32 x = -half + pitch * (f32)i + t * pitch;
+                f32 z = -half + pitch * (f32)j + k_street_width * 0.25f + (f32)(rand() % 255) / 255.0f * 2.0f;
+
+                if (p & 1)
+                    std::swap(x, z);
+
+                u32 prop = get_new_entity(scene);
+                scene->names[prop] = "prop";
+                scene->transforms[prop].translation = vec3f(x, 1.0f, z);
+                scene->transforms[prop].rotation = quat();
+                scene->transforms[prop].scale = vec3f(1.0f);
+                scene->entities[prop] |= CMP_TRANSFORM;
+                scene->parents[prop] = prop;
+                instantiate_geometry(p % 3 == 0 ? sphere_resource : box_resource, scene, prop);
+                instantiate_material(default_material, scene, prop);
+                instantiate_model_cbuffer(scene, prop);
+            }
+        }
+    }
+
+    // light
+    u32 light = get_new_entity(scene);
+    scene->names[light] = "sun";
+    scene->transforms[light].rotation = quat();
+    scene->transforms[light].scale = vec3f::one();
+    scene->entities[light] |= CMP_TRANSFORM;
+    instantiate_light(scene, light);
+    scene->lights[light].colour = vec3f(0.8f, 0.8f, 0.7f);
+    scene->lights[light].direction = normalised(vec3f(0.5f, 1.0f, 0.3f));
+    scene->lights[light].type = LIGHT_TYPE_DIR;
+
+    set_occluders(scene, s_occlusion);
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    ImGui::Begin("Occlusion Culling", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    if (ImGui::Checkbox("Occlusion Cull", &s_occlusion))
+        set_occluders(scene, s_occlusion);
+
+    ImGui::Checkbox("Show Depth Buffer", &s_show_buffer);
+
+    ecs_occlusion* oc = scene->occlusion;
+    if (oc)
+    {
+        const occlusion_stats& st = oc->stats;
+
+        f32 pc = st.num_tested ? (f32)st.num_occluded / (f32)st.num_tested * 100.0f : 0.0f;
+
+        ImGui::Separator();
+        ImGui::Text("Buffer: %i x %i, %i levels (%i workers)", OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT,
+                    oc->num_levels, pen::jobs_get_num_workers());
+        ImGui::Text("Occluders: %i, Triangles: %i, Rasterised: %i", st.num_occluders, st.num_triangles, st.rasterised);
+        ImGui::Text("Tested: %i, Occluded: %i (%.1f%%)", st.num_tested, st.num_occluded, pc);
+        ImGui::Text("Raster (ms): %.3f", st.raster_ms);
+
+        ImGui::Separator();
+        if (ImGui::Button("Run Headless Sweep"))
+            headless_sweep(scene, cam);
+
+        if (s_report.valid)
+        {
+            f32 spc = s_report.candidates ? (f32)s_report.occluded / (f32)s_report.candidates * 100.0f : 0.0f;
+            ImGui::Text("Sweep: %i candidates, %i occluded (%.1f%%)", s_report.candidates, s_report.occluded, spc);
+            ImGui::Text("Sweep (ms): raster %.3f, test %.3f", s_report.raster_ms, s_report.test_ms);
+        }
+
+        // depth buffer in the debug overlay at half resolution, nearer occluders are brighter
+        if (s_show_buffer && oc->valid)
+        {
+            f32* depth = oc->levels[0];
+            for (u32 y = 0; y < OCCLUSION_BUFFER_HEIGHT; y += 2)
+            {
+                for (u32 x = 0; x < OCCLUSION_BUFFER_WIDTH; x += 2)
+                {
+                    f32 d = depth[y * OCCLUSION_BUFFER_WIDTH + x];
+                    if (d <= 0.0f)
+                        continue;
+
+                    f32 c = std::min<f32>(d * cam.near_plane * 200.0f, 1.0f);
+                    dbg::add_quad_2f(vec2f(10.0f + x, 10.0f + y), vec2f(2.0f, 2.0f), vec4f(c, c, c, 1.0f));
+                }
+            }
+        }
+    }
+
+    ImGui::End();
+}
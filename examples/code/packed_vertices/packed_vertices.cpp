@@ -0,0 +1,99 @@
+#include "../example_common.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,             // width
+    720,              // height
+    4,                // MSAA samples
+    "packed_vertices" // window title / process name
+};
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    clear_scene(scene);
+
+    material_resource* default_material = get_material_resource(PEN_HASH("default_material"));
+    geometry_resource* box = get_geometry_resource(PEN_HASH("cube"));
+
+    // light
+    u32 light = get_new_entity(scene);
+    scene->names[light] = "front_light";
+    scene->id_name[light] = PEN_HASH("front_light");
+    scene->lights[light].colour = vec3f::one();
+    scene->lights[light].direction = vec3f::one();
+    scene->lights[light].type = LIGHT_TYPE_DIR;
+    scene->transforms[light].translation = vec3f::zero();
+    scene->transforms[light].rotation = quat();
+    scene->transforms[light].scale = vec3f::one();
+    scene->entities[light] |= CMP_LIGHT;
+    scene->entities[light] |= CMP_TRANSFORM;
+
+    // ground
+    u32 ground = get_new_entity(scene);
+    scene->names[ground] = "ground";
+    scene->transforms[ground].translation = vec3f::zero();
+    scene->transforms[ground].rotation = quat();
+    scene->transforms[ground].scale = vec3f(50.0f, 1.0f, 50.0f);
+    scene->entities[ground] |= CMP_TRANSFORM;
+    scene->parents[ground] = ground;
+    instantiate_geometry(box, scene, ground);
+    instantiate_material(default_material, scene, ground);
+    instantiate_model_cbuffer(scene, ground);
+
+    // static and skinned models converted to the packed formats as they load, materials pick the PACKED permutation
+    u32 model = load_pmm("data/models/lucy.pmm", scene, PMM_ALL | PMM_PACKED_VERTICES);
+    scene->transforms[model].scale = vec3f(0.07f);
+    scene->transforms[model].rotation = quat(0.0f, -M_PI / 4.0f, 0.0f);
+    scene->transforms[model].translation = vec3f(-4.0f, 0.65f, 0.0f);
+    scene->entities[model] |= CMP_TRANSFORM;
+
+    u32 skinned_char = load_pmm("data/models/characters/testcharacter/testcharacter.pmm", scene,
+                                PMM_ALL | PMM_PACKED_VERTICES);
+    PEN_ASSERT(is_valid(skinned_char));
+
+    scene->transforms[skinned_char].translation = vec3f(4.0f, 1.0f, 0.0f);
+    scene->transforms[skinned_char].scale = vec3f(0.25f);
+    scene->entities[skinned_char] |= CMP_TRANSFORM;
+
+    instantiate_anim_controller(scene, skinned_char);
+
+    anim_handle ah = load_pma("data/models/characters/testcharacter/anims/testcharacter_idle.pma");
+    bind_animation_to_rig(scene, ah, skinned_char);
+
+    scene->anim_controller[skinned_char].current_frame = 0;
+    scene->anim_controller[skinned_char].current_time = 1.0f;
+    scene->anim_controller[skinned_char].current_animation = ah;
+    scene->anim_controller[skinned_char].play_flags = cmp_anim_controller::PLAY;
+
+    scene->anim_controller_v2[skinned_char].blend.anim_a = 0;
+    scene->anim_controller_v2[skinned_char].blend.anim_b = 0;
+    scene->anim_controller_v2[skinned_char].blend.ratio = 0.0f;
+
+    const geometry_load_stats& st = get_geometry_load_stats();
+    PEN_LOG("packed vertices: %i of %i geometries, %i -> %i bytes, load %.3f ms (pack %.3f ms)\n", st.num_packed,
+            st.num_geometries, st.full_vertex_bytes, st.vertex_bytes, st.load_ms, st.pack_ms);
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    const geometry_load_stats& st = get_geometry_load_stats();
+
+    f32 kb = 1.0f / 1024.0f;
+    f32 saved = st.full_vertex_bytes ? 100.0f - (f32)st.vertex_bytes / (f32)st.full_vertex_bytes * 100.0f : 0.0f;
+
+    ImGui::Begin("Packed Vertices", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    ImGui::Text("Formats: static %i -> %i bytes, skinned %i -> %i bytes", (u32)sizeof(vertex_model),
+                (u32)sizeof(vertex_model_packed), (u32)sizeof(vertex_model_skinned),
+                (u32)sizeof(vertex_model_skinned_packed));
+
+    ImGui::Separator();
+    ImGui::Text("Geometries: %i (%i packed)", st.num_geometries, st.num_packed);
+    ImGui::Text("Vertex memory: %.1f kb full, %.1f kb packed (%.1f%% saved)", st.full_vertex_bytes * kb,
+                st.vertex_bytes * kb, saved);
+    ImGui::Text("Load (ms): %.3f, of which packing: %.3f", st.load_ms, st.pack_ms);
+
+    ImGui::End();
+}
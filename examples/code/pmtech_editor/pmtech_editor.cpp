@@ -62,6 +62,7 @@ PEN_TRV pen::user_entry(void* params)
     svr_main.name = "ces_render_scene";
     svr_main.id_name = PEN_HASH(svr_main.name.c_str());
     svr_main.render_function = &ecs::render_scene_view;
+    svr_main.thread_safe = true;
 
     put::scene_view_renderer svr_light_volumes;
     svr_light_volumes.name = "ces_render_light_volumes";
@@ -77,6 +78,7 @@ PEN_TRV pen::user_entry(void* params)
     svr_shadow_maps.name = "ces_render_shadow_maps";
     svr_shadow_maps.id_name = PEN_HASH(svr_shadow_maps.name.c_str());
     svr_shadow_maps.render_function = &ecs::render_shadow_views;
+    svr_shadow_maps.thread_safe = true;
 
     put::scene_view_renderer svr_area_light_textures;
     svr_area_light_textures.name = "ces_render_area_light_textures";
@@ -0,0 +1,145 @@
+#include "../example_common.h"
+
+#include "pmfx_render_graph.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,          // width
+    720,           // height
+    4,             // MSAA samples
+    "render_graph" // window title / process name
+};
+
+namespace
+{
+    // render_graph.jsn is a known graph: rg_unused_view writes a transient target nothing reads so it is culled,
+    // rg_half_a / rg_half_depth_a are dead by the time the b targets are written so the b targets alias them
+    const u32 k_expected_culled_views = 1;
+    const u32 k_expected_aliased_targets = 2;
+    const u32 k_expected_released_targets = 1;
+
+    struct graph_counts
+    {
+        u32 culled_views = 0;
+        u32 aliased_targets = 0;
+        u32 released_targets = 0;
+    };
+
+    graph_counts count_graph(const pmfx::render_graph& rg)
+    {
+        graph_counts gc;
+
+        u32 num_passes = sb_count(rg.passes);
+        for (u32 p = 0; p < num_passes; ++p)
+            if (!rg.passes[p].live)
+                gc.culled_views++;
+
+        u32 num_resources = sb_count(rg.resources);
+        for (u32 r = 0; r < num_resources; ++r)
+        {
+            const pmfx::rg_resource& res = rg.resources[r];
+            if (!is_valid(res.physical))
+                gc.released_targets++;
+            else if (res.physical != r)
+                gc.aliased_targets++;
+        }
+
+        return gc;
+    }
+
+    bool s_logged = false;
+} // namespace
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    pmfx::init("data/configs/render_graph.jsn");
+
+    clear_scene(scene);
+
+    material_resource* default_material = get_material_resource(PEN_HASH("default_material"));
+    geometry_resource* box_resource = get_geometry_resource(PEN_HASH("cube"));
+
+    // add light
+    u32 light = get_new_entity(scene);
+    scene->names[light] = "front_light";
+    scene->id_name[light] = PEN_HASH("front_light");
+    scene->lights[light].colour = vec3f::one();
+    scene->lights[light].direction = vec3f::one();
+    scene->lights[light].type = LIGHT_TYPE_DIR;
+    scene->transforms[light].translation = vec3f::zero();
+    scene->transforms[light].rotation = quat();
+    scene->transforms[light].scale = vec3f::one();
+    scene->entities[light] |= CMP_LIGHT;
+    scene->entities[light] |= CMP_TRANSFORM;
+
+    // ground and a few boxes
+    f32 ground_size = 50.0f;
+    u32 ground = get_new_entity(scene);
+    scene->transforms[ground].rotation = quat();
+    scene->transforms[ground].scale = vec3f(ground_size, 1.0f, ground_size);
+    scene->transforms[ground].translation = vec3f::zero();
+    scene->parents[ground] = ground;
+    scene->entities[ground] |= CMP_TRANSFORM;
+
+    instantiate_geometry(box_resource, scene, ground);
+    instantiate_material(default_material, scene, ground);
+    instantiate_model_cbuffer(scene, ground);
+
+    for (s32 i = 0; i < 5; ++i)
+    {
+        u32 box = get_new_entity(scene);
+        scene->transforms[box].rotation = quat();
+        scene->transforms[box].scale = vec3f(4.0f, 4.0f + (f32)i * 2.0f, 4.0f);
+        scene->transforms[box].translation = vec3f(-20.0f + (f32)i * 10.0f, 4.0f + (f32)i * 2.0f, 0.0f);
+        scene->parents[box] = box;
+        scene->entities[box] |= CMP_TRANSFORM;
+
+        instantiate_geometry(box_resource, scene, box);
+        instantiate_material(default_material, scene, box);
+        instantiate_model_cbuffer(scene, box);
+    }
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    // the graph is recompiled when the config is hot loaded or culling / aliasing are toggled in the dev ui
+    graph_counts gc = count_graph(pmfx::get_render_graph());
+
+    bool pass = gc.culled_views == k_expected_culled_views && gc.aliased_targets == k_expected_aliased_targets &&
+                gc.released_targets == k_expected_released_targets;
+
+    if (!s_logged)
+    {
+        dev_console_log_level(pass ? dev_ui::CONSOLE_MESSAGE : dev_ui::CONSOLE_ERROR,
+                              "[render graph] culled views %i/%i, aliased targets %i/%i, released targets %i/%i",
+                              gc.culled_views, k_expected_culled_views, gc.aliased_targets, k_expected_aliased_targets,
+                              gc.released_targets, k_expected_released_targets);
+        s_logged = true;
+    }
+
+    ImGui::Begin("Render Graph", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    ImGui::Text("Culled Views: %i (expected %i)", gc.culled_views, k_expected_culled_views);
+    ImGui::Text("Aliased Targets: %i (expected %i)", gc.aliased_targets, k_expected_aliased_targets);
+    ImGui::Text("Released Targets: %i (expected %i)", gc.released_targets, k_expected_released_targets);
+    ImGui::TextColored(pass ? ImVec4(0.0f, 1.0f, 0.0f, 1.0f) : ImVec4(1.0f, 0.0f, 0.0f, 1.0f), pass ? "Pass" : "Fail");
+
+    // aliased targets share a handle, so both show whichever view wrote last
+    static hash_id id_targets[] = {PEN_HASH("rg_half_a"), PEN_HASH("rg_half_b")};
+    for (hash_id id : id_targets)
+    {
+        const pmfx::render_target* rt = pmfx::get_render_target(id);
+        if (!rt || !is_valid(rt->handle))
+            continue;
+
+        f32 w, h;
+        pmfx::get_render_target_dimensions(rt, w, h);
+        ImGui::Image(IMG(rt->handle), ImVec2(w / 2.0f, h / 2.0f));
+        ImGui::SameLine();
+    }
+    ImGui::NewLine();
+
+    ImGui::End();
+}
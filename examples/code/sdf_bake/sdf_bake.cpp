@@ -0,0 +1,207 @@
+#include "../example_common.h"
+
+#include "sdf_baker.h"
+#include "sdf_gen/makelevelset3.h"
+
+#include <vector>
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,      // width
+    720,       // height
+    4,         // MSAA samples
+    "sdf_bake" // window title / process name
+};
+
+namespace
+{
+    const u32 k_dims[] = {32, 64, 128};
+    const u32 k_max_reference_dim = 64; // make_level_set3 is single threaded, larger grids take too long to compare
+
+    struct bake_result
+    {
+        const c8*       name;
+        u32             dim;
+        sdf::bake_stats stats;
+        f32             reference_ms;
+        f32             max_diff; // against make_level_set3, which is only exact in a band around the surface
+        u32             sign_mismatch;
+    };
+    bake_result* s_results = nullptr;
+
+    void benchmark_model(ecs_scene* scene, const c8* name, u32 start, u32 end)
+    {
+        sdf::bake_mesh mesh;
+
+        // model space, no gpu work so the timings are just the bake
+        mat4 identity = mat4::create_identity();
+        for (u32 n = start; n < end; ++n)
+        {
+            if (!(scene->entities[n] & CMP_GEOMETRY))
+                continue;
+
+            sdf::add_geometry(mesh, get_geometry_resource(scene->id_geometry[n]), identity);
+        }
+
+        u32 num_verts = sb_count(mesh.vertices);
+        if (num_verts == 0)
+            return;
+
+        vec3f emin = vec3f(FLT_MAX);
+        vec3f emax = vec3f(-FLT_MAX);
+        for (u32 i = 0; i < num_verts; ++i)
+        {
+            emin = min_union(emin, mesh.vertices[i]);
+            emax = max_union(emax, mesh.vertices[i]);
+        }
+
+        // cube grid around the bounds with 10% padding each side, fitted the same way as the volume generator
+        vec3f size = (emax - emin) * 1.2f;
+        vec3f centre = emin + (emax - emin) * 0.5f;
+
+        std::vector<vec3f>  ref_vertices(mesh.vertices, mesh.vertices + num_verts);
+        std::vector<vec3ui> ref_triangles;
+        for (u32 i = 0; i < sb_count(mesh.indices); i += 3)
+            ref_triangles.push_back(vec3ui(mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]));
+
+        for (u32 d = 0; d < PEN_ARRAY_SIZE(k_dims); ++d)
+        {
+            u32 dim = k_dims[d];
+
+            sdf::bake_params bp;
+            bp.mesh = &mesh;
+            bp.dx = component_wise_max(size) / (f32)dim;
+            bp.origin = centre - vec3f(component_wise_max(size) / 2.0f);
+            bp.nx = dim;
+            bp.ny = dim;
+            bp.nz = dim;
+            bp.sign_mode = sdf::SIGN_PARITY;
+
+            f32* phi = (f32*)pen::memory_alloc(dim * dim * dim * sizeof(f32));
+
+            bake_result r;
+            r.name = name;
+            r.dim = dim;
+            r.reference_ms = 0.0f;
+            r.max_diff = 0.0f;
+            r.sign_mismatch = 0;
+
+            sdf::bake(bp, phi, &r.stats);
+
+            if (dim <= k_max_reference_dim)
+            {
+                Array3f ref_phi;
+
+                f32 ref_start = pen::get_time_ms();
+                make_level_set3(ref_triangles, ref_vertices, bp.origin, bp.dx, dim, dim, dim, ref_phi);
+                r.reference_ms = pen::get_time_ms() - ref_start;
+
+                for (u32 z = 0; z < dim; ++z)
+                {
+                    for (u32 y = 0; y < dim; ++y)
+                    {
+                        for (u32 x = 0; x < dim; ++x)
+                        {
+                            f32 a = phi[z * dim * dim + y * dim + x];
+                            f32 b = ref_phi(x, y, z);
+
+                            r.max_diff = std::max(r.max_diff, fabs(fabs(a) - fabs(b)));
+                            if ((a < 0.0f) != (b < 0.0f))
+                                ++r.sign_mismatch;
+                        }
+                    }
+                }
+            }
+
+            pen::memory_free(phi);
+
+            PEN_LOG("sdf bake: %s %i^3, %i triangles, %.2f ms (bvh %.2f, distance %.2f, sign %.2f), "
+                    "make_level_set3 %.2f ms, max diff %.4f, sign mismatches %i\n",
+                    name, dim, r.stats.num_triangles, r.stats.total_ms, r.stats.build_ms, r.stats.distance_ms,
+                    r.stats.sign_ms, r.reference_ms, r.max_diff, r.sign_mismatch);
+
+            sb_push(s_results, r);
+        }
+
+        sdf::free_mesh(mesh);
+    }
+} // namespace
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    clear_scene(scene);
+
+    u32 lucy = load_pmm("data/models/lucy.pmm", scene);
+    u32 head = load_pmm("data/models/head_smooth.pmm", scene);
+    u32 end = scene->num_entities;
+
+    // bakes run here on load with the worker pool, the window only shows the results
+    benchmark_model(scene, "lucy", lucy, head);
+    benchmark_model(scene, "head_smooth", head, end);
+
+    scene->transforms[lucy].scale = vec3f(0.07f);
+    scene->transforms[lucy].rotation = quat(0.0f, -M_PI / 4.0f, 0.0f);
+    scene->transforms[lucy].translation = vec3f(-4.0f, 0.65f, 0.0f);
+    scene->entities[lucy] |= CMP_TRANSFORM;
+
+    scene->transforms[head].translation = vec3f(4.0f, 4.0f, 0.0f);
+    scene->entities[head] |= CMP_TRANSFORM;
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    ImGui::Begin("SDF Bake", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    ImGui::Text("Workers: %i + calling thread, sse: %s", pen::jobs_get_num_workers(), PEN_SSE ? "yes" : "no");
+    ImGui::Separator();
+
+    ImGui::Columns(6);
+    ImGui::Text("Model");
+    ImGui::NextColumn();
+    ImGui::Text("Grid");
+    ImGui::NextColumn();
+    ImGui::Text("Bake (ms)");
+    ImGui::NextColumn();
+    ImGui::Text("make_level_set3 (ms)");
+    ImGui::NextColumn();
+    ImGui::Text("Max Diff");
+    ImGui::NextColumn();
+    ImGui::Text("Sign Mismatch");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (u32 i = 0; i < sb_count(s_results); ++i)
+    {
+        const bake_result& r = s_results[i];
+
+        ImGui::Text("%s", r.name);
+        ImGui::NextColumn();
+        ImGui::Text("%i^3", r.dim);
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", r.stats.total_ms);
+        ImGui::NextColumn();
+
+        if (r.reference_ms > 0.0f)
+        {
+            ImGui::Text("%.2f", r.reference_ms);
+            ImGui::NextColumn();
+            ImGui::Text("%.4f", r.max_diff);
+            ImGui::NextColumn();
+            ImGui::Text("%i", r.sign_mismatch);
+            ImGui::NextColumn();
+        }
+        else
+        {
+            for (u32 c = 0; c < 3; ++c)
+            {
+                ImGui::Text("-");
+                ImGui::NextColumn();
+            }
+        }
+    }
+
+    ImGui::Columns(1);
+    ImGui::End();
+}
@@ -0,0 +1,215 @@
+#include "../example_common.h"
+
+#include "ecs/ecs_anim_compression.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,            // width
+    720,             // height
+    4,               // MSAA samples
+    "skinning_crowd" // window title / process name
+};
+
+namespace
+{
+    const u32 k_crowd_dim = 16;
+    const u32 k_history = 120;
+
+    u32  s_num_characters = 0;
+    u32  s_num_samples = 0;
+    bool s_compressed = false;
+
+    f32 s_history[k_history] = {0};
+    u32 s_history_pos = 0;
+    f32 s_min_ms = FLT_MAX;
+    f32 s_max_ms = 0.0f;
+
+    anim_handle            s_anims[2];
+    anim_compression_stats s_stats[2];
+} // namespace
+
+void example_setup(ecs_scene* scene, camera& cam)
+{
+    clear_scene(scene);
+
+    material_resource* default_material = get_material_resource(PEN_HASH("default_material"));
+
+    geometry_resource* box = get_geometry_resource(PEN_HASH("cube"));
+
+    // add light
+    u32 light = get_new_entity(scene);
+    scene->names[light] = "front_light";
+    scene->id_name[light] = PEN_HASH("front_light");
+    scene->lights[light].colour = vec3f::one();
+    scene->lights[light].direction = vec3f::one();
+    scene->lights[light].type = LIGHT_TYPE_DIR;
+    scene->transforms[light].translation = vec3f::zero();
+    scene->transforms[light].rotation = quat();
+    scene->transforms[light].scale = vec3f::one();
+    scene->entities[light] |= CMP_LIGHT;
+    scene->entities[light] |= CMP_TRANSFORM;
+
+    // ground
+    u32 ground = get_new_entity(scene);
+    scene->names[ground] = "ground";
+    scene->transforms[ground].translation = vec3f::zero();
+    scene->transforms[ground].rotation = quat();
+    scene->transforms[ground].scale = vec3f(50.0f, 1.0f, 50.0f);
+    scene->entities[ground] |= CMP_TRANSFORM;
+    scene->parents[ground] = ground;
+    instantiate_geometry(box, scene, ground);
+    instantiate_material(default_material, scene, ground);
+    instantiate_model_cbuffer(scene, ground);
+
+    anim_handle idle = load_pma("data/models/characters/testcharacter/anims/testcharacter_idle.pma");
+    anim_handle walk = load_pma("data/models/characters/testcharacter/anims/testcharacter_walk.pma");
+
+    // compressed versions of the clips, instances switch between them in example_update
+    s_anims[0] = idle;
+    s_anims[1] = walk;
+
+    anim_compression_params params;
+    for (u32 i = 0; i < 2; ++i)
+    {
+        animation_resource* anim = get_animation_resource(s_anims[i]);
+        anim->compressed = compress_anim(anim->soa, anim->length, params, &s_stats[i]);
+    }
+
+    // grid of characters each with 2 anims blending at different ratios
+    f32 spacing = 3.0f;
+    f32 half = (k_crowd_dim - 1) * spacing * 0.5f;
+
+    for (u32 i = 0; i < k_crowd_dim; ++i)
+    {
+        for (u32 j = 0; j < k_crowd_dim; ++j)
+        {
+            u32 skinned_char = load_pmm("data/models/characters/testcharacter/testcharacter.pmm", scene);
+            PEN_ASSERT(is_valid(skinned_char));
+
+            scene->transforms[skinned_char].translation = vec3f(i * spacing - half, 1.0f, j * spacing - half);
+            scene->transforms[skinned_char].scale = vec3f(0.25f);
+            scene->entities[skinned_char] |= CMP_TRANSFORM;
+
+            instantiate_anim_controller(scene, skinned_char);
+
+            bind_animation_to_rig(scene, idle, skinned_char);
+            bind_animation_to_rig(scene, walk, skinned_char);
+
+            cmp_anim_controller_v2& controller = scene->anim_controller_v2[skinned_char];
+            controller.blend.anim_a = 0;
+            controller.blend.anim_b = 1;
+            controller.blend.ratio = (f32)((i + j) % k_crowd_dim) / (f32)k_crowd_dim;
+
+            // offset start times so the crowd is not in lock step
+            u32 num_anims = sb_count(controller.anim_instances);
+            for (u32 a = 0; a < num_anims; ++a)
+            {
+                anim_instance& instance = controller.anim_instances[a];
+                instance.time = fmod((i * k_crowd_dim + j) * 0.137f, instance.length);
+                instance.compressed = nullptr;
+            }
+
+            for (u32 a = 0; a < num_anims; ++a)
+                s_num_samples += controller.anim_instances[a].soa.num_channels;
+
+            ++s_num_characters;
+        }
+    }
+
+    // animations are updated manually in example_update so they can be timed
+    scene->flags |= PAUSE_UPDATE;
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    static pen::timer* anim_timer = pen::timer_create();
+
+    pen::timer_start(anim_timer);
+    update_animations(scene, dt);
+    f32 ms = pen::timer_elapsed_ms(anim_timer);
+
+    s_history[s_history_pos] = ms;
+    s_history_pos = (s_history_pos + 1) % k_history;
+    s_min_ms = min(s_min_ms, ms);
+    s_max_ms = max(s_max_ms, ms);
+
+    f32 avg = 0.0f;
+    for (u32 i = 0; i < k_history; ++i)
+        avg += s_history[i];
+    avg /= (f32)k_history;
+
+    ImGui::Begin("Crowd Animation");
+    ImGui::Text("Characters: %i", s_num_characters);
+    ImGui::Text("Workers: %i", pen::jobs_get_num_workers() + 1);
+    ImGui::Text("Update (ms): avg %.3f, min %.3f, max %.3f", avg, s_min_ms, s_max_ms);
+    ImGui::Text("Throughput: %.0f channel samples / ms", avg > 0.0f ? (f32)s_num_samples / avg : 0.0f);
+
+    ImGui::Separator();
+
+    if (ImGui::Checkbox("Compressed Clips", &s_compressed))
+    {
+        for (u32 n = 0; n < scene->num_entities; ++n)
+        {
+            if (!(scene->entities[n] & CMP_ANIM_CONTROLLER))
+                continue;
+
+            cmp_anim_controller_v2& controller = scene->anim_controller_v2[n];
+
+            u32 num_anims = sb_count(controller.anim_instances);
+            for (u32 a = 0; a < num_anims; ++a)
+            {
+                animation_resource* anim = get_animation_resource(s_anims[a]);
+                controller.anim_instances[a].compressed = s_compressed ? anim->compressed : nullptr;
+            }
+        }
+
+        s_min_ms = FLT_MAX;
+        s_max_ms = 0.0f;
+    }
+
+    ImGui::Separator();
+
+    // anim lod
+    anim_lod_params&      lp = scene->anim_lod;
+    const anim_lod_stats& st = scene->anim_stats;
+
+    static const c8* k_lod_names[] = {"lod 0", "lod 1", "lod 2", "culled"};
+
+    ImGui::Checkbox("Anim LOD", &lp.enabled);
+    ImGui::SliderFloat("Lod 0 Screen Size", &lp.min_screen_size[ANIM_LOD_0], 0.0f, 1.0f);
+    ImGui::SliderFloat("Lod 1 Screen Size", &lp.min_screen_size[ANIM_LOD_1], 0.0f, 1.0f);
+    ImGui::InputInt4("Update Intervals", (s32*)&lp.update_interval[0]);
+    ImGui::SliderInt("Skip Leaf Joints Lod", (s32*)&lp.skip_leaf_joints_lod, 0, ANIM_LOD_COUNT);
+
+    for (u32 l = 0; l < ANIM_LOD_COUNT; ++l)
+        ImGui::Text("%s: %i", k_lod_names[l], st.controllers[l]);
+
+    ImGui::Text("Updated: %i, Throttled: %i", st.updated, st.throttled);
+    ImGui::Text("Joints Sampled: %i, Skipped: %i", st.joints_sampled, st.joints_skipped);
+    ImGui::Text("Palettes Built: %i, Skipped: %i", st.palettes_built, st.palettes_skipped);
+
+    ImGui::Separator();
+
+    for (u32 i = 0; i < 2; ++i)
+    {
+        animation_resource*           anim = get_animation_resource(s_anims[i]);
+        const anim_compression_stats& cs = s_stats[i];
+
+        ImGui::Text("%s", anim->name.c_str());
+        ImGui::Text("    memory: %i bytes -> %i bytes (%.1f%%)", (s32)cs.raw_bytes, (s32)cs.compressed_bytes,
+                    cs.raw_bytes ? 100.0f * (f32)cs.compressed_bytes / (f32)cs.raw_bytes : 0.0f);
+        ImGui::Text("    keys: %i -> %i, constant tracks: %i, animated tracks: %i", cs.raw_keys, cs.compressed_keys,
+                    cs.constant_tracks, cs.animated_tracks);
+    }
+    ImGui::PlotLines("", &s_history[0], k_history, s_history_pos, nullptr, 0.0f, s_max_ms, ImVec2(300, 60));
+
+    if (ImGui::Button("Reset"))
+    {
+        s_min_ms = FLT_MAX;
+        s_max_ms = 0.0f;
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,158 @@
+#include "../example_common.h"
+
+#include "voxeliser.h"
+
+using namespace put;
+using namespace ecs;
+
+pen::window_creation_params pen_window{
+    1280,      // width
+    720,       // height
+    4,         // MSAA samples
+    "voxelise" // window title / process name
+};
+
+namespace
+{
+    const u32 k_dims[] = {32, 64, 128, 256};
+
+    struct voxelise_result
+    {
+        const c8*             name;
+        u32                   dim;
+        voxel::voxelise_stats stats;
+        u32                   num_occupied;
+    };
+    voxelise_result* s_results = nullptr;
+
+    void benchmark_model(ecs_scene* scene, const c8* name, u32 start, u32 end)
+    {
+        voxel::voxel_mesh mesh;
+
+        // model space, no gpu work so the timings are just the voxelise
+        mat4 identity = mat4::create_identity();
+        for (u32 n = start; n < end; ++n)
+        {
+            if (!(scene->entities[n] & CMP_GEOMETRY))
+                continue;
+
+            voxel::add_geometry(mesh, get_geometry_resource(scene->id_geometry[n]), identity, vec4f::one());
+        }
+
+        u32 num_verts = sb_count(mesh.vertices);
+        if (num_verts == 0)
+            return;
+
+        vec3f emin = vec3f(FLT_MAX);
+        vec3f emax = vec3f(-FLT_MAX);
+        for (u32 i = 0; i < num_verts; ++i)
+        {
+            emin = min_union(emin, mesh.vertices[i]);
+            emax = max_union(emax, mesh.vertices[i]);
+        }
+
+        for (u32 d = 0; d < PEN_ARRAY_SIZE(k_dims); ++d)
+        {
+            u32 dim = k_dims[d];
+
+            // bounds with a texel border, fitted the same way as the volume generator
+            f32   border = component_wise_max(emax - emin) / dim;
+            vec3f vmin = emin - vec3f(border);
+            vec3f vmax = emax + vec3f(border);
+
+            voxel::voxelise_params vp;
+            vp.mesh = &mesh;
+            vp.origin = vmin;
+            vp.cell = (vmax - vmin) / (f32)dim;
+            vp.nx = dim;
+            vp.ny = dim;
+            vp.nz = dim;
+
+            u8* volume = (u8*)pen::memory_alloc(dim * dim * dim * 4);
+
+            voxelise_result r;
+            r.name = name;
+            r.dim = dim;
+            r.num_occupied = 0;
+
+            voxel::voxelise(vp, volume, &r.stats);
+
+            for (u32 i = 0; i < dim * dim * dim; ++i)
+                if (volume[i * 4 + 3])
+                    ++r.num_occupied;
+
+            pen::memory_free(volume);
+
+            PEN_LOG("voxelise: %s %i^3, %i triangles, %.2f ms (bin %.2f, voxelise %.2f, dilate %.2f), "
+                    "%i voxels, %i of %i bricks\n",
+                    name, dim, r.stats.num_triangles, r.stats.total_ms, r.stats.bin_ms, r.stats.voxelise_ms,
+                    r.stats.dilate_ms, r.num_occupied, r.stats.num_occupied_bricks, r.stats.num_bricks);
+
+            sb_push(s_results, r);
+        }
+
+        voxel::free_mesh(mesh);
+    }
+} // namespace
+
+void example_setup(ecs::ecs_scene* scene, camera& cam)
+{
+    clear_scene(scene);
+
+    u32 lucy = load_pmm("data/models/lucy.pmm", scene);
+    u32 head = load_pmm("data/models/head_smooth.pmm", scene);
+    u32 end = scene->num_entities;
+
+    // voxelised here on load with the worker pool, the window only shows the results
+    benchmark_model(scene, "lucy", lucy, head);
+    benchmark_model(scene, "head_smooth", head, end);
+
+    scene->transforms[lucy].scale = vec3f(0.07f);
+    scene->transforms[lucy].rotation = quat(0.0f, -M_PI / 4.0f, 0.0f);
+    scene->transforms[lucy].translation = vec3f(-4.0f, 0.65f, 0.0f);
+    scene->entities[lucy] |= CMP_TRANSFORM;
+
+    scene->transforms[head].translation = vec3f(4.0f, 4.0f, 0.0f);
+    scene->entities[head] |= CMP_TRANSFORM;
+}
+
+void example_update(ecs::ecs_scene* scene, camera& cam, f32 dt)
+{
+    ImGui::Begin("Voxelise", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    ImGui::Text("Workers: %i + calling thread", pen::jobs_get_num_workers());
+    ImGui::Text("GPU slices read back 6 x dim^3 texels before combining, the cpu path writes dim^3 once");
+    ImGui::Separator();
+
+    ImGui::Columns(5);
+    ImGui::Text("Model");
+    ImGui::NextColumn();
+    ImGui::Text("Grid");
+    ImGui::NextColumn();
+    ImGui::Text("Voxelise (ms)");
+    ImGui::NextColumn();
+    ImGui::Text("Occupied Voxels");
+    ImGui::NextColumn();
+    ImGui::Text("Occupied Bricks");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (u32 i = 0; i < sb_count(s_results); ++i)
+    {
+        const voxelise_result& r = s_results[i];
+
+        ImGui::Text("%s", r.name);
+        ImGui::NextColumn();
+        ImGui::Text("%i^3", r.dim);
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", r.stats.total_ms);
+        ImGui::NextColumn();
+        ImGui::Text("%i", r.num_occupied);
+        ImGui::NextColumn();
+        ImGui::Text("%i / %i", r.stats.num_occupied_bricks, r.stats.num_bricks);
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+    ImGui::End();
+}
@@ -50,6 +50,18 @@ create_app_example( "shadow_maps", script_path() )
 create_app_example( "cubemap", script_path() )
 create_app_example( "texture_formats", script_path() )
 create_app_example( "skinning", script_path() )
+create_app_example( "skinning_crowd", script_path() )
+create_app_example( "ecs_chunks", script_path() )
+create_app_example( "clustered_lights", script_path() )
+create_app_example( "occlusion_culling", script_path() )
+create_app_example( "mesh_lods", script_path() )
+create_app_example( "packed_vertices", script_path() )
+create_app_example( "mesh_optimise", script_path() )
+create_app_example( "dynamic_resolution", script_path() )
+create_app_example( "sdf_bake", script_path() )
+create_app_example( "voxelise", script_path() )
+create_app_example( "mip_generation", script_path() )
+create_app_example( "audio_mixer", script_path() )
 create_app_example( "vertex_stream_out", script_path() )
 create_app_example( "volume_texture", script_path() )
 create_app_example( "multiple_render_targets", script_path() )
@@ -69,3 +81,4 @@ create_app_example( "ik", script_path() )
 create_app_example( "stencil_shadows", script_path() )
 create_app_example( "msaa_resolve", script_path() )
 create_app_example( "compute_demo", script_path() )
+create_app_example( "render_graph", script_path() )
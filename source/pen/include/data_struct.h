@@ -162,6 +162,35 @@ namespace pen
         void grow(size_t size);
     };
 
+    // lockless single producer single consumer - triple buffered arrays, the producer publishes its back buffer and the
+    // consumer acquires the latest published one. neither side waits and the consumer's array is never written
+    template <typename T>
+    struct triple_array_buffer
+    {
+        T*     _data[3] = {0};
+        size_t _capacity[3] = {0};
+        u32    _bb; // producer
+        u32    _fb; // consumer
+        a_u32  _ready;
+
+        triple_array_buffer();
+        ~triple_array_buffer();
+
+        // producer
+        T*     backbuffer();
+        u32    backbuffer_index();
+        size_t backbuffer_capacity();
+        void   grow(size_t size);
+        void   publish();
+
+        // consumer, acquire returns true if a newer array was taken
+        bool     acquire();
+        const T* frontbuffer();
+        size_t   frontbuffer_capacity();
+
+        void init(size_t size);
+    };
+
     // multiple producer, multiple consumer buffer - partially lock-free but will lock when re-sizing.
     template <typename T>
     struct mpmc_stretchy_buffer
@@ -407,6 +436,93 @@ namespace pen
         _capacity[_bb] = size;
     }
 
+    // bit set in _ready while the published array has not been acquired
+    static const u32 k_triple_buffer_new = 1 << 2;
+
+    template <typename T>
+    pen_inline triple_array_buffer<T>::triple_array_buffer()
+    {
+        _bb = 0;
+        _fb = 1;
+        _ready = 2;
+    }
+
+    template <typename T>
+    pen_inline triple_array_buffer<T>::~triple_array_buffer()
+    {
+        for (u32 i = 0; i < 3; ++i)
+            pen::memory_free(_data[i]);
+    }
+
+    template <typename T>
+    pen_inline T* triple_array_buffer<T>::backbuffer()
+    {
+        return _data[_bb];
+    }
+
+    template <typename T>
+    pen_inline u32 triple_array_buffer<T>::backbuffer_index()
+    {
+        return _bb;
+    }
+
+    template <typename T>
+    pen_inline size_t triple_array_buffer<T>::backbuffer_capacity()
+    {
+        return _capacity[_bb];
+    }
+
+    template <typename T>
+    pen_inline void triple_array_buffer<T>::grow(size_t size)
+    {
+        size_t cur = _capacity[_bb];
+        if (cur >= size)
+            return;
+
+        _data[_bb] = (T*)pen::memory_realloc(_data[_bb], sizeof(T) * size);
+        memset(&_data[_bb][cur], 0x00, sizeof(T) * (size - cur));
+        _capacity[_bb] = size;
+    }
+
+    template <typename T>
+    pen_inline void triple_array_buffer<T>::publish()
+    {
+        _bb = _ready.exchange(_bb | k_triple_buffer_new) & ~k_triple_buffer_new;
+    }
+
+    template <typename T>
+    pen_inline bool triple_array_buffer<T>::acquire()
+    {
+        if (!(_ready.load() & k_triple_buffer_new))
+            return false;
+
+        _fb = _ready.exchange(_fb) & ~k_triple_buffer_new;
+        return true;
+    }
+
+    template <typename T>
+    pen_inline const T* triple_array_buffer<T>::frontbuffer()
+    {
+        return _data[_fb];
+    }
+
+    template <typename T>
+    pen_inline size_t triple_array_buffer<T>::frontbuffer_capacity()
+    {
+        return _capacity[_fb];
+    }
+
+    template <typename T>
+    pen_inline void triple_array_buffer<T>::init(size_t size)
+    {
+        for (u32 i = 0; i < 3; ++i)
+        {
+            _data[i] = (T*)pen::memory_alloc(sizeof(T) * size);
+            memset(_data[i], 0x00, sizeof(T) * size);
+            _capacity[i] = size;
+        }
+    }
+
     template <typename T>
     pen_inline void mpmc_stretchy_buffer<T>::push_back(T item)
     {
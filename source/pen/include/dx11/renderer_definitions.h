@@ -99,7 +99,9 @@ enum vertex_format : s32
     PEN_VERTEX_FORMAT_FLOAT4 = DXGI_FORMAT_R32G32B32A32_FLOAT,
     PEN_VERTEX_FORMAT_UNORM4 = DXGI_FORMAT_R8G8B8A8_UNORM,
     PEN_VERTEX_FORMAT_UNORM2 = DXGI_FORMAT_R8G8_UNORM,
-    PEN_VERTEX_FORMAT_UNORM1 = DXGI_FORMAT_R8_UNORM
+    PEN_VERTEX_FORMAT_UNORM1 = DXGI_FORMAT_R8_UNORM,
+    PEN_VERTEX_FORMAT_SNORM16_4 = DXGI_FORMAT_R16G16B16A16_SNORM,
+    PEN_VERTEX_FORMAT_HALF4 = DXGI_FORMAT_R16G16B16A16_FLOAT
 };
 
 enum index_buffer_format : s32
@@ -131,7 +131,9 @@ enum vertex_format : s32
     PEN_VERTEX_FORMAT_FLOAT4 = PACK_GL_FORMAT(GL_FLOAT, 4),
     PEN_VERTEX_FORMAT_UNORM4 = PACK_GL_FORMAT(GL_UNSIGNED_BYTE, 4),
     PEN_VERTEX_FORMAT_UNORM2 = PACK_GL_FORMAT(GL_UNSIGNED_BYTE, 2),
-    PEN_VERTEX_FORMAT_UNORM1 = PACK_GL_FORMAT(GL_UNSIGNED_BYTE, 1)
+    PEN_VERTEX_FORMAT_UNORM1 = PACK_GL_FORMAT(GL_UNSIGNED_BYTE, 1),
+    PEN_VERTEX_FORMAT_SNORM16_4 = PACK_GL_FORMAT(GL_SHORT, 4),
+    PEN_VERTEX_FORMAT_HALF4 = PACK_GL_FORMAT(GL_HALF_FLOAT, 4)
 };
 
 enum index_buffer_format : s32
@@ -42,4 +42,11 @@ namespace pen
 #define pen_debug_break __builtin_trap()
 #endif
 
+// simd.. sse2 is available on all x64 targets, other architectures use scalar fallbacks
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define PEN_SSE 1
+#else
+#define PEN_SSE 0
+#endif
+
 #endif
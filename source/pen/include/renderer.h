@@ -51,7 +51,8 @@ namespace pen
     {
         BACK_BUFFER_RATIO = (u32)-1,
         MAX_MRT = 8,
-        CUBEMAP_FACES = 6
+        CUBEMAP_FACES = 6,
+        CBUFFER_RANGE_ALIGNMENT = 256 // offset alignment for renderer_set_constant_buffer_range
     };
 
     enum e_clear_types
@@ -66,7 +67,11 @@ namespace pen
         RESOURCE_VERTEX_SHADER,
         RESOURCE_PIXEL_SHADER,
         RESOURCE_BUFFER,
-        RESOURCE_RENDER_TARGET
+        RESOURCE_RENDER_TARGET,
+        RESOURCE_SAMPLER_STATE,
+        RESOURCE_RASTER_STATE,
+        RESOURCE_BLEND_STATE,
+        RESOURCE_DEPTH_STENCIL_STATE
     };
 
     struct mrt_clear
@@ -391,9 +396,38 @@ namespace pen
 
     void renderer_set_index_buffer(u32 buffer_index, u32 format, u32 offset);
     void renderer_set_constant_buffer(u32 buffer_index, u32 resource_slot, u32 flags);
+    void renderer_set_constant_buffer_range(u32 buffer_index, u32 resource_slot, u32 flags, u32 offset, u32 size);
     void renderer_set_structured_buffer(u32 buffer_index, u32 resource_slot, u32 flags);
+
+    // an update at offset 0 may discard the rest of a dynamic buffer, updates at other offsets keep it and must not
+    // overwrite data the gpu could still be reading.
     void renderer_update_buffer(u32 buffer_index, const void* data, u32 data_size, u32 offset = 0);
 
+    // transient streaming
+    // Per frame vertex and index data written straight into ring memory owned by the renderer, for immediate mode
+    // geometry that changes every frame (debug primitives, ui). Write into data, commit the bytes written and then bind
+    // buffer at offset to draw. Commits are uploaded in order with the other commands, so draws issued after a commit
+    // see it, there is no copy into the command buffer and nothing is recreated when usage grows, the ring adds pages
+    // as it needs them and keeps them. Allocations are valid until renderer_consume_cmd_buffer.
+    struct stream_alloc
+    {
+        void* data = nullptr;
+        u32   buffer = 0; // bind with renderer_set_vertex_buffer or renderer_set_index_buffer
+        u32   offset = 0; // byte offset into buffer, a multiple of STREAM_ALIGNMENT
+        u32   size = 0;
+        u64   frame = 0; // renderer_stream_frame at allocation
+    };
+
+    enum stream_constants
+    {
+        STREAM_ALIGNMENT = 16,
+        STREAM_PAGE_SIZE = 1024 * 1024 // allocations larger than a page get a page of their own
+    };
+
+    stream_alloc renderer_stream_alloc(u32 bind_flags, u32 size); // PEN_BIND_VERTEX_BUFFER or PEN_BIND_INDEX_BUFFER
+    void         renderer_stream_commit(const stream_alloc& sa, u32 offset, u32 size); // offset within the allocation
+    u64          renderer_stream_frame(); // increments every renderer_consume_cmd_buffer
+
     // textures
     u32  renderer_create_texture(const texture_creation_params& tcp);
     u32  renderer_create_sampler(const sampler_creation_params& scp);
@@ -452,6 +486,17 @@ namespace pen
     void renderer_release_sampler(u32 sampler);
     void renderer_release_depth_stencil_state(u32 depth_stencil_state);
 
+    // command lists
+    // Commands issued by a thread between begin and end are recorded into the list instead of the render thread's
+    // queue, lists can be recorded concurrently on worker threads and are appended to the queue in order on submit.
+    // Recording threads may set state, update buffers and draw.. resources must be created and released by the
+    // user thread. Lists are created and submitted by the user thread and are reset after submit.
+    u32  renderer_create_cmd_list();
+    void renderer_begin_cmd_list(u32 cmd_list);
+    void renderer_end_cmd_list();
+    void renderer_submit_cmd_list(u32 cmd_list);
+    u32  renderer_get_cmd_list_size(u32 cmd_list);
+
     // cmd specific
     void renderer_window_resize(s32 width, s32 height);
     void renderer_consume_cmd_buffer();
@@ -484,6 +529,7 @@ namespace pen
                                          const u32* offsets);
         void renderer_set_index_buffer(u32 buffer_index, u32 format, u32 offset);
         void renderer_set_constant_buffer(u32 buffer_index, u32 resource_slot, u32 flags);
+        void renderer_set_constant_buffer_range(u32 buffer_index, u32 resource_slot, u32 flags, u32 offset, u32 size);
         void renderer_set_structured_buffer(u32 buffer_index, u32 resource_slot, u32 flags);
         void renderer_update_buffer(u32 buffer_index, const void* data, u32 data_size, u32 offset);
 
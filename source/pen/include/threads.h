@@ -24,6 +24,7 @@ namespace pen
     struct semaphore;
 
     typedef void (*completion_callback)(void*);
+    typedef void (*job_range_callback)(u32 start, u32 end, void* user_data);
 
     // A Job is just a thread with some user data, a callback
     // and some syncronisation semaphores
@@ -79,6 +80,14 @@ namespace pen
     job* jobs_create_job(PEN_THREAD_ROUTINE(thread_func), u32 stack_size, void* user_data, thread_start_flags flags,
                          completion_callback cb = nullptr);
 
+    // Workers
+    // A small pool of persistent worker threads which split a range [0, count) into chunks of grain size.
+    // The calling thread participates and jobs_parallel_for returns once the whole range has been processed.
+    // Nested or concurrent calls while the pool is busy execute serially on the calling thread.
+    void jobs_create_workers(u32 num_workers = 0); // 0 = hardware concurrency - 1
+    u32  jobs_get_num_workers();
+    void jobs_parallel_for(u32 count, u32 grain, job_range_callback cb, void* user_data);
+
     // Mutex
     mutex* mutex_create();
     void   mutex_destroy(mutex* p_mutex);
@@ -139,4 +139,43 @@ inline f16 float_to_half(f32 f)
     return v.ui | sign;
 }
 
+inline f32 half_to_float(f16 h)
+{
+    union bits {
+        float    f;
+        int32_t  si;
+        uint32_t ui;
+    };
+
+    static int const     shift = 13;
+    static int const     shift_sign = 16;
+    static int32_t const infN = 0x7F800000; // flt32 infinity
+    static int32_t const maxN = 0x477FE000; // max flt16 normal as a flt32
+    static int32_t const minN = 0x38800000; // min flt16 normal as a flt32
+    static int32_t const infC = infN >> shift;
+    static int32_t const maxC = maxN >> shift;
+    static int32_t const minC = minN >> shift;
+    static int32_t const signC = 0x8000;    // flt16 sign bit
+    static int32_t const mulC = 0x33800000; // minN / (1 << (23 - shift))
+    static int32_t const subC = 0x003FF;    // max flt32 subnormal down shifted
+    static int32_t const norC = 0x00400;    // min flt32 normal down shifted
+    static int32_t const maxD = infC - maxC - 1;
+    static int32_t const minD = minC - subC - 1;
+
+    bits v, s;
+    v.ui = h;
+    int32_t sign = v.si & signC;
+    v.si ^= sign;
+    sign <<= shift_sign;
+    v.si ^= ((v.si + minD) ^ v.si) & -(v.si > subC);
+    v.si ^= ((v.si + maxD) ^ v.si) & -(v.si > maxC);
+    s.si = mulC;
+    s.f *= v.si; // correct subnormals
+    int32_t mask = -(norC > v.si);
+    v.si <<= shift;
+    v.si ^= (s.si ^ v.si) & mask;
+    v.si |= sign;
+    return v.f;
+}
+
 #endif //_pen_types_h
@@ -96,7 +96,9 @@ enum vertex_format : s32
     PEN_VERTEX_FORMAT_FLOAT4,
     PEN_VERTEX_FORMAT_UNORM4,
     PEN_VERTEX_FORMAT_UNORM2,
-    PEN_VERTEX_FORMAT_UNORM1
+    PEN_VERTEX_FORMAT_UNORM1,
+    PEN_VERTEX_FORMAT_SNORM16_4,
+    PEN_VERTEX_FORMAT_HALF4
 };
 
 enum index_buffer_format : s32
@@ -38,6 +38,14 @@ namespace
     ID3D11DeviceContext*    s_immediate_context = nullptr;
     ID3D11DeviceContext1*   s_immediate_context_1 = nullptr;
 
+    // d3d 11.0 cannot bind constant buffers at an offset, ranges are copied into one of these per slot instead
+    struct cbuffer_range
+    {
+        ID3D11Buffer* buf = nullptr;
+        u32           size = 0;
+    };
+    cbuffer_range s_cbuffer_ranges[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+
     u64 s_frame = 0;
 } // namespace
 
@@ -747,7 +755,13 @@ namespace pen
         bd.BindFlags = (D3D11_BIND_FLAG)params.bind_flags;
         bd.CPUAccessFlags = params.cpu_access_flags;
 
-        if (bd.BindFlags & PEN_BIND_UNORDERED_ACCESS)
+        _res_pool[resource_index].generic_buffer.srv = nullptr;
+        _res_pool[resource_index].generic_buffer.uav = nullptr;
+
+        // buffers bound as shader resources are structured, rw with uav or dynamic read only
+        bool structured = bd.BindFlags & (PEN_BIND_UNORDERED_ACCESS | PEN_BIND_SHADER_RESOURCE);
+
+        if (structured)
         {
             bd.MiscFlags |= D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
             bd.StructureByteStride = params.stride;
@@ -778,7 +792,10 @@ namespace pen
 
             CHECK_CALL(s_device->CreateUnorderedAccessView(_res_pool[resource_index].generic_buffer.buf, &uav_desc,
                 &_res_pool[resource_index].generic_buffer.uav));
+        }
 
+        if (structured)
+        {
             // srv if we need it
             D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
             srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
@@ -1441,6 +1458,79 @@ namespace pen
         }
     }
 
+    void renderer_copy_constant_buffer_range(u32 buffer_index, u32 resource_slot, u32 flags, u32 offset, u32 size)
+    {
+        if (resource_slot >= PEN_ARRAY_SIZE(s_cbuffer_ranges))
+            return;
+
+        ID3D11Buffer* src = _res_pool[buffer_index].generic_buffer.buf;
+
+        D3D11_BUFFER_DESC src_desc;
+        src->GetDesc(&src_desc);
+        if (offset >= src_desc.ByteWidth)
+            return;
+
+        // grow the slot's buffer to fit, the copy is clipped to the end of the source
+        cbuffer_range& range = s_cbuffer_ranges[resource_slot];
+        if (range.size < size)
+        {
+            if (range.buf)
+                range.buf->Release();
+
+            D3D11_BUFFER_DESC bd;
+            ZeroMemory(&bd, sizeof(bd));
+            bd.Usage = D3D11_USAGE_DEFAULT;
+            bd.ByteWidth = size;
+            bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+            range.buf = nullptr;
+            range.size = 0;
+            CHECK_CALL(s_device->CreateBuffer(&bd, nullptr, &range.buf));
+            if (!range.buf)
+                return;
+
+            range.size = size;
+        }
+
+        u32       end = offset + size < src_desc.ByteWidth ? offset + size : src_desc.ByteWidth;
+        D3D11_BOX box = {offset, 0, 0, end, 1, 1};
+        s_immediate_context->CopySubresourceRegion(range.buf, 0, 0, 0, 0, src, 0, &box);
+
+        if (flags & pen::CBUFFER_BIND_PS)
+            s_immediate_context->PSSetConstantBuffers(resource_slot, 1, &range.buf);
+
+        if (flags & pen::CBUFFER_BIND_VS)
+            s_immediate_context->VSSetConstantBuffers(resource_slot, 1, &range.buf);
+
+        if (flags & pen::CBUFFER_BIND_CS)
+            s_immediate_context->CSSetConstantBuffers(resource_slot, 1, &range.buf);
+    }
+
+    void direct::renderer_set_constant_buffer_range(u32 buffer_index, u32 resource_slot, u32 flags, u32 offset, u32 size)
+    {
+        // offsets require d3d 11.1, offset and size are in 16 byte constants and must be multiples of 16 constants
+        ID3D11Buffer** buf = &_res_pool[buffer_index].generic_buffer.buf;
+
+        u32 first_constant = offset / 16;
+        u32 num_constants = ((size + CBUFFER_RANGE_ALIGNMENT - 1) / CBUFFER_RANGE_ALIGNMENT) * 16;
+
+        // 11.0 devices copy the range and bind the copy whole
+        if (!s_immediate_context_1)
+        {
+            renderer_copy_constant_buffer_range(buffer_index, resource_slot, flags, offset, num_constants * 16);
+            return;
+        }
+
+        if (flags & pen::CBUFFER_BIND_PS)
+            s_immediate_context_1->PSSetConstantBuffers1(resource_slot, 1, buf, &first_constant, &num_constants);
+
+        if (flags & pen::CBUFFER_BIND_VS)
+            s_immediate_context_1->VSSetConstantBuffers1(resource_slot, 1, buf, &first_constant, &num_constants);
+
+        if (flags & pen::CBUFFER_BIND_CS)
+            s_immediate_context_1->CSSetConstantBuffers1(resource_slot, 1, buf, &first_constant, &num_constants);
+    }
+
     void direct::renderer_set_structured_buffer(u32 buffer_index, u32 resource_slot, u32 flags)
     {
         static ID3D11Buffer*              null_buffer = nullptr;
@@ -1487,7 +1577,10 @@ namespace pen
     {
         D3D11_MAPPED_SUBRESOURCE mapped_res = {0};
 
-        s_immediate_context->Map(_res_pool[buffer_index].generic_buffer.buf, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_res);
+        // offset 0 discards the buffer, otherwise the range is written in place and must not be in use (no overwrite)
+        D3D11_MAP map_type = offset == 0 ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+
+        s_immediate_context->Map(_res_pool[buffer_index].generic_buffer.buf, 0, map_type, 0, &mapped_res);
 
         void* p_data = (void*)((size_t)mapped_res.pData + offset);
         memcpy(p_data, data, data_size);
@@ -1579,6 +1672,12 @@ namespace pen
     void direct::renderer_release_buffer(u32 buffer_index)
     {
         _res_pool[buffer_index].generic_buffer.buf->Release();
+
+        if (_res_pool[buffer_index].generic_buffer.srv)
+            _res_pool[buffer_index].generic_buffer.srv->Release();
+
+        if (_res_pool[buffer_index].generic_buffer.uav)
+            _res_pool[buffer_index].generic_buffer.uav->Release();
     }
 
     void direct::renderer_release_texture(u32 texture_index)
@@ -1813,6 +1912,18 @@ namespace pen
             case RESOURCE_RENDER_TARGET:
                 direct::renderer_release_render_target(dest);
                 break;
+            case RESOURCE_SAMPLER_STATE:
+                direct::renderer_release_sampler(dest);
+                break;
+            case RESOURCE_RASTER_STATE:
+                direct::renderer_release_raster_state(dest);
+                break;
+            case RESOURCE_BLEND_STATE:
+                direct::renderer_release_blend_state(dest);
+                break;
+            case RESOURCE_DEPTH_STENCIL_STATE:
+                direct::renderer_release_depth_stencil_state(dest);
+                break;
             default:
                 break;
         }
@@ -2072,6 +2183,10 @@ namespace pen
         if (s_immediate_context_1)
             s_immediate_context_1->Release();
 
+        for (u32 i = 0; i < PEN_ARRAY_SIZE(s_cbuffer_ranges); ++i)
+            if (s_cbuffer_ranges[i].buf)
+                s_cbuffer_ranges[i].buf->Release();
+
         if (s_device)
             s_device->Release();
         if (s_device_1)
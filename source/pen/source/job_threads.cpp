@@ -5,13 +5,140 @@
 #include "renderer.h"
 #include "threads.h"
 
+#include <thread>
+
 namespace pen
 {
 #define MAX_THREADS 8
+#define MAX_WORKERS 16
 
     static job s_jt[MAX_THREADS];
     static u32 s_num_active_threads = 0;
 
+    namespace
+    {
+        struct worker_pool
+        {
+            thread*    threads[MAX_WORKERS];
+            semaphore* sem_work[MAX_WORKERS];
+            semaphore* sem_done = nullptr;
+            mutex*     dispatch = nullptr;
+            u32        num_workers = 0;
+
+            // current range
+            job_range_callback cb = nullptr;
+            void*              user_data = nullptr;
+            u32                count = 0;
+            u32                grain = 1;
+            a_u32              next;
+        };
+        static worker_pool s_workers;
+
+        // set while a thread runs a range, nested calls from inside a callback run inline.. the dispatch mutex
+        // alone is not enough where mutexes are recursive (win32 critical sections)
+        thread_local bool s_in_range = false;
+
+        void process_range(worker_pool& wp)
+        {
+            s_in_range = true;
+
+            for (;;)
+            {
+                u32 start = wp.next.fetch_add(wp.grain);
+                if (start >= wp.count)
+                    break;
+
+                u32 end = std::min<u32>(start + wp.grain, wp.count);
+                wp.cb(start, end, wp.user_data);
+            }
+
+            s_in_range = false;
+        }
+
+        PEN_TRV worker_thread_function(void* params)
+        {
+            u32 index = (u32)(size_t)params;
+
+            for (;;)
+            {
+                semaphore_wait(s_workers.sem_work[index]);
+                process_range(s_workers);
+                semaphore_post(s_workers.sem_done, 1);
+            }
+
+            return PEN_THREAD_OK;
+        }
+    } // namespace
+
+    void jobs_create_workers(u32 num_workers)
+    {
+        if (s_workers.dispatch)
+            return;
+
+        if (num_workers == 0)
+        {
+            u32 hw = std::thread::hardware_concurrency();
+            num_workers = hw > 1 ? hw - 1 : 0;
+        }
+
+        num_workers = std::min<u32>(num_workers, MAX_WORKERS);
+
+        s_workers.dispatch = mutex_create();
+        s_workers.sem_done = semaphore_create(0, num_workers);
+        s_workers.next = 0;
+
+        for (u32 i = 0; i < num_workers; ++i)
+        {
+            s_workers.sem_work[i] = semaphore_create(0, 1);
+            s_workers.threads[i] = thread_create(worker_thread_function, 1024 * 1024, (void*)(size_t)i, THREAD_START_DETACHED);
+        }
+
+        s_workers.num_workers = num_workers;
+    }
+
+    u32 jobs_get_num_workers()
+    {
+        return s_workers.num_workers;
+    }
+
+    void jobs_parallel_for(u32 count, u32 grain, job_range_callback cb, void* user_data)
+    {
+        if (count == 0)
+            return;
+
+        grain = std::max<u32>(grain, 1);
+
+        if (!s_workers.dispatch)
+            jobs_create_workers();
+
+        // small ranges, no workers or the pool is already busy (nested call).. just run on this thread
+        if (count <= grain || s_workers.num_workers == 0 || s_in_range || !mutex_try_lock(s_workers.dispatch))
+        {
+            cb(0, count, user_data);
+            return;
+        }
+
+        s_workers.cb = cb;
+        s_workers.user_data = user_data;
+        s_workers.count = count;
+        s_workers.grain = grain;
+        s_workers.next = 0;
+
+        // only wake as many workers as there are chunks
+        u32 num_chunks = (count + grain - 1) / grain;
+        u32 num_wake = std::min<u32>(num_chunks - 1, s_workers.num_workers);
+
+        for (u32 i = 0; i < num_wake; ++i)
+            semaphore_post(s_workers.sem_work[i], 1);
+
+        process_range(s_workers);
+
+        for (u32 i = 0; i < num_wake; ++i)
+            semaphore_wait(s_workers.sem_done);
+
+        mutex_unlock(s_workers.dispatch);
+    }
+
     pen::job* jobs_create_job(PEN_THREAD_ROUTINE(thread_func), u32 stack_size, void* user_data, thread_start_flags flags,
                               completion_callback cb)
     {
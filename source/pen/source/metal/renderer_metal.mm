@@ -220,6 +220,14 @@ namespace // internal structs and static vars
 
         void update(const void* data, u32 data_size, u32 offset)
         {
+            // updates at an offset write the current buffer in place (no overwrite), only offset 0 moves to a new one
+            if (offset != 0 && _dynamic_pos != -1)
+            {
+                u8* pdata = (u8*)[read() contents];
+                memcpy(pdata + offset, data, data_size);
+                return;
+            }
+
             if (frame != g_frame_index)
             {
                 _dynamic_pos = 0;
@@ -312,6 +320,10 @@ namespace // pen consts -> metal consts
                 return MTLVertexFormatUChar2;
             case PEN_VERTEX_FORMAT_UNORM1:
                 return MTLVertexFormatUChar;
+            case PEN_VERTEX_FORMAT_SNORM16_4:
+                return MTLVertexFormatShort4Normalized;
+            case PEN_VERTEX_FORMAT_HALF4:
+                return MTLVertexFormatHalf4;
         }
 
         // unhandled
@@ -1138,7 +1150,7 @@ namespace pen
             ib.size_bytes = index_size_bytes(format);
         }
         
-        inline void _set_buffer(u32 buffer_index, u32 resource_slot, u32 flags)
+        inline void _set_buffer(u32 buffer_index, u32 resource_slot, u32 flags, u32 offset = 0)
         {
             if(buffer_index == 0)
                 return;
@@ -1148,14 +1160,14 @@ namespace pen
             if (flags & pen::CBUFFER_BIND_VS)
             {
                 validate_render_encoder();
-                [_state.render_encoder setVertexBuffer:_res_pool.get(bi).buffer.read() offset:0
+                [_state.render_encoder setVertexBuffer:_res_pool.get(bi).buffer.read() offset:offset
                                                atIndex:resource_slot + CBUF_OFFSET];
             }
 
             if (flags & pen::CBUFFER_BIND_PS)
             {
                 validate_render_encoder();
-                [_state.render_encoder setFragmentBuffer:_res_pool.get(bi).buffer.read() offset:0
+                [_state.render_encoder setFragmentBuffer:_res_pool.get(bi).buffer.read() offset:offset
                                                  atIndex:resource_slot + CBUF_OFFSET];
             }
 
@@ -1163,7 +1175,7 @@ namespace pen
             if (flags & pen::CBUFFER_BIND_CS)
             {
                 validate_compute_encoder();
-                [_state.compute_encoder setBuffer:_res_pool.get(bi).buffer.read() offset:0
+                [_state.compute_encoder setBuffer:_res_pool.get(bi).buffer.read() offset:offset
                                           atIndex:resource_slot + CBUF_OFFSET];
             }
         }
@@ -1173,6 +1185,11 @@ namespace pen
             _set_buffer(buffer_index, resource_slot, flags);
         }
         
+        void renderer_set_constant_buffer_range(u32 buffer_index, u32 resource_slot, u32 flags, u32 offset, u32 size)
+        {
+            _set_buffer(buffer_index, resource_slot, flags, offset);
+        }
+
         void renderer_set_structured_buffer(u32 buffer_index, u32 resource_slot, u32 flags)
         {
             _set_buffer(buffer_index, resource_slot, flags);
@@ -2012,6 +2029,18 @@ namespace pen
                 case RESOURCE_RENDER_TARGET:
                     direct::renderer_release_render_target(dest);
                     break;
+                case RESOURCE_SAMPLER_STATE:
+                    direct::renderer_release_sampler(dest);
+                    break;
+                case RESOURCE_RASTER_STATE:
+                    direct::renderer_release_raster_state(dest);
+                    break;
+                case RESOURCE_BLEND_STATE:
+                    direct::renderer_release_blend_state(dest);
+                    break;
+                case RESOURCE_DEPTH_STENCIL_STATE:
+                    direct::renderer_release_depth_stencil_state(dest);
+                    break;
                 default:
                     break;
             }
@@ -441,6 +441,7 @@ namespace pen
         u32  vertex_buffer_offset[MAX_VERTEX_BUFFERS] = {0};
         u32  num_bound_vertex_buffers = 0;
         u32  index_buffer = 0;
+        u32  index_buffer_offset = 0;
         u32  stream_out_buffer = 0;
         u32  input_layout = 0;
         u32  vertex_shader = 0;
@@ -920,6 +921,7 @@ namespace pen
     {
         g_bound_state.index_buffer = buffer_index;
         g_bound_state.index_format = format;
+        g_bound_state.index_buffer_offset = offset;
     }
 
     void bind_state(u32 primitive_topology)
@@ -1023,6 +1025,7 @@ namespace pen
         {
             g_bound_state.vertex_buffer[v] = g_current_state.vertex_buffer[v];
             g_bound_state.vertex_buffer_stride[v] = g_current_state.vertex_buffer_stride[v];
+            g_bound_state.vertex_buffer_offset[v] = g_current_state.vertex_buffer_offset[v];
 
             auto& res = _res_pool[g_bound_state.vertex_buffer[v]].handle;
             CHECK_CALL(glBindBuffer(GL_ARRAY_BUFFER, res));
@@ -1038,11 +1041,12 @@ namespace pen
                 CHECK_CALL(glEnableVertexAttribArray(attribute.location));
 
                 u32 base_vertex_offset = g_bound_state.vertex_buffer_stride[v] * g_bound_state.base_vertex;
+                u32 buffer_offset = g_bound_state.vertex_buffer_offset[v];
 
                 CHECK_CALL(glVertexAttribPointer(attribute.location, attribute.num_elements, attribute.type,
-                                                 attribute.type == GL_UNSIGNED_BYTE ? true : false,
+                                                 attribute.type == GL_UNSIGNED_BYTE || attribute.type == GL_SHORT,
                                                  g_bound_state.vertex_buffer_stride[v],
-                                                 (void*)(attribute.offset + base_vertex_offset)));
+                                                 (void*)(attribute.offset + base_vertex_offset + buffer_offset)));
 
                 CHECK_CALL(glVertexAttribDivisor(attribute.location, attribute.step_rate));
             }
@@ -1153,7 +1157,7 @@ namespace pen
         GLuint res = _res_pool[g_bound_state.index_buffer].handle;
         CHECK_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, res));
 
-        void* offset = (void*)(size_t)(start_index * 2);
+        void* offset = (void*)(size_t)(start_index * 2 + g_bound_state.index_buffer_offset);
 
         CHECK_CALL(
             glDrawElementsBaseVertex(primitive_topology, index_count, g_bound_state.index_format, offset, base_vertex));
@@ -1171,7 +1175,7 @@ namespace pen
         CHECK_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, res));
 
         // todo this needs to check index size 32 or 16 bit
-        void* offset = (void*)(size_t)(start_index * 2);
+        void* offset = (void*)(size_t)(start_index * 2 + g_bound_state.index_buffer_offset);
 
         CHECK_CALL(glDrawElementsInstancedBaseVertex(primitive_topology, index_count, g_bound_state.index_format, offset,
                                                      instance_count, base_vertex));
@@ -1887,6 +1891,12 @@ namespace pen
         CHECK_CALL(glBindBufferBase(GL_UNIFORM_BUFFER, resource_slot, res.handle));
     }
     
+    void direct::renderer_set_constant_buffer_range(u32 buffer_index, u32 resource_slot, u32 flags, u32 offset, u32 size)
+    {
+        resource_allocation& res = _res_pool[buffer_index];
+        CHECK_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, resource_slot, res.handle, offset, size));
+    }
+
     void direct::renderer_set_structured_buffer(u32 buffer_index, u32 resource_slot, u32 flags)
     {
         PEN_ASSERT(0); // stubbed.. use metal on mac or d3d / vulkan on windows
@@ -1894,17 +1904,22 @@ namespace pen
 
     void direct::renderer_update_buffer(u32 buffer_index, const void* data, u32 data_size, u32 offset)
     {
+        if (data_size == 0)
+            return;
+
         resource_allocation& res = _res_pool[buffer_index];
         CHECK_CALL(glBindBuffer(res.type, res.handle));
 
 #ifndef PEN_GLES3
-        void* mapped_data = CHECK_CALL(glMapBuffer(res.type, GL_WRITE_ONLY));
+        // offset 0 orphans the buffer, otherwise the range is written without waiting on the gpu (no overwrite)
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+        if (offset != 0)
+            access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+
+        void* mapped_data = CHECK_CALL(glMapBufferRange(res.type, offset, data_size, access));
 
         if (mapped_data)
-        {
-            c8* mapped_offset = ((c8*)mapped_data) + offset;
-            memcpy(mapped_offset, data, data_size);
-        }
+            memcpy(mapped_data, data, data_size);
 
         CHECK_CALL(glUnmapBuffer(res.type));
 #else
@@ -2128,6 +2143,18 @@ namespace pen
             case RESOURCE_RENDER_TARGET:
                 direct::renderer_release_render_target(dest);
                 break;
+            case RESOURCE_SAMPLER_STATE:
+                direct::renderer_release_sampler(dest);
+                break;
+            case RESOURCE_RASTER_STATE:
+                direct::renderer_release_raster_state(dest);
+                break;
+            case RESOURCE_BLEND_STATE:
+                direct::renderer_release_blend_state(dest);
+                break;
+            case RESOURCE_DEPTH_STENCIL_STATE:
+                direct::renderer_release_depth_stencil_state(dest);
+                break;
             default:
                 break;
         }
@@ -3,6 +3,8 @@
 // License: https://github.com/polymonster/pmtech/blob/master/license.md
 
 #include <fstream>
+#include <mutex>
+#include <vector>
 
 #include "console.h"
 #include "data_struct.h"
@@ -58,8 +60,10 @@ namespace
         CMD_CREATE_BLEND_STATE,
         CMD_SET_BLEND_STATE,
         CMD_SET_CONSTANT_BUFFER,
+        CMD_SET_CONSTANT_BUFFER_RANGE,
         CMD_SET_STRUCTURED_BUFFER,
         CMD_UPDATE_BUFFER,
+        CMD_UPDATE_STREAM,
         CMD_CREATE_DEPTH_STENCIL_STATE,
         CMD_SET_DEPTH_STENCIL_STATE,
         CMD_UPDATE_QUERIES,
@@ -161,6 +165,8 @@ namespace
         u32 buffer_index;
         u32 resource_slot;
         u32 flags;
+        u32 offset;
+        u32 size;
     };
 
     struct update_buffer_cmd
@@ -236,6 +242,53 @@ namespace
     f32                       _present_time;
     pen::resolve_resources    _resolve_resources;
     ring_buffer<renderer_cmd> _cmd_buffer;
+
+    struct cmd_list
+    {
+        renderer_cmd* cmds = nullptr;
+        u32           size = 0;
+        u32           capacity = 0;
+    };
+
+    std::vector<cmd_list*> _cmd_lists;
+    thread_local cmd_list* _recording_list = nullptr; // list the calling thread records into, null for the queue
+
+    void put_cmd(const renderer_cmd& cmd)
+    {
+        cmd_list* list = _recording_list;
+        if (!list)
+        {
+            _cmd_buffer.put(cmd);
+            return;
+        }
+
+        if (list->size == list->capacity)
+        {
+            list->capacity = std::max<u32>(list->capacity * 2, 1024);
+            list->cmds = (renderer_cmd*)pen::memory_realloc(list->cmds, sizeof(renderer_cmd) * list->capacity);
+        }
+
+        list->cmds[list->size++] = cmd;
+    }
+
+    // transient streaming. the user thread writes a frame into staging while the render thread can still be uploading
+    // the frame before, so two frames of staging are enough. gpu buffers are not duplicated, a page used in the last
+    // frame is discarded (renamed) once at the start of the next and then written with no overwrite
+    static const u32 k_stream_frames = 2;
+
+    struct stream_page
+    {
+        u32 buffer;
+        u32 bind_flags;
+        u32 size;
+        u32 pos;          // bytes allocated this frame, the first STREAM_ALIGNMENT are kept for the discard
+        u8* staging;      // size * k_stream_frames
+        u64 commit_frame; // last frame anything was committed
+    };
+
+    std::vector<stream_page> _stream_pages;
+    std::mutex               _stream_mutex; // allocations can come from threads recording cmd lists
+    u64                      _stream_frame = 0;
 } // namespace
 
 namespace pen
@@ -388,6 +441,11 @@ namespace pen
                                                      cmd.set_buffer.resource_slot, cmd.set_buffer.flags);
                 break;
 
+            case CMD_SET_CONSTANT_BUFFER_RANGE:
+                direct::renderer_set_constant_buffer_range(cmd.set_buffer.buffer_index, cmd.set_buffer.resource_slot,
+                                                           cmd.set_buffer.flags, cmd.set_buffer.offset, cmd.set_buffer.size);
+                break;
+
             case CMD_SET_STRUCTURED_BUFFER:
                 direct::renderer_set_structured_buffer(cmd.set_buffer.buffer_index,
                     cmd.set_buffer.resource_slot, cmd.set_buffer.flags);
@@ -399,6 +457,12 @@ namespace pen
                 memory_free(cmd.update_buffer.data);
                 break;
 
+            case CMD_UPDATE_STREAM:
+                // data points into stream staging, which is not freed
+                direct::renderer_update_buffer(cmd.update_buffer.buffer_index, cmd.update_buffer.data,
+                                               cmd.update_buffer.data_size, cmd.update_buffer.offset);
+                break;
+
             case CMD_CREATE_DEPTH_STENCIL_STATE:
                 direct::renderer_create_depth_stencil_state(*cmd.p_create_depth_stencil_state, cmd.resource_slot);
                 memory_free(cmd.p_create_depth_stencil_state);
@@ -494,6 +558,7 @@ namespace pen
     //-----------------------------------------------------------------------------------------------------------------------
 
     void renderer_wait_for_jobs();
+    void renderer_stream_next_frame();
 
     static pen::job*           p_job_thread_info;
     static pen::semaphore*     p_consume_semaphore = nullptr;
@@ -507,6 +572,8 @@ namespace pen
 
     void renderer_consume_cmd_buffer()
     {
+        renderer_stream_next_frame();
+
         if (p_consume_semaphore)
         {
             semaphore_post(p_consume_semaphore, 1);
@@ -666,12 +733,45 @@ namespace pen
     //  COMMAND BUFFER API
     //-----------------------------------------------------------------------------------------------------------------------
 
+    u32 renderer_create_cmd_list()
+    {
+        _cmd_lists.push_back(new cmd_list());
+        return (u32)_cmd_lists.size() - 1;
+    }
+
+    void renderer_begin_cmd_list(u32 cmd_list)
+    {
+        PEN_ASSERT(!_recording_list);
+        _recording_list = _cmd_lists[cmd_list];
+    }
+
+    void renderer_end_cmd_list()
+    {
+        _recording_list = nullptr;
+    }
+
+    void renderer_submit_cmd_list(u32 cmd_list)
+    {
+        ::cmd_list* list = _cmd_lists[cmd_list];
+
+        // commands own any data they carry (buffer updates, names), it is freed when the render thread executes them
+        for (u32 i = 0; i < list->size; ++i)
+            _cmd_buffer.put(list->cmds[i]);
+
+        list->size = 0;
+    }
+
+    u32 renderer_get_cmd_list_size(u32 cmd_list)
+    {
+        return _cmd_lists[cmd_list]->size;
+    }
+
     void renderer_update_queries()
     {
         renderer_cmd cmd;
 
         cmd.command_index = CMD_UPDATE_QUERIES;
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_clear(u32 clear_state_index, u32 array_index)
@@ -682,7 +782,7 @@ namespace pen
         cmd.clear.clear_state = clear_state_index;
         cmd.clear.array_index = array_index;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_present()
@@ -691,7 +791,7 @@ namespace pen
 
         cmd.command_index = CMD_PRESENT;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     u32 renderer_load_shader(const shader_load_params& params)
@@ -723,7 +823,7 @@ namespace pen
         u32 resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -773,7 +873,7 @@ namespace pen
         u32 resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -787,7 +887,7 @@ namespace pen
         cmd.set_shader.shader_index = shader_index;
         cmd.set_shader.shader_type = shader_type;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     u32 renderer_create_input_layout(const input_layout_creation_params& params)
@@ -813,7 +913,7 @@ namespace pen
         u32 resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -824,7 +924,7 @@ namespace pen
         cmd.command_index = CMD_SET_INPUT_LAYOUT;
         cmd.command_data_index = layout_index;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     u32 renderer_create_buffer(const buffer_creation_params& params)
@@ -845,7 +945,7 @@ namespace pen
         u32 resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -876,7 +976,7 @@ namespace pen
             cmd.set_vertex_buffer.offsets[i] = offsets[i];
         }
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_set_index_buffer(u32 buffer_index, u32 format, u32 offset)
@@ -888,7 +988,7 @@ namespace pen
         cmd.set_index_buffer.format = format;
         cmd.set_index_buffer.offset = offset;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_draw(u32 vertex_count, u32 start_vertex, u32 primitive_topology)
@@ -900,7 +1000,7 @@ namespace pen
         cmd.draw.start_vertex = start_vertex;
         cmd.draw.primitive_topology = primitive_topology;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_draw_indexed(u32 index_count, u32 start_index, u32 base_vertex, u32 primitive_topology)
@@ -913,7 +1013,7 @@ namespace pen
         cmd.draw_indexed.base_vertex = base_vertex;
         cmd.draw_indexed.primitive_topology = primitive_topology;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_draw_indexed_instanced(u32 instance_count, u32 start_instance, u32 index_count, u32 start_index,
@@ -929,7 +1029,7 @@ namespace pen
         cmd.draw_indexed_instanced.base_vertex = base_vertex;
         cmd.draw_indexed_instanced.primitive_topology = primitive_topology;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     u32 renderer_create_render_target(const texture_creation_params& tcp)
@@ -945,7 +1045,7 @@ namespace pen
         u32 resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -984,7 +1084,7 @@ namespace pen
         u32 resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -1001,7 +1101,7 @@ namespace pen
         cmd.set_shader.shader_index = shader_index;
         cmd.set_shader.shader_type = shader_type;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_release_buffer(u32 buffer_index)
@@ -1015,7 +1115,7 @@ namespace pen
 
         cmd.command_data_index = buffer_index;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_release_texture(u32 texture_index)
@@ -1029,7 +1129,7 @@ namespace pen
 
         cmd.command_data_index = texture_index;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     u32 renderer_create_sampler(const sampler_creation_params& scp)
@@ -1043,7 +1143,7 @@ namespace pen
         u32 resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -1059,7 +1159,7 @@ namespace pen
         cmd.set_texture.resource_slot = resource_slot;
         cmd.set_texture.bind_flags = bind_flags;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     u32 renderer_create_rasterizer_state(const rasteriser_state_creation_params& rscp)
@@ -1073,7 +1173,7 @@ namespace pen
         u32 resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -1086,7 +1186,7 @@ namespace pen
 
         cmd.command_data_index = rasterizer_state_index;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_set_viewport(const viewport& vp)
@@ -1097,7 +1197,7 @@ namespace pen
 
         memcpy(&cmd.set_viewport, (void*)&vp, sizeof(viewport));
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_set_scissor_rect(const rect& r)
@@ -1108,7 +1208,7 @@ namespace pen
 
         memcpy(&cmd.set_rect, (void*)&r, sizeof(rect));
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_release_raster_state(u32 raster_state_index)
@@ -1122,7 +1222,7 @@ namespace pen
 
         cmd.command_data_index = raster_state_index;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     u32 renderer_create_blend_state(const blend_creation_params& bcp)
@@ -1143,7 +1243,7 @@ namespace pen
         u32 resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -1156,7 +1256,7 @@ namespace pen
 
         cmd.command_data_index = blend_state_index;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_set_constant_buffer(u32 buffer_index, u32 resource_slot, u32 flags)
@@ -1169,7 +1269,24 @@ namespace pen
         cmd.set_buffer.resource_slot = resource_slot;
         cmd.set_buffer.flags = flags;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
+    }
+
+    void renderer_set_constant_buffer_range(u32 buffer_index, u32 resource_slot, u32 flags, u32 offset, u32 size)
+    {
+        PEN_ASSERT(offset % CBUFFER_RANGE_ALIGNMENT == 0);
+
+        renderer_cmd cmd;
+
+        cmd.command_index = CMD_SET_CONSTANT_BUFFER_RANGE;
+
+        cmd.set_buffer.buffer_index = buffer_index;
+        cmd.set_buffer.resource_slot = resource_slot;
+        cmd.set_buffer.flags = flags;
+        cmd.set_buffer.offset = offset;
+        cmd.set_buffer.size = size;
+
+        put_cmd(cmd);
     }
 
     void renderer_set_structured_buffer(u32 buffer_index, u32 resource_slot, u32 flags)
@@ -1182,7 +1299,7 @@ namespace pen
         cmd.set_buffer.resource_slot = resource_slot;
         cmd.set_buffer.flags = flags;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_update_buffer(u32 buffer_index, const void* data, u32 data_size, u32 offset)
@@ -1200,7 +1317,131 @@ namespace pen
         cmd.update_buffer.data = memory_alloc(data_size);
         memcpy(cmd.update_buffer.data, data, data_size);
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
+    }
+
+    stream_alloc renderer_stream_alloc(u32 bind_flags, u32 size)
+    {
+        stream_alloc sa;
+        if (size == 0)
+            return sa;
+
+        u32 aligned_size = (size + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+
+        std::lock_guard<std::mutex> lock(_stream_mutex);
+
+        stream_page* page = nullptr;
+        for (auto& p : _stream_pages)
+        {
+            if (p.bind_flags == bind_flags && p.pos + aligned_size <= p.size)
+            {
+                page = &p;
+                break;
+            }
+        }
+
+        if (!page)
+        {
+            u32 page_size = STREAM_PAGE_SIZE;
+            while (page_size < aligned_size + STREAM_ALIGNMENT)
+                page_size *= 2;
+
+            stream_page np;
+            np.bind_flags = bind_flags;
+            np.size = page_size;
+            np.pos = STREAM_ALIGNMENT;
+            np.staging = (u8*)memory_alloc(page_size * k_stream_frames);
+            np.commit_frame = (u64)-1;
+
+            // creation goes straight to the queue, ahead of any cmd list that could allocate from the page
+            renderer_cmd cmd;
+            cmd.command_index = CMD_CREATE_BUFFER;
+            cmd.create_buffer.usage_flags = PEN_USAGE_DYNAMIC;
+            cmd.create_buffer.bind_flags = bind_flags;
+            cmd.create_buffer.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
+            cmd.create_buffer.buffer_size = page_size;
+            cmd.create_buffer.stride = 0;
+            cmd.create_buffer.data = nullptr;
+            cmd.resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
+
+            np.buffer = cmd.resource_slot;
+            _cmd_buffer.put(cmd);
+
+            _stream_pages.push_back(np);
+            page = &_stream_pages.back();
+        }
+
+        sa.data = page->staging + page->size * (_stream_frame % k_stream_frames) + page->pos;
+        sa.buffer = page->buffer;
+        sa.offset = page->pos;
+        sa.size = size;
+        sa.frame = _stream_frame;
+
+        page->pos += aligned_size;
+
+        return sa;
+    }
+
+    void renderer_stream_commit(const stream_alloc& sa, u32 offset, u32 size)
+    {
+        if (size == 0)
+            return;
+
+        PEN_ASSERT(sa.frame == _stream_frame);
+        PEN_ASSERT(offset + size <= sa.size);
+
+        {
+            std::lock_guard<std::mutex> lock(_stream_mutex);
+
+            for (auto& p : _stream_pages)
+            {
+                if (p.buffer == sa.buffer)
+                {
+                    p.commit_frame = _stream_frame;
+                    break;
+                }
+            }
+        }
+
+        renderer_cmd cmd;
+
+        cmd.command_index = CMD_UPDATE_STREAM;
+        cmd.update_buffer.buffer_index = sa.buffer;
+        cmd.update_buffer.data = (u8*)sa.data + offset;
+        cmd.update_buffer.data_size = size;
+        cmd.update_buffer.offset = sa.offset + offset;
+
+        put_cmd(cmd);
+    }
+
+    u64 renderer_stream_frame()
+    {
+        return _stream_frame;
+    }
+
+    void renderer_stream_next_frame()
+    {
+        std::lock_guard<std::mutex> lock(_stream_mutex);
+
+        for (auto& p : _stream_pages)
+        {
+            p.pos = STREAM_ALIGNMENT;
+
+            if (p.commit_frame != _stream_frame)
+                continue;
+
+            // an update at offset 0 discards, so the gpu can keep reading last frame's data while this frame is written
+            renderer_cmd cmd;
+            cmd.command_index = CMD_UPDATE_STREAM;
+            cmd.update_buffer.buffer_index = p.buffer;
+            cmd.update_buffer.data = p.staging;
+            cmd.update_buffer.data_size = STREAM_ALIGNMENT;
+            cmd.update_buffer.offset = 0;
+
+            _cmd_buffer.put(cmd);
+        }
+
+        ++_stream_frame;
     }
 
     u32 renderer_create_depth_stencil_state(const depth_stencil_creation_params& dscp)
@@ -1217,7 +1458,7 @@ namespace pen
         u32 resource_slot = slot_resources_get_next(&s_renderer_slot_resources);
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -1230,7 +1471,7 @@ namespace pen
 
         cmd.command_data_index = depth_stencil_state;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_set_targets(u32* colour_targets, u32 num_colour_targets, u32 depth_target, u32 array_index)
@@ -1243,7 +1484,7 @@ namespace pen
         cmd.set_targets.depth = depth_target;
         cmd.set_targets.array_index = array_index;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_set_targets(u32 colour_target, u32 depth_target)
@@ -1256,7 +1497,7 @@ namespace pen
         cmd.set_targets.depth = depth_target;
         cmd.set_targets.array_index = 0;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_release_blend_state(u32 blend_state)
@@ -1269,7 +1510,7 @@ namespace pen
         cmd.command_index = CMD_RELEASE_BLEND_STATE;
         cmd.command_data_index = blend_state;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_release_render_target(u32 render_target)
@@ -1283,7 +1524,7 @@ namespace pen
 
         cmd.command_data_index = render_target;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_release_clear_state(u32 clear_state)
@@ -1297,7 +1538,7 @@ namespace pen
 
         cmd.command_data_index = clear_state;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_release_input_layout(u32 input_layout)
@@ -1311,7 +1552,7 @@ namespace pen
 
         cmd.command_data_index = input_layout;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_release_sampler(u32 sampler)
@@ -1325,7 +1566,7 @@ namespace pen
 
         cmd.command_data_index = sampler;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_release_depth_stencil_state(u32 depth_stencil_state)
@@ -1339,7 +1580,7 @@ namespace pen
 
         cmd.command_data_index = depth_stencil_state;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_set_stream_out_target(u32 buffer_index)
@@ -1350,7 +1591,7 @@ namespace pen
 
         cmd.command_data_index = buffer_index;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_resolve_target(u32 target, e_msaa_resolve_type type)
@@ -1362,7 +1603,7 @@ namespace pen
         cmd.resolve_params.render_target = target;
         cmd.resolve_params.resolve_type = type;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_draw_auto()
@@ -1371,7 +1612,7 @@ namespace pen
 
         cmd.command_index = CMD_DRAW_AUTO;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_dispatch_compute(uint3 grid, uint3 num_threads)
@@ -1382,7 +1623,7 @@ namespace pen
         cmd.cs_dispatch.grid = grid;
         cmd.cs_dispatch.num_threads = num_threads;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_read_back_resource(const resource_read_back_params& rrbp)
@@ -1393,7 +1634,7 @@ namespace pen
 
         cmd.rrb_params = rrbp;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_replace_resource(u32 dest, u32 src, e_renderer_resource type)
@@ -1404,7 +1645,7 @@ namespace pen
 
         cmd.replace_resource_params = {dest, src, type};
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     u32 renderer_create_clear_state(const clear_state& cs)
@@ -1417,7 +1658,7 @@ namespace pen
         cmd.clear_state_params = cs;
         cmd.resource_slot = resource_slot;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
 
         return resource_slot;
     }
@@ -1429,7 +1670,7 @@ namespace pen
         cmd.command_index = CMD_SET_STENCIL_REF;
         cmd.stencil_ref = ref;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_push_perf_marker(const c8* name)
@@ -1444,7 +1685,7 @@ namespace pen
         memcpy(cmd.name, name, len);
         cmd.name[len] = '\0';
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     void renderer_pop_perf_marker()
@@ -1453,7 +1694,7 @@ namespace pen
 
         cmd.command_index = CMD_POP_PERF_MARKER;
 
-        _cmd_buffer.put(cmd);
+        put_cmd(cmd);
     }
 
     // graphics test
@@ -107,6 +107,10 @@ namespace
             return VK_FORMAT_R8G8_UNORM;
         case PEN_VERTEX_FORMAT_UNORM1:
             return VK_FORMAT_R8_UNORM;
+        case PEN_VERTEX_FORMAT_SNORM16_4:
+            return VK_FORMAT_R16G16B16A16_SNORM;
+        case PEN_VERTEX_FORMAT_HALF4:
+            return VK_FORMAT_R16G16B16A16_SFLOAT;
         }
         PEN_ASSERT(0);
         return VK_FORMAT_R32G32B32A32_SFLOAT;
@@ -414,6 +418,8 @@ namespace
     {
         u32                 stage;
         VkDescriptorType    descriptor_type;
+        u32                 buffer_offset = 0;
+        u32                 buffer_range = 0; // 0 = whole buffer
         union
         {
             struct
@@ -452,6 +458,14 @@ namespace
     hash_id*            s_pipeline_cache_hash = nullptr;
     vk_pipeline_cache*  s_pipeline_cache = nullptr;
 
+    // replaced resources swap their old allocation into the src slot, it is released at present once the gpu is idle
+    struct retired_resource
+    {
+        u32                 handle;
+        e_renderer_resource type;
+    };
+    retired_resource* s_retired_resources = nullptr;
+
     enum e_shd
     {
         vertex,
@@ -1792,8 +1806,8 @@ namespace
                     vulkan_buffer& vb = _res_pool.get(pb.index).buffer;
 
                     buf_info.buffer = vb.get_buffer();
-                    buf_info.offset = 0;
-                    buf_info.range = vb.size;
+                    buf_info.offset = pb.buffer_offset;
+                    buf_info.range = pb.buffer_range ? pb.buffer_range : vb.size;
 
                     descriptor_write.pBufferInfo = &buf_info;
                 }
@@ -2147,6 +2161,23 @@ namespace pen
             _set_binding(b);
         }
         
+        void renderer_set_constant_buffer_range(u32 buffer_index, u32 resource_slot, u32 flags, u32 offset, u32 size)
+        {
+            if (buffer_index == 0)
+                return;
+
+            pen_binding b;
+            b.descriptor_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            b.stage = to_vk_stage(flags);
+            b.index = buffer_index;
+            b.slot = resource_slot;
+            b.bind_flags = flags;
+            b.buffer_offset = offset;
+            b.buffer_range = size;
+
+            _set_binding(b);
+        }
+
         void renderer_set_structured_buffer(u32 buffer_index, u32 resource_slot, u32 flags)
         {
             
@@ -2160,7 +2191,7 @@ namespace pen
             VkDeviceMemory mem = _res_pool.get(buffer_index).buffer.get_mem();
 
             void* map_data;
-            vkMapMemory(_ctx.device, mem, 0, data_size, 0, &map_data);
+            vkMapMemory(_ctx.device, mem, offset, data_size, 0, &map_data);
             memcpy(map_data, data, (size_t)data_size);
             vkUnmapMemory(_ctx.device, mem);
         }
@@ -2560,6 +2591,57 @@ namespace pen
 
         }
 
+        void release_retired_resources()
+        {
+            // passes and pipelines are cached by handle and may have been built from the old resources
+            destroy_caches();
+
+            _state.hpipeline = 0;
+            _state.hpass = 0;
+            _state.hdescriptors = 0;
+
+            u32 num_retired = sb_count(s_retired_resources);
+            for (u32 i = 0; i < num_retired; ++i)
+            {
+                u32 h = s_retired_resources[i].handle;
+                switch (s_retired_resources[i].type)
+                {
+                    case RESOURCE_TEXTURE:
+                        renderer_release_texture(h);
+                        break;
+                    case RESOURCE_BUFFER:
+                        renderer_release_buffer(h);
+                        break;
+                    case RESOURCE_VERTEX_SHADER:
+                        renderer_release_shader(h, PEN_SHADER_TYPE_VS);
+                        break;
+                    case RESOURCE_PIXEL_SHADER:
+                        renderer_release_shader(h, PEN_SHADER_TYPE_PS);
+                        break;
+                    case RESOURCE_RENDER_TARGET:
+                        renderer_release_render_target(h);
+                        break;
+                    case RESOURCE_SAMPLER_STATE:
+                        renderer_release_sampler(h);
+                        break;
+                    case RESOURCE_RASTER_STATE:
+                        renderer_release_raster_state(h);
+                        break;
+                    case RESOURCE_BLEND_STATE:
+                        renderer_release_blend_state(h);
+                        break;
+                    case RESOURCE_DEPTH_STENCIL_STATE:
+                        renderer_release_depth_stencil_state(h);
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            sb_free(s_retired_resources);
+            s_retired_resources = nullptr;
+        }
+
         void renderer_present()
         {
             end_render_pass();
@@ -2610,6 +2692,13 @@ namespace pen
             VkResult result = vkQueuePresentKHR(_ctx.present_queue, &present);
             u32 next_frame = (_ctx.ii + 1) % NBB;
 
+            // frames in flight may still reference replaced resources
+            if (s_retired_resources)
+            {
+                vkDeviceWaitIdle(_ctx.device);
+                release_retired_resources();
+            }
+
             // handle swapchain re-creation / window resize
             if (result == VK_ERROR_OUT_OF_DATE_KHR ||
                 result == VK_SUBOPTIMAL_KHR ||
@@ -2636,7 +2725,15 @@ namespace pen
 
         void renderer_replace_resource(u32 dest, u32 src, e_renderer_resource type)
         {
+            // commands already recorded this frame may reference the old allocation, keep it alive until present
+            resource_allocation old = _res_pool.get(dest);
+            _res_pool.get(dest) = _res_pool.get(src);
+            _res_pool.get(src) = old;
 
+            retired_resource rr;
+            rr.handle = src;
+            rr.type = type;
+            sb_push(s_retired_resources, rr);
         }
 
         void renderer_release_shader(u32 shader_index, u32 shader_type)
@@ -62,6 +62,13 @@ project "put"
         
         "../../third_party/maths/*.h"
     }
+    
+    if audio_backend == "native" then
+        removefiles { "source/audio/audio_fmod.cpp" }
+    else
+        removefiles { "source/audio/audio_native.cpp" }
+    end
+    
     includedirs { "include" }
     
     configuration "Debug"
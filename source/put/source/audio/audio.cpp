@@ -10,8 +10,6 @@
 #include "slot_resource.h"
 #include "threads.h"
 
-#include "fmod.hpp"
-
 #include <math.h>
 
 using namespace pen;
@@ -65,6 +63,7 @@ namespace
     {
         u32 command_index;
         u32 resource_slot;
+        u64 time; // audio clock time to apply at, 0 for as soon as possible
 
         union {
             c8*           filename;
@@ -75,9 +74,65 @@ namespace
         };
     };
 
-    pen::job*                   _audio_job_thread_info;
-    pen::slot_resources         _audio_slot_resources;
-    pen::ring_buffer<audio_cmd> _cmd_buffer;
+    // single producer single consumer, commands written by the user thread are made visible to the audio thread together
+    // when audio_consume_command_buffer commits them, so the audio thread never sees part of a frame's commands
+    struct command_queue
+    {
+        audio_cmd* cmds = nullptr;
+        u32        capacity = 0;
+        u32        write_pos = 0; // user thread only
+        a_u32      commit_pos;
+        a_u32      read_pos;
+        a_u32      commits; // number of commits, the audio thread publishes state when it changes
+    };
+
+    pen::job*           _audio_job_thread_info;
+    pen::slot_resources _audio_slot_resources;
+    command_queue       _cmd_queue;
+    audio_output_params _output_params;
+    u64                 _cmd_time = 0;
+    a_u64               _audio_time;
+    a_u32               _audio_sample_rate;
+
+    void commit_commands()
+    {
+        _cmd_queue.commit_pos = _cmd_queue.write_pos;
+        _cmd_queue.commits++;
+    }
+
+    void put_command(audio_cmd& cmd)
+    {
+        cmd.time = _cmd_time;
+
+        u32 next = (_cmd_queue.write_pos + 1) % _cmd_queue.capacity;
+        if (next == _cmd_queue.read_pos)
+        {
+            // more commands than fit in the queue in one frame, or the audio thread has stalled. this is the only time
+            // the user thread waits, commit what is already written so the audio thread can make space
+            commit_commands();
+
+            while (next == _cmd_queue.read_pos)
+                pen::thread_sleep_ms(0);
+        }
+
+        _cmd_queue.cmds[_cmd_queue.write_pos] = cmd;
+        _cmd_queue.write_pos = next;
+    }
+
+    // audio thread
+    audio_cmd* peek_command()
+    {
+        u32 rp = _cmd_queue.read_pos;
+        if (rp == _cmd_queue.commit_pos)
+            return nullptr;
+
+        return &_cmd_queue.cmds[rp];
+    }
+
+    void pop_command()
+    {
+        _cmd_queue.read_pos = (_cmd_queue.read_pos + 1) % _cmd_queue.capacity;
+    }
 } // namespace
 
 namespace put
@@ -141,10 +196,33 @@ namespace put
         }
     }
 
+    void audio_set_output_params(const audio_output_params& params)
+    {
+        _output_params = params;
+    }
+
     void audio_consume_command_buffer()
     {
-        pen::semaphore_post(_audio_job_thread_info->p_sem_consume, 1);
-        pen::semaphore_wait(_audio_job_thread_info->p_sem_continue);
+        commit_commands();
+        _cmd_time = 0;
+
+        // every accessor call until the next consume reads the same snapshot
+        direct::audio_system_acquire_state();
+    }
+
+    void audio_set_command_time(u64 time)
+    {
+        _cmd_time = time;
+    }
+
+    u64 audio_get_time()
+    {
+        return _audio_time;
+    }
+
+    u32 audio_get_sample_rate()
+    {
+        return _audio_sample_rate;
     }
 
     PEN_TRV audio_thread_function(void* params)
@@ -154,37 +232,60 @@ namespace put
 
         // create resource slots
         pen::slot_resources_init(&_audio_slot_resources, 128);
-        _cmd_buffer.create(1024);
 
-        direct::audio_system_initialise();
+        _cmd_queue.capacity = 4096;
+        _cmd_queue.cmds = (audio_cmd*)pen::memory_alloc(sizeof(audio_cmd) * _cmd_queue.capacity);
+        _cmd_queue.commit_pos = 0;
+        _cmd_queue.read_pos = 0;
+        _cmd_queue.commits = 0;
+
+        direct::audio_system_initialise(_output_params);
+
+        _audio_time = direct::audio_system_get_time();
+        _audio_sample_rate = direct::audio_system_get_sample_rate();
 
         // allow main thread to continue now we are initialised
         pen::semaphore_post(_audio_job_thread_info->p_sem_continue, 1);
 
+        u32 commits = 0;
         for (;;)
         {
-            if (pen::semaphore_try_wait(_audio_job_thread_info->p_sem_consume))
-            {
-                pen::semaphore_post(_audio_job_thread_info->p_sem_continue, 1);
+            u64 time = direct::audio_system_get_time();
+            _audio_time = time;
 
-                audio_cmd* cmd = _cmd_buffer.get();
-                while (cmd)
-                {
-                    audio_exec_command(*cmd);
-                    cmd = _cmd_buffer.get();
-                }
+            // commands are applied in order once they are due, a command waiting for its time holds back the rest
+            audio_cmd* cmd = peek_command();
+            while (cmd && cmd->time <= time)
+            {
+                audio_exec_command(*cmd);
+                pop_command();
+                cmd = peek_command();
+            }
 
+            // publish state once for each frame the user thread commits
+            u32 c = _cmd_queue.commits;
+            if (c != commits)
+            {
                 direct::audio_system_update();
+                commits = c;
             }
-            else
-            {
+
+            // mixing stops at the next command's time so it is applied on that exact frame
+            u64 until = cmd ? cmd->time : (u64)-1;
+            if (direct::audio_system_mix(until) == 0)
                 pen::thread_sleep_ms(1);
-            }
 
             if (pen::semaphore_try_wait(_audio_job_thread_info->p_sem_exit))
                 break;
         }
 
+        // anything committed before exit is still executed so resources are released
+        while (audio_cmd* cmd = peek_command())
+        {
+            audio_exec_command(*cmd);
+            pop_command();
+        }
+
         direct::audio_system_shutdown();
 
         pen::semaphore_post(_audio_job_thread_info->p_sem_continue, 1);
@@ -208,7 +309,7 @@ namespace put
         // set command (create stream or sound)
         ac.command_index = command;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     u32 audio_create_stream(const c8* filename)
@@ -238,7 +339,7 @@ namespace put
         ac.command_index = CMD_AUDIO_CREATE_GROUP;
         ac.resource_slot = res;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
 
         return res;
     }
@@ -258,7 +359,7 @@ namespace put
         ac.resource_index = sound_index;
         ac.resource_slot = res;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
 
         return res;
     }
@@ -271,7 +372,7 @@ namespace put
         ac.set_valuei.resource_index = channel_index;
         ac.set_valuei.value = position_ms;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     void audio_channel_set_frequency(const u32 channel_index, const f32 frequency)
@@ -282,7 +383,7 @@ namespace put
         ac.set_valuef.resource_index = channel_index;
         ac.set_valuef.value = frequency;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     void audio_group_set_pause(const u32 group_index, const bool val)
@@ -293,7 +394,7 @@ namespace put
         ac.set_valuei.resource_index = group_index;
         ac.set_valuei.value = (s32)val;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     void audio_group_set_mute(const u32 group_index, const bool val)
@@ -304,7 +405,7 @@ namespace put
         ac.set_valuei.resource_index = group_index;
         ac.set_valuei.value = (s32)val;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     void audio_group_set_pitch(const u32 group_index, const f32 pitch)
@@ -315,7 +416,7 @@ namespace put
         ac.set_valuef.resource_index = group_index;
         ac.set_valuef.value = pitch;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     void audio_group_set_volume(const u32 group_index, const f32 volume)
@@ -326,7 +427,7 @@ namespace put
         ac.set_valuef.resource_index = group_index;
         ac.set_valuef.value = volume;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     void audio_add_channel_to_group(const u32 channel_index, const u32 group_index)
@@ -342,7 +443,7 @@ namespace put
         ac.set_valuei.resource_index = channel_index;
         ac.set_valuei.value = group_index;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     void audio_release_resource(u32 index)
@@ -355,7 +456,7 @@ namespace put
         ac.command_index = CMD_AUDIO_RELEASE_RESOURCE;
         ac.resource_index = index;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     u32 audio_add_dsp_to_group(const u32 group_index, dsp_type type)
@@ -369,7 +470,7 @@ namespace put
         ac.set_valuei.value = type;
         ac.resource_slot = res;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
 
         return res;
     }
@@ -384,7 +485,7 @@ namespace put
         ac.set_value3f.value[1] = med;
         ac.set_value3f.value[2] = high;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     void audio_dsp_set_gain(const u32 dsp_index, const f32 gain)
@@ -395,7 +496,7 @@ namespace put
         ac.set_valuef.resource_index = dsp_index;
         ac.set_valuef.value = gain;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 
     void audio_channel_stop(const u32 channel_index)
@@ -405,6 +506,6 @@ namespace put
         ac.command_index = CMD_AUDIO_CHANNEL_STOP;
         ac.resource_index = channel_index;
 
-        _cmd_buffer.put(ac);
+        put_command(ac);
     }
 } // namespace put
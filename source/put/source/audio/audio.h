@@ -10,11 +10,12 @@
 namespace put
 {
     // Simple C-Style generic audio API wrapper
-    // Currently implementation is in fmod.
+    // Implementation is in fmod or the native software mixer, selected by the --audio premake option.
 
-    // Public API used by the user thread will store function call arguments in a command buffer
-    // Dedicated thread will wait on a semaphore until audio_consume_command_buffer is called
-    // command buffer will be consumed passing arguments to the direct:: functions.
+    // Public API used by the user thread will store function call arguments in a command queue
+    // audio_consume_command_buffer commits a frame's commands to the audio thread without waiting for it, the audio
+    // thread passes them to the direct:: functions as they become due and publishes a snapshot of resource state,
+    // accessors read the latest snapshot taken at the last audio_consume_command_buffer.
 
     enum audio_play_state : s32
     {
@@ -63,11 +64,36 @@ namespace put
         f32* spectrum[32];
     };
 
+    enum audio_output_sink : u32
+    {
+        AUDIO_OUTPUT_DEVICE,
+        AUDIO_OUTPUT_FILE, // 16 bit wav
+        AUDIO_OUTPUT_NULL
+    };
+
+    struct audio_output_params
+    {
+        u32       sink = AUDIO_OUTPUT_DEVICE;
+        const c8* filename = nullptr; // for AUDIO_OUTPUT_FILE, must stay valid until the audio thread has started
+        u32       sample_rate = 48000;
+        u32       latency_ms = 40;
+    };
+
     // Threading
 
     PEN_TRV audio_thread_function(void* params);
     void    audio_consume_command_buffer();
 
+    // Timing
+    // Commands are applied once the audio clock reaches their time, in the order they were issued. The native backend
+    // stops its mix at the time so the command takes effect on that frame, fmod applies it on its next update.
+    u64  audio_get_time(); // audio clock in output frames, updated by the audio thread
+    u32  audio_get_sample_rate();
+    void audio_set_command_time(u64 time); // for commands issued until the next consume, 0 for as soon as possible
+
+    // Set before the audio thread is created, the native backend uses them and fmod ignores them
+    void audio_set_output_params(const audio_output_params& params);
+
     // Creation
     u32  audio_create_stream(const c8* filename);
     u32  audio_create_sound(const c8* filename);
@@ -105,9 +131,15 @@ namespace put
         // The audio platform will implement these functions and execute them on a dedicated thread
 
         // System
-        void audio_system_initialise();
+        void audio_system_initialise(const audio_output_params& params);
         void audio_system_shutdown();
-        void audio_system_update();
+        void audio_system_update();       // publishes a snapshot of resource state for the accessors
+        u32  audio_system_mix(u64 until); // mixes no further than until, returns frames mixed, 0 if mixing is elsewhere
+        u64  audio_system_get_time();
+        u32  audio_system_get_sample_rate();
+
+        // called from the user thread by audio_consume_command_buffer to take the latest snapshot
+        void audio_system_acquire_state();
 
         // Creation
         u32 audio_create_stream(const c8* filename, u32 resource_slot);
@@ -39,25 +39,28 @@ namespace
 
     struct resource_state
     {
+        audio_resource_type type; // AUDIO_RESOURCE_VIRTUAL if the slot is not assigned
+
         union {
-            audio_channel_state channel_state;
-            audio_group_state   group_state;
-            audio_fft_spectrum* fft_spectrum;
-            audio_eq_state      eq_state;
-            f32                 gain_value;
+            audio_channel_state   channel_state;
+            audio_group_state     group_state;
+            audio_sound_file_info file_info;
+            audio_fft_spectrum    fft_spectrum; // points to fmod's own spectrum data
+            audio_eq_state        eq_state;
+            f32                   gain_value;
         };
     };
 
-    FMOD::System*                              _sound_system;
-    pen::res_pool<audio_resource_allocation>   _audio_resources;
-    pen::multi_array_buffer<resource_state, 2> _resource_states;
-    pen::res_pool<std::atomic<bool>>           _sound_file_info_ready;
-    pen::res_pool<audio_sound_file_info>       _sound_file_info;
+    FMOD::System*                            _sound_system;
+    pen::res_pool<audio_resource_allocation> _audio_resources;
+    pen::triple_array_buffer<resource_state> _resource_states;
+    pen::res_pool<std::atomic<bool>>         _sound_file_info_ready;
+    pen::res_pool<audio_sound_file_info>     _sound_file_info;
 } // namespace
 
 namespace put
 {
-    void direct::audio_system_initialise()
+    void direct::audio_system_initialise(const audio_output_params& params)
     {
         // init fmod
         FMOD_RESULT result;
@@ -86,13 +89,39 @@ namespace put
         _sound_system->release();
     }
 
-    void update_channel_state(u32 resource_index)
+    u32 direct::audio_system_mix(u64 until)
     {
-        _resource_states.grow(resource_index);
+        // fmod mixes on its own thread
+        return 0;
+    }
 
-        audio_resource_allocation& res = _audio_resources[resource_index];
+    u64 direct::audio_system_get_time()
+    {
+        FMOD::ChannelGroup* master = nullptr;
+        _sound_system->getMasterChannelGroup(&master);
+
+        unsigned long long clock = 0;
+        master->getDSPClock(&clock, nullptr);
+
+        return clock;
+    }
+
+    u32 direct::audio_system_get_sample_rate()
+    {
+        s32 rate = 0;
+        _sound_system->getSoftwareFormat(&rate, nullptr, nullptr);
+
+        return rate;
+    }
+
+    void direct::audio_system_acquire_state()
+    {
+        _resource_states.acquire();
+    }
 
-        resource_state& rs = _resource_states.backbuffer()[resource_index];
+    void update_channel_state(u32 resource_index, resource_state& rs)
+    {
+        audio_resource_allocation& res = _audio_resources[resource_index];
 
         audio_channel_state* state = &rs.channel_state;
 
@@ -123,14 +152,10 @@ namespace put
         }
     }
 
-    void update_group_state(u32 resource_index)
+    void update_group_state(u32 resource_index, resource_state& rs)
     {
-        _resource_states.grow(resource_index);
-
         audio_resource_allocation& res = _audio_resources[resource_index];
 
-        resource_state& rs = _resource_states.backbuffer()[resource_index];
-
         audio_group_state* state = &rs.group_state;
 
         FMOD::ChannelGroup* channel = (FMOD::ChannelGroup*)res.resource;
@@ -160,42 +185,35 @@ namespace put
         }
     }
 
-    void update_fft(u32 resource_index)
+    void update_fft(u32 resource_index, resource_state& rs)
     {
-        _resource_states.grow(resource_index);
-
         audio_resource_allocation& res = _audio_resources[resource_index];
 
-        resource_state& rs = _resource_states.backbuffer()[resource_index];
-
-        audio_fft_spectrum** fft = &rs.fft_spectrum;
+        audio_fft_spectrum* fft = nullptr;
 
         FMOD::DSP* fft_dsp = (FMOD::DSP*)res.resource;
 
-        FMOD_RESULT result = fft_dsp->getParameterData(FMOD_DSP_FFT_SPECTRUMDATA, (void**)fft, 0, 0, 0);
+        FMOD_RESULT result = fft_dsp->getParameterData(FMOD_DSP_FFT_SPECTRUMDATA, (void**)&fft, 0, 0, 0);
 
         PEN_ASSERT(result == FMOD_OK);
+
+        memset(&rs.fft_spectrum, 0x0, sizeof(audio_fft_spectrum));
+
+        if (fft)
+            rs.fft_spectrum = *fft;
     }
 
-    void update_three_band_eq(u32 resource_index)
+    void update_three_band_eq(u32 resource_index, resource_state& rs)
     {
-        _resource_states.grow(resource_index);
-
         FMOD::DSP* eq_dsp = (FMOD::DSP*)_audio_resources[resource_index].resource;
 
-        resource_state& rs = _resource_states.backbuffer()[resource_index];
-
         eq_dsp->getParameterFloat(FMOD_DSP_THREE_EQ_LOWGAIN, &rs.eq_state.low, nullptr, 0);
         eq_dsp->getParameterFloat(FMOD_DSP_THREE_EQ_MIDGAIN, &rs.eq_state.med, nullptr, 0);
         eq_dsp->getParameterFloat(FMOD_DSP_THREE_EQ_HIGHGAIN, &rs.eq_state.high, nullptr, 0);
     }
 
-    void update_gain(u32 resource_index)
+    void update_gain(u32 resource_index, resource_state& rs)
     {
-        _resource_states.grow(resource_index);
-
-        resource_state& rs = _resource_states.backbuffer()[resource_index];
-
         FMOD::DSP* gain_dsp = (FMOD::DSP*)_audio_resources[resource_index].resource;
 
         gain_dsp->getParameterFloat(FMOD_DSP_CHANNELMIX_GAIN_CH0, &rs.gain_value, nullptr, 0);
@@ -205,49 +223,67 @@ namespace put
     {
         _sound_system->update();
 
+        // every slot is written, the back buffer holds the state from 3 updates ago
+        _resource_states.grow(_audio_resources._capacity);
+
         for (s32 i = 0; i < _audio_resources._capacity; ++i)
         {
-            if (_audio_resources[i].assigned_flag)
+            resource_state& rs = _resource_states.backbuffer()[i];
+            rs.type = AUDIO_RESOURCE_VIRTUAL;
+
+            if (!_audio_resources[i].assigned_flag)
+                continue;
+
+            rs.type = _audio_resources[i].type;
+
+            switch (rs.type)
             {
-                switch (_audio_resources[i].type)
+                case AUDIO_RESOURCE_SOUND:
                 {
-                    case AUDIO_RESOURCE_CHANNEL:
-                    {
-                        update_channel_state(i);
-                    }
-                    break;
+                    // not ready until the file info is
+                    if (!_sound_file_info_ready[i])
+                        rs.type = AUDIO_RESOURCE_VIRTUAL;
 
-                    case AUDIO_RESOURCE_GROUP:
-                    {
-                        update_group_state(i);
-                    }
-                    break;
+                    rs.file_info = _sound_file_info[i];
+                }
+                break;
 
-                    case AUDIO_RESOURCE_DSP_FFT:
-                    {
-                        update_fft(i);
-                    }
-                    break;
+                case AUDIO_RESOURCE_CHANNEL:
+                {
+                    update_channel_state(i, rs);
+                }
+                break;
 
-                    case AUDIO_RESOURCE_DSP_EQ:
-                    {
-                        update_three_band_eq(i);
-                    }
-                    break;
+                case AUDIO_RESOURCE_GROUP:
+                {
+                    update_group_state(i, rs);
+                }
+                break;
 
-                    case AUDIO_RESOURCE_DSP_GAIN:
-                    {
-                        update_gain(i);
-                    }
-                    break;
+                case AUDIO_RESOURCE_DSP_FFT:
+                {
+                    update_fft(i, rs);
+                }
+                break;
 
-                    default:
-                        break;
+                case AUDIO_RESOURCE_DSP_EQ:
+                {
+                    update_three_band_eq(i, rs);
                 }
+                break;
+
+                case AUDIO_RESOURCE_DSP_GAIN:
+                {
+                    update_gain(i, rs);
+                }
+                break;
+
+                default:
+                    break;
             }
         }
 
-        _resource_states.swap_buffers();
+        _resource_states.publish();
     }
 
     u32 direct::audio_create_sound(const c8* filename, u32 resource_slot)
@@ -419,6 +455,8 @@ namespace put
                 default:
                     break;
             }
+
+            _audio_resources[index].assigned_flag = 0;
         }
 
         return 0;
@@ -501,118 +539,85 @@ namespace put
         gain_dsp->setParameterFloat(FMOD_DSP_CHANNELMIX_GAIN_CH1, gain);
     }
 
-    pen_error audio_channel_get_state(const u32 channel_index, audio_channel_state* state)
+    pen_error get_resource_state(u32 index, audio_resource_type type, const resource_state*& rs)
     {
-        if (_audio_resources[channel_index].assigned_flag)
-        {
-            if (_audio_resources[channel_index].type == AUDIO_RESOURCE_CHANNEL)
-            {
-                const resource_state& rs = _resource_states.frontbuffer()[channel_index];
+        if (index >= _resource_states.frontbuffer_capacity())
+            return PEN_ERR_NOT_READY;
 
-                *state = rs.channel_state;
+        rs = &_resource_states.frontbuffer()[index];
 
-                return PEN_ERR_OK;
-            }
+        if (rs->type == AUDIO_RESOURCE_VIRTUAL)
+            return PEN_ERR_NOT_READY;
 
+        if (rs->type != type)
             return PEN_ERR_FAILED;
-        }
 
-        return PEN_ERR_NOT_READY;
+        return PEN_ERR_OK;
     }
 
-    pen_error audio_channel_get_sound_file_info(const u32 sound_index, audio_sound_file_info* info)
+    pen_error audio_channel_get_state(const u32 channel_index, audio_channel_state* state)
     {
-        if (_audio_resources[sound_index].assigned_flag && _sound_file_info_ready[sound_index])
-        {
-            if (_audio_resources[sound_index].type == AUDIO_RESOURCE_SOUND)
-            {
-                *info = _sound_file_info[sound_index];
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(channel_index, AUDIO_RESOURCE_CHANNEL, rs);
 
-                return PEN_ERR_OK;
-            }
-
-            return PEN_ERR_FAILED;
-        }
+        if (err == PEN_ERR_OK)
+            *state = rs->channel_state;
 
-        return PEN_ERR_NOT_READY;
+        return err;
     }
 
-    pen_error audio_group_get_state(const u32 group_index, audio_group_state* state)
+    pen_error audio_channel_get_sound_file_info(const u32 sound_index, audio_sound_file_info* info)
     {
-        if (_audio_resources[group_index].assigned_flag)
-        {
-            if (_audio_resources[group_index].type == AUDIO_RESOURCE_GROUP)
-            {
-                const resource_state& rs = _resource_states.frontbuffer()[group_index];
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(sound_index, AUDIO_RESOURCE_SOUND, rs);
 
-                *state = rs.group_state;
+        if (err == PEN_ERR_OK)
+            *info = rs->file_info;
 
-                return PEN_ERR_OK;
-            }
+        return err;
+    }
 
-            return PEN_ERR_FAILED;
-        }
+    pen_error audio_group_get_state(const u32 group_index, audio_group_state* state)
+    {
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(group_index, AUDIO_RESOURCE_GROUP, rs);
+
+        if (err == PEN_ERR_OK)
+            *state = rs->group_state;
 
-        return PEN_ERR_NOT_READY;
+        return err;
     }
 
     pen_error audio_dsp_get_spectrum(const u32 spectrum_dsp, audio_fft_spectrum* spectrum)
     {
-        if (_audio_resources[spectrum_dsp].assigned_flag)
-        {
-            if (_audio_resources[spectrum_dsp].type == AUDIO_RESOURCE_DSP_FFT)
-            {
-                const resource_state& rs = _resource_states.frontbuffer()[spectrum_dsp];
-
-                if (rs.fft_spectrum != nullptr)
-                {
-                    *spectrum = *rs.fft_spectrum;
-                }
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(spectrum_dsp, AUDIO_RESOURCE_DSP_FFT, rs);
 
-                return PEN_ERR_OK;
-            }
+        if (err == PEN_ERR_OK)
+            *spectrum = rs->fft_spectrum;
 
-            return PEN_ERR_FAILED;
-        }
-
-        return PEN_ERR_NOT_READY;
+        return err;
     }
 
     pen_error audio_dsp_get_three_band_eq(const u32 eq_dsp, audio_eq_state* eq_state)
     {
-        if (_audio_resources[eq_dsp].assigned_flag)
-        {
-            if (_audio_resources[eq_dsp].type == AUDIO_RESOURCE_DSP_EQ)
-            {
-                const resource_state& rs = _resource_states.frontbuffer()[eq_dsp];
-
-                *eq_state = rs.eq_state;
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(eq_dsp, AUDIO_RESOURCE_DSP_EQ, rs);
 
-                return PEN_ERR_OK;
-            }
+        if (err == PEN_ERR_OK)
+            *eq_state = rs->eq_state;
 
-            return PEN_ERR_FAILED;
-        }
-
-        return PEN_ERR_NOT_READY;
+        return err;
     }
 
     pen_error audio_dsp_get_gain(const u32 dsp_index, f32* gain)
     {
-        if (_audio_resources[dsp_index].assigned_flag)
-        {
-            if (_audio_resources[dsp_index].type == AUDIO_RESOURCE_DSP_GAIN)
-            {
-                const resource_state& rs = _resource_states.frontbuffer()[dsp_index];
-
-                *gain = rs.gain_value;
-
-                return PEN_ERR_OK;
-            }
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(dsp_index, AUDIO_RESOURCE_DSP_GAIN, rs);
 
-            return PEN_ERR_FAILED;
-        }
+        if (err == PEN_ERR_OK)
+            *gain = rs->gain_value;
 
-        return PEN_ERR_NOT_READY;
+        return err;
     }
 } // namespace put
@@ -0,0 +1,1123 @@
+// audio_mixer.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "audio_mixer.h"
+
+#include "console.h"
+#include "data_struct.h"
+#include "file_system.h"
+#include "memory.h"
+#include "os.h"
+#include "pen_string.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if PEN_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace put
+{
+    namespace mixer
+    {
+        struct wav_format
+        {
+            u32 format = 0; // 1 pcm, 3 float
+            u32 channels = 0;
+            u32 sample_rate = 0;
+            u32 bits = 0;
+            u32 frame_size = 0;
+            u32 data_offset = 0;
+            u32 num_frames = 0;
+        };
+
+        struct sound
+        {
+            f32*       samples = nullptr; // interleaved num_channels, null for streams
+            u32        num_frames = 0;
+            u32        num_channels = 0; // 1 or 2
+            u32        sample_rate = 0;
+            bool       loop = false;
+            c8*        filename = nullptr; // streams open their own file per voice
+            wav_format format;
+        };
+
+        // a window of decoded stereo frames of a stream, frames are counted from the first play through so looping
+        // streams keep increasing and are wrapped when read
+        struct stream_window
+        {
+            FILE* file = nullptr;
+            f32*  frames = nullptr;
+            u8*   raw = nullptr;
+            u64   start = 0;
+            u32   count = 0;
+        };
+
+        struct voice
+        {
+            sound*        snd = nullptr;
+            group*        grp = nullptr;
+            u64           position = 0; // 32.32 fixed point source frames
+            f32           frequency = 0.0f;
+            f32           smooth_frequency = 0.0f;
+            bool          playing = false;
+            stream_window stream;
+        };
+
+        struct biquad
+        {
+            f32 b0, b1, b2, a1, a2;
+            f32 z1[2];
+            f32 z2[2];
+        };
+
+        struct dsp
+        {
+            dsp_type type;
+            f32      params[3] = {0.0f, 0.0f, 0.0f}; // eq low, med, high or gain, in db
+            f32      smooth_gain[3] = {1.0f, 1.0f, 1.0f}; // linear gains at the end of the last block
+
+            // eq, 24db / octave crossovers from 2 cascaded butterworth lowpass filters each
+            biquad low[2];
+            biquad high[2];
+
+            // fft
+            f32*               history = nullptr; // stereo ring of MIXER_FFT_WINDOW frames
+            u32                history_pos = 0;
+            f32*               window = nullptr;
+            f32*               twiddle = nullptr; // cos, sin pairs
+            f32*               work = nullptr;
+            f32*               spectrum_data = nullptr;
+            audio_fft_spectrum spectrum[2];
+            u32                flip = 0;
+        };
+
+        struct group
+        {
+            dsp* dsps[MIXER_MAX_DSP];
+            u32  num_dsp = 0;
+            u32  sample_rate = 0;
+            f32  volume = 1.0f;
+            f32  smooth_volume = 1.0f;
+            f32  pitch = 1.0f;
+            f32  smooth_pitch = 1.0f;
+            bool paused = false;
+            bool muted = false;
+            f32  bus[MIXER_BLOCK_FRAMES * 2];
+        };
+
+        struct mixer_context
+        {
+            u32         sample_rate = 0;
+            sound**     sounds = nullptr;
+            voice**     voices = nullptr;
+            group**     groups = nullptr;
+            f32*        staging = nullptr;
+            f32         master[MIXER_BLOCK_FRAMES * 2];
+            mixer_stats stats;
+        };
+    } // namespace mixer
+} // namespace put
+
+using namespace put;
+using namespace mixer;
+
+namespace
+{
+    const u32 k_max_step = 16; // max playback rate relative to the mixer rate
+    const u32 k_staging_frames = MIXER_BLOCK_FRAMES * k_max_step + 2;
+    const f32 k_frac_scale = 1.0f / 4294967296.0f;
+    const f32 k_eq_low_hz = 400.0f;
+    const f32 k_eq_high_hz = 4000.0f;
+    const f32 k_min_db = -80.0f;
+    const f32 k_max_db = 10.0f;
+    const f32 k_smooth_seconds = 0.01f; // time constant parameter changes are smoothed over
+
+    inline u16 read_u16(const u8* p)
+    {
+        return (u16)(p[0] | (p[1] << 8));
+    }
+
+    inline u32 read_u32(const u8* p)
+    {
+        return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+    }
+
+    // one pole step towards target, applied once a block and ramped linearly across it
+    inline f32 smooth(f32 current, f32 target, f32 k)
+    {
+        f32 next = current + (target - current) * k;
+        return fabsf(target - next) < 1e-5f ? target : next;
+    }
+
+    inline f32 db_to_linear(f32 db)
+    {
+        return powf(10.0f, std::min(std::max(db, k_min_db), k_max_db) / 20.0f);
+    }
+
+    // riff header, fmt and the location of the data chunk. header_size is all of the file or enough of the start of
+    // it to reach the data chunk
+    bool parse_wav(const u8* data, u32 header_size, u32 file_size, wav_format& fmt)
+    {
+        if (header_size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+            return false;
+
+        u32 pos = 12;
+        while (pos + 8 <= header_size)
+        {
+            const u8* chunk = data + pos;
+            u32       size = read_u32(chunk + 4);
+
+            if (memcmp(chunk, "fmt ", 4) == 0 && pos + 8 + 16 <= header_size)
+            {
+                fmt.format = read_u16(chunk + 8);
+                fmt.channels = read_u16(chunk + 10);
+                fmt.sample_rate = read_u32(chunk + 12);
+                fmt.frame_size = read_u16(chunk + 20);
+                fmt.bits = read_u16(chunk + 22);
+
+                // extensible, the format is the start of the sub format guid
+                if (fmt.format == 0xfffe && size >= 40 && pos + 8 + 26 <= header_size)
+                    fmt.format = read_u16(chunk + 32);
+            }
+            else if (memcmp(chunk, "data", 4) == 0)
+            {
+                if (fmt.frame_size == 0)
+                    return false;
+
+                fmt.data_offset = pos + 8;
+                u32 data_size = std::min(size, file_size - std::min(file_size, fmt.data_offset));
+                fmt.num_frames = data_size / fmt.frame_size;
+                break;
+            }
+
+            pos += 8 + size + (size & 1);
+        }
+
+        if (fmt.data_offset == 0 || fmt.channels == 0 || fmt.sample_rate == 0)
+            return false;
+
+        bool pcm = fmt.format == 1 && (fmt.bits == 8 || fmt.bits == 16 || fmt.bits == 24 || fmt.bits == 32);
+        bool flt = fmt.format == 3 && fmt.bits == 32;
+
+        return (pcm || flt) && fmt.frame_size == fmt.channels * fmt.bits / 8;
+    }
+
+    inline f32 decode_sample(const u8* p, const wav_format& fmt)
+    {
+        switch (fmt.bits)
+        {
+            case 8:
+                return ((f32)p[0] - 128.0f) / 128.0f;
+            case 16:
+                return (f32)(s16)read_u16(p) / 32768.0f;
+            case 24:
+                return (f32)((s32)(((u32)p[0] << 8) | ((u32)p[1] << 16) | ((u32)p[2] << 24)) >> 8) / 8388608.0f;
+            default:
+                break;
+        }
+
+        u32 v = read_u32(p);
+        if (fmt.format == 3)
+        {
+            f32 f;
+            memcpy(&f, &v, 4);
+            return f;
+        }
+
+        return (f32)(s32)v / 2147483648.0f;
+    }
+
+    // decodes frames to num_out_channels (1 or 2) interleaved, extra source channels are dropped
+    void decode_frames(const u8* src, const wav_format& fmt, u32 num_frames, f32* dst, u32 num_out_channels)
+    {
+        for (u32 i = 0; i < num_frames; ++i)
+        {
+            const u8* frame = src + i * fmt.frame_size;
+            for (u32 c = 0; c < num_out_channels; ++c)
+            {
+                u32 sc = std::min(c, fmt.channels - 1);
+                *dst++ = decode_sample(frame + sc * fmt.bits / 8, fmt);
+            }
+        }
+    }
+
+    bool is_ogg(const u8* data, u32 size)
+    {
+        return size >= 4 && memcmp(data, "OggS", 4) == 0;
+    }
+
+    //
+    // sources
+    //
+
+    void stream_open(voice* v)
+    {
+        sound* s = v->snd;
+        if (!s->filename)
+            return;
+
+        v->stream.file = fopen(pen::os_path_for_resource(s->filename), "rb");
+        v->stream.frames = (f32*)pen::memory_alloc(MIXER_STREAM_WINDOW * 2 * sizeof(f32));
+        v->stream.raw = (u8*)pen::memory_alloc(MIXER_STREAM_WINDOW * s->format.frame_size);
+        v->stream.start = 0;
+        v->stream.count = 0;
+    }
+
+    void stream_close(voice* v)
+    {
+        if (v->stream.file)
+            fclose(v->stream.file);
+
+        pen::memory_free(v->stream.frames);
+        pen::memory_free(v->stream.raw);
+        v->stream = stream_window();
+    }
+
+    void stream_refill(voice* v, u64 first)
+    {
+        sound*            s = v->snd;
+        const wav_format& fmt = s->format;
+        stream_window&    sw = v->stream;
+
+        sw.start = first;
+        sw.count = 0;
+
+        while (sw.count < MIXER_STREAM_WINDOW)
+        {
+            u64 frame = first + sw.count;
+            if (!s->loop && frame >= s->num_frames)
+                break;
+
+            u32 src = (u32)(frame % s->num_frames);
+            u32 n = std::min<u32>(MIXER_STREAM_WINDOW - sw.count, s->num_frames - src);
+
+            fseek(sw.file, fmt.data_offset + src * fmt.frame_size, SEEK_SET);
+            u32 read = (u32)fread(sw.raw, fmt.frame_size, n, sw.file);
+
+            decode_frames(sw.raw, fmt, read, sw.frames + sw.count * 2, 2);
+            sw.count += read;
+
+            if (read < n)
+                break;
+        }
+    }
+
+    // copies count frames from first to stereo dst, loops wrap and one shots are zero past the end
+    void gather(voice* v, u64 first, u32 count, f32* dst)
+    {
+        sound* s = v->snd;
+
+        if (!s->samples)
+        {
+            stream_window& sw = v->stream;
+            if (!sw.file)
+            {
+                memset(dst, 0, count * 2 * sizeof(f32));
+                return;
+            }
+
+            if (first < sw.start || first + count > sw.start + sw.count)
+                stream_refill(v, first);
+
+            u32 offset = (u32)(first - sw.start);
+            u32 avail = sw.count > offset ? std::min(count, sw.count - offset) : 0;
+
+            memcpy(dst, sw.frames + offset * 2, avail * 2 * sizeof(f32));
+            memset(dst + avail * 2, 0, (count - avail) * 2 * sizeof(f32));
+            return;
+        }
+
+        u32 done = 0;
+        while (done < count)
+        {
+            u64 frame = first + done;
+            if (!s->loop && frame >= s->num_frames)
+            {
+                memset(dst + done * 2, 0, (count - done) * 2 * sizeof(f32));
+                break;
+            }
+
+            u32 src = (u32)(frame % s->num_frames);
+            u32 n = std::min<u32>(count - done, s->num_frames - src);
+
+            if (s->num_channels == 2)
+            {
+                memcpy(dst + done * 2, s->samples + src * 2, n * 2 * sizeof(f32));
+            }
+            else
+            {
+                const f32* mono = s->samples + src;
+                f32*       out = dst + done * 2;
+                for (u32 i = 0; i < n; ++i)
+                {
+                    out[i * 2 + 0] = mono[i];
+                    out[i * 2 + 1] = mono[i];
+                }
+            }
+
+            done += n;
+        }
+    }
+
+    //
+    // kernels
+    //
+
+    // linear interpolation of stereo src from the 32.32 position pos, added to dst
+    void resample_add(const f32* src, u64 pos, u64 step, f32* dst, u32 num_frames)
+    {
+        u32 i = 0;
+
+#if PEN_SSE
+        for (; i + 2 <= num_frames; i += 2)
+        {
+            u32 i0 = (u32)(pos >> 32);
+            f32 f0 = (f32)(u32)pos * k_frac_scale;
+            pos += step;
+
+            u32 i1 = (u32)(pos >> 32);
+            f32 f1 = (f32)(u32)pos * k_frac_scale;
+            pos += step;
+
+            __m128 a = _mm_loadu_ps(src + i0 * 2); // l0 r0 l1 r1 around the first output frame
+            __m128 b = _mm_loadu_ps(src + i1 * 2); // and the second
+            __m128 lo = _mm_movelh_ps(a, b);
+            __m128 hi = _mm_movehl_ps(b, a);
+            __m128 f = _mm_set_ps(f1, f1, f0, f0);
+            __m128 r = _mm_add_ps(lo, _mm_mul_ps(_mm_sub_ps(hi, lo), f));
+
+            _mm_storeu_ps(dst + i * 2, _mm_add_ps(_mm_loadu_ps(dst + i * 2), r));
+        }
+#endif
+
+        for (; i < num_frames; ++i)
+        {
+            u32        i0 = (u32)(pos >> 32);
+            f32        f = (f32)(u32)pos * k_frac_scale;
+            const f32* s = src + i0 * 2;
+
+            dst[i * 2 + 0] += s[0] + (s[2] - s[0]) * f;
+            dst[i * 2 + 1] += s[1] + (s[3] - s[1]) * f;
+
+            pos += step;
+        }
+    }
+
+    // dst += src * gain ramped from g0 to g1 across the block
+    void add_ramped(const f32* src, f32* dst, u32 num_frames, f32 g0, f32 g1)
+    {
+        f32 d = (g1 - g0) / (f32)num_frames;
+        u32 i = 0;
+
+#if PEN_SSE
+        __m128 g = _mm_set_ps(g0 + d * 2.0f, g0 + d * 2.0f, g0 + d, g0 + d);
+        __m128 gd = _mm_set1_ps(d * 2.0f);
+        for (; i + 2 <= num_frames; i += 2)
+        {
+            __m128 s = _mm_loadu_ps(src + i * 2);
+            _mm_storeu_ps(dst + i * 2, _mm_add_ps(_mm_loadu_ps(dst + i * 2), _mm_mul_ps(s, g)));
+            g = _mm_add_ps(g, gd);
+        }
+#endif
+
+        for (; i < num_frames; ++i)
+        {
+            f32 gi = g0 + d * (f32)(i + 1);
+            dst[i * 2 + 0] += src[i * 2 + 0] * gi;
+            dst[i * 2 + 1] += src[i * 2 + 1] * gi;
+        }
+    }
+
+    void set_lowpass(biquad& bq, f32 hz, f32 sample_rate)
+    {
+        f32 w0 = 2.0f * (f32)M_PI * std::min(hz, sample_rate * 0.45f) / sample_rate;
+        f32 cw = cosf(w0);
+        f32 alpha = sinf(w0) / (2.0f * 0.70710678f);
+        f32 a0 = 1.0f + alpha;
+
+        bq.b0 = (1.0f - cw) * 0.5f / a0;
+        bq.b1 = (1.0f - cw) / a0;
+        bq.b2 = bq.b0;
+        bq.a1 = -2.0f * cw / a0;
+        bq.a2 = (1.0f - alpha) / a0;
+        bq.z1[0] = bq.z1[1] = 0.0f;
+        bq.z2[0] = bq.z2[1] = 0.0f;
+    }
+
+    inline f32 biquad_tick(biquad& bq, u32 c, f32 x)
+    {
+        f32 y = bq.b0 * x + bq.z1[c];
+        bq.z1[c] = bq.b1 * x - bq.a1 * y + bq.z2[c];
+        bq.z2[c] = bq.b2 * x - bq.a2 * y;
+        return y;
+    }
+
+    // low and high crossovers, the mid band is what is left so flat gains pass the signal through unchanged
+    void process_eq(dsp* d, f32* bus, u32 num_frames, f32 k)
+    {
+        f32 g0[3];
+        f32 gd[3];
+        for (u32 b = 0; b < 3; ++b)
+        {
+            g0[b] = d->smooth_gain[b];
+            d->smooth_gain[b] = smooth(g0[b], db_to_linear(d->params[b]), k);
+            gd[b] = (d->smooth_gain[b] - g0[b]) / (f32)num_frames;
+        }
+
+        for (u32 i = 0; i < num_frames; ++i)
+        {
+            f32 t = (f32)(i + 1);
+            f32 gl = g0[0] + gd[0] * t;
+            f32 gm = g0[1] + gd[1] * t;
+            f32 gh = g0[2] + gd[2] * t;
+
+            for (u32 c = 0; c < 2; ++c)
+            {
+                f32 x = bus[i * 2 + c];
+                f32 low = biquad_tick(d->low[1], c, biquad_tick(d->low[0], c, x));
+                f32 lp_high = biquad_tick(d->high[1], c, biquad_tick(d->high[0], c, x));
+
+                bus[i * 2 + c] = gh * x + (gm - gh) * lp_high + (gl - gm) * low;
+            }
+        }
+    }
+
+    void process_gain(dsp* d, f32* bus, u32 num_frames, f32 k)
+    {
+        f32 g0 = d->smooth_gain[0];
+        f32 g1 = smooth(g0, db_to_linear(d->params[0]), k);
+        f32 gd = (g1 - g0) / (f32)num_frames;
+
+        for (u32 i = 0; i < num_frames; ++i)
+        {
+            f32 g = g0 + gd * (f32)(i + 1);
+            bus[i * 2 + 0] *= g;
+            bus[i * 2 + 1] *= g;
+        }
+
+        d->smooth_gain[0] = g1;
+    }
+
+    void capture_fft(dsp* d, const f32* bus, u32 num_frames)
+    {
+        for (u32 i = 0; i < num_frames; ++i)
+        {
+            d->history[d->history_pos * 2 + 0] = bus[i * 2 + 0];
+            d->history[d->history_pos * 2 + 1] = bus[i * 2 + 1];
+            d->history_pos = (d->history_pos + 1) % MIXER_FFT_WINDOW;
+        }
+    }
+
+    // in place radix 2 on interleaved complex
+    void fft(f32* z, const f32* twiddle, u32 n)
+    {
+        for (u32 i = 1, j = 0; i < n; ++i)
+        {
+            u32 bit = n >> 1;
+            for (; j & bit; bit >>= 1)
+                j ^= bit;
+
+            j ^= bit;
+
+            if (i < j)
+            {
+                std::swap(z[i * 2 + 0], z[j * 2 + 0]);
+                std::swap(z[i * 2 + 1], z[j * 2 + 1]);
+            }
+        }
+
+        for (u32 len = 2; len <= n; len <<= 1)
+        {
+            u32 half = len >> 1;
+            u32 tstep = n / len;
+
+            for (u32 i = 0; i < n; i += len)
+            {
+                for (u32 k = 0; k < half; ++k)
+                {
+                    f32 wr = twiddle[k * tstep * 2 + 0];
+                    f32 wi = twiddle[k * tstep * 2 + 1];
+
+                    f32* a = &z[(i + k) * 2];
+                    f32* b = &z[(i + k + half) * 2];
+
+                    f32 br = b[0] * wr - b[1] * wi;
+                    f32 bi = b[0] * wi + b[1] * wr;
+
+                    b[0] = a[0] - br;
+                    b[1] = a[1] - bi;
+                    a[0] += br;
+                    a[1] += bi;
+                }
+            }
+        }
+    }
+
+    void mix_voice(mixer_context* m, voice* v, f32 pitch, f32* bus, u32 num_frames, f32 k)
+    {
+        sound* s = v->snd;
+
+        v->smooth_frequency = smooth(v->smooth_frequency, v->frequency, k);
+
+        f64 rate = (f64)v->smooth_frequency * (f64)pitch / (f64)m->sample_rate;
+        rate = std::min(std::max(rate, 0.0), (f64)k_max_step);
+
+        u64 step = (u64)(rate * 4294967296.0);
+        u64 first = v->position >> 32;
+        u64 last = (v->position + step * (num_frames - 1)) >> 32;
+        u32 count = (u32)(last - first) + 2;
+
+        gather(v, first, count, m->staging);
+        resample_add(m->staging, v->position & 0xffffffff, step, bus, num_frames);
+
+        v->position += step * num_frames;
+
+        u64 frames = (u64)s->num_frames << 32;
+        if (s->loop)
+        {
+            // streams keep counting so their decode window stays valid across the loop point
+            if (s->samples)
+                v->position %= frames;
+        }
+        else if (v->position >= frames)
+        {
+            v->playing = false;
+        }
+    }
+
+    void mix_block(mixer_context* m, f32* output, u32 num_frames)
+    {
+        memset(m->master, 0, num_frames * 2 * sizeof(f32));
+
+        u32 num_groups = sb_count(m->groups);
+        for (u32 g = 0; g < num_groups; ++g)
+            memset(m->groups[g]->bus, 0, num_frames * 2 * sizeof(f32));
+
+        m->stats.num_voices = 0;
+
+        // the same smoothing for every block size, so results do not depend on how the mix is split up
+        f32 k = 1.0f - expf(-(f32)num_frames / ((f32)m->sample_rate * k_smooth_seconds));
+
+        for (u32 g = 0; g < num_groups; ++g)
+            m->groups[g]->smooth_pitch = smooth(m->groups[g]->smooth_pitch, m->groups[g]->pitch, k);
+
+        u32 num_voices = sb_count(m->voices);
+        for (u32 i = 0; i < num_voices; ++i)
+        {
+            voice* v = m->voices[i];
+            if (!v->playing || !v->snd)
+                continue;
+
+            if (v->grp && v->grp->paused)
+                continue;
+
+            f32* bus = v->grp ? v->grp->bus : m->master;
+            f32  pitch = v->grp ? v->grp->smooth_pitch : 1.0f;
+
+            mix_voice(m, v, pitch, bus, num_frames, k);
+            m->stats.num_voices++;
+        }
+
+        for (u32 i = 0; i < num_groups; ++i)
+        {
+            group* g = m->groups[i];
+
+            // the last dsp added is the first in the chain
+            for (s32 d = (s32)g->num_dsp - 1; d >= 0; --d)
+            {
+                dsp* gd = g->dsps[d];
+                switch (gd->type)
+                {
+                    case DSP_THREE_BAND_EQ:
+                        process_eq(gd, g->bus, num_frames, k);
+                        break;
+                    case DSP_GAIN:
+                        process_gain(gd, g->bus, num_frames, k);
+                        break;
+                    case DSP_FFT:
+                        capture_fft(gd, g->bus, num_frames);
+                        break;
+                }
+            }
+
+            f32 v0 = g->smooth_volume;
+            g->smooth_volume = smooth(v0, g->muted ? 0.0f : g->volume, k);
+            add_ramped(g->bus, m->master, num_frames, v0, g->smooth_volume);
+        }
+
+        memcpy(output, m->master, num_frames * 2 * sizeof(f32));
+        m->stats.frames_mixed += num_frames;
+    }
+
+    void free_dsp(dsp* d)
+    {
+        pen::memory_free(d->history);
+        pen::memory_free(d->window);
+        pen::memory_free(d->twiddle);
+        pen::memory_free(d->work);
+        pen::memory_free(d->spectrum_data);
+        delete d;
+    }
+
+    template <typename T>
+    void remove_item(T**& list, T* item)
+    {
+        u32 count = sb_count(list);
+        for (u32 i = 0; i < count; ++i)
+        {
+            if (list[i] != item)
+                continue;
+
+            list[i] = list[count - 1];
+            stb__sbn(list)--;
+            return;
+        }
+    }
+} // namespace
+
+namespace put
+{
+    namespace mixer
+    {
+        mixer_context* create_mixer(u32 sample_rate)
+        {
+            mixer_context* m = new mixer_context();
+            m->sample_rate = sample_rate;
+            m->staging = (f32*)pen::memory_alloc(k_staging_frames * 2 * sizeof(f32));
+            return m;
+        }
+
+        void destroy_mixer(mixer_context* m)
+        {
+            while (sb_count(m->voices))
+                release_voice(m, m->voices[0]);
+
+            while (sb_count(m->groups))
+                release_group(m, m->groups[0]);
+
+            while (sb_count(m->sounds))
+                release_sound(m, m->sounds[0]);
+
+            sb_free(m->voices);
+            sb_free(m->groups);
+            sb_free(m->sounds);
+            pen::memory_free(m->staging);
+            delete m;
+        }
+
+        u32 get_sample_rate(const mixer_context* m)
+        {
+            return m->sample_rate;
+        }
+
+        void mix(mixer_context* m, f32* output, u32 num_frames)
+        {
+#if PEN_SSE
+            // flush denormals, filter tails decaying towards 0 would otherwise be very slow
+            u32 csr = _mm_getcsr();
+            _mm_setcsr(csr | 0x8040);
+#endif
+
+            while (num_frames > 0)
+            {
+                u32 n = std::min<u32>(num_frames, MIXER_BLOCK_FRAMES);
+                mix_block(m, output, n);
+
+                output += n * 2;
+                num_frames -= n;
+            }
+
+#if PEN_SSE
+            _mm_setcsr(csr);
+#endif
+        }
+
+        mixer_stats get_stats(const mixer_context* m)
+        {
+            return m->stats;
+        }
+
+        sound* create_sound(mixer_context* m, const c8* filename, bool stream)
+        {
+            wav_format fmt;
+
+            if (stream)
+            {
+                // only the header is read now
+                FILE* f = fopen(pen::os_path_for_resource(filename), "rb");
+                if (!f)
+                {
+                    PEN_LOG("[audio] failed to open %s\n", filename);
+                    return nullptr;
+                }
+
+                fseek(f, 0, SEEK_END);
+                u32 file_size = (u32)ftell(f);
+                fseek(f, 0, SEEK_SET);
+
+                u8  header[4096];
+                u32 header_size = (u32)fread(header, 1, sizeof(header), f);
+                fclose(f);
+
+                if (!parse_wav(header, header_size, file_size, fmt))
+                {
+                    PEN_LOG("[audio] %s is not a supported wav file%s\n", filename,
+                            is_ogg(header, header_size) ? ", ogg is not supported by the native mixer" : "");
+                    return nullptr;
+                }
+
+                sound* s = new sound();
+                s->num_frames = fmt.num_frames;
+                s->num_channels = std::min<u32>(fmt.channels, 2);
+                s->sample_rate = fmt.sample_rate;
+                s->loop = true;
+                s->format = fmt;
+
+                u32 len = pen::string_length(filename);
+                s->filename = (c8*)pen::memory_alloc(len + 1);
+                memcpy(s->filename, filename, len + 1);
+
+                sb_push(m->sounds, s);
+                return s;
+            }
+
+            void* data = nullptr;
+            u32   size = 0;
+            if (pen::filesystem_read_file_to_buffer(filename, &data, size) != PEN_ERR_OK)
+            {
+                PEN_LOG("[audio] failed to open %s\n", filename);
+                return nullptr;
+            }
+
+            if (!parse_wav((const u8*)data, size, size, fmt))
+            {
+                PEN_LOG("[audio] %s is not a supported wav file%s\n", filename,
+                        is_ogg((const u8*)data, size) ? ", ogg is not supported by the native mixer" : "");
+                pen::memory_free(data);
+                return nullptr;
+            }
+
+            sound* s = new sound();
+            s->num_frames = fmt.num_frames;
+            s->num_channels = std::min<u32>(fmt.channels, 2);
+            s->sample_rate = fmt.sample_rate;
+            s->format = fmt;
+            s->samples = (f32*)pen::memory_alloc(std::max<u32>(s->num_frames, 1) * s->num_channels * sizeof(f32));
+
+            decode_frames((const u8*)data + fmt.data_offset, fmt, s->num_frames, s->samples, s->num_channels);
+            pen::memory_free(data);
+
+            sb_push(m->sounds, s);
+            return s;
+        }
+
+        sound* create_sound(mixer_context* m, const f32* samples, u32 num_frames, u32 num_channels, u32 sample_rate,
+                            bool loop)
+        {
+            sound* s = new sound();
+            s->num_frames = num_frames;
+            s->num_channels = std::min<u32>(num_channels, 2);
+            s->sample_rate = sample_rate;
+            s->loop = loop;
+            s->samples = (f32*)pen::memory_alloc(std::max<u32>(num_frames, 1) * s->num_channels * sizeof(f32));
+
+            for (u32 i = 0; i < num_frames; ++i)
+                for (u32 c = 0; c < s->num_channels; ++c)
+                    s->samples[i * s->num_channels + c] = samples[i * num_channels + c];
+
+            sb_push(m->sounds, s);
+            return s;
+        }
+
+        void release_sound(mixer_context* m, sound* s)
+        {
+            if (!s)
+                return;
+
+            u32 num_voices = sb_count(m->voices);
+            for (u32 i = 0; i < num_voices; ++i)
+            {
+                voice* v = m->voices[i];
+                if (v->snd != s)
+                    continue;
+
+                stream_close(v);
+                v->playing = false;
+                v->snd = nullptr;
+            }
+
+            remove_item(m->sounds, s);
+
+            pen::memory_free(s->samples);
+            pen::memory_free(s->filename);
+            delete s;
+        }
+
+        u32 get_length_ms(const sound* s)
+        {
+            return (u32)((u64)s->num_frames * 1000 / s->sample_rate);
+        }
+
+        voice* play_sound(mixer_context* m, sound* s)
+        {
+            if (!s || s->num_frames == 0)
+                return nullptr;
+
+            voice* v = new voice();
+            v->snd = s;
+            v->frequency = (f32)s->sample_rate;
+            v->smooth_frequency = v->frequency;
+            v->playing = true;
+
+            if (!s->samples)
+                stream_open(v);
+
+            sb_push(m->voices, v);
+            return v;
+        }
+
+        void release_voice(mixer_context* m, voice* v)
+        {
+            if (!v)
+                return;
+
+            stream_close(v);
+            remove_item(m->voices, v);
+            delete v;
+        }
+
+        void voice_set_group(voice* v, group* g)
+        {
+            if (v)
+                v->grp = g;
+        }
+
+        void voice_set_position(voice* v, u32 position_ms)
+        {
+            if (!v || !v->snd)
+                return;
+
+            u64 frame = (u64)position_ms * v->snd->sample_rate / 1000;
+            v->position = std::min<u64>(frame, v->snd->num_frames) << 32;
+        }
+
+        void voice_set_frequency(voice* v, f32 frequency)
+        {
+            if (v)
+                v->frequency = std::max(frequency, 0.0f);
+        }
+
+        void voice_stop(voice* v)
+        {
+            if (v)
+                v->playing = false;
+        }
+
+        void voice_get_state(const voice* v, voice_state& state)
+        {
+            state = voice_state();
+            if (!v || !v->snd)
+                return;
+
+            u64 frames = v->snd->num_frames;
+            u64 frame = (v->position >> 32) % std::max<u64>(frames, 1);
+
+            state.play_state = NOT_PLAYING;
+            if (v->playing)
+                state.play_state = v->grp && v->grp->paused ? PAUSED : PLAYING;
+
+            state.position_ms = (u32)(frame * 1000 / v->snd->sample_rate);
+            state.pitch = v->grp ? v->grp->pitch : 1.0f;
+            state.volume = v->grp ? v->grp->volume : 1.0f;
+            state.frequency = v->frequency;
+        }
+
+        group* create_group(mixer_context* m)
+        {
+            group* g = new group();
+            g->sample_rate = m->sample_rate;
+            sb_push(m->groups, g);
+            return g;
+        }
+
+        void release_group(mixer_context* m, group* g)
+        {
+            if (!g)
+                return;
+
+            u32 num_voices = sb_count(m->voices);
+            for (u32 i = 0; i < num_voices; ++i)
+                if (m->voices[i]->grp == g)
+                    m->voices[i]->grp = nullptr;
+
+            for (u32 i = 0; i < g->num_dsp; ++i)
+                free_dsp(g->dsps[i]);
+
+            remove_item(m->groups, g);
+            delete g;
+        }
+
+        void group_set_paused(group* g, bool paused)
+        {
+            if (g)
+                g->paused = paused;
+        }
+
+        void group_set_muted(group* g, bool muted)
+        {
+            if (g)
+                g->muted = muted;
+        }
+
+        void group_set_pitch(group* g, f32 pitch)
+        {
+            if (g)
+                g->pitch = std::max(pitch, 0.0f);
+        }
+
+        void group_set_volume(group* g, f32 volume)
+        {
+            if (g)
+                g->volume = std::max(volume, 0.0f);
+        }
+
+        void group_get_state(const mixer_context* m, const group* g, audio_group_state& state)
+        {
+            state.play_state = NOT_PLAYING;
+            state.pitch = g->pitch;
+            state.volume = g->volume;
+
+            u32 num_voices = sb_count(m->voices);
+            for (u32 i = 0; i < num_voices; ++i)
+            {
+                if (m->voices[i]->grp == g && m->voices[i]->playing)
+                {
+                    state.play_state = g->paused ? PAUSED : PLAYING;
+                    break;
+                }
+            }
+        }
+
+        dsp* group_add_dsp(group* g, dsp_type type)
+        {
+            if (!g || g->num_dsp >= MIXER_MAX_DSP)
+                return nullptr;
+
+            dsp* d = new dsp();
+            d->type = type;
+
+            for (u32 i = 0; i < 2; ++i)
+            {
+                set_lowpass(d->low[i], k_eq_low_hz, (f32)g->sample_rate);
+                set_lowpass(d->high[i], k_eq_high_hz, (f32)g->sample_rate);
+            }
+
+            if (type == DSP_FFT)
+            {
+                const u32 n = MIXER_FFT_WINDOW;
+
+                d->history = (f32*)pen::memory_calloc(n * 2, sizeof(f32));
+                d->window = (f32*)pen::memory_alloc(n * sizeof(f32));
+                d->twiddle = (f32*)pen::memory_alloc(n * sizeof(f32));
+                d->work = (f32*)pen::memory_alloc(n * 2 * sizeof(f32));
+                d->spectrum_data = (f32*)pen::memory_calloc(MIXER_FFT_LENGTH * 4, sizeof(f32));
+
+                for (u32 i = 0; i < n; ++i)
+                    d->window[i] = 0.5f - 0.5f * cosf(2.0f * (f32)M_PI * (f32)i / (f32)n);
+
+                for (u32 k = 0; k < n / 2; ++k)
+                {
+                    d->twiddle[k * 2 + 0] = cosf(-2.0f * (f32)M_PI * (f32)k / (f32)n);
+                    d->twiddle[k * 2 + 1] = sinf(-2.0f * (f32)M_PI * (f32)k / (f32)n);
+                }
+
+                for (u32 b = 0; b < 2; ++b)
+                {
+                    audio_fft_spectrum& sp = d->spectrum[b];
+                    memset(&sp, 0, sizeof(audio_fft_spectrum));
+                    sp.length = MIXER_FFT_LENGTH;
+                    sp.num_channels = 2;
+                    sp.spectrum[0] = d->spectrum_data + (b * 2 + 0) * MIXER_FFT_LENGTH;
+                    sp.spectrum[1] = d->spectrum_data + (b * 2 + 1) * MIXER_FFT_LENGTH;
+                }
+            }
+
+            g->dsps[g->num_dsp++] = d;
+            return d;
+        }
+
+        void dsp_set_three_band_eq(dsp* d, f32 low, f32 med, f32 high)
+        {
+            if (!d || d->type != DSP_THREE_BAND_EQ)
+                return;
+
+            d->params[0] = std::min(std::max(low, k_min_db), k_max_db);
+            d->params[1] = std::min(std::max(med, k_min_db), k_max_db);
+            d->params[2] = std::min(std::max(high, k_min_db), k_max_db);
+        }
+
+        void dsp_set_gain(dsp* d, f32 gain)
+        {
+            if (!d || d->type != DSP_GAIN)
+                return;
+
+            d->params[0] = std::min(std::max(gain, k_min_db), k_max_db);
+        }
+
+        void dsp_get_three_band_eq(const dsp* d, audio_eq_state& state)
+        {
+            state.low = d ? d->params[0] : 0.0f;
+            state.med = d ? d->params[1] : 0.0f;
+            state.high = d ? d->params[2] : 0.0f;
+        }
+
+        f32 dsp_get_gain(const dsp* d)
+        {
+            return d ? d->params[0] : 0.0f;
+        }
+
+        const audio_fft_spectrum* dsp_update_spectrum(dsp* d)
+        {
+            if (!d || d->type != DSP_FFT)
+                return nullptr;
+
+            const u32 n = MIXER_FFT_WINDOW;
+
+            // both real channels in one complex transform, left in the real part and right in the imaginary
+            for (u32 i = 0; i < n; ++i)
+            {
+                u32 h = (d->history_pos + i) % n;
+                d->work[i * 2 + 0] = d->history[h * 2 + 0] * d->window[i];
+                d->work[i * 2 + 1] = d->history[h * 2 + 1] * d->window[i];
+            }
+
+            fft(d->work, d->twiddle, n);
+
+            d->flip ^= 1;
+            audio_fft_spectrum& sp = d->spectrum[d->flip];
+
+            // a full scale sine at a bin centre has a magnitude of n / 4 through the hann window
+            const f32 scale = 4.0f / (f32)n;
+            for (u32 k = 0; k < MIXER_FFT_LENGTH; ++k)
+            {
+                const f32* zk = &d->work[k * 2];
+                const f32* zn = &d->work[((n - k) % n) * 2];
+
+                f32 lr = zk[0] + zn[0];
+                f32 li = zk[1] - zn[1];
+                f32 rr = zk[1] + zn[1];
+                f32 ri = zn[0] - zk[0];
+
+                sp.spectrum[0][k] = sqrtf(lr * lr + li * li) * 0.5f * scale;
+                sp.spectrum[1][k] = sqrtf(rr * rr + ri * ri) * 0.5f * scale;
+            }
+
+            return &sp;
+        }
+    } // namespace mixer
+} // namespace put
@@ -0,0 +1,100 @@
+// audio_mixer.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "audio.h"
+#include "pen.h"
+
+// Software mixer used by the native audio backend, it can also be driven directly (offline rendering, benchmarks).
+// Output is interleaved stereo float mixed in blocks of MIXER_BLOCK_FRAMES. Every voice gathers the source frames a
+// block needs into a contiguous stereo staging buffer (wrapping loops, zero filling past the end of one shots and
+// refilling the decode window of streams), then resamples it with linear interpolation and accumulates it into its
+// group 2 frames at a time with sse.
+// Groups run their dsps over the summed voices and add the result into the master output with their own volume.
+// Volume, pitch, frequency, eq and gain changes are smoothed with a 10ms one pole filter stepped once per block and
+// ramped across it, so parameter changes do not click or zip.
+// Like fmod the last dsp added to a group is the first to process the signal, so an fft added first sees the output of
+// anything added after it. Eq and gain parameters are in decibels.
+// Wav files (pcm 8, 16, 24 or 32 bit and float) are decoded whole as sounds or a window at a time as streams.
+// Nothing here is thread safe, all calls including mix must come from the same thread.
+
+namespace put
+{
+    namespace mixer
+    {
+        struct mixer_context;
+        struct sound;
+        struct voice;
+        struct group;
+        struct dsp;
+
+        enum e_mixer_constants
+        {
+            MIXER_BLOCK_FRAMES = 256,
+            MIXER_FFT_WINDOW = 2048,
+            MIXER_FFT_LENGTH = MIXER_FFT_WINDOW / 2,
+            MIXER_STREAM_WINDOW = 16384, // frames decoded per stream refill
+            MIXER_MAX_DSP = 8
+        };
+
+        struct voice_state
+        {
+            u32 play_state = NOT_PLAYING;
+            u32 position_ms = 0;
+            f32 pitch = 1.0f; // group pitch
+            f32 volume = 1.0f;
+            f32 frequency = 0.0f; // playback rate in hz, the sound's sample rate unless it has been changed
+        };
+
+        struct mixer_stats
+        {
+            u32 num_voices = 0; // voices mixed in the last block
+            u64 frames_mixed = 0;
+        };
+
+        mixer_context* create_mixer(u32 sample_rate);
+        void           destroy_mixer(mixer_context* m);
+        u32            get_sample_rate(const mixer_context* m);
+
+        // num_frames of interleaved stereo
+        void        mix(mixer_context* m, f32* output, u32 num_frames);
+        mixer_stats get_stats(const mixer_context* m);
+
+        // sounds are decoded when created, streams keep the file and decode as they play. streams loop, sounds do not
+        sound* create_sound(mixer_context* m, const c8* filename, bool stream);
+        sound* create_sound(mixer_context* m, const f32* samples, u32 num_frames, u32 num_channels, u32 sample_rate,
+                            bool loop);
+        void   release_sound(mixer_context* m, sound* s); // stops any voices playing it
+        u32    get_length_ms(const sound* s);
+
+        // voices stay allocated after they stop so their state can be read, release them when done
+        voice* play_sound(mixer_context* m, sound* s);
+        void   release_voice(mixer_context* m, voice* v);
+        void   voice_set_group(voice* v, group* g); // null for the master output
+        void   voice_set_position(voice* v, u32 position_ms);
+        void   voice_set_frequency(voice* v, f32 frequency);
+        void   voice_stop(voice* v);
+        void   voice_get_state(const voice* v, voice_state& state);
+
+        group* create_group(mixer_context* m);
+        void   release_group(mixer_context* m, group* g); // voices in the group move to the master output
+        void   group_set_paused(group* g, bool paused);
+        void   group_set_muted(group* g, bool muted);
+        void   group_set_pitch(group* g, f32 pitch);
+        void   group_set_volume(group* g, f32 volume);
+        void   group_get_state(const mixer_context* m, const group* g, audio_group_state& state);
+
+        // dsps are owned by their group and released with it
+        dsp* group_add_dsp(group* g, dsp_type type);
+        void dsp_set_three_band_eq(dsp* d, f32 low, f32 med, f32 high);
+        void dsp_set_gain(dsp* d, f32 gain);
+        void dsp_get_three_band_eq(const dsp* d, audio_eq_state& state);
+        f32  dsp_get_gain(const dsp* d);
+
+        // spectrum of the last MIXER_FFT_WINDOW frames through the dsp, magnitudes of a full scale sine are 1.
+        // the returned pointers stay valid until the call after next, the native backend double buffers its states
+        const audio_fft_spectrum* dsp_update_spectrum(dsp* d);
+    } // namespace mixer
+} // namespace put
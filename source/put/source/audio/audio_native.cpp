@@ -0,0 +1,739 @@
+// audio_native.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+// Audio backend built on the software mixer in audio_mixer.h, selected with --audio=native.
+// Mixing happens on the audio thread, direct::audio_system_mix is called every time round its loop and renders as many
+// frames as the output needs to stay latency_ms ahead. The device output on linux is alsa, loaded at runtime so there is
+// no link or header dependency, if it is not available or on other platforms the null output is used instead.
+// The file output writes 16 bit wav and the null output discards, both are paced by a timer to run in real time.
+
+#include "audio.h"
+#include "audio_mixer.h"
+
+#include "console.h"
+#include "data_struct.h"
+#include "memory.h"
+#include "slot_resource.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+#ifdef __linux__
+#include <dlfcn.h>
+#endif
+
+using namespace put;
+
+namespace
+{
+    enum audio_resource_type : s32
+    {
+        AUDIO_RESOURCE_VIRTUAL,
+        AUDIO_RESOURCE_SOUND,
+        AUDIO_RESOURCE_CHANNEL,
+        AUDIO_RESOURCE_GROUP,
+        AUDIO_RESOURCE_DSP_FFT,
+        AUDIO_RESOURCE_DSP_EQ,
+        AUDIO_RESOURCE_DSP_GAIN,
+        AUDIO_RESOURCE_DSP
+    };
+
+    struct audio_resource_allocation
+    {
+        void* resource;
+        u32   group = 0; // dsps are owned by their group and released with it
+
+        audio_resource_type type;
+
+        std::atomic<u8> assigned_flag;
+    };
+
+    struct resource_state
+    {
+        audio_resource_type type; // AUDIO_RESOURCE_VIRTUAL if the slot is not assigned
+
+        union {
+            audio_channel_state   channel_state;
+            audio_group_state     group_state;
+            audio_sound_file_info file_info;
+            audio_fft_spectrum    fft_spectrum; // points to spectrum data owned by the same snapshot
+            audio_eq_state        eq_state;
+            f32                   gain_value;
+        };
+    };
+
+    // subset of alsa, the values match alsa/pcm.h
+    typedef void snd_pcm_t;
+
+    enum alsa_constants
+    {
+        SND_PCM_STREAM_PLAYBACK = 0,
+        SND_PCM_FORMAT_S16_LE = 2,
+        SND_PCM_ACCESS_RW_INTERLEAVED = 3,
+        SND_PCM_NONBLOCK = 1
+    };
+
+    typedef int (*pfn_snd_pcm_open)(snd_pcm_t**, const char*, int, int);
+    typedef int (*pfn_snd_pcm_set_params)(snd_pcm_t*, int, int, unsigned int, unsigned int, int, unsigned int);
+    typedef long (*pfn_snd_pcm_avail_update)(snd_pcm_t*);
+    typedef long (*pfn_snd_pcm_writei)(snd_pcm_t*, const void*, unsigned long);
+    typedef int (*pfn_snd_pcm_recover)(snd_pcm_t*, int, int);
+    typedef int (*pfn_snd_pcm_close)(snd_pcm_t*);
+
+    struct alsa_api
+    {
+        void*                    lib = nullptr;
+        pfn_snd_pcm_open         pcm_open;
+        pfn_snd_pcm_set_params   pcm_set_params;
+        pfn_snd_pcm_avail_update pcm_avail_update;
+        pfn_snd_pcm_writei       pcm_writei;
+        pfn_snd_pcm_recover      pcm_recover;
+        pfn_snd_pcm_close        pcm_close;
+    };
+
+    struct audio_output
+    {
+        u32         sink = AUDIO_OUTPUT_NULL;
+        u32         sample_rate = 0;
+        u32         latency_frames = 0;
+        snd_pcm_t*  pcm = nullptr;
+        FILE*       file = nullptr;
+        u32         file_frames = 0;
+        pen::timer* timer = nullptr;
+        f64         frames_due = 0.0; // timer paced outputs
+    };
+
+    static const u32 k_mix_frames = 1024;
+
+    mixer::mixer_context*                     _mixer;
+    audio_output                              _output;
+    alsa_api                                  _alsa;
+    f32                                       _mix_buffer[k_mix_frames * 2];
+    s16                                       _pcm_buffer[k_mix_frames * 2];
+    pen::res_pool<audio_resource_allocation>  _audio_resources;
+    pen::triple_array_buffer<resource_state>  _resource_states;
+    pen::res_pool<f32*>                       _spectrum_data[3]; // per snapshot, per fft dsp
+    pen::res_pool<audio_sound_file_info>      _sound_file_info;
+
+    bool alsa_open(u32 sample_rate, u32 latency_ms)
+    {
+#ifdef __linux__
+        _alsa.lib = dlopen("libasound.so.2", RTLD_NOW);
+        if (!_alsa.lib)
+            return false;
+
+        _alsa.pcm_open = (pfn_snd_pcm_open)dlsym(_alsa.lib, "snd_pcm_open");
+        _alsa.pcm_set_params = (pfn_snd_pcm_set_params)dlsym(_alsa.lib, "snd_pcm_set_params");
+        _alsa.pcm_avail_update = (pfn_snd_pcm_avail_update)dlsym(_alsa.lib, "snd_pcm_avail_update");
+        _alsa.pcm_writei = (pfn_snd_pcm_writei)dlsym(_alsa.lib, "snd_pcm_writei");
+        _alsa.pcm_recover = (pfn_snd_pcm_recover)dlsym(_alsa.lib, "snd_pcm_recover");
+        _alsa.pcm_close = (pfn_snd_pcm_close)dlsym(_alsa.lib, "snd_pcm_close");
+
+        if (_alsa.pcm_open && _alsa.pcm_set_params && _alsa.pcm_avail_update && _alsa.pcm_writei && _alsa.pcm_recover &&
+            _alsa.pcm_close)
+        {
+            if (_alsa.pcm_open(&_output.pcm, "default", SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK) == 0)
+            {
+                if (_alsa.pcm_set_params(_output.pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, 2,
+                                         sample_rate, 1, latency_ms * 1000) == 0)
+                    return true;
+
+                _alsa.pcm_close(_output.pcm);
+                _output.pcm = nullptr;
+            }
+        }
+
+        dlclose(_alsa.lib);
+        _alsa.lib = nullptr;
+#endif
+        return false;
+    }
+
+    void write_u16(FILE* f, u16 v)
+    {
+        u8 b[2] = {(u8)v, (u8)(v >> 8)};
+        fwrite(b, 1, 2, f);
+    }
+
+    void write_u32(FILE* f, u32 v)
+    {
+        u8 b[4] = {(u8)v, (u8)(v >> 8), (u8)(v >> 16), (u8)(v >> 24)};
+        fwrite(b, 1, 4, f);
+    }
+
+    // sizes are patched when the file is closed
+    void write_wav_header(FILE* f, u32 sample_rate, u32 num_frames)
+    {
+        u32 data_size = num_frames * 4;
+
+        fwrite("RIFF", 1, 4, f);
+        write_u32(f, 36 + data_size);
+        fwrite("WAVEfmt ", 1, 8, f);
+        write_u32(f, 16);
+        write_u16(f, 1);
+        write_u16(f, 2);
+        write_u32(f, sample_rate);
+        write_u32(f, sample_rate * 4);
+        write_u16(f, 4);
+        write_u16(f, 16);
+        fwrite("data", 1, 4, f);
+        write_u32(f, data_size);
+    }
+
+    void output_open(const audio_output_params& params)
+    {
+        _output.sink = params.sink;
+        _output.sample_rate = params.sample_rate;
+        _output.latency_frames = params.sample_rate * params.latency_ms / 1000;
+
+        if (_output.sink == AUDIO_OUTPUT_DEVICE && !alsa_open(params.sample_rate, params.latency_ms))
+        {
+            PEN_LOG("[audio] no output device available, audio will not be heard\n");
+            _output.sink = AUDIO_OUTPUT_NULL;
+        }
+
+        if (_output.sink == AUDIO_OUTPUT_FILE)
+        {
+            _output.file = params.filename ? fopen(params.filename, "wb") : nullptr;
+            if (_output.file)
+            {
+                write_wav_header(_output.file, params.sample_rate, 0);
+            }
+            else
+            {
+                PEN_LOG("[audio] failed to open output file %s\n", params.filename ? params.filename : "");
+                _output.sink = AUDIO_OUTPUT_NULL;
+            }
+        }
+
+        // timer paced outputs start with a latency worth of frames
+        _output.timer = pen::timer_create();
+        _output.frames_due = (f64)_output.latency_frames;
+        pen::timer_start(_output.timer);
+    }
+
+    void output_close()
+    {
+        if (_output.pcm)
+        {
+            _alsa.pcm_close(_output.pcm);
+            _output.pcm = nullptr;
+        }
+
+#ifdef __linux__
+        if (_alsa.lib)
+            dlclose(_alsa.lib);
+
+        _alsa.lib = nullptr;
+#endif
+
+        if (_output.file)
+        {
+            fseek(_output.file, 0, SEEK_SET);
+            write_wav_header(_output.file, _output.sample_rate, _output.file_frames);
+            fclose(_output.file);
+            _output.file = nullptr;
+        }
+    }
+
+    u32 output_frames_needed()
+    {
+        if (_output.pcm)
+        {
+            long avail = _alsa.pcm_avail_update(_output.pcm);
+            if (avail < 0)
+            {
+                _alsa.pcm_recover(_output.pcm, (int)avail, 1);
+                avail = _alsa.pcm_avail_update(_output.pcm);
+            }
+
+            return avail > 0 ? (u32)avail : 0;
+        }
+
+        f32 elapsed_ms = pen::timer_elapsed_ms(_output.timer);
+        pen::timer_start(_output.timer);
+
+        // if the thread stalls catch up by no more than the latency, rather than with a burst of the whole stall
+        _output.frames_due += (f64)elapsed_ms * (f64)_output.sample_rate / 1000.0;
+        _output.frames_due = std::min(_output.frames_due, (f64)_output.latency_frames * 2.0);
+
+        return (u32)_output.frames_due;
+    }
+
+    void output_write(const f32* frames, u32 num_frames)
+    {
+        if (_output.sink == AUDIO_OUTPUT_NULL)
+        {
+            _output.frames_due -= num_frames;
+            return;
+        }
+
+        for (u32 i = 0; i < num_frames * 2; ++i)
+        {
+            f32 s = std::min(std::max(frames[i], -1.0f), 1.0f);
+            _pcm_buffer[i] = (s16)lrintf(s * 32767.0f);
+        }
+
+        if (_output.pcm)
+        {
+            long written = _alsa.pcm_writei(_output.pcm, _pcm_buffer, num_frames);
+            if (written < 0)
+                _alsa.pcm_recover(_output.pcm, (int)written, 1);
+
+            return;
+        }
+
+        // wav data is little endian
+        u8* bytes = (u8*)_pcm_buffer;
+        for (u32 i = 0; i < num_frames * 2; ++i)
+        {
+            u16 v = (u16)_pcm_buffer[i];
+            bytes[i * 2 + 0] = (u8)v;
+            bytes[i * 2 + 1] = (u8)(v >> 8);
+        }
+
+        fwrite(_pcm_buffer, 4, num_frames, _output.file);
+        _output.file_frames += num_frames;
+        _output.frames_due -= num_frames;
+    }
+
+    void alloc_resource(u32 resource_slot, audio_resource_type type, void* resource)
+    {
+        _audio_resources.grow(resource_slot);
+        _sound_file_info.grow(resource_slot);
+
+        _audio_resources[resource_slot].resource = resource;
+        _audio_resources[resource_slot].type = type;
+        _audio_resources[resource_slot].group = 0;
+        _audio_resources[resource_slot].assigned_flag |= 0xff;
+    }
+
+    u32 create_sound(const c8* filename, u32 resource_slot, bool stream)
+    {
+        mixer::sound* snd = mixer::create_sound(_mixer, filename, stream);
+
+        alloc_resource(resource_slot, AUDIO_RESOURCE_SOUND, snd);
+
+        _sound_file_info[resource_slot].length_ms = snd ? mixer::get_length_ms(snd) : 0;
+
+        return resource_slot;
+    }
+} // namespace
+
+namespace put
+{
+    void direct::audio_system_initialise(const audio_output_params& params)
+    {
+        static u32 reserved = 128;
+
+        _audio_resources.init(reserved);
+        _sound_file_info.init(reserved);
+        _resource_states.init(reserved);
+
+        for (u32 i = 0; i < 3; ++i)
+            _spectrum_data[i].init(reserved);
+
+        _mixer = mixer::create_mixer(params.sample_rate);
+        output_open(params);
+    }
+
+    void direct::audio_system_shutdown()
+    {
+        for (s32 i = 0; i < _audio_resources._capacity; ++i)
+            if (_audio_resources[i].assigned_flag)
+                direct::audio_release_resource(i);
+
+        output_close();
+        mixer::destroy_mixer(_mixer);
+        _mixer = nullptr;
+
+        for (u32 i = 0; i < 3; ++i)
+            for (s32 j = 0; j < _spectrum_data[i]._capacity; ++j)
+                pen::memory_free(_spectrum_data[i][j]);
+    }
+
+    u32 direct::audio_system_mix(u64 until)
+    {
+        u64 time = direct::audio_system_get_time();
+        if (until <= time)
+            return 0;
+
+        u32 frames = (u32)std::min<u64>(output_frames_needed(), until - time);
+        u32 mixed = frames;
+
+        while (frames > 0)
+        {
+            u32 n = std::min(frames, k_mix_frames);
+
+            mixer::mix(_mixer, _mix_buffer, n);
+            output_write(_mix_buffer, n);
+
+            frames -= n;
+        }
+
+        return mixed;
+    }
+
+    u64 direct::audio_system_get_time()
+    {
+        return mixer::get_stats(_mixer).frames_mixed;
+    }
+
+    u32 direct::audio_system_get_sample_rate()
+    {
+        return mixer::get_sample_rate(_mixer);
+    }
+
+    void direct::audio_system_acquire_state()
+    {
+        _resource_states.acquire();
+    }
+
+    void update_channel_state(u32 resource_index, resource_state& rs)
+    {
+        mixer::voice_state vs;
+        mixer::voice_get_state((mixer::voice*)_audio_resources[resource_index].resource, vs);
+
+        audio_channel_state* state = &rs.channel_state;
+        state->play_state = vs.play_state;
+        state->position_ms = vs.position_ms;
+        state->pitch = vs.pitch;
+        state->volume = vs.volume;
+        state->frequency = vs.frequency;
+    }
+
+    void update_group_state(u32 resource_index, resource_state& rs)
+    {
+        mixer::group_get_state(_mixer, (mixer::group*)_audio_resources[resource_index].resource, rs.group_state);
+    }
+
+    void update_fft(u32 resource_index, resource_state& rs)
+    {
+        mixer::dsp* fft_dsp = (mixer::dsp*)_audio_resources[resource_index].resource;
+
+        const audio_fft_spectrum* spectrum = mixer::dsp_update_spectrum(fft_dsp);
+        u32                       length = spectrum->length;
+
+        // copied into the snapshot being written so it can not change while the user thread holds it
+        pen::res_pool<f32*>& data = _spectrum_data[_resource_states.backbuffer_index()];
+        data.grow(resource_index);
+
+        if (!data[resource_index])
+            data[resource_index] = (f32*)pen::memory_alloc(length * spectrum->num_channels * sizeof(f32));
+
+        rs.fft_spectrum = *spectrum;
+        for (s32 c = 0; c < spectrum->num_channels; ++c)
+        {
+            rs.fft_spectrum.spectrum[c] = data[resource_index] + c * length;
+            memcpy(rs.fft_spectrum.spectrum[c], spectrum->spectrum[c], length * sizeof(f32));
+        }
+    }
+
+    void update_three_band_eq(u32 resource_index, resource_state& rs)
+    {
+        mixer::dsp_get_three_band_eq((mixer::dsp*)_audio_resources[resource_index].resource, rs.eq_state);
+    }
+
+    void update_gain(u32 resource_index, resource_state& rs)
+    {
+        rs.gain_value = mixer::dsp_get_gain((mixer::dsp*)_audio_resources[resource_index].resource);
+    }
+
+    void direct::audio_system_update()
+    {
+        // every slot is written, the back buffer holds the state from 3 updates ago
+        _resource_states.grow(_audio_resources._capacity);
+
+        for (s32 i = 0; i < _audio_resources._capacity; ++i)
+        {
+            resource_state& rs = _resource_states.backbuffer()[i];
+            rs.type = AUDIO_RESOURCE_VIRTUAL;
+
+            if (!_audio_resources[i].assigned_flag)
+                continue;
+
+            rs.type = _audio_resources[i].type;
+
+            switch (rs.type)
+            {
+                case AUDIO_RESOURCE_SOUND:
+                {
+                    rs.file_info = _sound_file_info[i];
+                }
+                break;
+
+                case AUDIO_RESOURCE_CHANNEL:
+                {
+                    update_channel_state(i, rs);
+                }
+                break;
+
+                case AUDIO_RESOURCE_GROUP:
+                {
+                    update_group_state(i, rs);
+                }
+                break;
+
+                case AUDIO_RESOURCE_DSP_FFT:
+                {
+                    update_fft(i, rs);
+                }
+                break;
+
+                case AUDIO_RESOURCE_DSP_EQ:
+                {
+                    update_three_band_eq(i, rs);
+                }
+                break;
+
+                case AUDIO_RESOURCE_DSP_GAIN:
+                {
+                    update_gain(i, rs);
+                }
+                break;
+
+                default:
+                    break;
+            }
+        }
+
+        _resource_states.publish();
+    }
+
+    u32 direct::audio_create_sound(const c8* filename, u32 resource_slot)
+    {
+        return create_sound(filename, resource_slot, false);
+    }
+
+    u32 direct::audio_create_stream(const c8* filename, u32 resource_slot)
+    {
+        return create_sound(filename, resource_slot, true);
+    }
+
+    u32 direct::audio_create_channel_group(u32 resource_slot)
+    {
+        alloc_resource(resource_slot, AUDIO_RESOURCE_GROUP, mixer::create_group(_mixer));
+
+        return resource_slot;
+    }
+
+    u32 direct::audio_create_channel_for_sound(u32 sound_index, u32 resource_slot)
+    {
+        mixer::sound* snd = (mixer::sound*)_audio_resources[sound_index].resource;
+
+        alloc_resource(resource_slot, AUDIO_RESOURCE_CHANNEL, mixer::play_sound(_mixer, snd));
+
+        return resource_slot;
+    }
+
+    void direct::audio_channel_set_position(const u32 channel_index, const u32 position_ms)
+    {
+        mixer::voice_set_position((mixer::voice*)_audio_resources[channel_index].resource, position_ms);
+    }
+
+    void direct::audio_channel_set_frequency(const u32 channel_index, const f32 frequency)
+    {
+        mixer::voice_set_frequency((mixer::voice*)_audio_resources[channel_index].resource, frequency);
+    }
+
+    void direct::audio_channel_stop(const u32 channel_index)
+    {
+        mixer::voice_stop((mixer::voice*)_audio_resources[channel_index].resource);
+    }
+
+    void direct::audio_group_set_pause(const u32 group_index, const bool val)
+    {
+        mixer::group_set_paused((mixer::group*)_audio_resources[group_index].resource, val);
+    }
+
+    void direct::audio_group_set_mute(const u32 group_index, const bool val)
+    {
+        mixer::group_set_muted((mixer::group*)_audio_resources[group_index].resource, val);
+    }
+
+    void direct::audio_group_set_pitch(const u32 group_index, const f32 pitch)
+    {
+        mixer::group_set_pitch((mixer::group*)_audio_resources[group_index].resource, pitch);
+    }
+
+    void direct::audio_group_set_volume(const u32 group_index, const f32 volume)
+    {
+        mixer::group_set_volume((mixer::group*)_audio_resources[group_index].resource, volume);
+    }
+
+    u32 direct::audio_release_resource(u32 index)
+    {
+        if (index == 0)
+        {
+            return 0;
+        }
+
+        if (_audio_resources[index].assigned_flag)
+        {
+            void* p_res = _audio_resources[index].resource;
+
+            switch (_audio_resources[index].type)
+            {
+                case AUDIO_RESOURCE_CHANNEL:
+                {
+                    mixer::release_voice(_mixer, (mixer::voice*)p_res);
+                }
+                break;
+
+                case AUDIO_RESOURCE_GROUP:
+                {
+                    // the group's dsps go with it
+                    for (s32 i = 0; i < _audio_resources._capacity; ++i)
+                        if (_audio_resources[i].assigned_flag && _audio_resources[i].group == index)
+                            _audio_resources[i].assigned_flag = 0;
+
+                    mixer::release_group(_mixer, (mixer::group*)p_res);
+                }
+                break;
+
+                case AUDIO_RESOURCE_SOUND:
+                {
+                    mixer::release_sound(_mixer, (mixer::sound*)p_res);
+                }
+                break;
+
+                default:
+                    break;
+            }
+
+            _audio_resources[index].assigned_flag = 0;
+        }
+
+        return 0;
+    }
+
+    void direct::audio_add_channel_to_group(const u32 channel_index, const u32 group_index)
+    {
+        mixer::voice* v = (mixer::voice*)_audio_resources[channel_index].resource;
+        mixer::group* g = (mixer::group*)_audio_resources[group_index].resource;
+
+        mixer::voice_set_group(v, g);
+    }
+
+    u32 direct::audio_add_dsp_to_group(const u32 group_index, dsp_type type, u32 resource_slot)
+    {
+        audio_resource_type res_type = AUDIO_RESOURCE_DSP;
+        switch (type)
+        {
+            case DSP_FFT:
+                res_type = AUDIO_RESOURCE_DSP_FFT;
+                break;
+            case DSP_THREE_BAND_EQ:
+                res_type = AUDIO_RESOURCE_DSP_EQ;
+                break;
+            case DSP_GAIN:
+                res_type = AUDIO_RESOURCE_DSP_GAIN;
+                break;
+            default:
+                PEN_ERROR;
+        }
+
+        mixer::dsp* d = mixer::group_add_dsp((mixer::group*)_audio_resources[group_index].resource, type);
+        PEN_ASSERT(d);
+
+        alloc_resource(resource_slot, res_type, d);
+        _audio_resources[resource_slot].group = group_index;
+
+        return resource_slot;
+    }
+
+    void direct::audio_dsp_set_three_band_eq(const u32 eq_index, const f32 low, const f32 med, const f32 high)
+    {
+        mixer::dsp_set_three_band_eq((mixer::dsp*)_audio_resources[eq_index].resource, low, med, high);
+    }
+
+    void direct::audio_dsp_set_gain(const u32 dsp_index, const f32 gain)
+    {
+        mixer::dsp_set_gain((mixer::dsp*)_audio_resources[dsp_index].resource, gain);
+    }
+
+    pen_error get_resource_state(u32 index, audio_resource_type type, const resource_state*& rs)
+    {
+        if (index >= _resource_states.frontbuffer_capacity())
+            return PEN_ERR_NOT_READY;
+
+        rs = &_resource_states.frontbuffer()[index];
+
+        if (rs->type == AUDIO_RESOURCE_VIRTUAL)
+            return PEN_ERR_NOT_READY;
+
+        if (rs->type != type)
+            return PEN_ERR_FAILED;
+
+        return PEN_ERR_OK;
+    }
+
+    pen_error audio_channel_get_state(const u32 channel_index, audio_channel_state* state)
+    {
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(channel_index, AUDIO_RESOURCE_CHANNEL, rs);
+
+        if (err == PEN_ERR_OK)
+            *state = rs->channel_state;
+
+        return err;
+    }
+
+    pen_error audio_channel_get_sound_file_info(const u32 sound_index, audio_sound_file_info* info)
+    {
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(sound_index, AUDIO_RESOURCE_SOUND, rs);
+
+        if (err == PEN_ERR_OK)
+            *info = rs->file_info;
+
+        return err;
+    }
+
+    pen_error audio_group_get_state(const u32 group_index, audio_group_state* state)
+    {
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(group_index, AUDIO_RESOURCE_GROUP, rs);
+
+        if (err == PEN_ERR_OK)
+            *state = rs->group_state;
+
+        return err;
+    }
+
+    pen_error audio_dsp_get_spectrum(const u32 spectrum_dsp, audio_fft_spectrum* spectrum)
+    {
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(spectrum_dsp, AUDIO_RESOURCE_DSP_FFT, rs);
+
+        if (err == PEN_ERR_OK)
+            *spectrum = rs->fft_spectrum;
+
+        return err;
+    }
+
+    pen_error audio_dsp_get_three_band_eq(const u32 eq_dsp, audio_eq_state* eq_state)
+    {
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(eq_dsp, AUDIO_RESOURCE_DSP_EQ, rs);
+
+        if (err == PEN_ERR_OK)
+            *eq_state = rs->eq_state;
+
+        return err;
+    }
+
+    pen_error audio_dsp_get_gain(const u32 dsp_index, f32* gain)
+    {
+        const resource_state* rs = nullptr;
+        pen_error             err = get_resource_state(dsp_index, AUDIO_RESOURCE_DSP_GAIN, rs);
+
+        if (err == PEN_ERR_OK)
+            *gain = rs->gain_value;
+
+        return err;
+    }
+} // namespace put
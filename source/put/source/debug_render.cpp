@@ -4,6 +4,7 @@
 
 #include "debug_render.h"
 #include "camera.h"
+#include "data_struct.h"
 #include "hash.h"
 #include "input.h"
 #include "memory.h"
@@ -12,6 +13,10 @@
 #include "pmfx.h"
 #include "stb/stb_easy_font.h"
 
+#if PEN_SSE
+#include <xmmintrin.h>
+#endif
+
 extern pen::window_creation_params pen_window;
 
 using namespace put;
@@ -44,26 +49,94 @@ namespace put
             vertex_debug_2d(){};
         };
 
-        shader_program* debug_3d_program;
+        // primitives are written straight into transient stream memory in chunks, a chunk is drawn with one call.
+        // the first chunk of a frame is sized to what the last frame used, so steady use is a single draw
+        static const u32 k_min_chunk_verts = 2048;
+
+        struct stream_chunk
+        {
+            pen::stream_alloc alloc;
+            u32               capacity; // in vertices
+            u32               count;    // vertices written once the chunk is closed, until then it is the global count
+            u32               drawn;    // vertices drawn by an earlier render this frame
+        };
+
+        struct vertex_stream
+        {
+            stream_chunk* chunks = nullptr; // stretchy buffer, the last chunk is being written
+            u32           stride = 0;
+            u32           frame_verts = 0;
+            u32           last_frame_verts = 0;
+            u64           frame = (u64)-1;
+        };
+
+        // text is drawn as one instanced quad per glyph from an atlas of stb_easy_font glyphs rasterised at init.
+        // formatted strings are laid out once and cached by hash, so text which has not changed since the last frame
+        // costs a lookup and an offset copy of its glyphs
+        enum text_constants
+        {
+            TEXT_CELL_W = 8, // glyphs fit in 7x9 pixels
+            TEXT_CELL_H = 10,
+            TEXT_ATLAS_COLS = 16,
+            TEXT_ATLAS_W = 128,
+            TEXT_ATLAS_H = 64,
+            TEXT_NUM_GLYPHS = 95, // printable ascii
+            TEXT_LINE_H = 12,
+            TEXT_CACHE_MIN_SLOTS = 1024,
+            TEXT_CACHE_MIN_GLYPHS = 1 << 16 // glyphs cached before entries unused last frame are evicted
+        };
+
+        struct glyph_instance
+        {
+            f32 glyph[4]; // xy pixel position, zw atlas uv
+            f32 col[4];
+        };
+
+        struct text_entry
+        {
+            hash_id hash;
+            u32     string; // offset into strings
+            u32     length;
+            u32     glyph; // first glyph in glyphs
+            u32     num_glyphs;
+            u64     frame; // stream frame last used in
+        };
+
+        struct text_cache
+        {
+            text_entry* entries = nullptr; // stretchy buffers
+            c8*         strings = nullptr;
+            f32*        glyphs = nullptr; // 4 per glyph, xy offset from the text origin and zw atlas uv
+            u32*        slots = nullptr;  // open addressed, entry index + 1 or 0 when empty
+            u32         num_slots = 0;
+            u32         evict_glyphs = TEXT_CACHE_MIN_GLYPHS;
+            u64         frame = (u64)-1;
+        };
+
+        vertex_stream streams_3d[VB_NUM];
+        vertex_stream streams_2d[VB_NUM];
+        vertex_stream text_stream;
+        text_cache    text;
 
-        u32 vb_3d[VB_NUM];
         u32 line_vert_3d_count = 0;
         u32 tri_vert_3d_count = 0;
 
-        vertex_debug_3d* debug_3d_buffers[VB_NUM] = {0};
-        vertex_debug_3d* debug_3d_verts = debug_3d_buffers[VB_LINES];
-        vertex_debug_3d* debug_3d_tris = debug_3d_buffers[VB_TRIS];
+        vertex_debug_3d* debug_3d_verts = nullptr;
+        vertex_debug_3d* debug_3d_tris = nullptr;
 
-        u32 vb_2d[VB_NUM];
         u32 tri_vert_2d_count = 0;
         u32 line_vert_2d_count = 0;
 
-        u32 buffer_2d_size_in_verts[VB_NUM] = {0};
-        u32 buffer_3d_size_in_verts[VB_NUM] = {0};
+        vertex_debug_2d* debug_2d_verts = nullptr;
+        vertex_debug_2d* debug_2d_tris = nullptr;
+
+        u32             text_glyph_count = 0;
+        glyph_instance* text_glyphs = nullptr;
 
-        vertex_debug_2d* debug_2d_buffers[VB_NUM] = {0};
-        vertex_debug_2d* debug_2d_verts = debug_2d_buffers[VB_LINES];
-        vertex_debug_2d* debug_2d_tris = debug_2d_buffers[VB_TRIS];
+        u32 text_atlas;
+        u32 text_sampler;
+        u32 text_quad_vb;
+        u32 text_quad_ib;
 
         u32 debug_shader;
 
@@ -72,176 +145,423 @@ namespace put
             debug_shader = pmfx::load_shader("debug");
         }
 
-        void release_3d_buffers()
+        void create_text_resources()
         {
-            for (s32 i = 0; i < VB_NUM; ++i)
+            // stb_easy_font glyphs are made of whole pixel quads, so they rasterise exactly into the atlas cells
+            u8* pixels = (u8*)pen::memory_calloc(TEXT_ATLAS_W * TEXT_ATLAS_H, 1);
+
+            for (u32 i = 0; i < TEXT_NUM_GLYPHS; ++i)
             {
-                pen::renderer_release_buffer(vb_3d[i]);
-                delete[] debug_3d_buffers[i];
+                c8  str[2] = {(c8)(32 + i), 0};
+                f32 quads[16 * 16]; // 4 verts of x, y, z, colour per quad
+
+                f32 cx = (f32)((i % TEXT_ATLAS_COLS) * TEXT_CELL_W);
+                f32 cy = (f32)((i / TEXT_ATLAS_COLS) * TEXT_CELL_H);
+                u32 num_quads = stb_easy_font_print(cx, cy, str, nullptr, quads, sizeof(quads));
+
+                for (u32 q = 0; q < num_quads; ++q)
+                {
+                    // the first and third verts are the min and max corners
+                    const f32* v = &quads[q * 16];
+                    for (u32 y = (u32)v[1]; y < (u32)v[9]; ++y)
+                        for (u32 x = (u32)v[0]; x < (u32)v[8]; ++x)
+                            pixels[y * TEXT_ATLAS_W + x] = 0xff;
+                }
             }
+
+            pen::texture_creation_params tcp;
+            tcp.width = TEXT_ATLAS_W;
+            tcp.height = TEXT_ATLAS_H;
+            tcp.format = PEN_TEX_FORMAT_R8_UNORM;
+            tcp.num_mips = 1;
+            tcp.num_arrays = 1;
+            tcp.sample_count = 1;
+            tcp.sample_quality = 0;
+            tcp.usage = PEN_USAGE_IMMUTABLE;
+            tcp.bind_flags = PEN_BIND_SHADER_RESOURCE;
+            tcp.cpu_access_flags = 0;
+            tcp.flags = 0;
+            tcp.block_size = 1;
+            tcp.pixels_per_block = 1;
+            tcp.data_size = TEXT_ATLAS_W * TEXT_ATLAS_H;
+            tcp.data = pixels;
+            tcp.collection_type = pen::TEXTURE_COLLECTION_NONE;
+
+            text_atlas = pen::renderer_create_texture(tcp);
+            pen::memory_free(pixels);
+
+            pen::sampler_creation_params scp;
+            pen::memory_zero(&scp, sizeof(pen::sampler_creation_params));
+            scp.filter = PEN_FILTER_MIN_MAG_MIP_POINT;
+            scp.address_u = PEN_TEXTURE_ADDRESS_CLAMP;
+            scp.address_v = PEN_TEXTURE_ADDRESS_CLAMP;
+            scp.address_w = PEN_TEXTURE_ADDRESS_CLAMP;
+            scp.comparison_func = PEN_COMPARISON_ALWAYS;
+            scp.min_lod = 0.0f;
+            scp.max_lod = 1000.0f;
+
+            text_sampler = pen::renderer_create_sampler(scp);
+
+            // xy in pixels and zw in uv, so the shader only adds the glyph position. screen y is up, atlas v is down
+            f32 uw = (f32)TEXT_CELL_W / (f32)TEXT_ATLAS_W;
+            f32 vh = (f32)TEXT_CELL_H / (f32)TEXT_ATLAS_H;
+
+            vec4f corners[4] = {vec4f(0.0f, 0.0f, 0.0f, 0.0f), vec4f((f32)TEXT_CELL_W, 0.0f, uw, 0.0f),
+                                vec4f((f32)TEXT_CELL_W, -(f32)TEXT_CELL_H, uw, vh),
+                                vec4f(0.0f, -(f32)TEXT_CELL_H, 0.0f, vh)};
+
+            u16 indices[] = {0, 1, 2, 2, 3, 0};
+
+            pen::buffer_creation_params bcp;
+            bcp.usage_flags = PEN_USAGE_IMMUTABLE;
+            bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
+            bcp.cpu_access_flags = 0;
+            bcp.buffer_size = sizeof(corners);
+            bcp.data = (void*)&corners[0];
+
+            text_quad_vb = pen::renderer_create_buffer(bcp);
+
+            bcp.bind_flags = PEN_BIND_INDEX_BUFFER;
+            bcp.buffer_size = sizeof(indices);
+            bcp.data = (void*)&indices[0];
+
+            text_quad_ib = pen::renderer_create_buffer(bcp);
         }
 
-        void alloc_3d_buffer(u32 num_verts, u32 buffer_index)
+        void stream_begin_frame(vertex_stream& vs, u32& count)
         {
-            if (num_verts < buffer_3d_size_in_verts[buffer_index])
+            u64 frame = pen::renderer_stream_frame();
+            if (vs.frame == frame)
                 return;
 
-            vertex_debug_3d* prev_buffer = debug_3d_buffers[buffer_index];
-
-            u32 prev_vb = vb_3d[buffer_index];
-            u32 prev_size = sizeof(vertex_debug_3d) * buffer_3d_size_in_verts[buffer_index];
+            // stream memory only lasts a frame, primitives which were not rendered in it are dropped
+            vs.last_frame_verts = vs.frame_verts + count;
+            vs.frame_verts = 0;
+            vs.frame = frame;
 
-            buffer_3d_size_in_verts[buffer_index] = num_verts * 2;
+            if (vs.chunks)
+                stb__sbn(vs.chunks) = 0;
 
-            // debug lines buffer
-            pen::buffer_creation_params bcp;
-            bcp.usage_flags = PEN_USAGE_DYNAMIC;
-            bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
-            bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-            bcp.buffer_size = sizeof(vertex_debug_3d) * buffer_3d_size_in_verts[buffer_index];
-            bcp.data = NULL;
-
-            vb_3d[buffer_index] = pen::renderer_create_buffer(bcp);
+            count = 0;
+        }
 
-            debug_3d_buffers[buffer_index] = new vertex_debug_3d[buffer_3d_size_in_verts[buffer_index]];
+        // returns the vertices of a chunk with room for num_verts more after count
+        void* stream_reserve(vertex_stream& vs, u32& count, u32 num_verts)
+        {
+            stream_begin_frame(vs, count);
 
-            if (prev_buffer)
+            u32 n = sb_count(vs.chunks);
+            if (n > 0)
             {
-                memcpy(debug_3d_buffers[buffer_index], prev_buffer, prev_size);
-                delete prev_buffer;
+                stream_chunk& c = vs.chunks[n - 1];
+                if (count + num_verts <= c.capacity)
+                    return c.alloc.data;
 
-                pen::renderer_release_buffer(prev_vb);
+                c.count = count;
+                vs.frame_verts += count;
             }
 
-            debug_3d_verts = &debug_3d_buffers[VB_LINES][0];
-            debug_3d_tris = &debug_3d_buffers[VB_TRIS][0];
+            u32 capacity = n > 0 ? vs.chunks[n - 1].capacity * 2 : std::max(vs.last_frame_verts, k_min_chunk_verts);
+            capacity = std::max(capacity, num_verts);
+
+            stream_chunk nc;
+            nc.alloc = pen::renderer_stream_alloc(PEN_BIND_VERTEX_BUFFER, capacity * vs.stride);
+            nc.capacity = capacity;
+            nc.count = 0;
+            nc.drawn = 0;
+
+            sb_push(vs.chunks, nc);
+
+            count = 0;
+            return nc.alloc.data;
         }
 
-        void release_2d_buffers()
+        typedef void (*stream_draw_func)(const stream_chunk& c, u32 stride, u32 start, u32 num, u32 primitive_topology);
+
+        void draw_verts(const stream_chunk& c, u32 stride, u32 start, u32 num, u32 primitive_topology)
         {
-            for (s32 i = 0; i < VB_NUM; ++i)
+            pen::renderer_set_vertex_buffer(c.alloc.buffer, 0, stride, c.alloc.offset);
+            pen::renderer_draw(num, start, primitive_topology);
+        }
+
+        void draw_glyphs(const stream_chunk& c, u32 stride, u32 start, u32 num, u32 primitive_topology)
+        {
+            // instances are bound from the first one to draw, gl ignores start_instance
+            u32 vbs[] = {text_quad_vb, c.alloc.buffer};
+            u32 strides[] = {sizeof(vec4f), stride};
+            u32 offsets[] = {0, c.alloc.offset + start * stride};
+
+            pen::renderer_set_vertex_buffers(vbs, 2, 0, strides, offsets);
+            pen::renderer_set_index_buffer(text_quad_ib, PEN_FORMAT_R16_UINT, 0);
+            pen::renderer_draw_indexed_instanced(num, 0, 6, 0, 0, primitive_topology);
+        }
+
+        void stream_render(vertex_stream& vs, u32& count, u32 primitive_topology, stream_draw_func draw = draw_verts)
+        {
+            stream_begin_frame(vs, count);
+
+            u32 n = sb_count(vs.chunks);
+            if (n == 0)
+                return;
+
+            vs.chunks[n - 1].count = count;
+
+            for (u32 i = 0; i < n; ++i)
             {
-                pen::renderer_release_buffer(vb_2d[i]);
-                delete[] debug_2d_buffers[i];
+                stream_chunk& c = vs.chunks[i];
+                if (c.count == c.drawn)
+                    continue;
+
+                u32 num_verts = c.count - c.drawn;
+                pen::renderer_stream_commit(c.alloc, c.drawn * vs.stride, num_verts * vs.stride);
+
+                draw(c, vs.stride, c.drawn, num_verts, primitive_topology);
+
+                c.drawn = c.count;
             }
+
+            // closed chunks are done with, primitives added after this render carry on in the last one
+            vs.chunks[0] = vs.chunks[n - 1];
+            stb__sbn(vs.chunks) = 1;
         }
 
-        void alloc_2d_buffer(u32 num_verts, u32 buffer_index)
+        void reserve_3d(u32 num_verts, u32 buffer_index)
         {
-            if (num_verts < buffer_2d_size_in_verts[buffer_index])
-                return;
+            if (buffer_index == VB_LINES)
+                debug_3d_verts = (vertex_debug_3d*)stream_reserve(streams_3d[VB_LINES], line_vert_3d_count, num_verts);
+            else
+                debug_3d_tris = (vertex_debug_3d*)stream_reserve(streams_3d[VB_TRIS], tri_vert_3d_count, num_verts);
+        }
+
+        void reserve_2d(u32 num_verts, u32 buffer_index)
+        {
+            if (buffer_index == VB_LINES)
+                debug_2d_verts = (vertex_debug_2d*)stream_reserve(streams_2d[VB_LINES], line_vert_2d_count, num_verts);
+            else
+                debug_2d_tris = (vertex_debug_2d*)stream_reserve(streams_2d[VB_TRIS], tri_vert_2d_count, num_verts);
+        }
 
-            vertex_debug_2d* prev_buffer = debug_2d_buffers[buffer_index];
+        void reserve_text(u32 num_glyphs)
+        {
+            text_glyphs = (glyph_instance*)stream_reserve(text_stream, text_glyph_count, num_glyphs);
+        }
 
-            u32 prev_vb = vb_2d[buffer_index];
-            u32 prev_size = sizeof(vertex_debug_2d) * buffer_2d_size_in_verts[buffer_index];
+        void text_cache_rebuild(u32 num_slots, bool evict)
+        {
+            if (evict)
+            {
+                // keep entries used this frame or last, compacting their strings and glyphs
+                text_entry* entries = nullptr;
+                c8*         strings = nullptr;
+                f32*        glyphs = nullptr;
 
-            buffer_2d_size_in_verts[buffer_index] = num_verts * 2;
+                u32 num_entries = sb_count(text.entries);
+                for (u32 i = 0; i < num_entries; ++i)
+                {
+                    text_entry e = text.entries[i];
+                    if (e.frame + 1 < text.frame)
+                        continue;
 
-            // debug lines buffer
-            pen::buffer_creation_params bcp;
-            bcp.usage_flags = PEN_USAGE_DYNAMIC;
-            bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
-            bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-            bcp.buffer_size = sizeof(vertex_debug_2d) * buffer_2d_size_in_verts[buffer_index];
-            bcp.data = NULL;
+                    e.string = sb_count(strings);
+                    if (e.length)
+                        memcpy(sb_add(strings, e.length), &text.strings[text.entries[i].string], e.length);
 
-            vb_2d[buffer_index] = pen::renderer_create_buffer(bcp);
+                    e.glyph = sb_count(glyphs) / 4;
+                    if (e.num_glyphs)
+                        memcpy(sb_add(glyphs, e.num_glyphs * 4), &text.glyphs[text.entries[i].glyph * 4],
+                               e.num_glyphs * 4 * sizeof(f32));
+
+                    sb_push(entries, e);
+                }
 
-            debug_2d_buffers[buffer_index] = new vertex_debug_2d[buffer_2d_size_in_verts[buffer_index]];
+                sb_free(text.entries);
+                sb_free(text.strings);
+                sb_free(text.glyphs);
 
-            if (prev_buffer)
+                text.entries = entries;
+                text.strings = strings;
+                text.glyphs = glyphs;
+            }
+
+            pen::memory_free(text.slots);
+            text.slots = (u32*)pen::memory_calloc(num_slots, sizeof(u32));
+            text.num_slots = num_slots;
+
+            u32 mask = num_slots - 1;
+            u32 num_entries = sb_count(text.entries);
+            for (u32 i = 0; i < num_entries; ++i)
+            {
+                u32 slot = text.entries[i].hash & mask;
+                while (text.slots[slot])
+                    slot = (slot + 1) & mask;
+
+                text.slots[slot] = i + 1;
+            }
+        }
+
+        // appends glyphs for the printable characters of str, matching stb_easy_font_print's layout
+        u32 text_layout(const c8* str, u32 len)
+        {
+            f32 x = 0.0f;
+            f32 y = 0.0f;
+            u32 num_glyphs = 0;
+
+            for (u32 i = 0; i < len; ++i)
             {
-                memcpy(debug_2d_buffers[buffer_index], prev_buffer, prev_size);
-                delete prev_buffer;
+                if (str[i] == '\n')
+                {
+                    x = 0.0f;
+                    y -= (f32)TEXT_LINE_H;
+                    continue;
+                }
+
+                if (str[i] < 32 || str[i] > 126)
+                    continue;
+
+                u32   g = str[i] - 32;
+                auto& ci = stb_easy_font_charinfo[g];
+                auto& next = stb_easy_font_charinfo[g + 1];
 
-                pen::renderer_release_buffer(prev_vb);
+                // spaces have no segments and need no quad
+                if (next.h_seg != ci.h_seg || next.v_seg != ci.v_seg)
+                {
+                    f32* glyph = sb_add(text.glyphs, 4);
+                    glyph[0] = x;
+                    glyph[1] = y;
+                    glyph[2] = (f32)((g % TEXT_ATLAS_COLS) * TEXT_CELL_W) / (f32)TEXT_ATLAS_W;
+                    glyph[3] = (f32)((g / TEXT_ATLAS_COLS) * TEXT_CELL_H) / (f32)TEXT_ATLAS_H;
+                    ++num_glyphs;
+                }
+
+                x += (f32)(ci.advance & 15) + stb_easy_font_spacing_val;
             }
 
-            debug_2d_verts = &debug_2d_buffers[VB_LINES][0];
-            debug_2d_tris = &debug_2d_buffers[VB_TRIS][0];
+            return num_glyphs;
         }
 
-        void create_buffers()
+        const text_entry& text_cache_get(const c8* str, u32 len)
         {
-            for (s32 i = 0; i < VB_NUM; ++i)
+            u64 frame = pen::renderer_stream_frame();
+            if (text.frame != frame)
             {
-                alloc_3d_buffer(2048, i);
-                alloc_2d_buffer(2048, i);
+                text.frame = frame;
+
+                // strings which change every frame keep adding entries, drop the stale ones once enough build up
+                if (sb_count(text.glyphs) / 4 > text.evict_glyphs)
+                {
+                    text_cache_rebuild(text.num_slots, true);
+                    text.evict_glyphs = std::max<u32>(TEXT_CACHE_MIN_GLYPHS, sb_count(text.glyphs) / 4 * 2);
+                }
+            }
+
+            if ((sb_count(text.entries) + 1) * 2 > text.num_slots)
+                text_cache_rebuild(std::max<u32>(text.num_slots * 2, TEXT_CACHE_MIN_SLOTS), false);
+
+            hash_id hash = pen::hashMurmur2A(str, len);
+
+            u32 mask = text.num_slots - 1;
+            u32 slot = hash & mask;
+            for (; text.slots[slot]; slot = (slot + 1) & mask)
+            {
+                text_entry& e = text.entries[text.slots[slot] - 1];
+                if (e.hash == hash && e.length == len && memcmp(&text.strings[e.string], str, len) == 0)
+                {
+                    e.frame = frame;
+                    return e;
+                }
             }
+
+            text_entry e;
+            e.hash = hash;
+            e.string = sb_count(text.strings);
+            e.length = len;
+            e.glyph = sb_count(text.glyphs) / 4;
+            e.num_glyphs = text_layout(str, len);
+            e.frame = frame;
+
+            if (len)
+                memcpy(sb_add(text.strings, len), str, len);
+
+            text.slots[slot] = sb_count(text.entries) + 1;
+            sb_push(text.entries, e);
+
+            return sb_last(text.entries);
         }
 
         void init()
         {
-            create_buffers();
+            for (s32 i = 0; i < VB_NUM; ++i)
+            {
+                streams_3d[i].stride = sizeof(vertex_debug_3d);
+                streams_2d[i].stride = sizeof(vertex_debug_2d);
+            }
+
+            text_stream.stride = sizeof(glyph_instance);
+
             create_shaders();
+            create_text_resources();
         }
 
         void shutdown()
         {
-            release_2d_buffers();
-            release_3d_buffers();
+            for (s32 i = 0; i < VB_NUM; ++i)
+            {
+                sb_free(streams_3d[i].chunks);
+                sb_free(streams_2d[i].chunks);
+
+                streams_3d[i].chunks = nullptr;
+                streams_2d[i].chunks = nullptr;
+            }
+
+            sb_free(text_stream.chunks);
+            sb_free(text.entries);
+            sb_free(text.strings);
+            sb_free(text.glyphs);
+            pen::memory_free(text.slots);
+
+            text_stream.chunks = nullptr;
+            text = text_cache();
+
+            pen::renderer_release_texture(text_atlas);
+            pen::renderer_release_sampler(text_sampler);
+            pen::renderer_release_buffer(text_quad_vb);
+            pen::renderer_release_buffer(text_quad_ib);
         }
 
         void render_3d(u32 cb_3d_view)
         {
-            pen::renderer_update_buffer(vb_3d[VB_TRIS], &debug_3d_tris[0], sizeof(vertex_debug_3d) * tri_vert_3d_count);
-            pen::renderer_update_buffer(vb_3d[VB_LINES], &debug_3d_verts[0], sizeof(vertex_debug_3d) * line_vert_3d_count);
-
             static hash_id ID_DEBUG_3D = PEN_HASH("debug_3d");
 
             pmfx::set_technique_perm(debug_shader, ID_DEBUG_3D);
             pen::renderer_set_constant_buffer(cb_3d_view, 1, pen::CBUFFER_BIND_VS); // gles on ios will crash if not set
             pen::renderer_set_constant_buffer(cb_3d_view, 0, pen::CBUFFER_BIND_VS);
 
-            if (tri_vert_3d_count > 0)
-            {
-                pen::renderer_set_vertex_buffer(vb_3d[VB_TRIS], 0, sizeof(vertex_debug_3d), 0);
-                pen::renderer_draw(tri_vert_3d_count, 0, PEN_PT_TRIANGLELIST);
-            }
-
-            if (line_vert_3d_count > 0)
-            {
-                pen::renderer_set_vertex_buffer(vb_3d[VB_LINES], 0, sizeof(vertex_debug_3d), 0);
-                pen::renderer_draw(line_vert_3d_count, 0, PEN_PT_LINELIST);
-            }
-
-            // reset
-            tri_vert_3d_count = 0;
-            line_vert_3d_count = 0;
+            stream_render(streams_3d[VB_TRIS], tri_vert_3d_count, PEN_PT_TRIANGLELIST);
+            stream_render(streams_3d[VB_LINES], line_vert_3d_count, PEN_PT_LINELIST);
         }
 
         void render_2d(u32 cb_2d_view)
         {
-            pen::renderer_update_buffer(vb_2d[VB_TRIS], &debug_2d_tris[0], sizeof(vertex_debug_2d) * tri_vert_2d_count);
-            pen::renderer_update_buffer(vb_2d[VB_LINES], &debug_2d_verts[0], sizeof(vertex_debug_2d) * line_vert_2d_count);
-
             static hash_id ID_DEBUG_2D = PEN_HASH("debug_2d");
 
             pmfx::set_technique_perm(debug_shader, ID_DEBUG_2D);
             pen::renderer_set_constant_buffer(cb_2d_view, 1, pen::CBUFFER_BIND_VS);
             pen::renderer_set_constant_buffer(cb_2d_view, 0, pen::CBUFFER_BIND_VS); // gles on ios will crash if not set
 
-            if (tri_vert_2d_count > 0)
-            {
-                pen::renderer_set_vertex_buffer(vb_2d[VB_TRIS], 0, sizeof(vertex_debug_2d), 0);
-                pen::renderer_draw(tri_vert_2d_count, 0, PEN_PT_TRIANGLELIST);
-            }
+            stream_render(streams_2d[VB_TRIS], tri_vert_2d_count, PEN_PT_TRIANGLELIST);
+            stream_render(streams_2d[VB_LINES], line_vert_2d_count, PEN_PT_LINELIST);
 
-            if (line_vert_2d_count > 0)
-            {
-                pen::renderer_set_vertex_buffer(vb_2d[VB_LINES], 0, sizeof(vertex_debug_2d), 0);
-                pen::renderer_draw(line_vert_2d_count, 0, PEN_PT_LINELIST);
-            }
+            static hash_id ID_DEBUG_TEXT = PEN_HASH("debug_text");
+
+            pmfx::set_technique_perm(debug_shader, ID_DEBUG_TEXT);
+            pen::renderer_set_texture(text_atlas, text_sampler, 0, pen::TEXTURE_BIND_PS);
 
-            // reset
-            tri_vert_2d_count = 0;
-            line_vert_2d_count = 0;
+            stream_render(text_stream, text_glyph_count, PEN_PT_TRIANGLELIST, draw_glyphs);
         }
 
         void add_line(const vec3f& start, const vec3f& end, const vec4f& col)
         {
-            alloc_3d_buffer(line_vert_3d_count + 2, VB_LINES);
+            reserve_3d(2, VB_LINES);
 
             debug_3d_verts[line_vert_3d_count].pos = vec4f(start, 1.0f);
             debug_3d_verts[line_vert_3d_count + 1].pos = vec4f(end, 1.0f);
@@ -259,7 +579,7 @@ namespace put
 
         void add_circle_segment(const vec3f& axis, const vec3f& centre, f32 radius, f32 min, f32 max, const vec4f& col)
         {
-            alloc_3d_buffer(line_vert_3d_count + 24, VB_LINES);
+            reserve_3d(24, VB_LINES);
 
             vec3f right = cross(axis, vec3f::unit_y());
             if (mag(right) < 0.1)
@@ -348,7 +668,7 @@ namespace put
 
         void add_aabb(const vec3f& min, const vec3f& max, const vec4f& col)
         {
-            alloc_3d_buffer(line_vert_3d_count + 24, VB_LINES);
+            reserve_3d(24, VB_LINES);
 
             // sides
             //
@@ -450,9 +770,10 @@ namespace put
 
         void add_obb(const mat4& matrix, vec4f col)
         {
-            u32 start_index = line_vert_3d_count;
+            // add_aabb can start a new chunk, so count back from the end
             add_aabb(vec3f::one(), -vec3f::one(), col);
             u32 end_index = line_vert_3d_count;
+            u32 start_index = end_index - 24;
 
             for (u32 i = start_index; i < end_index; i++)
             {
@@ -521,7 +842,7 @@ namespace put
 
         void add_coord_space(const mat4& mat, const f32 size, u32 selected)
         {
-            alloc_3d_buffer(line_vert_3d_count + 6, VB_LINES);
+            reserve_3d(6, VB_LINES);
 
             vec3f pos = mat.get_translation();
 
@@ -546,7 +867,7 @@ namespace put
 
         void add_point(const vec3f& point, f32 size, const vec4f& col)
         {
-            alloc_3d_buffer(line_vert_3d_count + 12, VB_LINES);
+            reserve_3d(12, VB_LINES);
 
             vec3f units[6] = {
                 vec3f(-1.0f, 0.0f, 0.0f), vec3f(1.0f, 0.0f, 0.0f),
@@ -572,7 +893,7 @@ namespace put
 
         void add_grid(const vec3f& centre, const vec3f& size, const vec3f& divisions)
         {
-            alloc_3d_buffer(line_vert_3d_count + divisions.x * 2 + divisions.z * 2, VB_LINES);
+            reserve_3d(divisions.x * 2 + divisions.z * 2, VB_LINES);
 
             vec3f start = centre - size * 0.5f;
             vec3f division_size = size / divisions;
@@ -677,67 +998,45 @@ namespace put
 
             va_end(va);
 
-            static c8 buffer[99999]; // ~500 chars
-            u32       num_quads;
-            num_quads = stb_easy_font_print(x, y, expanded_buffer, nullptr, buffer, sizeof(buffer));
+            const text_entry& te = text_cache_get(expanded_buffer, pen::string_length(expanded_buffer));
+            if (te.num_glyphs == 0)
+                return;
 
-            f32* vb = (f32*)&buffer[0];
+            reserve_text(te.num_glyphs);
 
-            u32 start_vertex = tri_vert_2d_count;
+            // cached glyphs are relative to the text origin, screen y is up
+            f32             ox = x + vp.x;
+            f32             oy = vp.height - y - vp.y;
+            const f32*      src = &text.glyphs[te.glyph * 4];
+            glyph_instance* dst = &text_glyphs[text_glyph_count];
 
-            alloc_2d_buffer(tri_vert_2d_count + num_quads * 6, VB_TRIS);
+#if PEN_SSE
+            __m128 origin = _mm_set_ps(0.0f, 0.0f, oy, ox);
+            __m128 col = _mm_set_ps(colour.w, colour.z, colour.y, colour.x);
 
-            for (u32 i = 0; i < num_quads; ++i)
+            for (u32 i = 0; i < te.num_glyphs; ++i)
             {
-                f32 x[4];
-                f32 y[4];
-
-                for (u32 v = 0; v < 4; ++v)
-                {
-                    vec2f ndc_pos = vec2f(vb[0] + vp.x, vb[1] + vp.y);
-
-                    x[v] = ndc_pos.x;
-                    y[v] = vp.height - ndc_pos.y;
-
-                    vb += 4;
-                }
-
-                // t1
-                debug_2d_tris[tri_vert_2d_count].pos.x = x[0];
-                debug_2d_tris[tri_vert_2d_count].pos.y = y[0];
-                tri_vert_2d_count++;
-
-                debug_2d_tris[tri_vert_2d_count].pos.x = x[1];
-                debug_2d_tris[tri_vert_2d_count].pos.y = y[1];
-                tri_vert_2d_count++;
-
-                debug_2d_tris[tri_vert_2d_count].pos.x = x[2];
-                debug_2d_tris[tri_vert_2d_count].pos.y = y[2];
-                tri_vert_2d_count++;
-
-                // 2
-                debug_2d_tris[tri_vert_2d_count].pos.x = x[2];
-                debug_2d_tris[tri_vert_2d_count].pos.y = y[2];
-                tri_vert_2d_count++;
-
-                debug_2d_tris[tri_vert_2d_count].pos.x = x[3];
-                debug_2d_tris[tri_vert_2d_count].pos.y = y[3];
-                tri_vert_2d_count++;
-
-                debug_2d_tris[tri_vert_2d_count].pos.x = x[0];
-                debug_2d_tris[tri_vert_2d_count].pos.y = y[0];
-                tri_vert_2d_count++;
+                _mm_storeu_ps(dst[i].glyph, _mm_add_ps(_mm_loadu_ps(src + i * 4), origin));
+                _mm_storeu_ps(dst[i].col, col);
             }
-
-            for (u32 i = start_vertex; i < tri_vert_2d_count; ++i)
+#else
+            for (u32 i = 0; i < te.num_glyphs; ++i)
             {
-                debug_2d_tris[i].col = colour;
+                dst[i].glyph[0] = src[i * 4 + 0] + ox;
+                dst[i].glyph[1] = src[i * 4 + 1] + oy;
+                dst[i].glyph[2] = src[i * 4 + 2];
+                dst[i].glyph[3] = src[i * 4 + 3];
+
+                for (u32 c = 0; c < 4; ++c)
+                    dst[i].col[c] = colour.v[c];
             }
+#endif
+            text_glyph_count += te.num_glyphs;
         }
 
         void add_line_2f(const vec2f& start, const vec2f& end, const vec4f& colour)
         {
-            alloc_2d_buffer(line_vert_2d_count + 2, VB_LINES);
+            reserve_2d(2, VB_LINES);
 
             debug_2d_verts[line_vert_2d_count].pos = start;
             debug_2d_verts[line_vert_2d_count + 1].pos = end;
@@ -757,7 +1056,7 @@ namespace put
 
         void add_tri_2f(const vec2f& p1, const vec2f& p2, const vec2f& p3, const vec4f& colour)
         {
-            alloc_2d_buffer(tri_vert_2d_count + 6, VB_TRIS);
+            reserve_2d(6, VB_TRIS);
 
             // tri 1
             s32 start_index = tri_vert_2d_count;
@@ -776,7 +1075,7 @@ namespace put
 
         void add_quad_2f(const vec2f& pos, const vec2f& size, const vec4f& colour)
         {
-            alloc_2d_buffer(tri_vert_2d_count + 6, VB_TRIS);
+            reserve_2d(6, VB_TRIS);
 
             vec2f corners[4] = {pos + size * vec2f(-1.0f, -1.0f), pos + size * vec2f(-1.0f, 1.0f),
                                 pos + size * vec2f(1.0f, 1.0f), pos + size * vec2f(1.0f, -1.0f)};
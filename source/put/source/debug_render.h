@@ -6,9 +6,12 @@
 #define debug_render_h__
 
 // Minimalist c-style api for rendering debug primitives.
-// Adding primitives will push verts into a buffer which will grow to accomodate space as required.
+// Adding primitives writes verts straight into the renderer's transient stream memory, which grows as required.
 // 2D vertices and 3D vertices are stored in different buffers.
-// Calling render_2d or render_3d will flush the buffers and reset them ready for reuse.
+// Calling render_2d or render_3d will draw the primitives added since the last call, primitives which are not rendered
+// before renderer_consume_cmd_buffer are dropped.
+// Text is laid out once per distinct formatted string and cached across frames, each glyph is drawn as an instanced
+// quad sampling an atlas, so static labels and overlays only pay for formatting and a copy of their glyphs.
 
 #include "maths/maths.h"
 #include "pen.h"
@@ -0,0 +1,635 @@
+// ecs_anim_compression.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include <fstream>
+
+#include "data_struct.h"
+#include "file_system.h"
+#include "memory.h"
+
+#include "ecs/ecs_anim_compression.h"
+#include "ecs/ecs_scene.h"
+
+namespace put
+{
+    namespace ecs
+    {
+        namespace
+        {
+            const u32 k_compressed_anim_version = 1;
+
+            // uncompressed samples for a single track, 3 or 4 floats per frame
+            struct raw_track
+            {
+                u32  mask = 0;
+                u32  stride = 3;
+                f32* values = nullptr;
+            };
+
+            void relink_instances(const compressed_anim* prev, compressed_anim* ca)
+            {
+                ecs_scene_list* scenes = get_scenes();
+                for (auto& si : *scenes)
+                {
+                    ecs_scene* scene = si.scene;
+                    for (u32 n = 0; n < scene->num_entities; ++n)
+                    {
+                        if (!(scene->entities[n] & CMP_ANIM_CONTROLLER))
+                            continue;
+
+                        cmp_anim_controller_v2& controller = scene->anim_controller_v2[n];
+
+                        u32 num_anims = sb_count(controller.anim_instances);
+                        for (u32 a = 0; a < num_anims; ++a)
+                        {
+                            anim_instance& instance = controller.anim_instances[a];
+                            if (instance.compressed != prev)
+                                continue;
+
+                            instance.compressed = ca;
+
+                            // cached key cursors index the old tracks
+                            u32 num_samplers = sb_count(instance.samplers);
+                            for (u32 i = 0; i < num_samplers; ++i)
+                                memset(instance.samplers[i].track_pos, 0x0, sizeof(instance.samplers[i].track_pos));
+                        }
+                    }
+                }
+            }
+
+            f32 track_error(const raw_track& track, const f32* a, const f32* b)
+            {
+                if (track.stride == 4)
+                {
+                    f32 d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+                    return 1.0f - fabs(d);
+                }
+
+                f32 err = 0.0f;
+                for (u32 i = 0; i < 3; ++i)
+                    err = std::max<f32>(err, fabs(a[i] - b[i]));
+
+                return err;
+            }
+
+            void track_lerp(const raw_track& track, const f32* a, const f32* b, f32 t, f32* out)
+            {
+                if (track.stride == 4)
+                {
+                    f32 d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+                    f32 s = d < 0.0f ? -1.0f : 1.0f;
+
+                    f32 len2 = 0.0f;
+                    for (u32 i = 0; i < 4; ++i)
+                    {
+                        out[i] = a[i] + (b[i] * s - a[i]) * t;
+                        len2 += out[i] * out[i];
+                    }
+
+                    f32 rlen = len2 > 0.0f ? 1.0f / sqrt(len2) : 0.0f;
+                    for (u32 i = 0; i < 4; ++i)
+                        out[i] *= rlen;
+
+                    return;
+                }
+
+                for (u32 i = 0; i < 3; ++i)
+                    out[i] = a[i] + (b[i] - a[i]) * t;
+            }
+
+            // greedy error bounded reduction, keeps the first and last frame and extends each segment as far as
+            // linear interpolation between its end keys reproduces every frame in between
+            void reduce_keys(const raw_track& track, const f32* times, u32 num_frames, f32 tolerance, u32** keys_out)
+            {
+                u32 stride = track.stride;
+                const f32* v = track.values;
+
+                // constant
+                bool constant = true;
+                for (u32 f = 1; f < num_frames; ++f)
+                {
+                    if (track_error(track, &v[0], &v[f * stride]) > tolerance)
+                    {
+                        constant = false;
+                        break;
+                    }
+                }
+
+                sb_push(*keys_out, 0);
+
+                if (constant || num_frames < 2)
+                    return;
+
+                u32 start = 0;
+                while (start < num_frames - 1)
+                {
+                    u32 end = start + 1;
+
+                    for (u32 candidate = start + 2; candidate < num_frames; ++candidate)
+                    {
+                        bool ok = true;
+                        f32  span = times[candidate] - times[start];
+
+                        for (u32 m = start + 1; m < candidate; ++m)
+                        {
+                            f32 t = span > 0.0f ? (times[m] - times[start]) / span : 0.0f;
+
+                            f32 r[4];
+                            track_lerp(track, &v[start * stride], &v[candidate * stride], t, r);
+
+                            if (track_error(track, r, &v[m * stride]) > tolerance)
+                            {
+                                ok = false;
+                                break;
+                            }
+                        }
+
+                        if (!ok)
+                            break;
+
+                        end = candidate;
+                    }
+
+                    sb_push(*keys_out, end);
+                    start = end;
+                }
+            }
+
+            u16 quantise_unorm(f32 v)
+            {
+                v = std::min<f32>(std::max<f32>(v, 0.0f), 1.0f);
+                return (u16)(v * 65535.0f + 0.5f);
+            }
+
+            void encode_quat(const f32* q, u16* out)
+            {
+                static const f32 k_rsqrt2 = 0.70710678f;
+
+                u32 largest = 0;
+                for (u32 i = 1; i < 4; ++i)
+                    if (fabs(q[i]) > fabs(q[largest]))
+                        largest = i;
+
+                // q and -q are the same rotation, flip so the dropped component is positive
+                f32 s = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+                u32 oi = 0;
+                for (u32 i = 0; i < 4; ++i)
+                {
+                    if (i == largest)
+                        continue;
+
+                    f32 n = (q[i] * s + k_rsqrt2) / (2.0f * k_rsqrt2);
+                    n = std::min<f32>(std::max<f32>(n, 0.0f), 1.0f);
+                    out[oi++] = (u16)(n * 32767.0f + 0.5f);
+                }
+
+                out[0] |= (largest & 1) << 15;
+                out[1] |= (largest >> 1) << 15;
+            }
+
+            u32 num_soa_frames(const soa_anim& soa)
+            {
+                u32 max_frames = 0;
+                for (u32 c = 0; c < soa.num_channels; ++c)
+                    max_frames = std::max<u32>(max_frames, soa.channels[c].num_frames);
+
+                return max_frames;
+            }
+
+            void quat_mul(const f32* a, const f32* b, f32* out)
+            {
+                quat qa, qb;
+                memcpy(&qa.v[0], a, 16);
+                memcpy(&qb.v[0], b, 16);
+
+                quat r = qa * qb;
+                memcpy(out, &r.v[0], 16);
+            }
+        } // namespace
+
+        compressed_anim* compress_anim(const soa_anim& soa, f32 length, const anim_compression_params& params,
+                                       anim_compression_stats* stats)
+        {
+            compressed_anim* ca = new compressed_anim();
+            ca->num_channels = soa.num_channels;
+            ca->length = length;
+            ca->channels = new compressed_channel[soa.num_channels];
+
+            f32 tolerance[anim_track::COUNT] = {params.translation_error, params.scale_error, params.rotation_error};
+
+            for (u32 c = 0; c < soa.num_channels; ++c)
+            {
+                const anim_channel& channel = soa.channels[c];
+                compressed_channel& cc = ca->channels[c];
+
+                u32 num_frames = channel.num_frames;
+                cc.flags = channel.flags;
+
+                if (num_frames == 0)
+                    continue;
+
+                cc.start_time = soa.info[0][c].time;
+                cc.end_time = soa.info[num_frames - 1][c].time;
+
+                // extract tracks from the interleaved soa data
+                raw_track tracks[anim_track::COUNT];
+                tracks[anim_track::ROTATE].stride = 4;
+
+                f32* times = nullptr;
+
+                for (u32 f = 0; f < num_frames; ++f)
+                {
+                    const anim_info& info = soa.info[f][c];
+                    const f32*       d = &soa.data[f][info.offset];
+
+                    sb_push(times, info.time);
+
+                    f32 t[3] = {0.0f, 0.0f, 0.0f};
+                    f32 s[3] = {1.0f, 1.0f, 1.0f};
+                    f32 q[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+
+                    for (u32 e = 0; e < channel.element_count; ++e)
+                    {
+                        u32 eo = channel.element_offset[e];
+
+                        if (eo == A_OUT_QUAT)
+                        {
+                            // multiple rotations are concatenated in the same order as the sampler applies them
+                            f32 r[4];
+                            quat_mul(&d[e], q, r);
+                            memcpy(q, r, 16);
+
+                            tracks[anim_track::ROTATE].mask = 0xf;
+                            e += 3;
+                        }
+                        else if (eo >= A_OUT_SX)
+                        {
+                            s[eo - A_OUT_SX] = d[e];
+                            tracks[anim_track::SCALE].mask |= 1 << (eo - A_OUT_SX);
+                        }
+                        else
+                        {
+                            t[eo - A_OUT_TX] = d[e];
+                            tracks[anim_track::TRANSLATE].mask |= 1 << (eo - A_OUT_TX);
+                        }
+                    }
+
+                    for (u32 i = 0; i < 3; ++i)
+                    {
+                        sb_push(tracks[anim_track::TRANSLATE].values, t[i]);
+                        sb_push(tracks[anim_track::SCALE].values, s[i]);
+                    }
+
+                    // keep rotations in the same hemisphere so reduction interpolates the short way
+                    if (f > 0)
+                    {
+                        f32* pq = &tracks[anim_track::ROTATE].values[(f - 1) * 4];
+                        if (pq[0] * q[0] + pq[1] * q[1] + pq[2] * q[2] + pq[3] * q[3] < 0.0f)
+                            for (u32 i = 0; i < 4; ++i)
+                                q[i] = -q[i];
+                    }
+
+                    for (u32 i = 0; i < 4; ++i)
+                        sb_push(tracks[anim_track::ROTATE].values, q[i]);
+                }
+
+                for (u32 tr = 0; tr < anim_track::COUNT; ++tr)
+                {
+                    raw_track&        track = tracks[tr];
+                    compressed_track& ct = cc.tracks[tr];
+
+                    if (track.mask)
+                    {
+                        u32* keys = nullptr;
+                        reduce_keys(track, times, num_frames, tolerance[tr], &keys);
+
+                        u32 num_keys = sb_count(keys);
+
+                        ct.mask = track.mask;
+                        ct.num_keys = num_keys;
+
+                        // range
+                        for (u32 i = 0; i < 3; ++i)
+                        {
+                            ct.min[i] = 0.0f;
+                            ct.range[i] = 0.0f;
+                        }
+
+                        if (tr != anim_track::ROTATE)
+                        {
+                            f32 max_v[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+                            for (u32 i = 0; i < 3; ++i)
+                                ct.min[i] = FLT_MAX;
+
+                            for (u32 k = 0; k < num_keys; ++k)
+                            {
+                                const f32* v = &track.values[keys[k] * 3];
+                                for (u32 i = 0; i < 3; ++i)
+                                {
+                                    ct.min[i] = std::min<f32>(ct.min[i], v[i]);
+                                    max_v[i] = std::max<f32>(max_v[i], v[i]);
+                                }
+                            }
+
+                            for (u32 i = 0; i < 3; ++i)
+                                ct.range[i] = max_v[i] - ct.min[i];
+                        }
+
+                        // times
+                        ct.times = sb_count(ca->keys);
+                        for (u32 k = 0; k < num_keys; ++k)
+                        {
+                            f32 nt = length > 0.0f ? times[keys[k]] / length : 0.0f;
+                            sb_push(ca->keys, quantise_unorm(nt));
+                        }
+
+                        // data
+                        ct.data = sb_count(ca->keys);
+                        for (u32 k = 0; k < num_keys; ++k)
+                        {
+                            u16 q[3] = {0};
+
+                            if (tr == anim_track::ROTATE)
+                            {
+                                encode_quat(&track.values[keys[k] * 4], q);
+                            }
+                            else
+                            {
+                                const f32* v = &track.values[keys[k] * 3];
+                                for (u32 i = 0; i < 3; ++i)
+                                    if (ct.range[i] > 0.0f)
+                                        q[i] = quantise_unorm((v[i] - ct.min[i]) / ct.range[i]);
+                            }
+
+                            for (u32 i = 0; i < 3; ++i)
+                                sb_push(ca->keys, q[i]);
+                        }
+
+                        if (stats)
+                        {
+                            stats->raw_keys += num_frames;
+                            stats->compressed_keys += num_keys;
+
+                            if (num_keys == 1)
+                                stats->constant_tracks++;
+                            else
+                                stats->animated_tracks++;
+                        }
+
+                        sb_free(keys);
+                    }
+
+                    sb_free(track.values);
+                }
+
+                sb_free(times);
+            }
+
+            ca->num_keys = sb_count(ca->keys);
+
+            if (stats)
+            {
+                stats->raw_bytes = get_anim_memory_size(soa);
+                stats->compressed_bytes = get_compressed_anim_memory_size(ca);
+            }
+
+            return ca;
+        }
+
+        void free_compressed_anim(compressed_anim* ca)
+        {
+            if (!ca)
+                return;
+
+            delete[] ca->channels;
+            sb_free(ca->keys);
+            delete ca;
+        }
+
+        bool compress_animation(anim_handle h, const anim_compression_params& params)
+        {
+            animation_resource* anim = get_animation_resource(h);
+            if (!anim)
+                return false;
+
+            compressed_anim* prev = anim->compressed;
+            anim->compressed = compress_anim(anim->soa, anim->length, params);
+
+            // instances bound with bind_animation_to_rig sample the clip directly, move them over before it is freed
+            if (prev)
+                relink_instances(prev, anim->compressed);
+
+            free_compressed_anim(prev);
+            return true;
+        }
+
+        bool save_compressed_anim(const c8* filename, const compressed_anim* ca)
+        {
+            std::ofstream ofs(filename, std::ofstream::binary);
+            if (!ofs.is_open())
+                return false;
+
+            ofs.write((const c8*)&k_compressed_anim_version, sizeof(u32));
+            ofs.write((const c8*)&ca->num_channels, sizeof(u32));
+            ofs.write((const c8*)&ca->length, sizeof(f32));
+            ofs.write((const c8*)&ca->num_keys, sizeof(u32));
+            ofs.write((const c8*)ca->channels, sizeof(compressed_channel) * ca->num_channels);
+            ofs.write((const c8*)ca->keys, sizeof(u16) * ca->num_keys);
+
+            ofs.close();
+            return true;
+        }
+
+        compressed_anim* load_compressed_anim(const c8* filename)
+        {
+            void* file_data;
+            u32   file_size;
+
+            pen_error err = pen::filesystem_read_file_to_buffer(filename, &file_data, file_size);
+            if (err != PEN_ERR_OK || file_size < sizeof(u32) * 4)
+                return nullptr;
+
+            const u8* reader = (const u8*)file_data;
+
+            u32 header[4];
+            memcpy(header, reader, sizeof(header));
+            reader += sizeof(header);
+
+            if (header[0] != k_compressed_anim_version)
+            {
+                pen::memory_free(file_data);
+                return nullptr;
+            }
+
+            // counts come from the file, reject any which would read past the end of it
+            u64 num_channels = header[1];
+            u64 num_keys = header[3];
+            u64 data_size = sizeof(header) + sizeof(compressed_channel) * num_channels + sizeof(u16) * num_keys;
+            if (data_size > file_size)
+            {
+                pen::memory_free(file_data);
+                return nullptr;
+            }
+
+            compressed_anim* ca = new compressed_anim();
+            ca->num_channels = header[1];
+            memcpy(&ca->length, &header[2], sizeof(f32));
+            ca->num_keys = header[3];
+
+            ca->channels = new compressed_channel[ca->num_channels];
+            memcpy(ca->channels, reader, sizeof(compressed_channel) * ca->num_channels);
+            reader += sizeof(compressed_channel) * ca->num_channels;
+
+            sb_grow(ca->keys, ca->num_keys);
+            stb__sbn(ca->keys) = ca->num_keys;
+            memcpy(ca->keys, reader, sizeof(u16) * ca->num_keys);
+
+            pen::memory_free(file_data);
+
+            // and tracks which index outside of the keys
+            bool ok = true;
+            for (u32 c = 0; ok && c < ca->num_channels; ++c)
+            {
+                for (u32 tr = 0; ok && tr < anim_track::COUNT; ++tr)
+                {
+                    const compressed_track& ct = ca->channels[c].tracks[tr];
+                    u64                     n = ct.num_keys;
+                    ok = (u64)ct.times + n <= num_keys && (u64)ct.data + n * 3 <= num_keys;
+                }
+            }
+
+            if (!ok)
+            {
+                free_compressed_anim(ca);
+                return nullptr;
+            }
+
+            return ca;
+        }
+
+        size_t get_anim_memory_size(const soa_anim& soa)
+        {
+            u32 num_frames = num_soa_frames(soa);
+
+            size_t size = sizeof(soa_anim);
+            size += sizeof(anim_channel) * soa.num_channels;
+            size += (sizeof(f32*) + sizeof(anim_info*)) * num_frames;
+
+            for (u32 f = 0; f < num_frames; ++f)
+            {
+                size += sizeof(f32) * sb_count(soa.data[f]);
+                size += sizeof(anim_info) * sb_count(soa.info[f]);
+            }
+
+            return size;
+        }
+
+        size_t get_compressed_anim_memory_size(const compressed_anim* ca)
+        {
+            if (!ca)
+                return 0;
+
+            size_t size = sizeof(compressed_anim);
+            size += sizeof(compressed_channel) * ca->num_channels;
+            size += sizeof(u16) * ca->num_keys;
+
+            return size;
+        }
+
+        void sample_compressed_track(const compressed_anim* ca, u32 c, u32 tr, f32 t, u32& cursor, anim_target& target)
+        {
+            const compressed_track& ct = ca->channels[c].tracks[tr];
+
+            if (ct.num_keys == 0)
+                return;
+
+            const u16* times = &ca->keys[ct.times];
+            const u16* data = &ca->keys[ct.data];
+
+            // find key k where times[k] <= t < times[k + 1], checking the cached key first
+            u32 k0 = 0;
+            u32 k1 = 0;
+            f32 it = 0.0f;
+
+            if (ct.num_keys > 1)
+            {
+                f32 nt = ca->length > 0.0f ? (t / ca->length) * 65535.0f : 0.0f;
+                u32 last = ct.num_keys - 1;
+
+                if (nt <= (f32)times[0])
+                {
+                    cursor = 0;
+                    k1 = 0;
+                }
+                else if (nt >= (f32)times[last])
+                {
+                    cursor = last;
+                    k0 = k1 = last;
+                }
+                else
+                {
+                    if (cursor >= last || nt < (f32)times[cursor] || nt >= (f32)times[cursor + 1])
+                    {
+                        if (cursor + 1 < last && nt >= (f32)times[cursor + 1] && nt < (f32)times[cursor + 2])
+                        {
+                            cursor = cursor + 1;
+                        }
+                        else
+                        {
+                            u32 lo = 0;
+                            u32 hi = last;
+                            while (hi - lo > 1)
+                            {
+                                u32 mid = (lo + hi) / 2;
+                                if ((f32)times[mid] <= nt)
+                                    lo = mid;
+                                else
+                                    hi = mid;
+                            }
+                            cursor = lo;
+                        }
+                    }
+
+                    k0 = cursor;
+                    k1 = cursor + 1;
+                    it = (nt - (f32)times[k0]) / (f32)(times[k1] - times[k0]);
+                }
+            }
+
+            const u16* d0 = &data[k0 * 3];
+            const u16* d1 = &data[k1 * 3];
+
+            if (tr == anim_track::ROTATE)
+            {
+                f32 q0[4];
+                f32 q1[4];
+                anim_decode_quat(d0, q0);
+                anim_decode_quat(d1, q1);
+
+                raw_track rt;
+                rt.stride = 4;
+
+                quat ql;
+                track_lerp(rt, q0, q1, it, &ql.v[0]);
+
+                target.q = ql * target.q;
+                target.flags |= ca->channels[c].flags;
+                return;
+            }
+
+            u32 base = tr == anim_track::TRANSLATE ? A_OUT_TX : A_OUT_SX;
+            for (u32 i = 0; i < 3; ++i)
+            {
+                if (!(ct.mask & (1 << i)))
+                    continue;
+
+                f32 v0 = anim_dequantise(d0[i], ct.min[i], ct.range[i]);
+                f32 v1 = anim_dequantise(d1[i], ct.min[i], ct.range[i]);
+
+                target.t[base + i] = v0 + (v1 - v0) * it;
+            }
+        }
+    } // namespace ecs
+} // namespace put
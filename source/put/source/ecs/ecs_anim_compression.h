@@ -0,0 +1,115 @@
+// ecs_anim_compression.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "ecs/ecs_resources.h"
+
+// Compressed animation clips.
+// Each channel is split into translation, scale and rotation tracks. Constant tracks are stripped down to a single key,
+// remaining tracks are reduced to the minimum set of keys which reproduce the source within an error bound and
+// are stored in a single pool of u16s:
+//      key times are normalised over the clip length.
+//      translation and scale are range quantised per track.
+//      rotations are stored smallest three, 15 bits per component with the dropped index in the top bits.
+// The compressed clip contains no pointers other than channels and keys so it can be written and loaded as is.
+
+namespace put
+{
+    namespace ecs
+    {
+        namespace anim_track
+        {
+            enum anim_track_type
+            {
+                TRANSLATE = 0,
+                SCALE,
+                ROTATE,
+                COUNT
+            };
+        }
+
+        struct anim_compression_params
+        {
+            f32 translation_error = 0.0001f; // max absolute error in units
+            f32 scale_error = 0.0001f;       // max absolute error
+            f32 rotation_error = 0.00001f;   // max 1 - |dot(q1, q2)|
+        };
+
+        struct compressed_track
+        {
+            u32 mask = 0;     // components present, xyz for translate and scale, always 0xf for rotations
+            u32 num_keys = 0; // 0 = track not present, 1 = constant
+            u32 times = 0;    // offset into keys, 1 x u16 normalised time per key
+            u32 data = 0;     // offset into keys, 3 x u16 per key
+            f32 min[3];
+            f32 range[3];
+        };
+
+        struct compressed_channel
+        {
+            u32              flags = 0;
+            f32              start_time = 0.0f;
+            f32              end_time = 0.0f;
+            compressed_track tracks[anim_track::COUNT];
+        };
+
+        struct compressed_anim
+        {
+            u32                 num_channels = 0;
+            f32                 length = 0.0f;
+            u32                 num_keys = 0;
+            compressed_channel* channels = nullptr;
+            u16*                keys = nullptr;
+        };
+
+        struct anim_compression_stats
+        {
+            size_t raw_bytes = 0;
+            size_t compressed_bytes = 0;
+            u32    raw_keys = 0;
+            u32    compressed_keys = 0;
+            u32    constant_tracks = 0;
+            u32    animated_tracks = 0;
+        };
+
+        compressed_anim* compress_anim(const soa_anim& soa, f32 length, const anim_compression_params& params,
+                                       anim_compression_stats* stats = nullptr);
+        void             free_compressed_anim(compressed_anim* ca);
+
+        bool             compress_animation(anim_handle h, const anim_compression_params& params);
+        bool             save_compressed_anim(const c8* filename, const compressed_anim* ca);
+        compressed_anim* load_compressed_anim(const c8* filename);
+
+        size_t get_anim_memory_size(const soa_anim& soa);
+        size_t get_compressed_anim_memory_size(const compressed_anim* ca);
+
+        // samples track tr of channel c at time t into the anim target, cursor caches the current key
+        void sample_compressed_track(const compressed_anim* ca, u32 c, u32 tr, f32 t, u32& cursor, anim_target& target);
+
+        pen_inline f32 anim_dequantise(u16 v, f32 min, f32 range)
+        {
+            return min + ((f32)v / 65535.0f) * range;
+        }
+
+        pen_inline void anim_decode_quat(const u16* k, f32* out)
+        {
+            static const f32 k_rsqrt2 = 0.70710678f;
+            static const f32 k_scale = 1.41421356f / 32767.0f;
+
+            u32 largest = (k[0] >> 15) | ((k[1] >> 15) << 1);
+
+            f32 a = (f32)(k[0] & 0x7fff) * k_scale - k_rsqrt2;
+            f32 b = (f32)(k[1] & 0x7fff) * k_scale - k_rsqrt2;
+            f32 c = (f32)(k[2] & 0x7fff) * k_scale - k_rsqrt2;
+            f32 d = 1.0f - a * a - b * b - c * c;
+            d = d > 0.0f ? sqrt(d) : 0.0f;
+
+            f32 s[3] = {a, b, c};
+            u32 si = 0;
+            for (u32 i = 0; i < 4; ++i)
+                out[i] = i == largest ? d : s[si++];
+        }
+    } // namespace ecs
+} // namespace put
@@ -0,0 +1,933 @@
+// ecs_bvh.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "ecs/ecs_bvh.h"
+#include "data_struct.h"
+#include "ecs/ecs_resources.h"
+#include "memory.h"
+#include "timer.h"
+
+#include <algorithm>
+
+using namespace put;
+using namespace ecs;
+
+namespace put
+{
+    namespace ecs
+    {
+        // triangles are copied in leaf order, leaves have count > 0 and index the triangles, internal nodes have
+        // count 0 and their children at first and first + 1
+        struct triangle_node
+        {
+            vec3f min;
+            vec3f max;
+            u32   first;
+            u32   count;
+        };
+
+        struct triangle_bvh
+        {
+            geometry_resource* geometry = nullptr;
+            triangle_node*     nodes = nullptr;
+            vec3f*             verts = nullptr; // 3 per triangle
+            u32*               tris = nullptr;  // first index of each triangle in the index buffer
+        };
+    } // namespace ecs
+} // namespace put
+
+namespace
+{
+    const u32 k_stack_size = 128; // the entity tree is rebalanced as it changes and triangles split at the median
+    const u32 k_leaf_triangles = 4;
+    const f32 k_margin = 0.1f; // leaf boxes grow by this fraction of their size on each side, plus k_min_margin
+    const f32 k_min_margin = 0.01f;
+
+    struct stack_entry
+    {
+        u32 node;
+        f32 t;
+    };
+
+    inline vec3f ray_inv(const vec3f& rv)
+    {
+        return vec3f(1.0f / rv.x, 1.0f / rv.y, 1.0f / rv.z);
+    }
+
+    // slab test, entry t clamped to 0 when the ray starts inside, FLT_MAX for a miss
+    inline f32 ray_vs_aabb(const vec3f& min, const vec3f& max, const vec3f& r0, const vec3f& inv, f32 t_max)
+    {
+        f32 t0 = 0.0f;
+        f32 t1 = t_max;
+
+        for (u32 i = 0; i < 3; ++i)
+        {
+            f32 a = (min[i] - r0[i]) * inv[i];
+            f32 b = (max[i] - r0[i]) * inv[i];
+
+            t0 = std::max(t0, std::min(a, b));
+            t1 = std::min(t1, std::max(a, b));
+        }
+
+        return t0 <= t1 ? t0 : FLT_MAX;
+    }
+
+    // moller trumbore, double sided
+    inline bool ray_vs_triangle(const vec3f* v, const vec3f& r0, const vec3f& rv, f32& t)
+    {
+        vec3f e1 = v[1] - v[0];
+        vec3f e2 = v[2] - v[0];
+        vec3f p = cross(rv, e2);
+        f32   det = dot(e1, p);
+
+        if (fabsf(det) < 1e-12f)
+            return false;
+
+        f32   inv_det = 1.0f / det;
+        vec3f s = r0 - v[0];
+        f32   u = dot(s, p) * inv_det;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+
+        vec3f q = cross(s, e1);
+        f32   w = dot(rv, q) * inv_det;
+        if (w < 0.0f || u + w > 1.0f)
+            return false;
+
+        t = dot(e2, q) * inv_det;
+        return t >= 0.0f;
+    }
+
+    inline bool aabb_overlap(const vec3f& min0, const vec3f& max0, const vec3f& min1, const vec3f& max1)
+    {
+        for (u32 i = 0; i < 3; ++i)
+            if (min0[i] > max1[i] || max0[i] < min1[i])
+                return false;
+
+        return true;
+    }
+
+    inline bool sphere_overlap(const vec3f& min, const vec3f& max, const vec3f& pos, f32 radius)
+    {
+        vec3f cp = vec3f::vmin(vec3f::vmax(pos, min), max);
+        vec3f d = cp - pos;
+        return dot(d, d) <= radius * radius;
+    }
+
+    inline f32 half_area(const vec3f& min, const vec3f& max)
+    {
+        vec3f d = max - min;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+    inline f32 union_area(const bvh_node& a, const bvh_node& b)
+    {
+        return half_area(vec3f::vmin(a.min, b.min), vec3f::vmax(a.max, b.max));
+    }
+
+    bool get_entity_aabb(ecs_scene* scene, u32 e, vec3f& min, vec3f& max)
+    {
+        if (e >= scene->num_entities)
+            return false;
+
+        u64 flags = scene->entities[e];
+        if (!(flags & CMP_ALLOCATED) || !(flags & CMP_GEOMETRY))
+            return false;
+
+        min = scene->bounding_volumes[e].transformed_min_extents;
+        max = scene->bounding_volumes[e].transformed_max_extents;
+
+        // unset or unbounded extents stay out of the tree
+        for (u32 i = 0; i < 3; ++i)
+            if (!(min[i] <= max[i]) || fabsf(min[i]) > 1e18f || fabsf(max[i]) > 1e18f)
+                return false;
+
+        return true;
+    }
+
+    inline bool query_entity(ecs_scene* scene, u32 e, u32 flags)
+    {
+        if (e >= scene->num_entities || !(scene->entities[e] & CMP_ALLOCATED))
+            return false;
+
+        if ((flags & BVH_QUERY_VISIBLE) && (scene->state_flags[e] & SF_HIDDEN))
+            return false;
+
+        return true;
+    }
+
+    //
+    // dynamic tree
+    //
+
+    u32 alloc_node(ecs_bvh* bvh)
+    {
+        u32 i = bvh->free_list;
+        if (i != PEN_INVALID_HANDLE)
+        {
+            bvh->free_list = bvh->nodes[i].parent;
+        }
+        else
+        {
+            i = sb_count(bvh->nodes);
+            sb_push(bvh->nodes, bvh_node());
+        }
+
+        bvh_node& n = bvh->nodes[i];
+        n.parent = PEN_INVALID_HANDLE;
+        n.child[0] = n.child[1] = PEN_INVALID_HANDLE;
+        n.entity = PEN_INVALID_HANDLE;
+        n.height = 0;
+        return i;
+    }
+
+    void free_node(ecs_bvh* bvh, u32 i)
+    {
+        bvh->nodes[i].parent = bvh->free_list;
+        bvh->nodes[i].height = -1;
+        bvh->free_list = i;
+    }
+
+    void refit(ecs_bvh* bvh, u32 i)
+    {
+        bvh_node& n = bvh->nodes[i];
+        bvh_node& a = bvh->nodes[n.child[0]];
+        bvh_node& b = bvh->nodes[n.child[1]];
+
+        n.min = vec3f::vmin(a.min, b.min);
+        n.max = vec3f::vmax(a.max, b.max);
+        n.height = 1 + std::max(a.height, b.height);
+    }
+
+    void replace_child(ecs_bvh* bvh, u32 parent, u32 old_child, u32 new_child)
+    {
+        if (parent == PEN_INVALID_HANDLE)
+        {
+            bvh->root = new_child;
+            return;
+        }
+
+        bvh_node& p = bvh->nodes[parent];
+        p.child[p.child[0] == old_child ? 0 : 1] = new_child;
+    }
+
+    // if one child of a is 2 taller than the other, the taller child takes a's place, a takes the shorter of the
+    // taller child's children and the taller grandchild stays where it was
+    u32 balance(ecs_bvh* bvh, u32 a)
+    {
+        bvh_node* nodes = bvh->nodes;
+        if (nodes[a].height < 2)
+            return a;
+
+        s32 diff = nodes[nodes[a].child[1]].height - nodes[nodes[a].child[0]].height;
+        if (diff >= -1 && diff <= 1)
+            return a;
+
+        u32 side = diff > 1 ? 1 : 0;
+        u32 lift = nodes[a].child[side];
+
+        u32 g0 = nodes[lift].child[0];
+        u32 g1 = nodes[lift].child[1];
+        u32 tall = nodes[g0].height > nodes[g1].height ? g0 : g1;
+        u32 low = tall == g0 ? g1 : g0;
+
+        nodes[lift].parent = nodes[a].parent;
+        replace_child(bvh, nodes[a].parent, a, lift);
+
+        nodes[lift].child[0] = a;
+        nodes[lift].child[1] = tall;
+        nodes[a].parent = lift;
+
+        nodes[a].child[side] = low;
+        nodes[low].parent = a;
+
+        refit(bvh, a);
+        refit(bvh, lift);
+        return lift;
+    }
+
+    void fix_upwards(ecs_bvh* bvh, u32 i)
+    {
+        while (i != PEN_INVALID_HANDLE)
+        {
+            i = balance(bvh, i);
+            refit(bvh, i);
+            i = bvh->nodes[i].parent;
+        }
+    }
+
+    void insert_leaf(ecs_bvh* bvh, u32 leaf)
+    {
+        if (bvh->root == PEN_INVALID_HANDLE)
+        {
+            bvh->root = leaf;
+            bvh->nodes[leaf].parent = PEN_INVALID_HANDLE;
+            return;
+        }
+
+        // descend while it is cheaper to push the leaf further down than to pair it with the current node
+        const bvh_node& l = bvh->nodes[leaf];
+        u32             i = bvh->root;
+
+        while (bvh->nodes[i].height > 0)
+        {
+            const bvh_node& n = bvh->nodes[i];
+
+            f32 area = half_area(n.min, n.max);
+            f32 combined = union_area(n, l);
+            f32 cost = 2.0f * combined;
+            f32 inherit = 2.0f * (combined - area);
+
+            f32 child_cost[2];
+            for (u32 c = 0; c < 2; ++c)
+            {
+                const bvh_node& cn = bvh->nodes[n.child[c]];
+                child_cost[c] = union_area(cn, l) + inherit;
+                if (cn.height > 0)
+                    child_cost[c] -= half_area(cn.min, cn.max);
+            }
+
+            if (cost < child_cost[0] && cost < child_cost[1])
+                break;
+
+            i = n.child[child_cost[0] < child_cost[1] ? 0 : 1];
+        }
+
+        u32 sibling = i;
+        u32 old_parent = bvh->nodes[sibling].parent;
+        u32 new_parent = alloc_node(bvh);
+
+        bvh_node& np = bvh->nodes[new_parent];
+        np.parent = old_parent;
+        np.child[0] = sibling;
+        np.child[1] = leaf;
+
+        replace_child(bvh, old_parent, sibling, new_parent);
+
+        bvh->nodes[sibling].parent = new_parent;
+        bvh->nodes[leaf].parent = new_parent;
+
+        fix_upwards(bvh, new_parent);
+    }
+
+    void remove_leaf(ecs_bvh* bvh, u32 leaf)
+    {
+        if (leaf == bvh->root)
+        {
+            bvh->root = PEN_INVALID_HANDLE;
+            return;
+        }
+
+        u32 parent = bvh->nodes[leaf].parent;
+        u32 grand_parent = bvh->nodes[parent].parent;
+        u32 sibling = bvh->nodes[parent].child[bvh->nodes[parent].child[0] == leaf ? 1 : 0];
+
+        replace_child(bvh, grand_parent, parent, sibling);
+        bvh->nodes[sibling].parent = grand_parent;
+        free_node(bvh, parent);
+
+        fix_upwards(bvh, grand_parent);
+    }
+
+    void set_leaf_box(bvh_node& n, const vec3f& min, const vec3f& max)
+    {
+        vec3f margin = (max - min) * k_margin + vec3f(k_min_margin);
+        n.min = min - margin;
+        n.max = max + margin;
+    }
+
+    inline bool contains(const bvh_node& n, const vec3f& min, const vec3f& max)
+    {
+        for (u32 i = 0; i < 3; ++i)
+            if (min[i] < n.min[i] || max[i] > n.max[i])
+                return false;
+
+        return true;
+    }
+
+    ecs_bvh* get_bvh(ecs_scene* scene)
+    {
+        if (!scene->bvh)
+            update_bvh(scene);
+
+        return scene->bvh;
+    }
+
+    //
+    // triangle trees
+    //
+
+    void build_triangle_bvh(triangle_bvh* tb, geometry_resource* gr)
+    {
+        tb->geometry = gr;
+
+        u32 num_tris = gr->num_indices / 3;
+        if (num_tris == 0)
+            return;
+
+        const vec4f* positions = (const vec4f*)gr->cpu_position_buffer;
+
+        vec3f* centres = (vec3f*)pen::memory_alloc(num_tris * sizeof(vec3f));
+        u32*   order = (u32*)pen::memory_alloc(num_tris * sizeof(u32));
+
+        for (u32 t = 0; t < num_tris; ++t)
+        {
+            vec3f c = vec3f::zero();
+            for (u32 j = 0; j < 3; ++j)
+            {
+                u32 idx = gr->index_type == PEN_FORMAT_R32_UINT ? ((u32*)gr->cpu_index_buffer)[t * 3 + j]
+                                                                 : ((u16*)gr->cpu_index_buffer)[t * 3 + j];
+                c += positions[idx].xyz;
+            }
+
+            centres[t] = c / 3.0f;
+            order[t] = t;
+        }
+
+        struct build_item
+        {
+            u32 node;
+            u32 start;
+            u32 end;
+        };
+
+        build_item stack[k_stack_size];
+        u32        sp = 0;
+
+        sb_push(tb->nodes, triangle_node());
+        stack[sp++] = {0, 0, num_tris};
+
+        while (sp > 0)
+        {
+            build_item item = stack[--sp];
+
+            vec3f cmin = vec3f::flt_max();
+            vec3f cmax = -vec3f::flt_max();
+            for (u32 i = item.start; i < item.end; ++i)
+            {
+                cmin = vec3f::vmin(cmin, centres[order[i]]);
+                cmax = vec3f::vmax(cmax, centres[order[i]]);
+            }
+
+            u32 count = item.end - item.start;
+            if (count <= k_leaf_triangles)
+            {
+                tb->nodes[item.node].first = item.start;
+                tb->nodes[item.node].count = count;
+                continue;
+            }
+
+            // median split on the longest axis of the centres keeps the height at log2 of the triangle count
+            vec3f ext = cmax - cmin;
+            u32   axis = ext.x > ext.y ? (ext.x > ext.z ? 0 : 2) : (ext.y > ext.z ? 1 : 2);
+            u32   mid = item.start + count / 2;
+
+            std::nth_element(order + item.start, order + mid, order + item.end,
+                             [centres, axis](u32 a, u32 b) { return centres[a][axis] < centres[b][axis]; });
+
+            u32 first = sb_count(tb->nodes);
+            sb_push(tb->nodes, triangle_node());
+            sb_push(tb->nodes, triangle_node());
+
+            tb->nodes[item.node].first = first;
+            tb->nodes[item.node].count = 0;
+
+            stack[sp++] = {first, item.start, mid};
+            stack[sp++] = {first + 1, mid, item.end};
+        }
+
+        // copy triangles in leaf order
+        for (u32 i = 0; i < num_tris; ++i)
+        {
+            u32 t = order[i];
+            sb_push(tb->tris, t * 3);
+
+            for (u32 j = 0; j < 3; ++j)
+            {
+                u32 idx = gr->index_type == PEN_FORMAT_R32_UINT ? ((u32*)gr->cpu_index_buffer)[t * 3 + j]
+                                                                 : ((u16*)gr->cpu_index_buffer)[t * 3 + j];
+                sb_push(tb->verts, positions[idx].xyz);
+            }
+        }
+
+        // bounds bottom up, children are always created after their parent
+        u32 num_nodes = sb_count(tb->nodes);
+        for (s32 i = num_nodes - 1; i >= 0; --i)
+        {
+            triangle_node& n = tb->nodes[i];
+            if (n.count > 0)
+            {
+                n.min = vec3f::flt_max();
+                n.max = -vec3f::flt_max();
+                for (u32 v = n.first * 3; v < (n.first + n.count) * 3; ++v)
+                {
+                    n.min = vec3f::vmin(n.min, tb->verts[v]);
+                    n.max = vec3f::vmax(n.max, tb->verts[v]);
+                }
+            }
+            else
+            {
+                n.min = vec3f::vmin(tb->nodes[n.first].min, tb->nodes[n.first + 1].min);
+                n.max = vec3f::vmax(tb->nodes[n.first].max, tb->nodes[n.first + 1].max);
+            }
+        }
+
+        pen::memory_free(centres);
+        pen::memory_free(order);
+    }
+
+    triangle_bvh* get_triangle_bvh(ecs_bvh* bvh, ecs_scene* scene, u32 e)
+    {
+        if (scene->entities[e] & (CMP_SKINNED | CMP_PRE_SKINNED))
+            return nullptr;
+
+        geometry_resource* gr = get_geometry_resource(scene->id_geometry[e]);
+        if (!gr || !gr->cpu_position_buffer || !gr->cpu_index_buffer)
+            return nullptr;
+
+        u32 num_bvhs = sb_count(bvh->triangle_bvhs);
+        for (u32 i = 0; i < num_bvhs; ++i)
+            if (bvh->triangle_bvhs[i]->geometry == gr)
+                return bvh->triangle_bvhs[i];
+
+        triangle_bvh* tb = new triangle_bvh();
+        build_triangle_bvh(tb, gr);
+
+        sb_push(bvh->triangle_bvhs, tb);
+        bvh->stats.num_triangle_bvhs++;
+
+        return tb;
+    }
+
+    void free_triangle_bvh(triangle_bvh* tb)
+    {
+        sb_free(tb->nodes);
+        sb_free(tb->verts);
+        sb_free(tb->tris);
+        delete tb;
+    }
+
+    // ray in the triangle tree's space, t is shared with world space because the ray vector is transformed too
+    bool ray_cast_triangles(const triangle_bvh* tree, const vec3f& r0, const vec3f& rv, f32& best, u32& tri)
+    {
+        if (!tree->nodes)
+            return false;
+
+        vec3f inv = ray_inv(rv);
+        bool  hit = false;
+
+        stack_entry stack[k_stack_size];
+        u32         sp = 0;
+
+        f32 t0 = ray_vs_aabb(tree->nodes[0].min, tree->nodes[0].max, r0, inv, best);
+        if (t0 == FLT_MAX)
+            return false;
+
+        stack[sp++] = {0, t0};
+
+        while (sp > 0)
+        {
+            stack_entry se = stack[--sp];
+            if (se.t >= best)
+                continue;
+
+            const triangle_node& n = tree->nodes[se.node];
+            if (n.count > 0)
+            {
+                for (u32 i = n.first; i < n.first + n.count; ++i)
+                {
+                    f32 t;
+                    if (ray_vs_triangle(&tree->verts[i * 3], r0, rv, t) && t < best)
+                    {
+                        best = t;
+                        tri = i;
+                        hit = true;
+                    }
+                }
+
+                continue;
+            }
+
+            const triangle_node& a = tree->nodes[n.first];
+            const triangle_node& b = tree->nodes[n.first + 1];
+
+            // push the far child first so the near one is walked first
+            stack_entry near_child = {n.first, ray_vs_aabb(a.min, a.max, r0, inv, best)};
+            stack_entry far_child = {n.first + 1, ray_vs_aabb(b.min, b.max, r0, inv, best)};
+            if (far_child.t < near_child.t)
+                std::swap(near_child, far_child);
+
+            if (far_child.t != FLT_MAX)
+                stack[sp++] = far_child;
+
+            if (near_child.t != FLT_MAX)
+                stack[sp++] = near_child;
+        }
+
+        return hit;
+    }
+
+    // closest hit with a leaf, returns false if it is not closer than hit.t
+    bool ray_cast_leaf(ecs_bvh* bvh, ecs_scene* scene, u32 e, const vec3f& r0, const vec3f& rv, const vec3f& inv,
+                       bvh_hit& hit, u32 flags)
+    {
+        const cmp_bounding_volume& bv = scene->bounding_volumes[e];
+
+        f32 t = ray_vs_aabb(bv.transformed_min_extents, bv.transformed_max_extents, r0, inv, hit.t);
+        if (t == FLT_MAX)
+            return false;
+
+        if (flags & BVH_QUERY_TRIANGLES)
+        {
+            triangle_bvh* tb = get_triangle_bvh(bvh, scene, e);
+            if (tb)
+            {
+                const mat4& world = scene->world_matrices[e];
+                mat4        inv_world = mat::inverse3x4(world);
+
+                vec3f lr0 = inv_world.transform_vector(r0);
+                vec3f lrv = inv_world.transform_vector(r0 + rv) - lr0;
+
+                f32 best = hit.t;
+                u32 tri = PEN_INVALID_HANDLE;
+                if (!ray_cast_triangles(tb, lr0, lrv, best, tri))
+                    return false;
+
+                vec3f v[3];
+                for (u32 j = 0; j < 3; ++j)
+                    v[j] = world.transform_vector(tb->verts[tri * 3 + j]);
+
+                vec3f n = cross(v[1] - v[0], v[2] - v[0]);
+                f32   len = mag(n);
+                n = len > 0.0f ? n / len : -normalised(rv);
+
+                hit.entity = e;
+                hit.triangle = tb->tris[tri];
+                hit.t = best;
+                hit.pos = r0 + rv * best;
+                hit.normal = dot(n, rv) > 0.0f ? -n : n;
+                return true;
+            }
+        }
+
+        // box face normal from the slab the ray entered through
+        vec3f pos = r0 + rv * t;
+        vec3f centre = (bv.transformed_min_extents + bv.transformed_max_extents) * 0.5f;
+        vec3f half = (bv.transformed_max_extents - bv.transformed_min_extents) * 0.5f;
+        vec3f local = pos - centre;
+
+        u32 axis = 0;
+        f32 best_d = -FLT_MAX;
+        for (u32 i = 0; i < 3; ++i)
+        {
+            f32 d = half[i] > 0.0f ? fabsf(local[i]) / half[i] : 1.0f;
+            if (d > best_d)
+            {
+                best_d = d;
+                axis = i;
+            }
+        }
+
+        hit.entity = e;
+        hit.triangle = PEN_INVALID_HANDLE;
+        hit.t = t;
+        hit.pos = pos;
+        hit.normal = vec3f::zero();
+        hit.normal[axis] = rv[axis] > 0.0f ? -1.0f : 1.0f;
+        return true;
+    }
+} // namespace
+
+namespace put
+{
+    namespace ecs
+    {
+        void update_bvh(ecs_scene* scene)
+        {
+            static pen::timer* timer = pen::timer_create();
+            pen::timer_start(timer);
+
+            if (!scene->bvh)
+                scene->bvh = new ecs_bvh();
+
+            ecs_bvh* bvh = scene->bvh;
+            bvh->stats.num_reinserted = 0;
+
+            // leaves are tracked by entity index, entries past num_entities are removed
+            u32 num_tracked = sb_count(bvh->leaves);
+            if (num_tracked < scene->num_entities)
+            {
+                u32* extra = sb_add(bvh->leaves, scene->num_entities - num_tracked);
+                memset(extra, 0xff, (scene->num_entities - num_tracked) * sizeof(u32));
+            }
+
+            num_tracked = sb_count(bvh->leaves);
+            for (u32 e = 0; e < num_tracked; ++e)
+            {
+                vec3f min, max;
+                bool  valid = get_entity_aabb(scene, e, min, max);
+                u32   leaf = bvh->leaves[e];
+
+                if (leaf != PEN_INVALID_HANDLE)
+                {
+                    if (valid && contains(bvh->nodes[leaf], min, max))
+                        continue;
+
+                    remove_leaf(bvh, leaf);
+                    bvh->stats.num_reinserted++;
+
+                    if (!valid)
+                    {
+                        free_node(bvh, leaf);
+                        bvh->leaves[e] = PEN_INVALID_HANDLE;
+                        bvh->stats.num_leaves--;
+                        continue;
+                    }
+                }
+                else
+                {
+                    if (!valid)
+                        continue;
+
+                    leaf = alloc_node(bvh);
+                    bvh->nodes[leaf].entity = e;
+                    bvh->leaves[e] = leaf;
+                    bvh->stats.num_leaves++;
+                    bvh->stats.num_reinserted++;
+                }
+
+                set_leaf_box(bvh->nodes[leaf], min, max);
+                insert_leaf(bvh, leaf);
+            }
+
+            bvh->stats.height = bvh->root != PEN_INVALID_HANDLE ? bvh->nodes[bvh->root].height : 0;
+            bvh->stats.update_ms = pen::timer_elapsed_ms(timer);
+        }
+
+        bool bvh_ray_cast(ecs_scene* scene, const vec3f& r0, const vec3f& rv, bvh_hit& hit, u32 flags)
+        {
+            hit = bvh_hit();
+
+            ecs_bvh* bvh = get_bvh(scene);
+            if (bvh->root == PEN_INVALID_HANDLE)
+                return false;
+
+            vec3f inv = ray_inv(rv);
+
+            stack_entry stack[k_stack_size];
+            u32         sp = 0;
+
+            f32 t0 = ray_vs_aabb(bvh->nodes[bvh->root].min, bvh->nodes[bvh->root].max, r0, inv, FLT_MAX);
+            if (t0 == FLT_MAX)
+                return false;
+
+            stack[sp++] = {bvh->root, t0};
+
+            while (sp > 0)
+            {
+                stack_entry se = stack[--sp];
+                if (se.t >= hit.t)
+                    continue;
+
+                const bvh_node& n = bvh->nodes[se.node];
+                if (n.height == 0)
+                {
+                    if (query_entity(scene, n.entity, flags))
+                        ray_cast_leaf(bvh, scene, n.entity, r0, rv, inv, hit, flags);
+
+                    continue;
+                }
+
+                const bvh_node& a = bvh->nodes[n.child[0]];
+                const bvh_node& b = bvh->nodes[n.child[1]];
+
+                stack_entry near_child = {n.child[0], ray_vs_aabb(a.min, a.max, r0, inv, hit.t)};
+                stack_entry far_child = {n.child[1], ray_vs_aabb(b.min, b.max, r0, inv, hit.t)};
+                if (far_child.t < near_child.t)
+                    std::swap(near_child, far_child);
+
+                if (far_child.t != FLT_MAX)
+                    stack[sp++] = far_child;
+
+                if (near_child.t != FLT_MAX)
+                    stack[sp++] = near_child;
+            }
+
+            return hit.entity != PEN_INVALID_HANDLE;
+        }
+
+        u32 bvh_query_aabb(ecs_scene* scene, const vec3f& min, const vec3f& max, u32*& results, u32 flags)
+        {
+            ecs_bvh* bvh = get_bvh(scene);
+            if (bvh->root == PEN_INVALID_HANDLE)
+                return 0;
+
+            u32 stack[k_stack_size];
+            u32 sp = 0;
+            u32 count = 0;
+
+            stack[sp++] = bvh->root;
+
+            while (sp > 0)
+            {
+                const bvh_node& n = bvh->nodes[stack[--sp]];
+                if (!aabb_overlap(n.min, n.max, min, max))
+                    continue;
+
+                if (n.height > 0)
+                {
+                    stack[sp++] = n.child[0];
+                    stack[sp++] = n.child[1];
+                    continue;
+                }
+
+                if (!query_entity(scene, n.entity, flags))
+                    continue;
+
+                const cmp_bounding_volume& bv = scene->bounding_volumes[n.entity];
+                if (!aabb_overlap(bv.transformed_min_extents, bv.transformed_max_extents, min, max))
+                    continue;
+
+                sb_push(results, n.entity);
+                count++;
+            }
+
+            return count;
+        }
+
+        u32 bvh_query_sphere(ecs_scene* scene, const vec3f& pos, f32 radius, u32*& results, u32 flags)
+        {
+            ecs_bvh* bvh = get_bvh(scene);
+            if (bvh->root == PEN_INVALID_HANDLE)
+                return 0;
+
+            u32 stack[k_stack_size];
+            u32 sp = 0;
+            u32 count = 0;
+
+            stack[sp++] = bvh->root;
+
+            while (sp > 0)
+            {
+                const bvh_node& n = bvh->nodes[stack[--sp]];
+                if (!sphere_overlap(n.min, n.max, pos, radius))
+                    continue;
+
+                if (n.height > 0)
+                {
+                    stack[sp++] = n.child[0];
+                    stack[sp++] = n.child[1];
+                    continue;
+                }
+
+                if (!query_entity(scene, n.entity, flags))
+                    continue;
+
+                const cmp_bounding_volume& bv = scene->bounding_volumes[n.entity];
+                if (!sphere_overlap(bv.transformed_min_extents, bv.transformed_max_extents, pos, radius))
+                    continue;
+
+                sb_push(results, n.entity);
+                count++;
+            }
+
+            return count;
+        }
+
+        u32 bvh_query_frustum(ecs_scene* scene, const vec3f* normals, const vec3f* points, u32 num_planes, u32*& results,
+                              u32 flags)
+        {
+            ecs_bvh* bvh = get_bvh(scene);
+            if (bvh->root == PEN_INVALID_HANDLE || num_planes > 32)
+                return 0;
+
+            // planes a node is entirely behind are dropped for its subtree
+            struct frustum_entry
+            {
+                u32 node;
+                u32 planes;
+            };
+
+            frustum_entry stack[k_stack_size];
+            u32           sp = 0;
+            u32           count = 0;
+
+            stack[sp++] = {bvh->root, num_planes == 32 ? 0xffffffff : (1u << num_planes) - 1};
+
+            while (sp > 0)
+            {
+                frustum_entry fe = stack[--sp];
+                const bvh_node& n = bvh->nodes[fe.node];
+
+                vec3f min = n.min;
+                vec3f max = n.max;
+
+                if (n.height == 0)
+                {
+                    if (!query_entity(scene, n.entity, flags))
+                        continue;
+
+                    min = scene->bounding_volumes[n.entity].transformed_min_extents;
+                    max = scene->bounding_volumes[n.entity].transformed_max_extents;
+                }
+
+                vec3f centre = (min + max) * 0.5f;
+                vec3f half = (max - min) * 0.5f;
+
+                bool outside = false;
+                for (u32 p = 0; p < num_planes; ++p)
+                {
+                    if (!(fe.planes & (1u << p)))
+                        continue;
+
+                    const vec3f& pn = normals[p];
+                    f32          d = dot(pn, centre - points[p]);
+                    f32          r = fabsf(pn.x) * half.x + fabsf(pn.y) * half.y + fabsf(pn.z) * half.z;
+
+                    if (d - r > 0.0f)
+                    {
+                        outside = true;
+                        break;
+                    }
+
+                    if (d + r <= 0.0f)
+                        fe.planes &= ~(1u << p);
+                }
+
+                if (outside)
+                    continue;
+
+                if (n.height > 0)
+                {
+                    stack[sp++] = {n.child[0], fe.planes};
+                    stack[sp++] = {n.child[1], fe.planes};
+                    continue;
+                }
+
+                sb_push(results, n.entity);
+                count++;
+            }
+
+            return count;
+        }
+
+        void release_bvh(ecs_scene* scene)
+        {
+            ecs_bvh* bvh = scene->bvh;
+            if (!bvh)
+                return;
+
+            u32 num_bvhs = sb_count(bvh->triangle_bvhs);
+            for (u32 i = 0; i < num_bvhs; ++i)
+                free_triangle_bvh(bvh->triangle_bvhs[i]);
+
+            sb_free(bvh->triangle_bvhs);
+            sb_free(bvh->nodes);
+            sb_free(bvh->leaves);
+
+            delete bvh;
+            scene->bvh = nullptr;
+        }
+    } // namespace ecs
+} // namespace put
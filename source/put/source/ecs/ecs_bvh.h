@@ -0,0 +1,87 @@
+// ecs_bvh.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "ecs/ecs_scene.h"
+
+// Dynamic bounding volume hierarchy over the world space bounding volumes of geometry entities.
+// Leaves keep the entity's box grown by a margin and update_bvh only reinserts entities whose box has left it, entities
+// which are added or deleted are inserted or removed the same way, so a frame where a few things move touches a few
+// paths through the tree. Insertion descends to the sibling with the least surface area cost and rotates nodes on the
+// way back up to keep the tree balanced.
+// Rays are walked front to back for the closest hit, boxes, spheres and frustums collect every overlapping entity.
+// Rays can be tested against triangles, a tree per geometry resource is built from its cpu buffers on first use and
+// the ray is transformed into the entity's local space to walk it. Skinned geometry is only tested against its box.
+// There are no renderer calls here, the tree is created by the first query and kept up to date by update_scene.
+
+namespace put
+{
+    namespace ecs
+    {
+        struct triangle_bvh;
+
+        enum e_bvh_query_flags
+        {
+            BVH_QUERY_TRIANGLES = 1 << 0, // rays test triangles of geometry with cpu buffers instead of boxes
+            BVH_QUERY_VISIBLE = 1 << 1    // skip hidden entities
+        };
+
+        struct bvh_hit
+        {
+            u32   entity = PEN_INVALID_HANDLE;
+            u32   triangle = PEN_INVALID_HANDLE; // index of the triangle's first index, invalid for box hits
+            f32   t = FLT_MAX;                   // distance along the ray in units of the ray vector passed in
+            vec3f pos;
+            vec3f normal; // world space, facing the ray
+        };
+
+        struct bvh_node
+        {
+            vec3f min;
+            vec3f max;
+            u32   parent;
+            u32   child[2];
+            u32   entity; // PEN_INVALID_HANDLE for internal nodes
+            s32   height; // 0 for leaves, -1 for nodes on the free list
+        };
+
+        struct bvh_stats
+        {
+            u32 num_leaves = 0;
+            u32 height = 0;
+            u32 num_reinserted = 0; // inserted, moved or removed in the last update
+            u32 num_triangle_bvhs = 0;
+            f32 update_ms = 0.0f;
+        };
+
+        struct ecs_bvh
+        {
+            bvh_node*      nodes = nullptr;
+            u32            root = PEN_INVALID_HANDLE;
+            u32            free_list = PEN_INVALID_HANDLE; // linked through parent
+            u32*           leaves = nullptr;               // per entity leaf node or PEN_INVALID_HANDLE
+            triangle_bvh** triangle_bvhs = nullptr;
+            bvh_stats      stats;
+        };
+
+        // creates the tree if it does not exist, update_scene calls this once it does
+        void update_bvh(ecs_scene* scene);
+
+        // closest hit along r0 + rv * t for t >= 0, triangle trees are built on first use so ray casts with
+        // BVH_QUERY_TRIANGLES are not safe to call from multiple threads until every geometry hit has one
+        bool bvh_ray_cast(ecs_scene* scene, const vec3f& r0, const vec3f& rv, bvh_hit& hit, u32 flags = 0);
+
+        // overlap queries append entities to results (stretchy buffer) and return the number appended
+        u32 bvh_query_aabb(ecs_scene* scene, const vec3f& min, const vec3f& max, u32*& results, u32 flags = 0);
+        u32 bvh_query_sphere(ecs_scene* scene, const vec3f& pos, f32 radius, u32*& results, u32 flags = 0);
+
+        // planes are a normal facing out of the volume and a point on the plane, entities entirely in front of any
+        // plane are outside
+        u32 bvh_query_frustum(ecs_scene* scene, const vec3f* normals, const vec3f* points, u32 num_planes, u32*& results,
+                              u32 flags = 0);
+
+        void release_bvh(ecs_scene* scene);
+    } // namespace ecs
+} // namespace put
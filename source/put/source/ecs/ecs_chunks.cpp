@@ -0,0 +1,763 @@
+// ecs_chunks.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "data_struct.h"
+#include "memory.h"
+
+#include "ecs/ecs_chunks.h"
+
+#include <algorithm>
+
+using namespace put;
+using namespace ecs;
+
+namespace
+{
+    // entities and the free list stay soa, systems test entity flags for every entity and the free list links
+    // pointers into its own array
+    const u64 k_cmp_not_stored = (u64)-1;
+
+    const u32 k_cmp_align = 16;
+
+    struct cmp_mask
+    {
+        u64 words[CHUNK_MASK_WORDS];
+    };
+
+    template <typename T>
+    void set_required_flags(ecs_scene* scene, ecs_chunk_storage* cs, const cmp_array<T>& cmp, u64 flags)
+    {
+        u32 i = get_component_index(scene, &cmp);
+        if (!is_valid(i))
+            return;
+
+        cs->component_flags[i] = flags;
+    }
+
+    void init_base_component_flags(ecs_scene* scene, ecs_chunk_storage* cs)
+    {
+        const u64 physics = CMP_PHYSICS | CMP_CONSTRAINT;
+
+        set_required_flags(scene, cs, scene->entities, k_cmp_not_stored);
+        set_required_flags(scene, cs, scene->free_list, k_cmp_not_stored);
+        set_required_flags(scene, cs, scene->state_flags, CMP_ALLOCATED);
+        set_required_flags(scene, cs, scene->id_name, CMP_ALLOCATED);
+        set_required_flags(scene, cs, scene->names, CMP_ALLOCATED);
+        set_required_flags(scene, cs, scene->parents, CMP_ALLOCATED);
+        set_required_flags(scene, cs, scene->transforms, CMP_ALLOCATED);
+        set_required_flags(scene, cs, scene->local_matrices, CMP_ALLOCATED);
+        set_required_flags(scene, cs, scene->world_matrices, CMP_ALLOCATED);
+        set_required_flags(scene, cs, scene->offset_matrices, CMP_ALLOCATED);
+        set_required_flags(scene, cs, scene->bounding_volumes, CMP_ALLOCATED);
+        set_required_flags(scene, cs, scene->id_geometry, CMP_GEOMETRY);
+        set_required_flags(scene, cs, scene->geometry_names, CMP_GEOMETRY);
+        set_required_flags(scene, cs, scene->geometries, CMP_GEOMETRY);
+        set_required_flags(scene, cs, scene->cbuffer, CMP_GEOMETRY);
+        set_required_flags(scene, cs, scene->draw_call_data, CMP_GEOMETRY);
+        set_required_flags(scene, cs, scene->id_material, CMP_MATERIAL);
+        set_required_flags(scene, cs, scene->material_names, CMP_MATERIAL);
+        set_required_flags(scene, cs, scene->materials, CMP_MATERIAL);
+        set_required_flags(scene, cs, scene->material_data, CMP_MATERIAL);
+        set_required_flags(scene, cs, scene->material_resources, CMP_MATERIAL);
+        set_required_flags(scene, cs, scene->material_permutation, CMP_MATERIAL);
+        set_required_flags(scene, cs, scene->physics_matrices, physics);
+        set_required_flags(scene, cs, scene->physics_handles, physics);
+        set_required_flags(scene, cs, scene->physics_data, physics);
+        set_required_flags(scene, cs, scene->physics_offset, physics);
+        set_required_flags(scene, cs, scene->lights, CMP_LIGHT);
+        set_required_flags(scene, cs, scene->master_instances, CMP_MASTER_INSTANCE);
+        set_required_flags(scene, cs, scene->pre_skin, CMP_PRE_SKINNED);
+        set_required_flags(scene, cs, scene->anim_controller, CMP_ANIM_CONTROLLER);
+        set_required_flags(scene, cs, scene->anim_controller_v2, CMP_ANIM_CONTROLLER);
+        set_required_flags(scene, cs, scene->shadows, CMP_SDF_SHADOW);
+        set_required_flags(scene, cs, scene->samplers, CMP_SAMPLERS);
+    }
+
+    bool is_zero(const u8* data, u32 size)
+    {
+        for (u32 i = 0; i < size; ++i)
+            if (data[i])
+                return false;
+
+        return true;
+    }
+
+    inline bool mask_test(const u64* mask, u32 c)
+    {
+        return (mask[c / 64] & (1ull << (c % 64))) != 0;
+    }
+
+    inline void mask_set(u64* mask, u32 c)
+    {
+        mask[c / 64] |= (1ull << (c % 64));
+    }
+
+    bool mask_contains(const u64* mask, const cmp_mask& query)
+    {
+        for (u32 w = 0; w < CHUNK_MASK_WORDS; ++w)
+            if ((mask[w] & query.words[w]) != query.words[w])
+                return false;
+
+        return true;
+    }
+
+    // flags are covered when every component they require is in the mask
+    u64 get_covered_flags(ecs_chunk_storage* cs, const u64* mask)
+    {
+        u64 missing = 0;
+        for (u32 c = 0; c < cs->num_components; ++c)
+        {
+            u64 req = cs->component_flags[c];
+            if (req == k_cmp_not_stored)
+                continue;
+
+            if (!mask_test(mask, c))
+                missing |= req;
+        }
+
+        return cs->flag_bits & ~missing;
+    }
+
+    u32 find_or_create_archetype(ecs_chunk_storage* cs, const cmp_mask& m)
+    {
+        u32 num_archetypes = sb_count(cs->archetypes);
+        for (u32 a = 0; a < num_archetypes; ++a)
+        {
+            bool match = true;
+            for (u32 w = 0; w < CHUNK_MASK_WORDS; ++w)
+                match &= cs->archetypes[a].mask[w] == m.words[w];
+
+            if (match)
+                return a;
+        }
+
+        ecs_archetype at;
+        memcpy(at.mask, m.words, sizeof(at.mask));
+        at.flags = get_covered_flags(cs, at.mask);
+
+        u32 stride = sizeof(u32);
+        for (u32 c = 0; c < cs->num_components; ++c)
+        {
+            sb_push(at.lookup, PEN_INVALID_HANDLE);
+
+            if (!mask_test(m.words, c))
+                continue;
+
+            sb_push(at.components, c);
+            stride += cs->component_sizes[c];
+        }
+
+        // fit as many entities as we can into a chunk, each component array is aligned
+        u32 num_cmp = sb_count(at.components);
+        u32 padding = (num_cmp + 1) * k_cmp_align;
+        at.capacity = CHUNK_SIZE > stride + padding ? (CHUNK_SIZE - padding) / stride : 1;
+
+        u32 offset = at.capacity * sizeof(u32);
+        for (u32 i = 0; i < num_cmp; ++i)
+        {
+            offset = (offset + k_cmp_align - 1) & ~(k_cmp_align - 1);
+            sb_push(at.offsets, offset);
+            at.lookup[at.components[i]] = offset;
+            offset += cs->component_sizes[at.components[i]] * at.capacity;
+        }
+        at.chunk_bytes = offset;
+
+        sb_push(cs->archetypes, at);
+        return num_archetypes;
+    }
+
+    // appends a slot for entity to the last chunk of an archetype, component data is left for the caller to write
+    void chunk_alloc(ecs_chunk_storage* cs, u32 a, u32 entity)
+    {
+        ecs_archetype& at = cs->archetypes[a];
+
+        // all chunks but the last are full
+        u32 num_chunks = sb_count(at.chunks);
+        if (num_chunks == 0 || at.chunks[num_chunks - 1].count == at.capacity)
+        {
+            ecs_chunk chunk;
+            chunk.mem = (u8*)pen::memory_alloc(at.chunk_bytes);
+            sb_push(at.chunks, chunk);
+            ++num_chunks;
+        }
+
+        u32        ci = num_chunks - 1;
+        ecs_chunk& chunk = at.chunks[ci];
+        u32        slot = chunk.count++;
+
+        ((u32*)chunk.mem)[slot] = entity;
+
+        cs->entity_archetype[entity] = a;
+        cs->entity_chunk[entity] = ci;
+        cs->entity_slot[entity] = slot;
+    }
+
+    inline u8* chunk_component(ecs_chunk_storage* cs, u32 entity, u32 offset, u32 size)
+    {
+        ecs_archetype& at = cs->archetypes[cs->entity_archetype[entity]];
+        return at.chunks[cs->entity_chunk[entity]].mem + offset + cs->entity_slot[entity] * size;
+    }
+
+    // the slot is left as a hole, its data stays valid until the archetype is compacted
+    void chunk_remove(ecs_chunk_storage* cs, u32 entity)
+    {
+        u32 a = cs->entity_archetype[entity];
+        if (!is_valid(a))
+            return;
+
+        ecs_archetype& at = cs->archetypes[a];
+        ecs_chunk&     chunk = at.chunks[cs->entity_chunk[entity]];
+
+        ((u32*)chunk.mem)[cs->entity_slot[entity]] = PEN_INVALID_HANDLE;
+        at.num_holes++;
+        cs->num_holes++;
+
+        cs->entity_archetype[entity] = PEN_INVALID_HANDLE;
+        cs->entity_chunk[entity] = PEN_INVALID_HANDLE;
+        cs->entity_slot[entity] = PEN_INVALID_HANDLE;
+    }
+
+    // moves entity to archetype a copying the components it has in both and zeroing the new ones
+    void chunk_move(ecs_chunk_storage* cs, u32 entity, u32 a)
+    {
+        u32 prev_a = cs->entity_archetype[entity];
+        u32 prev_ci = cs->entity_chunk[entity];
+        u32 prev_slot = cs->entity_slot[entity];
+
+        chunk_alloc(cs, a, entity);
+
+        ecs_archetype& at = cs->archetypes[a];
+        ecs_chunk&     chunk = at.chunks[cs->entity_chunk[entity]];
+        u32            slot = cs->entity_slot[entity];
+
+        u32 num_cmp = sb_count(at.components);
+        for (u32 i = 0; i < num_cmp; ++i)
+        {
+            u32 c = at.components[i];
+            u32 size = cs->component_sizes[c];
+            u8* dst = chunk.mem + at.offsets[i] + slot * size;
+
+            u32 prev_offset = is_valid(prev_a) ? cs->archetypes[prev_a].lookup[c] : PEN_INVALID_HANDLE;
+            if (is_valid(prev_offset))
+            {
+                u8* src = cs->archetypes[prev_a].chunks[prev_ci].mem + prev_offset + prev_slot * size;
+                memcpy(dst, src, size);
+            }
+            else
+            {
+                memset(dst, 0x0, size);
+            }
+        }
+
+        if (!is_valid(prev_a))
+            return;
+
+        ecs_archetype& prev = cs->archetypes[prev_a];
+        ((u32*)prev.chunks[prev_ci].mem)[prev_slot] = PEN_INVALID_HANDLE;
+        prev.num_holes++;
+        cs->num_holes++;
+    }
+
+    // adds component (if valid) and any components the entity flags require, returns the entities archetype
+    u32 grow_entity(ecs_chunk_storage* cs, u32 entity, u32 component)
+    {
+        cmp_mask m = {};
+
+        u32 a = cs->entity_archetype[entity];
+        if (is_valid(a))
+            memcpy(m.words, cs->archetypes[a].mask, sizeof(m.words));
+
+        u64 ef = cs->scene->entities[entity] & cs->flag_bits;
+        for (u32 c = 0; c < cs->num_components; ++c)
+        {
+            u64 req = cs->component_flags[c];
+            if (req != k_cmp_not_stored && (ef & req))
+                mask_set(m.words, c);
+        }
+
+        if (is_valid(component))
+            mask_set(m.words, component);
+
+        u32 na = find_or_create_archetype(cs, m);
+        if (na != a)
+            chunk_move(cs, entity, na);
+
+        return na;
+    }
+
+    void compact_archetype(ecs_chunk_storage* cs, ecs_archetype& at)
+    {
+        u32 num_chunks = sb_count(at.chunks);
+        if (num_chunks == 0)
+            return;
+
+        // every chunk but the last is full so slots can be addressed linearly
+        u32 total = (num_chunks - 1) * at.capacity + at.chunks[num_chunks - 1].count;
+        u32 live = total - at.num_holes;
+        u32 num_cmp = sb_count(at.components);
+
+        u32 i = 0;
+        u32 j = total;
+        for (;;)
+        {
+            while (i < j && is_valid(((u32*)at.chunks[i / at.capacity].mem)[i % at.capacity]))
+                ++i;
+
+            while (j > i && !is_valid(((u32*)at.chunks[(j - 1) / at.capacity].mem)[(j - 1) % at.capacity]))
+                --j;
+
+            if (i + 1 > j)
+                break;
+
+            // move the last live entity into the first hole
+            --j;
+            ecs_chunk& dst = at.chunks[i / at.capacity];
+            ecs_chunk& src = at.chunks[j / at.capacity];
+            u32        ds = i % at.capacity;
+            u32        ss = j % at.capacity;
+
+            u32 entity = ((u32*)src.mem)[ss];
+            ((u32*)dst.mem)[ds] = entity;
+            ((u32*)src.mem)[ss] = PEN_INVALID_HANDLE;
+
+            for (u32 c = 0; c < num_cmp; ++c)
+            {
+                u32 size = cs->component_sizes[at.components[c]];
+                memcpy(dst.mem + at.offsets[c] + ds * size, src.mem + at.offsets[c] + ss * size, size);
+            }
+
+            cs->entity_chunk[entity] = i / at.capacity;
+            cs->entity_slot[entity] = ds;
+            ++i;
+        }
+
+        // release chunks past the live entities
+        u32 keep = (live + at.capacity - 1) / at.capacity;
+        for (u32 c = keep; c < num_chunks; ++c)
+            pen::memory_free(at.chunks[c].mem);
+
+        stb__sbn(at.chunks) = keep;
+        for (u32 c = 0; c < keep; ++c)
+            at.chunks[c].count = at.capacity;
+
+        if (keep)
+            at.chunks[keep - 1].count = live - (keep - 1) * at.capacity;
+
+        cs->num_holes -= at.num_holes;
+        at.num_holes = 0;
+    }
+
+    void compact_chunks(ecs_chunk_storage* cs)
+    {
+        if (cs->num_holes == 0)
+            return;
+
+        u32 num_archetypes = sb_count(cs->archetypes);
+        for (u32 a = 0; a < num_archetypes; ++a)
+            if (cs->archetypes[a].num_holes)
+                compact_archetype(cs, cs->archetypes[a]);
+    }
+
+    void free_chunks(ecs_chunk_storage* cs)
+    {
+        u32 num_archetypes = sb_count(cs->archetypes);
+        for (u32 a = 0; a < num_archetypes; ++a)
+        {
+            ecs_archetype& at = cs->archetypes[a];
+
+            u32 num_chunks = sb_count(at.chunks);
+            for (u32 c = 0; c < num_chunks; ++c)
+                pen::memory_free(at.chunks[c].mem);
+
+            sb_free(at.chunks);
+            sb_free(at.components);
+            sb_free(at.offsets);
+            sb_free(at.lookup);
+        }
+
+        sb_free(cs->archetypes);
+        cs->archetypes = nullptr;
+        cs->num_holes = 0;
+
+        u32 num_entities = sb_count(cs->entity_archetype);
+        for (u32 i = 0; i < num_entities; ++i)
+        {
+            cs->entity_archetype[i] = PEN_INVALID_HANDLE;
+            cs->entity_chunk[i] = PEN_INVALID_HANDLE;
+            cs->entity_slot[i] = PEN_INVALID_HANDLE;
+        }
+    }
+} // namespace
+
+namespace put
+{
+    namespace ecs
+    {
+        void* get_chunk_component(ecs_chunk_storage* cs, u32 component, u32 entity)
+        {
+            u32 size = cs->component_sizes[component];
+            u32 a = cs->entity_archetype[entity];
+
+            if (is_valid(a))
+            {
+                ecs_archetype& at = cs->archetypes[a];
+                u32            offset = at.lookup[component];
+                u64            ef = cs->scene->entities[entity] & cs->flag_bits;
+
+                if (is_valid(offset) && !(ef & ~at.flags))
+                    return at.chunks[cs->entity_chunk[entity]].mem + offset + cs->entity_slot[entity] * size;
+            }
+
+            a = grow_entity(cs, entity, component);
+            return chunk_component(cs, entity, cs->archetypes[a].lookup[component], size);
+        }
+
+        const void* read_chunk_component(const ecs_chunk_storage* cs, u32 component, u32 entity)
+        {
+            u32 a = cs->entity_archetype[entity];
+            if (!is_valid(a))
+                return cs->zero;
+
+            const ecs_archetype& at = cs->archetypes[a];
+            u32                  offset = at.lookup[component];
+            if (!is_valid(offset))
+                return cs->zero;
+
+            u32 size = cs->component_sizes[component];
+            return at.chunks[cs->entity_chunk[entity]].mem + offset + cs->entity_slot[entity] * size;
+        }
+
+        u32 get_component_index(ecs_scene* scene, const void* cmp_array)
+        {
+            size_t base = (size_t)&scene->entities;
+            size_t addr = (size_t)cmp_array;
+
+            if (addr >= base)
+            {
+                size_t i = (addr - base) / sizeof(generic_cmp_array);
+                if (i < scene->num_base_components)
+                    return (u32)i;
+            }
+
+            // extension components
+            u32 num_ext = sb_count(scene->extensions);
+            for (u32 e = 0; e < num_ext; ++e)
+            {
+                ecs_extension& ext = scene->extensions[e];
+                size_t         ext_base = (size_t)ext.components;
+
+                if (addr < ext_base)
+                    continue;
+
+                size_t i = (addr - ext_base) / sizeof(generic_cmp_array);
+                if (i < ext.num_components)
+                    return get_extension_component_offset(scene, e) + (u32)i;
+            }
+
+            return PEN_INVALID_HANDLE;
+        }
+
+        void enable_chunk_storage(ecs_scene* scene, bool enable)
+        {
+            if (enable)
+            {
+                if (scene->chunk_storage)
+                    return;
+
+                scene->chunk_storage = new ecs_chunk_storage();
+                scene->chunk_storage->scene = scene;
+
+                reserve_chunk_storage(scene, scene->soa_size);
+                adopt_chunk_components(scene);
+                return;
+            }
+
+            ecs_chunk_storage* cs = scene->chunk_storage;
+            if (!cs)
+                return;
+
+            compact_chunks(cs);
+
+            // give the soa arrays back their memory and write each entity back to its index
+            for (u32 c = 0; c < cs->num_components; ++c)
+            {
+                generic_cmp_array& cmp = scene->get_component_array(c);
+                if (!cmp.chunks)
+                    continue;
+
+                if (scene->soa_size)
+                {
+                    cmp.data = pen::memory_alloc(cmp.size * scene->soa_size);
+                    pen::memory_zero(cmp.data, cmp.size * scene->soa_size);
+                }
+            }
+
+            u32 num_archetypes = sb_count(cs->archetypes);
+            for (u32 a = 0; a < num_archetypes; ++a)
+            {
+                ecs_archetype& at = cs->archetypes[a];
+
+                u32 num_cmp = sb_count(at.components);
+                u32 num_chunks = sb_count(at.chunks);
+                for (u32 ci = 0; ci < num_chunks; ++ci)
+                {
+                    ecs_chunk& chunk = at.chunks[ci];
+                    u32*       entities = (u32*)chunk.mem;
+
+                    for (u32 i = 0; i < num_cmp; ++i)
+                    {
+                        generic_cmp_array& cmp = scene->get_component_array(at.components[i]);
+                        u8*                src = chunk.mem + at.offsets[i];
+
+                        for (u32 e = 0; e < chunk.count; ++e)
+                            memcpy((u8*)cmp.data + entities[e] * cmp.size, src + e * cmp.size, cmp.size);
+                    }
+                }
+            }
+
+            for (u32 c = 0; c < cs->num_components; ++c)
+            {
+                generic_cmp_array& cmp = scene->get_component_array(c);
+                cmp.chunks = nullptr;
+                cmp.chunk_component = 0;
+            }
+
+            free_chunks(cs);
+            sb_free(cs->component_sizes);
+            sb_free(cs->component_flags);
+            sb_free(cs->entity_archetype);
+            sb_free(cs->entity_chunk);
+            sb_free(cs->entity_slot);
+            pen::memory_free(cs->zero);
+
+            delete cs;
+            scene->chunk_storage = nullptr;
+        }
+
+        void adopt_chunk_components(ecs_scene* scene)
+        {
+            ecs_chunk_storage* cs = scene->chunk_storage;
+            if (!cs || cs->num_components == scene->num_components)
+                return;
+
+            PEN_ASSERT(scene->num_components <= CHUNK_MASK_WORDS * 64);
+
+            // component info, components without flags are owned once they are non zero or accessed
+            u32 first = cs->num_components;
+            for (u32 c = first; c < scene->num_components; ++c)
+            {
+                sb_push(cs->component_sizes, scene->get_component_array(c).size);
+                sb_push(cs->component_flags, 0);
+            }
+            cs->num_components = scene->num_components;
+
+            if (first == 0)
+                init_base_component_flags(scene, cs);
+
+            u32 max_size = 0;
+            cs->flag_bits = 0;
+            for (u32 c = 0; c < cs->num_components; ++c)
+            {
+                max_size = std::max<u32>(max_size, cs->component_sizes[c]);
+                if (cs->component_flags[c] != k_cmp_not_stored)
+                    cs->flag_bits |= cs->component_flags[c];
+            }
+
+            pen::memory_free(cs->zero);
+            cs->zero = (u8*)pen::memory_alloc(max_size);
+            pen::memory_zero(cs->zero, max_size);
+
+            // existing archetypes do not contain the new components
+            u32 num_archetypes = sb_count(cs->archetypes);
+            for (u32 a = 0; a < num_archetypes; ++a)
+                for (u32 c = first; c < cs->num_components; ++c)
+                    sb_push(cs->archetypes[a].lookup, PEN_INVALID_HANDLE);
+
+            // move owned soa data into chunks
+            for (u32 n = 0; n < scene->soa_size; ++n)
+            {
+                u64 ef = scene->entities[n] & cs->flag_bits;
+
+                for (u32 c = first; c < cs->num_components; ++c)
+                {
+                    u64 req = cs->component_flags[c];
+                    if (req == k_cmp_not_stored)
+                        continue;
+
+                    generic_cmp_array& cmp = scene->get_component_array(c);
+                    const u8*          src = (const u8*)cmp.data + n * cmp.size;
+
+                    if (!(ef & req) && is_zero(src, cmp.size))
+                        continue;
+
+                    memcpy(get_chunk_component(cs, c, n), src, cmp.size);
+                }
+            }
+
+            for (u32 c = first; c < cs->num_components; ++c)
+            {
+                if (cs->component_flags[c] == k_cmp_not_stored)
+                    continue;
+
+                generic_cmp_array& cmp = scene->get_component_array(c);
+                pen::memory_free(cmp.data);
+                cmp.data = nullptr;
+                cmp.chunks = cs;
+                cmp.chunk_component = c;
+            }
+        }
+
+        void reserve_chunk_storage(ecs_scene* scene, u32 num_entities)
+        {
+            ecs_chunk_storage* cs = scene->chunk_storage;
+            if (!cs)
+                return;
+
+            u32 count = sb_count(cs->entity_archetype);
+            for (u32 i = count; i < num_entities; ++i)
+            {
+                sb_push(cs->entity_archetype, PEN_INVALID_HANDLE);
+                sb_push(cs->entity_chunk, PEN_INVALID_HANDLE);
+                sb_push(cs->entity_slot, PEN_INVALID_HANDLE);
+            }
+        }
+
+        void clear_chunk_storage(ecs_scene* scene)
+        {
+            if (scene->chunk_storage)
+                free_chunks(scene->chunk_storage);
+        }
+
+        void remove_chunk_entity(ecs_scene* scene, u32 entity)
+        {
+            if (scene->chunk_storage)
+                chunk_remove(scene->chunk_storage, entity);
+        }
+
+        void copy_chunk_entity(ecs_scene* scene, u32 dst, u32 src)
+        {
+            ecs_chunk_storage* cs = scene->chunk_storage;
+            if (!cs || dst == src)
+                return;
+
+            // dst ends up with exactly the components of src, like a memcpy of every soa array
+            chunk_remove(cs, dst);
+
+            u32 a = cs->entity_archetype[src];
+            if (!is_valid(a))
+                return;
+
+            chunk_alloc(cs, a, dst);
+
+            ecs_archetype& at = cs->archetypes[a];
+            u8*            dst_mem = at.chunks[cs->entity_chunk[dst]].mem;
+            u8*            src_mem = at.chunks[cs->entity_chunk[src]].mem;
+
+            u32 num_cmp = sb_count(at.components);
+            for (u32 i = 0; i < num_cmp; ++i)
+            {
+                u32 size = cs->component_sizes[at.components[i]];
+                memcpy(dst_mem + at.offsets[i] + cs->entity_slot[dst] * size,
+                       src_mem + at.offsets[i] + cs->entity_slot[src] * size, size);
+            }
+        }
+
+        void sync_chunk_storage(ecs_scene* scene)
+        {
+            ecs_chunk_storage* cs = scene->chunk_storage;
+            if (!cs)
+                return;
+
+            for (u32 n = 0; n < scene->num_entities; ++n)
+            {
+                u64 ef = scene->entities[n] & cs->flag_bits;
+                if (!ef)
+                    continue;
+
+                u32 a = cs->entity_archetype[n];
+                if (!is_valid(a) || (ef & ~cs->archetypes[a].flags))
+                    grow_entity(cs, n, PEN_INVALID_HANDLE);
+            }
+
+            compact_chunks(cs);
+        }
+
+        u32 for_each_chunk(ecs_scene* scene, const u32* components, u32 num_components, ecs_chunk_func func,
+                           void* user_data)
+        {
+            ecs_chunk_storage* cs = scene->chunk_storage;
+            if (!cs)
+                return 0;
+
+            PEN_ASSERT(num_components <= CHUNK_MAX_QUERY);
+
+            // views are dense, components must not be added to entities from func
+            compact_chunks(cs);
+
+            cmp_mask query = {};
+            for (u32 i = 0; i < num_components; ++i)
+                mask_set(query.words, components[i]);
+
+            u32 visited = 0;
+
+            u32 num_archetypes = sb_count(cs->archetypes);
+            for (u32 a = 0; a < num_archetypes; ++a)
+            {
+                ecs_archetype& at = cs->archetypes[a];
+                if (!mask_contains(at.mask, query))
+                    continue;
+
+                u32 num_chunks = sb_count(at.chunks);
+                for (u32 c = 0; c < num_chunks; ++c)
+                {
+                    ecs_chunk& chunk = at.chunks[c];
+
+                    ecs_chunk_view view;
+                    view.count = chunk.count;
+                    view.entities = (u32*)chunk.mem;
+                    for (u32 q = 0; q < num_components; ++q)
+                        view.components[q] = chunk.mem + at.lookup[components[q]];
+
+                    func(view, user_data);
+                    visited += chunk.count;
+                }
+            }
+
+            return visited;
+        }
+
+        ecs_chunk_memory_stats get_chunk_memory_stats(ecs_scene* scene)
+        {
+            ecs_chunk_memory_stats stats;
+
+            // every array which still has soa memory, all of them for scenes without chunk storage
+            for (u32 c = 0; c < scene->num_components; ++c)
+            {
+                generic_cmp_array& cmp = scene->get_component_array(c);
+                if (cmp.data)
+                    stats.soa_bytes += (size_t)cmp.size * scene->soa_size;
+            }
+
+            ecs_chunk_storage* cs = scene->chunk_storage;
+            if (!cs)
+                return stats;
+
+            stats.chunk_bytes += sb_count(cs->entity_archetype) * sizeof(u32) * 3;
+
+            stats.num_archetypes = sb_count(cs->archetypes);
+            for (u32 a = 0; a < stats.num_archetypes; ++a)
+            {
+                ecs_archetype& at = cs->archetypes[a];
+
+                u32 num_chunks = sb_count(at.chunks);
+                stats.num_chunks += num_chunks;
+                stats.chunk_bytes += (size_t)num_chunks * at.chunk_bytes;
+                stats.chunk_bytes += sizeof(ecs_archetype) + sb_count(at.lookup) * sizeof(u32);
+                stats.chunk_bytes += sb_count(at.components) * sizeof(u32) * 2;
+            }
+
+            return stats;
+        }
+    } // namespace ecs
+} // namespace put
@@ -0,0 +1,108 @@
+// ecs_chunks.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "ecs/ecs_scene.h"
+
+// Archetype / chunked component storage.
+// Entities are grouped by the set of components they own (an archetype) and packed into fixed size chunks, within a
+// chunk each component is stored contiguously so systems can iterate only the chunks which contain the components
+// they need and pay memory only for the components an entity actually has.
+// When enabled the chunks are the backing store, every component except entities and the free list has its soa array
+// freed and cmp_array::operator[] looks the entity up in its chunk instead. Extension components are stored the same
+// way, components are moved with byte copies just as resize_scene_buffers reallocs the soa.
+// An entity owns a component if it has the entity flags which require it (ie. CMP_LIGHT -> lights), if the component
+// was not zero when storage was enabled or once it is accessed through a non const cmp_array. Reading a component
+// through a const cmp_array does not add it and returns zero for components the entity does not own.
+// Adding a component moves the entity to another archetype, references to its other components taken before are
+// invalidated. Deleted and moved entities leave holes which are compacted by sync_chunk_storage (called by
+// update_scene) and for_each_chunk, entities whose flags have changed but have not been accessed since are also
+// moved into their new archetype by sync_chunk_storage.
+
+namespace put
+{
+    namespace ecs
+    {
+        enum e_chunk_constants
+        {
+            CHUNK_SIZE = 64 * 1024,
+            CHUNK_MASK_WORDS = 2, // max 128 components including extensions, asserted when enabling
+            CHUNK_MAX_QUERY = 8
+        };
+
+        struct ecs_chunk
+        {
+            u8* mem = nullptr;
+            u32 count = 0; // including holes
+        };
+
+        struct ecs_archetype
+        {
+            u64        mask[CHUNK_MASK_WORDS];
+            u64        flags = 0;            // entity flags whose required components are all in the archetype
+            u32*       components = nullptr; // component indices
+            u32*       offsets = nullptr;    // byte offset of each components array within a chunk
+            u32*       lookup = nullptr;     // offset by component index, PEN_INVALID_HANDLE if not in the archetype
+            u32        capacity = 0;         // entities per chunk
+            u32        chunk_bytes = 0;
+            u32        num_holes = 0;
+            ecs_chunk* chunks = nullptr;
+        };
+
+        struct ecs_chunk_storage
+        {
+            ecs_scene*     scene = nullptr;
+            u32            num_components = 0;
+            u32*           component_sizes = nullptr;
+            u64*           component_flags = nullptr; // entity flags which imply ownership of a component
+            u64            flag_bits = 0;             // all flags which imply ownership
+            u8*            zero = nullptr;            // returned for const reads of components an entity does not own
+            ecs_archetype* archetypes = nullptr;
+            u32            num_holes = 0;
+
+            // per entity location, PEN_INVALID_HANDLE archetype for entities which own no components
+            u32* entity_archetype = nullptr;
+            u32* entity_chunk = nullptr;
+            u32* entity_slot = nullptr;
+        };
+
+        struct ecs_chunk_view
+        {
+            u32   count;
+            u32*  entities;
+            void* components[CHUNK_MAX_QUERY];
+        };
+
+        struct ecs_chunk_memory_stats
+        {
+            size_t soa_bytes = 0;   // component arrays still allocated as soa
+            size_t chunk_bytes = 0; // chunks, entity locations and archetypes
+            u32    num_archetypes = 0;
+            u32    num_chunks = 0;
+        };
+
+        typedef void (*ecs_chunk_func)(ecs_chunk_view& view, void* user_data);
+
+        // moves components between the soa and chunks
+        void enable_chunk_storage(ecs_scene* scene, bool enable);
+
+        // compact holes and move entities whose flags have changed to their archetype
+        void sync_chunk_storage(ecs_scene* scene);
+
+        // scene buffer management, all do nothing for scenes without chunk storage
+        void reserve_chunk_storage(ecs_scene* scene, u32 num_entities);
+        void adopt_chunk_components(ecs_scene* scene); // store components registered after enabling (extensions)
+        void clear_chunk_storage(ecs_scene* scene);
+        void remove_chunk_entity(ecs_scene* scene, u32 entity);
+        void copy_chunk_entity(ecs_scene* scene, u32 dst, u32 src);
+
+        // calls func for each chunk containing all of the components, returns the number of entities visited
+        u32 for_each_chunk(ecs_scene* scene, const u32* components, u32 num_components, ecs_chunk_func func,
+                           void* user_data);
+
+        u32                    get_component_index(ecs_scene* scene, const void* cmp_array);
+        ecs_chunk_memory_stats get_chunk_memory_stats(ecs_scene* scene);
+    } // namespace ecs
+} // namespace put
@@ -2,7 +2,9 @@
 // Copyright 2014 - 2019 Alex Dixon.
 // License: https://github.com/polymonster/pmtech/blob/master/license.md
 
+#include "ecs/ecs_bvh.h"
 #include "ecs/ecs_editor.h"
+#include "ecs/ecs_journal.h"
 #include "ecs/ecs_resources.h"
 #include "ecs/ecs_utilities.h"
 
@@ -40,15 +42,7 @@ namespace put
             u32           node_index;
         };
 
-        static const hash_id ID_PICKING_BUFFER = PEN_HASH("picking");
-
-        struct picking_info
-        {
-            u32  result;
-            a_u8 ready;
-            u32  x, y;
-        };
-        static picking_info s_picking_info;
+        static bvh_hit s_picking_hit;
 
         enum e_picking_state : u32
         {
@@ -307,6 +301,10 @@ namespace put
             s_model_view_controller.settings.zoom_speed = dev_ui::get_program_preference("camera_zoom_speed").as_f32(1.0f);
             s_model_view_controller.invalidated = true;
 
+            // undo
+            s32 undo_budget_mb = std::max(dev_ui::get_program_preference("undo_budget_mb").as_s32(32), 1);
+            journal_set_budget((size_t)undo_budget_mb * 1024 * 1024);
+
             ecs_controller controller;
             controller.name = "editor_controller";
             controller.id_name = PEN_HASH(controller.name);
@@ -316,6 +314,9 @@ namespace put
 
             ecs::register_ecs_controller(scene, controller);
 
+            // shadow cascades are split along the camera the editor controls rather than one named in the config
+            scene->shadow_settings.camera = cam;
+
             // volume generator
             put::vgt::init(scene);
         }
@@ -495,7 +496,7 @@ namespace put
         {
             if (ImGui::Begin("Selection List", opened))
             {
-                ImGui::Text("Picking Result: %u", s_picking_info.result);
+                ImGui::Text("Picking Result: %u", s_picking_hit.entity);
 
                 u32 sel_count = sb_count(scene->selection_list);
                 for (s32 i = 0; i < sel_count; ++i)
@@ -509,36 +510,13 @@ namespace put
             }
         }
 
-        void picking_read_back(void* p_data, u32 row_pitch, u32 depth_pitch, u32 block_size)
-        {
-            s_picking_info.result = *((u32*)(((u8*)p_data) + s_picking_info.y * row_pitch + s_picking_info.x * block_size));
-
-            s_picking_info.ready = 1;
-        }
-
         void picking_update(ecs_scene* scene, const camera* cam)
         {
             static u32 picking_state = PICKING_READY;
-            static u32 picking_result = (-1);
 
             if (dev_ui::want_capture() & dev_ui::MOUSE)
                 return;
 
-            if (picking_state == PICKING_SINGLE)
-            {
-                if (s_picking_info.ready)
-                {
-                    picking_state = PICKING_READY;
-                    picking_result = s_picking_info.result;
-
-                    add_selection(scene, picking_result);
-
-                    s_picking_info.ready = false;
-                }
-
-                return;
-            }
-
             pen::mouse_state ms = pen::input_get_mouse_state();
             f32              corrected_y = pen_window.height - ms.y;
 
@@ -588,34 +566,16 @@ namespace put
                         pm = SELECT_ADD;
                     }
 
-                    for (s32 node = 0; node < scene->num_entities; ++node)
+                    static u32* frustum_result = nullptr;
+                    if (frustum_result)
                     {
-                        if (!(scene->entities[node] & CMP_ALLOCATED))
-                            continue;
-
-                        if (!(scene->entities[node] & CMP_GEOMETRY))
-                            continue;
-
-                        bool selected = true;
-                        for (s32 i = 0; i < 6; ++i)
-                        {
-                            vec3f& min = scene->bounding_volumes[node].transformed_min_extents;
-                            vec3f& max = scene->bounding_volumes[node].transformed_max_extents;
-
-                            u32 c = maths::aabb_vs_plane(min, max, p[i], n[i]);
-                            if (c == maths::INFRONT)
-                            {
-                                selected = false;
-                                break;
-                            }
-                        }
-
-                        if (selected)
-                        {
-                            add_selection(scene, node, SELECT_ADD_MULTI);
-                        }
+                        sb_clear(frustum_result);
                     }
 
+                    u32 num_result = bvh_query_frustum(scene, n, p, 6, frustum_result);
+                    for (u32 i = 0; i < num_result; ++i)
+                        add_selection(scene, frustum_result[i], SELECT_ADD_MULTI);
+
                     sb_clear(scene->selection_list);
                     stb__sbgrow(scene->selection_list, scene->num_entities);
 
@@ -673,30 +633,15 @@ namespace put
 
                 if (mag(max - min) < 6.0)
                 {
-                    picking_state = PICKING_SINGLE;
-
-                    const pmfx::render_target* rt = pmfx::get_render_target(ID_PICKING_BUFFER);
-
-                    if (!rt)
-                    {
-                        picking_state = PICKING_READY;
-                        return;
-                    }
+                    // ray through the cursor against the triangles of visible geometry
+                    vec2i vpi = vec2i(pen_window.width, pen_window.height);
+                    mat4  view_proj = cam->proj * cam->view;
 
-                    f32 w, h;
-                    pmfx::get_render_target_dimensions(rt, w, h);
+                    vec3f r0 = maths::unproject_sc(vec3f(cur_mouse, 0.0f), view_proj, vpi);
+                    vec3f r1 = maths::unproject_sc(vec3f(cur_mouse, 1.0f), view_proj, vpi);
 
-                    u32 pitch = (u32)w * 4;
-                    u32 data_size = (u32)h * pitch;
-
-                    pen::resource_read_back_params rrbp = {rt->handle, rt->format,        pitch, data_size, 4,
-                                                           data_size,  &picking_read_back};
-
-                    pen::renderer_read_back_resource(rrbp);
-
-                    s_picking_info.ready = 0;
-                    s_picking_info.x = ms.x;
-                    s_picking_info.y = ms.y;
+                    bvh_ray_cast(scene, r0, r1 - r0, s_picking_hit, BVH_QUERY_TRIANGLES | BVH_QUERY_VISIBLE);
+                    add_selection(scene, s_picking_hit.entity);
                 }
                 else
                 {
@@ -733,232 +678,19 @@ namespace put
             }
         }
 
-        // undoable / redoable actions
-        enum e_editor_actions
-        {
-            MACRO_BEGIN = -1,
-            MACRO_END = -2,
-            UNDO = 0,
-            REDO,
-            NUM_ACTIONS
-        };
-
-        struct node_state
-        {
-            void** components = nullptr;
-        };
-
-        struct editor_action
-        {
-            s32        node_index;
-            node_state action_state[NUM_ACTIONS];
-            f32        timer = 0.0f;
-        };
-
-        typedef pen::stack<editor_action> action_stack;
-
-        static action_stack   k_undo_stack;
-        static action_stack   k_redo_stack;
-        static editor_action* k_editor_nodes = nullptr;
-
-        void free_node_state_mem(ecs_scene* scene, node_state& ns)
-        {
-            if (!ns.components)
-                return;
-
-            u32 num = scene->num_components;
-            for (u32 i = 0; i < num; ++i)
-                pen::memory_free(ns.components[i]);
-
-            pen::memory_free(ns.components);
-            ns.components = nullptr;
-        }
-
-        void store_node_state(ecs_scene* scene, u32 node_index, e_editor_actions action)
-        {
-            static const f32 undo_push_timer = 33.0f;
-            node_state&      ns = k_editor_nodes[node_index].action_state[action];
-            u32              num = scene->num_components;
-
-            if (action == UNDO)
-                if (ns.components)
-                    return;
-
-            if (action == REDO)
-            {
-                node_state& us = k_editor_nodes[node_index].action_state[UNDO];
-
-                u32 diff = 0;
-                for (u32 i = 0; i < num; ++i)
-                {
-                    generic_cmp_array& cmp = scene->get_component_array(i);
-                    diff += memcmp(cmp[node_index], us.components[i], cmp.size);
-                }
-
-                // no change bail out
-                if (diff == 0)
-                    return;
-
-                // check if we are actively editing
-                if (ns.components)
-                {
-                    u32 edit_diff = 0;
-                    for (u32 i = 0; i < num; ++i)
-                    {
-                        generic_cmp_array& cmp = scene->get_component_array(i);
-                        edit_diff += memcmp(cmp[node_index], ns.components[i], cmp.size);
-                    }
-
-                    // no change since last frame
-                    if (edit_diff == 0)
-                        return;
-                }
-            }
-
-            k_editor_nodes[node_index].timer = undo_push_timer;
-
-            if (!ns.components)
-            {
-                ns.components = (void**)pen::memory_alloc(num * sizeof(generic_cmp_array));
-                pen::memory_zero(ns.components, num * sizeof(generic_cmp_array));
-            }
-
-            for (u32 i = 0; i < num; ++i)
-            {
-                generic_cmp_array& cmp = scene->get_component_array(i);
-
-                if (!ns.components[i])
-                    ns.components[i] = pen::memory_alloc(cmp.size);
-
-                void* data = cmp[node_index];
-
-                memcpy(ns.components[i], data, cmp.size);
-            }
-        }
-
-        void restore_node_state(ecs_scene* scene, node_state& ns, u32 node_index)
-        {
-            u32 num = scene->num_components;
-            for (u32 i = 0; i < num; ++i)
-            {
-                generic_cmp_array& cmp = scene->get_component_array(i);
-
-                // specialisations
-                // remove physics
-                if (cmp[node_index] == &scene->physics_handles[node_index])
-                {
-                    u32 h_cur = scene->physics_handles[node_index];
-                    u32 h_prev = *(u32*)ns.components[i];
-
-                    if (h_prev == 0 && h_cur)
-                    {
-                        // release previous physics handle
-                        physics::release_entity(h_cur);
-                    }
-                }
-
-                if (cmp[node_index] == &scene->physics_handles[node_index])
-                {
-                    u32 h_cur = scene->physics_handles[node_index];
-                    u32 h_prev = *(u32*)ns.components[i];
-
-                    if (h_prev == 0 && h_cur)
-                    {
-                        // release previous physics handle
-                        physics::release_entity(h_cur);
-                    }
-                }
-
-                memcpy(cmp[node_index], ns.components[i], cmp.size);
-            }
-
-            node_state& us = k_editor_nodes[node_index].action_state[UNDO];
-            node_state& rs = k_editor_nodes[node_index].action_state[REDO];
-
-            free_node_state_mem(scene, us);
-            free_node_state_mem(scene, rs);
-        }
-
-        void restore_from_stack(ecs_scene* scene, action_stack& stack, action_stack& reverse, e_editor_actions action)
-        {
-            if (stack.size() <= 0)
-                return;
-
-            int macro_count = 0;
-            for (;;)
-            {
-                editor_action ua = stack.pop();
-                reverse.push(ua);
-
-                if (ua.node_index < 0)
-                {
-                    macro_count++;
-                    if (macro_count == 2)
-                        break;
-
-                    continue;
-                }
-
-                if (scene->state_flags[ua.node_index] & SF_SELECTED)
-                    sb_clear(scene->selection_list);
-
-                restore_node_state(scene, ua.action_state[action], ua.node_index);
-            }
-        }
-
         void undo(ecs_scene* scene)
         {
-            restore_from_stack(scene, k_undo_stack, k_redo_stack, UNDO);
+            journal_undo(scene);
         }
 
         void redo(ecs_scene* scene)
         {
-            restore_from_stack(scene, k_redo_stack, k_undo_stack, REDO);
+            journal_redo(scene);
         }
 
         void update_undo_stack(ecs_scene* scene, f32 dt)
         {
-            // resize buffers
-            if (!k_editor_nodes || sb_count(k_editor_nodes) < scene->soa_size)
-            {
-                stb__sbgrow(k_editor_nodes, scene->soa_size);
-                stb__sbm(k_editor_nodes) = scene->num_entities;
-                stb__sbn(k_editor_nodes) = scene->soa_size;
-            }
-
-            static editor_action macro_begin;
-            static editor_action macro_end;
-
-            macro_begin.node_index = MACRO_BEGIN;
-            macro_end.node_index = MACRO_END;
-
-            bool first_item = true;
-
-            for (u32 i = 0; i < scene->soa_size; ++i)
-            {
-                if (k_editor_nodes[i].action_state[REDO].components)
-                {
-                    if (k_editor_nodes[i].timer <= 0.0f)
-                    {
-                        if (first_item)
-                        {
-                            k_redo_stack.clear();
-                            k_undo_stack.push(macro_end);
-                            first_item = false;
-                        }
-
-                        k_editor_nodes[i].node_index = i;
-                        k_undo_stack.push(k_editor_nodes[i]);
-                        k_editor_nodes[i].action_state[UNDO].components = nullptr;
-                        k_editor_nodes[i].action_state[REDO].components = nullptr;
-                    }
-
-                    k_editor_nodes[i].timer -= dt * 0.1f;
-                }
-            }
-
-            if (!first_item)
-                k_undo_stack.push(macro_begin);
+            journal_update(scene, dt);
 
             // undo / redo
             static bool debounce_undo = false;
@@ -999,6 +731,7 @@ namespace put
 
             static bool dynamic_timestep = dev_ui::get_program_preference("dynamic_timestep").as_bool(true);
             static f32  fixed_timestep = dev_ui::get_program_preference("fixed_timestep").as_f32(1.0f / 60.0f);
+            static s32  undo_budget_mb = dev_ui::get_program_preference("undo_budget_mb").as_s32(32);
 
             if (ImGui::Begin("Settings", opened))
             {
@@ -1036,6 +769,17 @@ namespace put
                     }
                 }
 
+                if (ImGui::InputInt("Undo Budget (mb)", &undo_budget_mb))
+                {
+                    undo_budget_mb = std::max(undo_budget_mb, 1);
+                    journal_set_budget((size_t)undo_budget_mb * 1024 * 1024);
+                    dev_ui::set_program_preference("undo_budget_mb", undo_budget_mb);
+                }
+
+                journal_stats js = journal_get_stats();
+                f32 mb = (f32)js.journal_bytes / 1024.0f / 1024.0f;
+                ImGui::Text("Undo: %i, Redo: %i, %.2f mb", js.num_undo, js.num_redo, mb);
+
                 if (ImGui::Button("Set Project Dir"))
                 {
                     set_project_dir = true;
@@ -2414,7 +2158,7 @@ namespace put
                 if (ImGui::Button(ICON_FA_PLUS))
                 {
                     u32 ni = ecs::get_next_entity(scene);
-                    store_node_state(scene, ni, UNDO);
+                    journal_begin(scene, ni);
 
                     u32 nn = ecs::get_new_entity(scene);
 
@@ -2433,7 +2177,7 @@ namespace put
 
                     add_selection(scene, nn);
 
-                    store_node_state(scene, ni, REDO);
+                    journal_touch(scene, ni);
                 }
                 put::dev_ui::set_tooltip("Add New Node");
 
@@ -2582,9 +2326,9 @@ namespace put
                     ImGui::Text("%i Selected Items", num_selected);
                 }
 
-                // Undoable actions
+                // Undoable actions, the ui can edit any component so changes are detected by hashing the node
                 if (sb_count(scene->selection_list) == 1)
-                    store_node_state(scene, scene->selection_list[0], UNDO);
+                    journal_begin(scene, scene->selection_list[0]);
 
                 scene_options_ui(scene);
 
@@ -2614,7 +2358,7 @@ namespace put
                     scene->extensions[e].browser_func(scene->extensions[e], scene);
 
                 if (sb_count(scene->selection_list) == 1)
-                    store_node_state(scene, scene->selection_list[0], REDO);
+                    journal_detect(scene, scene->selection_list[0]);
 
                 ImGui::End();
             }
@@ -2625,28 +2369,21 @@ namespace put
             if (move_axis == vec3f::zero())
                 return;
 
+            // only transforms and the flags are snapshot for undo, large selections stay cheap to edit
+            u64 undo_mask = journal_component_bit(scene, &scene->entities);
+            undo_mask |= journal_component_bit(scene, &scene->transforms);
+
             u32 sel_num = sb_count(scene->selection_list);
             for (u32 s = 0; s < sel_num; ++s)
             {
                 u32 i = scene->selection_list[s];
 
                 // only move if parent isnt selected
-                s32 parent = scene->parents[i];
-                if (parent != i)
-                {
-                    bool found = false;
-                    for (u32 t = 0; t < sel_num; ++t)
-                        if (scene->selection_list[t] == parent)
-                        {
-                            found = true;
-                            break;
-                        }
-
-                    if (found)
-                        continue;
-                }
+                u32 parent = scene->parents[i];
+                if (parent != i && (scene->state_flags[parent] & SF_SELECTED))
+                    continue;
 
-                store_node_state(scene, i, UNDO);
+                journal_begin(scene, i, undo_mask);
 
                 cmp_transform& t = scene->transforms[i];
 
@@ -2667,7 +2404,7 @@ namespace put
 
                 scene->entities[i] |= CMP_TRANSFORM;
 
-                store_node_state(scene, i, REDO);
+                journal_touch(scene, i);
             }
         }
 
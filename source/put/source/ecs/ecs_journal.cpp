@@ -0,0 +1,580 @@
+// ecs_journal.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "ecs/ecs_journal.h"
+#include "ecs/ecs_chunks.h"
+
+#include "data_struct.h"
+#include "memory.h"
+#include "physics/physics.h"
+
+#include <algorithm>
+
+namespace put
+{
+    namespace ecs
+    {
+        namespace
+        {
+            static const size_t k_default_budget = 32 * 1024 * 1024;
+
+            struct pending_edit
+            {
+                u32  node;
+                u64  mask;
+                u32  snapshot; // offset into the snapshot arena
+                u32  snapshot_size;
+                u64  hash;
+                f32  timer;
+                bool dirty;
+                bool seen; // begun since the last update, clean edits which are not get dropped
+            };
+
+            // followed by before_size bytes of encoded before and xor_size bytes of encoded before ^ after
+            struct journal_record
+            {
+                u32 node;
+                u32 component;
+                u32 offset; // byte range of the component which changed
+                u32 size;
+                u32 before_size;
+                u32 xor_size;
+            };
+
+            struct journal_action
+            {
+                u8* data = nullptr; // stretchy buffer of records
+                u32 num_records = 0;
+            };
+
+            struct journal
+            {
+                pending_edit*   pending = nullptr;
+                u32*            lookup = nullptr; // per entity index into pending, PEN_INVALID_HANDLE for none
+                u32             lookup_size = 0;
+                u8*             snapshots = nullptr;
+                u32             snapshot_garbage = 0;
+                journal_action* actions = nullptr; // [0, cursor) can be undone, [cursor, count) redone
+                u32             cursor = 0;
+                size_t          bytes = 0;
+                size_t          budget = k_default_budget;
+            };
+            journal s_journal;
+
+            inline bool in_mask(u64 mask, u32 component)
+            {
+                return mask & (1ull << (component < 63 ? component : 63));
+            }
+
+            u64 hash_node(ecs_scene* scene, u32 node, u64 mask)
+            {
+                // fnv1a
+                u64 h = 14695981039346656037ull;
+
+                for (u32 i = 0; i < scene->num_components; ++i)
+                {
+                    if (!in_mask(mask, i))
+                        continue;
+
+                    const generic_cmp_array& cmp = scene->get_component_array(i);
+                    const u8*                p = (const u8*)cmp[node];
+
+                    for (u32 b = 0; b < cmp.size; ++b)
+                    {
+                        h ^= p[b];
+                        h *= 1099511628211ull;
+                    }
+                }
+
+                return h;
+            }
+
+            u32 snapshot_size(ecs_scene* scene, u64 mask)
+            {
+                u32 size = 0;
+                for (u32 i = 0; i < scene->num_components; ++i)
+                    if (in_mask(mask, i))
+                        size += scene->get_component_array(i).size;
+
+                return size;
+            }
+
+            // components in prev_mask come from the previous snapshot, the rest from the node
+            void write_snapshot(ecs_scene* scene, u32 node, u64 mask, u64 prev_mask, const u8* prev, u8* dst)
+            {
+                for (u32 i = 0; i < scene->num_components; ++i)
+                {
+                    if (!in_mask(mask, i))
+                        continue;
+
+                    const generic_cmp_array& cmp = scene->get_component_array(i);
+
+                    if (prev && in_mask(prev_mask, i))
+                    {
+                        memcpy(dst, prev, cmp.size);
+                        prev += cmp.size;
+                    }
+                    else
+                    {
+                        memcpy(dst, cmp[node], cmp.size);
+                    }
+
+                    dst += cmp.size;
+                }
+            }
+
+            void reserve_lookup(u32 count)
+            {
+                if (count <= s_journal.lookup_size)
+                    return;
+
+                u32  size = std::max(count, s_journal.lookup_size * 2);
+                u32* lookup = (u32*)pen::memory_alloc(size * sizeof(u32));
+
+                memset(lookup, 0xff, size * sizeof(u32));
+                if (s_journal.lookup)
+                    memcpy(lookup, s_journal.lookup, s_journal.lookup_size * sizeof(u32));
+
+                pen::memory_free(s_journal.lookup);
+                s_journal.lookup = lookup;
+                s_journal.lookup_size = size;
+            }
+
+            pending_edit* find_pending(u32 node)
+            {
+                if (node >= s_journal.lookup_size || s_journal.lookup[node] == PEN_INVALID_HANDLE)
+                    return nullptr;
+
+                return &s_journal.pending[s_journal.lookup[node]];
+            }
+
+            void remove_pending(pending_edit& pe)
+            {
+                s_journal.lookup[pe.node] = PEN_INVALID_HANDLE;
+                s_journal.snapshot_garbage += pe.snapshot_size;
+                pe.node = PEN_INVALID_HANDLE;
+            }
+
+            void compact_pending()
+            {
+                pending_edit* pending = nullptr;
+                u8*           snapshots = nullptr;
+
+                u32 num_pending = sb_count(s_journal.pending);
+                for (u32 i = 0; i < num_pending; ++i)
+                {
+                    pending_edit pe = s_journal.pending[i];
+                    if (pe.node == PEN_INVALID_HANDLE)
+                        continue;
+
+                    u32 offset = sb_count(snapshots);
+                    u8* dst = sb_add(snapshots, pe.snapshot_size);
+                    memcpy(dst, s_journal.snapshots + pe.snapshot, pe.snapshot_size);
+
+                    pe.snapshot = offset;
+                    s_journal.lookup[pe.node] = sb_count(pending);
+                    sb_push(pending, pe);
+                }
+
+                sb_free(s_journal.pending);
+                sb_free(s_journal.snapshots);
+
+                s_journal.pending = pending;
+                s_journal.snapshots = snapshots;
+                s_journal.snapshot_garbage = 0;
+            }
+
+            // zero runs of 2 - 128 bytes are a control byte with the top bit set, anything else is a control byte
+            // with the count - 1 of up to 128 literal bytes which follow. encodes a ^ b, or a when b is null
+            u32 rle_encode(const u8* a, const u8* b, u32 size, u8*& out)
+            {
+                u32 start = sb_count(out);
+                u32 i = 0;
+
+                while (i < size)
+                {
+                    u32 run = 0;
+                    while (i + run < size && run < 128 && (a[i + run] ^ (b ? b[i + run] : 0)) == 0)
+                        ++run;
+
+                    if (run >= 2)
+                    {
+                        sb_push(out, (u8)(0x80 | (run - 1)));
+                        i += run;
+                        continue;
+                    }
+
+                    u32 lit = 0;
+                    while (i + lit < size && lit < 128)
+                    {
+                        u32 j = i + lit;
+                        if (j + 1 < size && (a[j] ^ (b ? b[j] : 0)) == 0 && (a[j + 1] ^ (b ? b[j + 1] : 0)) == 0)
+                            break;
+
+                        ++lit;
+                    }
+
+                    sb_push(out, (u8)(lit - 1));
+                    for (u32 k = 0; k < lit; ++k)
+                        sb_push(out, (u8)(a[i + k] ^ (b ? b[i + k] : 0)));
+
+                    i += lit;
+                }
+
+                return sb_count(out) - start;
+            }
+
+            // writes the decoded bytes to dst, or xors them into it
+            void rle_decode(const u8* src, u8* dst, u32 size, bool xor_into)
+            {
+                u32 i = 0;
+                while (i < size)
+                {
+                    u8 c = *src++;
+                    if (c & 0x80)
+                    {
+                        u32 run = (c & 0x7f) + 1;
+                        if (!xor_into)
+                            memset(dst + i, 0, run);
+
+                        i += run;
+                        continue;
+                    }
+
+                    u32 lit = c + 1;
+                    for (u32 k = 0; k < lit; ++k)
+                        dst[i + k] = xor_into ? dst[i + k] ^ src[k] : src[k];
+
+                    src += lit;
+                    i += lit;
+                }
+            }
+
+            void encode_edit(ecs_scene* scene, const pending_edit& pe, journal_action& action)
+            {
+                const u8* before = s_journal.snapshots + pe.snapshot;
+
+                for (u32 i = 0; i < scene->num_components; ++i)
+                {
+                    if (!in_mask(pe.mask, i))
+                        continue;
+
+                    const generic_cmp_array& cmp = scene->get_component_array(i);
+
+                    const u8* b = before;
+                    const u8* a = (const u8*)cmp[pe.node];
+                    before += cmp.size;
+
+                    u32 first = 0;
+                    while (first < cmp.size && b[first] == a[first])
+                        ++first;
+
+                    if (first == cmp.size)
+                        continue;
+
+                    u32 last = cmp.size;
+                    while (last > first && b[last - 1] == a[last - 1])
+                        --last;
+
+                    journal_record rec;
+                    rec.node = pe.node;
+                    rec.component = i;
+                    rec.offset = first;
+                    rec.size = last - first;
+
+                    u32 rec_offset = sb_count(action.data);
+                    sb_add(action.data, sizeof(journal_record));
+
+                    rec.before_size = rle_encode(b + first, nullptr, rec.size, action.data);
+                    rec.xor_size = rle_encode(b + first, a + first, rec.size, action.data);
+
+                    memcpy(action.data + rec_offset, &rec, sizeof(journal_record));
+                    action.num_records++;
+                }
+            }
+
+            void free_action(journal_action& action)
+            {
+                s_journal.bytes -= sb_count(action.data);
+                sb_free(action.data);
+                action.data = nullptr;
+            }
+
+            void enforce_budget()
+            {
+                while (s_journal.bytes > s_journal.budget && sb_count(s_journal.actions) > 0)
+                {
+                    u32 count = sb_count(s_journal.actions);
+
+                    if (s_journal.cursor > 0)
+                    {
+                        // oldest undo
+                        free_action(s_journal.actions[0]);
+                        memmove(&s_journal.actions[0], &s_journal.actions[1], (count - 1) * sizeof(journal_action));
+                        s_journal.cursor--;
+                    }
+                    else
+                    {
+                        // furthest redo
+                        free_action(s_journal.actions[count - 1]);
+                    }
+
+                    stb__sbn(s_journal.actions)--;
+                }
+            }
+
+            void push_action(const journal_action& action)
+            {
+                // a new action replaces anything which could be redone
+                while (sb_count(s_journal.actions) > s_journal.cursor)
+                {
+                    free_action(sb_last(s_journal.actions));
+                    stb__sbn(s_journal.actions)--;
+                }
+
+                sb_push(s_journal.actions, action);
+                s_journal.cursor++;
+                s_journal.bytes += sb_count(action.data);
+
+                enforce_budget();
+            }
+
+            // commits dirty edits which have been quiet for long enough, or all of them with force
+            void commit(ecs_scene* scene, f32 dt_ms, bool force)
+            {
+                journal_action action;
+
+                u32 num_pending = sb_count(s_journal.pending);
+                for (u32 i = 0; i < num_pending; ++i)
+                {
+                    pending_edit& pe = s_journal.pending[i];
+                    if (pe.node == PEN_INVALID_HANDLE)
+                        continue;
+
+                    if (pe.node >= scene->soa_size)
+                    {
+                        remove_pending(pe);
+                        continue;
+                    }
+
+                    if (pe.dirty)
+                    {
+                        pe.timer -= dt_ms;
+                        if (pe.timer <= 0.0f || force)
+                        {
+                            encode_edit(scene, pe, action);
+                            remove_pending(pe);
+                            continue;
+                        }
+                    }
+                    else if (!pe.seen && !force)
+                    {
+                        remove_pending(pe);
+                        continue;
+                    }
+
+                    pe.seen = false;
+                }
+
+                if (action.num_records > 0)
+                    push_action(action);
+                else
+                    sb_free(action.data);
+
+                if (s_journal.snapshot_garbage > 0)
+                    compact_pending();
+            }
+
+            void apply_action(ecs_scene* scene, const journal_action& action, bool redo)
+            {
+                const u8* p = action.data;
+
+                for (u32 r = 0; r < action.num_records; ++r)
+                {
+                    journal_record rec;
+                    memcpy(&rec, p, sizeof(journal_record));
+
+                    const u8* before = p + sizeof(journal_record);
+                    const u8* delta = before + rec.before_size;
+                    p = delta + rec.xor_size;
+
+                    if (rec.node >= scene->soa_size || rec.component >= scene->num_components)
+                        continue;
+
+                    generic_cmp_array& cmp = scene->get_component_array(rec.component);
+                    if (rec.offset + rec.size > cmp.size)
+                        continue;
+
+                    // restoring state flags can change the selection
+                    if (scene->state_flags[rec.node] & SF_SELECTED)
+                    {
+                        sb_clear(scene->selection_list);
+                    }
+
+                    // an edit in progress would commit the restore as a new action
+                    pending_edit* pe = find_pending(rec.node);
+                    if (pe)
+                        remove_pending(*pe);
+
+                    u32 h_cur = scene->physics_handles[rec.node];
+
+                    u8* dst = (u8*)cmp[rec.node] + rec.offset;
+                    rle_decode(before, dst, rec.size, false);
+
+                    if (redo)
+                        rle_decode(delta, dst, rec.size, true);
+
+                    // release physics for entities which did not have it
+                    if (rec.component == get_component_index(scene, &scene->physics_handles) && h_cur &&
+                        scene->physics_handles[rec.node] == 0)
+                        physics::release_entity(h_cur);
+                }
+
+                if (s_journal.snapshot_garbage > 0)
+                    compact_pending();
+            }
+        } // namespace
+
+        void journal_begin(ecs_scene* scene, u32 node, u64 component_mask)
+        {
+            if (node >= scene->soa_size)
+                return;
+
+            reserve_lookup(scene->soa_size);
+
+            pending_edit* existing = find_pending(node);
+            if (existing)
+            {
+                existing->seen = true;
+
+                u64 mask = existing->mask | component_mask;
+                if (mask == existing->mask)
+                    return;
+
+                // widen, the added components have not been edited yet so they are taken from the node
+                u32 size = snapshot_size(scene, mask);
+                u32 offset = sb_count(s_journal.snapshots);
+                sb_add(s_journal.snapshots, size);
+
+                const u8* prev = s_journal.snapshots + existing->snapshot;
+                write_snapshot(scene, node, mask, existing->mask, prev, s_journal.snapshots + offset);
+
+                s_journal.snapshot_garbage += existing->snapshot_size;
+
+                existing->mask = mask;
+                existing->snapshot = offset;
+                existing->snapshot_size = size;
+                existing->hash = hash_node(scene, node, mask);
+                return;
+            }
+
+            pending_edit pe;
+            pe.node = node;
+            pe.mask = component_mask;
+            pe.snapshot_size = snapshot_size(scene, component_mask);
+            pe.snapshot = sb_count(s_journal.snapshots);
+            pe.hash = hash_node(scene, node, component_mask);
+            pe.timer = 0.0f;
+            pe.dirty = false;
+            pe.seen = true;
+
+            sb_add(s_journal.snapshots, pe.snapshot_size);
+            write_snapshot(scene, node, component_mask, 0, nullptr, s_journal.snapshots + pe.snapshot);
+
+            s_journal.lookup[node] = sb_count(s_journal.pending);
+            sb_push(s_journal.pending, pe);
+        }
+
+        void journal_touch(ecs_scene* scene, u32 node)
+        {
+            pending_edit* pe = find_pending(node);
+            if (!pe)
+                return;
+
+            pe->dirty = true;
+            pe->timer = k_journal_commit_ms;
+        }
+
+        void journal_detect(ecs_scene* scene, u32 node)
+        {
+            pending_edit* pe = find_pending(node);
+            if (!pe)
+                return;
+
+            u64 h = hash_node(scene, node, pe->mask);
+            if (h == pe->hash)
+                return;
+
+            pe->hash = h;
+            journal_touch(scene, node);
+        }
+
+        void journal_update(ecs_scene* scene, f32 dt_ms)
+        {
+            commit(scene, dt_ms, false);
+        }
+
+        bool journal_undo(ecs_scene* scene)
+        {
+            // edits still settling are committed so they are what gets undone
+            commit(scene, 0.0f, true);
+
+            if (s_journal.cursor == 0)
+                return false;
+
+            s_journal.cursor--;
+            apply_action(scene, s_journal.actions[s_journal.cursor], false);
+            return true;
+        }
+
+        bool journal_redo(ecs_scene* scene)
+        {
+            if (s_journal.cursor >= (u32)sb_count(s_journal.actions))
+                return false;
+
+            apply_action(scene, s_journal.actions[s_journal.cursor], true);
+            s_journal.cursor++;
+            return true;
+        }
+
+        void journal_clear()
+        {
+            u32 num_actions = sb_count(s_journal.actions);
+            for (u32 i = 0; i < num_actions; ++i)
+                free_action(s_journal.actions[i]);
+
+            sb_free(s_journal.actions);
+            sb_free(s_journal.pending);
+            sb_free(s_journal.snapshots);
+            pen::memory_free(s_journal.lookup);
+
+            size_t budget = s_journal.budget;
+            s_journal = journal();
+            s_journal.budget = budget;
+        }
+
+        void journal_set_budget(size_t bytes)
+        {
+            s_journal.budget = bytes;
+            enforce_budget();
+        }
+
+        journal_stats journal_get_stats()
+        {
+            journal_stats stats;
+            stats.num_undo = s_journal.cursor;
+            stats.num_redo = sb_count(s_journal.actions) - s_journal.cursor;
+            stats.journal_bytes = s_journal.bytes;
+            stats.snapshot_bytes = sb_count(s_journal.snapshots);
+            stats.budget_bytes = s_journal.budget;
+
+            u32 num_pending = sb_count(s_journal.pending);
+            for (u32 i = 0; i < num_pending; ++i)
+                if (s_journal.pending[i].node != PEN_INVALID_HANDLE)
+                    stats.num_pending++;
+
+            return stats;
+        }
+    } // namespace ecs
+} // namespace put
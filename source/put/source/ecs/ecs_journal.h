@@ -0,0 +1,57 @@
+// ecs_journal.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "ecs/ecs_chunks.h"
+#include "ecs/ecs_scene.h"
+
+// Undo / redo journal for editor edits.
+// An edit snapshots only the components of a node it may change (journal_begin). Edits which know what they changed
+// mark the node dirty (journal_touch), the single node component ui has no way to know so it compares a hash of the
+// node against the hash from the last frame (journal_detect), nothing is compared against whole snapshots per frame.
+// Once a dirty node has been quiet for k_journal_commit_ms the edits of every quiet node are committed as one action.
+// An action stores just the byte range of each component which changed, as the bytes before the edit and the xor of
+// before and after, both zero run length encoded. Undo writes the before bytes and redo writes before ^ xor, so
+// restores are absolute and stay correct if other systems have written to the node since.
+// Actions live in a journal bounded by a byte budget, the oldest are dropped to make room for new ones.
+
+namespace put
+{
+    namespace ecs
+    {
+        static const f32 k_journal_commit_ms = 330.0f;
+        static const u64 k_journal_all_components = ~0ull;
+
+        struct journal_stats
+        {
+            u32    num_undo = 0;
+            u32    num_redo = 0;
+            u32    num_pending = 0;  // nodes with an edit in progress
+            size_t journal_bytes = 0; // committed actions
+            size_t snapshot_bytes = 0;
+            size_t budget_bytes = 0;
+        };
+
+        // component bits for journal_begin from a component array, ie. &scene->transforms
+        // components from 63 onwards all share the last bit
+        inline u64 journal_component_bit(ecs_scene* scene, const void* cmp)
+        {
+            u32 index = get_component_index(scene, cmp);
+            return 1ull << (index < 63 ? index : 63);
+        }
+
+        void journal_begin(ecs_scene* scene, u32 node, u64 component_mask = k_journal_all_components);
+        void journal_touch(ecs_scene* scene, u32 node);
+        void journal_detect(ecs_scene* scene, u32 node);
+        void journal_update(ecs_scene* scene, f32 dt_ms);
+
+        bool journal_undo(ecs_scene* scene);
+        bool journal_redo(ecs_scene* scene);
+        void journal_clear();
+
+        void          journal_set_budget(size_t bytes);
+        journal_stats journal_get_stats();
+    } // namespace ecs
+} // namespace put
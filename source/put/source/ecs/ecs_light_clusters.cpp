@@ -0,0 +1,535 @@
+// ecs_light_clusters.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "ecs/ecs_light_clusters.h"
+#include "camera.h"
+#include "data_struct.h"
+#include "memory.h"
+#include "threads.h"
+#include "timer.h"
+
+#if PEN_SSE
+#include <emmintrin.h>
+#endif
+
+using namespace put;
+using namespace ecs;
+
+namespace
+{
+    // point_light_attenuation_cutoff reaches zero at sqrt(1 / cutoff) * radius with a cutoff of 0.2
+    const f32 k_point_light_influence = 2.236f;
+
+    struct bin_job
+    {
+        ecs_light_clusters* lc;
+        u32                 num_lights;
+    };
+
+    void build_cluster_bounds(ecs_light_clusters* lc, camera* cam)
+    {
+        if (lc->fov == cam->fov && lc->aspect == cam->aspect && lc->near_plane == cam->near_plane &&
+            lc->far_plane == cam->far_plane)
+            return;
+
+        lc->fov = cam->fov;
+        lc->aspect = cam->aspect;
+        lc->near_plane = cam->near_plane;
+        lc->far_plane = cam->far_plane;
+
+        // exponential slices keep clusters roughly cubic in view space
+        f32 ratio = cam->far_plane / cam->near_plane;
+        for (u32 z = 0; z <= LIGHT_CLUSTER_DIM_Z; ++z)
+            lc->slice_depth[z] = cam->near_plane * pow(ratio, (f32)z / (f32)LIGHT_CLUSTER_DIM_Z);
+
+        f32 tan_y = tan(maths::deg_to_rad(cam->fov) * 0.5f);
+        f32 tan_x = tan_y * cam->aspect;
+
+        for (u32 z = 0; z < LIGHT_CLUSTER_DIM_Z; ++z)
+        {
+            f32 d[2] = {lc->slice_depth[z], lc->slice_depth[z + 1]};
+
+            for (u32 y = 0; y < LIGHT_CLUSTER_DIM_Y; ++y)
+            {
+                // tile rows start at the top of the screen
+                f32 ny[2] = {1.0f - 2.0f * (f32)y / (f32)LIGHT_CLUSTER_DIM_Y,
+                             1.0f - 2.0f * (f32)(y + 1) / (f32)LIGHT_CLUSTER_DIM_Y};
+
+                for (u32 x = 0; x < LIGHT_CLUSTER_DIM_X; ++x)
+                {
+                    f32 nx[2] = {-1.0f + 2.0f * (f32)x / (f32)LIGHT_CLUSTER_DIM_X,
+                                 -1.0f + 2.0f * (f32)(x + 1) / (f32)LIGHT_CLUSTER_DIM_X};
+
+                    vec3f cmin = vec3f::flt_max();
+                    vec3f cmax = -vec3f::flt_max();
+
+                    for (u32 i = 0; i < 8; ++i)
+                    {
+                        f32   depth = d[i & 1];
+                        vec3f p = vec3f(nx[(i >> 1) & 1] * depth * tan_x, ny[(i >> 2) & 1] * depth * tan_y, -depth);
+
+                        cmin = vec3f::vmin(cmin, p);
+                        cmax = vec3f::vmax(cmax, p);
+                    }
+
+                    u32   c = z * LIGHT_CLUSTER_SLICE + y * LIGHT_CLUSTER_DIM_X + x;
+                    vec3f centre = (cmin + cmax) * 0.5f;
+
+                    for (u32 a = 0; a < 3; ++a)
+                    {
+                        lc->aabb_min[a][c] = cmin[a];
+                        lc->aabb_max[a][c] = cmax[a];
+                        lc->sphere_pos[a][c] = centre[a];
+                    }
+
+                    lc->sphere_radius[c] = mag(cmax - centre);
+                }
+            }
+        }
+    }
+
+    template <typename T>
+    pen_inline void reset_buffer(T* sb)
+    {
+        if (sb)
+            stb__sbn(sb) = 0;
+    }
+
+    void gather_lights(ecs_scene* scene, ecs_light_clusters* lc, camera* cam)
+    {
+        reset_buffer(lc->lights);
+        reset_buffer(lc->view_lights);
+
+        lc->stats.num_point_lights = 0;
+        lc->stats.num_spot_lights = 0;
+
+        for (u32 pass = 0; pass < 2; ++pass)
+        {
+            u32 type = pass == 0 ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT;
+
+            for (u32 n = 0; n < scene->num_entities; ++n)
+            {
+                if (sb_count(lc->lights) >= MAX_CLUSTERED_LIGHTS)
+                    break;
+
+                if (!(scene->entities[n] & CMP_LIGHT))
+                    continue;
+
+                cmp_light& l = scene->lights[n];
+                if (l.type != type)
+                    continue;
+
+                vec3f pos = scene->world_matrices[n].get_translation();
+                vec3f vpos = cam->view.transform_vector(vec4f(pos, 1.0f)).xyz;
+
+                light_data ld;
+                ld.pos_radius = vec4f(pos, l.radius);
+                ld.dir_cutoff = vec4f(0.0f, 0.0f, 0.0f, 0.0f);
+                ld.colour = vec4f(l.colour, 0.0f);
+                ld.data = vec4f(0.0f, 0.0f, 0.0f, 0.0f);
+
+                cluster_light cl;
+                cl.pos[0] = vpos.x;
+                cl.pos[1] = vpos.y;
+                cl.pos[2] = vpos.z;
+                cl.spot = 0;
+
+                if (type == LIGHT_TYPE_POINT)
+                {
+                    cl.radius = l.radius * k_point_light_influence;
+                    lc->stats.num_point_lights++;
+                }
+                else
+                {
+                    // spot_light_attenuation cuts off at 1 - dot(l, dir) > cos_cutoff
+                    vec3f dir = normalized(-scene->world_matrices[n].get_column(1).xyz);
+                    vec3f vdir = cam->view.transform_vector(vec4f(dir, 0.0f)).xyz;
+                    f32   ca = std::min<f32>(std::max<f32>(1.0f - l.cos_cutoff, -1.0f), 1.0f);
+
+                    ld.dir_cutoff = vec4f(dir, l.cos_cutoff);
+                    ld.data = vec4f(l.spot_falloff, 1.0f, 0.0f, 0.0f);
+
+                    cl.radius = l.radius;
+                    cl.dir[0] = vdir.x;
+                    cl.dir[1] = vdir.y;
+                    cl.dir[2] = vdir.z;
+                    cl.cos_angle = ca;
+                    cl.sin_angle = sqrt(1.0f - ca * ca);
+                    cl.spot = 1;
+                    lc->stats.num_spot_lights++;
+                }
+
+                cl.min_depth = -cl.pos[2] - cl.radius;
+                cl.max_depth = -cl.pos[2] + cl.radius;
+
+                sb_push(lc->lights, ld);
+                sb_push(lc->view_lights, cl);
+            }
+        }
+    }
+
+#if PEN_SSE
+    pen_inline u32 sphere_aabb_mask(const ecs_light_clusters* lc, u32 c, const cluster_light& l)
+    {
+        __m128 zero = _mm_setzero_ps();
+        __m128 d2 = zero;
+
+        for (u32 a = 0; a < 3; ++a)
+        {
+            __m128 p = _mm_set1_ps(l.pos[a]);
+            __m128 lo = _mm_sub_ps(_mm_loadu_ps(&lc->aabb_min[a][c]), p);
+            __m128 hi = _mm_sub_ps(p, _mm_loadu_ps(&lc->aabb_max[a][c]));
+            __m128 d = _mm_max_ps(_mm_max_ps(lo, hi), zero);
+            d2 = _mm_add_ps(d2, _mm_mul_ps(d, d));
+        }
+
+        __m128 r2 = _mm_set1_ps(l.radius * l.radius);
+        return (u32)_mm_movemask_ps(_mm_cmple_ps(d2, r2));
+    }
+
+    pen_inline u32 cone_sphere_mask(const ecs_light_clusters* lc, u32 c, const cluster_light& l)
+    {
+        __m128 zero = _mm_setzero_ps();
+        __m128 len_sq = zero;
+        __m128 v1 = zero;
+
+        for (u32 a = 0; a < 3; ++a)
+        {
+            __m128 v = _mm_sub_ps(_mm_loadu_ps(&lc->sphere_pos[a][c]), _mm_set1_ps(l.pos[a]));
+            len_sq = _mm_add_ps(len_sq, _mm_mul_ps(v, v));
+            v1 = _mm_add_ps(v1, _mm_mul_ps(v, _mm_set1_ps(l.dir[a])));
+        }
+
+        __m128 sr = _mm_loadu_ps(&lc->sphere_radius[c]);
+        __m128 perp = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(len_sq, _mm_mul_ps(v1, v1)), zero));
+        __m128 closest =
+            _mm_sub_ps(_mm_mul_ps(perp, _mm_set1_ps(l.cos_angle)), _mm_mul_ps(v1, _mm_set1_ps(l.sin_angle)));
+
+        __m128 in_angle = _mm_cmple_ps(closest, sr);
+        __m128 in_front = _mm_cmple_ps(v1, _mm_add_ps(sr, _mm_set1_ps(l.radius)));
+        __m128 in_back = _mm_cmpge_ps(v1, _mm_sub_ps(zero, sr));
+
+        return (u32)_mm_movemask_ps(_mm_and_ps(in_angle, _mm_and_ps(in_front, in_back)));
+    }
+#else
+    pen_inline u32 sphere_aabb_mask(const ecs_light_clusters* lc, u32 c, const cluster_light& l)
+    {
+        u32 mask = 0;
+        for (u32 i = 0; i < 4; ++i)
+        {
+            f32 d2 = 0.0f;
+            for (u32 a = 0; a < 3; ++a)
+            {
+                f32 d = std::max<f32>(std::max<f32>(lc->aabb_min[a][c + i] - l.pos[a], l.pos[a] - lc->aabb_max[a][c + i]),
+                                      0.0f);
+                d2 += d * d;
+            }
+
+            if (d2 <= l.radius * l.radius)
+                mask |= 1 << i;
+        }
+
+        return mask;
+    }
+
+    pen_inline u32 cone_sphere_mask(const ecs_light_clusters* lc, u32 c, const cluster_light& l)
+    {
+        u32 mask = 0;
+        for (u32 i = 0; i < 4; ++i)
+        {
+            f32 len_sq = 0.0f;
+            f32 v1 = 0.0f;
+            for (u32 a = 0; a < 3; ++a)
+            {
+                f32 v = lc->sphere_pos[a][c + i] - l.pos[a];
+                len_sq += v * v;
+                v1 += v * l.dir[a];
+            }
+
+            f32 sr = lc->sphere_radius[c + i];
+            f32 closest = l.cos_angle * sqrt(std::max<f32>(len_sq - v1 * v1, 0.0f)) - v1 * l.sin_angle;
+
+            if (closest <= sr && v1 <= sr + l.radius && v1 >= -sr)
+                mask |= 1 << i;
+        }
+
+        return mask;
+    }
+#endif
+
+    void bin_slices(u32 start, u32 end, void* user_data)
+    {
+        bin_job*            job = (bin_job*)user_data;
+        ecs_light_clusters* lc = job->lc;
+
+        for (u32 z = start; z < end; ++z)
+        {
+            u32 first = z * LIGHT_CLUSTER_SLICE;
+            f32 d0 = lc->slice_depth[z];
+            f32 d1 = lc->slice_depth[z + 1];
+
+            memset(&lc->cluster_counts[first], 0x0, sizeof(u32) * LIGHT_CLUSTER_SLICE);
+            lc->slice_overflow[z] = 0;
+
+            for (u32 i = 0; i < job->num_lights; ++i)
+            {
+                const cluster_light& l = lc->view_lights[i];
+                if (l.max_depth < d0 || l.min_depth > d1)
+                    continue;
+
+                for (u32 c = first; c < first + LIGHT_CLUSTER_SLICE; c += 4)
+                {
+                    u32 mask = sphere_aabb_mask(lc, c, l);
+
+                    if (mask && l.spot)
+                        mask &= cone_sphere_mask(lc, c, l);
+
+                    for (u32 b = 0; mask; ++b, mask >>= 1)
+                    {
+                        if (!(mask & 1))
+                            continue;
+
+                        u32& count = lc->cluster_counts[c + b];
+                        if (count < MAX_LIGHTS_PER_CLUSTER)
+                        {
+                            lc->cluster_lights[(c + b) * MAX_LIGHTS_PER_CLUSTER + count] = i;
+                            ++count;
+                        }
+                        else
+                        {
+                            lc->slice_overflow[z]++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void compact_clusters(ecs_light_clusters* lc)
+    {
+        light_cluster_stats& st = lc->stats;
+        st.num_indices = 0;
+        st.max_cluster_lights = 0;
+        st.occupied_clusters = 0;
+        st.overflow = 0;
+
+        reset_buffer(lc->indices);
+
+        // the gpu index buffer only grows on the user thread, lights beyond it are dropped until the next frame
+        u32 required = 0;
+
+        for (u32 c = 0; c < LIGHT_CLUSTER_COUNT; ++c)
+        {
+            u32 count = lc->cluster_counts[c];
+            u32 offset = sb_count(lc->indices);
+
+            required += count;
+            if (offset + count > lc->index_buffer_capacity)
+            {
+                st.overflow += offset + count - lc->index_buffer_capacity;
+                count = lc->index_buffer_capacity - offset;
+            }
+
+            lc->grid[c * 2 + 0] = offset;
+            lc->grid[c * 2 + 1] = count;
+
+            for (u32 i = 0; i < count; ++i)
+                sb_push(lc->indices, lc->cluster_lights[c * MAX_LIGHTS_PER_CLUSTER + i]);
+
+            if (count)
+                st.occupied_clusters++;
+
+            st.max_cluster_lights = std::max<u32>(st.max_cluster_lights, count);
+        }
+
+        for (u32 z = 0; z < LIGHT_CLUSTER_DIM_Z; ++z)
+            st.overflow += lc->slice_overflow[z];
+
+        st.num_indices = sb_count(lc->indices);
+        lc->required_indices = std::max<u32>(lc->required_indices, required);
+    }
+
+    ecs_light_clusters* create_light_clusters()
+    {
+        ecs_light_clusters* lc = new ecs_light_clusters();
+
+        for (u32 a = 0; a < 3; ++a)
+        {
+            lc->aabb_min[a] = (f32*)pen::memory_alloc(sizeof(f32) * LIGHT_CLUSTER_COUNT);
+            lc->aabb_max[a] = (f32*)pen::memory_alloc(sizeof(f32) * LIGHT_CLUSTER_COUNT);
+            lc->sphere_pos[a] = (f32*)pen::memory_alloc(sizeof(f32) * LIGHT_CLUSTER_COUNT);
+        }
+
+        lc->sphere_radius = (f32*)pen::memory_alloc(sizeof(f32) * LIGHT_CLUSTER_COUNT);
+        lc->cluster_lights = (u32*)pen::memory_alloc(sizeof(u32) * LIGHT_CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER);
+        lc->cluster_counts = (u32*)pen::memory_alloc(sizeof(u32) * LIGHT_CLUSTER_COUNT);
+        lc->grid = (u32*)pen::memory_alloc(sizeof(u32) * LIGHT_CLUSTER_COUNT * 2);
+
+        memset(lc->cluster_counts, 0x0, sizeof(u32) * LIGHT_CLUSTER_COUNT);
+        memset(lc->grid, 0x0, sizeof(u32) * LIGHT_CLUSTER_COUNT * 2);
+        memset(lc->slice_overflow, 0x0, sizeof(lc->slice_overflow));
+
+        return lc;
+    }
+
+    u32 create_structured_buffer(u32 num_elements, u32 stride)
+    {
+        pen::buffer_creation_params bcp;
+        bcp.usage_flags = PEN_USAGE_DYNAMIC;
+        bcp.bind_flags = PEN_BIND_SHADER_RESOURCE;
+        bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
+        bcp.buffer_size = num_elements * stride;
+        bcp.stride = stride;
+        bcp.data = nullptr;
+
+        return pen::renderer_create_buffer(bcp);
+    }
+} // namespace
+
+namespace put
+{
+    namespace ecs
+    {
+        void bin_light_clusters(ecs_scene* scene, camera* cam, const pen::viewport& vp)
+        {
+            static pen::timer* timer = pen::timer_create();
+            pen::timer_start(timer);
+
+            ecs_light_clusters* lc = scene->light_clusters;
+            if (!lc)
+                return;
+
+            // clusters are built from a symmetric perspective frustum
+            if (cam->flags & CF_ORTHO)
+            {
+                reset_buffer(lc->lights);
+                reset_buffer(lc->indices);
+                memset(lc->grid, 0x0, sizeof(u32) * LIGHT_CLUSTER_COUNT * 2);
+                lc->stats = light_cluster_stats();
+                return;
+            }
+
+            build_cluster_bounds(lc, cam);
+            gather_lights(scene, lc, cam);
+
+            bin_job job;
+            job.lc = lc;
+            job.num_lights = sb_count(lc->view_lights);
+
+            pen::jobs_parallel_for(LIGHT_CLUSTER_DIM_Z, 1, bin_slices, &job);
+
+            compact_clusters(lc);
+
+            f32 log_ratio = log(cam->far_plane / cam->near_plane);
+            f32 scale = (f32)LIGHT_CLUSTER_DIM_Z / log_ratio;
+
+            lc->info.dims = vec4f(LIGHT_CLUSTER_DIM_X, LIGHT_CLUSTER_DIM_Y, LIGHT_CLUSTER_DIM_Z, job.num_lights);
+            lc->info.depth = vec4f(cam->near_plane, cam->far_plane, scale, -log(cam->near_plane) * scale);
+            lc->info.screen = vec4f(1.0f / vp.width, 1.0f / vp.height, vp.x, vp.y);
+
+            lc->stats.bin_ms = pen::timer_elapsed_ms(timer);
+        }
+
+        void create_light_cluster_resources(ecs_scene* scene)
+        {
+            if (!scene->light_clusters)
+                scene->light_clusters = create_light_clusters();
+
+            ecs_light_clusters* lc = scene->light_clusters;
+
+            if (!is_valid(lc->light_buffer))
+            {
+                lc->light_buffer = create_structured_buffer(MAX_CLUSTERED_LIGHTS, sizeof(light_data));
+                lc->grid_buffer = create_structured_buffer(LIGHT_CLUSTER_COUNT, sizeof(u32) * 2);
+
+                pen::buffer_creation_params bcp;
+                bcp.usage_flags = PEN_USAGE_DYNAMIC;
+                bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
+                bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
+                bcp.buffer_size = sizeof(light_cluster_info);
+                bcp.data = nullptr;
+
+                lc->info_buffer = pen::renderer_create_buffer(bcp);
+            }
+
+            // index list grows to fit the largest demand binned since the last update
+            u32 required = lc->required_indices;
+            if (required > lc->index_buffer_capacity || !is_valid(lc->index_buffer))
+            {
+                if (is_valid(lc->index_buffer))
+                    pen::renderer_release_buffer(lc->index_buffer);
+
+                lc->index_buffer_capacity = std::max<u32>(required + required / 2, 4096);
+                lc->index_buffer = create_structured_buffer(lc->index_buffer_capacity, sizeof(u32));
+            }
+
+            lc->required_indices = 0;
+        }
+
+        void update_light_cluster_buffers(ecs_scene* scene)
+        {
+            ecs_light_clusters* lc = scene->light_clusters;
+            if (!lc || !is_valid(lc->index_buffer))
+                return;
+
+            // buffers are never read beyond the counts in the grid
+            u32 num_indices = sb_count(lc->indices);
+
+            u32 num_lights = sb_count(lc->lights);
+            if (num_lights)
+                pen::renderer_update_buffer(lc->light_buffer, lc->lights, num_lights * sizeof(light_data));
+
+            if (num_indices)
+                pen::renderer_update_buffer(lc->index_buffer, lc->indices, num_indices * sizeof(u32));
+
+            pen::renderer_update_buffer(lc->grid_buffer, lc->grid, LIGHT_CLUSTER_COUNT * 2 * sizeof(u32));
+            pen::renderer_update_buffer(lc->info_buffer, &lc->info, sizeof(light_cluster_info));
+        }
+
+        void bind_light_clusters(ecs_scene* scene)
+        {
+            ecs_light_clusters* lc = scene->light_clusters;
+            if (!lc || !is_valid(lc->info_buffer))
+                return;
+
+            static const u32 sb_flags = pen::SBUFFER_BIND_PS | pen::SBUFFER_BIND_READ;
+
+            pen::renderer_set_constant_buffer(lc->info_buffer, LIGHT_CLUSTER_INFO_SLOT, pen::CBUFFER_BIND_PS);
+            pen::renderer_set_structured_buffer(lc->light_buffer, LIGHT_CLUSTER_LIGHTS_SLOT, sb_flags);
+            pen::renderer_set_structured_buffer(lc->grid_buffer, LIGHT_CLUSTER_GRID_SLOT, sb_flags);
+            pen::renderer_set_structured_buffer(lc->index_buffer, LIGHT_CLUSTER_INDEX_SLOT, sb_flags);
+        }
+
+        void release_light_clusters(ecs_scene* scene)
+        {
+            ecs_light_clusters* lc = scene->light_clusters;
+            if (!lc)
+                return;
+
+            u32 buffers[] = {lc->light_buffer, lc->grid_buffer, lc->index_buffer, lc->info_buffer};
+            for (u32 b : buffers)
+                if (is_valid(b))
+                    pen::renderer_release_buffer(b);
+
+            for (u32 a = 0; a < 3; ++a)
+            {
+                pen::memory_free(lc->aabb_min[a]);
+                pen::memory_free(lc->aabb_max[a]);
+                pen::memory_free(lc->sphere_pos[a]);
+            }
+
+            pen::memory_free(lc->sphere_radius);
+            pen::memory_free(lc->cluster_lights);
+            pen::memory_free(lc->cluster_counts);
+            pen::memory_free(lc->grid);
+
+            sb_free(lc->lights);
+            sb_free(lc->view_lights);
+            sb_free(lc->indices);
+
+            delete lc;
+            scene->light_clusters = nullptr;
+        }
+    } // namespace ecs
+} // namespace put
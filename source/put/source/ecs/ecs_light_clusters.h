@@ -0,0 +1,116 @@
+// ecs_light_clusters.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "ecs/ecs_scene.h"
+
+// Clustered forward lighting.
+// The view frustum is split into a froxel grid (screen tiles x exponential depth slices), point and spot lights are
+// binned into the clusters they touch on the cpu and a compact offset / count grid with a light index list is
+// uploaded alongside an uncapped light buffer, so the forward_lit_clustered technique only evaluates nearby lights.
+// Directional lights, shadow maps and area lights remain in the forward light buffers.
+// Binning is split across worker threads by depth slice and tests 4 clusters at a time against each light.
+
+namespace put
+{
+    struct camera;
+
+    namespace ecs
+    {
+        enum e_light_cluster_constants
+        {
+            LIGHT_CLUSTER_DIM_X = 16,
+            LIGHT_CLUSTER_DIM_Y = 9,
+            LIGHT_CLUSTER_DIM_Z = 24,
+            LIGHT_CLUSTER_SLICE = LIGHT_CLUSTER_DIM_X * LIGHT_CLUSTER_DIM_Y,
+            LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_SLICE * LIGHT_CLUSTER_DIM_Z,
+            MAX_CLUSTERED_LIGHTS = 4096,
+            MAX_LIGHTS_PER_CLUSTER = 128
+        };
+
+        // slots shared with forward_render.pmfx
+        enum e_light_cluster_slots
+        {
+            LIGHT_CLUSTER_INFO_SLOT = 11,
+            LIGHT_CLUSTER_LIGHTS_SLOT = 16,
+            LIGHT_CLUSTER_GRID_SLOT = 17,
+            LIGHT_CLUSTER_INDEX_SLOT = 18
+        };
+
+        struct light_cluster_info
+        {
+            vec4f dims;   // xyz = grid dimensions, w = num lights
+            vec4f depth;  // x = near, y = far, z = log depth scale, w = log depth bias
+            vec4f screen; // xy = 1 / viewport size, zw = viewport offset
+        };
+
+        struct light_cluster_stats
+        {
+            u32 num_point_lights = 0;
+            u32 num_spot_lights = 0;
+            u32 num_indices = 0;
+            u32 max_cluster_lights = 0;
+            u32 occupied_clusters = 0;
+            u32 overflow = 0; // light / cluster pairs dropped because a cluster was full
+            f32 bin_ms = 0.0f;
+        };
+
+        struct cluster_light
+        {
+            f32 pos[3]; // view space
+            f32 radius; // influence radius
+            f32 dir[3]; // view space, spot only
+            f32 cos_angle;
+            f32 sin_angle;
+            f32 min_depth;
+            f32 max_depth;
+            u32 spot;
+        };
+
+        struct ecs_light_clusters
+        {
+            // view space cluster bounds, soa for 4 wide tests. sphere bounds are used for spot cones
+            f32* aabb_min[3] = {nullptr};
+            f32* aabb_max[3] = {nullptr};
+            f32* sphere_pos[3] = {nullptr};
+            f32* sphere_radius = nullptr;
+            f32  slice_depth[LIGHT_CLUSTER_DIM_Z + 1];
+
+            // camera the bounds were built for
+            f32 fov = 0.0f;
+            f32 aspect = 0.0f;
+            f32 near_plane = 0.0f;
+            f32 far_plane = 0.0f;
+
+            light_data*    lights = nullptr;      // point lights then spot lights
+            cluster_light* view_lights = nullptr; // culling data for lights
+            u32*           cluster_lights = nullptr; // MAX_LIGHTS_PER_CLUSTER per cluster
+            u32*           cluster_counts = nullptr;
+            u32*           grid = nullptr;        // offset, count per cluster
+            u32*           indices = nullptr;
+            u32            slice_overflow[LIGHT_CLUSTER_DIM_Z];
+
+            light_cluster_info  info;
+            light_cluster_stats stats;
+
+            u32 light_buffer = PEN_INVALID_HANDLE;
+            u32 grid_buffer = PEN_INVALID_HANDLE;
+            u32 index_buffer = PEN_INVALID_HANDLE;
+            u32 info_buffer = PEN_INVALID_HANDLE;
+            u32 index_buffer_capacity = 0;
+            u32 required_indices = 0; // largest binned index count since the buffers were last created
+        };
+
+        // user thread, views may be recorded on workers so the clusters and gpu buffers are created up front
+        void create_light_cluster_resources(ecs_scene* scene);
+
+        // cpu only, gathers point and spot lights from the scene and bins them for the camera
+        void bin_light_clusters(ecs_scene* scene, camera* cam, const pen::viewport& vp);
+
+        void update_light_cluster_buffers(ecs_scene* scene);
+        void bind_light_clusters(ecs_scene* scene);
+        void release_light_clusters(ecs_scene* scene);
+    } // namespace ecs
+} // namespace put
@@ -0,0 +1,633 @@
+// ecs_lod.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "ecs/ecs_lod.h"
+#include "console.h"
+#include "data_struct.h"
+#include "dev_ui.h"
+#include "ecs/ecs_resources.h"
+#include "memory.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+extern pen::window_creation_params pen_window;
+
+using namespace put;
+using namespace ecs;
+
+namespace
+{
+    const f64 k_boundary_weight = 10.0;
+    const f32 k_flip_threshold = 0.2f;
+
+    // symmetric 4x4 plane quadric xx xy xz xw yy yz yw zz zw ww, w sums the plane weights
+    struct quadric
+    {
+        f64 a[10] = {0.0};
+        f64 w = 0.0;
+    };
+
+    void add_plane(quadric& q, const vec3f& n, f32 d, f64 weight)
+    {
+        f64 p[4] = {n.x, n.y, n.z, d};
+
+        u32 i = 0;
+        for (u32 r = 0; r < 4; ++r)
+            for (u32 c = r; c < 4; ++c)
+                q.a[i++] += p[r] * p[c] * weight;
+
+        q.w += weight;
+    }
+
+    void add_quadric(quadric& q, const quadric& other)
+    {
+        for (u32 i = 0; i < 10; ++i)
+            q.a[i] += other.a[i];
+
+        q.w += other.w;
+    }
+
+    // weighted mean squared distance from p to the planes of a and b
+    f64 eval_error(const quadric& qa, const quadric& qb, const vec3f& p)
+    {
+        f64 a[10];
+        for (u32 i = 0; i < 10; ++i)
+            a[i] = qa.a[i] + qb.a[i];
+
+        f64 x = p.x, y = p.y, z = p.z;
+        f64 e = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x + a[4] * y * y +
+                2.0 * a[5] * y * z + 2.0 * a[6] * y + a[7] * z * z + 2.0 * a[8] * z + a[9];
+
+        f64 w = qa.w + qb.w;
+        return w > 0.0 ? std::max<f64>(e, 0.0) / w : 0.0;
+    }
+
+    struct collapse
+    {
+        f64 cost;
+        u32 from;
+        u32 to;
+        u32 from_stamp;
+        u32 to_stamp;
+
+        bool operator>(const collapse& other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    typedef std::priority_queue<collapse, std::vector<collapse>, std::greater<collapse>> collapse_queue;
+
+    struct simplifier
+    {
+        // welded vertices
+        std::vector<vec3f>            pos;
+        std::vector<quadric>          quadrics;
+        std::vector<u32>              stamp;
+        std::vector<u8>               alive;
+        std::vector<std::vector<u32>> vertex_tris;
+        std::vector<u32>              member_start; // original vertices sharing each welded position
+        std::vector<u32>              members;
+
+        // triangles, welded and original vertex per corner
+        std::vector<u32> tris;
+        std::vector<u32> corners;
+        std::vector<u8>  tri_alive;
+        u32              live_tris = 0;
+
+        const vec4f* normals = nullptr;
+        u32          normal_stride = 0;
+
+        collapse_queue queue;
+        f64            max_cost = 0.0;
+    };
+
+    vec3f get_normal(const simplifier& s, u32 v)
+    {
+        const vec4f* n = (const vec4f*)((const u8*)s.normals + v * s.normal_stride);
+        return n->xyz;
+    }
+
+    vec3f tri_normal(const vec3f& p0, const vec3f& p1, const vec3f& p2)
+    {
+        return cross(p1 - p0, p2 - p0);
+    }
+
+    // vertex from welded position v which best matches the attributes of original vertex o
+    u32 pick_member(const simplifier& s, u32 v, u32 o)
+    {
+        u32 best = s.members[s.member_start[v]];
+        if (!s.normals)
+            return best;
+
+        vec3f n = get_normal(s, o);
+        f32   best_dot = -2.0f;
+        for (u32 m = s.member_start[v]; m < s.member_start[v + 1]; ++m)
+        {
+            f32 d = dot(n, get_normal(s, s.members[m]));
+            if (d > best_dot)
+            {
+                best_dot = d;
+                best = s.members[m];
+            }
+        }
+
+        return best;
+    }
+
+    void push_collapse(simplifier& s, u32 from, u32 to)
+    {
+        collapse c;
+        c.cost = eval_error(s.quadrics[from], s.quadrics[to], s.pos[to]);
+        c.from = from;
+        c.to = to;
+        c.from_stamp = s.stamp[from];
+        c.to_stamp = s.stamp[to];
+        s.queue.push(c);
+    }
+
+    void push_vertex_collapses(simplifier& s, u32 v)
+    {
+        for (u32 t : s.vertex_tris[v])
+        {
+            if (!s.tri_alive[t])
+                continue;
+
+            for (u32 k = 0; k < 3; ++k)
+            {
+                u32 w = s.tris[t * 3 + k];
+                if (w == v)
+                    continue;
+
+                push_collapse(s, v, w);
+                push_collapse(s, w, v);
+            }
+        }
+    }
+
+    // moving from onto to must not fold any of the triangles which survive
+    bool collapse_flips(const simplifier& s, u32 from, u32 to)
+    {
+        for (u32 t : s.vertex_tris[from])
+        {
+            if (!s.tri_alive[t])
+                continue;
+
+            const u32* tri = &s.tris[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to)
+                continue;
+
+            vec3f p[3];
+            vec3f q[3];
+            for (u32 k = 0; k < 3; ++k)
+            {
+                p[k] = s.pos[tri[k]];
+                q[k] = tri[k] == from ? s.pos[to] : p[k];
+            }
+
+            vec3f n0 = tri_normal(p[0], p[1], p[2]);
+            vec3f n1 = tri_normal(q[0], q[1], q[2]);
+
+            f32 l0 = mag(n0);
+            f32 l1 = mag(n1);
+            if (l1 <= 0.0f)
+                return true;
+
+            if (l0 > 0.0f && dot(n0, n1) < k_flip_threshold * l0 * l1)
+                return true;
+        }
+
+        return false;
+    }
+
+    void apply_collapse(simplifier& s, const collapse& c)
+    {
+        u32 from = c.from;
+        u32 to = c.to;
+
+        for (u32 t : s.vertex_tris[from])
+        {
+            if (!s.tri_alive[t])
+                continue;
+
+            u32* tri = &s.tris[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to)
+            {
+                s.tri_alive[t] = 0;
+                s.live_tris--;
+                continue;
+            }
+
+            for (u32 k = 0; k < 3; ++k)
+            {
+                if (tri[k] != from)
+                    continue;
+
+                tri[k] = to;
+                s.corners[t * 3 + k] = pick_member(s, to, s.corners[t * 3 + k]);
+            }
+
+            s.vertex_tris[to].push_back(t);
+        }
+
+        s.alive[from] = 0;
+        s.vertex_tris[from].clear();
+        add_quadric(s.quadrics[to], s.quadrics[from]);
+        s.stamp[to]++;
+        s.max_cost = std::max<f64>(s.max_cost, c.cost);
+
+        // drop triangles which collapsed away
+        std::vector<u32>& vt = s.vertex_tris[to];
+        vt.erase(std::remove_if(vt.begin(), vt.end(), [&](u32 t) { return !s.tri_alive[t]; }), vt.end());
+
+        push_vertex_collapses(s, to);
+    }
+
+    // collapses until the live triangle count reaches target, returns false once nothing is left within max_cost
+    bool simplify_to(simplifier& s, u32 target, f64 max_cost)
+    {
+        while (s.live_tris > target)
+        {
+            if (s.queue.empty())
+                return false;
+
+            collapse c = s.queue.top();
+            if (c.cost > max_cost)
+                return false;
+
+            s.queue.pop();
+
+            if (!s.alive[c.from] || !s.alive[c.to])
+                continue;
+
+            if (s.stamp[c.from] != c.from_stamp || s.stamp[c.to] != c.to_stamp)
+                continue;
+
+            if (collapse_flips(s, c.from, c.to))
+                continue;
+
+            apply_collapse(s, c);
+        }
+
+        return true;
+    }
+
+    bool same_position(const vec4f& a, const vec4f& b)
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+
+    void weld_vertices(simplifier& s, const vec4f* positions, u32 num_vertices, std::vector<u32>& weld)
+    {
+        std::vector<u32> order(num_vertices);
+        for (u32 i = 0; i < num_vertices; ++i)
+            order[i] = i;
+
+        std::sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+            const vec4f& pa = positions[a];
+            const vec4f& pb = positions[b];
+            if (pa.x != pb.x)
+                return pa.x < pb.x;
+            if (pa.y != pb.y)
+                return pa.y < pb.y;
+            return pa.z < pb.z;
+        });
+
+        weld.resize(num_vertices);
+        s.members.resize(num_vertices);
+
+        for (u32 i = 0; i < num_vertices; ++i)
+        {
+            u32 v = order[i];
+            if (i == 0 || !same_position(positions[v], positions[order[i - 1]]))
+            {
+                s.member_start.push_back(i);
+                s.pos.push_back(positions[v].xyz);
+            }
+
+            weld[v] = (u32)s.pos.size() - 1;
+            s.members[i] = v;
+        }
+
+        s.member_start.push_back(num_vertices);
+    }
+
+    void add_boundary_planes(simplifier& s)
+    {
+        // edges used by a single triangle get a plane through the edge at right angles to the surface
+        struct edge
+        {
+            u64 key;
+            u32 tri;
+        };
+
+        std::vector<edge> edges;
+        u32               num_tris = s.tri_alive.size();
+        for (u32 t = 0; t < num_tris; ++t)
+        {
+            if (!s.tri_alive[t])
+                continue;
+
+            for (u32 k = 0; k < 3; ++k)
+            {
+                u32 a = s.tris[t * 3 + k];
+                u32 b = s.tris[t * 3 + (k + 1) % 3];
+                edges.push_back({(u64)std::min(a, b) << 32 | std::max(a, b), t});
+            }
+        }
+
+        std::sort(edges.begin(), edges.end(), [](const edge& a, const edge& b) { return a.key < b.key; });
+
+        u32 num_edges = edges.size();
+        for (u32 i = 0; i < num_edges; ++i)
+        {
+            bool shared = (i > 0 && edges[i - 1].key == edges[i].key) ||
+                          (i + 1 < num_edges && edges[i + 1].key == edges[i].key);
+            if (shared)
+                continue;
+
+            u32 a = (u32)(edges[i].key >> 32);
+            u32 b = (u32)(edges[i].key & 0xffffffff);
+
+            const u32* tri = &s.tris[edges[i].tri * 3];
+            vec3f      n = tri_normal(s.pos[tri[0]], s.pos[tri[1]], s.pos[tri[2]]);
+            vec3f      e = s.pos[b] - s.pos[a];
+            vec3f      bn = cross(e, n);
+
+            f32 len = mag(bn);
+            if (len <= 0.0f)
+                continue;
+
+            bn /= len;
+            f64 weight = (f64)dot(e, e) * k_boundary_weight;
+            f32 d = -dot(bn, s.pos[a]);
+
+            add_plane(s.quadrics[a], bn, d, weight);
+            add_plane(s.quadrics[b], bn, d, weight);
+        }
+    }
+
+    template <typename T>
+    void read_indices(const void* src, u32 count, std::vector<u32>& dst)
+    {
+        const T* idx = (const T*)src;
+        dst.resize(count);
+        for (u32 i = 0; i < count; ++i)
+            dst[i] = idx[i];
+    }
+} // namespace
+
+namespace put
+{
+    namespace ecs
+    {
+        u32 simplify_mesh(const vec4f* positions, const vec4f* normals, u32 normal_stride, u32 num_vertices,
+                          const u32* indices, u32 num_indices, f32 radius, const lod_generation_params& params,
+                          u32** out_indices, geometry_lod* lods)
+        {
+            lods[0].index_offset = 0;
+            lods[0].num_indices = num_indices;
+            lods[0].error = 0.0f;
+
+            u32* out = *out_indices;
+            for (u32 i = 0; i < num_indices; ++i)
+                sb_push(out, indices[i]);
+
+            u32 num_tris = num_indices / 3;
+            u32 max_lods = std::min<u32>(params.max_lods, MAX_GEOMETRY_LODS);
+            if (max_lods < 2 || radius <= 0.0f || (f32)num_tris * params.reduction < (f32)params.min_triangles)
+            {
+                *out_indices = out;
+                return 1;
+            }
+
+            simplifier s;
+            s.normals = normals;
+            s.normal_stride = normal_stride;
+
+            std::vector<u32> weld;
+            weld_vertices(s, positions, num_vertices, weld);
+
+            u32 num_welded = s.pos.size();
+            s.quadrics.resize(num_welded);
+            s.stamp.resize(num_welded, 0);
+            s.alive.resize(num_welded, 1);
+            s.vertex_tris.resize(num_welded);
+
+            s.tris.resize(num_tris * 3);
+            s.corners.resize(num_tris * 3);
+            s.tri_alive.resize(num_tris, 0);
+
+            // area weighted face planes
+            for (u32 t = 0; t < num_tris; ++t)
+            {
+                u32* tri = &s.tris[t * 3];
+                for (u32 k = 0; k < 3; ++k)
+                {
+                    s.corners[t * 3 + k] = indices[t * 3 + k];
+                    tri[k] = weld[indices[t * 3 + k]];
+                }
+
+                if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+                    continue;
+
+                vec3f n = tri_normal(s.pos[tri[0]], s.pos[tri[1]], s.pos[tri[2]]);
+                f32   area2 = mag(n);
+                if (area2 <= 0.0f)
+                    continue;
+
+                n /= area2;
+                f32 d = -dot(n, s.pos[tri[0]]);
+
+                for (u32 k = 0; k < 3; ++k)
+                {
+                    add_plane(s.quadrics[tri[k]], n, d, area2 * 0.5);
+                    s.vertex_tris[tri[k]].push_back(t);
+                }
+
+                s.tri_alive[t] = 1;
+                s.live_tris++;
+            }
+
+            add_boundary_planes(s);
+
+            for (u32 v = 0; v < num_welded; ++v)
+                push_vertex_collapses(s, v);
+
+            f64 max_error = params.max_error * radius;
+            f64 max_cost = max_error * max_error;
+
+            u32 num_lods = 1;
+            u32 prev_tris = s.live_tris;
+            for (; num_lods < max_lods; ++num_lods)
+            {
+                u32 target = (u32)((f32)prev_tris * params.reduction);
+                if (target < params.min_triangles)
+                    break;
+
+                bool reached = simplify_to(s, target, max_cost);
+
+                // not worth another index range if it barely saves anything
+                if (s.live_tris == 0 || (f32)s.live_tris > (f32)prev_tris * 0.9f)
+                    break;
+
+                geometry_lod& lod = lods[num_lods];
+                lod.index_offset = sb_count(out);
+                lod.num_indices = s.live_tris * 3;
+                lod.error = (f32)sqrt(s.max_cost) / radius;
+
+                for (u32 t = 0; t < num_tris; ++t)
+                {
+                    if (!s.tri_alive[t])
+                        continue;
+
+                    for (u32 k = 0; k < 3; ++k)
+                        sb_push(out, s.corners[t * 3 + k]);
+                }
+
+                prev_tris = s.live_tris;
+
+                if (!reached)
+                {
+                    num_lods++;
+                    break;
+                }
+            }
+
+            *out_indices = out;
+            return num_lods;
+        }
+
+        void generate_geometry_lods(geometry_resource* gr, const lod_generation_params& params)
+        {
+            if (!gr->cpu_index_buffer || !gr->cpu_position_buffer)
+                return;
+
+            std::vector<u32> indices;
+            if (gr->index_type == PEN_FORMAT_R16_UINT)
+                read_indices<u16>(gr->cpu_index_buffer, gr->num_indices, indices);
+            else
+                read_indices<u32>(gr->cpu_index_buffer, gr->num_indices, indices);
+
+            // cpu vertices keep the full format when the gpu buffer is packed
+            u32 normal_stride = gr->vertex_size;
+            if (gr->vertex_format == VERTEX_FORMAT_PACKED)
+                normal_stride = gr->p_skin ? sizeof(vertex_model_skinned) : sizeof(vertex_model);
+
+            const vec4f* normals = nullptr;
+            if (gr->cpu_vertex_buffer)
+                normals = (const vec4f*)((const u8*)gr->cpu_vertex_buffer + sizeof(vec4f));
+
+            f32 radius = mag(gr->max_extents - gr->min_extents) * 0.5f;
+
+            u32* out = nullptr;
+            gr->num_lods = simplify_mesh((const vec4f*)gr->cpu_position_buffer, normals, normal_stride,
+                                         gr->num_vertices, indices.data(), gr->num_indices, radius, params, &out,
+                                         gr->lods);
+
+            // levels follow lod 0 in one index buffer
+            u32 total = sb_count(out);
+            u32 index_size = gr->index_type == PEN_FORMAT_R16_UINT ? 2 : 4;
+
+            pen::memory_free(gr->cpu_index_buffer);
+            gr->cpu_index_buffer = pen::memory_alloc(total * index_size);
+
+            for (u32 i = 0; i < total; ++i)
+            {
+                if (index_size == 2)
+                    ((u16*)gr->cpu_index_buffer)[i] = (u16)out[i];
+                else
+                    ((u32*)gr->cpu_index_buffer)[i] = out[i];
+            }
+
+            sb_free(out);
+
+            if (is_valid(gr->index_buffer))
+                pen::renderer_release_buffer(gr->index_buffer);
+
+            pen::buffer_creation_params bcp;
+            bcp.usage_flags = PEN_USAGE_DEFAULT;
+            bcp.bind_flags = PEN_BIND_INDEX_BUFFER;
+            bcp.cpu_access_flags = 0;
+            bcp.buffer_size = total * index_size;
+            bcp.data = gr->cpu_index_buffer;
+
+            gr->index_buffer = pen::renderer_create_buffer(bcp);
+
+            if (gr->num_lods > 1)
+            {
+                const geometry_lod& last = gr->lods[gr->num_lods - 1];
+                dev_console_log("[lod] %s %i: %i lods, %i -> %i triangles, error %.3f", gr->geometry_name.c_str(),
+                                gr->submesh_index, gr->num_lods, gr->num_indices / 3, last.num_indices / 3, last.error);
+            }
+        }
+
+        void update_geometry_lods(ecs_scene* scene)
+        {
+            const geometry_lod_params& lp = scene->geometry_lods;
+
+            scene->geometry_stats = scene->geometry_stats_pending;
+            scene->geometry_stats_pending = geometry_lod_stats();
+
+            // projected error in pixels is error * radius / half view height * half screen height
+            f32 half_screen = (f32)pen_window.height * 0.5f;
+
+            for (u32 n = 0; n < scene->num_entities; ++n)
+            {
+                if (!(scene->entities[n] & CMP_GEOMETRY))
+                    continue;
+
+                cmp_geometry& geom = scene->geometries[n];
+                if (geom.num_lods < 2)
+                    continue;
+
+                f32 screen_size = geom.lod_screen_size;
+                geom.lod_screen_size = -1.0f;
+
+                if (!lp.enabled)
+                {
+                    geom.lod = 0;
+                    continue;
+                }
+
+                // keep the last level for anything not seen by a perspective view
+                if (screen_size < 0.0f)
+                    continue;
+
+                f32 scale = screen_size * half_screen;
+
+                u32 target = 0;
+                for (u32 l = 1; l < geom.num_lods; ++l)
+                    if (geom.lods[l].error * scale <= lp.pixel_error)
+                        target = l;
+
+                // only drop detail once the coarser level is comfortably inside the error bound
+                if (target > geom.lod)
+                {
+                    f32 threshold = lp.pixel_error * (1.0f - lp.hysteresis);
+                    while (target > geom.lod && geom.lods[target].error * scale > threshold)
+                        target--;
+                }
+
+                geom.lod = target;
+            }
+        }
+
+        u32 get_geometry_lod(const ecs_scene* scene, u32 n, bool shadow_pass)
+        {
+            const cmp_geometry& geom = scene->geometries[n];
+            if (geom.num_lods < 2 || !scene->geometry_lods.enabled)
+                return 0;
+
+            u32 lod = geom.lod;
+            if (shadow_pass)
+                lod += scene->geometry_lods.shadow_bias;
+
+            return std::min<u32>(lod, geom.num_lods - 1);
+        }
+    } // namespace ecs
+} // namespace put
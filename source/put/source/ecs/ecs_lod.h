@@ -0,0 +1,45 @@
+// ecs_lod.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "ecs/ecs_scene.h"
+
+// Geometry lod chains.
+// Simplified levels are generated from the cpu copies of a submesh with quadric error edge collapses. Vertices are
+// welded by position so seams do not split the surface, and collapses only ever move a vertex onto one of its
+// neighbours so every level indexes the original vertex buffer. Levels are appended to the index buffer after lod 0.
+// Each level stores the max error it introduced, the level drawn is the coarsest whose error projects to less than
+// geometry_lod_params::pixel_error on screen.
+
+namespace put
+{
+    namespace ecs
+    {
+        struct geometry_resource;
+
+        struct lod_generation_params
+        {
+            u32 max_lods = MAX_GEOMETRY_LODS; // including lod 0
+            f32 reduction = 0.5f;             // target triangle ratio between successive levels
+            u32 min_triangles = 64;           // no level is made smaller than this
+            f32 max_error = 0.25f;            // fraction of the bounding radius, simplification stops beyond it
+        };
+
+        // appends lods to the cpu index buffer and (re)creates the gpu index buffer, call before instantiating
+        void generate_geometry_lods(geometry_resource* gr, const lod_generation_params& params = lod_generation_params());
+
+        // writes level indices after the full mesh in out_indices and the ranges into lods, returns the level count
+        // including lod 0. normals are optional and pick which vertex to keep where positions are shared by seams
+        u32 simplify_mesh(const vec4f* positions, const vec4f* normals, u32 normal_stride, u32 num_vertices,
+                          const u32* indices, u32 num_indices, f32 radius, const lod_generation_params& params,
+                          u32** out_indices, geometry_lod* lods);
+
+        // selects levels from the screen sizes recorded by last frames views and rolls over the stats
+        void update_geometry_lods(ecs_scene* scene);
+
+        // level to draw for entity n, shadow passes add geometry_lod_params::shadow_bias
+        u32 get_geometry_lod(const ecs_scene* scene, u32 n, bool shadow_pass);
+    } // namespace ecs
+} // namespace put
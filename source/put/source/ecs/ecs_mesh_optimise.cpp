@@ -0,0 +1,521 @@
+// ecs_mesh_optimise.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "ecs/ecs_mesh_optimise.h"
+#include "console.h"
+#include "dev_ui.h"
+#include "ecs/ecs_resources.h"
+#include "memory.h"
+#include "renderer.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+using namespace put;
+using namespace ecs;
+
+namespace
+{
+    // forsyth scoring, the cache modelled here is lru and larger than the fifo used for analysis
+    const u32 k_cache_size = 32;
+    const f32 k_cache_decay_power = 1.5f;
+    const f32 k_last_tri_score = 0.75f;
+    const f32 k_valence_boost_scale = 2.0f;
+    const f32 k_valence_boost_power = 0.5f;
+
+    f32 vertex_score(s32 cache_pos, u32 remaining)
+    {
+        // nothing left to draw with it
+        if (remaining == 0)
+            return -1.0f;
+
+        f32 score = 0.0f;
+        if (cache_pos >= 0)
+        {
+            // the last triangles vertices get a fixed score so the next one does not just reuse an edge
+            if (cache_pos < 3)
+            {
+                score = k_last_tri_score;
+            }
+            else
+            {
+                f32 scale = 1.0f / (f32)(k_cache_size - 3);
+                score = powf(1.0f - (f32)(cache_pos - 3) * scale, k_cache_decay_power);
+            }
+        }
+
+        // favour vertices with few triangles left so they are finished off rather than left stranded
+        score += k_valence_boost_scale * powf((f32)remaining, -k_valence_boost_power);
+        return score;
+    }
+
+    // fifo cache simulation, a vertex is resident while fewer than cache_size misses happened since it was loaded
+    struct fifo_cache
+    {
+        std::vector<u32> stamp;
+        u32              time;
+        u32              size;
+
+        fifo_cache(u32 num_vertices, u32 cache_size) : stamp(num_vertices, 0), time(cache_size + 1), size(cache_size)
+        {
+        }
+
+        bool miss(u32 v)
+        {
+            if (time - stamp[v] <= size)
+                return false;
+
+            stamp[v] = time++;
+            return true;
+        }
+
+        void flush()
+        {
+            time += size + 1;
+        }
+    };
+
+    struct cluster
+    {
+        u32 start;
+        u32 count;
+        f32 sort_key;
+    };
+
+    vec3f get_pos(const vec4f* positions, u32 v)
+    {
+        return vec3f(positions[v].x, positions[v].y, positions[v].z);
+    }
+
+    template <typename T>
+    void read_indices(const void* src, u32 count, std::vector<u32>& dst)
+    {
+        const T* idx = (const T*)src;
+        dst.resize(count);
+        for (u32 i = 0; i < count; ++i)
+            dst[i] = idx[i];
+    }
+
+    void recreate_buffer(u32& handle, void* data, u32 size, u32 bind_flags)
+    {
+        if (!is_valid(handle))
+            return;
+
+        pen::renderer_release_buffer(handle);
+
+        pen::buffer_creation_params bcp;
+        bcp.usage_flags = PEN_USAGE_DEFAULT;
+        bcp.bind_flags = bind_flags;
+        bcp.cpu_access_flags = 0;
+        bcp.buffer_size = size;
+        bcp.data = data;
+
+        handle = pen::renderer_create_buffer(bcp);
+    }
+} // namespace
+
+namespace put
+{
+    namespace ecs
+    {
+        void optimise_vertex_cache(u32* indices, u32 num_indices, u32 num_vertices)
+        {
+            u32 num_tris = num_indices / 3;
+            if (num_tris == 0)
+                return;
+
+            // triangles using each vertex, live triangles are kept at the front of each list
+            std::vector<u32> remaining(num_vertices, 0);
+            for (u32 i = 0; i < num_tris * 3; ++i)
+                remaining[indices[i]]++;
+
+            std::vector<u32> offsets(num_vertices + 1, 0);
+            for (u32 v = 0; v < num_vertices; ++v)
+                offsets[v + 1] = offsets[v] + remaining[v];
+
+            std::vector<u32> adjacency(num_tris * 3);
+            std::vector<u32> fill(offsets.begin(), offsets.end() - 1);
+            for (u32 i = 0; i < num_tris * 3; ++i)
+                adjacency[fill[indices[i]]++] = i / 3;
+
+            std::vector<s32> cache_pos(num_vertices, -1);
+            std::vector<f32> score(num_vertices);
+            for (u32 v = 0; v < num_vertices; ++v)
+                score[v] = vertex_score(-1, remaining[v]);
+
+            std::vector<u8>  emitted(num_tris, 0);
+            std::vector<u32> out(num_tris * 3);
+
+            u32 cache[k_cache_size + 3];
+            u32 cache_count = 0;
+            u32 cursor = 0;
+            s32 best = -1;
+
+            for (u32 t = 0; t < num_tris; ++t)
+            {
+                // dead end, continue with the next triangle in submission order
+                if (best < 0)
+                {
+                    while (emitted[cursor])
+                        ++cursor;
+
+                    best = (s32)cursor;
+                }
+
+                const u32* tri = &indices[best * 3];
+                memcpy(&out[t * 3], tri, sizeof(u32) * 3);
+                emitted[best] = 1;
+
+                for (u32 k = 0; k < 3; ++k)
+                {
+                    u32  v = tri[k];
+                    u32* adj = &adjacency[offsets[v]];
+                    u32  last = remaining[v] - 1;
+
+                    for (u32 a = 0; a <= last; ++a)
+                    {
+                        if (adj[a] == (u32)best)
+                        {
+                            std::swap(adj[a], adj[last]);
+                            break;
+                        }
+                    }
+
+                    remaining[v]--;
+                }
+
+                // emitted triangle moves to the front of the lru
+                u32 new_cache[k_cache_size + 3];
+                u32 new_count = 0;
+
+                for (u32 k = 0; k < 3; ++k)
+                    new_cache[new_count++] = tri[k];
+
+                for (u32 c = 0; c < cache_count; ++c)
+                {
+                    u32 v = cache[c];
+                    if (v != tri[0] && v != tri[1] && v != tri[2])
+                        new_cache[new_count++] = v;
+                }
+
+                for (u32 c = k_cache_size; c < new_count; ++c)
+                {
+                    u32 v = new_cache[c];
+                    cache_pos[v] = -1;
+                    score[v] = vertex_score(-1, remaining[v]);
+                }
+
+                cache_count = std::min<u32>(new_count, k_cache_size);
+                memcpy(cache, new_cache, sizeof(u32) * cache_count);
+
+                for (u32 c = 0; c < cache_count; ++c)
+                {
+                    u32 v = cache[c];
+                    cache_pos[v] = (s32)c;
+                    score[v] = vertex_score((s32)c, remaining[v]);
+                }
+
+                // next triangle is the best scoring one touching the cache
+                best = -1;
+                f32 best_score = -1.0f;
+
+                for (u32 c = 0; c < cache_count; ++c)
+                {
+                    u32        v = cache[c];
+                    const u32* adj = &adjacency[offsets[v]];
+
+                    for (u32 a = 0; a < remaining[v]; ++a)
+                    {
+                        const u32* at = &indices[adj[a] * 3];
+                        f32        ts = score[at[0]] + score[at[1]] + score[at[2]];
+
+                        if (ts > best_score)
+                        {
+                            best_score = ts;
+                            best = (s32)adj[a];
+                        }
+                    }
+                }
+            }
+
+            memcpy(indices, out.data(), sizeof(u32) * num_tris * 3);
+        }
+
+        void optimise_overdraw(u32* indices, u32 num_indices, const vec4f* positions, u32 num_vertices,
+                               f32 threshold)
+        {
+            u32 num_tris = num_indices / 3;
+            if (num_tris == 0)
+                return;
+
+            const u32 cache_size = 16;
+
+            // hard boundaries, where every vertex of a triangle misses the cache has restarted anyway
+            std::vector<u32> hard;
+            {
+                fifo_cache fc(num_vertices, cache_size);
+                for (u32 t = 0; t < num_tris; ++t)
+                {
+                    u32 misses = 0;
+                    for (u32 k = 0; k < 3; ++k)
+                        misses += fc.miss(indices[t * 3 + k]) ? 1 : 0;
+
+                    if (t == 0 || misses == 3)
+                        hard.push_back(t);
+                }
+                hard.push_back(num_tris);
+            }
+
+            // soft boundaries, split once the running acmr is within threshold of the whole hard clusters
+            std::vector<cluster> clusters;
+            fifo_cache           fc(num_vertices, cache_size);
+
+            for (u32 h = 0; h + 1 < hard.size(); ++h)
+            {
+                u32 start = hard[h];
+                u32 end = hard[h + 1];
+
+                fc.flush();
+
+                u32 cluster_misses = 0;
+                for (u32 i = start * 3; i < end * 3; ++i)
+                    cluster_misses += fc.miss(indices[i]) ? 1 : 0;
+
+                f32 cluster_acmr = (f32)cluster_misses / (f32)(end - start);
+
+                fc.flush();
+
+                u32 soft_start = start;
+                u32 misses = 0;
+                for (u32 t = start; t < end; ++t)
+                {
+                    for (u32 k = 0; k < 3; ++k)
+                        misses += fc.miss(indices[t * 3 + k]) ? 1 : 0;
+
+                    f32 acmr = (f32)misses / (f32)(t - soft_start + 1);
+                    if (t + 1 < end && acmr <= cluster_acmr * threshold)
+                    {
+                        clusters.push_back({soft_start, t + 1 - soft_start, 0.0f});
+                        soft_start = t + 1;
+                        misses = 0;
+                        fc.flush();
+                    }
+                }
+
+                clusters.push_back({soft_start, end - soft_start, 0.0f});
+            }
+
+            // area weighted centroids and normals
+            vec3f              mesh_centroid = vec3f::zero();
+            f32                mesh_area = 0.0f;
+            std::vector<vec3f> centroids(clusters.size());
+            std::vector<vec3f> normals(clusters.size());
+
+            for (u32 c = 0; c < clusters.size(); ++c)
+            {
+                vec3f centroid = vec3f::zero();
+                vec3f normal = vec3f::zero();
+                f32   area = 0.0f;
+
+                for (u32 t = clusters[c].start; t < clusters[c].start + clusters[c].count; ++t)
+                {
+                    vec3f p0 = get_pos(positions, indices[t * 3 + 0]);
+                    vec3f p1 = get_pos(positions, indices[t * 3 + 1]);
+                    vec3f p2 = get_pos(positions, indices[t * 3 + 2]);
+
+                    vec3f n = cross(p1 - p0, p2 - p0);
+                    f32   a = mag(n);
+
+                    centroid += (p0 + p1 + p2) * (a / 3.0f);
+                    normal += n;
+                    area += a;
+                }
+
+                mesh_centroid += centroid;
+                mesh_area += area;
+
+                centroids[c] = area > 0.0f ? centroid / area : vec3f::zero();
+                normals[c] = normal;
+            }
+
+            if (mesh_area > 0.0f)
+                mesh_centroid /= mesh_area;
+
+            // clusters facing away from the centre are likely to occlude the rest, draw them first
+            for (u32 c = 0; c < clusters.size(); ++c)
+            {
+                f32 l = mag(normals[c]);
+                if (l > 0.0f)
+                    clusters[c].sort_key = dot(centroids[c] - mesh_centroid, normals[c] / l);
+            }
+
+            std::stable_sort(clusters.begin(), clusters.end(),
+                             [](const cluster& a, const cluster& b) { return a.sort_key > b.sort_key; });
+
+            std::vector<u32> out(num_tris * 3);
+            u32              pos = 0;
+            for (auto& c : clusters)
+            {
+                memcpy(&out[pos], &indices[c.start * 3], sizeof(u32) * c.count * 3);
+                pos += c.count * 3;
+            }
+
+            memcpy(indices, out.data(), sizeof(u32) * num_tris * 3);
+        }
+
+        u32 optimise_vertex_fetch_remap(u32* remap, const u32* indices, u32 num_indices, u32 num_vertices)
+        {
+            for (u32 v = 0; v < num_vertices; ++v)
+                remap[v] = (u32)-1;
+
+            u32 next = 0;
+            for (u32 i = 0; i < num_indices; ++i)
+            {
+                u32 v = indices[i];
+                if (remap[v] == (u32)-1)
+                    remap[v] = next++;
+            }
+
+            u32 referenced = next;
+
+            for (u32 v = 0; v < num_vertices; ++v)
+                if (remap[v] == (u32)-1)
+                    remap[v] = next++;
+
+            return referenced;
+        }
+
+        void analyse_vertex_cache(const u32* indices, u32 num_indices, u32 num_vertices, u32 cache_size, f32& acmr,
+                                  f32& atvr)
+        {
+            acmr = 0.0f;
+            atvr = 0.0f;
+
+            u32 num_tris = num_indices / 3;
+            if (num_tris == 0)
+                return;
+
+            fifo_cache      fc(num_vertices, cache_size);
+            std::vector<u8> used(num_vertices, 0);
+
+            u32 misses = 0;
+            u32 unique = 0;
+            for (u32 i = 0; i < num_tris * 3; ++i)
+            {
+                u32 v = indices[i];
+                misses += fc.miss(v) ? 1 : 0;
+
+                if (!used[v])
+                {
+                    used[v] = 1;
+                    unique++;
+                }
+            }
+
+            acmr = (f32)misses / (f32)num_tris;
+            atvr = (f32)misses / (f32)unique;
+        }
+
+        void optimise_geometry(geometry_resource* gr, const mesh_optimise_params& params)
+        {
+            if (!gr->cpu_index_buffer || !gr->cpu_vertex_buffer || !gr->cpu_position_buffer)
+                return;
+
+            u32 total = gr->num_indices;
+            if (gr->num_lods > 1)
+                total = gr->lods[gr->num_lods - 1].index_offset + gr->lods[gr->num_lods - 1].num_indices;
+
+            std::vector<u32> indices;
+            if (gr->index_type == PEN_FORMAT_R16_UINT)
+                read_indices<u16>(gr->cpu_index_buffer, total, indices);
+            else
+                read_indices<u32>(gr->cpu_index_buffer, total, indices);
+
+            mesh_optimise_stats& st = gr->optimise_stats;
+            analyse_vertex_cache(indices.data(), gr->num_indices, gr->num_vertices, params.analyse_cache_size,
+                                 st.acmr_before, st.atvr_before);
+
+            const vec4f* positions = (const vec4f*)gr->cpu_position_buffer;
+
+            // each level draws on its own so each is ordered on its own
+            u32 num_ranges = std::max<u32>(gr->num_lods, 1);
+            for (u32 l = 0; l < num_ranges; ++l)
+            {
+                u32 offset = gr->num_lods > 1 ? gr->lods[l].index_offset : 0;
+                u32 count = gr->num_lods > 1 ? gr->lods[l].num_indices : gr->num_indices;
+
+                optimise_vertex_cache(&indices[offset], count, gr->num_vertices);
+
+                if (params.overdraw)
+                    optimise_overdraw(&indices[offset], count, positions, gr->num_vertices, params.overdraw_threshold);
+            }
+
+            // lod 0 comes first in the index buffer so it decides the vertex order
+            std::vector<u32> remap(gr->num_vertices);
+            optimise_vertex_fetch_remap(remap.data(), indices.data(), total, gr->num_vertices);
+
+            for (auto& i : indices)
+                i = remap[i];
+
+            // cpu vertices keep the full format when the gpu buffer is packed
+            u32 vertex_stride = gr->vertex_size;
+            if (gr->vertex_format == VERTEX_FORMAT_PACKED)
+                vertex_stride = gr->p_skin ? sizeof(vertex_model_skinned) : sizeof(vertex_model);
+
+            u32 position_stride = sizeof(vertex_position);
+
+            u8* vertices = (u8*)pen::memory_alloc(vertex_stride * gr->num_vertices);
+            u8* pos = (u8*)pen::memory_alloc(position_stride * gr->num_vertices);
+
+            for (u32 v = 0; v < gr->num_vertices; ++v)
+            {
+                memcpy(vertices + remap[v] * vertex_stride, (u8*)gr->cpu_vertex_buffer + v * vertex_stride,
+                       vertex_stride);
+                memcpy(pos + remap[v] * position_stride, (u8*)gr->cpu_position_buffer + v * position_stride,
+                       position_stride);
+            }
+
+            pen::memory_free(gr->cpu_vertex_buffer);
+            pen::memory_free(gr->cpu_position_buffer);
+            gr->cpu_vertex_buffer = vertices;
+            gr->cpu_position_buffer = pos;
+
+            u32 index_size = gr->index_type == PEN_FORMAT_R16_UINT ? 2 : 4;
+            for (u32 i = 0; i < total; ++i)
+            {
+                if (index_size == 2)
+                    ((u16*)gr->cpu_index_buffer)[i] = (u16)indices[i];
+                else
+                    ((u32*)gr->cpu_index_buffer)[i] = indices[i];
+            }
+
+            analyse_vertex_cache(indices.data(), gr->num_indices, gr->num_vertices, params.analyse_cache_size,
+                                 st.acmr_after, st.atvr_after);
+
+            gr->optimised = true;
+
+            // gpu buffers made before optimising need the new order
+            recreate_buffer(gr->index_buffer, gr->cpu_index_buffer, total * index_size, PEN_BIND_INDEX_BUFFER);
+            recreate_buffer(gr->position_buffer, gr->cpu_position_buffer, position_stride * gr->num_vertices,
+                            PEN_BIND_VERTEX_BUFFER);
+
+            if (gr->vertex_format == VERTEX_FORMAT_PACKED)
+            {
+                gr->vertex_format = VERTEX_FORMAT_FULL;
+                gr->vertex_size = vertex_stride;
+                pack_geometry_vertices(gr);
+            }
+            else
+            {
+                recreate_buffer(gr->vertex_buffer, gr->cpu_vertex_buffer, vertex_stride * gr->num_vertices,
+                                PEN_BIND_VERTEX_BUFFER);
+            }
+
+            dev_console_log("[optimise] %s %i: acmr %.3f -> %.3f, atvr %.3f -> %.3f", gr->geometry_name.c_str(),
+                            gr->submesh_index, st.acmr_before, st.acmr_after, st.atvr_before, st.atvr_after);
+        }
+    } // namespace ecs
+} // namespace put
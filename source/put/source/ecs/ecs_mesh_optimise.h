@@ -0,0 +1,49 @@
+// ecs_mesh_optimise.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "ecs/ecs_scene.h"
+
+// Mesh optimisation for triangle lists.
+// Triangles are first reordered for the post transform vertex cache with Forsyth's linear speed algorithm, the
+// result is then cut into clusters where the cache restarts (or where the running miss ratio is already close to the
+// clusters own) and clusters are sorted so those facing out from the centre of the mesh draw first, which gets most
+// of the overdraw reduction of Sander et al. without moving far from the cache friendly order. Finally vertices are
+// renumbered in the order the indices first use them so vertex fetch walks memory forwards.
+// Each lod range is optimised on its own, vertex fetch order follows lod 0.
+
+namespace put
+{
+    namespace ecs
+    {
+        struct geometry_resource;
+
+        struct mesh_optimise_params
+        {
+            bool overdraw = true;            // sort clusters for overdraw after cache optimisation
+            f32  overdraw_threshold = 1.05f; // running acmr allowed over the clusters own at a split
+            u32  analyse_cache_size = 16;    // fifo size used for the acmr / atvr stats
+        };
+
+        // reorders triangles in place for the vertex cache
+        void optimise_vertex_cache(u32* indices, u32 num_indices, u32 num_vertices);
+
+        // reorders clusters of triangles in place, expects indices already optimised for the vertex cache
+        void optimise_overdraw(u32* indices, u32 num_indices, const vec4f* positions, u32 num_vertices,
+                               f32 threshold);
+
+        // writes the new index of each vertex into remap in first use order, unused vertices go last
+        // returns the number of referenced vertices
+        u32 optimise_vertex_fetch_remap(u32* remap, const u32* indices, u32 num_indices, u32 num_vertices);
+
+        // simulates a fifo cache of cache_size vertices
+        void analyse_vertex_cache(const u32* indices, u32 num_indices, u32 num_vertices, u32 cache_size, f32& acmr,
+                                  f32& atvr);
+
+        // reorders the cpu index, vertex and position copies and recreates any gpu buffers already made from them
+        // geometry_resource::optimise_stats receives the before and after acmr and atvr
+        void optimise_geometry(geometry_resource* gr, const mesh_optimise_params& params = mesh_optimise_params());
+    } // namespace ecs
+} // namespace put
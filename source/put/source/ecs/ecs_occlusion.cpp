@@ -0,0 +1,494 @@
+// ecs_occlusion.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "ecs/ecs_occlusion.h"
+#include "camera.h"
+#include "data_struct.h"
+#include "ecs/ecs_resources.h"
+#include "hash.h"
+#include "memory.h"
+#include "threads.h"
+#include "timer.h"
+
+#if PEN_SSE
+#include <emmintrin.h>
+#endif
+
+using namespace put;
+using namespace ecs;
+
+namespace
+{
+    template <typename T>
+    void reset_buffer(T* sb)
+    {
+        if (sb)
+            stb__sbn(sb) = 0;
+    }
+
+    geometry_resource* get_occluder_geometry(ecs_scene* scene, const occluder& occ)
+    {
+        u32 e = occ.entity;
+        if (e >= scene->num_entities || !(scene->entities[e] & CMP_ALLOCATED))
+            return nullptr;
+
+        if (scene->state_flags[e] & SF_HIDDEN)
+            return nullptr;
+
+        geometry_resource* gr = occ.proxy;
+        if (!gr && scene->entities[e] & CMP_GEOMETRY)
+            gr = get_geometry_resource(scene->id_geometry[e]);
+
+        if (!gr || !gr->cpu_position_buffer || !gr->cpu_index_buffer)
+            return nullptr;
+
+        return gr;
+    }
+
+    ecs_occlusion* create_occlusion()
+    {
+        ecs_occlusion* oc = new ecs_occlusion();
+
+        u32 w = OCCLUSION_BUFFER_WIDTH;
+        u32 h = OCCLUSION_BUFFER_HEIGHT;
+        for (u32 l = 0; l < OCCLUSION_MAX_LEVELS; ++l)
+        {
+            oc->levels[l] = (f32*)pen::memory_alloc(sizeof(f32) * w * h);
+            oc->level_width[l] = w;
+            oc->level_height[l] = h;
+            oc->num_levels++;
+
+            if (w == 1 && h == 1)
+                break;
+
+            w = std::max<u32>(w / 2, 1);
+            h = std::max<u32>(h / 2, 1);
+        }
+
+        return oc;
+    }
+
+    hash_id hash_occluders(ecs_scene* scene, ecs_occlusion* oc)
+    {
+        pen::hash_murmur hm;
+        hm.begin();
+        hm.add(&oc->view_proj, sizeof(mat4));
+
+        u32 num_occluders = sb_count(oc->occluders);
+        for (u32 i = 0; i < num_occluders; ++i)
+        {
+            const occluder& occ = oc->occluders[i];
+            geometry_resource* gr = get_occluder_geometry(scene, occ);
+            if (!gr)
+                continue;
+
+            hm.add(occ.entity);
+            hm.add(gr);
+            hm.add(&scene->world_matrices[occ.entity], sizeof(mat4));
+        }
+
+        return hm.end();
+    }
+
+    void setup_triangles(ecs_scene* scene, ecs_occlusion* oc)
+    {
+        // transform occluder vertices to clip space and build screen space triangles
+        reset_buffer(oc->tris);
+
+        const f32 w = (f32)OCCLUSION_BUFFER_WIDTH;
+        const f32 h = (f32)OCCLUSION_BUFFER_HEIGHT;
+
+        occlusion_stats& st = oc->stats;
+
+        u32 num_occluders = sb_count(oc->occluders);
+        for (u32 i = 0; i < num_occluders; ++i)
+        {
+            geometry_resource* gr = get_occluder_geometry(scene, oc->occluders[i]);
+            if (!gr)
+                continue;
+
+            st.num_occluders++;
+
+            mat4 wvp = oc->view_proj * scene->world_matrices[oc->occluders[i].entity];
+
+            reset_buffer(oc->clip_verts);
+            vec4f* positions = (vec4f*)gr->cpu_position_buffer;
+            for (u32 v = 0; v < gr->num_vertices; ++v)
+                sb_push(oc->clip_verts, wvp.transform_vector(vec4f(positions[v].xyz, 1.0f)));
+
+            for (u32 t = 0; t + 2 < gr->num_indices; t += 3)
+            {
+                st.num_triangles++;
+
+                u32 idx[3];
+                for (u32 j = 0; j < 3; ++j)
+                {
+                    if (gr->index_type == PEN_FORMAT_R32_UINT)
+                        idx[j] = ((u32*)gr->cpu_index_buffer)[t + j];
+                    else
+                        idx[j] = ((u16*)gr->cpu_index_buffer)[t + j];
+                }
+
+                // triangles crossing the near plane are dropped, missing occluders only makes culling less effective
+                occluder_tri tri;
+                bool         clipped = false;
+                f32          bmin[2] = {FLT_MAX, FLT_MAX};
+                f32          bmax[2] = {-FLT_MAX, -FLT_MAX};
+                for (u32 j = 0; j < 3; ++j)
+                {
+                    const vec4f& cv = oc->clip_verts[idx[j]];
+                    if (cv.w < oc->near_plane)
+                    {
+                        clipped = true;
+                        break;
+                    }
+
+                    f32 rcp_w = 1.0f / cv.w;
+                    tri.x[j] = (cv.x * rcp_w * 0.5f + 0.5f) * w;
+                    tri.y[j] = (0.5f - cv.y * rcp_w * 0.5f) * h;
+                    tri.z[j] = rcp_w;
+
+                    bmin[0] = std::min<f32>(bmin[0], tri.x[j]);
+                    bmin[1] = std::min<f32>(bmin[1], tri.y[j]);
+                    bmax[0] = std::max<f32>(bmax[0], tri.x[j]);
+                    bmax[1] = std::max<f32>(bmax[1], tri.y[j]);
+                }
+
+                if (clipped)
+                    continue;
+
+                // pixel centres at + 0.5
+                tri.min_x = std::max<s32>((s32)floor(bmin[0] - 0.5f) + 1, 0);
+                tri.min_y = std::max<s32>((s32)floor(bmin[1] - 0.5f) + 1, 0);
+                tri.max_x = std::min<s32>((s32)floor(bmax[0] - 0.5f), OCCLUSION_BUFFER_WIDTH - 1);
+                tri.max_y = std::min<s32>((s32)floor(bmax[1] - 0.5f), OCCLUSION_BUFFER_HEIGHT - 1);
+
+                if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+                    continue;
+
+                sb_push(oc->tris, tri);
+            }
+        }
+
+        st.rasterised = sb_count(oc->tris);
+    }
+
+    void raster_bands(u32 start, u32 end, void* user_data)
+    {
+        ecs_occlusion* oc = (ecs_occlusion*)user_data;
+        f32*           depth = oc->levels[0];
+
+        u32 num_tris = sb_count(oc->tris);
+        for (u32 b = start; b < end; ++b)
+        {
+            s32 band_min = b * OCCLUSION_BAND_HEIGHT;
+            s32 band_max = band_min + OCCLUSION_BAND_HEIGHT - 1;
+
+            f32* band = depth + band_min * OCCLUSION_BUFFER_WIDTH;
+            memset(band, 0x0, sizeof(f32) * OCCLUSION_BUFFER_WIDTH * OCCLUSION_BAND_HEIGHT);
+
+            for (u32 t = 0; t < num_tris; ++t)
+            {
+                const occluder_tri& tri = oc->tris[t];
+
+                s32 y0 = std::max<s32>(tri.min_y, band_min);
+                s32 y1 = std::min<s32>(tri.max_y, band_max);
+                if (y0 > y1)
+                    continue;
+
+                // edge functions, flipped so either winding is inside when positive
+                f32 area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+                if (fabs(area) < 1e-6f)
+                    continue;
+
+                f32 sign = area > 0.0f ? 1.0f : -1.0f;
+                f32 rcp_area = 1.0f / fabs(area);
+
+                f32 ea[3], eb[3], ec[3];
+                for (u32 i = 0; i < 3; ++i)
+                {
+                    u32 i0 = (i + 1) % 3;
+                    u32 i1 = (i + 2) % 3;
+
+                    // e(x, y) = ea * x + eb * y + ec, barycentric weight of vertex i
+                    ea[i] = sign * (tri.y[i0] - tri.y[i1]);
+                    eb[i] = sign * (tri.x[i1] - tri.x[i0]);
+                    ec[i] = sign * (tri.x[i0] * tri.y[i1] - tri.x[i1] * tri.y[i0]);
+                }
+
+                // 1 / w is affine in screen space
+                f32 za = 0.0f, zb = 0.0f, zc = 0.0f;
+                for (u32 i = 0; i < 3; ++i)
+                {
+                    za += ea[i] * tri.z[i] * rcp_area;
+                    zb += eb[i] * tri.z[i] * rcp_area;
+                    zc += ec[i] * tri.z[i] * rcp_area;
+                }
+
+                s32 x0 = tri.min_x & ~3;
+
+                for (s32 y = y0; y <= y1; ++y)
+                {
+                    f32  py = (f32)y + 0.5f;
+                    f32* row = depth + y * OCCLUSION_BUFFER_WIDTH;
+
+#if PEN_SSE
+                    __m128 step = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+                    __m128 e_a[3], e_row[3];
+                    for (u32 i = 0; i < 3; ++i)
+                    {
+                        e_a[i] = _mm_set1_ps(ea[i]);
+                        e_row[i] = _mm_set1_ps(eb[i] * py + ec[i]);
+                    }
+
+                    __m128 z_a = _mm_set1_ps(za);
+                    __m128 z_row = _mm_set1_ps(zb * py + zc);
+                    __m128 zero = _mm_setzero_ps();
+
+                    for (s32 x = x0; x <= tri.max_x; x += 4)
+                    {
+                        __m128 px = _mm_add_ps(_mm_set1_ps((f32)x), step);
+
+                        __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e_a[0], px), e_row[0]), zero);
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e_a[1], px), e_row[1]), zero));
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e_a[2], px), e_row[2]), zero));
+
+                        if (_mm_movemask_ps(inside) == 0)
+                            continue;
+
+                        __m128 z = _mm_add_ps(_mm_mul_ps(z_a, px), z_row);
+                        __m128 prev = _mm_loadu_ps(row + x);
+                        __m128 nearest = _mm_max_ps(prev, z);
+
+                        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, prev)));
+                    }
+#else
+                    for (s32 x = tri.min_x; x <= tri.max_x; ++x)
+                    {
+                        f32 px = (f32)x + 0.5f;
+
+                        bool inside = true;
+                        for (u32 i = 0; i < 3; ++i)
+                            inside &= ea[i] * px + eb[i] * py + ec[i] >= 0.0f;
+
+                        if (!inside)
+                            continue;
+
+                        row[x] = std::max<f32>(row[x], za * px + zb * py + zc);
+                    }
+#endif
+                }
+            }
+        }
+    }
+
+    void build_pyramid(ecs_occlusion* oc)
+    {
+        for (u32 l = 1; l < oc->num_levels; ++l)
+        {
+            const f32* src = oc->levels[l - 1];
+            f32*       dst = oc->levels[l];
+
+            u32 sw = oc->level_width[l - 1];
+            u32 sh = oc->level_height[l - 1];
+            u32 dw = oc->level_width[l];
+            u32 dh = oc->level_height[l];
+
+            for (u32 y = 0; y < dh; ++y)
+            {
+                u32 y0 = std::min<u32>(y * 2, sh - 1);
+                u32 y1 = std::min<u32>(y * 2 + 1, sh - 1);
+
+                for (u32 x = 0; x < dw; ++x)
+                {
+                    u32 x0 = std::min<u32>(x * 2, sw - 1);
+                    u32 x1 = std::min<u32>(x * 2 + 1, sw - 1);
+
+                    f32 a = std::min<f32>(src[y0 * sw + x0], src[y0 * sw + x1]);
+                    f32 b = std::min<f32>(src[y1 * sw + x0], src[y1 * sw + x1]);
+                    dst[y * dw + x] = std::min<f32>(a, b);
+                }
+            }
+        }
+    }
+} // namespace
+
+namespace put
+{
+    namespace ecs
+    {
+        void add_occluder(ecs_scene* scene, u32 entity, geometry_resource* proxy)
+        {
+            if (!scene->occlusion)
+                scene->occlusion = create_occlusion();
+
+            ecs_occlusion* oc = scene->occlusion;
+
+            u32 num_occluders = sb_count(oc->occluders);
+            for (u32 i = 0; i < num_occluders; ++i)
+            {
+                if (oc->occluders[i].entity == entity)
+                {
+                    oc->occluders[i].proxy = proxy;
+                    oc->occluder_hash = 0;
+                    return;
+                }
+            }
+
+            occluder occ;
+            occ.entity = entity;
+            occ.proxy = proxy;
+            sb_push(oc->occluders, occ);
+
+            oc->occluder_hash = 0;
+        }
+
+        void remove_occluder(ecs_scene* scene, u32 entity)
+        {
+            ecs_occlusion* oc = scene->occlusion;
+            if (!oc)
+                return;
+
+            u32 num_occluders = sb_count(oc->occluders);
+            for (u32 i = 0; i < num_occluders; ++i)
+            {
+                if (oc->occluders[i].entity != entity)
+                    continue;
+
+                oc->occluders[i] = oc->occluders[num_occluders - 1];
+                stb__sbn(oc->occluders)--;
+                oc->occluder_hash = 0;
+                return;
+            }
+        }
+
+        void update_occlusion(ecs_scene* scene, camera* cam)
+        {
+            ecs_occlusion* oc = scene->occlusion;
+            if (!oc)
+                return;
+
+            // only perspective cameras, orthographic views and shadows are not culled
+            if (cam->flags & CF_ORTHO)
+            {
+                oc->valid = false;
+                return;
+            }
+
+            oc->view_proj = cam->proj * cam->view;
+            oc->near_plane = cam->near_plane;
+
+            // test counts are per view, raster stats are kept from the last time the buffer was rebuilt
+            oc->stats.num_tested = 0;
+            oc->stats.num_occluded = 0;
+
+            hash_id h = hash_occluders(scene, oc);
+            if (oc->valid && h == oc->occluder_hash)
+                return;
+
+            static pen::timer* timer = pen::timer_create();
+            pen::timer_start(timer);
+
+            oc->stats = occlusion_stats();
+            oc->occluder_hash = h;
+
+            setup_triangles(scene, oc);
+            pen::jobs_parallel_for(OCCLUSION_NUM_BANDS, 1, raster_bands, oc);
+            build_pyramid(oc);
+
+            oc->valid = true;
+            oc->stats.raster_ms = pen::timer_elapsed_ms(timer);
+        }
+
+        bool is_occluded(ecs_scene* scene, const vec3f& min, const vec3f& max)
+        {
+            ecs_occlusion* oc = scene->occlusion;
+            if (!oc || !oc->valid)
+                return false;
+
+            oc->stats.num_tested++;
+
+            const f32 w = (f32)OCCLUSION_BUFFER_WIDTH;
+            const f32 h = (f32)OCCLUSION_BUFFER_HEIGHT;
+
+            // screen rect and nearest depth of the box
+            f32 smin[2] = {FLT_MAX, FLT_MAX};
+            f32 smax[2] = {-FLT_MAX, -FLT_MAX};
+            f32 nearest = 0.0f;
+            for (u32 i = 0; i < 8; ++i)
+            {
+                vec4f corner = vec4f(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1.0f);
+                vec4f cv = oc->view_proj.transform_vector(corner);
+
+                if (cv.w < oc->near_plane)
+                    return false;
+
+                f32 rcp_w = 1.0f / cv.w;
+                f32 sx = (cv.x * rcp_w * 0.5f + 0.5f) * w;
+                f32 sy = (0.5f - cv.y * rcp_w * 0.5f) * h;
+
+                smin[0] = std::min<f32>(smin[0], sx);
+                smin[1] = std::min<f32>(smin[1], sy);
+                smax[0] = std::max<f32>(smax[0], sx);
+                smax[1] = std::max<f32>(smax[1], sy);
+                nearest = std::max<f32>(nearest, rcp_w);
+            }
+
+            s32 x0 = std::max<s32>((s32)floor(smin[0]), 0);
+            s32 y0 = std::max<s32>((s32)floor(smin[1]), 0);
+            s32 x1 = std::min<s32>((s32)floor(smax[0]), OCCLUSION_BUFFER_WIDTH - 1);
+            s32 y1 = std::min<s32>((s32)floor(smax[1]), OCCLUSION_BUFFER_HEIGHT - 1);
+
+            // off screen is left to the frustum cull
+            if (x0 > x1 || y0 > y1)
+                return false;
+
+            // level where the rect spans at most 2 texels on its longest side, which touches up to 3x3
+            u32 level = 0;
+            s32 size = std::max<s32>(x1 - x0, y1 - y0);
+            while (size > 1 && level + 1 < oc->num_levels)
+            {
+                size >>= 1;
+                ++level;
+            }
+
+            x0 >>= level;
+            y0 >>= level;
+            x1 >>= level;
+            y1 >>= level;
+
+            const f32* depth = oc->levels[level];
+            u32        lw = oc->level_width[level];
+            for (s32 y = y0; y <= y1; ++y)
+            {
+                for (s32 x = x0; x <= x1; ++x)
+                {
+                    // something here is farther than the box, or there is no occluder at all
+                    if (depth[y * lw + x] <= nearest)
+                        return false;
+                }
+            }
+
+            oc->stats.num_occluded++;
+            return true;
+        }
+
+        void release_occlusion(ecs_scene* scene)
+        {
+            ecs_occlusion* oc = scene->occlusion;
+            if (!oc)
+                return;
+
+            for (u32 l = 0; l < oc->num_levels; ++l)
+                pen::memory_free(oc->levels[l]);
+
+            sb_free(oc->occluders);
+            sb_free(oc->clip_verts);
+            sb_free(oc->tris);
+
+            delete oc;
+            scene->occlusion = nullptr;
+        }
+    } // namespace ecs
+} // namespace put
@@ -0,0 +1,89 @@
+// ecs_occlusion.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "ecs/ecs_scene.h"
+
+// Software occlusion culling.
+// Occluder meshes (low poly proxies or the entity's own geometry) are transformed with the view camera and
+// rasterised on the cpu into a small 1 / w depth buffer, split into horizontal bands across worker threads.
+// A hi-z pyramid keeping the farthest depth of each texel is built from it and candidate bounding boxes are tested
+// against the level where their screen rect covers no more than a few texels.
+// There are no renderer calls here so culling can be driven and measured without a gpu.
+
+namespace put
+{
+    struct camera;
+
+    namespace ecs
+    {
+        struct geometry_resource;
+
+        enum e_occlusion_constants
+        {
+            OCCLUSION_BUFFER_WIDTH = 256,
+            OCCLUSION_BUFFER_HEIGHT = 128,
+            OCCLUSION_BAND_HEIGHT = 16,
+            OCCLUSION_NUM_BANDS = OCCLUSION_BUFFER_HEIGHT / OCCLUSION_BAND_HEIGHT,
+            OCCLUSION_MAX_LEVELS = 8
+        };
+
+        struct occluder
+        {
+            u32                entity;
+            geometry_resource* proxy; // null uses the entity's geometry
+        };
+
+        struct occluder_tri
+        {
+            f32 x[3];
+            f32 y[3];
+            f32 z[3]; // 1 / w
+            s32 min_x, max_x;
+            s32 min_y, max_y;
+        };
+
+        struct occlusion_stats
+        {
+            u32 num_occluders = 0;
+            u32 num_triangles = 0; // occluder triangles considered
+            u32 rasterised = 0;    // triangles on screen and in front of the near plane
+            u32 num_tested = 0;
+            u32 num_occluded = 0;
+            f32 raster_ms = 0.0f; // transform, raster and pyramid
+        };
+
+        struct ecs_occlusion
+        {
+            occluder*     occluders = nullptr;
+            vec4f*        clip_verts = nullptr;
+            occluder_tri* tris = nullptr;
+
+            // level 0 is the depth buffer, each level keeps the min 1 / w (farthest) of 2x2 texels from the level above
+            f32* levels[OCCLUSION_MAX_LEVELS] = {nullptr};
+            u32  level_width[OCCLUSION_MAX_LEVELS];
+            u32  level_height[OCCLUSION_MAX_LEVELS];
+            u32  num_levels = 0;
+
+            mat4    view_proj;
+            f32     near_plane = 0.0f;
+            hash_id occluder_hash = 0; // view proj and occluder transforms the buffer was rasterised with
+            bool    valid = false;
+
+            occlusion_stats stats;
+        };
+
+        void add_occluder(ecs_scene* scene, u32 entity, geometry_resource* proxy = nullptr);
+        void remove_occluder(ecs_scene* scene, u32 entity);
+
+        // rasterises occluders for the camera, skipped if neither the camera or the occluders have moved
+        void update_occlusion(ecs_scene* scene, camera* cam);
+
+        // world space aabb against the last update, conservative.. anything crossing the near plane is visible
+        bool is_occluded(ecs_scene* scene, const vec3f& min, const vec3f& max);
+
+        void release_occlusion(ecs_scene* scene);
+    } // namespace ecs
+} // namespace put
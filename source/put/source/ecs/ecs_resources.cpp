@@ -7,8 +7,12 @@
 #include "file_system.h"
 #include "hash.h"
 #include "pen_string.h"
+#include "sparse_volume.h"
 #include "str_utilities.h"
+#include "timer.h"
 
+#include "ecs/ecs_lod.h"
+#include "ecs/ecs_mesh_optimise.h"
 #include "ecs/ecs_resources.h"
 #include "ecs/ecs_utilities.h"
 
@@ -208,7 +212,12 @@ namespace put
             instance->num_vertices = gr->num_vertices;
             instance->index_type = gr->index_type;
             instance->vertex_size = gr->vertex_size;
+            instance->vertex_format = gr->vertex_format;
             instance->p_skin = gr->p_skin;
+            instance->lods = gr->lods;
+            instance->num_lods = gr->num_lods;
+            instance->lod = 0;
+            instance->lod_screen_size = -1.0f;
 
             cmp_bounding_volume* bv = &scene->bounding_volumes[node_index];
 
@@ -295,6 +304,13 @@ namespace put
             cmp_geometry& geom = scene->geometries[node_index];
             cmp_pre_skin& pre_skin = scene->pre_skin[node_index];
 
+            // the stream out shader reads the full skinned format
+            if (geom.vertex_format == VERTEX_FORMAT_PACKED)
+            {
+                dev_console_log("[error] can't pre skin %s, it has packed vertices", scene->names[node_index].c_str());
+                return;
+            }
+
             u32 num_verts = geom.num_vertices;
 
             // stream out / transform feedback vertex buffer
@@ -383,6 +399,24 @@ namespace put
                     }
                 }
 
+                // flag leaf joints so they can be skipped by lower anim lods
+                u32 num_joints = sb_count(controller.joint_indices);
+                for (u32 j = 0; j < num_joints; ++j)
+                {
+                    u8 flags = anim_joint_flags::LEAF;
+
+                    for (u32 k = 0; k < num_joints; ++k)
+                    {
+                        if (k != j && scene->parents[controller.joint_indices[k]] == controller.joint_indices[j])
+                        {
+                            flags = 0;
+                            break;
+                        }
+                    }
+
+                    sb_push(controller.joint_flags, flags);
+                }
+
                 scene->entities[node_index] |= CMP_ANIM_CONTROLLER;
             }
         }
@@ -502,7 +536,142 @@ namespace put
             scene->area_light_resources[node_index] = alr;
         }
 
-        void load_geometry_resource(const c8* filename, const c8* geometry_name, const c8* data)
+        static geometry_load_stats s_geometry_load_stats;
+
+        const geometry_load_stats& get_geometry_load_stats()
+        {
+            return s_geometry_load_stats;
+        }
+
+        namespace
+        {
+            s16 pack_snorm16(f32 v)
+            {
+                v = std::max<f32>(std::min<f32>(v, 1.0f), -1.0f);
+                return (s16)(v * 32767.0f + (v >= 0.0f ? 0.5f : -0.5f));
+            }
+
+            // maps the unit sphere onto the [-1, 1] square, the lower hemisphere is folded over the diagonals
+            vec2f oct_encode(const vec3f& v, const vec3f& fallback)
+            {
+                f32   l1 = fabs(v.x) + fabs(v.y) + fabs(v.z);
+                vec3f n = l1 > 0.0f ? v / l1 : fallback;
+
+                if (n.z >= 0.0f)
+                    return vec2f(n.x, n.y);
+
+                return vec2f((1.0f - fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                             (1.0f - fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+            }
+
+            void pack_tbn(const vertex_model& v, s16* tbn)
+            {
+                vec3f n = vec3f(v.normal.x, v.normal.y, v.normal.z);
+                vec3f t = vec3f(v.tangent.x, v.tangent.y, v.tangent.z);
+                vec3f b = vec3f(v.bitangent.x, v.bitangent.y, v.bitangent.z);
+
+                vec2f on = oct_encode(n, vec3f(0.0f, 0.0f, 1.0f));
+                vec2f ot = oct_encode(t, vec3f(1.0f, 0.0f, 0.0f));
+
+                // shaders rebuild the bitangent as cross(n, t) * sign, keep w away from 0 so the sign survives
+                f32 sign = dot(cross(n, t), b) < 0.0f ? -1.0f : 1.0f;
+                f32 ty = std::max<f32>(ot.y * 0.5f + 0.5f, 1.0f / 32767.0f);
+
+                tbn[0] = pack_snorm16(on.x);
+                tbn[1] = pack_snorm16(on.y);
+                tbn[2] = pack_snorm16(ot.x);
+                tbn[3] = pack_snorm16(ty * sign);
+            }
+
+            void pack_blend(const vertex_model_skinned& v, u8* indices, u8* weights)
+            {
+                // blend data is written as floats by the pipeline
+                f32 fi[4];
+                f32 fw[4];
+                memcpy(fi, &v.blend_indices, sizeof(fi));
+                memcpy(fw, &v.blend_weights, sizeof(fw));
+
+                s32 total = 0;
+                u32 largest = 0;
+                for (u32 i = 0; i < 4; ++i)
+                {
+                    indices[i] = (u8)std::min<f32>(std::max<f32>(fi[i], 0.0f), 255.0f);
+                    weights[i] = (u8)(std::min<f32>(std::max<f32>(fw[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+                    total += weights[i];
+
+                    if (fw[i] > fw[largest])
+                        largest = i;
+                }
+
+                // rounding error goes to the strongest influence so the weights still sum to 1
+                if (total > 0)
+                    weights[largest] = (u8)std::min<s32>(std::max<s32>(weights[largest] + 255 - total, 0), 255);
+            }
+        } // namespace
+
+        void pack_geometry_vertices(geometry_resource* gr)
+        {
+            if (gr->vertex_format == VERTEX_FORMAT_PACKED || !gr->cpu_vertex_buffer)
+                return;
+
+            bool skinned = gr->p_skin != nullptr;
+            u32  src_size = skinned ? sizeof(vertex_model_skinned) : sizeof(vertex_model);
+            u32  dst_size = skinned ? sizeof(vertex_model_skinned_packed) : sizeof(vertex_model_packed);
+
+            // only the model formats have a packed equivalent
+            if (gr->vertex_size != src_size)
+                return;
+
+            f32 start_ms = pen::get_time_ms();
+
+            const u8* src = (const u8*)gr->cpu_vertex_buffer;
+            u8*       dst = (u8*)pen::memory_alloc(dst_size * gr->num_vertices);
+
+            for (u32 i = 0; i < gr->num_vertices; ++i)
+            {
+                const vertex_model&  v = *(const vertex_model*)(src + i * src_size);
+                vertex_model_packed& pv = *(vertex_model_packed*)(dst + i * dst_size);
+
+                pv.pos[0] = v.pos.x;
+                pv.pos[1] = v.pos.y;
+                pv.pos[2] = v.pos.z;
+
+                pack_tbn(v, pv.tbn);
+
+                pv.uv12[0] = float_to_half(v.uv12.x);
+                pv.uv12[1] = float_to_half(v.uv12.y);
+                pv.uv12[2] = float_to_half(v.uv12.z);
+                pv.uv12[3] = float_to_half(v.uv12.w);
+
+                if (skinned)
+                {
+                    const vertex_model_skinned&  sv = *(const vertex_model_skinned*)(src + i * src_size);
+                    vertex_model_skinned_packed& spv = *(vertex_model_skinned_packed*)(dst + i * dst_size);
+                    pack_blend(sv, spv.blend_indices, spv.blend_weights);
+                }
+            }
+
+            pen::buffer_creation_params bcp;
+            bcp.usage_flags = PEN_USAGE_DEFAULT;
+            bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
+            bcp.cpu_access_flags = 0;
+            bcp.buffer_size = dst_size * gr->num_vertices;
+            bcp.data = (void*)dst;
+
+            if (is_valid(gr->vertex_buffer))
+                pen::renderer_release_buffer(gr->vertex_buffer);
+
+            gr->vertex_buffer = pen::renderer_create_buffer(bcp);
+            gr->vertex_size = dst_size;
+            gr->vertex_format = VERTEX_FORMAT_PACKED;
+
+            pen::memory_free(dst);
+
+            s_geometry_load_stats.num_packed++;
+            s_geometry_load_stats.pack_ms += pen::get_time_ms() - start_ms;
+        }
+
+        void load_geometry_resource(const c8* filename, const c8* geometry_name, const c8* data, u32 load_flags)
         {
             // generate hash
             pen::hash_murmur hm;
@@ -516,6 +685,8 @@ namespace put
                 if (geom_hash == s_geometry_resources[g]->geom_hash)
                     return;
 
+            f32 start_ms = pen::get_time_ms();
+
             u32* p_reader = (u32*)data;
             u32  version = *p_reader++;
             u32  num_meshes = *p_reader++;
@@ -583,17 +754,17 @@ namespace put
                     p_geometry->p_skin->bind_shape_matrix = final_bind;
 
                     u32 num_ijb_floats = *p_reader++;
-                    memcpy(&p_geometry->p_skin->joint_bind_matrices[0], p_reader, sizeof(f32) * num_ijb_floats);
-                    p_reader += num_ijb_floats;
+                    u32 num_joints = num_ijb_floats / 16;
 
-                    p_geometry->p_skin->num_joints = num_ijb_floats / 16;
+                    if (num_joints > MAX_SKIN_JOINTS)
+                        dev_console_log_level(dev_ui::CONSOLE_ERROR, "[error] %s has %i joints, max per draw is %i",
+                                              filename, num_joints, MAX_SKIN_JOINTS);
 
-                    for (u32 joint = 0; joint < p_geometry->p_skin->num_joints; ++joint)
-                    {
-                        p_geometry->p_skin->joint_bind_matrices[joint] = p_geometry->p_skin->joint_bind_matrices[joint];
-                    }
+                    p_geometry->p_skin->num_joints = std::min<u32>(num_joints, MAX_SKIN_JOINTS);
+                    p_geometry->p_skin->joint_bind_matrices = (mat4*)pen::memory_alloc(sizeof(mat4) * num_joints);
 
-                    p_geometry->p_skin->bone_cbuffer = PEN_INVALID_HANDLE;
+                    memcpy(p_geometry->p_skin->joint_bind_matrices, p_reader, sizeof(f32) * num_ijb_floats);
+                    p_reader += num_ijb_floats;
                 }
 
                 p_geometry->vertex_size = vertex_size;
@@ -604,16 +775,10 @@ namespace put
 
                 p_geometry->num_vertices = num_verts;
 
-                pen::buffer_creation_params bcp;
-                bcp.usage_flags = PEN_USAGE_DEFAULT;
-                bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
-                bcp.cpu_access_flags = 0;
-                bcp.buffer_size = sizeof(vertex_position) * num_pos_verts;
-                bcp.data = (void*)p_reader;
-
-                // keep a cpu copy of position data
-                p_geometry->cpu_position_buffer = pen::memory_alloc(bcp.buffer_size);
-                memcpy(p_geometry->cpu_position_buffer, bcp.data, bcp.buffer_size);
+                // keep a cpu copy of position data, gpu buffers are created once indices are final
+                u32 position_bytes = sizeof(vertex_position) * num_pos_verts;
+                p_geometry->cpu_position_buffer = pen::memory_alloc(position_bytes);
+                memcpy(p_geometry->cpu_position_buffer, p_reader, position_bytes);
 
                 if (p_geometry->min_extents.x == -1.0f)
                 {
@@ -624,40 +789,116 @@ namespace put
                     }
                 }
 
-                p_geometry->position_buffer = pen::renderer_create_buffer(bcp);
+                p_reader += position_bytes / sizeof(f32);
 
-                p_reader += bcp.buffer_size / sizeof(f32);
+                u32 vertex_bytes = vertex_size * num_verts;
+                p_geometry->cpu_vertex_buffer = pen::memory_alloc(vertex_bytes);
+                memcpy(p_geometry->cpu_vertex_buffer, p_reader, vertex_bytes);
 
-                bcp.buffer_size = vertex_size * num_verts;
-                bcp.data = (void*)p_reader;
+                p_geometry->position_buffer = PEN_INVALID_HANDLE;
+                p_geometry->vertex_buffer = PEN_INVALID_HANDLE;
 
-                p_geometry->cpu_vertex_buffer = pen::memory_alloc(bcp.buffer_size);
-                memcpy(p_geometry->cpu_vertex_buffer, bcp.data, bcp.buffer_size);
+                p_reader += vertex_bytes / sizeof(u32);
+
+                p_geometry->num_indices = num_indices;
+                p_geometry->index_type = index_size == 2 ? PEN_FORMAT_R16_UINT : PEN_FORMAT_R32_UINT;
+                p_geometry->index_buffer = PEN_INVALID_HANDLE;
 
-                p_geometry->vertex_buffer = pen::renderer_create_buffer(bcp);
+                const c8* p_indices = (const c8*)p_reader;
+                p_reader = (u32*)((c8*)p_reader + index_size * num_indices);
 
-                p_reader += bcp.buffer_size / sizeof(u32);
+                p_reader += num_collision_floats;
 
+                // version 2 adds lod chains, each level is an index count, error and indices into the same vertices
+                u32 num_lods = 0;
+                u32 num_lod_indices = 0;
+                const u32* p_lods = p_reader;
+                if (version >= 2)
+                {
+                    num_lods = std::min<u32>(*p_reader++, MAX_GEOMETRY_LODS - 1);
+                    for (u32 l = 0; l < num_lods; ++l)
+                    {
+                        u32 count = *p_reader++;
+                        p_reader++;
+                        p_reader = (u32*)((c8*)p_reader + index_size * count);
+                        num_lod_indices += count;
+                    }
+                }
+
+                // keep a cpu copy of index data, lods follow the full mesh
+                p_geometry->cpu_index_buffer = pen::memory_alloc(index_size * (num_indices + num_lod_indices));
+                memcpy(p_geometry->cpu_index_buffer, p_indices, index_size * num_indices);
+
+                if (version >= 2)
+                {
+                    p_geometry->num_lods = num_lods + 1;
+                    p_geometry->lods[0] = {0, num_indices, 0.0f};
+
+                    const u32* p_lod = p_lods + 1;
+                    u32        offset = num_indices;
+                    for (u32 l = 1; l <= num_lods; ++l)
+                    {
+                        u32 count = *p_lod++;
+                        f32 error = *(f32*)p_lod++;
+
+                        memcpy((c8*)p_geometry->cpu_index_buffer + offset * index_size, p_lod, index_size * count);
+                        p_geometry->lods[l] = {offset, count, error};
+
+                        p_lod = (u32*)((c8*)p_lod + index_size * count);
+                        offset += count;
+                    }
+                }
+
+                // older files have no lods.. simplify here when asked, creates the index buffer
+                if (version < 2 && (load_flags & PMM_GENERATE_LODS))
+                    generate_geometry_lods(p_geometry);
+
+                if ((load_flags & PMM_OPTIMISE_MESHES) && num_pos_verts == num_verts)
+                {
+                    f32 optimise_start_ms = pen::get_time_ms();
+                    optimise_geometry(p_geometry);
+
+                    s_geometry_load_stats.num_optimised++;
+                    s_geometry_load_stats.optimise_ms += pen::get_time_ms() - optimise_start_ms;
+                }
+
+                pen::buffer_creation_params bcp;
                 bcp.usage_flags = PEN_USAGE_DEFAULT;
-                bcp.bind_flags = PEN_BIND_INDEX_BUFFER;
+                bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
                 bcp.cpu_access_flags = 0;
-                bcp.buffer_size = index_size * num_indices;
-                bcp.data = (void*)p_reader;
+                bcp.buffer_size = position_bytes;
+                bcp.data = p_geometry->cpu_position_buffer;
 
-                p_geometry->num_indices = num_indices;
-                p_geometry->index_type = index_size == 2 ? PEN_FORMAT_R16_UINT : PEN_FORMAT_R32_UINT;
-                p_geometry->index_buffer = pen::renderer_create_buffer(bcp);
+                p_geometry->position_buffer = pen::renderer_create_buffer(bcp);
 
-                // keep a cpu copy of index data
-                p_geometry->cpu_index_buffer = pen::memory_alloc(bcp.buffer_size);
-                memcpy(p_geometry->cpu_index_buffer, bcp.data, bcp.buffer_size);
+                if (load_flags & PMM_PACKED_VERTICES)
+                    pack_geometry_vertices(p_geometry);
 
-                p_reader = (u32*)((c8*)p_reader + bcp.buffer_size);
+                if (!is_valid(p_geometry->vertex_buffer))
+                {
+                    bcp.buffer_size = vertex_bytes;
+                    bcp.data = p_geometry->cpu_vertex_buffer;
 
-                p_reader += num_collision_floats;
+                    p_geometry->vertex_buffer = pen::renderer_create_buffer(bcp);
+                }
+
+                if (!is_valid(p_geometry->index_buffer))
+                {
+                    bcp.bind_flags = PEN_BIND_INDEX_BUFFER;
+                    bcp.buffer_size = index_size * (num_indices + num_lod_indices);
+                    bcp.data = p_geometry->cpu_index_buffer;
+
+                    p_geometry->index_buffer = pen::renderer_create_buffer(bcp);
+                }
+
+                s_geometry_load_stats.num_geometries++;
+                s_geometry_load_stats.full_vertex_bytes += vertex_bytes;
+                s_geometry_load_stats.vertex_bytes += p_geometry->vertex_size * num_verts;
 
                 s_geometry_resources.push_back(p_geometry);
             }
+
+            s_geometry_load_stats.load_ms += pen::get_time_ms() - start_ms;
         }
 
         material_resource* get_material_resource(hash_id hash)
@@ -712,6 +953,32 @@ namespace put
                 permutation |= PERMUTATION_INSTANCED;
         }
 
+        void use_full_vertex_format(ecs_scene* scene, u32 node_index)
+        {
+            cmp_geometry&      geom = scene->geometries[node_index];
+            geometry_resource* gr = get_geometry_resource(scene->id_geometry[node_index]);
+            if (!gr || !gr->cpu_vertex_buffer)
+                return;
+
+            u32 full_size = gr->p_skin ? sizeof(vertex_model_skinned) : sizeof(vertex_model);
+
+            if (!is_valid(gr->full_vertex_buffer))
+            {
+                pen::buffer_creation_params bcp;
+                bcp.usage_flags = PEN_USAGE_DEFAULT;
+                bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
+                bcp.cpu_access_flags = 0;
+                bcp.buffer_size = full_size * gr->num_vertices;
+                bcp.data = gr->cpu_vertex_buffer;
+
+                gr->full_vertex_buffer = pen::renderer_create_buffer(bcp);
+            }
+
+            geom.vertex_buffer = gr->full_vertex_buffer;
+            geom.vertex_size = full_size;
+            geom.vertex_format = VERTEX_FORMAT_FULL;
+        }
+
         void bake_material_handles(ecs_scene* scene, u32 node_index)
         {
             material_resource* resource = &scene->material_resources[node_index];
@@ -731,6 +998,26 @@ namespace put
             // permutation form geom
             permutation_flags_from_vertex_class(permutation, geometry->vertex_shader_class);
 
+            permutation &= ~PERMUTATION_PACKED;
+            if (geometry->vertex_format == VERTEX_FORMAT_PACKED)
+            {
+                // the permutation is masked away when the technique has no PACKED variant, the full input layout would
+                // then be bound to packed vertices.. so draw this entity from a full format copy instead
+                u32 full = pmfx::get_technique_index_perm(material->shader, resource->id_technique, permutation);
+                u32 packed = pmfx::get_technique_index_perm(material->shader, resource->id_technique,
+                                                            permutation | PERMUTATION_PACKED);
+                if (full == packed)
+                {
+                    dev_console_log_level(dev_ui::CONSOLE_WARNING, "[warning] %s: technique has no packed permutation",
+                                          scene->names[node_index].c_str());
+                    use_full_vertex_format(scene, node_index);
+                }
+                else
+                {
+                    permutation |= PERMUTATION_PACKED;
+                }
+            }
+
             // technique / permutation
             material->technique_index = pmfx::get_technique_index_perm(material->shader, resource->id_technique, permutation);
             PEN_ASSERT(is_valid(material->technique_index));
@@ -1274,7 +1561,7 @@ namespace put
                 for (u32 g = 0; g < num_geom; ++g)
                 {
                     u32* p_geom_data = (u32*)(p_data_start + geom_offsets[g]);
-                    load_geometry_resource(filename, geometry_names[g].c_str(), (const c8*)p_geom_data);
+                    load_geometry_resource(filename, geometry_names[g].c_str(), (const c8*)p_geom_data, load_flags);
                 }
             }
 
@@ -1581,8 +1868,32 @@ namespace put
         {
             pen::json pmv = pen::json::load_from_file(filename);
 
-            Str volume_texture_filename = pmv["filename"].as_str();
-            u32 volume_texture = put::load_texture(volume_texture_filename.c_str());
+            u32 volume_texture = PEN_INVALID_HANDLE;
+
+            Str bricks_filename = pmv["bricks"].as_filename();
+            if (bricks_filename.length() > 0)
+            {
+                // sparse bricks expand to a dense copy only for the upload
+                sparse::volume bricks;
+                if (!sparse::load(bricks_filename.c_str(), bricks))
+                {
+                    dev_console_log_level(dev_ui::CONSOLE_ERROR, "[error] failed to load volume bricks %s",
+                                          bricks_filename.c_str());
+                    return PEN_INVALID_HANDLE;
+                }
+
+                pen::texture_creation_params tcp;
+                sparse::decode(bricks, tcp);
+                sparse::release(bricks);
+
+                volume_texture = pen::renderer_create_texture(tcp);
+                pen::memory_free(tcp.data);
+            }
+            else
+            {
+                Str volume_texture_filename = pmv["filename"].as_str();
+                volume_texture = put::load_texture(volume_texture_filename.c_str());
+            }
 
             vec3f scale = vec3f(pmv["scale_x"].as_f32(), pmv["scale_y"].as_f32(), pmv["scale_z"].as_f32());
 
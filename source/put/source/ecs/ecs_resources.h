@@ -11,6 +11,8 @@ namespace put
     namespace ecs
     {
         // anim v2
+        struct compressed_anim;
+
         struct anim_info
         {
             f32 time;
@@ -51,6 +53,7 @@ namespace put
             u32 pos;
             u32 joint;
             u32 flags;
+            u32 track_pos[3]; // cached keys for compressed tracks
 
             f32 cur_t;
             f32 prev_t;
@@ -65,15 +68,16 @@ namespace put
 
         struct anim_instance
         {
-            u32            flags = 0;
-            soa_anim       soa;
-            f32            time = 0.0f;
-            f32            length = 0.0f; // length in time
-            anim_target*   targets = nullptr;
-            cmp_transform* joints = nullptr;
-            anim_sampler*  samplers = nullptr;
-            vec3f          root_translation;
-            vec3f          root_delta = vec3f::zero();
+            u32              flags = 0;
+            soa_anim         soa;
+            compressed_anim* compressed = nullptr; // when set sampled instead of soa
+            f32              time = 0.0f;
+            f32              length = 0.0f; // length in time
+            anim_target*     targets = nullptr;
+            cmp_transform*   joints = nullptr;
+            anim_sampler*    samplers = nullptr;
+            vec3f            root_translation;
+            vec3f            root_delta = vec3f::zero();
         };
 
         enum e_animation_semantics
@@ -139,7 +143,10 @@ namespace put
             PMM_GEOMETRY = (1 << 0),
             PMM_MATERIAL = (1 << 1),
             PMM_NODES = (1 << 2),
-            PMM_ALL = 7
+            PMM_ALL = 7,
+            PMM_PACKED_VERTICES = (1 << 3), // convert vertex buffers to the packed formats as they load
+            PMM_OPTIMISE_MESHES = (1 << 4), // reorder indices and vertices for the post transform cache and overdraw
+            PMM_GENERATE_LODS = (1 << 5)    // simplify version 1 files at load, they were built before lod chains
         };
 
         struct animation_channel
@@ -169,7 +176,16 @@ namespace put
             f32 length;
             Str name;
 
-            soa_anim soa;
+            soa_anim         soa;
+            compressed_anim* compressed = nullptr;
+        };
+
+        struct mesh_optimise_stats
+        {
+            f32 acmr_before = 0.0f; // average cache misses per triangle of lod 0, 0.5 is the best case
+            f32 acmr_after = 0.0f;
+            f32 atvr_before = 0.0f; // cache misses per referenced vertex, 1.0 is the best case
+            f32 atvr_after = 0.0f;
         };
 
         struct geometry_resource
@@ -191,15 +207,23 @@ namespace put
             u32 index_type;
             u32 material_index;
             u32 vertex_size;
+            u32 vertex_format = VERTEX_FORMAT_FULL;
+            u32 full_vertex_buffer = PEN_INVALID_HANDLE; // made from cpu_vertex_buffer for techniques without PACKED
 
             vec3f min_extents;
             vec3f max_extents;
 
-            void* cpu_index_buffer;
+            void* cpu_index_buffer; // lod 0 then any simplified levels
             void* cpu_position_buffer;
-            void* cpu_vertex_buffer;
+            void* cpu_vertex_buffer; // always full format, gpu buffer may be packed
 
             cmp_skin* p_skin;
+
+            u32          num_lods = 0; // 0 or 1 is the full mesh only
+            geometry_lod lods[MAX_GEOMETRY_LODS];
+
+            bool                optimised = false;
+            mesh_optimise_stats optimise_stats;
         };
 
         struct vertex_2d
@@ -232,11 +256,42 @@ namespace put
             vertex_model_skinned(){};
         };
 
+        // packed formats, 28 and 36 bytes against 80 and 112. normal and tangent are octahedral encoded snorm16, the
+        // tangent y is stored in the magnitude of w and the bitangent sign in its sign. uvs are half floats and joint
+        // indices and weights unorm8, joint indices index a 256 joint palette window so they always fit.
+        struct vertex_model_packed
+        {
+            f32 pos[3];
+            s16 tbn[4];
+            f16 uv12[4];
+        };
+
+        struct vertex_model_skinned_packed
+        {
+            f32 pos[3];
+            s16 tbn[4];
+            f16 uv12[4];
+            u8  blend_indices[4];
+            u8  blend_weights[4];
+        };
+
         struct vertex_position
         {
             f32 x, y, z, w;
         };
 
+        struct geometry_load_stats
+        {
+            u32 num_geometries = 0;
+            u32 num_packed = 0;
+            u32 full_vertex_bytes = 0; // gpu vertex memory had every stream used the full format
+            u32 vertex_bytes = 0;      // actual gpu vertex memory
+            f32 load_ms = 0.0f;        // time in the geometry loader, including conversion
+            f32 pack_ms = 0.0f;        // time converting to packed formats
+            u32 num_optimised = 0;
+            f32 optimise_ms = 0.0f; // time reordering for the vertex cache, overdraw and fetch
+        };
+
         void save_scene(const c8* filename, ecs_scene* scene);
         void save_sub_scene(ecs_scene* scene, u32 root);
         void load_scene(const c8* filename, ecs_scene* scene, bool merge = false);
@@ -269,6 +324,10 @@ namespace put
 
         void create_geometry_primitives();
 
+        // replaces the gpu vertex buffer with a packed copy of cpu_vertex_buffer
+        void pack_geometry_vertices(geometry_resource* gr);
+        const geometry_load_stats& get_geometry_load_stats();
+
         void add_geometry_resource(geometry_resource* gr);
         void add_material_resource(material_resource* mr);
 
@@ -14,16 +14,74 @@
 #include "pmfx.h"
 #include "str/Str.h"
 #include "str_utilities.h"
+#include "threads.h"
 #include "timer.h"
 
+#include "ecs/ecs_anim_compression.h"
+#include "ecs/ecs_bvh.h"
+#include "ecs/ecs_chunks.h"
+#include "ecs/ecs_journal.h"
+#include "ecs/ecs_light_clusters.h"
+#include "ecs/ecs_lod.h"
+#include "ecs/ecs_occlusion.h"
 #include "ecs/ecs_resources.h"
 #include "ecs/ecs_scene.h"
 #include "ecs/ecs_utilities.h"
 
+#if PEN_SSE
+#include <emmintrin.h>
+#endif
+
 using namespace put;
 
 extern pen::user_info pen_user_info;
 
+namespace
+{
+    const u32 k_skin_palette_window = put::ecs::MAX_SKIN_JOINTS * 3 * sizeof(vec4f);
+
+    // scene views can be recorded on worker threads, anything they write which is shared between views is locked
+    pen::mutex* view_mutex()
+    {
+        static pen::mutex* m = pen::mutex_create();
+        return m;
+    }
+
+    // resources shared by all scene views, created on the user thread before any view can record on a worker
+    struct view_resources
+    {
+        u32 cb_shadow_view = PEN_INVALID_HANDLE;
+        u32 clear_shadow_depth = PEN_INVALID_HANDLE;
+        u32 ltc_mat = PEN_INVALID_HANDLE;
+        u32 ltc_mag = PEN_INVALID_HANDLE;
+    };
+    view_resources s_view_resources;
+
+    void create_view_resources()
+    {
+        view_resources& vr = s_view_resources;
+        if (is_valid(vr.cb_shadow_view))
+            return;
+
+        pen::buffer_creation_params bcp;
+        bcp.usage_flags = PEN_USAGE_DYNAMIC;
+        bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
+        bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
+        bcp.buffer_size = sizeof(put::camera_cbuffer);
+        bcp.data = nullptr;
+
+        vr.cb_shadow_view = pen::renderer_create_buffer(bcp);
+
+        // layers are cleared only when they are re-rendered, the view itself must not clear
+        pen::clear_state cs = {0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0x00, PEN_CLEAR_DEPTH_BUFFER};
+        vr.clear_shadow_depth = pen::renderer_create_clear_state(cs);
+
+        // ltc lookups
+        vr.ltc_mat = put::load_texture("data/textures/ltc/ltc_mat.dds");
+        vr.ltc_mag = put::load_texture("data/textures/ltc/ltc_amp.dds");
+    }
+} // namespace
+
 namespace put
 {
     namespace ecs
@@ -36,6 +94,9 @@ namespace put
             scene->num_components += ext.num_components;
 
             resize_scene_buffers(scene);
+
+            // extension components are stored in chunks like the base components
+            adopt_chunk_components(scene);
         }
 
         void unregister_ecs_extensions(ecs_scene* scene)
@@ -86,6 +147,9 @@ namespace put
                 generic_cmp_array& cmp = scene->get_component_array(i);
                 u32                alloc_size = cmp.size * new_size;
 
+                if (cmp.chunks)
+                    continue;
+
                 if (cmp.data)
                 {
                     // realloc
@@ -106,6 +170,7 @@ namespace put
             }
 
             scene->soa_size = new_size;
+            reserve_chunk_storage(scene, new_size);
             initialise_free_list(scene);
         }
 
@@ -129,15 +194,22 @@ namespace put
                 cmp.data = nullptr;
             }
 
+            clear_chunk_storage(scene);
+
             scene->soa_size = 0;
             scene->num_entities = 0;
         }
 
         void zero_entity_components(ecs_scene* scene, u32 node_index)
         {
+            remove_chunk_entity(scene, node_index);
+
             for (u32 i = 0; i < scene->num_components; ++i)
             {
                 generic_cmp_array& cmp = scene->get_component_array(i);
+                if (cmp.chunks)
+                    continue;
+
                 u8*                offset = (u8*)cmp.data + node_index * cmp.size;
                 pen::memory_zero(offset, cmp.size);
             }
@@ -194,15 +266,32 @@ namespace put
         {
             free_scene_buffers(scene);
             resize_scene_buffers(scene);
+            pmfx::request_serial_recording();
+
+            // static shadow layers were rendered from the old entities, tracking starts again from zero
+            sb_free(scene->static_shadow_casters);
+            scene->static_shadow_casters = nullptr;
+
+            u32 num_maps = sb_count(scene->shadow_maps);
+            for (u32 m = 0; m < num_maps; ++m)
+                scene->shadow_maps[m].flags |= SHADOW_MAP_STATIC_DIRTY;
+
+            // journal actions are node indices and byte ranges into the old entities
+            journal_clear();
         }
 
         // a component wise memcpy of all components and extension components
         void entity_cpy(ecs_scene* scene, u32 dst, u32 src)
         {
             // will copy extensions and base
+            copy_chunk_entity(scene, dst, src);
+
             for (u32 i = 0; i < scene->num_components; ++i)
             {
                 generic_cmp_array& cmp = scene->get_component_array(i);
+                if (cmp.chunks)
+                    continue;
+
                 memcpy(cmp[dst], cmp[src], cmp.size);
             }
         }
@@ -241,9 +330,14 @@ namespace put
             ecs_scene* p_sn = scene;
 
             // copy components
+            copy_chunk_entity(p_sn, dst, src);
+
             for (u32 i = 0; i < scene->num_components; ++i)
             {
                 generic_cmp_array& cmp = p_sn->get_component_array(i);
+                if (cmp.chunks)
+                    continue;
+
                 memcpy(cmp[dst], cmp[src], cmp.size);
             }
 
@@ -332,7 +426,7 @@ namespace put
             bcp.usage_flags = PEN_USAGE_DYNAMIC;
             bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
             bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-            bcp.buffer_size = sizeof(mat4) * MAX_SHADOW_MAPS;
+            bcp.buffer_size = sizeof(shadow_map_cbuffer);
             bcp.data = nullptr;
 
             new_instance.scene->shadow_map_buffer = pen::renderer_create_buffer(bcp);
@@ -351,8 +445,21 @@ namespace put
 
         void destroy_scene(ecs_scene* scene)
         {
+            enable_chunk_storage(scene, false);
+            release_light_clusters(scene);
+            release_occlusion(scene);
+            release_bvh(scene);
             free_scene_buffers(scene);
 
+            sb_free(scene->shadow_maps);
+            scene->shadow_maps = nullptr;
+
+            sb_free(scene->static_shadow_casters);
+            scene->static_shadow_casters = nullptr;
+
+            sb_free(scene->dynamic_shadow_casters);
+            scene->dynamic_shadow_casters = nullptr;
+
             // todo release resource refs
             // geom
             // anim
@@ -405,59 +512,376 @@ namespace put
             }
         }
 
-        void render_shadow_views(const scene_view& view)
+        bool is_dynamic_caster(ecs_scene* scene, u32 n)
         {
-            ecs_scene* scene = view.scene;
+            static const u32 k_dynamic_cmp = CMP_DYNAMIC | CMP_PHYSICS | CMP_SKINNED | CMP_ANIM_CONTROLLER;
+            return scene->entities[n] & k_dynamic_cmp;
+        }
+
+        void fit_shadow_map(ecs_scene* scene, shadow_map_slot& slot, const vec3f& light_dir, const vec4f& sphere)
+        {
+            // basis facing down the light, pick another up vector for lights pointing straight up or down
+            vec3f ref = fabs(light_dir.y) > 0.99f ? vec3f::unit_z() : vec3f::unit_y();
+            vec3f right = normalised(cross(light_dir, ref));
+            vec3f up = normalised(cross(right, light_dir));
+
+            mat4 shadow_view;
+            shadow_view.set_vectors(right, up, -light_dir, vec3f::zero());
+
+            // snap the centre to whole texels so static geometry does not shimmer as the cascade moves
+            f32   r = sphere.w;
+            f32   texel = (2.0f * r) / (f32)slot.resolution;
+            vec3f lc = shadow_view.transform_vector(sphere.xyz);
+            lc.x = floor(lc.x / texel) * texel;
+            lc.y = floor(lc.y / texel) * texel;
 
-            static u32 cb_view = PEN_INVALID_HANDLE;
-            if (!is_valid(cb_view))
+            // depth covers all renderables so casters outside of the cascade still cast into it, snapped so the
+            // range only changes when the scene grows significantly
+            static const f32 k_depth_snap = 16.0f;
+
+            vec3f emin = scene->renderable_extents.min - vec3f(0.1f);
+            vec3f emax = scene->renderable_extents.max + vec3f(0.1f);
+
+            f32 zmin = FLT_MAX;
+            f32 zmax = -FLT_MAX;
+            for (u32 i = 0; i < 8; ++i)
             {
-                pen::buffer_creation_params bcp;
-                bcp.usage_flags = PEN_USAGE_DYNAMIC;
-                bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
-                bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-                bcp.buffer_size = sizeof(camera_cbuffer);
-                bcp.data = nullptr;
+                vec3f corner = vec3f(i & 1 ? emax.x : emin.x, i & 2 ? emax.y : emin.y, i & 4 ? emax.z : emin.z);
+                vec3f p = shadow_view.transform_vector(corner);
 
-                cb_view = pen::renderer_create_buffer(bcp);
+                zmin = std::min<f32>(zmin, p.z);
+                zmax = std::max<f32>(zmax, p.z);
             }
 
-            static mat4 shadow_matrices[MAX_SHADOW_MAPS];
-            u32         shadow_index = 0;
-            for (u32 n = 0; n < scene->num_entities; ++n)
+            zmin = floor(zmin / k_depth_snap) * k_depth_snap;
+            zmax = ceil(zmax / k_depth_snap) * k_depth_snap;
+
+            slot.view = shadow_view;
+            slot.proj = mat::create_orthographic_projection(lc.x - r, lc.x + r, lc.y - r, lc.y + r, zmin, zmax);
+            slot.fit = sphere;
+            slot.light_dir = light_dir;
+            slot.flags |= SHADOW_MAP_FITTED;
+        }
+
+        bool is_shadow_caster(ecs_scene* scene, u32 n)
+        {
+            if (!(scene->entities[n] & CMP_GEOMETRY && scene->entities[n] & CMP_MATERIAL))
+                return false;
+
+            if (scene->entities[n] & CMP_SUB_INSTANCE)
+                return false;
+
+            return !(scene->state_flags[n] & SF_HIDDEN);
+        }
+
+        frustum get_shadow_map_frustum(const shadow_map_slot& slot)
+        {
+            camera cam;
+            cam.view = slot.view;
+            cam.proj = slot.proj;
+            cam.flags |= CF_ORTHO;
+            camera_update_frustum(&cam);
+
+            return cam.camera_frustum;
+        }
+
+        bool extents_inside_frustum(const frustum& f, const vec3f& min, const vec3f& max)
+        {
+            vec3f pos = min + (max - min) * 0.5f;
+            f32   radius = mag(max - min) * 0.5f;
+
+            for (s32 i = 0; i < 6; ++i)
+                if (maths::point_plane_distance(pos, f.p[i], f.n[i]) > radius)
+                    return false;
+
+            return true;
+        }
+
+        hash_id hash_dynamic_casters(ecs_scene* scene, const shadow_map_slot& slot)
+        {
+            // the matrices and resolution are hashed with the index and world matrix of dynamic casters inside the map
+            frustum f = get_shadow_map_frustum(slot);
+
+            pen::hash_murmur hd;
+            hd.begin();
+            hd.add(&slot.view, sizeof(mat4));
+            hd.add(&slot.proj, sizeof(mat4));
+            hd.add(slot.resolution);
+
+            u32 num_casters = sb_count(scene->dynamic_shadow_casters);
+            for (u32 i = 0; i < num_casters; ++i)
             {
-                if (!(scene->entities[n] & CMP_LIGHT))
+                u32 n = scene->dynamic_shadow_casters[i];
+
+                const cmp_bounding_volume& bv = scene->bounding_volumes[n];
+                if (!extents_inside_frustum(f, bv.transformed_min_extents, bv.transformed_max_extents))
                     continue;
 
-                if (!scene->lights[n].shadow_map)
+                hd.add(n);
+                hd.add(&scene->world_matrices[n], sizeof(mat4));
+            }
+
+            return hd.end();
+        }
+
+        void track_shadow_caster(ecs_scene* scene, u32 n, vec3f*& dirty_extents)
+        {
+            // a static caster which moved, appeared or went away dirties the maps under its old and new extents
+            static_shadow_caster& sc = scene->static_shadow_casters[n];
+
+            bool caster = is_shadow_caster(scene, n);
+            if (caster && is_dynamic_caster(scene, n))
+            {
+                sb_push(scene->dynamic_shadow_casters, n);
+                caster = false;
+            }
+
+            if (!caster && !sc.caster)
+                return;
+
+            const cmp_bounding_volume& bv = scene->bounding_volumes[n];
+            if (caster && sc.caster)
+            {
+                // extents change with the matrix or when the geometry is swapped
+                bool moved = memcmp(&sc.world_matrix, &scene->world_matrices[n], sizeof(mat4)) != 0;
+                moved |= memcmp(&sc.min_extents, &bv.transformed_min_extents, sizeof(vec3f)) != 0;
+                moved |= memcmp(&sc.max_extents, &bv.transformed_max_extents, sizeof(vec3f)) != 0;
+                if (!moved)
+                    return;
+            }
+
+            if (sc.caster)
+            {
+                sb_push(dirty_extents, sc.min_extents);
+                sb_push(dirty_extents, sc.max_extents);
+            }
+
+            sc.caster = caster;
+            if (!caster)
+                return;
+
+            sc.world_matrix = scene->world_matrices[n];
+            sc.min_extents = bv.transformed_min_extents;
+            sc.max_extents = bv.transformed_max_extents;
+
+            sb_push(dirty_extents, sc.min_extents);
+            sb_push(dirty_extents, sc.max_extents);
+        }
+
+        void dirty_static_shadow_maps(ecs_scene* scene, const vec3f* dirty_extents)
+        {
+            // maps which are not fitted yet render their static layer when they are
+            u32 num_extents = sb_count(dirty_extents);
+            u32 num_maps = sb_count(scene->shadow_maps);
+            for (u32 m = 0; m < num_maps; ++m)
+            {
+                shadow_map_slot& slot = scene->shadow_maps[m];
+                if (!(slot.flags & SHADOW_MAP_FITTED) || slot.flags & SHADOW_MAP_STATIC_DIRTY)
                     continue;
 
-                if (shadow_index++ != view.array_index)
+                frustum f = get_shadow_map_frustum(slot);
+                for (u32 e = 0; e < num_extents; e += 2)
+                {
+                    if (extents_inside_frustum(f, dirty_extents[e], dirty_extents[e + 1]))
+                    {
+                        slot.flags |= SHADOW_MAP_STATIC_DIRTY;
+                        break;
+                    }
+                }
+            }
+        }
+
+        void plan_shadow_maps(ecs_scene* scene, camera* view_camera)
+        {
+            // decide which shadow map layers need rendering this frame and fill the shadow cbuffer
+            static shadow_map_cbuffer sm_buffer;
+
+            const shadow_params& params = scene->shadow_settings;
+            shadow_map_stats&    stats = scene->shadow_stats;
+
+            u32 num_maps = sb_count(scene->shadow_maps);
+            u32 static_budget = params.max_static_updates > 0 ? params.max_static_updates : num_maps;
+
+            stats = shadow_map_stats();
+            stats.num_maps = num_maps;
+
+            // cascade split distances, a blend of logarithmic and uniform
+            bool  perspective = view_camera && !(view_camera->flags & CF_ORTHO);
+            u32   num_cascades = std::min<u32>(std::max<u32>(params.num_cascades, 1), MAX_SHADOW_CASCADES);
+            f32   splits[MAX_SHADOW_CASCADES + 1] = {0.0f};
+            if (perspective)
+            {
+                f32 n = view_camera->near_plane;
+                f32 f = std::min<f32>(params.max_distance, view_camera->far_plane);
+
+                splits[0] = n;
+                for (u32 c = 1; c <= num_cascades; ++c)
+                {
+                    f32 t = (f32)c / (f32)num_cascades;
+                    f32 log_split = n * pow(f / n, t);
+                    f32 uniform_split = n + (f - n) * t;
+                    splits[c] = uniform_split + (log_split - uniform_split) * params.split_lambda;
+                }
+            }
+
+            for (u32 m = 0; m < num_maps; ++m)
+            {
+                shadow_map_slot& slot = scene->shadow_maps[m];
+                cmp_light&       l = scene->lights[slot.light];
+
+                slot.flags &= ~(SHADOW_MAP_RENDER_STATIC | SHADOW_MAP_RENDER_DYNAMIC);
+
+                // without a perspective camera to split the first cascade covers the whole scene
+                if (!perspective && slot.cascade > 0)
+                {
+                    sm_buffer.info[m] = vec4f((f32)(m * 2), (f32)(m * 2 + 1), FLT_MAX, 0.0f);
+                    stats.skipped++;
                     continue;
+                }
+
+                vec3f light_dir = normalised(-l.direction);
+
+                // bounding sphere the map must cover
+                vec4f required;
+                if (perspective && l.type == LIGHT_TYPE_DIR)
+                {
+                    f32 tan_y = tan(maths::deg_to_rad(view_camera->fov) * 0.5f);
+                    f32 tan_x = tan_y * view_camera->aspect;
+
+                    mat4 inv_view = mat::inverse3x4(view_camera->view);
+
+                    vec3f corners[8];
+                    vec3f centre = vec3f::zero();
+                    for (u32 i = 0; i < 8; ++i)
+                    {
+                        f32   d = splits[slot.cascade + (i >> 2)];
+                        f32   sx = i & 1 ? 1.0f : -1.0f;
+                        f32   sy = i & 2 ? 1.0f : -1.0f;
+                        vec3f vp = vec3f(sx * tan_x * d, sy * tan_y * d, -d);
 
-                camera cam;
-                vec3f  light_dir = normalised(-scene->lights[n].direction);
-                camera_update_shadow_frustum(&cam, light_dir, scene->renderable_extents.min - vec3f(0.1f),
-                                             scene->renderable_extents.max + vec3f(0.1f));
+                        corners[i] = inv_view.transform_vector(vp);
+                        centre += corners[i];
+                    }
+                    centre /= 8.0f;
+
+                    f32 r = 0.0f;
+                    for (u32 i = 0; i < 8; ++i)
+                        r = std::max<f32>(r, mag(corners[i] - centre));
+
+                    required = vec4f(centre, ceil(r));
+                    slot.far_depth = splits[slot.cascade + 1];
+                }
+                else
+                {
+                    vec3f emin = scene->renderable_extents.min;
+                    vec3f emax = scene->renderable_extents.max;
+                    vec3f centre = emin + (emax - emin) * 0.5f;
+
+                    required = vec4f(centre, ceil(mag(emax - emin) * 0.5f) + 1.0f);
+                    slot.far_depth = FLT_MAX;
+                }
+
+                // keep the cached fit while it still contains the required sphere
+                bool refit = !(slot.flags & SHADOW_MAP_FITTED);
+                refit |= dot(slot.light_dir, light_dir) < 0.9999f;
+                refit |= mag(required.xyz - slot.fit.xyz) + required.w > slot.fit.w;
+
+                // static casters are tracked in update_scene, which flags the maps they dirty
+                if (slot.flags & SHADOW_MAP_STATIC_DIRTY || refit)
+                {
+                    if (static_budget > 0)
+                    {
+                        --static_budget;
+                        if (refit)
+                            fit_shadow_map(scene, slot, light_dir,
+                                           vec4f(required.xyz, required.w * (1.0f + params.refit_margin)));
+
+                        slot.flags &= ~SHADOW_MAP_STATIC_DIRTY;
+                        slot.flags |= SHADOW_MAP_RENDER_STATIC;
+                        stats.static_updates++;
+                    }
+                    else
+                    {
+                        // out of budget, keep the old fit and static layer and update the dynamic layer against it
+                        stats.deferred_updates++;
+                    }
+                }
 
-                scene_view vv = view;
-                vv.camera = &cam;
+                hash_id dynamic_hash = hash_dynamic_casters(scene, slot);
+                if (slot.flags & SHADOW_MAP_FITTED && slot.dynamic_hash != dynamic_hash)
+                {
+                    slot.dynamic_hash = dynamic_hash;
+                    slot.flags |= SHADOW_MAP_RENDER_DYNAMIC;
+                    stats.dynamic_updates++;
+                }
 
-                mat4 shadow_vp = cam.proj * cam.view;
-                pen::renderer_update_buffer(cb_view, &shadow_vp, sizeof(mat4));
+                if (!(slot.flags & (SHADOW_MAP_RENDER_STATIC | SHADOW_MAP_RENDER_DYNAMIC)))
+                    stats.skipped++;
 
-                shadow_matrices[shadow_index - 1] = shadow_vp;
+                // maps smaller than the render target use the top left corner, scale clip space into it
+                const pmfx::render_target* rt = pmfx::get_render_target(PEN_HASH("shadow_map"));
+                f32                        s = (f32)slot.resolution / (f32)rt->width;
 
-                vv.cb_view = cb_view;
+                mat4 sub_rect = mat::create_translation(vec3f(s - 1.0f, 1.0f - s, 0.0f)) * mat::create_scale(vec3f(s, s, 1.0f));
 
-                render_scene_view(vv);
+                sm_buffer.matrices[m] = sub_rect * slot.proj * slot.view;
+                sm_buffer.info[m] = vec4f((f32)(m * 2), (f32)(m * 2 + 1), slot.far_depth, 0.0f);
             }
 
-            // update cbuffer
             if (is_valid(scene->shadow_map_buffer))
+                pen::renderer_update_buffer(scene->shadow_map_buffer, &sm_buffer, sizeof(shadow_map_cbuffer));
+        }
+
+        void render_shadow_views(const scene_view& view)
+        {
+            ecs_scene* scene = view.scene;
+
+            u32 cb_view = s_view_resources.cb_shadow_view;
+            u32 clear_depth = s_view_resources.clear_shadow_depth;
+
+            // all slices are rendered from the one view, plan on the first.. pmfx records it before the others
+            if (view.array_index == 0)
             {
-                pen::renderer_update_buffer(scene->shadow_map_buffer, &shadow_matrices[0], sizeof(mat4) * MAX_SHADOW_MAPS);
+                camera* view_camera = scene->shadow_settings.camera ? scene->shadow_settings.camera : view.camera;
+
+                pen::mutex_lock(view_mutex());
+                plan_shadow_maps(scene, view_camera);
+                pen::mutex_unlock(view_mutex());
             }
+
+            u32 m = view.array_index / 2;
+            if (m >= sb_count(scene->shadow_maps))
+                return;
+
+            shadow_map_slot& slot = scene->shadow_maps[m];
+
+            bool dynamic_layer = view.array_index & 1;
+            u32  layer_flag = dynamic_layer ? SHADOW_MAP_RENDER_DYNAMIC : SHADOW_MAP_RENDER_STATIC;
+            if (!(slot.flags & layer_flag))
+                return;
+
+            pen::renderer_clear(clear_depth, view.array_index);
+
+            pen::viewport vp = {0.0f, 0.0f, (f32)slot.resolution, (f32)slot.resolution, 0.0f, 1.0f};
+            pen::renderer_set_viewport(vp);
+            pen::renderer_set_scissor_rect({vp.x, vp.y, vp.width, vp.height});
+
+            camera cam;
+            cam.view = slot.view;
+            cam.proj = slot.proj;
+            cam.flags |= CF_INVALIDATED | CF_ORTHO;
+            camera_update_frustum(&cam);
+
+            mat4 shadow_vp = cam.proj * cam.view;
+            pen::renderer_update_buffer(cb_view, &shadow_vp, sizeof(mat4));
+
+            scene_view vv = view;
+            vv.camera = &cam;
+            vv.cb_view = cb_view;
+            vv.viewport = &vp;
+            vv.render_flags |= dynamic_layer ? RENDER_SHADOW_DYNAMIC : RENDER_SHADOW_STATIC;
+
+            render_scene_view(vv);
         }
 
         void render_light_volumes(const scene_view& view)
@@ -571,6 +995,31 @@ namespace put
             s32 draw_count = 0;
             s32 cull_count = 0;
 
+            f32 start_ms = pen::get_time_ms();
+
+            u32  shadow_flags = RENDER_SHADOW_STATIC | RENDER_SHADOW_DYNAMIC | RENDER_SHADOW_CASTERS;
+            bool shadow_pass = view.render_flags & shadow_flags;
+            bool perspective = !(view.camera->flags & CF_ORTHO);
+
+            geometry_lod_stats lod_stats;
+
+            // light clusters and the occlusion buffer are per scene, views which use them are recorded one at a time
+            bool exclusive = view.render_flags & (RENDER_CLUSTERED_LIT | RENDER_OCCLUSION_CULL);
+            if (exclusive)
+                pen::mutex_lock(view_mutex());
+
+            // bin point and spot lights for this camera
+            if (view.render_flags & RENDER_CLUSTERED_LIT)
+            {
+                bin_light_clusters(scene, view.camera, *view.viewport);
+                update_light_cluster_buffers(scene);
+            }
+
+            // rasterise occluders for this camera
+            bool occlusion_cull = view.render_flags & RENDER_OCCLUSION_CULL && scene->occlusion;
+            if (occlusion_cull)
+                update_occlusion(scene, view.camera);
+
             for (u32 n = 0; n < scene->num_entities; ++n)
             {
                 if (!(scene->entities[n] & CMP_GEOMETRY && scene->entities[n] & CMP_MATERIAL))
@@ -582,6 +1031,13 @@ namespace put
                 if (scene->state_flags[n] & SF_HIDDEN)
                     continue;
 
+                // cached shadow maps render static and dynamic casters into separate layers
+                if (view.render_flags & RENDER_SHADOW_STATIC && is_dynamic_caster(scene, n))
+                    continue;
+
+                if (view.render_flags & RENDER_SHADOW_DYNAMIC && !is_dynamic_caster(scene, n))
+                    continue;
+
                 // frustum cull
                 bool inside = true;
                 for (s32 i = 0; i < 6; ++i)
@@ -609,9 +1065,65 @@ namespace put
                     continue;
                 }
 
+                // occlusion cull
+                if (occlusion_cull)
+                {
+                    vec3f& min = scene->bounding_volumes[n].transformed_min_extents;
+                    vec3f& max = scene->bounding_volumes[n].transformed_max_extents;
+
+                    if (is_occluded(scene, min, max))
+                    {
+                        cull_count++;
+                        continue;
+                    }
+                }
+
                 draw_count++;
 
                 cmp_geometry* p_geom = &scene->geometries[n];
+
+                // store the largest screen size this frame for anim and geometry lod selection
+                bool anim_lod = scene->entities[n] & CMP_ANIM_CONTROLLER;
+                bool geom_lod = p_geom->num_lods > 1 && perspective && !shadow_pass;
+                if (anim_lod || geom_lod)
+                {
+                    f32 screen_size = 0.0f;
+                    if (perspective)
+                    {
+                        vec3f& min = scene->bounding_volumes[n].transformed_min_extents;
+                        vec3f& max = scene->bounding_volumes[n].transformed_max_extents;
+
+                        f32 radius = scene->bounding_volumes[n].radius;
+                        f32 d = mag(min + (max - min) * 0.5f - view.camera->pos);
+                        f32 half_height = tan(maths::deg_to_rad(view.camera->fov) * 0.5f) * std::max<f32>(d, radius);
+
+                        screen_size = half_height > 0.0f ? radius / half_height : 1.0f;
+                    }
+
+                    if (!exclusive)
+                        pen::mutex_lock(view_mutex());
+
+                    if (anim_lod)
+                    {
+                        cmp_anim_controller_v2& controller = scene->anim_controller_v2[n];
+                        if (controller.lod_frame != scene->anim_frame)
+                        {
+                            controller.lod_frame = scene->anim_frame;
+                            controller.lod_screen_size = screen_size;
+                        }
+                        else
+                        {
+                            controller.lod_screen_size = std::max<f32>(controller.lod_screen_size, screen_size);
+                        }
+                    }
+
+                    if (geom_lod)
+                        p_geom->lod_screen_size = std::max<f32>(p_geom->lod_screen_size, screen_size);
+
+                    if (!exclusive)
+                        pen::mutex_unlock(view_mutex());
+                }
+
                 cmp_material* p_mat = &scene->materials[n];
                 u32           permutation = scene->material_permutation[n];
 
@@ -623,6 +1135,20 @@ namespace put
                 }
                 else
                 {
+                    // view techniques without a PACKED variant would bind the full input layout to packed vertices
+                    if (permutation & PERMUTATION_PACKED)
+                    {
+                        u32 packed = pmfx::get_technique_index_perm(view.pmfx_shader, view.technique, permutation);
+                        u32 full = pmfx::get_technique_index_perm(view.pmfx_shader, view.technique,
+                                                                  permutation & ~PERMUTATION_PACKED);
+                        if (packed == full)
+                        {
+                            if (scene->entities[n] & CMP_MASTER_INSTANCE)
+                                n += scene->master_instances[n].num_instances;
+                            continue;
+                        }
+                    }
+
                     bool set = pmfx::set_technique_perm(view.pmfx_shader, view.technique, permutation);
                     if (!set)
                     {
@@ -636,28 +1162,18 @@ namespace put
                     }
                 }
 
-                // update skin
-                if (scene->entities[n] & CMP_SKINNED && !(scene->entities[n] & CMP_SUB_GEOMETRY))
+                // bind skin palette, sub geometry shares its parents palette
+                if (scene->entities[n] & CMP_SKINNED)
                 {
-                    if (p_geom->p_skin->bone_cbuffer == PEN_INVALID_HANDLE)
-                    {
-                        pen::buffer_creation_params bcp;
-                        bcp.usage_flags = PEN_USAGE_DYNAMIC;
-                        bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
-                        bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-                        bcp.buffer_size = sizeof(mat4) * 85;
-                        bcp.data = nullptr;
-
-                        p_geom->p_skin->bone_cbuffer = pen::renderer_create_buffer(bcp);
-                    }
+                    u32 pn = scene->entities[n] & CMP_SUB_GEOMETRY ? scene->parents[n] : n;
+                    u32 palette_offset = scene->geometries[pn].skin_palette_offset;
 
-                    static mat4 bb[85];
-                    s32         joints_offset = scene->anim_controller[n].joints_offset;
-                    for (s32 i = 0; i < p_geom->p_skin->num_joints; ++i)
-                        bb[i] = scene->world_matrices[joints_offset + i] * p_geom->p_skin->joint_bind_matrices[i];
+                    // palette was not built this frame (culled by anim lod last frame)
+                    if (!is_valid(palette_offset))
+                        continue;
 
-                    pen::renderer_update_buffer(p_geom->p_skin->bone_cbuffer, bb, sizeof(bb));
-                    pen::renderer_set_constant_buffer(p_geom->p_skin->bone_cbuffer, 2, pen::CBUFFER_BIND_VS);
+                    pen::renderer_set_constant_buffer_range(scene->skinning_palette_buffer, 2, pen::CBUFFER_BIND_VS,
+                                                            palette_offset, k_skin_palette_window);
                 }
 
                 // set material cbs
@@ -710,8 +1226,8 @@ namespace put
                     pen::renderer_set_constant_buffer(scene->area_light_buffer, 6, pen::CBUFFER_BIND_PS);
 
                     // ltc lookups
-                    static u32 ltc_mat = put::load_texture("data/textures/ltc/ltc_mat.dds");
-                    static u32 ltc_mag = put::load_texture("data/textures/ltc/ltc_amp.dds");
+                    u32 ltc_mat = s_view_resources.ltc_mat;
+                    u32 ltc_mag = s_view_resources.ltc_mag;
 
 					static hash_id id_clamp_linear = PEN_HASH("clamp_linear");
                     u32 clamp_linear = pmfx::get_render_state(id_clamp_linear, pmfx::RS_SAMPLER);
@@ -720,6 +1236,9 @@ namespace put
                     pen::renderer_set_texture(ltc_mag, clamp_linear, 12, pen::TEXTURE_BIND_PS);
                 }
 
+                if (view.render_flags & RENDER_CLUSTERED_LIT)
+                    bind_light_clusters(scene);
+
                 // sdf shadows
                 pen::renderer_set_constant_buffer(scene->sdf_shadow_buffer, 5, pen::CBUFFER_BIND_PS);
                 for (u32 n = 0; n < scene->num_entities; ++n)
@@ -746,23 +1265,235 @@ namespace put
                     continue;
                 }
 
-                // single
-                pen::renderer_draw_indexed(scene->geometries[n].num_indices, 0, 0, PEN_PT_TRIANGLELIST);
+                // single, lods are index ranges after the full mesh
+                u32 start_index = 0;
+                u32 num_indices = p_geom->num_indices;
+                if (p_geom->num_lods > 1)
+                {
+                    u32 lod = get_geometry_lod(scene, n, shadow_pass);
+                    start_index = p_geom->lods[lod].index_offset;
+                    num_indices = p_geom->lods[lod].num_indices;
+
+                    lod_stats.lod_draws[lod]++;
+                }
+
+                lod_stats.draws++;
+                if (shadow_pass)
+                {
+                    lod_stats.shadow_triangles += num_indices / 3;
+                    lod_stats.shadow_full_triangles += p_geom->num_indices / 3;
+                }
+                else
+                {
+                    lod_stats.triangles += num_indices / 3;
+                    lod_stats.full_triangles += p_geom->num_indices / 3;
+                }
+
+                pen::renderer_draw_indexed(num_indices, start_index, 0, PEN_PT_TRIANGLELIST);
             }
+
+            if (!exclusive)
+                pen::mutex_lock(view_mutex());
+
+            geometry_lod_stats& st = scene->geometry_stats_pending;
+            st.draws += lod_stats.draws;
+            st.triangles += lod_stats.triangles;
+            st.full_triangles += lod_stats.full_triangles;
+            st.shadow_triangles += lod_stats.shadow_triangles;
+            st.shadow_full_triangles += lod_stats.shadow_full_triangles;
+            st.record_ms += pen::get_time_ms() - start_ms;
+
+            for (u32 l = 0; l < MAX_GEOMETRY_LODS; ++l)
+                st.lod_draws[l] += lod_stats.lod_draws[l];
+
+            pen::mutex_unlock(view_mutex());
         }
 
-        void update_animations(ecs_scene* scene, f32 dt)
+        namespace
         {
-            //dt = 16.66;
-            //pen::timer* timer = pen::timer_create("anim_v2");
-            //pen::timer_start(timer);
+#if PEN_SSE
+            pen_inline __m128 dot4(__m128 a, __m128 b)
+            {
+                __m128 m = _mm_mul_ps(a, b);
+                __m128 s = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+                s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+                return s;
+            }
+#endif
+            // normalised lerp taking the shortest path, q1 and q2 are 4 floats xyzw
+            pen_inline void anim_nlerp(const f32* q1, const f32* q2, f32 t, f32* out)
+            {
+#if PEN_SSE
+                __m128 a = _mm_loadu_ps(q1);
+                __m128 b = _mm_loadu_ps(q2);
 
-            for (u32 n = 0; n < scene->num_entities; ++n)
+                __m128 sign = _mm_and_ps(dot4(a, b), _mm_set1_ps(-0.0f));
+                b = _mm_xor_ps(b, sign);
+
+                __m128 r = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t)));
+                r = _mm_div_ps(r, _mm_sqrt_ps(dot4(r, r)));
+
+                _mm_storeu_ps(out, r);
+#else
+                f32 d = q1[0] * q2[0] + q1[1] * q2[1] + q1[2] * q2[2] + q1[3] * q2[3];
+                f32 s = d < 0.0f ? -1.0f : 1.0f;
+
+                f32 len2 = 0.0f;
+                for (u32 i = 0; i < 4; ++i)
+                {
+                    out[i] = q1[i] + (q2[i] * s - q1[i]) * t;
+                    len2 += out[i] * out[i];
+                }
+
+                f32 rlen = 1.0f / sqrt(len2);
+                for (u32 i = 0; i < 4; ++i)
+                    out[i] *= rlen;
+#endif
+            }
+
+            // blends 4 joints at a time, lerp translation and scale, nlerp rotation
+            pen_inline void anim_blend_joints4(const cmp_transform** ta, const cmp_transform** tb, f32 t, cmp_transform* out)
+            {
+#if PEN_SSE
+                __m128 vt = _mm_set1_ps(t);
+
+                // rotation in soa xxxx, yyyy, zzzz, wwww
+                __m128 a0 = _mm_loadu_ps(&ta[0]->rotation.v[0]);
+                __m128 a1 = _mm_loadu_ps(&ta[1]->rotation.v[0]);
+                __m128 a2 = _mm_loadu_ps(&ta[2]->rotation.v[0]);
+                __m128 a3 = _mm_loadu_ps(&ta[3]->rotation.v[0]);
+                _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+
+                __m128 b0 = _mm_loadu_ps(&tb[0]->rotation.v[0]);
+                __m128 b1 = _mm_loadu_ps(&tb[1]->rotation.v[0]);
+                __m128 b2 = _mm_loadu_ps(&tb[2]->rotation.v[0]);
+                __m128 b3 = _mm_loadu_ps(&tb[3]->rotation.v[0]);
+                _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, b0), _mm_mul_ps(a1, b1)),
+                                      _mm_add_ps(_mm_mul_ps(a2, b2), _mm_mul_ps(a3, b3)));
+
+                __m128 sign = _mm_and_ps(d, _mm_set1_ps(-0.0f));
+                b0 = _mm_xor_ps(b0, sign);
+                b1 = _mm_xor_ps(b1, sign);
+                b2 = _mm_xor_ps(b2, sign);
+                b3 = _mm_xor_ps(b3, sign);
+
+                __m128 r0 = _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(b0, a0), vt));
+                __m128 r1 = _mm_add_ps(a1, _mm_mul_ps(_mm_sub_ps(b1, a1), vt));
+                __m128 r2 = _mm_add_ps(a2, _mm_mul_ps(_mm_sub_ps(b2, a2), vt));
+                __m128 r3 = _mm_add_ps(a3, _mm_mul_ps(_mm_sub_ps(b3, a3), vt));
+
+                __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, r0), _mm_mul_ps(r1, r1)),
+                                                    _mm_add_ps(_mm_mul_ps(r2, r2), _mm_mul_ps(r3, r3))));
+                r0 = _mm_div_ps(r0, len);
+                r1 = _mm_div_ps(r1, len);
+                r2 = _mm_div_ps(r2, len);
+                r3 = _mm_div_ps(r3, len);
+
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                _mm_storeu_ps(&out[0].rotation.v[0], r0);
+                _mm_storeu_ps(&out[1].rotation.v[0], r1);
+                _mm_storeu_ps(&out[2].rotation.v[0], r2);
+                _mm_storeu_ps(&out[3].rotation.v[0], r3);
+
+                // translation and scale xxxx, yyyy, zzzz
+                for (u32 e = 0; e < 3; ++e)
+                {
+                    __m128 at = _mm_set_ps(ta[3]->translation[e], ta[2]->translation[e], ta[1]->translation[e],
+                                           ta[0]->translation[e]);
+                    __m128 bt = _mm_set_ps(tb[3]->translation[e], tb[2]->translation[e], tb[1]->translation[e],
+                                           tb[0]->translation[e]);
+                    __m128 as = _mm_set_ps(ta[3]->scale[e], ta[2]->scale[e], ta[1]->scale[e], ta[0]->scale[e]);
+                    __m128 bs = _mm_set_ps(tb[3]->scale[e], tb[2]->scale[e], tb[1]->scale[e], tb[0]->scale[e]);
+
+                    f32 rt[4];
+                    f32 rs[4];
+                    _mm_storeu_ps(rt, _mm_add_ps(at, _mm_mul_ps(_mm_sub_ps(bt, at), vt)));
+                    _mm_storeu_ps(rs, _mm_add_ps(as, _mm_mul_ps(_mm_sub_ps(bs, as), vt)));
+
+                    for (u32 i = 0; i < 4; ++i)
+                    {
+                        out[i].translation[e] = rt[i];
+                        out[i].scale[e] = rs[i];
+                    }
+                }
+#else
+                for (u32 i = 0; i < 4; ++i)
+                {
+                    out[i].translation = lerp(ta[i]->translation, tb[i]->translation, t);
+                    out[i].scale = lerp(ta[i]->scale, tb[i]->scale, t);
+                    anim_nlerp(&ta[i]->rotation.v[0], &tb[i]->rotation.v[0], t, &out[i].rotation.v[0]);
+                }
+#endif
+            }
+
+            // finds the frame the time t lies in, the cached cursor and next frame are checked first so
+            // sequential playback is o(1), loops and seeks fall back to a binary search.
+            // returns false if t lies outside of the channels key range.
+            pen_inline bool anim_find_frame(const soa_anim& soa, u32 c, u32 num_frames, f32 t, u32& cursor)
             {
-                if (!(scene->entities[n] & CMP_ANIM_CONTROLLER))
-                    continue;
+                if (num_frames < 2)
+                    return false;
+
+                u32 last = num_frames - 1;
+
+                if (t <= soa.info[0][c].time || t > soa.info[last][c].time)
+                    return false;
+
+                // cached
+                for (u32 i = 0; i < 2; ++i)
+                {
+                    u32 k = cursor + i;
+                    if (k >= last)
+                        break;
+
+                    if (soa.info[k][c].time < t && t <= soa.info[k + 1][c].time)
+                    {
+                        cursor = k;
+                        return true;
+                    }
+                }
+
+                // binary search for largest k where time[k] < t
+                u32 lo = 0;
+                u32 hi = last;
+                while (hi - lo > 1)
+                {
+                    u32 mid = (lo + hi) / 2;
+                    if (soa.info[mid][c].time < t)
+                        lo = mid;
+                    else
+                        hi = mid;
+                }
+
+                cursor = lo;
+                return true;
+            }
+
+            struct anim_update_job
+            {
+                ecs_scene* scene;
+                u32*       controllers;
+            };
+
+            void update_anim_controller(ecs_scene* scene, u32 n)
+            {
+                cmp_anim_controller_v2& controller = scene->anim_controller_v2[n];
+
+                f32 dt = controller.lod_dt;
+                controller.lod_dt = 0.0f;
+
+                bool skip_leaves = scene->anim_lod.enabled && controller.lod >= scene->anim_lod.skip_leaf_joints_lod;
+                skip_leaves &= controller.joint_flags != nullptr;
 
-                cmp_anim_controller_v2 controller = scene->anim_controller_v2[n];
+                // reduced joint set, root motion is always sampled. skipped joints hold their last sampled pose
+                auto skip_joint = [&](u32 j) -> bool {
+                    if (!skip_leaves || !(controller.joint_flags[j] & anim_joint_flags::LEAF))
+                        return false;
+
+                    return !(scene->entities[controller.joint_indices[j]] & CMP_ANIM_TRAJECTORY);
+                };
 
                 u32 num_anims = sb_count(controller.anim_instances);
                 for (u32 ai = 0; ai < num_anims; ++ai)
@@ -796,7 +1527,8 @@ namespace put
 
                     // reset rotations
                     for (u32 j = 0; j < num_joints; ++j)
-                        instance.targets[j].q = quat(0.0f, 0.0f, 0.0f);
+                        if (!skip_joint(j))
+                            instance.targets[j].q = quat(0.0f, 0.0f, 0.0f);
 
                     for (s32 c = 0; c < num_channels; ++c)
                     {
@@ -806,18 +1538,29 @@ namespace put
                         if (sampler.joint == PEN_INVALID_HANDLE)
                             continue;
 
-                        // find the frame we are on..
-                        for (; sampler.pos < channel.num_frames; sampler.pos++)
-                            if (anim_t <= soa.info[sampler.pos][c].time)
-                            {
-                                sampler.pos -= 1;
-                                break;
-                            }
+                        if (skip_joint(sampler.joint))
+                            continue;
 
                         //reset flag
                         sampler.flags &= ~anim_flags::LOOPED;
 
-                        if (sampler.pos >= channel.num_frames || looped)
+                        // decompressing sampler
+                        if (instance.compressed)
+                        {
+                            const compressed_channel& cc = instance.compressed->channels[c];
+
+                            if (looped || anim_t <= cc.start_time || anim_t > cc.end_time)
+                                sampler.flags = anim_flags::LOOPED;
+
+                            anim_target& target = instance.targets[sampler.joint];
+                            for (u32 tr = 0; tr < anim_track::COUNT; ++tr)
+                                sample_compressed_track(instance.compressed, c, tr, anim_t, sampler.track_pos[tr], target);
+
+                            continue;
+                        }
+
+                        // find the frame we are on..
+                        if (looped || !anim_find_frame(soa, c, channel.num_frames, anim_t, sampler.pos))
                         {
                             sampler.pos = 0;
                             sampler.flags = anim_flags::LOOPED;
@@ -840,30 +1583,26 @@ namespace put
                         sampler.prev_t = sampler.cur_t;
                         sampler.cur_t = it;
 
+                        anim_target& target = instance.targets[sampler.joint];
+
                         for (u32 e = 0; e < channel.element_count; ++e)
                         {
                             u32 eo = channel.element_offset[e];
 
-                            // slerp quats
+                            // nlerp quats
                             if (eo == A_OUT_QUAT)
                             {
-                                quat q1;
-                                quat q2;
+                                quat ql;
+                                anim_nlerp(&d1[e], &d2[e], it, &ql.v[0]);
 
-                                memcpy(&q1.v[0], &d1[e], 16);
-                                memcpy(&q2.v[0], &d2[e], 16);
-
-                                quat ql = slerp(q1, q2, it);
-
-                                instance.targets[sampler.joint].q = ql * instance.targets[sampler.joint].q;
-                                instance.targets[sampler.joint].flags |= channel.flags;
+                                target.q = ql * target.q;
+                                target.flags |= channel.flags;
                                 e += 3;
                             }
                             else
                             {
                                 // lerp translation / scale
-                                f32 lf = (1 - it) * d1[e] + it * d2[e];
-                                instance.targets[sampler.joint].t[eo] = lf;
+                                target.t[eo] = (1 - it) * d1[e] + it * d2[e];
                             }
                         }
                     }
@@ -880,6 +1619,9 @@ namespace put
                             continue;
                         }
 
+                        if (skip_joint(j))
+                            continue;
+
                         f32* f = &instance.targets[j].t[0];
 
                         instance.joints[j].translation = vec3f(f[A_OUT_TX], f[A_OUT_TY], f[A_OUT_TZ]);
@@ -919,43 +1661,134 @@ namespace put
                     f32            t = controller.blend.ratio;
 
                     u32 num_joints = sb_count(a.joints);
-                    for (u32 j = 0; j < num_joints; ++j)
+                    for (u32 j = 0; j < num_joints; j += 4)
                     {
-                        u32 jnode = controller.joint_indices[j];
+                        // blend 4 joints at a time, padding the tail with the last joint
+                        const cmp_transform* ta[4];
+                        const cmp_transform* tb[4];
+                        for (u32 i = 0; i < 4; ++i)
+                        {
+                            u32 ji = j + i < num_joints ? j + i : num_joints - 1;
+                            ta[i] = &a.joints[ji];
+                            tb[i] = &b.joints[ji];
+                        }
 
-                        cmp_transform& tc = scene->transforms[jnode];
-                        cmp_transform& ta = a.joints[j];
-                        cmp_transform& tb = b.joints[j];
+                        cmp_transform blended[4];
+                        anim_blend_joints4(ta, tb, t, blended);
 
-                        if (scene->entities[jnode] & CMP_ANIM_TRAJECTORY)
+                        u32 batch = num_joints - j < 4 ? num_joints - j : 4;
+                        for (u32 i = 0; i < batch; ++i)
                         {
-                            vec3f lerp_delta = lerp(a.root_delta, b.root_delta, t);
+                            u32 jnode = controller.joint_indices[j + i];
+
+                            if (scene->entities[jnode] & CMP_ANIM_TRAJECTORY)
+                            {
+                                vec3f lerp_delta = lerp(a.root_delta, b.root_delta, t);
 
-                            mat4 rot_mat;
-                            quat q = scene->initial_transform[jnode].rotation;
-                            q.get_matrix(rot_mat);
+                                mat4 rot_mat;
+                                quat q = scene->initial_transform[jnode].rotation;
+                                q.get_matrix(rot_mat);
 
-                            vec3f transform_translation = rot_mat.transform_vector(lerp_delta);
+                                vec3f transform_translation = rot_mat.transform_vector(lerp_delta);
 
-                            // apply root motion to the root controller, so we bring along the meshes
-                            scene->transforms[n].rotation = q;
-                            scene->transforms[n].translation += transform_translation;
-                            scene->entities[n] |= CMP_TRANSFORM;
+                                // apply root motion to the root controller, so we bring along the meshes
+                                scene->transforms[n].rotation = q;
+                                scene->transforms[n].translation += transform_translation;
+                                scene->entities[n] |= CMP_TRANSFORM;
 
-                            continue;
+                                continue;
+                            }
+
+                            scene->transforms[jnode] = blended[i];
+                            scene->entities[jnode] |= CMP_TRANSFORM;
                         }
+                    }
+                }
+            }
+
+            void update_anim_controllers_job(u32 start, u32 end, void* user_data)
+            {
+                anim_update_job* job = (anim_update_job*)user_data;
+
+                for (u32 i = start; i < end; ++i)
+                    update_anim_controller(job->scene, job->controllers[i]);
+            }
+        } // namespace
+
+        void update_animations(ecs_scene* scene, f32 dt)
+        {
+            // gather controllers, each one only writes to its own entity and joints so they can be updated in parallel
+            static u32* s_controllers = nullptr;
+            if (s_controllers)
+                stb__sbn(s_controllers) = 0;
+
+            const anim_lod_params& lp = scene->anim_lod;
+            anim_lod_stats&        stats = scene->anim_stats;
+
+            stats = anim_lod_stats();
+            scene->anim_frame++;
+
+            for (u32 n = 0; n < scene->num_entities; ++n)
+            {
+                if (!(scene->entities[n] & CMP_ANIM_CONTROLLER))
+                    continue;
 
-                        tc.translation = lerp(ta.translation, tb.translation, t);
-                        tc.rotation = slerp2(ta.rotation, tb.rotation, t);
-                        tc.scale = lerp(ta.scale, tb.scale, t);
+                cmp_anim_controller_v2& controller = scene->anim_controller_v2[n];
+                controller.lod_dt += dt;
 
-                        scene->entities[jnode] |= CMP_TRANSFORM;
+                // select lod from what was rendered last frame, only skinned meshes are rendered
+                u32 lod = ANIM_LOD_0;
+                if (lp.enabled && scene->entities[n] & (CMP_SKINNED | CMP_PRE_SKINNED))
+                {
+                    if (controller.lod_frame + 1 < scene->anim_frame)
+                    {
+                        lod = ANIM_LOD_CULLED;
+                    }
+                    else
+                    {
+                        lod = ANIM_LOD_2;
+                        for (u32 l = 0; l < ANIM_LOD_CULLED; ++l)
+                        {
+                            if (controller.lod_screen_size >= lp.min_screen_size[l])
+                            {
+                                lod = l;
+                                break;
+                            }
+                        }
                     }
                 }
+
+                controller.lod = lod;
+                stats.controllers[lod]++;
+
+                // throttle update rate, staggered by entity index to spread the cost over frames
+                u32 interval = lp.enabled ? std::max<u32>(lp.update_interval[lod], 1) : 1;
+                if ((scene->anim_frame + n) % interval != 0)
+                {
+                    stats.throttled++;
+                    continue;
+                }
+
+                stats.updated++;
+
+                u32 num_joints = sb_count(controller.joint_indices);
+                u32 num_skipped = 0;
+                if (lp.enabled && lod >= lp.skip_leaf_joints_lod && controller.joint_flags)
+                    for (u32 j = 0; j < num_joints; ++j)
+                        if (controller.joint_flags[j] & anim_joint_flags::LEAF)
+                            num_skipped++;
+
+                stats.joints_sampled += num_joints - num_skipped;
+                stats.joints_skipped += num_skipped;
+
+                sb_push(s_controllers, n);
             }
 
-            //f32 ms = pen::timer_elapsed_ms(timer);
-            //PEN_LOG("anim_v2 : %f", ms);
+            anim_update_job job;
+            job.scene = scene;
+            job.controllers = s_controllers;
+
+            pen::jobs_parallel_for(sb_count(s_controllers), 4, update_anim_controllers_job, &job);
         }
 
         void update_animations_baked(ecs_scene* scene, f32 dt)
@@ -1076,8 +1909,173 @@ namespace put
             return &s_scenes;
         }
 
+        void update_skinning_palettes(ecs_scene* scene)
+        {
+            // palettes for every rig are packed into a single buffer as 3x4 matrices once per frame.
+            // each rig starts on a CBUFFER_RANGE_ALIGNMENT boundary so draws can bind a window at its offset.
+            static vec4f* s_palette = nullptr;
+            if (s_palette)
+                stb__sbn(s_palette) = 0;
+
+            static const u32 k_align = pen::CBUFFER_RANGE_ALIGNMENT / sizeof(vec4f);
+
+            for (u32 n = 0; n < scene->num_entities; ++n)
+            {
+                if (!(scene->entities[n] & CMP_GEOMETRY))
+                    continue;
+
+                cmp_geometry& geom = scene->geometries[n];
+                geom.skin_palette_offset = PEN_INVALID_HANDLE;
+
+                if (!(scene->entities[n] & (CMP_SKINNED | CMP_PRE_SKINNED)))
+                    continue;
+
+                if (scene->entities[n] & CMP_SUB_GEOMETRY)
+                    continue;
+
+                // culled by anim lod, not rendered last frame
+                if (scene->anim_lod.enabled && scene->entities[n] & CMP_ANIM_CONTROLLER)
+                {
+                    if (scene->anim_controller_v2[n].lod == ANIM_LOD_CULLED)
+                    {
+                        scene->anim_stats.palettes_skipped++;
+                        continue;
+                    }
+                }
+
+                scene->anim_stats.palettes_built++;
+
+                u32 start = sb_count(s_palette);
+                u32 aligned = (start + k_align - 1) & ~(k_align - 1);
+                for (u32 i = start; i < aligned; ++i)
+                    sb_push(s_palette, vec4f(0.0f, 0.0f, 0.0f, 0.0f));
+
+                geom.skin_palette_offset = aligned * sizeof(vec4f);
+
+                s32 joints_offset = scene->anim_controller[n].joints_offset;
+                for (s32 i = 0; i < geom.p_skin->num_joints; ++i)
+                {
+                    mat4 m = scene->world_matrices[joints_offset + i] * geom.p_skin->joint_bind_matrices[i];
+
+                    sb_push(s_palette, m.get_row(0));
+                    sb_push(s_palette, m.get_row(1));
+                    sb_push(s_palette, m.get_row(2));
+                }
+            }
+
+            u32 palette_size = sb_count(s_palette) * sizeof(vec4f);
+            if (palette_size == 0)
+                return;
+
+            // the last rig still binds a full window
+            u32 required_size = palette_size + k_skin_palette_window;
+            if (required_size > scene->skinning_palette_buffer_size)
+            {
+                if (is_valid(scene->skinning_palette_buffer))
+                    pen::renderer_release_buffer(scene->skinning_palette_buffer);
+
+                u32 buffer_size = required_size + required_size / 2;
+
+                pen::buffer_creation_params bcp;
+                bcp.usage_flags = PEN_USAGE_DYNAMIC;
+                bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
+                bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
+                bcp.buffer_size = buffer_size;
+                bcp.data = nullptr;
+
+                scene->skinning_palette_buffer = pen::renderer_create_buffer(bcp);
+                scene->skinning_palette_buffer_size = buffer_size;
+            }
+
+            // upload is trimmed to the joints actually used
+            pen::renderer_update_buffer(scene->skinning_palette_buffer, s_palette, palette_size);
+        }
+
+        void update_shadow_map_slots(ecs_scene* scene)
+        {
+            // one map per cascade for directional lights and one for other shadow casting lights, in entity order
+            const shadow_params& params = scene->shadow_settings;
+            u32                  num_cascades = std::min<u32>(std::max<u32>(params.num_cascades, 1), MAX_SHADOW_CASCADES);
+
+            shadow_map_slot* slots = nullptr;
+            for (u32 n = 0; n < scene->num_entities; ++n)
+            {
+                if (!(scene->entities[n] & CMP_LIGHT))
+                    continue;
+
+                cmp_light& l = scene->lights[n];
+                if (!l.shadow_map)
+                    continue;
+
+                u32 count = l.type == LIGHT_TYPE_DIR ? num_cascades : 1;
+                for (u32 c = 0; c < count; ++c)
+                {
+                    if (sb_count(slots) >= MAX_SHADOW_MAPS)
+                        break;
+
+                    shadow_map_slot slot;
+                    slot.light = n;
+                    slot.cascade = c;
+                    slot.resolution = params.resolution[c];
+                    sb_push(slots, slot);
+                }
+            }
+
+            // keep cached slots while the lights and cascades are unchanged
+            u32  num_slots = sb_count(slots);
+            bool changed = num_slots != sb_count(scene->shadow_maps);
+            for (u32 m = 0; m < num_slots && !changed; ++m)
+            {
+                const shadow_map_slot& a = slots[m];
+                const shadow_map_slot& b = scene->shadow_maps[m];
+                changed = a.light != b.light || a.cascade != b.cascade || a.resolution != b.resolution;
+            }
+
+            if (changed)
+            {
+                sb_free(scene->shadow_maps);
+                scene->shadow_maps = slots;
+            }
+            else
+            {
+                sb_free(slots);
+            }
+
+            if (num_slots == 0)
+                return;
+
+            // static and dynamic slice per map, the target is sized for the largest map
+            u32 size = 0;
+            for (u32 m = 0; m < num_slots; ++m)
+                size = std::max<u32>(size, scene->shadow_maps[m].resolution);
+
+            const pmfx::render_target* sm = pmfx::get_render_target(PEN_HASH("shadow_map"));
+
+            if (sm->num_arrays < num_slots * 2 || sm->width != size)
+            {
+                pmfx::rt_resize_params rrp;
+                rrp.width = size;
+                rrp.height = size;
+                rrp.format = nullptr;
+                rrp.num_arrays = num_slots * 2;
+                rrp.num_mips = 1;
+                rrp.collection = pen::TEXTURE_COLLECTION_ARRAY;
+                pmfx::resize_render_target(PEN_HASH("shadow_map"), rrp);
+
+                // contents are lost
+                for (u32 m = 0; m < num_slots; ++m)
+                {
+                    scene->shadow_maps[m].flags = 0;
+                    scene->shadow_maps[m].dynamic_hash = 0;
+                }
+            }
+        }
+
         void update_scene(ecs_scene* scene, f32 dt)
         {
+            // entities whose flags changed move to their archetype and holes left by edits are compacted
+            sync_chunk_storage(scene);
+
             // static anim time to pass into draw calls etc..
             f32 anim_time = pen::get_time_ms() / 1000.0;
 
@@ -1099,6 +2097,8 @@ namespace put
                 update_animations(scene, dt);
             }
 
+            update_geometry_lods(scene);
+
             // extension component update
             for (u32 e = 0; e < num_extensions; ++e)
                 if (scene->extensions[e].update_func)
@@ -1188,6 +2188,21 @@ namespace put
             scene->renderable_extents.min = vec3f::flt_max();
             scene->renderable_extents.max = -vec3f::flt_max();
 
+            // shadow casters are tracked as their extents are transformed
+            static vec3f* s_dirty_extents = nullptr;
+            if (s_dirty_extents)
+                stb__sbn(s_dirty_extents) = 0;
+
+            if (scene->dynamic_shadow_casters)
+                stb__sbn(scene->dynamic_shadow_casters) = 0;
+
+            u32 num_tracked = sb_count(scene->static_shadow_casters);
+            if (num_tracked < scene->num_entities)
+            {
+                static_shadow_caster* added = sb_add(scene->static_shadow_casters, scene->num_entities - num_tracked);
+                memset(added, 0x0, (scene->num_entities - num_tracked) * sizeof(static_shadow_caster));
+            }
+
             // transform extents by transform
             for (s32 n = 0; n < scene->num_entities; ++n)
             {
@@ -1200,6 +2215,7 @@ namespace put
                 if (scene->entities[n] & CMP_BONE)
                 {
                     tmin = tmax = scene->world_matrices[n].get_translation();
+                    track_shadow_caster(scene, n, s_dirty_extents);
                     continue;
                 }
 
@@ -1217,6 +2233,8 @@ namespace put
                 f32& trad = scene->bounding_volumes[n].radius;
                 trad = mag(tmax - tmin) * 0.5f;
 
+                track_shadow_caster(scene, n, s_dirty_extents);
+
                 if (!(scene->entities[n] & CMP_GEOMETRY))
                     continue;
 
@@ -1255,6 +2273,26 @@ namespace put
                 }
             }
 
+            // refit the entity bvh once something has queried it
+            if (scene->bvh)
+                update_bvh(scene);
+
+            // casters beyond the end of the scene have been deleted, their components may no longer be allocated
+            for (u32 n = scene->num_entities; n < sb_count(scene->static_shadow_casters); ++n)
+            {
+                static_shadow_caster& sc = scene->static_shadow_casters[n];
+                if (!sc.caster)
+                    continue;
+
+                sb_push(s_dirty_extents, sc.min_extents);
+                sb_push(s_dirty_extents, sc.max_extents);
+                sc.caster = false;
+            }
+
+            // Shadow maps
+            update_shadow_map_slots(scene);
+            dirty_static_shadow_maps(scene, s_dirty_extents);
+
             // Forward light buffer
             static forward_light_buffer light_buffer;
             s32                         pos = 0;
@@ -1286,6 +2324,21 @@ namespace put
                 light_buffer.lights[pos].pos_radius = vec4f(light_pos, 0.0);
                 light_buffer.lights[pos].colour = vec4f(l.colour, l.shadow_map ? 1.0 : 0.0);
 
+                // first shadow map and number of cascades
+                u32 num_maps = sb_count(scene->shadow_maps);
+                for (u32 m = 0; m < num_maps; ++m)
+                {
+                    if (scene->shadow_maps[m].light != (u32)n)
+                        continue;
+
+                    u32 count = 0;
+                    while (m + count < num_maps && scene->shadow_maps[m + count].light == (u32)n)
+                        ++count;
+
+                    light_buffer.lights[pos].data = vec4f(0.0f, (f32)m, (f32)count, 0.0f);
+                    break;
+                }
+
                 ++num_directions_lights;
                 ++num_lights;
                 ++pos;
@@ -1461,33 +2514,11 @@ namespace put
                 pen::renderer_set_constant_buffer(scene->sdf_shadow_buffer, 5, pen::CBUFFER_BIND_PS);
             }
 
-            // Shadow maps
-            u32 num_shadow_maps = 0;
-            for (s32 n = 0; n < scene->num_entities; ++n)
-            {
-                if (!(scene->entities[n] & CMP_LIGHT))
-                    continue;
-
-                cmp_light& l = scene->lights[n];
-                if (!l.shadow_map)
-                    continue;
-
-                ++num_shadow_maps;
-            }
+            update_skinning_palettes(scene);
 
-            const pmfx::render_target* sm = pmfx::get_render_target(PEN_HASH("shadow_map"));
-
-            if (sm->num_arrays < num_shadow_maps)
-            {
-                pmfx::rt_resize_params rrp;
-                rrp.width = 2048;
-                rrp.height = 2048;
-                rrp.format = nullptr;
-                rrp.num_arrays = num_shadow_maps;
-                rrp.num_mips = 1;
-                rrp.collection = pen::TEXTURE_COLLECTION_ARRAY;
-                pmfx::resize_render_target(PEN_HASH("shadow_map"), rrp);
-            }
+            // views can record on worker threads, anything they would otherwise create lazily is made here
+            create_view_resources();
+            create_light_cluster_resources(scene);
 
             // Update pre skinned vertex buffers
             static hash_id id_pre_skin_technique = PEN_HASH("pre_skin");
@@ -1499,31 +2530,16 @@ namespace put
                     if (!(scene->entities[n] & CMP_PRE_SKINNED))
                         continue;
 
-                    // update bone cbuffer
+                    // culled by anim lod, not rendered last frame
                     cmp_geometry& geom = scene->geometries[n];
-                    if (geom.p_skin->bone_cbuffer == PEN_INVALID_HANDLE)
-                    {
-                        pen::buffer_creation_params bcp;
-                        bcp.usage_flags = PEN_USAGE_DYNAMIC;
-                        bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
-                        bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-                        bcp.buffer_size = sizeof(mat4) * 85;
-                        bcp.data = nullptr;
-
-                        geom.p_skin->bone_cbuffer = pen::renderer_create_buffer(bcp);
-                    }
-
-                    static mat4 bb[85];
-                    s32         joints_offset = scene->anim_controller[n].joints_offset;
-                    for (s32 i = 0; i < geom.p_skin->num_joints; ++i)
-                        bb[i] = scene->world_matrices[joints_offset + i] * geom.p_skin->joint_bind_matrices[i];
-
-                    pen::renderer_update_buffer(geom.p_skin->bone_cbuffer, bb, sizeof(bb));
+                    if (!is_valid(geom.skin_palette_offset))
+                        continue;
 
                     // bind stream out targets
                     cmp_pre_skin& pre_skin = scene->pre_skin[n];
                     pen::renderer_set_stream_out_target(geom.vertex_buffer);
-                    pen::renderer_set_constant_buffer(geom.p_skin->bone_cbuffer, 2, pen::CBUFFER_BIND_VS);
+                    pen::renderer_set_constant_buffer_range(scene->skinning_palette_buffer, 2, pen::CBUFFER_BIND_VS,
+                                                            geom.skin_palette_offset, k_skin_palette_window);
                     pen::renderer_set_vertex_buffer(pre_skin.vertex_buffer, 0, pre_skin.vertex_size, 0);
 
                     // render point list
@@ -1706,8 +2722,8 @@ namespace put
 
                 for (u32 c = 0; c < scene->num_components; ++c)
                 {
-                    generic_cmp_array& src = scene->get_component_array(c);
-                    generic_cmp_array& dst = sub_scene.get_component_array(c);
+                    const generic_cmp_array& src = scene->get_component_array(c);
+                    generic_cmp_array&       dst = sub_scene.get_component_array(c);
 
                     memcpy(dst[ni], src[ii], src.size);
                 }
@@ -1737,8 +2753,16 @@ namespace put
             // write basic components
             for (u32 i = 0; i < scene->num_components; ++i)
             {
-                generic_cmp_array& cmp = scene->get_component_array(i);
-                ofs.write((const c8*)cmp.data, cmp.size * scene->num_entities);
+                const generic_cmp_array& cmp = scene->get_component_array(i);
+                if (!cmp.chunks)
+                {
+                    ofs.write((const c8*)cmp.data, cmp.size * scene->num_entities);
+                    continue;
+                }
+
+                // components an entity does not own are written as zero
+                for (u32 n = 0; n < scene->num_entities; ++n)
+                    ofs.write((const c8*)cmp[n], cmp.size);
             }
 
             // specialisations ------------------------------------------------------------------------------
@@ -1913,7 +2937,13 @@ namespace put
 
         void load_scene(const c8* filename, ecs_scene* scene, bool merge)
         {
+            // components are read as whole arrays into the soa, chunked scenes move back into chunks once loaded
+            bool chunked = scene->chunk_storage != nullptr;
+            enable_chunk_storage(scene, false);
+
             scene->flags |= INVALIDATE_SCENE_TREE;
+            pmfx::request_serial_recording();
+            journal_clear();
             bool error = false;
             Str  project_dir = dev_ui::get_program_preference_filename("project_dir", pen_user_info.working_directory);
 
@@ -2299,6 +3329,9 @@ namespace put
 
             initialise_free_list(scene);
 
+            if (chunked)
+                enable_chunk_storage(scene, true);
+
             // cleanup
             sb_free(component_sizes);
             sb_free(exts);
@@ -25,6 +25,10 @@ namespace put
     {
         struct anim_instance;
         struct ecs_scene;
+        struct ecs_chunk_storage;
+        struct ecs_light_clusters;
+        struct ecs_occlusion;
+        struct ecs_bvh;
 
         enum e_scene_view_flags : u32
         {
@@ -126,13 +130,20 @@ namespace put
             MAX_FORWARD_LIGHTS = 100,
             MAX_AREA_LIGHTS = 10,
             MAX_SHADOW_MAPS = 100,
-            MAX_SDF_SHADOWS = 1
+            MAX_SDF_SHADOWS = 1,
+            MAX_SKIN_JOINTS = 256, // per draw, palette window is 3 x vec4 per joint
+            MAX_SHADOW_CASCADES = 4
         };
 
         enum e_scene_render_flags
         {
             RENDER_FORWARD_LIT = 1,
-            RENDER_DEFERRED_LIT = 1 << 1
+            RENDER_DEFERRED_LIT = 1 << 1,
+            RENDER_CLUSTERED_LIT = 1 << 2, // point and spot lights from cluster lists, see ecs_light_clusters.h
+            RENDER_SHADOW_STATIC = 1 << 3, // only static shadow casters
+            RENDER_SHADOW_DYNAMIC = 1 << 4, // only dynamic shadow casters
+            RENDER_OCCLUSION_CULL = 1 << 5, // cull against the cpu hi-z buffer, see ecs_occlusion.h
+            RENDER_SHADOW_CASTERS = 1 << 6  // shadow pass, draws coarser geometry lods
         };
 
         struct cmp_draw_call
@@ -145,10 +156,9 @@ namespace put
 
         struct cmp_skin
         {
-            u32  num_joints;
-            mat4 bind_shape_matrix;
-            mat4 joint_bind_matrices[85];
-            u32  bone_cbuffer = PEN_INVALID_HANDLE;
+            u32   num_joints;
+            mat4  bind_shape_matrix;
+            mat4* joint_bind_matrices;
         };
 
         // contains handles and data to re-create a material from scratch
@@ -213,17 +223,64 @@ namespace put
             vec3f max;
         };
 
+        // geometry lod, simplified index ranges follow the full mesh in the same index buffer and share its vertices.
+        // the level is chosen once per frame from the largest screen size (fraction of viewport height) the entity was
+        // rendered at by a perspective view, shadow passes draw a coarser level, see ecs_lod.h
+        enum e_geometry_lod_constants
+        {
+            MAX_GEOMETRY_LODS = 5 // including lod 0
+        };
+
+        struct geometry_lod
+        {
+            u32 index_offset;
+            u32 num_indices;
+            f32 error; // max distance the surface moved, as a fraction of the bounding radius
+        };
+
+        struct geometry_lod_params
+        {
+            bool enabled = true;
+            f32  pixel_error = 1.0f; // max projected error in pixels
+            f32  hysteresis = 0.25f; // fraction of pixel_error a coarser level must come in under before switching
+            u32  shadow_bias = 1;    // levels coarser than the camera lod for shadow passes
+        };
+
+        struct geometry_lod_stats
+        {
+            u32 draws = 0;
+            u32 lod_draws[MAX_GEOMETRY_LODS] = {0};
+            u32 triangles = 0;
+            u32 full_triangles = 0; // what the same draws cost at lod 0
+            u32 shadow_triangles = 0;
+            u32 shadow_full_triangles = 0;
+            f32 record_ms = 0.0f; // cpu time in render_scene_view
+        };
+
+        // vertex stream layout of a geometry, packed streams select the PACKED shader permutation
+        enum e_vertex_format
+        {
+            VERTEX_FORMAT_FULL = 0,  // vertex_model / vertex_model_skinned
+            VERTEX_FORMAT_PACKED = 1 // vertex_model_packed / vertex_model_skinned_packed
+        };
+
         struct cmp_geometry
         {
-            u32       position_buffer;
-            u32       vertex_buffer;
-            u32       index_buffer;
-            u32       num_indices;
-            u32       num_vertices;
-            u32       index_type;
-            u32       vertex_size;
-            cmp_skin* p_skin;
-            hash_id   vertex_shader_class;
+            u32                 position_buffer;
+            u32                 vertex_buffer;
+            u32                 index_buffer;
+            u32                 num_indices;
+            u32                 num_vertices;
+            u32                 index_type;
+            u32                 vertex_size;
+            cmp_skin*           p_skin;
+            hash_id             vertex_shader_class;
+            u32                 skin_palette_offset; // byte offset into the scenes skinning palette buffer this frame
+            const geometry_lod* lods;                // owned by the geometry resource
+            u32                 num_lods;
+            u32                 lod;
+            f32                 lod_screen_size; // largest this frame, negative when not rendered
+            u32                 vertex_format;   // e_vertex_format
         };
 
         struct cmp_pre_skin
@@ -265,12 +322,57 @@ namespace put
             f32 ratio = 0.0f;
         };
 
+        // anim lod, skinned characters are bucketed by the largest screen size (fraction of viewport height) they were
+        // rendered at last frame. lower lods update less often and can skip leaf joints, characters which were not
+        // rendered at all are culled and skip palette rebuilds.
+        enum e_anim_lod
+        {
+            ANIM_LOD_0 = 0,
+            ANIM_LOD_1,
+            ANIM_LOD_2,
+            ANIM_LOD_CULLED,
+            ANIM_LOD_COUNT
+        };
+
+        struct anim_lod_params
+        {
+            bool enabled = true;
+            f32  min_screen_size[ANIM_LOD_CULLED] = {0.2f, 0.05f, 0.0f}; // min screen size for lod n
+            u32  update_interval[ANIM_LOD_COUNT] = {1, 2, 4, 8};         // update every n frames
+            u32  skip_leaf_joints_lod = ANIM_LOD_2;                      // lod >= skips leaf joints
+        };
+
+        struct anim_lod_stats
+        {
+            u32 controllers[ANIM_LOD_COUNT] = {0};
+            u32 updated = 0;
+            u32 throttled = 0;
+            u32 joints_sampled = 0;
+            u32 joints_skipped = 0;
+            u32 palettes_built = 0;
+            u32 palettes_skipped = 0;
+        };
+
+        namespace anim_joint_flags
+        {
+            enum anim_joint_flags
+            {
+                LEAF = 1
+            };
+        }
+
         struct cmp_anim_controller_v2
         {
             anim_instance* anim_instances = nullptr;
             u32*           joint_indices = nullptr; // indices into the scene hierarchy
             u8*            joint_flags = nullptr;
             anim_blend     blend;
+
+            // lod
+            u32 lod = ANIM_LOD_0;
+            u32 lod_frame = 0;          // last frame rendered
+            f32 lod_screen_size = 1.0f; // largest screen size last frame rendered
+            f32 lod_dt = 0.0f;          // accumulated time since last update
         };
 
         struct cmp_light
@@ -320,7 +422,7 @@ namespace put
             vec4f pos_radius; // radius = point radius and spot length
             vec4f dir_cutoff; // spot dir and cos cutoff
             vec4f colour;     // w = boolean cast shadow
-            vec4f data;       // x = spot falloff, yzw reserved
+            vec4f data;       // x = spot falloff, y = first shadow map, z = num shadow maps (dir)
         };
 
         struct forward_light_buffer
@@ -329,6 +431,67 @@ namespace put
             light_data lights[MAX_FORWARD_LIGHTS];
         };
 
+        // shadow maps are split into cascades for directional lights, each cascade has a cached layer for static
+        // casters which is only re-rendered when the cascade is refit or a static caster moves, and a layer for
+        // dynamic casters which is re-rendered when any of them move. slices are 2 * map (static), 2 * map + 1 (dynamic)
+        struct shadow_params
+        {
+            put::camera* camera = nullptr; // cascades are split along this camera, else the shadow view camera
+            u32          num_cascades = 4;
+            f32          max_distance = 500.0f; // far plane of the last cascade, clamped to the camera far plane
+            f32          split_lambda = 0.8f;   // 0 = uniform, 1 = logarithmic splits
+            f32          refit_margin = 0.25f;  // padding so small camera moves reuse the cached cascade
+            u32          resolution[MAX_SHADOW_CASCADES] = {2048, 2048, 1024, 1024};
+            u32          max_static_updates = 2; // static layers re-rendered per frame, 0 = unlimited
+        };
+
+        struct shadow_map_stats
+        {
+            u32 num_maps = 0;
+            u32 static_updates = 0;
+            u32 dynamic_updates = 0;
+            u32 deferred_updates = 0; // static updates pushed to a later frame by the budget
+            u32 skipped = 0;          // maps with no work this frame
+        };
+
+        enum e_shadow_map_flags
+        {
+            SHADOW_MAP_FITTED = 1 << 0,
+            SHADOW_MAP_RENDER_STATIC = 1 << 1, // set for the frame the layer needs rendering
+            SHADOW_MAP_RENDER_DYNAMIC = 1 << 2,
+            SHADOW_MAP_STATIC_DIRTY = 1 << 3 // a static caster changed inside the fit since the layer was rendered
+        };
+
+        struct shadow_map_slot
+        {
+            u32     light = 0;
+            u32     cascade = 0;
+            u32     resolution = 0;
+            u32     flags = 0;
+            vec4f   fit;       // xyz = centre, w = radius
+            vec3f   light_dir; // at time of fit
+            f32     far_depth; // view depth covered by the cascade
+            mat4    view;
+            mat4    proj;
+            hash_id dynamic_hash = 0;
+        };
+
+        // what each entity last contributed to the static shadow layers, compared during update_scene so only maps
+        // touched by a static caster which moved, appeared or went away are re-rendered
+        struct static_shadow_caster
+        {
+            bool  caster;
+            mat4  world_matrix;
+            vec3f min_extents;
+            vec3f max_extents;
+        };
+
+        struct shadow_map_cbuffer
+        {
+            mat4  matrices[MAX_SHADOW_MAPS];
+            vec4f info[MAX_SHADOW_MAPS]; // x = static slice, y = dynamic slice, z = far view depth
+        };
+
         struct distance_field_shadow
         {
             mat4 world_matrix;
@@ -365,6 +528,10 @@ namespace put
             u32 size = sizeof(T);
             T*  data = nullptr;
 
+            // set when the component is stored in chunks instead of data, see ecs_chunks.h
+            ecs_chunk_storage* chunks = nullptr;
+            u32                chunk_component = 0;
+
             T&       operator[](size_t index);
             const T& operator[](size_t index) const;
         };
@@ -374,7 +541,11 @@ namespace put
             u32   size;
             void* data;
 
-            void* operator[](size_t index);
+            ecs_chunk_storage* chunks = nullptr;
+            u32                chunk_component = 0;
+
+            void*       operator[](size_t index);
+            const void* operator[](size_t index) const;
         };
 
         struct ecs_extension
@@ -461,6 +632,18 @@ namespace put
             ecs_extension*  extensions = nullptr;
             ecs_controller* controllers = nullptr;
 
+            // optional archetype storage which replaces the soa arrays, see ecs_chunks.h
+            ecs_chunk_storage* chunk_storage = nullptr;
+
+            // created by update_scene on the user thread, binned by views rendering with clustered lighting
+            ecs_light_clusters* light_clusters = nullptr;
+
+            // occluder list and cpu depth buffer, created by add_occluder, see ecs_occlusion.h
+            ecs_occlusion* occlusion = nullptr;
+
+            // entity bounding volumes for cpu picking and spatial queries, created by the first query, see ecs_bvh.h
+            ecs_bvh* bvh = nullptr;
+
             // Scene Data
             u32             num_entities = 0;
             u32             soa_size = 0;
@@ -469,14 +652,31 @@ namespace put
             u32             sdf_shadow_buffer = PEN_INVALID_HANDLE;
             u32             area_light_buffer = PEN_INVALID_HANDLE;
             u32             shadow_map_buffer = PEN_INVALID_HANDLE;
+            u32             skinning_palette_buffer = PEN_INVALID_HANDLE;
+            u32             skinning_palette_buffer_size = 0;
             s32             selected_index = -1;
             u32             flags = 0;
             u32             view_flags = 0;
             extents         renderable_extents;
             u32*            selection_list = nullptr;
+            u32             anim_frame = 0;
+            anim_lod_params anim_lod;
+            anim_lod_stats  anim_stats;
             u32             version = k_version;
             Str             filename = "";
 
+            // geometry lods, stats are from the last complete frame
+            geometry_lod_params geometry_lods;
+            geometry_lod_stats  geometry_stats;
+            geometry_lod_stats  geometry_stats_pending;
+
+            // cascaded / cached shadow maps
+            shadow_params         shadow_settings;
+            shadow_map_stats      shadow_stats;
+            shadow_map_slot*      shadow_maps = nullptr;
+            static_shadow_caster* static_shadow_casters = nullptr;  // per entity
+            u32*                  dynamic_shadow_casters = nullptr; // entity indices, rebuilt each update
+
             generic_cmp_array& get_component_array(u32 index);
         };
 
@@ -494,6 +694,7 @@ namespace put
 
         void update();
         void update_scene(ecs_scene* scene, f32 dt);
+        void update_animations(ecs_scene* scene, f32 dt);
 
         void render_scene_view(const scene_view& view);
         void render_light_volumes(const scene_view& view);
@@ -519,26 +720,48 @@ namespace put
 
         void register_ecs_controller(ecs_scene* scene, const ecs_controller& controller);
 
+        // chunk storage lookups, get adds the component to the entity if it does not own it, read returns zero
+        void*       get_chunk_component(ecs_chunk_storage* cs, u32 component, u32 entity);
+        const void* read_chunk_component(const ecs_chunk_storage* cs, u32 component, u32 entity);
+
         // separate implementations to make clang always inline
         template <typename T>
         pen_inline T& cmp_array<T>::operator[](size_t index)
         {
+            if (chunks)
+                return *(T*)get_chunk_component(chunks, chunk_component, (u32)index);
+
             return data[index];
         }
 
         template <typename T>
         pen_inline const T& cmp_array<T>::operator[](size_t index) const
         {
+            if (chunks)
+                return *(const T*)read_chunk_component(chunks, chunk_component, (u32)index);
+
             return data[index];
         }
 
         pen_inline void* generic_cmp_array::operator[](size_t index)
         {
+            if (chunks)
+                return get_chunk_component(chunks, chunk_component, (u32)index);
+
             u8* d = (u8*)data;
             u8* di = &d[index * size];
             return (void*)(di);
         }
 
+        pen_inline const void* generic_cmp_array::operator[](size_t index) const
+        {
+            if (chunks)
+                return read_chunk_component(chunks, chunk_component, (u32)index);
+
+            const u8* d = (const u8*)data;
+            return (const void*)&d[index * size];
+        }
+
         pen_inline u32 get_extension_component_offset(ecs_scene* scene, u32 extension)
         {
             u32 offset = scene->num_base_components;
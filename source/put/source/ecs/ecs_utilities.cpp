@@ -174,6 +174,9 @@ namespace put
 
             scene->flags |= INVALIDATE_SCENE_TREE;
 
+            // new lights or geometry may need resources before views can be recorded on workers again
+            pmfx::request_serial_recording();
+
             scene->num_entities = std::max<u32>(i + 1, scene->num_entities);
 
             scene->entities[i] = CMP_ALLOCATED;
@@ -485,6 +488,12 @@ namespace put
                     return;
                 }
 
+                if (gr->vertex_format == VERTEX_FORMAT_PACKED)
+                {
+                    dev_console_log("[error] can't bake vertex buffer with packed vertices.");
+                    return;
+                }
+
                 vertex_size = gr->vertex_size;
                 num_vertices += gr->num_vertices;
                 num_indices += gr->num_indices;
@@ -591,6 +600,7 @@ namespace put
             scene->geometries[nn].num_indices = num_indices;
             scene->geometries[nn].vertex_size = vertex_size;
             scene->geometries[nn].vertex_shader_class = 0;
+            scene->geometries[nn].vertex_format = VERTEX_FORMAT_FULL;
             scene->geometries[nn].p_skin = nullptr;
 
             scene->transforms[nn].scale = vec3f::one();
@@ -613,6 +623,7 @@ namespace put
             animation_resource* anim = get_animation_resource(anim_handle);
             anim_instance       anim_instance;
             anim_instance.soa = anim->soa;
+            anim_instance.compressed = anim->compressed;
             anim_instance.length = anim->length;
 
             cmp_anim_controller_v2& controller = scene->anim_controller_v2[node_index];
@@ -649,6 +660,9 @@ namespace put
                 anim_sampler sampler;
                 sampler.joint = PEN_INVALID_HANDLE;
                 sampler.pos = 0;
+                sampler.flags = 0;
+                for (u32 t = 0; t < 3; ++t)
+                    sampler.track_pos[t] = 0;
 
                 // find bone for channel
                 for (u32 j = 0; j < num_joints; ++j)
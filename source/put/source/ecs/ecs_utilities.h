@@ -17,7 +17,8 @@ namespace
     enum e_shader_permutation
     {
         PERMUTATION_SKINNED = 1 << 31,
-        PERMUTATION_INSTANCED = 1 << 30
+        PERMUTATION_INSTANCED = 1 << 30,
+        PERMUTATION_PACKED = 1 << 29
     };
 } // namespace
 
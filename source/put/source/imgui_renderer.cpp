@@ -29,16 +29,12 @@ namespace put
             u32 raster_state;
             u32 blend_state;
             u32 depth_stencil_state;
-            u32 vertex_buffer;
-            u32 index_buffer;
             u32 font_texture;
             u32 font_sampler_state;
-            u32 vb_size;
-            u32 ib_size;
             u32 constant_buffer;
 
-            void* vb_copy_buffer = nullptr;
-            void* ib_copy_buffer = nullptr;
+            pen::stream_alloc vb;
+            pen::stream_alloc ib;
 
             u32 imgui_shader;
             u32 imgui_ex_shader;
@@ -228,86 +224,38 @@ namespace put
 
         void update_dynamic_buffers(ImDrawData* draw_data)
         {
-            if (g_imgui_rs.vertex_buffer == 0 || (s32)g_imgui_rs.vb_size < draw_data->TotalVtxCount)
-            {
-                if (g_imgui_rs.vertex_buffer != 0)
-                {
-                    pen::renderer_release_buffer(g_imgui_rs.vertex_buffer);
-                };
+            // draw lists are copied straight into transient stream memory, nothing to grow or stage
+            u32 vb_size = draw_data->TotalVtxCount * sizeof(ImDrawVert);
+            u32 ib_size = draw_data->TotalIdxCount * sizeof(ImDrawIdx);
 
-                g_imgui_rs.vb_size = draw_data->TotalVtxCount + 10000;
+            g_imgui_rs.vb = pen::renderer_stream_alloc(PEN_BIND_VERTEX_BUFFER, vb_size);
+            g_imgui_rs.ib = pen::renderer_stream_alloc(PEN_BIND_INDEX_BUFFER, ib_size);
 
-                pen::buffer_creation_params bcp;
-                bcp.usage_flags = PEN_USAGE_DYNAMIC;
-                bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
-                bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-                bcp.buffer_size = g_imgui_rs.vb_size * sizeof(ImDrawVert);
-                bcp.data = (void*)nullptr;
-
-                if (g_imgui_rs.vb_copy_buffer == nullptr)
-                {
-                    g_imgui_rs.vb_copy_buffer = pen::memory_alloc(g_imgui_rs.vb_size * sizeof(ImDrawVert));
-                }
-                else
-                {
-                    g_imgui_rs.vb_copy_buffer =
-                        pen::memory_realloc(g_imgui_rs.vb_copy_buffer, g_imgui_rs.vb_size * sizeof(ImDrawVert));
-                }
-
-                g_imgui_rs.vertex_buffer = pen::renderer_create_buffer(bcp);
-            }
-
-            if (g_imgui_rs.index_buffer == 0 || (s32)g_imgui_rs.ib_size < draw_data->TotalIdxCount)
+            if (vb_size > 0 && ib_size > 0)
             {
-                if (g_imgui_rs.index_buffer != 0)
-                {
-                    pen::renderer_release_buffer(g_imgui_rs.index_buffer);
-                };
-
-                g_imgui_rs.ib_size = draw_data->TotalIdxCount + 5000;
+                u32 vb_offset = 0;
+                u32 ib_offset = 0;
 
-                pen::buffer_creation_params bcp;
-                bcp.usage_flags = PEN_USAGE_DYNAMIC;
-                bcp.bind_flags = PEN_BIND_INDEX_BUFFER;
-                bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-                bcp.buffer_size = g_imgui_rs.ib_size * sizeof(ImDrawIdx);
-                bcp.data = (void*)nullptr;
+                c8* vb_mem = (c8*)g_imgui_rs.vb.data;
+                c8* ib_mem = (c8*)g_imgui_rs.ib.data;
 
-                if (g_imgui_rs.ib_copy_buffer == nullptr)
+                for (int n = 0; n < draw_data->CmdListsCount; n++)
                 {
-                    g_imgui_rs.ib_copy_buffer = pen::memory_alloc(g_imgui_rs.ib_size * sizeof(ImDrawIdx));
-                }
-                else
-                {
-                    g_imgui_rs.ib_copy_buffer =
-                        pen::memory_realloc(g_imgui_rs.ib_copy_buffer, g_imgui_rs.ib_size * sizeof(ImDrawIdx));
-                }
+                    ImDrawList* cmd_list = draw_data->CmdLists[n];
+                    u32         vertex_size = cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+                    u32         index_size = cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
 
-                g_imgui_rs.index_buffer = pen::renderer_create_buffer(bcp);
-            }
-
-            u32 vb_offset = 0;
-            u32 ib_offset = 0;
+                    memcpy(&vb_mem[vb_offset], cmd_list->VtxBuffer.Data, vertex_size);
+                    memcpy(&ib_mem[ib_offset], cmd_list->IdxBuffer.Data, index_size);
 
-            for (int n = 0; n < draw_data->CmdListsCount; n++)
-            {
-                ImDrawList* cmd_list = draw_data->CmdLists[n];
-                u32         vertex_size = cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
-                u32         index_size = cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
-
-                c8* vb_mem = (c8*)g_imgui_rs.vb_copy_buffer;
-                c8* ib_mem = (c8*)g_imgui_rs.ib_copy_buffer;
-
-                memcpy(&vb_mem[vb_offset], cmd_list->VtxBuffer.Data, vertex_size);
-                memcpy(&ib_mem[ib_offset], cmd_list->IdxBuffer.Data, index_size);
+                    vb_offset += vertex_size;
+                    ib_offset += index_size;
+                }
 
-                vb_offset += vertex_size;
-                ib_offset += index_size;
+                pen::renderer_stream_commit(g_imgui_rs.vb, 0, vb_offset);
+                pen::renderer_stream_commit(g_imgui_rs.ib, 0, ib_offset);
             }
 
-            pen::renderer_update_buffer(g_imgui_rs.vertex_buffer, g_imgui_rs.vb_copy_buffer, vb_offset);
-            pen::renderer_update_buffer(g_imgui_rs.index_buffer, g_imgui_rs.ib_copy_buffer, ib_offset);
-            
             float L = 0.0f;
             float R = ImGui::GetIO().DisplaySize.x;
             float B = ImGui::GetIO().DisplaySize.y;
@@ -356,8 +304,11 @@ namespace put
 
                         pen::renderer_set_scissor_rect(r);
 
-                        pen::renderer_set_vertex_buffer(g_imgui_rs.vertex_buffer, 0, sizeof(ImDrawVert), 0);
-                        pen::renderer_set_index_buffer(g_imgui_rs.index_buffer, PEN_FORMAT_R16_UINT, 0);
+                        const pen::stream_alloc& vb = g_imgui_rs.vb;
+                        const pen::stream_alloc& ib = g_imgui_rs.ib;
+
+                        pen::renderer_set_vertex_buffer(vb.buffer, 0, sizeof(ImDrawVert), vb.offset);
+                        pen::renderer_set_index_buffer(ib.buffer, PEN_FORMAT_R16_UINT, ib.offset);
                         pen::renderer_set_constant_buffer(g_imgui_rs.constant_buffer, 1, pen::CBUFFER_BIND_VS);
 
                         pen::renderer_draw_indexed(pcmd->ElemCount, idx_offset, vtx_offset, PEN_PT_TRIANGLELIST);
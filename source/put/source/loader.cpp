@@ -9,6 +9,7 @@
 #include "file_system.h"
 #include "hash.h"
 #include "memory.h"
+#include "mip_generator.h"
 #include "pen.h"
 #include "pen_json.h"
 #include "pen_string.h"
@@ -24,7 +25,9 @@ using namespace put;
 // dxgi formats
 #define DXGI_RG32_FLOAT             16
 #define DXGI_RGBA32_FLOAT           2
+#define DXGI_RGBA16_FLOAT           10
 #define DXGI_RGBA8_UNORM            28
+#define DXGI_RGBA8_UNORM_SRGB       29
 #define DXGI_R8_UNORM               61
 #define DXGI_A8_UNORM               65
 #define DXGI_BC1_UNORM              71
@@ -177,7 +180,11 @@ namespace
             case DXGI_RG32_FLOAT:
                 block_size = 8;
                 return PEN_TEX_FORMAT_R32G32_FLOAT;
+            case DXGI_RGBA16_FLOAT:
+                block_size = 8;
+                return PEN_TEX_FORMAT_R16G16B16A16_FLOAT;
             case DXGI_RGBA8_UNORM:
+            case DXGI_RGBA8_UNORM_SRGB: // no srgb formats, sampled as unorm but mips are filtered in linear space
                 block_size = 4;
                 return PEN_TEX_FORMAT_RGBA8_UNORM;
             case DXGI_R8_UNORM:
@@ -321,13 +328,15 @@ namespace
 
         u32 format = dds_pixel_format_to_texture_format(ddsh, compressed, block_size, dx10_header_present);
 
-        u8* top_image_start = (u8*)file_data + sizeof(dds_header);
-        u32 array_size = 1;
+        u8*  top_image_start = (u8*)file_data + sizeof(dds_header);
+        u32  array_size = 1;
+        bool srgb = false;
         if (dx10_header_present)
         {
             dx10_header* dxh = (dx10_header*)top_image_start;
 
             format = dxgi_format_to_texture_format(dxh, compressed, block_size);
+            srgb = dxh->dxgi_format == DXGI_RGBA8_UNORM_SRGB;
 
             array_size = dxh->array_size;
             top_image_start += sizeof(dx10_header);
@@ -399,6 +408,19 @@ namespace
         // free the files contents
         pen::memory_free(file_data);
 
+        // generate mips for 8 bit colour textures exported without them. float and single channel formats are
+        // usually data (luts, masks, heights) sampled at a fixed level, so they are left as authored
+        bool colour = tcp.format == PEN_TEX_FORMAT_RGBA8_UNORM || tcp.format == PEN_TEX_FORMAT_BGRA8_UNORM;
+        if (tcp.num_mips == 1 && !compressed && colour)
+        {
+            mips::mip_params mp;
+            mp.flags = srgb ? mips::MIP_SRGB : 0;
+
+            void* top_data = tcp.data;
+            if (mips::generate(tcp, mp))
+                pen::memory_free(top_data);
+        }
+
         u32 texture_index = pen::renderer_create_texture(tcp);
 
         pen::memory_free(tcp.data);
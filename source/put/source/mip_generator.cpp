@@ -0,0 +1,706 @@
+// mip_generator.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "mip_generator.h"
+
+#include "memory.h"
+#include "threads.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if PEN_SSE
+#include <emmintrin.h>
+#endif
+
+namespace put
+{
+    namespace mips
+    {
+        namespace
+        {
+            static const u32 k_max_levels = 32;
+            static const u32 k_max_taps = 16;
+            static const f32 k_kaiser_radius = 1.5f; // in texels of the level being generated
+            static const f32 k_kaiser_alpha = 4.0f;
+            static const u32 k_srgb_lut = 4096;
+
+            enum e_channel_type
+            {
+                CHANNEL_U8,
+                CHANNEL_F16,
+                CHANNEL_F32
+            };
+
+            struct format_info
+            {
+                u32 channels;
+                u32 type;
+                u32 block_size;
+            };
+
+            struct u8_tables
+            {
+                f32 unorm[256];
+                f32 srgb[256];
+                f32 srgb_round[255];       // linear values half way between consecutive srgb values
+                u8  srgb_start[k_srgb_lut]; // srgb value at the bottom of each step of linear 0-1
+
+                u8_tables()
+                {
+                    for (u32 i = 0; i < 256; ++i)
+                    {
+                        unorm[i] = (f32)i / 255.0f;
+                        srgb[i] = srgb_to_linear((f32)i / 255.0f);
+                    }
+
+                    for (u32 i = 0; i < 255; ++i)
+                        srgb_round[i] = srgb_to_linear(((f32)i + 0.5f) / 255.0f);
+
+                    u32 k = 0;
+                    for (u32 i = 0; i < k_srgb_lut; ++i)
+                    {
+                        f32 f = (f32)i / (f32)(k_srgb_lut - 1);
+                        while (k < 255 && srgb_round[k] <= f)
+                            ++k;
+
+                        srgb_start[i] = (u8)k;
+                    }
+                }
+
+                static f32 srgb_to_linear(f32 c)
+                {
+                    if (c <= 0.04045f)
+                        return c / 12.92f;
+
+                    return powf((c + 0.055f) / 1.055f, 2.4f);
+                }
+            };
+
+            struct axis_taps
+            {
+                u32  num_taps = 0;
+                u32* index = nullptr; // num_taps per texel of the level being generated, unused taps have weight 0
+                f32* weight = nullptr;
+            };
+
+            struct level_job
+            {
+                const mip_params* params;
+                format_info       fi;
+                const f32*        decode[4]; // u8 lookup per channel
+                bool              encode_srgb[4];
+                const u8_tables*  tables;
+                const u8*         src;
+                u8*               dst;
+                u32               chain_size; // bytes between the chains of array slices or cube faces
+                u32               src_dim[3];
+                u32               dst_dim[3];
+                axis_taps         taps[3];
+                bool              pairs_u8; // 8 bit box or max with every axis halved or 1, integer path
+            };
+
+            bool get_format_info(u32 format, format_info& fi)
+            {
+                switch (format)
+                {
+                    case PEN_TEX_FORMAT_RGBA8_UNORM:
+                    case PEN_TEX_FORMAT_BGRA8_UNORM:
+                        fi = {4, CHANNEL_U8, 4};
+                        return true;
+                    case PEN_TEX_FORMAT_R8_UNORM:
+                        fi = {1, CHANNEL_U8, 1};
+                        return true;
+                    case PEN_TEX_FORMAT_R16G16B16A16_FLOAT:
+                        fi = {4, CHANNEL_F16, 8};
+                        return true;
+                    case PEN_TEX_FORMAT_R16_FLOAT:
+                        fi = {1, CHANNEL_F16, 2};
+                        return true;
+                    case PEN_TEX_FORMAT_R32G32B32A32_FLOAT:
+                        fi = {4, CHANNEL_F32, 16};
+                        return true;
+                    case PEN_TEX_FORMAT_R32G32_FLOAT:
+                        fi = {2, CHANNEL_F32, 8};
+                        return true;
+                    case PEN_TEX_FORMAT_R32_FLOAT:
+                        fi = {1, CHANNEL_F32, 4};
+                        return true;
+                }
+
+                return false;
+            }
+
+            const u8_tables& get_u8_tables()
+            {
+                static u8_tables s_tables;
+                return s_tables;
+            }
+
+            f32 bessel_i0(f32 x)
+            {
+                f32 sum = 1.0f;
+                f32 term = 1.0f;
+                f32 hx = x * 0.5f;
+
+                for (u32 k = 1; k < 32; ++k)
+                {
+                    term *= (hx / (f32)k) * (hx / (f32)k);
+                    sum += term;
+
+                    if (term < sum * 1e-7f)
+                        break;
+                }
+
+                return sum;
+            }
+
+            f32 kaiser_sinc(f32 d)
+            {
+                f32 t = d / k_kaiser_radius;
+                f32 window = bessel_i0(k_kaiser_alpha * sqrtf(std::max(1.0f - t * t, 0.0f))) / bessel_i0(k_kaiser_alpha);
+
+                if (fabsf(d) < 1e-5f)
+                    return window;
+
+                f32 pd = (f32)M_PI * d;
+                return window * sinf(pd) / pd;
+            }
+
+            void build_taps(axis_taps& at, u32 src, u32 dst, u32 filter)
+            {
+                u32* index = (u32*)pen::memory_alloc(dst * k_max_taps * sizeof(u32));
+                f32* weight = (f32*)pen::memory_alloc(dst * k_max_taps * sizeof(f32));
+                u32* count = (u32*)pen::memory_alloc(dst * sizeof(u32));
+
+                f32 scale = (f32)src / (f32)dst;
+                u32 num_taps = 1;
+
+                for (u32 x = 0; x < dst; ++x)
+                {
+                    u32* xi = &index[x * k_max_taps];
+                    f32* xw = &weight[x * k_max_taps];
+                    u32  n = 0;
+
+                    if (src == dst)
+                    {
+                        xi[0] = x;
+                        xw[0] = 1.0f;
+                        n = 1;
+                    }
+                    else if (filter == FILTER_KAISER)
+                    {
+                        f32 c = ((f32)x + 0.5f) * scale;
+                        f32 r = k_kaiser_radius * scale;
+                        s32 i0 = (s32)floorf(c - r);
+                        s32 i1 = (s32)ceilf(c + r);
+                        f32 sum = 0.0f;
+
+                        for (s32 i = i0; i < i1 && n < k_max_taps; ++i)
+                        {
+                            f32 d = ((f32)i + 0.5f - c) / scale;
+                            if (fabsf(d) >= k_kaiser_radius)
+                                continue;
+
+                            // clamp addressing, the edge texel takes the weight of the taps outside
+                            xi[n] = (u32)std::min(std::max(i, 0), (s32)src - 1);
+                            xw[n] = kaiser_sinc(d);
+                            sum += xw[n];
+                            ++n;
+                        }
+
+                        for (u32 k = 0; k < n; ++k)
+                            xw[k] /= sum;
+                    }
+                    else
+                    {
+                        // box and max, the share of each source texel covered by the footprint
+                        f32 lo = (f32)x * scale;
+                        f32 hi = (f32)(x + 1) * scale;
+
+                        for (u32 i = (u32)floorf(lo); i < (u32)ceilf(hi) && i < src && n < k_max_taps; ++i)
+                        {
+                            f32 w = std::min(hi, (f32)(i + 1)) - std::max(lo, (f32)i);
+                            if (w <= 0.0f)
+                                continue;
+
+                            xi[n] = i;
+                            xw[n] = w / scale;
+                            ++n;
+                        }
+                    }
+
+                    count[x] = n;
+                    num_taps = std::max(num_taps, n);
+                }
+
+                // compact to the widest texel, padding taps repeat the first with no weight
+                at.num_taps = num_taps;
+                at.index = (u32*)pen::memory_alloc(dst * num_taps * sizeof(u32));
+                at.weight = (f32*)pen::memory_alloc(dst * num_taps * sizeof(f32));
+
+                for (u32 x = 0; x < dst; ++x)
+                {
+                    for (u32 k = 0; k < num_taps; ++k)
+                    {
+                        bool used = k < count[x];
+                        at.index[x * num_taps + k] = index[x * k_max_taps + (used ? k : 0)];
+                        at.weight[x * num_taps + k] = used ? weight[x * k_max_taps + k] : 0.0f;
+                    }
+                }
+
+                pen::memory_free(index);
+                pen::memory_free(weight);
+                pen::memory_free(count);
+            }
+
+            void free_taps(axis_taps& at)
+            {
+                pen::memory_free(at.index);
+                pen::memory_free(at.weight);
+                at.index = nullptr;
+                at.weight = nullptr;
+            }
+
+            inline u8 encode_unorm8(f32 f)
+            {
+                return (u8)(std::min(std::max(f, 0.0f), 1.0f) * 255.0f + 0.5f);
+            }
+
+            inline u8 encode_srgb8(const u8_tables& t, f32 f)
+            {
+                // nearest srgb value is the count of midpoints at or below f, the lut is at most a step or two short
+                f = std::min(std::max(f, 0.0f), 1.0f);
+
+                u32 k = t.srgb_start[(u32)(f * (f32)(k_srgb_lut - 1))];
+                while (k < 255 && t.srgb_round[k] <= f)
+                    ++k;
+
+                return (u8)k;
+            }
+
+            void decode_row(const level_job& job, const u8* src, u32 count, f32* out)
+            {
+                const u32 ch = job.fi.channels;
+
+                switch (job.fi.type)
+                {
+                    case CHANNEL_U8:
+                        for (u32 t = 0, i = 0; t < count; ++t)
+                            for (u32 c = 0; c < ch; ++c, ++i)
+                                out[i] = job.decode[c][src[i]];
+                        break;
+                    case CHANNEL_F16:
+                    {
+                        const f16* h = (const f16*)src;
+                        for (u32 i = 0; i < count * ch; ++i)
+                            out[i] = half_to_float(h[i]);
+                    }
+                    break;
+                    case CHANNEL_F32:
+                        memcpy(out, src, count * ch * sizeof(f32));
+                        break;
+                }
+            }
+
+            void encode_row(const level_job& job, const f32* acc, u32 count, u8* dst)
+            {
+                const u32 ch = job.fi.channels;
+
+                switch (job.fi.type)
+                {
+                    case CHANNEL_U8:
+                        for (u32 t = 0, i = 0; t < count; ++t)
+                            for (u32 c = 0; c < ch; ++c, ++i)
+                                dst[i] = job.encode_srgb[c] ? encode_srgb8(*job.tables, acc[i]) : encode_unorm8(acc[i]);
+                        break;
+                    case CHANNEL_F16:
+                    {
+                        f16* h = (f16*)dst;
+                        for (u32 i = 0; i < count * ch; ++i)
+                            h[i] = float_to_half(acc[i]);
+                    }
+                    break;
+                    case CHANNEL_F32:
+                        memcpy(dst, acc, count * ch * sizeof(f32));
+                        break;
+                }
+            }
+
+            // fixed channel counts so the inner loops unroll and vectorise
+            template <u32 CH>
+            void filter_columns(const axis_taps& tx, u32 count, const f32* row, f32* acc)
+            {
+                const u32 nt = tx.num_taps;
+
+                for (u32 x = 0; x < count; ++x)
+                {
+                    f32 a[CH] = {0};
+
+                    for (u32 k = 0; k < nt; ++k)
+                    {
+                        const f32  wx = tx.weight[x * nt + k];
+                        const f32* p = &row[tx.index[x * nt + k] * CH];
+
+                        for (u32 c = 0; c < CH; ++c)
+                            a[c] += wx * p[c];
+                    }
+
+                    for (u32 c = 0; c < CH; ++c)
+                        acc[x * CH + c] = a[c];
+                }
+            }
+
+            template <u32 CH>
+            void max_columns(const axis_taps& tx, u32 count, const f32* row, f32* acc)
+            {
+                const u32 nt = tx.num_taps;
+
+                for (u32 x = 0; x < count; ++x)
+                {
+                    f32 a[CH];
+                    for (u32 c = 0; c < CH; ++c)
+                        a[c] = -FLT_MAX;
+
+                    for (u32 k = 0; k < nt; ++k)
+                    {
+                        if (tx.weight[x * nt + k] == 0.0f)
+                            continue;
+
+                        const f32* p = &row[tx.index[x * nt + k] * CH];
+
+                        for (u32 c = 0; c < CH; ++c)
+                            a[c] = std::max(a[c], p[c]);
+                    }
+
+                    for (u32 c = 0; c < CH; ++c)
+                        acc[x * CH + c] = a[c];
+                }
+            }
+
+            // source rows are combined vertically first so the horizontal taps run once per destination row
+            template <u32 CH>
+            void filter_row(const level_job& job, const u8* src, u32 y, u32 z, f32* row, f32* vrow, f32* acc, u8* dst)
+            {
+                const axis_taps& ty = job.taps[1];
+                const axis_taps& tz = job.taps[2];
+
+                const u32 sw = job.src_dim[0];
+                const u32 sh = job.src_dim[1];
+                const u32 bs = job.fi.block_size;
+                const u32 n = sw * CH;
+
+                bool max_filter = job.params->filter == FILTER_MAX;
+                std::fill(vrow, vrow + n, max_filter ? -FLT_MAX : 0.0f);
+
+                for (u32 kz = 0; kz < tz.num_taps; ++kz)
+                {
+                    f32 wz = tz.weight[z * tz.num_taps + kz];
+                    u32 iz = tz.index[z * tz.num_taps + kz];
+
+                    for (u32 ky = 0; ky < ty.num_taps; ++ky)
+                    {
+                        f32 w = wz * ty.weight[y * ty.num_taps + ky];
+                        u32 iy = ty.index[y * ty.num_taps + ky];
+
+                        if (w == 0.0f)
+                            continue;
+
+                        decode_row(job, src + (iz * sh + iy) * sw * bs, sw, row);
+
+                        if (max_filter)
+                        {
+                            for (u32 i = 0; i < n; ++i)
+                                vrow[i] = std::max(vrow[i], row[i]);
+                        }
+                        else
+                        {
+                            for (u32 i = 0; i < n; ++i)
+                                vrow[i] += w * row[i];
+                        }
+                    }
+                }
+
+                if (max_filter)
+                    max_columns<CH>(job.taps[0], job.dst_dim[0], vrow, acc);
+                else
+                    filter_columns<CH>(job.taps[0], job.dst_dim[0], vrow, acc);
+
+                encode_row(job, acc, job.dst_dim[0], dst);
+            }
+
+            // box or max of 1, 2 or 4 source rows with each pair of texels in a row combined, in integers
+            void pairs_row_u8(const level_job& job, const u8** rows, u32 num_rows, u8* dst)
+            {
+                const u32 ch = job.fi.channels;
+                const u32 dw = job.dst_dim[0];
+                const u32 n = num_rows * 2;
+                const u32 shift = n == 8 ? 3 : n == 4 ? 2 : 1;
+
+                bool max_filter = job.params->filter == FILTER_MAX;
+                u32  x = 0;
+
+#if PEN_SSE
+                if (ch == 4)
+                {
+                    __m128i zero = _mm_setzero_si128();
+                    __m128i rnd = _mm_set1_epi16((short)(n / 2));
+                    __m128i sh = _mm_cvtsi32_si128((int)shift);
+
+                    // 4 source texels to 2 destination texels per iteration
+                    for (; x + 2 <= dw; x += 2)
+                    {
+                        if (max_filter)
+                        {
+                            __m128i m = _mm_loadu_si128((const __m128i*)(rows[0] + x * 8));
+                            for (u32 r = 1; r < num_rows; ++r)
+                                m = _mm_max_epu8(m, _mm_loadu_si128((const __m128i*)(rows[r] + x * 8)));
+
+                            // pairs into dwords 0 and 2, then packed into the low half
+                            m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+                            m = _mm_shuffle_epi32(m, _MM_SHUFFLE(3, 1, 2, 0));
+                            _mm_storel_epi64((__m128i*)(dst + x * 4), m);
+                            continue;
+                        }
+
+                        __m128i lo = zero;
+                        __m128i hi = zero;
+                        for (u32 r = 0; r < num_rows; ++r)
+                        {
+                            __m128i v = _mm_loadu_si128((const __m128i*)(rows[r] + x * 8));
+                            lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+                            hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+                        }
+
+                        // lo holds source texels 0 and 1, hi 2 and 3, sum each pair into the low half
+                        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+                        __m128i sum = _mm_unpacklo_epi64(lo, hi);
+                        sum = _mm_srl_epi16(_mm_add_epi16(sum, rnd), sh);
+                        _mm_storel_epi64((__m128i*)(dst + x * 4), _mm_packus_epi16(sum, sum));
+                    }
+                }
+#endif
+
+                for (; x < dw; ++x)
+                {
+                    for (u32 c = 0; c < ch; ++c)
+                    {
+                        u32 a = 0;
+                        for (u32 r = 0; r < num_rows; ++r)
+                        {
+                            u32 t0 = rows[r][x * 2 * ch + c];
+                            u32 t1 = rows[r][(x * 2 + 1) * ch + c];
+
+                            if (max_filter)
+                                a = std::max(a, std::max(t0, t1));
+                            else
+                                a += t0 + t1;
+                        }
+
+                        dst[x * ch + c] = max_filter ? (u8)a : (u8)((a + n / 2) >> shift);
+                    }
+                }
+            }
+
+            void filter_rows(u32 start, u32 end, void* user_data)
+            {
+                const level_job& job = *(const level_job*)user_data;
+
+                const u32 ch = job.fi.channels;
+                const u32 bs = job.fi.block_size;
+                const u32 sw = job.src_dim[0];
+                const u32 sh = job.src_dim[1];
+                const u32 dw = job.dst_dim[0];
+                const u32 dh = job.dst_dim[1];
+                const u32 rows_per_chain = dh * job.dst_dim[2];
+
+                f32* row = nullptr;
+                f32* vrow = nullptr;
+                f32* acc = nullptr;
+                if (!job.pairs_u8)
+                {
+                    row = (f32*)pen::memory_alloc(sw * ch * sizeof(f32));
+                    vrow = (f32*)pen::memory_alloc(sw * ch * sizeof(f32));
+                    acc = (f32*)pen::memory_alloc(dw * ch * sizeof(f32));
+                }
+
+                for (u32 i = start; i < end; ++i)
+                {
+                    u32 chain = i / rows_per_chain;
+                    u32 z = (i % rows_per_chain) / dh;
+                    u32 y = (i % rows_per_chain) % dh;
+
+                    const u8* src = job.src + chain * job.chain_size;
+                    u8*       dst = job.dst + chain * job.chain_size + (z * dh + y) * dw * bs;
+
+                    if (job.pairs_u8)
+                    {
+                        const axis_taps& ty = job.taps[1];
+                        const axis_taps& tz = job.taps[2];
+
+                        const u8* rows[4];
+                        u32       num_rows = 0;
+
+                        for (u32 kz = 0; kz < tz.num_taps; ++kz)
+                        {
+                            for (u32 ky = 0; ky < ty.num_taps; ++ky)
+                            {
+                                u32 iz = tz.index[z * tz.num_taps + kz];
+                                u32 iy = ty.index[y * ty.num_taps + ky];
+                                rows[num_rows++] = src + (iz * sh + iy) * sw * bs;
+                            }
+                        }
+
+                        pairs_row_u8(job, rows, num_rows, dst);
+                        continue;
+                    }
+
+                    switch (ch)
+                    {
+                        case 1:
+                            filter_row<1>(job, src, y, z, row, vrow, acc, dst);
+                            break;
+                        case 2:
+                            filter_row<2>(job, src, y, z, row, vrow, acc, dst);
+                            break;
+                        default:
+                            filter_row<4>(job, src, y, z, row, vrow, acc, dst);
+                            break;
+                    }
+                }
+
+                pen::memory_free(row);
+                pen::memory_free(vrow);
+                pen::memory_free(acc);
+            }
+        } // namespace
+
+        bool supported(u32 format)
+        {
+            format_info fi;
+            return get_format_info(format, fi);
+        }
+
+        u32 num_levels(u32 width, u32 height, u32 depth)
+        {
+            u32 m = std::max(std::max(width, height), depth);
+
+            u32 n = 1;
+            while (m > 1)
+            {
+                m >>= 1;
+                ++n;
+            }
+
+            return n;
+        }
+
+        bool generate(pen::texture_creation_params& tcp, const mip_params& params, mip_stats* stats)
+        {
+            format_info fi;
+            if (!get_format_info(tcp.format, fi) || tcp.num_mips > 1 || tcp.pixels_per_block > 1)
+                return false;
+
+            f32 start = pen::get_time_ms();
+
+            // volumes are one chain of 3d levels, arrays and cubemaps a chain of 2d levels per slice or face
+            bool volume = tcp.collection_type == pen::TEXTURE_COLLECTION_VOLUME;
+            u32  num_chains = volume ? 1 : std::max<u32>(tcp.num_arrays, 1);
+            u32  depth = volume ? std::max<u32>(tcp.num_arrays, 1) : 1;
+
+            u32 num_mips = std::min(num_levels(tcp.width, tcp.height, depth), k_max_levels);
+
+            u32 dims[k_max_levels][3];
+            u32 offsets[k_max_levels + 1];
+
+            offsets[0] = 0;
+            for (u32 l = 0; l < num_mips; ++l)
+            {
+                dims[l][0] = std::max<u32>(tcp.width >> l, 1);
+                dims[l][1] = std::max<u32>(tcp.height >> l, 1);
+                dims[l][2] = std::max<u32>(depth >> l, 1);
+
+                offsets[l + 1] = offsets[l] + dims[l][0] * dims[l][1] * dims[l][2] * fi.block_size;
+            }
+
+            u32 top_size = offsets[1];
+            u32 chain_size = offsets[num_mips];
+
+            if (tcp.data_size < top_size * num_chains)
+                return false;
+
+            u8* data = (u8*)pen::memory_alloc(chain_size * num_chains);
+
+            for (u32 c = 0; c < num_chains; ++c)
+                memcpy(data + c * chain_size, (u8*)tcp.data + c * top_size, top_size);
+
+            const u8_tables& tables = get_u8_tables();
+
+            level_job job;
+            job.params = &params;
+            job.fi = fi;
+            job.tables = &tables;
+            job.chain_size = chain_size;
+
+            for (u32 c = 0; c < 4; ++c)
+            {
+                bool srgb = (params.flags & MIP_SRGB) && c < 3;
+                job.decode[c] = srgb ? tables.srgb : tables.unorm;
+                job.encode_srgb[c] = srgb;
+            }
+
+            u32 num_texels = 0;
+
+            for (u32 l = 1; l < num_mips; ++l)
+            {
+                job.src = data + offsets[l - 1];
+                job.dst = data + offsets[l];
+
+                bool pairs = fi.type == CHANNEL_U8 && !(params.flags & MIP_SRGB) && params.filter != FILTER_KAISER;
+
+                for (u32 a = 0; a < 3; ++a)
+                {
+                    job.src_dim[a] = dims[l - 1][a];
+                    job.dst_dim[a] = dims[l][a];
+
+                    u32 filter = params.filter == FILTER_KAISER ? FILTER_KAISER : FILTER_BOX;
+                    build_taps(job.taps[a], job.src_dim[a], job.dst_dim[a], filter);
+
+                    bool halved = job.src_dim[a] == job.dst_dim[a] * 2;
+                    pairs &= halved || (a > 0 && job.src_dim[a] == job.dst_dim[a]);
+                }
+
+                job.pairs_u8 = pairs;
+
+                u32 num_rows = num_chains * dims[l][1] * dims[l][2];
+                u32 grain = std::max<u32>(4096 / dims[l][0], 1);
+                pen::jobs_parallel_for(num_rows, grain, filter_rows, &job);
+
+                for (u32 a = 0; a < 3; ++a)
+                    free_taps(job.taps[a]);
+
+                num_texels += dims[l][0] * dims[l][1] * dims[l][2] * num_chains;
+            }
+
+            tcp.data = data;
+            tcp.data_size = chain_size * num_chains;
+            tcp.num_mips = num_mips;
+            tcp.block_size = fi.block_size;
+
+            if (stats)
+            {
+                stats->num_mips = num_mips;
+                stats->num_texels = num_texels;
+                stats->ms = pen::get_time_ms() - start;
+            }
+
+            return true;
+        }
+    } // namespace mips
+} // namespace put
@@ -0,0 +1,57 @@
+// mip_generator.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "pen.h"
+#include "renderer.h"
+
+// Mip chain generation for uncompressed 2d, array, cube and volume textures on the worker pool.
+// Each level is filtered from the one above it, the rows of every slice, face or depth slice of a level are split across
+// the workers. Texels are decoded to float per channel, 8 bit channels through lookup tables so srgb colour can be
+// filtered in linear space and rounded back to the nearest srgb value, half and float channels are filtered as is.
+// Filters are separable with weights precomputed per axis, so odd sizes are handled by the footprint of each texel
+// rather than dropping the last row or column. Box and max on linear 8 bit textures with even sizes stay in integers,
+// with an sse path for 4 channel formats.
+// Levels are half the size of the level above clamped to 1, until every axis is 1.
+
+namespace put
+{
+    namespace mips
+    {
+        enum e_filter
+        {
+            FILTER_BOX,    // average of the texels under each texel of the next level
+            FILTER_KAISER, // kaiser windowed sinc, 6 taps per axis when halving, sharper than box
+            FILTER_MAX     // per channel max of the box footprint, keeps volume occupancy in alpha at every level
+        };
+
+        enum e_mip_flags
+        {
+            MIP_SRGB = 1 // rgb of 8 bit formats is srgb encoded, alpha is always linear
+        };
+
+        struct mip_params
+        {
+            u32 filter = FILTER_BOX;
+            u32 flags = 0;
+        };
+
+        struct mip_stats
+        {
+            u32 num_mips = 0;
+            u32 num_texels = 0; // texels written to the generated levels
+            f32 ms = 0.0f;
+        };
+
+        bool supported(u32 format);
+        u32  num_levels(u32 width, u32 height, u32 depth);
+
+        // tcp must contain only the top level of each array slice or face, or the top level of a volume.
+        // on success tcp.data is replaced with a new allocation holding the full chains in the layout the renderer
+        // expects and num_mips and data_size are updated, the previous tcp.data is left for the caller to free.
+        // returns false and leaves tcp unchanged for compressed or unsupported formats
+        bool generate(pen::texture_creation_params& tcp, const mip_params& params = mip_params(), mip_stats* stats = nullptr);
+    } // namespace mips
+} // namespace put
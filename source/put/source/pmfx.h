@@ -60,6 +60,11 @@ namespace put
         hash_id id_name = 0;
 
         void (*render_function)(const scene_view&) = nullptr;
+
+        // can be recorded on a worker thread alongside other views and array slices, slice 0 of a view is always
+        // recorded before the rest. render functions must not create resources, the first frame after a load or
+        // request_serial_recording is recorded on the user thread as a fallback
+        bool thread_safe = false;
     };
 
     struct technique_constant_data
@@ -90,6 +95,8 @@ namespace put
 {
     namespace pmfx
     {
+        struct render_graph;
+
         enum e_constant_widget
         {
             CW_SLIDER,
@@ -187,7 +194,10 @@ namespace put
             RT_AUX = 1 << 1,
             RT_AUX_USED = 1 << 2,
             RT_WRITE_ONLY = 1 << 3,
-            RT_RESOLVE = 1 << 4
+            RT_RESOLVE = 1 << 4,
+            RT_TRANSIENT = 1 << 5,         // contents only needed between views in a frame.. may be culled or aliased
+            RT_ALIASED = 1 << 6,           // shares its handle with other transient targets
+            RT_DYNAMIC_RESOLUTION = 1 << 7 // ratio target drawn into a sub rect at the dynamic scale
         };
 
         enum e_rt_mode
@@ -215,6 +225,7 @@ namespace put
             u32 pp = VRT_READ;
             u32 pp_read = PEN_INVALID_HANDLE;
             u32 collection = pen::TEXTURE_COLLECTION_NONE;
+            hash_id hash = 0; // json definition, an unchanged target keeps its handle over a hot reload
         };
 
         struct rt_resize_params
@@ -228,6 +239,18 @@ namespace put
             const c8* format = nullptr;
         };
 
+        struct dynamic_resolution_params
+        {
+            bool enabled = false;
+            f32  target_ms = 16.6f;     // gpu frame time to hold, falls back to cpu present time
+            f32  min_scale = 0.5f;      // of each axis
+            f32  max_scale = 1.0f;      // targets are never reallocated so this can not go over 1
+            f32  increase_step = 0.02f; // per change while comfortably under budget
+            f32  headroom = 0.85f;      // only scale up when frame time is under target_ms * headroom
+            f32  smoothing = 0.1f;      // weight of the newest frame time in the running average
+            u32  settle_frames = 8;     // frames to wait after a change before measuring the effect
+        };
+
         // pmfx renderer ---------------------------------------------------------------------------------------------------
 
         void init(const c8* filename);
@@ -238,6 +261,9 @@ namespace put
         void render();
         void render_view(hash_id id_name);
 
+        // the next frame records every view on the user thread, for scene changes which may create resources lazily
+        void request_serial_recording();
+
         void register_scene(ecs::ecs_scene* scene, const char* name);
         void register_camera(camera* cam, const char* name);
         void register_scene_view_renderer(const scene_view_renderer& svr);
@@ -248,6 +274,10 @@ namespace put
 
         void set_view_set(const c8* name);
 
+        void                             set_dynamic_resolution(const dynamic_resolution_params& params);
+        const dynamic_resolution_params& get_dynamic_resolution_params();
+        f32                              get_dynamic_resolution_scale();
+
         camera*              get_camera(hash_id id_name);
         camera**             get_cameras(); // call sb_free on return value when done
         const render_target* get_render_target(hash_id h);
@@ -259,6 +289,9 @@ namespace put
 
         void fullscreen_quad(const scene_view& sv);
 
+        // compiled from the current view set, passes map 1:1 with views, see pmfx_render_graph.h
+        const render_graph& get_render_graph();
+
         // pmfx shader -----------------------------------------------------------------------------------------------------
 
         u32  load_shader(const c8* pmfx_name);
@@ -0,0 +1,394 @@
+// pmfx_render_graph.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "pmfx_render_graph.h"
+#include "data_struct.h"
+
+#include <algorithm>
+
+using namespace put;
+using namespace pmfx;
+
+namespace
+{
+    bool contains(const u32* list, u32 value)
+    {
+        u32 num = sb_count(list);
+        for (u32 i = 0; i < num; ++i)
+            if (list[i] == value)
+                return true;
+
+        return false;
+    }
+
+    void mark_temporal_resources(render_graph& rg)
+    {
+        // read before written in a frame means contents carry over from the previous frame, so the resource
+        // must stay allocated and its writers must not be culled
+        u32 num_passes = sb_count(rg.passes);
+        u32 num_resources = sb_count(rg.resources);
+
+        bool* written = nullptr;
+        for (u32 r = 0; r < num_resources; ++r)
+            sb_push(written, false);
+
+        for (u32 p = 0; p < num_passes; ++p)
+        {
+            rg_pass& pass = rg.passes[p];
+
+            u32 num_reads = sb_count(pass.reads);
+            for (u32 r = 0; r < num_reads; ++r)
+                if (!written[pass.reads[r]] && !contains(pass.writes, pass.reads[r]))
+                    rg.resources[pass.reads[r]].flags |= RG_RESOURCE_EXTERNAL;
+
+            u32 num_writes = sb_count(pass.writes);
+            for (u32 w = 0; w < num_writes; ++w)
+                written[pass.writes[w]] = true;
+        }
+
+        sb_free(written);
+    }
+
+    void cull_passes(render_graph& rg, bool cull)
+    {
+        u32 num_passes = sb_count(rg.passes);
+        u32 num_resources = sb_count(rg.resources);
+
+        if (!cull)
+        {
+            for (u32 p = 0; p < num_passes; ++p)
+                rg.passes[p].live = true;
+
+            return;
+        }
+
+        // walk backwards from external resources, a pass is live if something live consumes what it writes
+        bool* needed = nullptr;
+        for (u32 r = 0; r < num_resources; ++r)
+            sb_push(needed, (rg.resources[r].flags & RG_RESOURCE_EXTERNAL) != 0);
+
+        for (s32 p = num_passes - 1; p >= 0; --p)
+        {
+            rg_pass& pass = rg.passes[p];
+            pass.live = pass.flags & RG_PASS_SIDE_EFFECTS;
+
+            u32 num_writes = sb_count(pass.writes);
+            for (u32 w = 0; w < num_writes; ++w)
+                pass.live |= needed[pass.writes[w]];
+
+            if (!pass.live)
+                continue;
+
+            u32 num_reads = sb_count(pass.reads);
+            for (u32 r = 0; r < num_reads; ++r)
+                needed[pass.reads[r]] = true;
+        }
+
+        sb_free(needed);
+    }
+
+    void compute_lifetimes(render_graph& rg)
+    {
+        u32 num_passes = sb_count(rg.passes);
+        u32 num_resources = sb_count(rg.resources);
+
+        for (u32 r = 0; r < num_resources; ++r)
+        {
+            rg.resources[r].first_use = -1;
+            rg.resources[r].last_use = -1;
+            rg.resources[r].physical = PEN_INVALID_HANDLE;
+        }
+
+        for (u32 p = 0; p < num_passes; ++p)
+        {
+            rg_pass& pass = rg.passes[p];
+            if (!pass.live)
+                continue;
+
+            for (u32 a = 0; a < 2; ++a)
+            {
+                u32* list = a == 0 ? pass.reads : pass.writes;
+                u32  num = sb_count(list);
+                for (u32 i = 0; i < num; ++i)
+                {
+                    rg_resource& res = rg.resources[list[i]];
+
+                    if (res.first_use == -1)
+                        res.first_use = p;
+
+                    res.last_use = p;
+                }
+            }
+        }
+    }
+
+    void alias_resources(render_graph& rg, bool alias)
+    {
+        struct physical_slot
+        {
+            u32     owner;
+            hash_id alias_key;
+            s32     last_use;
+        };
+
+        physical_slot* slots = nullptr;
+
+        // transient resources in order of first use, greedily placed in the first compatible free slot
+        u32 num_passes = sb_count(rg.passes);
+        u32 num_resources = sb_count(rg.resources);
+        for (u32 p = 0; p < num_passes; ++p)
+        {
+            for (u32 r = 0; r < num_resources; ++r)
+            {
+                rg_resource& res = rg.resources[r];
+                if (res.first_use != p)
+                    continue;
+
+                if (res.flags & RG_RESOURCE_EXTERNAL)
+                {
+                    res.physical = r;
+                    continue;
+                }
+
+                u32 num_slots = sb_count(slots);
+                u32 slot = PEN_INVALID_HANDLE;
+
+                if (alias)
+                {
+                    for (u32 s = 0; s < num_slots; ++s)
+                    {
+                        if (slots[s].alias_key != res.alias_key)
+                            continue;
+
+                        // strictly before, a pass reading a and writing b must not share memory
+                        if (slots[s].last_use < res.first_use)
+                        {
+                            slot = s;
+                            break;
+                        }
+                    }
+                }
+
+                if (!is_valid(slot))
+                {
+                    physical_slot ps;
+                    ps.owner = r;
+                    ps.alias_key = res.alias_key;
+                    ps.last_use = res.last_use;
+                    sb_push(slots, ps);
+                    slot = num_slots;
+                }
+
+                slots[slot].last_use = res.last_use;
+                res.physical = slots[slot].owner;
+            }
+        }
+
+        // external resources are always allocated even if no live pass touches them
+        for (u32 r = 0; r < num_resources; ++r)
+            if (rg.resources[r].flags & RG_RESOURCE_EXTERNAL)
+                rg.resources[r].physical = r;
+
+        sb_free(slots);
+    }
+
+    void batch_passes(render_graph& rg)
+    {
+        u32 num_passes = sb_count(rg.passes);
+        u32 num_resources = sb_count(rg.resources);
+
+        // first batch after the last writer and the last reader of each physical resource
+        u32* after_write = nullptr;
+        u32* after_read = nullptr;
+        for (u32 r = 0; r < num_resources; ++r)
+        {
+            sb_push(after_write, 0);
+            sb_push(after_read, 0);
+        }
+
+        for (u32 p = 0; p < num_passes; ++p)
+        {
+            rg_pass& pass = rg.passes[p];
+            pass.batch = 0;
+
+            if (!pass.live)
+                continue;
+
+            // read after write, write after write and write after read all order the pass
+            u32 num_reads = sb_count(pass.reads);
+            for (u32 r = 0; r < num_reads; ++r)
+            {
+                u32 phys = rg.resources[pass.reads[r]].physical;
+                if (is_valid(phys))
+                    pass.batch = std::max<u32>(pass.batch, after_write[phys]);
+            }
+
+            u32 num_writes = sb_count(pass.writes);
+            for (u32 w = 0; w < num_writes; ++w)
+            {
+                u32 phys = rg.resources[pass.writes[w]].physical;
+                if (is_valid(phys))
+                    pass.batch = std::max<u32>(pass.batch, std::max<u32>(after_write[phys], after_read[phys]));
+            }
+
+            for (u32 r = 0; r < num_reads; ++r)
+            {
+                u32 phys = rg.resources[pass.reads[r]].physical;
+                if (is_valid(phys))
+                    after_read[phys] = std::max<u32>(after_read[phys], pass.batch + 1);
+            }
+
+            for (u32 w = 0; w < num_writes; ++w)
+            {
+                u32 phys = rg.resources[pass.writes[w]].physical;
+                if (is_valid(phys))
+                    after_write[phys] = pass.batch + 1;
+            }
+        }
+
+        sb_free(after_write);
+        sb_free(after_read);
+    }
+
+    void compute_stats(render_graph& rg)
+    {
+        render_graph_stats& st = rg.stats;
+        st = render_graph_stats();
+
+        u32 num_passes = sb_count(rg.passes);
+        u32 num_resources = sb_count(rg.resources);
+
+        st.num_passes = num_passes;
+        st.num_resources = num_resources;
+
+        for (u32 p = 0; p < num_passes; ++p)
+        {
+            if (!rg.passes[p].live)
+            {
+                st.culled_passes++;
+                continue;
+            }
+
+            st.num_batches = std::max<u32>(st.num_batches, rg.passes[p].batch + 1);
+        }
+
+        for (u32 r = 0; r < num_resources; ++r)
+        {
+            const rg_resource& res = rg.resources[r];
+            st.declared_bytes += res.size_bytes;
+
+            if (!(res.flags & RG_RESOURCE_EXTERNAL))
+                st.transient_resources++;
+
+            if (res.first_use != -1 || res.flags & RG_RESOURCE_EXTERNAL)
+                st.live_bytes += res.size_bytes;
+
+            if (res.physical == r)
+            {
+                st.physical_resources++;
+                st.aliased_bytes += res.size_bytes;
+            }
+        }
+
+        for (u32 p = 0; p < num_passes; ++p)
+        {
+            size_t alive = 0;
+            for (u32 r = 0; r < num_resources; ++r)
+            {
+                const rg_resource& res = rg.resources[r];
+                if (res.flags & RG_RESOURCE_EXTERNAL || (res.first_use <= (s32)p && res.last_use >= (s32)p))
+                    alive += res.size_bytes;
+            }
+
+            if (alive > st.peak_bytes)
+                st.peak_bytes = alive;
+        }
+    }
+} // namespace
+
+namespace put
+{
+    namespace pmfx
+    {
+        u32 render_graph_find_resource(const render_graph& rg, hash_id id_name)
+        {
+            u32 num_resources = sb_count(rg.resources);
+            for (u32 r = 0; r < num_resources; ++r)
+                if (rg.resources[r].id_name == id_name)
+                    return r;
+
+            return PEN_INVALID_HANDLE;
+        }
+
+        u32 render_graph_add_resource(render_graph& rg, hash_id id_name, u32 flags, hash_id alias_key, size_t size_bytes)
+        {
+            u32 existing = render_graph_find_resource(rg, id_name);
+            if (is_valid(existing))
+            {
+                rg.resources[existing].flags |= flags;
+                return existing;
+            }
+
+            rg_resource res;
+            res.id_name = id_name;
+            res.flags = flags;
+            res.alias_key = alias_key;
+            res.size_bytes = size_bytes;
+
+            sb_push(rg.resources, res);
+            return sb_count(rg.resources) - 1;
+        }
+
+        u32 render_graph_add_pass(render_graph& rg, hash_id id_name, u32 flags)
+        {
+            rg_pass pass;
+            pass.id_name = id_name;
+            pass.flags = flags;
+
+            sb_push(rg.passes, pass);
+            return sb_count(rg.passes) - 1;
+        }
+
+        void render_graph_read(render_graph& rg, u32 pass, u32 resource)
+        {
+            if (!is_valid(resource) || contains(rg.passes[pass].reads, resource))
+                return;
+
+            sb_push(rg.passes[pass].reads, resource);
+        }
+
+        void render_graph_write(render_graph& rg, u32 pass, u32 resource)
+        {
+            if (!is_valid(resource) || contains(rg.passes[pass].writes, resource))
+                return;
+
+            sb_push(rg.passes[pass].writes, resource);
+        }
+
+        void render_graph_compile(render_graph& rg, u32 compile_flags)
+        {
+            mark_temporal_resources(rg);
+            cull_passes(rg, compile_flags & RG_COMPILE_CULL);
+            compute_lifetimes(rg);
+            alias_resources(rg, compile_flags & RG_COMPILE_ALIAS);
+            batch_passes(rg);
+            compute_stats(rg);
+        }
+
+        void render_graph_release(render_graph& rg)
+        {
+            u32 num_passes = sb_count(rg.passes);
+            for (u32 p = 0; p < num_passes; ++p)
+            {
+                sb_free(rg.passes[p].reads);
+                sb_free(rg.passes[p].writes);
+            }
+
+            sb_free(rg.passes);
+            sb_free(rg.resources);
+
+            rg = render_graph();
+        }
+    } // namespace pmfx
+} // namespace put
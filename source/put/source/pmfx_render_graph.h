@@ -0,0 +1,91 @@
+// pmfx_render_graph.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "types.h"
+
+// Render graph compiled from pmfx views.
+// Passes declare the resources they read and write, compile derives each resource's lifetime from those bindings,
+// culls passes whose outputs are never consumed and assigns transient resources with non overlapping lifetimes and
+// compatible descriptions (alias_key) to the same physical resource.
+// Live passes are then levelled into batches, a pass goes in the batch after the last one which touched the same
+// physical memory, so every pass in a batch can be recorded at the same time.
+// This is pure cpu logic with no renderer calls, pmfx_renderer applies the result to its render targets and views.
+
+namespace put
+{
+    namespace pmfx
+    {
+        enum e_rg_resource_flags
+        {
+            RG_RESOURCE_EXTERNAL = 1 << 0 // visible outside of the graph (backbuffer, cpu read, read by code).. never culled or aliased
+        };
+
+        enum e_rg_pass_flags
+        {
+            RG_PASS_SIDE_EFFECTS = 1 << 0 // pass has effects the graph cannot see and is never culled
+        };
+
+        enum e_rg_compile_flags
+        {
+            RG_COMPILE_CULL = 1 << 0,
+            RG_COMPILE_ALIAS = 1 << 1
+        };
+
+        struct rg_resource
+        {
+            hash_id id_name = 0;
+            u32     flags = 0;
+            hash_id alias_key = 0; // resources can only alias others with the same key
+            size_t  size_bytes = 0;
+
+            // compiled
+            s32 first_use = -1;
+            s32 last_use = -1;
+            u32 physical = PEN_INVALID_HANDLE; // index of the resource which owns the memory, invalid if unused
+        };
+
+        struct rg_pass
+        {
+            hash_id id_name = 0;
+            u32     flags = 0;
+            u32*    reads = nullptr;  // resource indices
+            u32*    writes = nullptr; // resource indices
+
+            // compiled
+            bool live = true;
+            u32  batch = 0; // passes in the same batch do not depend on each other and can be recorded concurrently
+        };
+
+        struct render_graph_stats
+        {
+            u32    num_passes = 0;
+            u32    culled_passes = 0;
+            u32    num_resources = 0;
+            u32    transient_resources = 0;
+            u32    physical_resources = 0;
+            size_t declared_bytes = 0; // every resource allocated for the whole session
+            size_t live_bytes = 0;     // resources used by live passes
+            size_t aliased_bytes = 0;  // physical resources after aliasing
+            size_t peak_bytes = 0;     // max bytes alive at any one pass, lower bound for aliasing
+            u32    num_batches = 0;
+        };
+
+        struct render_graph
+        {
+            rg_resource*       resources = nullptr;
+            rg_pass*           passes = nullptr;
+            render_graph_stats stats;
+        };
+
+        u32  render_graph_add_resource(render_graph& rg, hash_id id_name, u32 flags, hash_id alias_key, size_t size_bytes);
+        u32  render_graph_add_pass(render_graph& rg, hash_id id_name, u32 flags);
+        u32  render_graph_find_resource(const render_graph& rg, hash_id id_name);
+        void render_graph_read(render_graph& rg, u32 pass, u32 resource);
+        void render_graph_write(render_graph& rg, u32 pass, u32 resource);
+        void render_graph_compile(render_graph& rg, u32 compile_flags);
+        void render_graph_release(render_graph& rg);
+    } // namespace pmfx
+} // namespace put
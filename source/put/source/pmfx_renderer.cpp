@@ -15,7 +15,9 @@
 #include "pen_json.h"
 #include "pen_string.h"
 #include "pmfx.h"
+#include "pmfx_render_graph.h"
 #include "str_utilities.h"
+#include "threads.h"
 #include "timer.h"
 
 #include <fstream>
@@ -52,7 +54,9 @@ namespace
         VF_ABSTRACT = (1<<3),       // abstract views can be used to render view templates, to perform multi-pass rendering.
         VF_RESOLVE = (1<<4),        // after view has completed, render targets are resolved.
         VF_GENERATE_MIPS = (1 << 5),// generate mip maps for the render target after resolving
-        VF_COMPUTE = (1<<6)         // runs a compute job instead of render job
+        VF_COMPUTE = (1<<6),        // runs a compute job instead of render job
+        VF_CULLED = (1<<7),         // render graph found nothing consumes the views output
+        VF_DYNAMIC_RESOLUTION = (1<<8) // all targets are dynamic resolution, viewport shrinks with the scale
     };
 
     struct mode_map
@@ -156,6 +160,9 @@ namespace
     
     const mode_map render_flags_map[] = {
         "forward_lit", ecs::RENDER_FORWARD_LIT,
+        "clustered_lit", ecs::RENDER_CLUSTERED_LIT,
+        "occlusion_cull", ecs::RENDER_OCCLUSION_CULL,
+        "shadow_casters", ecs::RENDER_SHADOW_CASTERS,
         nullptr, 0
     };
     
@@ -190,6 +197,7 @@ namespace
         put::camera*    camera;
 
         std::vector<void (*)(const put::scene_view&)> render_functions;
+        bool                                          thread_safe = false; // all render functions can record on workers
 
         // targets
         u32 render_targets[pen::MAX_MRT] = {PEN_INVALID_HANDLE, PEN_INVALID_HANDLE, PEN_INVALID_HANDLE, PEN_INVALID_HANDLE,
@@ -319,6 +327,58 @@ namespace
     std::vector<filter_kernel>           s_filter_kernels;
     geometry_utility                     s_geometry;
 
+    // Hot Reload
+    struct reload_stats
+    {
+        u32 kept = 0;     // states and targets taken over from the previous load
+        u32 replaced = 0; // edited in place with renderer_replace_resource
+        u32 created = 0;
+        u32 released = 0;
+    };
+
+    std::vector<render_state>  s_prev_render_states;  // states from the previous load during a hot reload
+    std::vector<render_target> s_prev_render_targets; // targets from the previous load during a hot reload
+    u32*                       s_taken_handles = nullptr;
+    reload_stats               s_reload_stats;
+
+    // Render Graph
+    render_graph s_render_graph;
+    u32          s_render_graph_flags = RG_COMPILE_CULL | RG_COMPILE_ALIAS;
+
+    // Parallel Recording
+    struct recording_stats
+    {
+        u32 num_views = 0;
+        u32 parallel_views = 0;
+        u32 parallel_slices = 0;
+        u32 num_cmd_lists = 0;
+        u32 num_batches = 0;
+        f32 record_ms = 0.0f;
+    };
+
+    bool             s_parallel_recording = true;
+    u32              s_frames_since_load = 0; // first frame after a load or scene change records on the user thread
+    std::vector<u32> s_cmd_lists;
+    recording_stats  s_recording_stats;
+
+    // Dynamic Resolution
+    const u32 k_dynamic_resolution_history = 120;
+
+    struct dynamic_resolution_state
+    {
+        dynamic_resolution_params params;
+        f32                       scale = 1.0f;
+        f32                       applied_scale = 1.0f; // scale written into view sampler info
+        f32                       frame_ms = 0.0f;      // smoothed
+        u32                       settle = 0;
+        u32                       num_changes = 0;
+        f32                       scale_history[k_dynamic_resolution_history] = {0};
+        f32                       ms_history[k_dynamic_resolution_history] = {0};
+        u32                       history_pos = 0;
+    };
+
+    dynamic_resolution_state s_dynamic_resolution;
+
     // ids
 } // namespace
 
@@ -376,6 +436,101 @@ namespace put
             vp_out = {vp_in[0] * w, vp_in[1] * h, vp_in[2] * w, vp_in[3] * h, 0.0f, 1.0f};
         }
 
+        vec2f get_dynamic_resolution_uv_scale(f32 w, f32 h, f32 scale)
+        {
+            // whole pixels so the viewport drawn and the uvs of anything sampling it agree
+            if (w <= 0.0f || h <= 0.0f)
+                return vec2f::one();
+
+            return vec2f(std::max(floorf(w * scale), 1.0f) / w, std::max(floorf(h * scale), 1.0f) / h);
+        }
+
+        vec2f get_dynamic_resolution_uv_scale(const render_target* rt, f32 scale)
+        {
+            if (!(rt->flags & RT_DYNAMIC_RESOLUTION))
+                return vec2f::one();
+
+            f32 w, h;
+            get_rt_dimensions(rt->width, rt->height, rt->ratio, w, h);
+            return get_dynamic_resolution_uv_scale(w, h, scale);
+        }
+
+        void apply_dynamic_resolution(view_params& v, f32 scale)
+        {
+            u32 num = v.sampler_bindings.size();
+            for (u32 i = 0; i < num; ++i)
+            {
+                const render_target* rt = get_render_target(v.sampler_bindings[i].id_texture);
+                if (!rt)
+                    continue;
+
+                vec2f uv_scale = get_dynamic_resolution_uv_scale(rt, scale);
+                v.sampler_info[i].z = uv_scale.x;
+                v.sampler_info[i].w = uv_scale.y;
+            }
+
+            for (auto& pv : v.post_process_views)
+                apply_dynamic_resolution(pv, scale);
+        }
+
+        void update_dynamic_resolution()
+        {
+            dynamic_resolution_state&        dr = s_dynamic_resolution;
+            const dynamic_resolution_params& p = dr.params;
+
+            f32 cpu_ms, gpu_ms;
+            pen::renderer_get_present_time(cpu_ms, gpu_ms);
+
+            f32 ms = gpu_ms > 0.0f ? gpu_ms : cpu_ms;
+            dr.frame_ms = dr.frame_ms > 0.0f ? dr.frame_ms + (ms - dr.frame_ms) * p.smoothing : ms;
+
+            f32 max_scale = std::min(p.max_scale, 1.0f);
+            f32 min_scale = std::min(p.min_scale, max_scale);
+            f32 scale = dr.scale;
+
+            if (!p.enabled)
+            {
+                scale = 1.0f;
+            }
+            else if (dr.settle > 0)
+            {
+                // the average still holds frames drawn at the old scale
+                dr.settle--;
+            }
+            else if (dr.frame_ms > p.target_ms)
+            {
+                // pixel cost goes with area, so each axis shrinks by the root of how far over budget we are
+                scale *= sqrtf(p.target_ms / dr.frame_ms);
+            }
+            else if (dr.frame_ms < p.target_ms * p.headroom)
+            {
+                scale += p.increase_step;
+            }
+
+            if (p.enabled)
+                scale = std::max(std::min(scale, max_scale), min_scale);
+
+            if (scale != dr.scale)
+            {
+                dr.scale = scale;
+                dr.settle = p.settle_frames;
+            }
+
+            dr.scale_history[dr.history_pos] = dr.scale;
+            dr.ms_history[dr.history_pos] = ms;
+            dr.history_pos = (dr.history_pos + 1) % k_dynamic_resolution_history;
+
+            // targets keep their allocation, only viewports and sampler uv scales change
+            if (dr.scale != dr.applied_scale)
+            {
+                dr.applied_scale = dr.scale;
+                dr.num_changes++;
+
+                for (auto& v : s_views)
+                    apply_dynamic_resolution(v, dr.scale);
+            }
+        }
+
         u32 mode_from_string(const mode_map* map, const c8* str, u32 default_value)
         {
             if (!str)
@@ -412,6 +567,67 @@ namespace put
             return nullptr;
         }
 
+        bool is_handle_taken(u32 handle)
+        {
+            u32 num = sb_count(s_taken_handles);
+            for (u32 i = 0; i < num; ++i)
+                if (s_taken_handles[i] == handle)
+                    return true;
+
+            return false;
+        }
+
+        bool reuse_render_state(render_state& rs)
+        {
+            // during a hot reload take over a state from the previous load with identical creation params
+            for (auto& ps : s_prev_render_states)
+            {
+                if (ps.type != rs.type || ps.hash != rs.hash)
+                    continue;
+
+                if (is_handle_taken(ps.handle))
+                    continue;
+
+                rs.handle = ps.handle;
+                sb_push(s_taken_handles, ps.handle);
+                s_reload_stats.kept++;
+                return true;
+            }
+
+            return false;
+        }
+
+        void replace_render_state(render_state& rs)
+        {
+            static const pen::e_renderer_resource k_resource_type[] = {
+                pen::RESOURCE_RASTER_STATE, pen::RESOURCE_SAMPLER_STATE, pen::RESOURCE_BLEND_STATE,
+                pen::RESOURCE_DEPTH_STENCIL_STATE};
+
+            s_reload_stats.created++;
+
+            // an edited state swaps into the handle of the state with the same name so anything caching it
+            // (ie. sampler bindings in the ecs) stays valid, handles shared between duplicate states are left alone
+            for (auto& ps : s_prev_render_states)
+            {
+                if (ps.type != rs.type || ps.id_name != rs.id_name)
+                    continue;
+
+                if (is_handle_taken(ps.handle))
+                    return;
+
+                for (auto& other : s_prev_render_states)
+                    if (&other != &ps && other.handle == ps.handle)
+                        return;
+
+                pen::renderer_replace_resource(ps.handle, rs.handle, k_resource_type[rs.type]);
+
+                rs.handle = ps.handle;
+                sb_push(s_taken_handles, ps.handle);
+                s_reload_stats.replaced++;
+                return;
+            }
+        }
+
         render_state* _get_render_state(hash_id id_name, u32 type)
         {
             size_t num = s_render_states.size();
@@ -555,6 +771,11 @@ namespace put
                 vp.sampler_info[i].x = 1.0f / w;
                 vp.sampler_info[i].y = 1.0f / h;
 
+                // uv scale of the area drawn, a pass sampling scaled targets into a full size one is the upscale
+                vec2f uv_scale = get_dynamic_resolution_uv_scale(rt, s_dynamic_resolution.applied_scale);
+                vp.sampler_info[i].z = uv_scale.x;
+                vp.sampler_info[i].w = uv_scale.y;
+
                 bindings.push_back(sb);
             }
         }
@@ -609,10 +830,11 @@ namespace put
 					rs.handle = existing_state->handle;
 					rs.copy = true;
 				}
-				else
-				{
-					rs.handle = pen::renderer_create_sampler(scp);
-				}
+                else if (!reuse_render_state(rs))
+                {
+                    rs.handle = pen::renderer_create_sampler(scp);
+                    replace_render_state(rs);
+                }
 
                 s_render_states.push_back(rs);
             }
@@ -654,10 +876,11 @@ namespace put
 					rs.handle = existing_state->handle;
 					rs.copy = true;
 				}
-				else
-				{
-					rs.handle = pen::renderer_create_rasterizer_state(rcp);
-				}
+                else if (!reuse_render_state(rs))
+                {
+                    rs.handle = pen::renderer_create_rasterizer_state(rcp);
+                    replace_render_state(rs);
+                }
 
                 s_render_states.push_back(rs);
             }
@@ -670,6 +893,19 @@ namespace put
         };
         static std::vector<partial_blend_state> s_partial_blend_states;
 
+        hash_id hash_blend_state(const pen::blend_creation_params& bcp)
+        {
+            pen::hash_murmur hm;
+            hm.begin();
+            hm.add(&bcp.alpha_to_coverage_enable, sizeof(bcp.alpha_to_coverage_enable));
+            hm.add(&bcp.independent_blend_enable, sizeof(bcp.independent_blend_enable));
+            hm.add(&bcp.num_render_targets, sizeof(bcp.num_render_targets));
+            for (u32 i = 0; i < bcp.num_render_targets; ++i)
+                hm.add(&bcp.render_targets[i], sizeof(bcp.render_targets[i]));
+
+            return hm.end();
+        }
+
         void parse_partial_blend_states(pen::json& render_config)
         {
             pen::json j_blend_states = render_config["blend_states"];
@@ -714,9 +950,15 @@ namespace put
                 rs.name = state.name();
                 rs.id_name = PEN_HASH(state.name().c_str());
                 rs.type = RS_BLEND;
-                rs.handle = pen::renderer_create_blend_state(bcp);
+                rs.hash = hash_blend_state(bcp);
 				rs.copy = false;
 
+                if (!reuse_render_state(rs))
+                {
+                    rs.handle = pen::renderer_create_blend_state(bcp);
+                    replace_render_state(rs);
+                }
+
                 s_render_states.push_back(rs);
             }
         }
@@ -791,10 +1033,11 @@ namespace put
 					rs.handle = existing_state->handle;
 					rs.copy = true;
 				}
-				else
-				{
-					rs.handle = pen::renderer_create_depth_stencil_state(dscp);
-				}
+                else if (!reuse_render_state(rs))
+                {
+                    rs.handle = pen::renderer_create_depth_stencil_state(dscp);
+                    replace_render_state(rs);
+                }
 
                 s_render_states.push_back(rs);
             }
@@ -939,15 +1182,7 @@ namespace put
                 bcp.render_targets[i].render_target_write_mask = masks[i];
             }
 
-            pen::hash_murmur hm;
-            hm.begin();
-            hm.add(&bcp.alpha_to_coverage_enable, sizeof(bcp.alpha_to_coverage_enable));
-            hm.add(&bcp.independent_blend_enable, sizeof(bcp.independent_blend_enable));
-            hm.add(&bcp.num_render_targets, sizeof(bcp.num_render_targets));
-            for (s32 i = 0; i < num_rt; ++i)
-                hm.add(&bcp.render_targets[i], sizeof(bcp.render_targets[i]));
-
-            hash_id hh = hm.end();
+            hash_id hh = hash_blend_state(bcp);
 
             render_state rs;
             rs.hash = hh;
@@ -962,10 +1197,11 @@ namespace put
 				rs.handle = existing_state->handle;
 				rs.copy = true;
 			}
-			else
-			{
-				rs.handle = pen::renderer_create_blend_state(bcp);
-			}
+            else if (!reuse_render_state(rs))
+            {
+                rs.handle = pen::renderer_create_blend_state(bcp);
+                replace_render_state(rs);
+            }
 
             s_render_states.push_back(rs);
 
@@ -1004,6 +1240,62 @@ namespace put
             s_render_target_tcp.push_back(texture_creation_params());
         }
 
+        bool reuse_render_target(render_target& rt, pen::texture_creation_params& tcp)
+        {
+            for (auto& prt : s_prev_render_targets)
+            {
+                if (prt.id_name != rt.id_name || prt.hash != rt.hash)
+                    continue;
+
+                if (!is_valid(prt.handle) || is_handle_taken(prt.handle))
+                    continue;
+
+                // the previous target may have been resized since it was created from json
+                rt.handle = prt.handle;
+                rt.width = prt.width;
+                rt.height = prt.height;
+                rt.format = prt.format;
+                rt.num_mips = prt.num_mips;
+                rt.num_arrays = prt.num_arrays;
+                rt.collection = prt.collection;
+
+                tcp.width = prt.width;
+                tcp.height = prt.height;
+                tcp.format = prt.format;
+                tcp.num_mips = prt.num_mips;
+                tcp.num_arrays = prt.num_arrays;
+                tcp.collection_type = prt.collection;
+
+                sb_push(s_taken_handles, prt.handle);
+                s_reload_stats.kept++;
+                return true;
+            }
+
+            return false;
+        }
+
+        void replace_render_target(render_target& rt)
+        {
+            s_reload_stats.created++;
+
+            // edited targets keep the handle of the target with the same name, aliased targets share handles
+            for (auto& prt : s_prev_render_targets)
+            {
+                if (prt.id_name != rt.id_name)
+                    continue;
+
+                if (!is_valid(prt.handle) || is_handle_taken(prt.handle) || (prt.flags & RT_ALIASED))
+                    return;
+
+                pen::renderer_replace_resource(prt.handle, rt.handle, pen::RESOURCE_RENDER_TARGET);
+
+                rt.handle = prt.handle;
+                sb_push(s_taken_handles, prt.handle);
+                s_reload_stats.replaced++;
+                return;
+            }
+        }
+
         void parse_render_targets(const pen::json& render_config, Str* include_targets)
         {
             pen::json j_render_targets = render_config["render_targets"];
@@ -1144,6 +1436,21 @@ namespace put
                             new_info.flags |= RT_AUX;
                         }
 
+                        // transient targets can be culled or aliased by the render graph, anything the cpu or
+                        // post process ping-pong touches needs its own memory for the whole session
+                        if (r["transient"].as_bool(false))
+                        {
+                            bool persistent = tcp.cpu_access_flags || (new_info.flags & RT_AUX);
+                            persistent |= r["always_create"].as_bool(false);
+
+                            if (!persistent)
+                                new_info.flags |= RT_TRANSIENT;
+                        }
+
+                        // ratio targets can be drawn into a sub rect of themselves to shed load without resizing
+                        if (new_info.ratio != 0 && r["dynamic_resolution"].as_bool(false))
+                            new_info.flags |= RT_DYNAMIC_RESOLUTION;
+
                         hash_id idr = r["init_read"].as_hash_id();
                         u32     hr = 0;
                         if (idr != 0)
@@ -1172,8 +1479,13 @@ namespace put
                         tcp.sample_quality = 0;
 
                         new_info.samples = tcp.sample_count;
+                        new_info.hash = PEN_HASH(r.dumps());
 
-                        new_info.handle = pen::renderer_create_render_target(tcp);
+                        if (!reuse_render_target(new_info, tcp))
+                        {
+                            new_info.handle = pen::renderer_create_render_target(tcp);
+                            replace_render_target(new_info);
+                        }
                     }
                 }
             }
@@ -1193,6 +1505,11 @@ namespace put
             return nullptr;
         }
 
+        const render_graph& get_render_graph()
+        {
+            return s_render_graph;
+        }
+
         void resize_render_target(hash_id target, const rt_resize_params& params)
         {
             u32       width = params.width;
@@ -1266,7 +1583,31 @@ namespace put
             tcp.collection_type = params.collection;
 
             u32 h = pen::renderer_create_render_target(tcp);
-            pen::renderer_replace_resource(current_target->handle, h, pen::RESOURCE_RENDER_TARGET);
+
+            if (current_target->flags & RT_ALIASED)
+            {
+                // stop aliasing, views which use this target by name get their own copy
+                for (auto& v : s_views)
+                {
+                    for (u32 i = 0; i < v.num_colour_targets; ++i)
+                        if (v.id_render_target[i] == target)
+                            v.render_targets[i] = h;
+
+                    if (v.id_depth_target == target)
+                        v.depth_target = h;
+
+                    for (auto& sb : v.sampler_bindings)
+                        if (sb.id_texture == target)
+                            sb.handle = h;
+                }
+
+                current_target->handle = h;
+                current_target->flags &= ~RT_ALIASED;
+            }
+            else
+            {
+                pen::renderer_replace_resource(current_target->handle, h, pen::RESOURCE_RENDER_TARGET);
+            }
 
             current_target->width = width;
             current_target->height = height;
@@ -1356,6 +1697,10 @@ namespace put
                 s_views[i].rt_height = target_h;
                 s_views[i].rt_ratio = target_r;
             }
+
+            // whole pixel rounding of the dynamic scale depends on the window size
+            for (auto& v : s_views)
+                apply_dynamic_resolution(v, s_dynamic_resolution.applied_scale);
         }
 
         void get_render_target_dimensions(const render_target* rt, f32& w, f32& h)
@@ -1520,6 +1865,7 @@ namespace put
                 new_view.view_flags |= mode_from_string(k_view_types, view["type"].as_cstr(), 0);
 
                 u32 depth_target_index = -1;
+                u32 num_dynamic_targets = 0;
                 for (s32 t = 0; t < num_targets; ++t)
                 {
                     Str     target_str = targets[t].as_str();
@@ -1542,6 +1888,9 @@ namespace put
                                 new_view.view_flags |= VF_CUBEMAP;
                             }
 
+                            if (r.flags & RT_DYNAMIC_RESOLUTION)
+                                num_dynamic_targets++;
+
                             if (cur_rt == 0)
                             {
                                 new_view.rt_width = w;
@@ -1587,6 +1936,10 @@ namespace put
                     }
                 }
 
+                // views writing a mix of scaled and full size targets draw at full size
+                if (num_targets > 0 && num_dynamic_targets == num_targets)
+                    new_view.view_flags |= VF_DYNAMIC_RESOLUTION;
+
                 parse_clear_colour(view, new_view, num_targets);
 
                 // resolve
@@ -1746,6 +2099,7 @@ namespace put
 
                 // scene views
                 pen::json scene_views = view["scene_views"];
+                new_view.thread_safe = scene_views.size() > 0;
                 for (s32 ii = 0; ii < scene_views.size(); ++ii)
                 {
                     hash_id id = scene_views[ii].as_hash_id();
@@ -1756,6 +2110,7 @@ namespace put
                         {
                             found = true;
                             new_view.render_functions.push_back(sv.render_function);
+                            new_view.thread_safe &= sv.thread_safe;
                         }
                     }
 
@@ -2296,69 +2651,267 @@ namespace put
             }
         }
 
-        void load_script_internal(const c8* filename)
+        render_target* find_render_target(hash_id id_name)
         {
-            pen::renderer_consume_cmd_buffer();
-            create_geometry_utilities();
+            for (auto& rt : s_render_targets)
+                if (rt.id_name == id_name)
+                    return &rt;
 
-            void* config_data;
-            u32   config_data_size;
+            return nullptr;
+        }
 
-            pen_error err = pen::filesystem_read_file_to_buffer(filename, &config_data, config_data_size);
+        size_t get_render_target_size_bytes(const render_target& rt)
+        {
+            f32 w, h;
+            get_rt_dimensions(rt.width, rt.height, rt.ratio, w, h);
 
-            if (err != PEN_ERR_OK || config_data_size == 0)
+            s32 byte_size = 0;
+            for (s32 f = 0; f < PEN_ARRAY_SIZE(rt_format); ++f)
             {
-                // failed load file
-                pen::memory_free(config_data);
-                dev_console_log_level(dev_ui::CONSOLE_ERROR, "[error] pmfx - failed to open %s'", filename);
-                return;
+                if (rt_format[f].format == rt.format)
+                {
+                    byte_size = rt_format[f].block_size / 8;
+                    break;
+                }
             }
 
-            // load render config
-            pen::json render_config = pen::json::load((const c8*)config_data);
+            size_t image_size = (size_t)(byte_size * w * h) * std::max<u32>(rt.num_arrays, 1);
 
-            // add includes
-            u32 num_includes = render_config["include"].size();
-            for (u32 i = 0; i < num_includes; ++i)
-            {
-                Str include_filename = render_config["include"][i].as_str();
+            // msaa has an extra resolve surface
+            if (rt.samples > 1)
+                image_size = image_size * rt.samples + image_size;
 
-                Str config_path = (const c8*)config_data;
-                config_path = pen::str_normalise_filepath(filename);
+            // full mip chain adds roughly a third
+            if (rt.num_mips > 1)
+                image_size += image_size / 3;
 
-                u32 last_dir = pen::str_find_reverse(config_path, "/");
-                Str include_dir = pen::str_substr(config_path, 0, last_dir + 1);
+            return image_size;
+        }
 
-                include_dir.append(include_filename.c_str());
+        hash_id get_render_target_alias_key(const render_target& rt)
+        {
+            pen::hash_murmur hm;
+            hm.begin(0);
+            hm.add(rt.width);
+            hm.add(rt.height);
+            hm.add(rt.ratio);
+            hm.add(rt.format);
+            hm.add(rt.samples);
+            hm.add(rt.num_mips);
+            hm.add(rt.num_arrays);
+            hm.add(rt.collection);
+            return hm.end();
+        }
 
-                pen::json include_json = pen::json::load_from_file(include_dir.c_str());
+        void pin_render_target_handle(u32 handle)
+        {
+            if (!is_valid(handle))
+                return;
 
-                render_config = pen::json::combine(include_json, render_config);
-            }
+            for (auto& rt : s_render_targets)
+            {
+                if (rt.handle != handle)
+                    continue;
 
-            // add main_colour and main_depth backbuffer target
-            add_backbuffer_targets();
-            load_always_create_render_targets(render_config); // load render targets with always_create
+                u32 r = render_graph_find_resource(s_render_graph, rt.id_name);
+                if (is_valid(r))
+                    s_render_graph.resources[r].flags |= RG_RESOURCE_EXTERNAL;
+            }
+        }
 
-            // parse info
-            parse_sampler_states(render_config);
-            parse_raster_states(render_config);
-            parse_depth_stencil_states(render_config);
-            parse_partial_blend_states(render_config);
-            parse_filters(render_config);
+        void pin_view_targets(const view_params& v)
+        {
+            for (u32 i = 0; i < v.num_colour_targets; ++i)
+                pin_render_target_handle(v.render_targets[i]);
 
-            pen::renderer_consume_cmd_buffer();
+            pin_render_target_handle(v.depth_target);
 
-            pen::json j_views = render_config["views"];
-            pen::json j_view_sets = render_config["view_sets"];
+            for (auto& sb : v.sampler_bindings)
+                pin_render_target_handle(sb.handle);
 
-            s_view_set_name = render_config["view_set"].as_str();
-            if (!s_edited_view_set_name.empty())
-                s_view_set_name = s_edited_view_set_name;
+            for (u32 i = 0; i < MAX_TECHNIQUE_SAMPLER_BINDINGS; ++i)
+                pin_render_target_handle(v.technique_samplers.sb[i].handle);
+        }
 
-            // get view set names
-            u32 num_view_sets = j_view_sets.size();
-            for (u32 i = 0; i < num_view_sets; ++i)
+        void remap_view_target_handles(u32 old_handle, u32 new_handle)
+        {
+            for (auto& v : s_views)
+            {
+                for (u32 i = 0; i < v.num_colour_targets; ++i)
+                    if (v.render_targets[i] == old_handle)
+                        v.render_targets[i] = new_handle;
+
+                if (v.depth_target == old_handle)
+                    v.depth_target = new_handle;
+
+                for (auto& sb : v.sampler_bindings)
+                    if (sb.handle == old_handle)
+                        sb.handle = new_handle;
+            }
+        }
+
+        void compile_render_graph()
+        {
+            render_graph_release(s_render_graph);
+            render_graph& rg = s_render_graph;
+
+            // resources, only targets marked transient are owned by the graph
+            for (auto& rt : s_render_targets)
+            {
+                u32 flags = rt.flags & RT_TRANSIENT ? 0 : RG_RESOURCE_EXTERNAL;
+                render_graph_add_resource(rg, rt.id_name, flags, get_render_target_alias_key(rt),
+                                          get_render_target_size_bytes(rt));
+            }
+
+            for (auto& rt : s_render_targets)
+                if (is_valid(rt.pp_read))
+                    pin_render_target_handle(s_render_targets[rt.pp_read].handle);
+
+            // passes map 1:1 with views
+            for (auto& v : s_views)
+            {
+                u32 flags = 0;
+
+                // templates are rendered out of order by abstract views, post process ping-pongs through virtual
+                // targets.. neither can be reasoned about here so they keep their targets alive
+                if (v.view_flags & (VF_TEMPLATE | VF_ABSTRACT | VF_COMPUTE))
+                    flags |= RG_PASS_SIDE_EFFECTS;
+
+                if (v.view_flags & VF_TEMPLATE)
+                    pin_view_targets(v);
+
+                if (v.post_process_flags & PP_ENABLED)
+                {
+                    flags |= RG_PASS_SIDE_EFFECTS;
+                    pin_view_targets(v);
+
+                    for (auto& pv : v.post_process_views)
+                        pin_view_targets(pv);
+                }
+
+                // technique samplers bind by handle only
+                for (u32 i = 0; i < MAX_TECHNIQUE_SAMPLER_BINDINGS; ++i)
+                    pin_render_target_handle(v.technique_samplers.sb[i].handle);
+
+                u32 p = render_graph_add_pass(rg, v.id_name, flags);
+
+                for (u32 i = 0; i < v.num_colour_targets; ++i)
+                    render_graph_write(rg, p, render_graph_find_resource(rg, v.id_render_target[i]));
+
+                if (v.id_depth_target)
+                    render_graph_write(rg, p, render_graph_find_resource(rg, v.id_depth_target));
+
+                for (auto& sb : v.sampler_bindings)
+                    render_graph_read(rg, p, render_graph_find_resource(rg, sb.id_texture));
+            }
+
+            render_graph_compile(rg, s_render_graph_flags);
+
+            // cull views
+            for (u32 i = 0; i < s_views.size(); ++i)
+                if (!rg.passes[i].live)
+                    s_views[i].view_flags |= VF_CULLED;
+
+            // alias targets, transient targets which are not used by any live view are released
+            u32 num_resources = sb_count(rg.resources);
+            for (u32 r = 0; r < num_resources; ++r)
+            {
+                rg_resource& res = rg.resources[r];
+                if (res.physical == r)
+                    continue;
+
+                render_target* rt = find_render_target(res.id_name);
+                if (!rt)
+                    continue;
+
+                u32 new_handle = PEN_INVALID_HANDLE;
+                if (is_valid(res.physical))
+                {
+                    render_target* owner = find_render_target(rg.resources[res.physical].id_name);
+                    owner->flags |= RT_ALIASED;
+                    new_handle = owner->handle;
+                }
+
+                pen::renderer_release_render_target(rt->handle);
+                remap_view_target_handles(rt->handle, new_handle);
+
+                rt->handle = new_handle;
+                rt->flags |= RT_ALIASED;
+            }
+
+            const render_graph_stats& st = rg.stats;
+            if (st.culled_passes || st.physical_resources < st.num_resources)
+            {
+                dev_console_log("[pmfx] render graph culled %i/%i views, %i/%i targets allocated, %.2f mb -> %.2f mb",
+                                st.culled_passes, st.num_passes, st.physical_resources, st.num_resources,
+                                (f32)st.declared_bytes / 1024.0f / 1024.0f, (f32)st.aliased_bytes / 1024.0f / 1024.0f);
+            }
+        }
+
+        void load_script_internal(const c8* filename)
+        {
+            pen::renderer_consume_cmd_buffer();
+            s_frames_since_load = 0;
+            create_geometry_utilities();
+
+            void* config_data;
+            u32   config_data_size;
+
+            pen_error err = pen::filesystem_read_file_to_buffer(filename, &config_data, config_data_size);
+
+            if (err != PEN_ERR_OK || config_data_size == 0)
+            {
+                // failed load file
+                pen::memory_free(config_data);
+                dev_console_log_level(dev_ui::CONSOLE_ERROR, "[error] pmfx - failed to open %s'", filename);
+                return;
+            }
+
+            // load render config
+            pen::json render_config = pen::json::load((const c8*)config_data);
+
+            // add includes
+            u32 num_includes = render_config["include"].size();
+            for (u32 i = 0; i < num_includes; ++i)
+            {
+                Str include_filename = render_config["include"][i].as_str();
+
+                Str config_path = (const c8*)config_data;
+                config_path = pen::str_normalise_filepath(filename);
+
+                u32 last_dir = pen::str_find_reverse(config_path, "/");
+                Str include_dir = pen::str_substr(config_path, 0, last_dir + 1);
+
+                include_dir.append(include_filename.c_str());
+
+                pen::json include_json = pen::json::load_from_file(include_dir.c_str());
+
+                render_config = pen::json::combine(include_json, render_config);
+            }
+
+            // add main_colour and main_depth backbuffer target
+            add_backbuffer_targets();
+            load_always_create_render_targets(render_config); // load render targets with always_create
+
+            // parse info
+            parse_sampler_states(render_config);
+            parse_raster_states(render_config);
+            parse_depth_stencil_states(render_config);
+            parse_partial_blend_states(render_config);
+            parse_filters(render_config);
+
+            pen::renderer_consume_cmd_buffer();
+
+            pen::json j_views = render_config["views"];
+            pen::json j_view_sets = render_config["view_sets"];
+
+            s_view_set_name = render_config["view_set"].as_str();
+            if (!s_edited_view_set_name.empty())
+                s_view_set_name = s_edited_view_set_name;
+
+            // get view set names
+            u32 num_view_sets = j_view_sets.size();
+            for (u32 i = 0; i < num_view_sets; ++i)
             {
                 s_view_sets.push_back(j_view_sets[i].name());
             }
@@ -2441,6 +2994,8 @@ namespace put
                 }
             }
 
+            compile_render_graph();
+
             pen::renderer_consume_cmd_buffer();
 
             // rebake material handles
@@ -2458,43 +3013,13 @@ namespace put
             PEN_SYSTEM(build_cmd.c_str());
         }
 
-        void pmfx_config_hotload()
+        void release_render_states(std::vector<render_state>& states)
         {
-            // wait a bit and flush the gpu
-            for (u32 i = 0; i < 6; ++i)
+            for (auto& rs : states)
             {
-                pen::renderer_present();
-                pen::renderer_consume_cmd_buffer();
-            }
-
-            release_script_resources();
-
-            for (auto& s : k_script_files)
-                load_script_internal(s.c_str());
-        }
-
-        void pmfx_config_hotload(std::vector<hash_id>& dirty)
-        {
-            pmfx_config_hotload();
-        }
-
-        void init(const c8* filename)
-        {
-            load_script_internal(filename);
-
-            k_script_files.push_back(filename);
-
-            put::add_file_watcher(filename, pmfx_config_build, pmfx_config_hotload);
-        }
-
-        void release_script_resources()
-        {
-            for (auto& rs : s_render_states)
-            {
-				if (rs.copy)
-					continue;
-
-				// PEN_LOG("release state %i : %s (%i)\n", rs.type, rs.name.c_str(), rs.handle);
+                // copies share a handle with another state, taken handles live on in the current load
+                if (rs.copy || is_handle_taken(rs.handle))
+                    continue;
 
                 switch (rs.type)
                 {
@@ -2511,10 +3036,18 @@ namespace put
                         pen::renderer_release_depth_stencil_state(rs.handle);
                         break;
                 }
+
+                s_reload_stats.released++;
             }
 
-            // release render targets
-            for (auto& rt : s_render_targets)
+            states.clear();
+        }
+
+        void release_render_targets(std::vector<render_target>& targets)
+        {
+            // release render targets, aliased targets share handles and culled transient targets have none
+            u32* released = nullptr;
+            for (auto& rt : targets)
             {
                 if (rt.id_name == k_id_main_colour)
                     continue;
@@ -2522,9 +3055,27 @@ namespace put
                 if (rt.id_name == k_id_main_depth)
                     continue;
 
+                if (!is_valid(rt.handle) || is_handle_taken(rt.handle))
+                    continue;
+
+                bool shared = false;
+                for (u32 i = 0; i < sb_count(released); ++i)
+                    shared |= released[i] == rt.handle;
+
+                if (shared)
+                    continue;
+
                 pen::renderer_release_render_target(rt.handle);
+                sb_push(released, rt.handle);
+                s_reload_stats.released++;
             }
+            sb_free(released);
 
+            targets.clear();
+        }
+
+        void clear_script_data()
+        {
             // release clear state and clear views
             for (auto& v : s_views)
             {
@@ -2541,6 +3092,75 @@ namespace put
             s_post_process_names.clear();
             s_virtual_rt.clear();
             s_partial_blend_states.clear();
+
+            render_graph_release(s_render_graph);
+        }
+
+        void pmfx_config_hotload()
+        {
+            static pen::timer* timer = pen::timer_create();
+            pen::timer_start(timer);
+
+            s_reload_stats = reload_stats();
+
+            // the previous load becomes a cache, anything re-declared with the same params is taken over as is
+            // and edited states or targets are swapped into their old handles, only the edit costs gpu work
+            std::swap(s_prev_render_states, s_render_states);
+            std::swap(s_prev_render_targets, s_render_targets);
+
+            clear_script_data();
+
+            for (auto& s : k_script_files)
+                load_script_internal(s.c_str());
+
+            // anything left over is no longer referenced by the config, wait for the gpu before releasing it
+            bool flush = false;
+            for (auto& rs : s_prev_render_states)
+                flush |= !rs.copy && !is_handle_taken(rs.handle);
+
+            for (auto& rt : s_prev_render_targets)
+                flush |= is_valid(rt.handle) && !is_handle_taken(rt.handle);
+
+            if (flush)
+            {
+                for (u32 i = 0; i < 6; ++i)
+                {
+                    pen::renderer_present();
+                    pen::renderer_consume_cmd_buffer();
+                }
+            }
+
+            release_render_states(s_prev_render_states);
+            release_render_targets(s_prev_render_targets);
+
+            sb_free(s_taken_handles);
+            s_taken_handles = nullptr;
+
+            const reload_stats& st = s_reload_stats;
+            dev_console_log("[pmfx] hot reload kept %i, replaced %i, created %i, released %i resources in %.2f ms",
+                            st.kept, st.replaced, st.created - st.replaced, st.released, pen::timer_elapsed_ms(timer));
+        }
+
+        void pmfx_config_hotload(std::vector<hash_id>& dirty)
+        {
+            pmfx_config_hotload();
+        }
+
+        void init(const c8* filename)
+        {
+            load_script_internal(filename);
+
+            k_script_files.push_back(filename);
+
+            put::add_file_watcher(filename, pmfx_config_build, pmfx_config_hotload);
+        }
+
+        void release_script_resources()
+        {
+            release_render_states(s_render_states);
+            release_render_targets(s_render_targets);
+
+            clear_script_data();
         }
 
         void shutdown()
@@ -2712,55 +3332,67 @@ namespace put
                 pen::renderer_set_texture(0, 0, i, pen::TEXTURE_BIND_PS | pen::TEXTURE_BIND_VS);
         }
 
-        void render_view(view_params& v)
+        u32 s_cb_2d = PEN_INVALID_HANDLE;
+        u32 s_cb_sampler_info = PEN_INVALID_HANDLE;
+
+        void create_view_cbuffers()
         {
-            // compute doesnt need render pipeline setup
-            if(v.view_flags & VF_COMPUTE)
-            {
-                scene_view sv;
-                sv.scene = v.scene;
-                sv.render_flags = v.render_flags;
-                sv.technique = v.id_technique;
-                sv.camera = v.camera;
-                sv.pmfx_shader = v.pmfx_shader;
-                sv.permutation = v.technique_permutation;
-                
-                for (s32 rf = 0; rf < v.render_functions.size(); ++rf)
-                    v.render_functions[rf](sv);
-                
+            if (is_valid(s_cb_2d))
                 return;
-            }
-            
-            // render pipeline
-            
-            // early out.. nothing to render
-            if (v.num_colour_targets == 0 && v.depth_target == PEN_INVALID_HANDLE)
-                return;
-            
-            static u32 cb_2d = PEN_INVALID_HANDLE;
-            static u32 cb_sampler_info = PEN_INVALID_HANDLE;
-            if (!is_valid(cb_2d))
-            {
-                pen::buffer_creation_params bcp;
-                bcp.usage_flags = PEN_USAGE_DYNAMIC;
-                bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
-                bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-                bcp.buffer_size = sizeof(float) * 20;
-                bcp.data = (void*)nullptr;
 
-                cb_2d = pen::renderer_create_buffer(bcp);
+            pen::buffer_creation_params bcp;
+            bcp.usage_flags = PEN_USAGE_DYNAMIC;
+            bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
+            bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
+            bcp.buffer_size = sizeof(float) * 20;
+            bcp.data = (void*)nullptr;
 
-                bcp.buffer_size = sizeof(vec4f) * 16; // 16 samplers worth, x = 1.0 / width, y = 1.0 / height
-                cb_sampler_info = pen::renderer_create_buffer(bcp);
-            }
+            s_cb_2d = pen::renderer_create_buffer(bcp);
+
+            bcp.buffer_size = sizeof(vec4f) * 16; // 16 samplers worth, xy = 1.0 / width, height, zw = uv scale
+            s_cb_sampler_info = pen::renderer_create_buffer(bcp);
+        }
+
+        void render_compute_view(view_params& v)
+        {
+            scene_view sv;
+            sv.scene = v.scene;
+            sv.render_flags = v.render_flags;
+            sv.technique = v.id_technique;
+            sv.camera = v.camera;
+            sv.pmfx_shader = v.pmfx_shader;
+            sv.permutation = v.technique_permutation;
+
+            for (s32 rf = 0; rf < v.render_functions.size(); ++rf)
+                v.render_functions[rf](sv);
+        }
+
+        bool begin_view(view_params& v, pen::viewport& vp, scene_view& sv)
+        {
+            // early out.. nothing to render
+            if (v.num_colour_targets == 0 && v.depth_target == PEN_INVALID_HANDLE)
+                return false;
 
             // unbind samplers to stop validation layers complaining, render targets may still be bound on output.
             for (s32 i = 0; i < MAX_SAMPLER_BINDINGS; ++i)
                 pen::renderer_set_texture(0, 0, i, pen::TEXTURE_BIND_PS | pen::TEXTURE_BIND_VS);
 
             // render state
-            pen::viewport vp = {0};
+            vp = {0};
             get_rt_viewport(v.rt_width, v.rt_height, v.rt_ratio, v.viewport, vp);
+
+            if (v.view_flags & VF_DYNAMIC_RESOLUTION)
+            {
+                f32 w, h;
+                get_rt_dimensions(v.rt_width, v.rt_height, v.rt_ratio, w, h);
+
+                vec2f uv_scale = get_dynamic_resolution_uv_scale(w, h, s_dynamic_resolution.applied_scale);
+                vp.x *= uv_scale.x;
+                vp.y *= uv_scale.y;
+                vp.width *= uv_scale.x;
+                vp.height *= uv_scale.y;
+            }
+
             pen::renderer_set_viewport(vp);
             pen::renderer_set_scissor_rect({vp.x, vp.y, vp.width, vp.height});
             pen::renderer_set_depth_stencil_state(v.depth_stencil_state);
@@ -2772,10 +3404,9 @@ namespace put
             float W = 2.0f / vp.width;
             float H = 2.0f / vp.height;
             float mvp[4][4] = {{W, 0.0, 0.0, 0.0}, {0.0, H, 0.0, 0.0}, {0.0, 0.0, 1.0, 0.0}, {-1.0, -1.0, 0.0, 1.0}};
-            pen::renderer_update_buffer(cb_2d, mvp, sizeof(mvp), 0);
+            pen::renderer_update_buffer(s_cb_2d, mvp, sizeof(mvp), 0);
 
             // build scene view info
-            scene_view sv;
             sv.scene = v.scene;
             sv.render_flags = v.render_flags;
             sv.technique = v.id_technique;
@@ -2784,80 +3415,87 @@ namespace put
             sv.blend_state = v.blend_state;
             sv.camera = v.camera;
             sv.viewport = &vp;
-            sv.cb_2d_view = cb_2d;
+            sv.cb_2d_view = s_cb_2d;
             sv.pmfx_shader = v.pmfx_shader;
             sv.permutation = v.technique_permutation;
+            sv.num_arrays = v.num_arrays;
 
-            // render passes.. multi pass for cubemaps or arrays
-            for (u32 a = 0; a < v.num_arrays; ++a)
-            {
-                sv.array_index = a;
-                sv.num_arrays = v.num_arrays;
+            return true;
+        }
 
-                // generate 3d view proj matrix
-                if (v.camera)
-                {
-                    if (v.view_flags & VF_CUBEMAP)
-                        put::camera_set_cubemap_face(v.camera, a);
+        void render_view_slice(view_params& v, scene_view& sv, u32 a, put::camera* cam)
+        {
+            sv.array_index = a;
 
-                    put::camera_update_shader_constants(v.camera);
-                    sv.cb_view = v.camera->cbuffer;
-                }
-                else
-                {
-                    // this code path is untested.
-                    static put::camera c;
-                    put::camera_create_orthographic(&c, vp.x, vp.width, vp.y, vp.height, 0.0f, 1.0f);
-                    put::camera_update_shader_constants(&c);
-                    sv.cb_view = c.cbuffer;
-                }
+            // generate 3d view proj matrix
+            if (cam)
+            {
+                if (v.view_flags & VF_CUBEMAP)
+                    put::camera_set_cubemap_face(cam, a);
 
-                // bind targets before samplers..
-                // so that ping-pong buffers get unbound from rt before being bound on samplers
-                pen::renderer_set_targets(v.render_targets, v.num_colour_targets, v.depth_target, a);
-                pen::renderer_clear(v.clear_state, a);
+                put::camera_update_shader_constants(cam);
+                sv.camera = cam;
+                sv.cb_view = cam->cbuffer;
+            }
+            else
+            {
+                // this code path is untested.
+                static put::camera c;
+                put::camera_create_orthographic(&c, sv.viewport->x, sv.viewport->width, sv.viewport->y,
+                                                sv.viewport->height, 0.0f, 1.0f);
+                put::camera_update_shader_constants(&c);
+                sv.cb_view = c.cbuffer;
+            }
 
-                // bind view samplers.. render targets, global textures
-                for (auto& sb : v.sampler_bindings)
-                {
-                    pen::renderer_set_texture(sb.handle, sb.sampler_state, sb.sampler_unit, sb.bind_flags);
-                }
+            // bind targets before samplers..
+            // so that ping-pong buffers get unbound from rt before being bound on samplers
+            pen::renderer_set_targets(v.render_targets, v.num_colour_targets, v.depth_target, a);
+            pen::renderer_clear(v.clear_state, a);
 
-                // bind technique samplers
-                for (u32 i = 0; i < MAX_TECHNIQUE_SAMPLER_BINDINGS; ++i)
-                {
-                    auto& sb = v.technique_samplers.sb[i];
-                    if (sb.handle == 0)
-                        continue;
+            // bind view samplers.. render targets, global textures
+            for (auto& sb : v.sampler_bindings)
+            {
+                pen::renderer_set_texture(sb.handle, sb.sampler_state, sb.sampler_unit, sb.bind_flags);
+            }
 
-                    pen::renderer_set_texture(sb.handle, sb.sampler_state, sb.sampler_unit, sb.bind_flags);
-                }
+            // bind technique samplers
+            for (u32 i = 0; i < MAX_TECHNIQUE_SAMPLER_BINDINGS; ++i)
+            {
+                auto& sb = v.technique_samplers.sb[i];
+                if (sb.handle == 0)
+                    continue;
 
-                // bind any per view cbuffers
-                u32 num_samplers = v.sampler_bindings.size();
-                if (num_samplers > 0)
-                {
-                    pen::renderer_update_buffer(cb_sampler_info, v.sampler_info, num_samplers * sizeof(vec4f));
-                    pen::renderer_set_constant_buffer(cb_sampler_info, CB_SAMPLER_INFO, pen::CBUFFER_BIND_PS);
-                }
+                pen::renderer_set_texture(sb.handle, sb.sampler_state, sb.sampler_unit, sb.bind_flags);
+            }
 
-                // filters
-                if (is_valid(v.cbuffer_filter))
-                    pen::renderer_set_constant_buffer(v.cbuffer_filter, CB_FILTER_KERNEL, pen::CBUFFER_BIND_PS);
+            // bind any per view cbuffers
+            u32 num_samplers = v.sampler_bindings.size();
+            if (num_samplers > 0)
+            {
+                pen::renderer_update_buffer(s_cb_sampler_info, v.sampler_info, num_samplers * sizeof(vec4f));
+                pen::renderer_set_constant_buffer(s_cb_sampler_info, CB_SAMPLER_INFO,
+                                                  pen::CBUFFER_BIND_PS | pen::CBUFFER_BIND_VS);
+            }
 
-                // technique cbuffer
-                if (is_valid(v.cbuffer_technique))
-                {
-                    pen::renderer_update_buffer(v.cbuffer_technique, v.technique_constants.data,
-                                                sizeof(technique_constant_data));
-                    pen::renderer_set_constant_buffer(v.cbuffer_technique, CB_MATERIAL_CONSTANTS, pen::CBUFFER_BIND_PS);
-                }
+            // filters
+            if (is_valid(v.cbuffer_filter))
+                pen::renderer_set_constant_buffer(v.cbuffer_filter, CB_FILTER_KERNEL, pen::CBUFFER_BIND_PS);
 
-                // call render functions and make draw calls
-                for (s32 rf = 0; rf < v.render_functions.size(); ++rf)
-                    v.render_functions[rf](sv);
+            // technique cbuffer
+            if (is_valid(v.cbuffer_technique))
+            {
+                pen::renderer_update_buffer(v.cbuffer_technique, v.technique_constants.data,
+                                            sizeof(technique_constant_data));
+                pen::renderer_set_constant_buffer(v.cbuffer_technique, CB_MATERIAL_CONSTANTS, pen::CBUFFER_BIND_PS);
             }
 
+            // call render functions and make draw calls
+            for (s32 rf = 0; rf < v.render_functions.size(); ++rf)
+                v.render_functions[rf](sv);
+        }
+
+        void end_view(view_params& v, const pen::viewport& vp)
+        {
             if (v.view_flags & (VF_RESOLVE | VF_GENERATE_MIPS))
                 resolve_view_targets(v);
 
@@ -2865,6 +3503,29 @@ namespace put
             stash_output(v, vp);
         }
 
+        void render_view(view_params& v)
+        {
+            // compute doesnt need render pipeline setup
+            if (v.view_flags & VF_COMPUTE)
+            {
+                render_compute_view(v);
+                return;
+            }
+
+            create_view_cbuffers();
+
+            pen::viewport vp;
+            scene_view    sv;
+            if (!begin_view(v, vp, sv))
+                return;
+
+            // render passes.. multi pass for cubemaps or arrays
+            for (u32 a = 0; a < v.num_arrays; ++a)
+                render_view_slice(v, sv, a, v.camera);
+
+            end_view(v, vp);
+        }
+
         void render_view(hash_id view)
         {
             for (auto& v : s_views)
@@ -2890,25 +3551,219 @@ namespace put
             }
         }
 
+        void render_view_serial(view_params& v)
+        {
+            if (v.view_flags & VF_ABSTRACT)
+            {
+                render_abstract_view(v);
+            }
+            else
+            {
+                render_view(v);
+
+                if (v.post_process_flags & PP_ENABLED)
+                    render_post_process(v);
+            }
+        }
+
+        struct view_record
+        {
+            view_params*  v;
+            u32           batch;
+            u32           first_list;
+            bool          parallel;
+            bool          active; // begin_view found something to render
+            pen::viewport vp;
+            scene_view    sv;
+        };
+
+        struct slice_record
+        {
+            view_record* vr;
+            u32          array_index;
+            put::camera  cam; // faces and frustums are written per slice, so each task works on its own copy
+        };
+
+        struct recording_job
+        {
+            view_record** heads;
+            slice_record* slices;
+        };
+
+        std::vector<view_record>  s_view_records;
+        std::vector<view_record*> s_head_records;
+        std::vector<slice_record> s_slice_records;
+
+        void record_heads(u32 start, u32 end, void* user_data)
+        {
+            recording_job* job = (recording_job*)user_data;
+            for (u32 i = start; i < end; ++i)
+            {
+                view_record* vr = job->heads[i];
+
+                pen::renderer_begin_cmd_list(s_cmd_lists[vr->first_list]);
+
+                vr->active = begin_view(*vr->v, vr->vp, vr->sv);
+                if (vr->active)
+                {
+                    scene_view  sv = vr->sv;
+                    put::camera cam = *vr->v->camera;
+                    render_view_slice(*vr->v, sv, 0, &cam);
+                }
+
+                pen::renderer_end_cmd_list();
+            }
+        }
+
+        void record_slices(u32 start, u32 end, void* user_data)
+        {
+            recording_job* job = (recording_job*)user_data;
+            for (u32 i = start; i < end; ++i)
+            {
+                slice_record& sr = job->slices[i];
+                view_record*  vr = sr.vr;
+                if (!vr->active)
+                    continue;
+
+                pen::renderer_begin_cmd_list(s_cmd_lists[vr->first_list + sr.array_index]);
+
+                scene_view sv = vr->sv;
+                render_view_slice(*vr->v, sv, sr.array_index, &sr.cam);
+
+                pen::renderer_end_cmd_list();
+            }
+        }
+
+        void request_serial_recording()
+        {
+            s_frames_since_load = 0;
+        }
+
         void render()
         {
-            for (auto& v : s_views)
+            static pen::timer* timer = pen::timer_create();
+            pen::timer_start(timer);
+
+            recording_stats& st = s_recording_stats;
+            st = recording_stats();
+
+            update_dynamic_resolution();
+
+            bool parallel = s_parallel_recording && s_frames_since_load > 0 && pen::jobs_get_num_workers() > 0;
+            s_frames_since_load++;
+
+            if (!parallel)
             {
-                if (v.view_flags & VF_TEMPLATE)
+                for (auto& v : s_views)
+                {
+                    if (v.view_flags & (VF_TEMPLATE | VF_CULLED))
+                        continue;
+
+                    render_view_serial(v);
+                    st.num_views++;
+                }
+
+                st.record_ms = pen::timer_elapsed_ms(timer);
+                return;
+            }
+
+            create_view_cbuffers();
+
+            // one list per serial view, parallel views get a list per array slice plus one for resolves
+            std::vector<view_record>& records = s_view_records;
+            records.clear();
+
+            u32 num_lists = 0;
+            u32 num_batches = 0;
+            for (u32 i = 0; i < s_views.size(); ++i)
+            {
+                view_params& v = s_views[i];
+                if (v.view_flags & (VF_TEMPLATE | VF_CULLED))
                     continue;
 
-                if (v.view_flags & VF_ABSTRACT)
+                view_record vr;
+                vr.v = &v;
+                vr.batch = i < sb_count(s_render_graph.passes) ? s_render_graph.passes[i].batch : num_batches;
+                vr.first_list = num_lists;
+                vr.active = false;
+                vr.parallel = v.thread_safe && v.camera && !(v.view_flags & (VF_ABSTRACT | VF_COMPUTE)) &&
+                              !(v.post_process_flags & PP_ENABLED);
+
+                num_lists += vr.parallel ? v.num_arrays + 1 : 1;
+                num_batches = std::max(num_batches, vr.batch + 1);
+
+                records.push_back(vr);
+            }
+
+            while (s_cmd_lists.size() < num_lists)
+                s_cmd_lists.push_back(pen::renderer_create_cmd_list());
+
+            std::vector<view_record*>& heads = s_head_records;
+            std::vector<slice_record>& slices = s_slice_records;
+
+            u32 num_records = records.size();
+            for (u32 b = 0; b < num_batches; ++b)
+            {
+                heads.clear();
+                slices.clear();
+
+                for (u32 r = 0; r < num_records; ++r)
                 {
-                    render_abstract_view(v);
+                    view_record& vr = records[r];
+                    if (vr.batch != b)
+                        continue;
+
+                    if (!vr.parallel)
+                    {
+                        pen::renderer_begin_cmd_list(s_cmd_lists[vr.first_list]);
+                        render_view_serial(*vr.v);
+                        pen::renderer_end_cmd_list();
+                        continue;
+                    }
+
+                    // aspect, projection and cbuffer creation happen here on the user thread
+                    put::camera_update_shader_constants(vr.v->camera);
+                    heads.push_back(&vr);
+
+                    for (u32 a = 1; a < vr.v->num_arrays; ++a)
+                    {
+                        slice_record sr;
+                        sr.vr = &vr;
+                        sr.array_index = a;
+                        sr.cam = *vr.v->camera;
+                        slices.push_back(sr);
+                    }
                 }
-                else
+
+                recording_job job = {heads.data(), slices.data()};
+                pen::jobs_parallel_for(heads.size(), 1, record_heads, &job);
+                pen::jobs_parallel_for(slices.size(), 1, record_slices, &job);
+
+                // resolves and debug stash may create targets
+                u32 num_heads = heads.size();
+                for (u32 h = 0; h < num_heads; ++h)
                 {
-                    render_view(v);
+                    view_record* vr = heads[h];
+                    if (!vr->active)
+                        continue;
 
-                    if (v.post_process_flags & PP_ENABLED)
-                        render_post_process(v);
+                    pen::renderer_begin_cmd_list(s_cmd_lists[vr->first_list + vr->v->num_arrays]);
+                    end_view(*vr->v, vr->vp);
+                    pen::renderer_end_cmd_list();
                 }
+
+                st.parallel_views += num_heads;
+                st.parallel_slices += slices.size();
             }
+
+            // submit in view order so the gpu sees exactly what serial recording would have produced
+            for (u32 i = 0; i < num_lists; ++i)
+                pen::renderer_submit_cmd_list(s_cmd_lists[i]);
+
+            st.num_views = num_records;
+            st.num_cmd_lists = num_lists;
+            st.num_batches = num_batches;
+            st.record_ms = pen::timer_elapsed_ms(timer);
         }
 
         void render_target_info_ui(const render_target& rt)
@@ -3051,6 +3906,21 @@ namespace put
             pmfx_config_hotload();
         }
 
+        void set_dynamic_resolution(const dynamic_resolution_params& params)
+        {
+            s_dynamic_resolution.params = params;
+        }
+
+        const dynamic_resolution_params& get_dynamic_resolution_params()
+        {
+            return s_dynamic_resolution.params;
+        }
+
+        f32 get_dynamic_resolution_scale()
+        {
+            return s_dynamic_resolution.applied_scale;
+        }
+
         void show_dev_ui()
         {
             ImGui::BeginMainMenuBar();
@@ -3098,6 +3968,7 @@ namespace put
 
                     bool unsupported_display = rt.id_name == k_id_main_colour || rt.id_name == k_id_main_depth;
                     unsupported_display |= rt.format == PEN_TEX_FORMAT_R32_UINT;
+                    unsupported_display |= !is_valid(rt.handle);
 
                     if (!unsupported_display)
                     {
@@ -3110,6 +3981,80 @@ namespace put
                     render_target_info_ui(rt);
                 }
 
+                if (ImGui::CollapsingHeader("Render Graph"))
+                {
+                    const render_graph_stats& st = s_render_graph.stats;
+
+                    bool cull = s_render_graph_flags & RG_COMPILE_CULL;
+                    bool alias = s_render_graph_flags & RG_COMPILE_ALIAS;
+
+                    bool invalidated = ImGui::Checkbox("Cull Views", &cull);
+                    invalidated |= ImGui::Checkbox("Alias Transient Targets", &alias);
+
+                    ImGui::Text("Views: %i, culled: %i", st.num_passes, st.culled_passes);
+                    ImGui::Text("Targets: %i, transient: %i, allocated: %i", st.num_resources, st.transient_resources,
+                                st.physical_resources);
+                    ImGui::Text("Declared: %.2f (mb)", (f32)st.declared_bytes / 1024.0f / 1024.0f);
+                    ImGui::Text("After culling: %.2f (mb)", (f32)st.live_bytes / 1024.0f / 1024.0f);
+                    ImGui::Text("After aliasing: %.2f (mb)", (f32)st.aliased_bytes / 1024.0f / 1024.0f);
+                    ImGui::Text("Peak live: %.2f (mb)", (f32)st.peak_bytes / 1024.0f / 1024.0f);
+
+                    const recording_stats& rs = s_recording_stats;
+                    ImGui::Checkbox("Parallel Recording", &s_parallel_recording);
+                    ImGui::Text("Batches: %i, views: %i, parallel: %i, slices: %i", st.num_batches, rs.num_views,
+                                rs.parallel_views, rs.parallel_slices);
+                    ImGui::Text("Command lists: %i, record: %.3f (ms) (%i workers)", rs.num_cmd_lists, rs.record_ms,
+                                pen::jobs_get_num_workers());
+
+                    for (u32 r = 0; r < st.num_resources; ++r)
+                    {
+                        const rg_resource& res = s_render_graph.resources[r];
+                        if (res.flags & RG_RESOURCE_EXTERNAL)
+                            continue;
+
+                        const render_target* rt = get_render_target(res.id_name);
+                        const render_target* owner =
+                            is_valid(res.physical) ? get_render_target(s_render_graph.resources[res.physical].id_name) : nullptr;
+
+                        ImGui::Text("%s: views [%i, %i] -> %s", rt->name.c_str(), res.first_use, res.last_use,
+                                    owner ? owner->name.c_str() : "culled");
+                    }
+
+                    if (invalidated)
+                    {
+                        s_render_graph_flags = (cull ? RG_COMPILE_CULL : 0) | (alias ? RG_COMPILE_ALIAS : 0);
+                        pmfx_config_hotload();
+                    }
+                }
+
+                if (ImGui::CollapsingHeader("Dynamic Resolution"))
+                {
+                    dynamic_resolution_state&  dr = s_dynamic_resolution;
+                    dynamic_resolution_params& p = dr.params;
+
+                    ImGui::Checkbox("Enabled", &p.enabled);
+                    ImGui::InputFloat("Target (ms)", &p.target_ms);
+                    ImGui::SliderFloat("Min Scale", &p.min_scale, 0.25f, 1.0f);
+                    ImGui::SliderFloat("Max Scale", &p.max_scale, 0.25f, 1.0f);
+                    ImGui::SliderFloat("Headroom", &p.headroom, 0.5f, 1.0f);
+
+                    s32 w = (s32)floorf((f32)pen_window.width * dr.applied_scale);
+                    s32 h = (s32)floorf((f32)pen_window.height * dr.applied_scale);
+                    u32 last = (dr.history_pos + k_dynamic_resolution_history - 1) % k_dynamic_resolution_history;
+
+                    ImGui::Text("Scale: %.3f (%i x %i), changes: %i", dr.applied_scale, w, h, dr.num_changes);
+                    ImGui::Text("Frame: %.2f (ms), smoothed: %.2f (ms)", dr.ms_history[last], dr.frame_ms);
+
+                    ImGui::PlotLines("Scale", dr.scale_history, k_dynamic_resolution_history, dr.history_pos, nullptr,
+                                     0.0f, 1.0f, ImVec2(0.0f, 60.0f));
+                    ImGui::PlotLines("Frame (ms)", dr.ms_history, k_dynamic_resolution_history, dr.history_pos,
+                                     nullptr, 0.0f, p.target_ms * 2.0f, ImVec2(0.0f, 60.0f));
+
+                    for (auto& rt : s_render_targets)
+                        if (rt.flags & RT_DYNAMIC_RESOLUTION)
+                            ImGui::Text("%s", rt.name.c_str());
+                }
+
                 if (ImGui::CollapsingHeader("Views"))
                 {
                     ImGui::Indent();
@@ -6,6 +6,7 @@
 
 #include "dev_ui.h"
 #include "ecs/ecs_resources.h"
+#include "ecs/ecs_utilities.h"
 #include "pmfx.h"
 #include "str/Str.h"
 #include "str_utilities.h"
@@ -41,6 +42,38 @@ namespace
 
     shader_program null_shader = {0};
 
+    // PACKED permutations declare the same float4 inputs, info.json lays them out as full floats so the formats and
+    // offsets come from the packed vertex structs instead. the gpu expands them to floats before the shader reads them
+    struct packed_input
+    {
+        u32 semantic_id;
+        u32 semantic_index;
+        s32 format;
+        u32 offset;
+    };
+
+    // clang-format off
+    const packed_input packed_inputs[] = {
+        {1, 0, PEN_VERTEX_FORMAT_FLOAT3,    offsetof(vertex_model_skinned_packed, pos)},
+        {2, 0, PEN_VERTEX_FORMAT_SNORM16_4, offsetof(vertex_model_skinned_packed, tbn)},
+        {2, 1, PEN_VERTEX_FORMAT_HALF4,     offsetof(vertex_model_skinned_packed, uv12)},
+        {2, 4, PEN_VERTEX_FORMAT_UNORM4,    offsetof(vertex_model_skinned_packed, blend_indices)},
+        {2, 5, PEN_VERTEX_FORMAT_UNORM4,    offsetof(vertex_model_skinned_packed, blend_weights)}
+    };
+    // clang-format on
+
+    static_assert(offsetof(vertex_model_packed, uv12) == offsetof(vertex_model_skinned_packed, uv12),
+                  "packed formats must share a layout up to the blend data");
+
+    const packed_input* find_packed_input(u32 semantic_id, u32 semantic_index)
+    {
+        for (auto& pi : packed_inputs)
+            if (pi.semantic_id == semantic_id && pi.semantic_index == semantic_index)
+                return &pi;
+
+        return nullptr;
+    }
+
     hash_id id_widgets[] = {
         PEN_HASH("slider"),
         PEN_HASH("input"),
@@ -56,6 +89,7 @@ namespace
         pen::json       info;
         u32             info_timestamp = 0;
         shader_program* techniques = nullptr;
+        hash_id*        technique_hashes = nullptr; // metadata and byte code, unchanged techniques survive a reload
     };
     
     pmfx_shader*  s_pmfx_list = nullptr;
@@ -255,6 +289,8 @@ namespace put
                 {"instance_inputs", PEN_INPUT_PER_INSTANCE, 1, instance_elements},
             };
 
+            bool packed = j_techique["permutation_id"].as_u32() & PERMUTATION_PACKED;
+
             u32 input_index = 0;
             for (u32 l = 0; l < 2; ++l)
             {
@@ -284,6 +320,19 @@ namespace put
                     ilp.input_layout[input_index].input_slot_class = layouts[l].iclass;
                     ilp.input_layout[input_index].instance_data_step_rate = layouts[l].step_rate;
 
+                    if (packed && layouts[l].iclass == PEN_INPUT_PER_VERTEX)
+                    {
+                        const packed_input* pi =
+                            find_packed_input(vj["semantic_id"].as_u32(), vj["semantic_index"].as_u32());
+
+                        PEN_ASSERT(pi);
+                        if (pi)
+                        {
+                            ilp.input_layout[input_index].format = pi->format;
+                            ilp.input_layout[input_index].aligned_byte_offset = pi->offset;
+                        }
+                    }
+
                     ++input_index;
                 }
             }
@@ -756,6 +805,13 @@ namespace put
                                pmfx_filename);
         }
 
+        void release_technique(shader_program& t)
+        {
+            pen::renderer_release_shader(t.pixel_shader, PEN_SHADER_TYPE_PS);
+            pen::renderer_release_shader(t.vertex_shader, PEN_SHADER_TYPE_VS);
+            pen::renderer_release_input_layout(t.input_layout);
+        }
+
         void release_shader(u32 shader)
         {
             s_pmfx_list[shader].filename = nullptr;
@@ -763,12 +819,52 @@ namespace put
             u32 num_techniques = sb_count(s_pmfx_list[shader].techniques);
 
             for (u32 i = 0; i < num_techniques; ++i)
+                release_technique(s_pmfx_list[shader].techniques[i]);
+        }
+
+        hash_id hash_technique(const c8* fx_filename, pen::json& j_technique)
+        {
+            static const c8* k_byte_code_files[] = {"vs_file", "ps_file", "cs_file"};
+
+            pen::hash_murmur hm;
+            hm.begin();
+
+            Str meta = j_technique.dumps();
+            hm.add(meta.c_str(), meta.length());
+
+            // a shared include can change the byte code without touching the technique info
+            const c8* sfp = pen::renderer_get_shader_platform();
+            for (u32 i = 0; i < PEN_ARRAY_SIZE(k_byte_code_files); ++i)
             {
-                auto& t = s_pmfx_list[shader].techniques[i];
+                Str file = j_technique[k_byte_code_files[i]].as_str();
+                if (file.empty())
+                    continue;
+
+                c8 file_buf[256];
+                pen::string_format(file_buf, 256, "data/pmfx/%s/%s/%s", sfp, fx_filename, file.c_str());
+
+                void* data = nullptr;
+                u32   size = 0;
+                if (pen::filesystem_read_file_to_buffer(file_buf, &data, size) == PEN_ERR_OK)
+                    hm.add(data, size);
+
+                pen::memory_free(data);
+            }
 
-                pen::renderer_release_shader(t.pixel_shader, PEN_SHADER_TYPE_PS);
-                pen::renderer_release_shader(t.vertex_shader, PEN_SHADER_TYPE_VS);
-                pen::renderer_release_input_layout(t.input_layout);
+            return hm.end();
+        }
+
+        void hash_techniques(pmfx_shader& pmfx_set)
+        {
+            // byte code is hashed once a reload is triggered, before the compiler overwrites it, so loads skip the io
+            if (pmfx_set.technique_hashes)
+                return;
+
+            pen::json techniques = pmfx_set.info["techniques"];
+            for (s32 i = 0; i < techniques.size(); ++i)
+            {
+                pen::json t = techniques[i];
+                sb_push(pmfx_set.technique_hashes, hash_technique(pmfx_set.filename.c_str(), t));
             }
         }
         
@@ -783,7 +879,7 @@ namespace put
             return true;
         }
 
-        pmfx_shader load_internal(const c8* filename)
+        pmfx_shader load_internal(const c8* filename, pmfx_shader* prev = nullptr)
         {
             // load info file for description
             static c8 info_file_buf[256];
@@ -808,7 +904,30 @@ namespace put
 
             for (s32 i = 0; i < _techniques.size(); ++i)
             {
-                pen::json      t = _techniques[i];
+                pen::json t = _techniques[i];
+
+                // on reload take over unchanged techniques from the previous set, taken ones have their hash zeroed
+                // the initial load has nothing to compare against so skips reading the byte code to hash it
+                bool    taken = false;
+                u32     num_prev = prev ? sb_count(prev->technique_hashes) : 0;
+                hash_id th = prev ? hash_technique(filename, t) : 0;
+                if (prev)
+                    sb_push(new_pmfx.technique_hashes, th);
+
+                for (u32 p = 0; p < num_prev; ++p)
+                {
+                    if (prev->technique_hashes[p] != th)
+                        continue;
+
+                    sb_push(new_pmfx.techniques, prev->techniques[p]);
+                    prev->technique_hashes[p] = 0;
+                    taken = true;
+                    break;
+                }
+
+                if (taken)
+                    continue;
+
                 shader_program new_technique = load_shader_technique(filename, t, new_pmfx.info);
 
                 sb_push(new_pmfx.techniques, new_technique);
@@ -902,11 +1021,28 @@ namespace put
                         bool complete = pmfx_ready(pmfx_set.filename.c_str());
                         if(complete)
                         {
-                            // load new one
-                            pmfx_shader pmfx_new = load_internal(pmfx_set.filename.c_str());
+                            // load new one, techniques and permutations which have not changed are kept as they are
+                            pmfx_shader pmfx_new = load_internal(pmfx_set.filename.c_str(), &pmfx_set);
+
+                            // release the techniques which were not taken over, all of them if they were never hashed
+                            u32 num_prev = sb_count(pmfx_set.techniques);
+                            u32 num_kept = 0;
+                            for (u32 t = 0; t < num_prev; ++t)
+                            {
+                                if (pmfx_set.technique_hashes && pmfx_set.technique_hashes[t] == 0)
+                                {
+                                    num_kept++;
+                                    continue;
+                                }
+
+                                release_technique(pmfx_set.techniques[t]);
+                            }
+
+                            dev_console_log("[pmfx] reloaded %s, rebuilt %i/%i techniques", pmfx_set.filename.c_str(),
+                                            sb_count(pmfx_new.techniques) - num_kept, sb_count(pmfx_new.techniques));
 
-                            // release existing
-                            release_shader(current_counter);
+                            sb_free(pmfx_set.techniques);
+                            sb_free(pmfx_set.technique_hashes);
 
                             // set exisiting to the new one
                             pmfx_set = pmfx_new;
@@ -935,6 +1071,7 @@ namespace put
                         // trigger re-compile if files on disk are newer
                         if (err == PEN_ERR_OK && current_ts > shader_ts)
                         {
+                            hash_techniques(pmfx_set);
                             put::trigger_hot_loader(shader_compiler_str);
                             pmfx_set.invalidated = true;
                         }
@@ -0,0 +1,914 @@
+// sdf_baker.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "sdf_baker.h"
+#include "ecs/ecs_resources.h"
+
+#include "data_struct.h"
+#include "memory.h"
+#include "threads.h"
+#include "timer.h"
+
+#include "sdf_gen/makelevelset3.h"
+
+#if PEN_SSE
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+
+namespace put
+{
+    namespace sdf
+    {
+        namespace
+        {
+            static const u32 k_leaf_size = 4;
+            static const u32 k_stack_size = 128;
+            static const u32 k_leaf = 1u << 31; // child refs with this bit are packet indices
+            static const u32 k_empty = (u32)-1;
+
+            // 4 triangles soa, short lanes repeat the last triangle
+            struct tri_packet
+            {
+                f32 v0[3][4];
+                f32 v1[3][4];
+                f32 v2[3][4];
+                f32 n[3][4];     // unnormalised, cross(v1 - v0, v2 - v0)
+                f32 inv_e01[4];  // 1 / squared edge lengths, 0 for collapsed edges
+                f32 inv_e12[4];
+                f32 inv_e20[4];
+                f32 inv_n2[4];   // 0 for degenerate triangles so they only use edge distances
+            };
+
+            // binary tree used while building
+            struct bvh_node
+            {
+                vec3f min;
+                u32   first; // leaf: packet index, inner: left child, right child is first + 1
+                vec3f max;
+                u32   count; // triangles in a leaf, 0 for inner nodes
+            };
+
+            // 4 child boxes soa so they are tested together, empty slots have inverted bounds
+            struct bvh4_node
+            {
+                f32 min[3][4];
+                f32 max[3][4];
+                u32 child[4]; // node index, k_leaf | packet index or k_empty
+            };
+
+            struct bvh
+            {
+                bvh4_node*  nodes = nullptr;
+                tri_packet* packets = nullptr;
+            };
+
+            struct build_tri
+            {
+                vec3f min;
+                vec3f max;
+                vec3f centre;
+                u32   index;
+            };
+
+            struct build_item
+            {
+                u32 node;
+                u32 start;
+                u32 end;
+            };
+
+            struct collapse_item
+            {
+                u32 node;
+                u32 binary;
+            };
+
+            struct bake_context
+            {
+                const bake_params* params;
+                const bake_mesh*   mesh;
+                bvh                tree;
+                f32*               phi;
+                u32                n[3];
+
+                // sign
+                f64* grid_verts; // vertices in grid units
+                u8*  votes;
+                u32* bucket_start;
+                u32* bucket_tris;
+                u32  axis, u, v; // crossings are counted along axis, rows along u, slices along v
+            };
+
+            struct batch
+            {
+                u32                     offset;
+                pen::job_range_callback cb;
+                void*                   user_data;
+            };
+
+            void set_packet_lane(tri_packet& tp, u32 lane, const vec3f& a, const vec3f& b, const vec3f& c)
+            {
+                vec3f e01 = b - a;
+                vec3f e12 = c - b;
+                vec3f e20 = a - c;
+                vec3f n = cross(e01, c - a);
+
+                for (u32 i = 0; i < 3; ++i)
+                {
+                    tp.v0[i][lane] = a[i];
+                    tp.v1[i][lane] = b[i];
+                    tp.v2[i][lane] = c[i];
+                    tp.n[i][lane] = n[i];
+                }
+
+                f32 l01 = dot(e01, e01);
+                f32 l12 = dot(e12, e12);
+                f32 l20 = dot(e20, e20);
+                f32 n2 = dot(n, n);
+
+                tp.inv_e01[lane] = l01 > 0.0f ? 1.0f / l01 : 0.0f;
+                tp.inv_e12[lane] = l12 > 0.0f ? 1.0f / l12 : 0.0f;
+                tp.inv_e20[lane] = l20 > 0.0f ? 1.0f / l20 : 0.0f;
+                tp.inv_n2[lane] = n2 > 0.0f ? 1.0f / n2 : 0.0f;
+            }
+
+            // collapses pairs of levels so each node holds up to 4 children
+            void collapse_bvh(bvh& tree, const bvh_node* binary)
+            {
+                collapse_item stack[k_stack_size];
+                u32           sp = 0;
+
+                sb_push(tree.nodes, bvh4_node());
+                stack[sp++] = {0, 0};
+
+                while (sp > 0)
+                {
+                    collapse_item item = stack[--sp];
+
+                    u32             kids[4];
+                    u32             num_kids = 0;
+                    const bvh_node& b = binary[item.binary];
+                    if (b.count)
+                    {
+                        // single leaf tree
+                        kids[num_kids++] = item.binary;
+                    }
+                    else
+                    {
+                        for (u32 c = 0; c < 2; ++c)
+                        {
+                            const bvh_node& cn = binary[b.first + c];
+                            if (cn.count)
+                            {
+                                kids[num_kids++] = b.first + c;
+                                continue;
+                            }
+
+                            kids[num_kids++] = cn.first;
+                            kids[num_kids++] = cn.first + 1;
+                        }
+                    }
+
+                    bvh4_node n4;
+                    for (u32 i = 0; i < 4; ++i)
+                    {
+                        for (u32 a = 0; a < 3; ++a)
+                        {
+                            n4.min[a][i] = FLT_MAX;
+                            n4.max[a][i] = -FLT_MAX;
+                        }
+                        n4.child[i] = k_empty;
+                    }
+
+                    for (u32 i = 0; i < num_kids; ++i)
+                    {
+                        const bvh_node& kn = binary[kids[i]];
+                        for (u32 a = 0; a < 3; ++a)
+                        {
+                            n4.min[a][i] = kn.min[a];
+                            n4.max[a][i] = kn.max[a];
+                        }
+
+                        if (kn.count)
+                        {
+                            n4.child[i] = k_leaf | kn.first;
+                            continue;
+                        }
+
+                        n4.child[i] = sb_count(tree.nodes);
+                        sb_push(tree.nodes, bvh4_node());
+                        stack[sp++] = {n4.child[i], kids[i]};
+                    }
+
+                    tree.nodes[item.node] = n4;
+                }
+            }
+
+            void build_bvh(bvh& tree, const bake_mesh& mesh)
+            {
+                u32 num_tris = sb_count(mesh.indices) / 3;
+                bvh_node* binary = nullptr;
+
+                build_tri* bt = (build_tri*)pen::memory_alloc(sizeof(build_tri) * num_tris);
+                for (u32 t = 0; t < num_tris; ++t)
+                {
+                    const vec3f& a = mesh.vertices[mesh.indices[t * 3 + 0]];
+                    const vec3f& b = mesh.vertices[mesh.indices[t * 3 + 1]];
+                    const vec3f& c = mesh.vertices[mesh.indices[t * 3 + 2]];
+
+                    bt[t].min = min_union(min_union(a, b), c);
+                    bt[t].max = max_union(max_union(a, b), c);
+                    bt[t].centre = (a + b + c) / 3.0f;
+                    bt[t].index = t;
+                }
+
+                // median split on the widest centroid axis, children are allocated together
+                build_item stack[k_stack_size];
+                u32        sp = 0;
+
+                sb_push(binary, bvh_node());
+                stack[sp++] = {0, 0, num_tris};
+
+                while (sp > 0)
+                {
+                    build_item item = stack[--sp];
+
+                    vec3f bmin = vec3f(FLT_MAX);
+                    vec3f bmax = vec3f(-FLT_MAX);
+                    vec3f cmin = vec3f(FLT_MAX);
+                    vec3f cmax = vec3f(-FLT_MAX);
+                    for (u32 i = item.start; i < item.end; ++i)
+                    {
+                        bmin = min_union(bmin, bt[i].min);
+                        bmax = max_union(bmax, bt[i].max);
+                        cmin = min_union(cmin, bt[i].centre);
+                        cmax = max_union(cmax, bt[i].centre);
+                    }
+
+                    binary[item.node].min = bmin;
+                    binary[item.node].max = bmax;
+
+                    u32 count = item.end - item.start;
+                    if (count <= k_leaf_size)
+                    {
+                        tri_packet tp;
+                        for (u32 lane = 0; lane < 4; ++lane)
+                        {
+                            u32 t = bt[item.start + std::min(lane, count - 1)].index;
+                            set_packet_lane(tp, lane, mesh.vertices[mesh.indices[t * 3 + 0]],
+                                            mesh.vertices[mesh.indices[t * 3 + 1]],
+                                            mesh.vertices[mesh.indices[t * 3 + 2]]);
+                        }
+
+                        binary[item.node].first = sb_count(tree.packets);
+                        binary[item.node].count = count;
+                        sb_push(tree.packets, tp);
+                        continue;
+                    }
+
+                    vec3f ce = cmax - cmin;
+                    u32   axis = 0;
+                    if (ce.y > ce.x)
+                        axis = 1;
+                    if (ce.z > ce[axis])
+                        axis = 2;
+
+                    u32 mid = item.start + count / 2;
+                    std::nth_element(bt + item.start, bt + mid, bt + item.end,
+                                     [axis](const build_tri& a, const build_tri& b) {
+                                         return a.centre[axis] < b.centre[axis];
+                                     });
+
+                    u32 left = sb_count(binary);
+                    sb_push(binary, bvh_node());
+                    sb_push(binary, bvh_node());
+
+                    binary[item.node].first = left;
+                    binary[item.node].count = 0;
+
+                    // median splits keep depth at log2(n / leaf size), so the stack never holds more than depth + 1
+                    stack[sp++] = {left + 1, mid, item.end};
+                    stack[sp++] = {left, item.start, mid};
+                }
+
+                pen::memory_free(bt);
+
+                collapse_bvh(tree, binary);
+                sb_free(binary);
+            }
+
+            inline f32 segment_dist2(const vec3f& w, const vec3f& e, f32 inv)
+            {
+                f32   t = std::min(std::max(dot(w, e) * inv, 0.0f), 1.0f);
+                vec3f r = w - e * t;
+                return dot(r, r);
+            }
+
+            // squared distance from p to a single triangle of the packet
+            f32 lane_dist2(const tri_packet& tp, u32 lane, const vec3f& p)
+            {
+                vec3f a = p - vec3f(tp.v0[0][lane], tp.v0[1][lane], tp.v0[2][lane]);
+                vec3f b = p - vec3f(tp.v1[0][lane], tp.v1[1][lane], tp.v1[2][lane]);
+                vec3f c = p - vec3f(tp.v2[0][lane], tp.v2[1][lane], tp.v2[2][lane]);
+                vec3f n = vec3f(tp.n[0][lane], tp.n[1][lane], tp.n[2][lane]);
+
+                vec3f e01 = a - b;
+                vec3f e12 = b - c;
+                vec3f e20 = c - a;
+
+                // projection inside all 3 edges is the plane distance, otherwise the nearest edge
+                if (tp.inv_n2[lane] > 0.0f && dot(cross(e01, a), n) >= 0.0f && dot(cross(e12, b), n) >= 0.0f &&
+                    dot(cross(e20, c), n) >= 0.0f)
+                {
+                    f32 pd = dot(a, n);
+                    return pd * pd * tp.inv_n2[lane];
+                }
+
+                f32 d01 = segment_dist2(a, e01, tp.inv_e01[lane]);
+                f32 d12 = segment_dist2(b, e12, tp.inv_e12[lane]);
+                f32 d20 = segment_dist2(c, e20, tp.inv_e20[lane]);
+                return std::min(std::min(d01, d12), d20);
+            }
+
+#if PEN_SSE
+            inline __m128 dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+            {
+                return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+            }
+
+            inline __m128 segment_dist2(__m128 wx, __m128 wy, __m128 wz, __m128 ex, __m128 ey, __m128 ez, __m128 inv)
+            {
+                __m128 t = _mm_mul_ps(dot3(wx, wy, wz, ex, ey, ez), inv);
+                t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+
+                __m128 rx = _mm_sub_ps(wx, _mm_mul_ps(ex, t));
+                __m128 ry = _mm_sub_ps(wy, _mm_mul_ps(ey, t));
+                __m128 rz = _mm_sub_ps(wz, _mm_mul_ps(ez, t));
+                return dot3(rx, ry, rz, rx, ry, rz);
+            }
+
+            // n . cross(e, w), positive when w is on the inner side of the edge
+            inline __m128 edge_side(__m128 ex, __m128 ey, __m128 ez, __m128 wx, __m128 wy, __m128 wz, __m128 nx,
+                                    __m128 ny, __m128 nz)
+            {
+                __m128 cx = _mm_sub_ps(_mm_mul_ps(ey, wz), _mm_mul_ps(ez, wy));
+                __m128 cy = _mm_sub_ps(_mm_mul_ps(ez, wx), _mm_mul_ps(ex, wz));
+                __m128 cz = _mm_sub_ps(_mm_mul_ps(ex, wy), _mm_mul_ps(ey, wx));
+                return dot3(cx, cy, cz, nx, ny, nz);
+            }
+
+            void aabb_dist2(const bvh4_node& node, const vec3f& p, f32* d2)
+            {
+                __m128 zero = _mm_setzero_ps();
+                __m128 d[3];
+                for (u32 a = 0; a < 3; ++a)
+                {
+                    __m128 pa = _mm_set1_ps(p[a]);
+                    __m128 lo = _mm_sub_ps(_mm_loadu_ps(node.min[a]), pa);
+                    __m128 hi = _mm_sub_ps(pa, _mm_loadu_ps(node.max[a]));
+                    d[a] = _mm_max_ps(_mm_max_ps(lo, hi), zero);
+                }
+
+                _mm_storeu_ps(d2, dot3(d[0], d[1], d[2], d[0], d[1], d[2]));
+            }
+
+            // all 4 triangles at once, branch free version of lane_dist2
+            f32 packet_dist2(const tri_packet& tp, const vec3f& p, u32& lane)
+            {
+                __m128 px = _mm_set1_ps(p.x);
+                __m128 py = _mm_set1_ps(p.y);
+                __m128 pz = _mm_set1_ps(p.z);
+
+                // p relative to each vertex, edges fall out of the differences
+                __m128 ax = _mm_sub_ps(px, _mm_loadu_ps(tp.v0[0]));
+                __m128 ay = _mm_sub_ps(py, _mm_loadu_ps(tp.v0[1]));
+                __m128 az = _mm_sub_ps(pz, _mm_loadu_ps(tp.v0[2]));
+                __m128 bx = _mm_sub_ps(px, _mm_loadu_ps(tp.v1[0]));
+                __m128 by = _mm_sub_ps(py, _mm_loadu_ps(tp.v1[1]));
+                __m128 bz = _mm_sub_ps(pz, _mm_loadu_ps(tp.v1[2]));
+                __m128 cx = _mm_sub_ps(px, _mm_loadu_ps(tp.v2[0]));
+                __m128 cy = _mm_sub_ps(py, _mm_loadu_ps(tp.v2[1]));
+                __m128 cz = _mm_sub_ps(pz, _mm_loadu_ps(tp.v2[2]));
+
+                __m128 e01x = _mm_sub_ps(ax, bx);
+                __m128 e01y = _mm_sub_ps(ay, by);
+                __m128 e01z = _mm_sub_ps(az, bz);
+                __m128 e12x = _mm_sub_ps(bx, cx);
+                __m128 e12y = _mm_sub_ps(by, cy);
+                __m128 e12z = _mm_sub_ps(bz, cz);
+                __m128 e20x = _mm_sub_ps(cx, ax);
+                __m128 e20y = _mm_sub_ps(cy, ay);
+                __m128 e20z = _mm_sub_ps(cz, az);
+
+                __m128 d01 = segment_dist2(ax, ay, az, e01x, e01y, e01z, _mm_loadu_ps(tp.inv_e01));
+                __m128 d12 = segment_dist2(bx, by, bz, e12x, e12y, e12z, _mm_loadu_ps(tp.inv_e12));
+                __m128 d20 = segment_dist2(cx, cy, cz, e20x, e20y, e20z, _mm_loadu_ps(tp.inv_e20));
+                __m128 edge = _mm_min_ps(_mm_min_ps(d01, d12), d20);
+
+                __m128 nx = _mm_loadu_ps(tp.n[0]);
+                __m128 ny = _mm_loadu_ps(tp.n[1]);
+                __m128 nz = _mm_loadu_ps(tp.n[2]);
+                __m128 inv_n2 = _mm_loadu_ps(tp.inv_n2);
+
+                __m128 pd = dot3(ax, ay, az, nx, ny, nz);
+                __m128 plane = _mm_mul_ps(_mm_mul_ps(pd, pd), inv_n2);
+
+                __m128 zero = _mm_setzero_ps();
+                __m128 inside = _mm_cmpgt_ps(inv_n2, zero);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(edge_side(e01x, e01y, e01z, ax, ay, az, nx, ny, nz), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(edge_side(e12x, e12y, e12z, bx, by, bz, nx, ny, nz), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(edge_side(e20x, e20y, e20z, cx, cy, cz, nx, ny, nz), zero));
+
+                __m128 d = _mm_or_ps(_mm_and_ps(inside, plane), _mm_andnot_ps(inside, edge));
+                __m128 m = _mm_min_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+                m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+
+                s32 mask = _mm_movemask_ps(_mm_cmpeq_ps(d, m));
+                for (lane = 0; lane < 3; ++lane)
+                    if (mask & (1 << lane))
+                        break;
+
+                return _mm_cvtss_f32(m);
+            }
+#else
+            void aabb_dist2(const bvh4_node& node, const vec3f& p, f32* d2)
+            {
+                for (u32 i = 0; i < 4; ++i)
+                {
+                    d2[i] = 0.0f;
+                    for (u32 a = 0; a < 3; ++a)
+                    {
+                        f32 d = std::max(std::max(node.min[a][i] - p[a], p[a] - node.max[a][i]), 0.0f);
+                        d2[i] += d * d;
+                    }
+                }
+            }
+
+            f32 packet_dist2(const tri_packet& tp, const vec3f& p, u32& lane)
+            {
+                f32 best = FLT_MAX;
+                for (u32 i = 0; i < 4; ++i)
+                {
+                    f32 d = lane_dist2(tp, i, p);
+                    if (d < best)
+                    {
+                        best = d;
+                        lane = i;
+                    }
+                }
+                return best;
+            }
+#endif
+
+            // nearest squared distance below best, best and closest (packet * 4 + lane) are unchanged if nothing is
+            // closer
+            f32 closest_dist2(const bvh& tree, const vec3f& p, f32 best, u32& closest)
+            {
+                struct entry
+                {
+                    u32 ref;
+                    f32 d2;
+                };
+
+                entry stack[k_stack_size];
+                u32   sp = 0;
+
+                stack[sp++] = {0, 0.0f};
+
+                while (sp > 0)
+                {
+                    entry e = stack[--sp];
+                    if (e.d2 >= best)
+                        continue;
+
+                    if (e.ref & k_leaf)
+                    {
+                        u32 packet = e.ref & ~k_leaf;
+                        u32 lane;
+                        f32 d2 = packet_dist2(tree.packets[packet], p, lane);
+                        if (d2 < best)
+                        {
+                            best = d2;
+                            closest = packet * 4 + lane;
+                        }
+                        continue;
+                    }
+
+                    const bvh4_node& node = tree.nodes[e.ref];
+
+                    f32 d2[4];
+                    aabb_dist2(node, p, d2);
+
+                    // sorted farthest first so the nearest child is popped next
+                    entry kids[4];
+                    u32   num_kids = 0;
+                    for (u32 i = 0; i < 4; ++i)
+                    {
+                        if (node.child[i] == k_empty || d2[i] >= best)
+                            continue;
+
+                        u32 k = num_kids++;
+                        for (; k > 0 && kids[k - 1].d2 < d2[i]; --k)
+                            kids[k] = kids[k - 1];
+
+                        kids[k] = {node.child[i], d2[i]};
+                    }
+
+                    for (u32 i = 0; i < num_kids; ++i)
+                        stack[sp++] = kids[i];
+                }
+
+                return best;
+            }
+
+            void distance_slices(u32 start, u32 end, void* user_data)
+            {
+                bake_context* ctx = (bake_context*)user_data;
+                const bvh&    tree = ctx->tree;
+                const vec3f&  origin = ctx->params->origin;
+                f32           dx = ctx->params->dx;
+                u32           nx = ctx->n[0];
+                u32           ny = ctx->n[1];
+
+                for (u32 k = start; k < end; ++k)
+                {
+                    if (ctx->params->cancel && *ctx->params->cancel)
+                        return;
+
+                    // the neighbouring voxel's closest triangle is usually this one's too, its distance here is a
+                    // tight upper bound which prunes almost every node that could not beat it
+                    u32 row_seed = (u32)-1;
+
+                    f32* slice = ctx->phi + k * nx * ny;
+                    for (u32 j = 0; j < ny; ++j)
+                    {
+                        f32* row = slice + j * nx;
+                        u32  seed = row_seed;
+
+                        for (u32 i = 0; i < nx; ++i)
+                        {
+                            vec3f p = origin + vec3f((f32)i, (f32)j, (f32)k) * dx;
+
+                            f32 d2 = FLT_MAX;
+                            if (seed != (u32)-1)
+                                d2 = lane_dist2(tree.packets[seed / 4], seed % 4, p);
+
+                            d2 = closest_dist2(tree, p, d2, seed);
+                            row[i] = sqrtf(d2);
+
+                            if (i == 0)
+                                row_seed = seed;
+                        }
+                    }
+                }
+            }
+
+            // calculate twice signed area of triangle (0,0)-(x1,y1)-(x2,y2)
+            // return an sos-determined sign (-1, +1, or 0 only if it's a truly degenerate triangle)
+            int orientation(f64 x1, f64 y1, f64 x2, f64 y2, f64& twice_signed_area)
+            {
+                twice_signed_area = y1 * x2 - x1 * y2;
+                if (twice_signed_area > 0)
+                    return 1;
+                else if (twice_signed_area < 0)
+                    return -1;
+                else if (y2 > y1)
+                    return 1;
+                else if (y2 < y1)
+                    return -1;
+                else if (x1 > x2)
+                    return 1;
+                else if (x1 < x2)
+                    return -1;
+                return 0;
+            }
+
+            // robust test of (x0,y0) in the triangle (x1,y1)-(x2,y2)-(x3,y3), as sdf_gen
+            // if true is returned, the barycentric coordinates are set in a,b,c.
+            bool point_in_triangle_2d(f64 x0, f64 y0, f64 x1, f64 y1, f64 x2, f64 y2, f64 x3, f64 y3, f64& a, f64& b,
+                                      f64& c)
+            {
+                x1 -= x0;
+                x2 -= x0;
+                x3 -= x0;
+                y1 -= y0;
+                y2 -= y0;
+                y3 -= y0;
+
+                int signa = orientation(x2, y2, x3, y3, a);
+                if (signa == 0)
+                    return false;
+
+                int signb = orientation(x3, y3, x1, y1, b);
+                if (signb != signa)
+                    return false;
+
+                int signc = orientation(x1, y1, x2, y2, c);
+                if (signc != signa)
+                    return false;
+
+                f64 sum = a + b + c;
+                a /= sum;
+                b /= sum;
+                c /= sum;
+                return true;
+            }
+
+            void parity_slices(u32 start, u32 end, void* user_data)
+            {
+                bake_context* ctx = (bake_context*)user_data;
+
+                u32 axis = ctx->axis;
+                u32 u = ctx->u;
+                u32 v = ctx->v;
+                u32 na = ctx->n[axis];
+                u32 nu = ctx->n[u];
+
+                // crossing at grid coord fa toggles the parity of every voxel from ceil(fa) onwards
+                u8* flips = (u8*)pen::memory_alloc(na * nu);
+
+                for (u32 s = start; s < end; ++s)
+                {
+                    if (ctx->params->cancel && *ctx->params->cancel)
+                        break;
+
+                    memset(flips, 0, na * nu);
+
+                    for (u32 b = ctx->bucket_start[s]; b < ctx->bucket_start[s + 1]; ++b)
+                    {
+                        const u32* tri = &ctx->mesh->indices[ctx->bucket_tris[b] * 3];
+                        const f64* gp = &ctx->grid_verts[tri[0] * 3];
+                        const f64* gq = &ctx->grid_verts[tri[1] * 3];
+                        const f64* gr = &ctx->grid_verts[tri[2] * 3];
+
+                        s32 u0 = std::max((s32)std::ceil(std::min(std::min(gp[u], gq[u]), gr[u])), 0);
+                        s32 u1 = std::min((s32)std::floor(std::max(std::max(gp[u], gq[u]), gr[u])), (s32)nu - 1);
+
+                        for (s32 r = u0; r <= u1; ++r)
+                        {
+                            f64 a, b, c;
+                            if (!point_in_triangle_2d(r, s, gp[u], gp[v], gq[u], gq[v], gr[u], gr[v], a, b, c))
+                                continue;
+
+                            // crossings before the grid start at the first voxel, past the end are ignored
+                            s32 fi = (s32)std::ceil(a * gp[axis] + b * gq[axis] + c * gr[axis]);
+                            if (fi < (s32)na)
+                                flips[r * na + std::max(fi, 0)] ^= 1;
+                        }
+                    }
+
+                    u32 stride[3] = {1, ctx->n[0], ctx->n[0] * ctx->n[1]};
+                    for (u32 r = 0; r < nu; ++r)
+                    {
+                        u8  parity = 0;
+                        u32 voxel = r * stride[u] + s * stride[v];
+                        for (u32 i = 0; i < na; ++i)
+                        {
+                            parity ^= flips[r * na + i];
+                            ctx->votes[voxel + i * stride[axis]] += parity;
+                        }
+                    }
+                }
+
+                pen::memory_free(flips);
+            }
+
+            void apply_sign_slices(u32 start, u32 end, void* user_data)
+            {
+                bake_context* ctx = (bake_context*)user_data;
+
+                u8  threshold = ctx->params->sign_mode == SIGN_PARITY_VOTE ? 2 : 1;
+                u32 slice_size = ctx->n[0] * ctx->n[1];
+
+                for (u32 i = start * slice_size; i < end * slice_size; ++i)
+                    if (ctx->votes[i] >= threshold)
+                        ctx->phi[i] = -ctx->phi[i];
+            }
+
+            void batch_range(u32 start, u32 end, void* user_data)
+            {
+                batch* b = (batch*)user_data;
+                b->cb(b->offset + start, b->offset + end, b->user_data);
+            }
+
+            // runs cb over count slices a few per worker at a time, between batches cancel is checked and
+            // progress is written from this thread only
+            bool dispatch_slices(bake_context& ctx, u32 count, pen::job_range_callback cb, f32* progress,
+                                 f32 progress_base, f32 progress_scale)
+            {
+                batch b;
+                b.cb = cb;
+                b.user_data = &ctx;
+
+                for (u32 s = 0; s < count;)
+                {
+                    if (ctx.params->cancel && *ctx.params->cancel)
+                        return false;
+
+                    u32 batch_size = (std::max<u32>(pen::jobs_get_num_workers(), 1) + 1) * 2;
+                    u32 n = std::min(batch_size, count - s);
+
+                    b.offset = s;
+                    pen::jobs_parallel_for(n, 1, batch_range, &b);
+                    s += n;
+
+                    if (progress)
+                        *progress = progress_base + progress_scale * ((f32)s / (f32)count);
+                }
+
+                return !(ctx.params->cancel && *ctx.params->cancel);
+            }
+
+            bool bake_sign(bake_context& ctx)
+            {
+                const bake_params& params = *ctx.params;
+                const bake_mesh&   mesh = *ctx.mesh;
+
+                u32 num_verts = sb_count(mesh.vertices);
+                u32 num_tris = sb_count(mesh.indices) / 3;
+                u32 num_voxels = ctx.n[0] * ctx.n[1] * ctx.n[2];
+
+                // grid coordinates in double precision for the crossing tests
+                ctx.grid_verts = (f64*)pen::memory_alloc(sizeof(f64) * 3 * num_verts);
+                for (u32 i = 0; i < num_verts; ++i)
+                    for (u32 c = 0; c < 3; ++c)
+                        ctx.grid_verts[i * 3 + c] = ((f64)mesh.vertices[i][c] - params.origin[c]) / params.dx;
+
+                ctx.votes = (u8*)pen::memory_alloc(num_voxels);
+                memset(ctx.votes, 0, num_voxels);
+
+                // x along rows of y in z slices, then y and z for the vote
+                static const u32 k_axes[3][3] = {{0, 1, 2}, {1, 0, 2}, {2, 0, 1}};
+                u32              num_axes = params.sign_mode == SIGN_PARITY_VOTE ? 3 : 1;
+
+                f32* progress = params.progress ? &params.progress->sweeps : nullptr;
+                bool complete = true;
+
+                for (u32 a = 0; a < num_axes && complete; ++a)
+                {
+                    ctx.axis = k_axes[a][0];
+                    ctx.u = k_axes[a][1];
+                    ctx.v = k_axes[a][2];
+
+                    // bucket triangles by the slices their crossings can land in
+                    u32 nv = ctx.n[ctx.v];
+                    ctx.bucket_start = (u32*)pen::memory_alloc(sizeof(u32) * (nv + 1));
+                    memset(ctx.bucket_start, 0, sizeof(u32) * (nv + 1));
+
+                    for (u32 pass = 0; pass < 2; ++pass)
+                    {
+                        if (pass == 1)
+                        {
+                            u32 total = 0;
+                            for (u32 s = 0; s <= nv; ++s)
+                            {
+                                u32 c = ctx.bucket_start[s];
+                                ctx.bucket_start[s] = total;
+                                total += c;
+                            }
+                            ctx.bucket_tris = (u32*)pen::memory_alloc(sizeof(u32) * std::max<u32>(total, 1));
+                        }
+
+                        for (u32 t = 0; t < num_tris; ++t)
+                        {
+                            f64 p = ctx.grid_verts[mesh.indices[t * 3 + 0] * 3 + ctx.v];
+                            f64 q = ctx.grid_verts[mesh.indices[t * 3 + 1] * 3 + ctx.v];
+                            f64 r = ctx.grid_verts[mesh.indices[t * 3 + 2] * 3 + ctx.v];
+
+                            s32 s0 = std::max((s32)std::ceil(std::min(std::min(p, q), r)), 0);
+                            s32 s1 = std::min((s32)std::floor(std::max(std::max(p, q), r)), (s32)nv - 1);
+
+                            for (s32 s = s0; s <= s1; ++s)
+                            {
+                                if (pass == 0)
+                                    ctx.bucket_start[s]++;
+                                else
+                                    ctx.bucket_tris[ctx.bucket_start[s]++] = t;
+                            }
+                        }
+                    }
+
+                    // fill advanced each start to the next bucket's
+                    for (u32 s = nv; s > 0; --s)
+                        ctx.bucket_start[s] = ctx.bucket_start[s - 1];
+                    ctx.bucket_start[0] = 0;
+
+                    complete = dispatch_slices(ctx, nv, parity_slices, progress, (f32)a / num_axes, 1.0f / num_axes);
+
+                    pen::memory_free(ctx.bucket_start);
+                    pen::memory_free(ctx.bucket_tris);
+                }
+
+                if (complete)
+                    complete = dispatch_slices(ctx, ctx.n[2], apply_sign_slices, nullptr, 0.0f, 0.0f);
+
+                pen::memory_free(ctx.grid_verts);
+                pen::memory_free(ctx.votes);
+
+                return complete;
+            }
+        } // namespace
+
+        bool add_geometry(bake_mesh& mesh, const ecs::geometry_resource* gr, const mat4& world)
+        {
+            const vec4f* positions = (const vec4f*)gr->cpu_position_buffer;
+            if (!positions || !gr->cpu_index_buffer)
+                return false;
+
+            u32 base = sb_count(mesh.vertices);
+            for (u32 i = 0; i < gr->num_vertices; ++i)
+                sb_push(mesh.vertices, world.transform_vector(positions[i].xyz));
+
+            for (u32 i = 0; i < gr->num_indices; ++i)
+            {
+                u32 index;
+                if (gr->index_type == PEN_FORMAT_R32_UINT)
+                    index = ((const u32*)gr->cpu_index_buffer)[i];
+                else
+                    index = ((const u16*)gr->cpu_index_buffer)[i];
+
+                sb_push(mesh.indices, base + index);
+            }
+
+            return true;
+        }
+
+        void free_mesh(bake_mesh& mesh)
+        {
+            sb_free(mesh.vertices);
+            sb_free(mesh.indices);
+            mesh.vertices = nullptr;
+            mesh.indices = nullptr;
+        }
+
+        bool bake(const bake_params& params, f32* phi, bake_stats* stats)
+        {
+            f32 start = pen::get_time_ms();
+
+            bake_stats st;
+            st.num_triangles = sb_count(params.mesh->indices) / 3;
+            st.num_voxels = params.nx * params.ny * params.nz;
+
+            if (params.progress)
+            {
+                params.progress->triangles = 0.0f;
+                params.progress->sweeps = 0.0f;
+            }
+
+            if (st.num_triangles == 0)
+            {
+                // upper bound on distance, as make_level_set3
+                f32 upper = (params.nx + params.ny + params.nz) * params.dx;
+                for (u32 i = 0; i < st.num_voxels; ++i)
+                    phi[i] = upper;
+
+                if (stats)
+                    *stats = st;
+
+                return true;
+            }
+
+            bake_context ctx;
+            ctx.params = &params;
+            ctx.mesh = params.mesh;
+            ctx.phi = phi;
+            ctx.n[0] = params.nx;
+            ctx.n[1] = params.ny;
+            ctx.n[2] = params.nz;
+
+            build_bvh(ctx.tree, *params.mesh);
+            st.num_nodes = sb_count(ctx.tree.nodes);
+            st.build_ms = pen::get_time_ms() - start;
+
+            f32* progress = params.progress ? &params.progress->triangles : nullptr;
+
+            f32  distance_start = pen::get_time_ms();
+            bool complete = dispatch_slices(ctx, params.nz, distance_slices, progress, 0.0f, 1.0f);
+            st.distance_ms = pen::get_time_ms() - distance_start;
+
+            sb_free(ctx.tree.nodes);
+            sb_free(ctx.tree.packets);
+
+            if (complete && params.sign_mode != SIGN_NONE)
+            {
+                f32 sign_start = pen::get_time_ms();
+                complete = bake_sign(ctx);
+                st.sign_ms = pen::get_time_ms() - sign_start;
+            }
+            else if (params.progress)
+            {
+                params.progress->sweeps = 1.0f;
+            }
+
+            st.total_ms = pen::get_time_ms() - start;
+
+            if (stats)
+                *stats = st;
+
+            return complete;
+        }
+    } // namespace sdf
+} // namespace put
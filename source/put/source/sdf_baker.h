@@ -0,0 +1,77 @@
+// sdf_baker.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "maths/mat.h"
+#include "maths/vec.h"
+#include "pen.h"
+
+#include <atomic>
+
+// Signed distance field baking for triangle meshes.
+// Triangles are packed 4 to a leaf of a 4 wide bvh so closest point queries test 4 boxes or 4 triangles at once with
+// sse. Each voxel is an exact nearest triangle query seeded with the closest triangle of the voxel before it, which
+// bounds the search tightly enough to prune almost the whole tree. Signs come from the parity of ray crossings along
+// grid rows, the same robust 2d test sdf_gen uses, optionally voted across all 3 axes so a hole only flips one ray.
+// Both passes are split into z slices on the worker pool, dispatched in small batches so cancellation is responsive
+// and the pool is not held for the whole bake.
+// phi is laid out x fastest, voxel (i, j, k) is the grid point origin + (i, j, k) * dx as with make_level_set3.
+
+struct mls_progress;
+
+namespace put
+{
+    namespace ecs
+    {
+        struct geometry_resource;
+    }
+
+    namespace sdf
+    {
+        enum e_sign_mode
+        {
+            SIGN_NONE,       // unsigned distance, for meshes which are not water tight
+            SIGN_PARITY,     // crossings along x only, matches make_level_set3
+            SIGN_PARITY_VOTE // majority of crossings along x, y and z
+        };
+
+        struct bake_mesh
+        {
+            vec3f* vertices = nullptr; // stretchy buffers
+            u32*   indices = nullptr;
+        };
+
+        struct bake_params
+        {
+            const bake_mesh*   mesh = nullptr;
+            vec3f              origin = vec3f::zero();
+            f32                dx = 1.0f;
+            u32                nx = 0;
+            u32                ny = 0;
+            u32                nz = 0;
+            u32                sign_mode = SIGN_PARITY;
+            std::atomic<bool>* cancel = nullptr;
+            mls_progress*      progress = nullptr; // triangles receives distance progress, sweeps sign progress
+        };
+
+        struct bake_stats
+        {
+            u32 num_triangles = 0;
+            u32 num_nodes = 0;
+            u32 num_voxels = 0;
+            f32 build_ms = 0.0f;
+            f32 distance_ms = 0.0f;
+            f32 sign_ms = 0.0f;
+            f32 total_ms = 0.0f;
+        };
+
+        // appends lod 0 of gr transformed by world, returns false if gr has no cpu positions or indices
+        bool add_geometry(bake_mesh& mesh, const ecs::geometry_resource* gr, const mat4& world);
+        void free_mesh(bake_mesh& mesh);
+
+        // fills phi with nx * ny * nz distances, returns false if cancelled
+        bool bake(const bake_params& params, f32* phi, bake_stats* stats = nullptr);
+    } // namespace sdf
+} // namespace put
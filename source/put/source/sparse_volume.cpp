@@ -0,0 +1,498 @@
+// sparse_volume.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "sparse_volume.h"
+
+#include "file_system.h"
+#include "memory.h"
+#include "threads.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+
+namespace put
+{
+    namespace sparse
+    {
+        namespace
+        {
+            static const u32 k_magic = 0x42564d50; // PMVB
+            static const u32 k_version = 1;
+
+            struct file_header
+            {
+                u32 magic;
+                u32 version;
+                u32 format;
+                u32 block_size;
+                u32 num_mips;
+                u32 brick_size;
+            };
+
+            struct level_header
+            {
+                u32 dim[3];
+                u32 num_pool_bricks;
+                u32 num_uniform_bricks;
+            };
+
+            enum brick_class
+            {
+                BRICK_EMPTY,
+                BRICK_UNIFORM,
+                BRICK_POOL
+            };
+
+            struct level_context
+            {
+                level* lv;
+                u8*    texels; // dense level
+                u32    block_size;
+                u32    format;
+                f32    band;
+                u8*    classes;        // brick_class per brick
+                u8*    uniform_values; // one texel per brick, valid for uniform bricks
+            };
+
+            u32 num_bricks(const level& lv)
+            {
+                return lv.num_bricks[0] * lv.num_bricks[1] * lv.num_bricks[2];
+            }
+
+            u32 level_size(const level& lv, u32 block_size)
+            {
+                return lv.dim[0] * lv.dim[1] * lv.dim[2] * block_size;
+            }
+
+            void init_level(level& lv, u32 w, u32 h, u32 d)
+            {
+                lv.dim[0] = w;
+                lv.dim[1] = h;
+                lv.dim[2] = d;
+
+                for (u32 c = 0; c < 3; ++c)
+                    lv.num_bricks[c] = (lv.dim[c] + k_brick_size - 1) / k_brick_size;
+            }
+
+            // texel bounds of brick b clipped to the level
+            void brick_bounds(const level& lv, u32 b, u32* lo, u32* hi)
+            {
+                u32 bc[3];
+                bc[0] = b % lv.num_bricks[0];
+                bc[1] = (b / lv.num_bricks[0]) % lv.num_bricks[1];
+                bc[2] = b / (lv.num_bricks[0] * lv.num_bricks[1]);
+
+                for (u32 c = 0; c < 3; ++c)
+                {
+                    lo[c] = bc[c] * k_brick_size;
+                    hi[c] = std::min(lo[c] + k_brick_size, lv.dim[c]);
+                }
+            }
+
+            void classify_range(u32 start, u32 end, void* user_data)
+            {
+                level_context& ctx = *(level_context*)user_data;
+                const level&   lv = *ctx.lv;
+
+                u32  bs = ctx.block_size;
+                u32  row_pitch = lv.dim[0] * bs;
+                u32  slice_pitch = lv.dim[1] * row_pitch;
+                bool banded = ctx.band > 0.0f && ctx.format == PEN_TEX_FORMAT_R32_FLOAT;
+
+                for (u32 b = start; b < end; ++b)
+                {
+                    u32 lo[3], hi[3];
+                    brick_bounds(lv, b, lo, hi);
+
+                    const u8* first = ctx.texels + lo[2] * slice_pitch + lo[1] * row_pitch + lo[0] * bs;
+
+                    bool zero = true;
+                    bool same = true;
+                    f32  min_dist = FLT_MAX;
+                    u32  signs = 0; // bit 0 positive, bit 1 negative
+
+                    for (u32 z = lo[2]; z < hi[2]; ++z)
+                    {
+                        for (u32 y = lo[1]; y < hi[1]; ++y)
+                        {
+                            const u8* row = ctx.texels + z * slice_pitch + y * row_pitch;
+                            for (u32 x = lo[0]; x < hi[0]; ++x)
+                            {
+                                const u8* texel = row + x * bs;
+
+                                if (same && memcmp(texel, first, bs) != 0)
+                                    same = false;
+
+                                for (u32 i = 0; zero && i < bs; ++i)
+                                    zero = texel[i] == 0;
+
+                                if (banded)
+                                {
+                                    f32 d;
+                                    memcpy(&d, texel, sizeof(f32));
+                                    min_dist = std::min(min_dist, (f32)fabs(d));
+                                    signs |= d < 0.0f ? 2 : 1;
+                                }
+                            }
+                        }
+                    }
+
+                    u8* uniform = ctx.uniform_values + b * bs;
+
+                    if (zero)
+                    {
+                        ctx.classes[b] = BRICK_EMPTY;
+                    }
+                    else if (same)
+                    {
+                        ctx.classes[b] = BRICK_UNIFORM;
+                        memcpy(uniform, first, bs);
+                    }
+                    else if (banded && min_dist > ctx.band && signs != 3)
+                    {
+                        // the nearest distance in the brick is a lower bound for all of it
+                        f32 d = signs == 2 ? -min_dist : min_dist;
+                        ctx.classes[b] = BRICK_UNIFORM;
+                        memcpy(uniform, &d, sizeof(f32));
+                    }
+                    else
+                    {
+                        ctx.classes[b] = BRICK_POOL;
+                    }
+                }
+            }
+
+            void gather_range(u32 start, u32 end, void* user_data)
+            {
+                level_context& ctx = *(level_context*)user_data;
+                level&         lv = *ctx.lv;
+
+                u32 bs = ctx.block_size;
+                u32 row_pitch = lv.dim[0] * bs;
+                u32 slice_pitch = lv.dim[1] * row_pitch;
+
+                for (u32 b = start; b < end; ++b)
+                {
+                    if (ctx.classes[b] != BRICK_POOL)
+                        continue;
+
+                    u32 lo[3], hi[3];
+                    brick_bounds(lv, b, lo, hi);
+
+                    u8* brick = lv.pool + lv.table[b] * k_brick_texels * bs;
+                    u32 row_size = (hi[0] - lo[0]) * bs;
+
+                    for (u32 z = lo[2]; z < hi[2]; ++z)
+                    {
+                        for (u32 y = lo[1]; y < hi[1]; ++y)
+                        {
+                            const u8* src = ctx.texels + z * slice_pitch + y * row_pitch + lo[0] * bs;
+                            u8*       dst = brick + ((z - lo[2]) * k_brick_size + (y - lo[1])) * k_brick_size * bs;
+                            memcpy(dst, src, row_size);
+                        }
+                    }
+                }
+            }
+
+            void scatter_range(u32 start, u32 end, void* user_data)
+            {
+                level_context& ctx = *(level_context*)user_data;
+                const level&   lv = *ctx.lv;
+
+                u32 bs = ctx.block_size;
+                u32 row_pitch = lv.dim[0] * bs;
+                u32 slice_pitch = lv.dim[1] * row_pitch;
+
+                for (u32 b = start; b < end; ++b)
+                {
+                    u32 entry = lv.table[b];
+                    if (entry == k_empty)
+                        continue; // dense texels are cleared up front
+
+                    u32 lo[3], hi[3];
+                    brick_bounds(lv, b, lo, hi);
+
+                    for (u32 z = lo[2]; z < hi[2]; ++z)
+                    {
+                        for (u32 y = lo[1]; y < hi[1]; ++y)
+                        {
+                            u8* dst = ctx.texels + z * slice_pitch + y * row_pitch + lo[0] * bs;
+
+                            if (entry & k_uniform)
+                            {
+                                const u8* uniform = lv.uniforms + (entry & ~k_uniform) * bs;
+                                for (u32 x = lo[0]; x < hi[0]; ++x, dst += bs)
+                                    memcpy(dst, uniform, bs);
+                            }
+                            else
+                            {
+                                const u8* src = lv.pool + entry * k_brick_texels * bs;
+                                src += ((z - lo[2]) * k_brick_size + (y - lo[1])) * k_brick_size * bs;
+                                memcpy(dst, src, (hi[0] - lo[0]) * bs);
+                            }
+                        }
+                    }
+                }
+            }
+
+            template <class T>
+            bool read(const u8*& cur, const u8* end, T* dst, u32 count)
+            {
+                u32 size = sizeof(T) * count;
+                if ((u32)(end - cur) < size)
+                    return false;
+
+                memcpy(dst, cur, size);
+                cur += size;
+                return true;
+            }
+        } // namespace
+
+        void encode(volume& v, const pen::texture_creation_params& tcp, const encode_params& params)
+        {
+            release(v);
+
+            v.format = tcp.format;
+            v.block_size = tcp.block_size;
+            v.num_mips = std::max<u32>(tcp.num_mips, 1);
+            v.levels = (level*)pen::memory_alloc(sizeof(level) * v.num_mips);
+
+            u8* texels = (u8*)tcp.data;
+
+            u32 w = tcp.width;
+            u32 h = tcp.height;
+            u32 d = tcp.num_arrays;
+
+            for (u32 m = 0; m < v.num_mips; ++m)
+            {
+                level& lv = v.levels[m];
+                lv = level();
+                init_level(lv, w, h, d);
+
+                u32 nb = num_bricks(lv);
+
+                level_context ctx;
+                ctx.lv = &lv;
+                ctx.texels = texels;
+                ctx.block_size = v.block_size;
+                ctx.format = v.format;
+                ctx.band = params.sdf_band;
+                ctx.classes = (u8*)pen::memory_alloc(nb);
+                ctx.uniform_values = (u8*)pen::memory_alloc(nb * v.block_size);
+
+                pen::jobs_parallel_for(nb, 64, classify_range, &ctx);
+
+                // compact into the table, pool and uniform indices follow brick order
+                lv.table = (u32*)pen::memory_alloc(sizeof(u32) * nb);
+                for (u32 b = 0; b < nb; ++b)
+                {
+                    if (ctx.classes[b] == BRICK_EMPTY)
+                        lv.table[b] = k_empty;
+                    else if (ctx.classes[b] == BRICK_UNIFORM)
+                        lv.table[b] = k_uniform | lv.num_uniform_bricks++;
+                    else
+                        lv.table[b] = lv.num_pool_bricks++;
+                }
+
+                lv.uniforms = (u8*)pen::memory_alloc(std::max<u32>(lv.num_uniform_bricks * v.block_size, 1));
+                for (u32 b = 0; b < nb; ++b)
+                    if (ctx.classes[b] == BRICK_UNIFORM)
+                        memcpy(lv.uniforms + (lv.table[b] & ~k_uniform) * v.block_size,
+                               ctx.uniform_values + b * v.block_size, v.block_size);
+
+                u32 pool_size = lv.num_pool_bricks * k_brick_texels * v.block_size;
+                lv.pool = (u8*)pen::memory_alloc(std::max<u32>(pool_size, 1));
+                memset(lv.pool, 0, pool_size);
+
+                pen::jobs_parallel_for(nb, 64, gather_range, &ctx);
+
+                pen::memory_free(ctx.classes);
+                pen::memory_free(ctx.uniform_values);
+
+                texels += level_size(lv, v.block_size);
+
+                w = std::max<u32>(w / 2, 1);
+                h = std::max<u32>(h / 2, 1);
+                d = std::max<u32>(d / 2, 1);
+            }
+        }
+
+        void decode(const volume& v, pen::texture_creation_params& tcp)
+        {
+            u32 data_size = 0;
+            for (u32 m = 0; m < v.num_mips; ++m)
+                data_size += level_size(v.levels[m], v.block_size);
+
+            u8* data = (u8*)pen::memory_alloc(data_size);
+            memset(data, 0, data_size);
+
+            u8* texels = data;
+            for (u32 m = 0; m < v.num_mips; ++m)
+            {
+                level_context ctx;
+                ctx.lv = &v.levels[m];
+                ctx.texels = texels;
+                ctx.block_size = v.block_size;
+
+                pen::jobs_parallel_for(num_bricks(v.levels[m]), 64, scatter_range, &ctx);
+
+                texels += level_size(v.levels[m], v.block_size);
+            }
+
+            tcp.collection_type = pen::TEXTURE_COLLECTION_VOLUME;
+            tcp.width = v.levels[0].dim[0];
+            tcp.height = v.levels[0].dim[1];
+            tcp.num_arrays = v.levels[0].dim[2];
+            tcp.format = v.format;
+            tcp.num_mips = v.num_mips;
+            tcp.sample_count = 1;
+            tcp.sample_quality = 0;
+            tcp.usage = PEN_USAGE_DEFAULT;
+            tcp.bind_flags = PEN_BIND_SHADER_RESOURCE;
+            tcp.cpu_access_flags = 0;
+            tcp.flags = 0;
+            tcp.block_size = v.block_size;
+            tcp.pixels_per_block = 1;
+            tcp.data = data;
+            tcp.data_size = data_size;
+        }
+
+        bool save(const c8* filename, const volume& v)
+        {
+            std::ofstream ofs(filename, std::ofstream::binary);
+            if (!ofs.is_open())
+                return false;
+
+            file_header fh = {k_magic, k_version, v.format, v.block_size, v.num_mips, k_brick_size};
+            ofs.write((const c8*)&fh, sizeof(fh));
+
+            for (u32 m = 0; m < v.num_mips; ++m)
+            {
+                const level& lv = v.levels[m];
+
+                level_header lh = {{lv.dim[0], lv.dim[1], lv.dim[2]}, lv.num_pool_bricks, lv.num_uniform_bricks};
+                ofs.write((const c8*)&lh, sizeof(lh));
+
+                ofs.write((const c8*)lv.table, sizeof(u32) * num_bricks(lv));
+                ofs.write((const c8*)lv.uniforms, lv.num_uniform_bricks * v.block_size);
+                ofs.write((const c8*)lv.pool, lv.num_pool_bricks * k_brick_texels * v.block_size);
+            }
+
+            ofs.close();
+            return true;
+        }
+
+        bool load(const c8* filename, volume& v)
+        {
+            release(v);
+
+            void* file_data = nullptr;
+            u32   file_size = 0;
+
+            if (pen::filesystem_read_file_to_buffer(filename, &file_data, file_size) != PEN_ERR_OK)
+                return false;
+
+            const u8* cur = (const u8*)file_data;
+            const u8* end = cur + file_size;
+
+            file_header fh;
+            bool        ok = read(cur, end, &fh, 1);
+            ok = ok && fh.magic == k_magic && fh.version == k_version && fh.brick_size == k_brick_size;
+            ok = ok && fh.num_mips > 0 && fh.num_mips <= 32 && fh.block_size > 0 && fh.block_size <= 16;
+
+            if (ok)
+            {
+                v.format = fh.format;
+                v.block_size = fh.block_size;
+                v.num_mips = fh.num_mips;
+                v.levels = (level*)pen::memory_alloc(sizeof(level) * v.num_mips);
+
+                for (u32 m = 0; m < v.num_mips; ++m)
+                    v.levels[m] = level();
+            }
+
+            for (u32 m = 0; ok && m < v.num_mips; ++m)
+            {
+                level& lv = v.levels[m];
+
+                level_header lh;
+                ok = read(cur, end, &lh, 1);
+                if (!ok)
+                    break;
+
+                init_level(lv, lh.dim[0], lh.dim[1], lh.dim[2]);
+                lv.num_pool_bricks = lh.num_pool_bricks;
+                lv.num_uniform_bricks = lh.num_uniform_bricks;
+
+                u32 nb = num_bricks(lv);
+                u32 uniform_size = lv.num_uniform_bricks * v.block_size;
+                u32 pool_size = lv.num_pool_bricks * k_brick_texels * v.block_size;
+
+                lv.table = (u32*)pen::memory_alloc(sizeof(u32) * std::max<u32>(nb, 1));
+                lv.uniforms = (u8*)pen::memory_alloc(std::max<u32>(uniform_size, 1));
+                lv.pool = (u8*)pen::memory_alloc(std::max<u32>(pool_size, 1));
+
+                ok = read(cur, end, lv.table, nb) && read(cur, end, lv.uniforms, uniform_size) &&
+                     read(cur, end, lv.pool, pool_size);
+
+                // reject tables which index outside of the pool or uniforms
+                for (u32 b = 0; ok && b < nb; ++b)
+                {
+                    u32 e = lv.table[b];
+                    if (e == k_empty)
+                        continue;
+
+                    if (e & k_uniform)
+                        ok = (e & ~k_uniform) < lv.num_uniform_bricks;
+                    else
+                        ok = e < lv.num_pool_bricks;
+                }
+            }
+
+            pen::memory_free(file_data);
+
+            if (!ok)
+                release(v);
+
+            return ok;
+        }
+
+        void release(volume& v)
+        {
+            for (u32 m = 0; m < v.num_mips; ++m)
+            {
+                pen::memory_free(v.levels[m].table);
+                pen::memory_free(v.levels[m].uniforms);
+                pen::memory_free(v.levels[m].pool);
+            }
+
+            pen::memory_free(v.levels);
+            v = volume();
+        }
+
+        volume_stats get_stats(const volume& v)
+        {
+            volume_stats st;
+
+            for (u32 m = 0; m < v.num_mips; ++m)
+            {
+                const level& lv = v.levels[m];
+                u32          nb = num_bricks(lv);
+
+                st.num_bricks += nb;
+                st.num_pool += lv.num_pool_bricks;
+                st.num_uniform += lv.num_uniform_bricks;
+                st.num_empty += nb - lv.num_pool_bricks - lv.num_uniform_bricks;
+
+                st.dense_size += level_size(lv, v.block_size);
+                st.sparse_size += sizeof(u32) * nb + lv.num_uniform_bricks * v.block_size;
+                st.sparse_size += lv.num_pool_bricks * k_brick_texels * v.block_size;
+            }
+
+            return st;
+        }
+    } // namespace sparse
+} // namespace put
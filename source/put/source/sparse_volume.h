@@ -0,0 +1,73 @@
+// sparse_volume.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "pen.h"
+#include "renderer.h"
+
+// Sparse brick storage for volume textures.
+// Each mip level is split into bricks of k_brick_size^3 texels with an indirection table of one entry per brick. Bricks
+// with every texel zero are dropped, bricks with every texel the same keep a single texel, and only the rest are stored
+// in the brick pool, so memory follows the surface of a volume rather than its size. Signed distance fields can
+// optionally collapse bricks which are entirely further than a band from the surface to their nearest distance, which
+// stays a lower bound for sphere tracing.
+// The gpu still samples a dense texture, decode expands the bricks into texture creation params for upload.
+
+namespace put
+{
+    namespace sparse
+    {
+        static const u32 k_brick_size = 8;
+        static const u32 k_brick_texels = k_brick_size * k_brick_size * k_brick_size;
+        static const u32 k_empty = 0xffffffff;
+        static const u32 k_uniform = 1u << 31; // table entries with this bit index uniforms, else the pool
+
+        struct level
+        {
+            u32  dim[3];
+            u32  num_bricks[3];
+            u32  num_pool_bricks = 0;
+            u32  num_uniform_bricks = 0;
+            u32* table = nullptr;    // num_bricks x * y * z, x fastest
+            u8*  uniforms = nullptr; // one texel per uniform brick
+            u8*  pool = nullptr;     // k_brick_texels per brick, x fastest, texels outside the level are zero
+        };
+
+        struct volume
+        {
+            u32    format = 0;
+            u32    block_size = 0;
+            u32    num_mips = 0;
+            level* levels = nullptr;
+        };
+
+        struct encode_params
+        {
+            f32 sdf_band = 0.0f; // r32 float only, bricks further than this from the surface become uniform, 0 lossless
+        };
+
+        struct volume_stats
+        {
+            u32 num_bricks = 0;
+            u32 num_empty = 0;
+            u32 num_uniform = 0;
+            u32 num_pool = 0;
+            u32 dense_size = 0;
+            u32 sparse_size = 0;
+        };
+
+        // encodes the volume and any mips in tcp.data, tcp is unchanged
+        void encode(volume& v, const pen::texture_creation_params& tcp, const encode_params& params = encode_params());
+
+        // fills tcp for a volume texture with a dense copy of all levels, release tcp.data with pen::memory_free
+        void decode(const volume& v, pen::texture_creation_params& tcp);
+
+        bool save(const c8* filename, const volume& v);
+        bool load(const c8* filename, volume& v);
+        void release(volume& v);
+
+        volume_stats get_stats(const volume& v);
+    } // namespace sparse
+} // namespace put
@@ -11,9 +11,13 @@
 #include "ecs/ecs_resources.h"
 #include "ecs/ecs_scene.h"
 #include "ecs/ecs_utilities.h"
+#include "mip_generator.h"
 #include "pmfx.h"
+#include "sdf_baker.h"
+#include "sparse_volume.h"
 #include "str_utilities.h"
 #include "timer.h"
+#include "voxeliser.h"
 
 #include "console.h"
 #include "data_struct.h"
@@ -23,22 +27,8 @@
 
 #include "sdf_gen/makelevelset3.h"
 
-#define PEN_SIMD 0
-#if PEN_SIMD
-#include <emmintrin.h>
-#include <tmmintrin.h>
-#include <xmmintrin.h>
-#endif
-
 #include <fstream>
 
-u8 temp[16];
-#define SIMD_PRINT_u8(V)                                                                                                     \
-    memcpy(temp, &V, 16);                                                                                                    \
-    for (u32 i = 0; i < 16; ++i)                                                                                             \
-        printf("%i ", (u32)temp[i]);                                                                                         \
-    printf("\n");
-
 // Progress / Cancellation
 extern mls_progress g_mls_progress;
 std::atomic<bool>   g_cancel_volume_job;
@@ -89,6 +79,12 @@ namespace put
             CAPTURE_CUSTOM
         };
 
+        enum rasterise_method
+        {
+            RASTERISE_CPU_VOXELISE = 0, // triangle / box overlap on the worker pool
+            RASTERISE_GPU_SLICES        // render and read back a slice per texel along each axis
+        };
+
         enum capture
         {
             CAPTURE_ALL,
@@ -101,13 +97,15 @@ namespace put
             u32  rasterise_axes = AXIS_ALL_MASK;
             s32  volume_type = VOLUME_RASTERISED_TEXELS;
             s32  capture_data = 0;
+            s32  rasterise_method = RASTERISE_CPU_VOXELISE;
             bool generate_mips = true;
         };
 
         struct generated_volume
         {
             u32                          texture;
-            pen::texture_creation_params tcp;
+            pen::texture_creation_params tcp; // dense data is only kept until the texture is created
+            sparse::volume               bricks;
             u32                          scene_node_index;
             vec3f                        scale;
             vec3f                        pos;
@@ -130,6 +128,7 @@ namespace put
             u32         data_size;
             s32         capture_type = 0;
             u32         generated_volume_index;
+            ecs_scene*  scene;
         };
         static vgt_rasteriser_job s_rasteriser_job;
 
@@ -150,7 +149,8 @@ namespace put
             u8*         volume_data;
             extents     scene_extents;
             vec3f       scene_centre;
-            bool        trust_sign = true;
+            s32         sign_mode = sdf::SIGN_PARITY_VOTE;
+            f32         sparse_band = 0.0f; // in texels, 0 keeps every distance
             f32         padding;
             u32         generate_in_progress = 0;
             s32         capture_type = 0;
@@ -163,7 +163,7 @@ namespace put
 
         // Forwards
         generated_volume create_volume_from_data(u32 volume_dim, u32 block_size, u32 data_size, u32 tex_format,
-                                                 u8* volume_data, bool generate_mips);
+                                                 u8* volume_data, bool generate_mips, f32 sdf_band = 0.0f);
 
         u8* get_texel(u32 axis, u32 x, u32 y, u32 z)
         {
@@ -404,447 +404,129 @@ namespace put
             return PEN_THREAD_OK;
         }
 
-        void generate_mips_r32f_simd(pen::texture_creation_params& tcp)
+        vec4f get_albedo(ecs_scene* scene, u32 n)
         {
-#if PEN_SIMD
-            // calc num mips
-            u32              num_mips = 1;
-            u32              data_size = 0;
-            static const u32 block_size = 4;
-
-            vec3ui m = vec3ui(tcp.width, tcp.height, tcp.num_arrays);
-
-            while (m.x > 1 && m.y > 1 && m.z > 1)
-            {
-                data_size += m.x * m.y * m.z * block_size;
-
-                num_mips++;
-
-                m /= vec3ui(2, 2, 2);
-                m = max_union(m, vec3ui::one());
-            }
-
-            data_size += block_size; // final mip
+            static hash_id id_albedo = PEN_HASH("albedo");
 
-            // offsets
-            vec3ui offsets[] = {vec3ui(0, 0, 0), vec3ui(0, 1, 0), vec3ui(0, 0, 1), vec3ui(0, 1, 1)};
+            if (!(scene->entities[n] & CMP_MATERIAL))
+                return vec4f::one();
 
-            u8* data = (u8*)pen::memory_alloc_align(data_size, 16);
-            memcpy(data, tcp.data, tcp.data_size);
+            cmp_material&             mat = scene->materials[n];
+            pmfx::technique_constant* tc = pmfx::get_technique_constant(id_albedo, mat.shader, mat.technique_index);
 
-            m = vec3ui(tcp.width, tcp.height, tcp.num_arrays);
+            if (!tc || tc->num_elements < 4)
+                return vec4f::one();
 
-            u8* prev_level = (u8*)data;
-            u8* cur_level = prev_level + tcp.data_size;
-
-            __m128 vrecip = _mm_set1_ps(1.0f / 8.0f);
-            __m128 r00, r01, r10, r11;
-            __m128 d00, d01, d10, d11;
-
-            u32 p_offset[4];
-
-            for (u32 i = 0; i < num_mips - 1; ++i)
-            {
-                u32 p_rp = m.x * block_size; // prev row pitch
-                u32 p_sp = p_rp * m.y;       // prev slice pitch
-
-                m /= vec3ui(2, 2, 2);
-                m = max_union(m, vec3ui::one());
-
-                u32 c_rp = m.x * block_size; // cur row pitch
-                u32 c_sp = c_rp * m.y;       // cur slice pitch
-
-                u32 block_copy_size = std::min<u32>(m.x * 4, 16);
-                u32 block_offset = block_copy_size < 16 ? 0 : 16;
-
-                for (u32 z = 0; z < m.z; ++z)
-                {
-                    for (u32 y = 0; y < m.y; ++y)
-                    {
-                        for (u32 x = 0; x < m.x; x += 4)
-                        {
-                            vec3ui vobase = vec3ui(x * 2, y * 2, z * 2);
-                            vec3ui vo = vobase;
-                            p_offset[0] = p_sp * vo.z + p_rp * vo.y + block_size * vo.x;
-
-                            vo = vobase + offsets[1];
-                            p_offset[1] = p_sp * vo.z + p_rp * vo.y + block_size * vo.x;
-
-                            vo = vobase + offsets[2];
-                            p_offset[2] = p_sp * vo.z + p_rp * vo.y + block_size * vo.x;
-
-                            vo = vobase + offsets[3];
-                            p_offset[3] = p_sp * vo.z + p_rp * vo.y + block_size * vo.x;
-
-                            memcpy(&r00, &prev_level[p_offset[0]], block_copy_size);
-                            memcpy(&r01, &prev_level[p_offset[0] + block_offset], block_copy_size);
-                            memcpy(&r10, &prev_level[p_offset[1]], block_copy_size);
-                            memcpy(&r11, &prev_level[p_offset[1] + block_offset], block_copy_size);
-
-                            memcpy(&d00, &prev_level[p_offset[2]], block_copy_size);
-                            memcpy(&d01, &prev_level[p_offset[2] + block_offset], block_copy_size);
-                            memcpy(&d10, &prev_level[p_offset[3]], block_copy_size);
-                            memcpy(&d11, &prev_level[p_offset[3] + block_offset], block_copy_size);
-
-                            __m128 x0 = _mm_shuffle_ps(r00, r01, _MM_SHUFFLE(2, 0, 2, 0));
-                            __m128 x1 = _mm_shuffle_ps(r00, r01, _MM_SHUFFLE(3, 1, 3, 1));
-                            __m128 x2 = _mm_shuffle_ps(r10, r11, _MM_SHUFFLE(2, 0, 2, 0));
-                            __m128 x3 = _mm_shuffle_ps(r10, r11, _MM_SHUFFLE(3, 1, 3, 1));
-                            __m128 x4 = _mm_shuffle_ps(d00, d01, _MM_SHUFFLE(2, 0, 2, 0));
-                            __m128 x5 = _mm_shuffle_ps(d00, d01, _MM_SHUFFLE(3, 1, 3, 1));
-                            __m128 x6 = _mm_shuffle_ps(d10, d11, _MM_SHUFFLE(2, 0, 2, 0));
-                            __m128 x7 = _mm_shuffle_ps(d10, d11, _MM_SHUFFLE(3, 1, 3, 1));
-
-                            __m128 output = _mm_add_ps(x0, x1);
-                            output = _mm_add_ps(output, x2);
-                            output = _mm_add_ps(output, x3);
-                            output = _mm_add_ps(output, x4);
-                            output = _mm_add_ps(output, x5);
-                            output = _mm_add_ps(output, x6);
-                            output = _mm_add_ps(output, x7);
-                            output = _mm_mul_ps(output, vrecip);
-
-                            u32 c_offset = c_sp * z + c_rp * y + block_size * x;
-                            memcpy(&cur_level[c_offset], &output, block_copy_size);
-                        }
-                    }
-                }
-
-                prev_level = cur_level;
-                cur_level += c_sp * m.z;
-            }
-
-            tcp.num_mips = num_mips;
-            tcp.data_size = data_size;
-
-            tcp.data = data;
-#endif
+            f32* albedo = &scene->material_data[n].data[tc->cb_offset];
+            return vec4f(albedo[0], albedo[1], albedo[2], albedo[3]);
         }
 
-        void generate_mips_rgba8_simd(pen::texture_creation_params& tcp)
+        PEN_TRV raster_voxelise(void* params)
         {
-#if PEN_SIMD
-            // calc num mips
-            u32              num_mips = 1;
-            u32              data_size = 0;
-            static const u32 block_size = 4;
-
-            vec3ui m = vec3ui(tcp.width, tcp.height, tcp.num_arrays);
-
-            while (m.x > 1 && m.y > 1 && m.z > 1)
-            {
-                data_size += m.x * m.y * m.z * block_size;
-
-                num_mips++;
-
-                m /= vec3ui(2, 2, 2);
-                m = max_union(m, vec3ui::one());
-            }
-
-            data_size += block_size; // final mip
-
-            // offsets
-            vec3ui offsets[] = {vec3ui(0, 0, 0), vec3ui(0, 1, 0), vec3ui(0, 0, 1), vec3ui(0, 1, 1)};
-
-            u8* data = (u8*)pen::memory_alloc(data_size);
-            memcpy(data, tcp.data, tcp.data_size);
-
-            m = vec3ui(tcp.width, tcp.height, tcp.num_arrays);
-
-            u8* prev_level = (u8*)data;
-            u8* cur_level = prev_level + tcp.data_size;
-
-            u32 p_offset[4];
-
-            __m128i r00, r01, r10, r11;
-            __m128i d00, d01, d10, d11;
-
-            uint8_t aumask[16] = {4, 5, 6, 7, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80};
-            uint8_t bumask[16] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 4, 5, 6, 7, 12, 13, 14, 15};
-            uint8_t cumask[16] = {0, 1, 2, 3, 8, 9, 10, 11, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80};
-            uint8_t dumask[16] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0, 1, 2, 3, 8, 9, 10, 11};
-
-            uint8_t u00[16] = {1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4};
-            uint8_t u01[16] = {5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7, 8, 8, 8, 8};
-
-            uint8_t u10[16];
-            uint8_t u11[16];
-
-            uint8_t ud00[16];
-            uint8_t ud01[16];
-
-            uint8_t ud10[16];
-            uint8_t ud11[16];
-
-            for (u32 i = 0; i < 16; ++i)
-            {
-                u10[i] = u00[i] + 10;
-                u11[i] = u01[i] + 10;
-
-                ud00[i] = u00[i] + 20;
-                ud01[i] = u01[i] + 20;
+            pen::job_thread_params* job_params = (pen::job_thread_params*)params;
+            vgt_rasteriser_job*     rasteriser_job = (vgt_rasteriser_job*)job_params->user_data;
+            pen::job*               p_thread_info = job_params->job_info;
+            pen::semaphore_post(p_thread_info->p_sem_continue, 1);
 
-                ud10[i] = u00[i] + 30;
-                ud11[i] = u01[i] + 30;
-            }
+            ecs_scene* scene = rasteriser_job->scene;
+            u32        volume_dim = rasteriser_job->dimension;
 
-            __m128i am, bm, cm, dm;
+            rasteriser_job->block_size = 4;
+            rasteriser_job->data_size = volume_dim * volume_dim * volume_dim * rasteriser_job->block_size;
+            rasteriser_job->combine_position = 0;
 
-            memcpy(&am, &aumask, 16);
-            memcpy(&bm, &bumask, 16);
-            memcpy(&cm, &cumask, 16);
-            memcpy(&dm, &dumask, 16);
+            // triangles in world space, coloured per entity as the capture data would have rendered them
+            voxel::voxel_mesh mesh;
 
-            for (u32 i = 0; i < num_mips - 1; ++i)
+            for (u32 n = 0; n < scene->num_entities; ++n)
             {
-                u32 p_rp = m.x * block_size; // prev row pitch
-                u32 p_sp = p_rp * m.y;       // prev slice pitch
+                if (!(scene->entities[n] & CMP_GEOMETRY) || (scene->state_flags[n] & SF_HIDDEN))
+                    continue;
 
-                m /= vec3ui(2, 2, 2);
-                m = max_union(m, vec3ui::one());
-
-                u32 c_rp = m.x * block_size; // cur row pitch
-                u32 c_sp = c_rp * m.y;       // cur slice pitch
-
-                u32 block_copy_size = std::min<u32>(m.x * 4, 16);
-                u32 block_offset = block_copy_size < 16 ? 0 : 16;
-
-                for (u32 z = 0; z < m.z; ++z)
+                if (rasteriser_job->capture_type == CAPTURE_SELECTED)
                 {
-                    for (u32 y = 0; y < m.y; ++y)
-                    {
-                        for (u32 x = 0; x < m.x; x += 4)
-                        {
-                            vec3ui vobase = vec3ui(x * 2, y * 2, z * 2);
-                            vec3ui vo = vobase;
-                            p_offset[0] = p_sp * vo.z + p_rp * vo.y + block_size * vo.x;
-
-                            vo = vobase + offsets[1];
-                            p_offset[1] = p_sp * vo.z + p_rp * vo.y + block_size * vo.x;
-
-                            vo = vobase + offsets[2];
-                            p_offset[2] = p_sp * vo.z + p_rp * vo.y + block_size * vo.x;
-
-                            vo = vobase + offsets[3];
-                            p_offset[3] = p_sp * vo.z + p_rp * vo.y + block_size * vo.x;
-
-                            memcpy(&r00, &prev_level[p_offset[0]], block_copy_size);
-                            memcpy(&r01, &prev_level[p_offset[0] + block_offset], block_copy_size);
-                            memcpy(&r10, &prev_level[p_offset[1]], block_copy_size);
-                            memcpy(&r11, &prev_level[p_offset[1] + block_offset], block_copy_size);
-
-                            memcpy(&d00, &prev_level[p_offset[2]], block_copy_size);
-                            memcpy(&d01, &prev_level[p_offset[2] + block_offset], block_copy_size);
-                            memcpy(&d10, &prev_level[p_offset[3]], block_copy_size);
-                            memcpy(&d11, &prev_level[p_offset[3] + block_offset], block_copy_size);
-
-                            // max of 4x4 rgba block
-                            __m128i x0 = _mm_max_epu8(r00, r10);
-                            x0 = _mm_max_epu8(x0, d00);
-                            x0 = _mm_max_epu8(x0, d10);
-
-                            __m128i x1 = _mm_max_epu8(r01, r11);
-                            x1 = _mm_max_epu8(x1, d01);
-                            x1 = _mm_max_epu8(x1, d11);
-
-                            // shuffle and interleave
-                            __m128i v0 = _mm_shuffle_epi8(x0, am);
-                            __m128i v1 = _mm_shuffle_epi8(x0, cm);
-                            __m128i y0 = _mm_shuffle_epi8(x1, bm);
-                            __m128i y1 = _mm_shuffle_epi8(x1, dm);
-
-                            __m128i vv = _mm_max_epu8(v0, v1);
-                            __m128i yy = _mm_max_epu8(y0, y1);
-                            __m128i output = _mm_max_epu8(vv, yy);
-
-                            u32 c_offset = c_sp * z + c_rp * y + block_size * x;
-                            memcpy(&cur_level[c_offset], &output, block_copy_size);
-                        }
-                    }
+                    if (!(scene->state_flags[n] & SF_SELECTED) && !(scene->state_flags[n] & SF_CHILD_SELECTED))
+                        continue;
                 }
 
-                prev_level = cur_level;
-                cur_level += c_sp * m.z;
-            }
-
-            tcp.num_mips = num_mips;
-            tcp.data_size = data_size;
-
-            tcp.data = data;
-#endif
-        }
-
-        void generate_mips_r32f(pen::texture_creation_params& tcp)
-        {
-            // calc num mips
-            u32              num_mips = 1;
-            u32              data_size = 0;
-            static const u32 block_size = 4;
-
-            vec3ui m = vec3ui(tcp.width, tcp.height, tcp.num_arrays);
-
-            while (m.x > 1 && m.y > 1 && m.z > 1)
-            {
-                data_size += m.x * m.y * m.z * block_size;
-
-                num_mips++;
-
-                m /= vec3ui(2, 2, 2);
-                m = max_union(m, vec3ui::one());
-            }
+                vec4f colour = vec4f::one();
+                if (rasteriser_job->options.capture_data == CAPTURE_ALBEDO)
+                    colour = get_albedo(scene, n);
 
-            data_size += block_size;
+                geometry_resource* gr = get_geometry_resource(scene->id_geometry[n]);
 
-            // offsets
-            vec3ui offsets[] = {vec3ui(0, 0, 0),
-
-                                vec3ui(1, 0, 0), vec3ui(0, 1, 0), vec3ui(1, 1, 0),
-
-                                vec3ui(0, 0, 1), vec3ui(1, 0, 1), vec3ui(0, 1, 1), vec3ui(1, 1, 1)};
-
-            u8* data = (u8*)pen::memory_alloc(data_size);
-            memcpy(data, tcp.data, tcp.data_size);
-
-            m = vec3ui(tcp.width, tcp.height, tcp.num_arrays);
-
-            u8* prev_level = (u8*)data;
-            u8* cur_level = prev_level + tcp.data_size;
-
-            for (u32 i = 0; i < num_mips - 1; ++i)
-            {
-                u32 p_rp = m.x * block_size; // prev row pitch
-                u32 p_sp = p_rp * m.y;       // prev slice pitch
-
-                m /= vec3ui(2, 2, 2);
-                m = max_union(m, vec3ui::one());
-
-                u32 c_rp = m.x * block_size; // cur row pitch
-                u32 c_sp = c_rp * m.y;       // cur slice pitch
-
-                for (u32 z = 0; z < m.z; ++z)
+                if (!voxel::add_geometry(mesh, gr, scene->world_matrices[n], colour))
                 {
-                    for (u32 y = 0; y < m.y; ++y)
-                    {
-                        for (u32 x = 0; x < m.x; ++x)
-                        {
-                            u32 c_offset = c_sp * z + c_rp * y + block_size * x;
-
-                            f32 texel = 0.0f;
-
-                            for (u32 o = 0; o < PEN_ARRAY_SIZE(offsets); ++o)
-                            {
-                                vec3ui vo = vec3ui(x * 2, y * 2, z * 2) + offsets[o];
-
-                                u32 p_offset = p_sp * vo.z + p_rp * vo.y + block_size * vo.x;
-
-                                f32* ft = (f32*)&prev_level[p_offset];
-                                texel += *ft;
-                            }
-
-                            texel /= PEN_ARRAY_SIZE(offsets);
-                            memcpy(&cur_level[c_offset], &texel, sizeof(f32));
-                        }
-                    }
+                    dev_console_log_level(dev_ui::CONSOLE_ERROR,
+                                          "[error] mesh %s does not have cpu vertex / triangle data",
+                                          scene->names[n].c_str());
                 }
-
-                prev_level = cur_level;
-                cur_level += c_sp * m.z;
             }
 
-            tcp.num_mips = num_mips;
-            tcp.data_size = data_size;
-
-            tcp.data = data;
-        }
-
-        void generate_mips_rgba8(pen::texture_creation_params& tcp)
-        {
-            // calc num mips
-            u32              num_mips = 1;
-            u32              data_size = 0;
-            static const u32 block_size = 4;
+            // same grid as the gpu slices, visible extents with a texel border
+            vec3f min = rasteriser_job->visible_extents.min;
+            vec3f max = rasteriser_job->visible_extents.max;
 
-            vec3ui m = vec3ui(tcp.width, tcp.height, tcp.num_arrays);
+            f32 texel_boarder = component_wise_max(max - min) / volume_dim;
 
-            while (m.x > 1 && m.y > 1 && m.z > 1)
-            {
-                data_size += m.x * m.y * m.z * block_size;
-
-                num_mips++;
-
-                m /= vec3ui(2, 2, 2);
-                m = max_union(m, vec3ui::one());
-            }
-
-            data_size += block_size;
-
-            // offsets
-            vec3ui offsets[] = {vec3ui(0, 0, 0),
+            min -= texel_boarder;
+            max += texel_boarder;
 
-                                vec3ui(1, 0, 0), vec3ui(0, 1, 0), vec3ui(1, 1, 0),
+            voxel::voxelise_params vp;
+            vp.mesh = &mesh;
+            vp.origin = min;
+            vp.cell = (max - min) / (f32)volume_dim;
+            vp.nx = volume_dim;
+            vp.ny = volume_dim;
+            vp.nz = volume_dim;
+            vp.colour_mode = voxel::COLOUR_TRIANGLE;
+            vp.cancel = &g_cancel_volume_job;
+            vp.progress = &rasteriser_job->combine_position;
 
-                                vec3ui(0, 0, 1), vec3ui(1, 0, 1), vec3ui(0, 1, 1), vec3ui(1, 1, 1)};
+            if (rasteriser_job->options.capture_data == CAPTURE_NORMALS)
+                vp.colour_mode = voxel::COLOUR_NORMAL;
 
-            u8* data = (u8*)pen::memory_alloc(data_size);
-            memcpy(data, tcp.data, tcp.data_size);
+            u8* volume_data = (u8*)pen::memory_alloc(rasteriser_job->data_size);
 
-            m = vec3ui(tcp.width, tcp.height, tcp.num_arrays);
+            voxel::voxelise_stats vs;
+            bool                  voxelised = voxel::voxelise(vp, volume_data, &vs);
 
-            u8* prev_level = (u8*)data;
-            u8* cur_level = prev_level + tcp.data_size;
+            voxel::free_mesh(mesh);
 
-            for (u32 i = 0; i < num_mips - 1; ++i)
+            if (!voxelised)
             {
-                u32 p_rp = m.x * block_size; // prev row pitch
-                u32 p_sp = p_rp * m.y;       // prev slice pitch
-
-                m /= vec3ui(2, 2, 2);
-                m = max_union(m, vec3ui::one());
-
-                u32 c_rp = m.x * block_size; // cur row pitch
-                u32 c_sp = c_rp * m.y;       // cur slice pitch
-
-                for (u32 z = 0; z < m.z; ++z)
-                {
-                    for (u32 y = 0; y < m.y; ++y)
-                    {
-                        for (u32 x = 0; x < m.x; ++x)
-                        {
-                            u32 c_offset = c_sp * z + c_rp * y + block_size * x;
-
-                            u8 rgba[4] = {0};
+                pen::memory_free(volume_data);
+                rasteriser_job->combine_in_progress = 0;
+                g_cancel_handled = true;
 
-                            for (u32 o = 0; o < PEN_ARRAY_SIZE(offsets); ++o)
-                            {
-                                vec3ui vo = vec3ui(x * 2, y * 2, z * 2) + offsets[o];
+                pen::semaphore_post(p_thread_info->p_sem_continue, 1);
+                pen::semaphore_post(p_thread_info->p_sem_terminated, 1);
+                return PEN_THREAD_OK;
+            }
 
-                                u32 p_offset = p_sp * vo.z + p_rp * vo.y + block_size * vo.x;
+            dev_console_log("[voxelise] %i triangles, %i^3 voxels, %i of %i bricks in %.2f ms "
+                            "(bin %.2f, voxelise %.2f, dilate %.2f)",
+                            vs.num_triangles, volume_dim, vs.num_occupied_bricks, vs.num_bricks, vs.total_ms, vs.bin_ms,
+                            vs.voxelise_ms, vs.dilate_ms);
 
-                                for (u32 r = 0; r < 4; ++r)
-                                    rgba[r] = max<u8>(prev_level[p_offset + r], rgba[r]);
-                            }
+            generated_volume gv =
+                create_volume_from_data(volume_dim, rasteriser_job->block_size, rasteriser_job->data_size,
+                                        PEN_TEX_FORMAT_BGRA8_UNORM, volume_data, rasteriser_job->options.generate_mips);
 
-                            for (u32 r = 0; r < 4; ++r)
-                            {
-                                // rgba[r] /= PEN_ARRAY_SIZE(offsets);
-                                cur_level[c_offset + r] = rgba[r];
-                            }
-                        }
-                    }
-                }
+            pen::memory_free(volume_data); // mem is now owned by gv.tcp
 
-                prev_level = cur_level;
-                cur_level += c_sp * m.z;
-            }
+            sb_push(s_generated_volumes, gv);
 
-            tcp.num_mips = num_mips;
-            tcp.data_size = data_size;
+            rasteriser_job->generated_volume_index = sb_count(s_generated_volumes) - 1;
+            rasteriser_job->combine_in_progress = 2;
 
-            tcp.data = data;
+            pen::semaphore_post(p_thread_info->p_sem_continue, 1);
+            pen::semaphore_post(p_thread_info->p_sem_terminated, 1);
+            return PEN_THREAD_OK;
         }
 
         generated_volume create_volume_from_data(u32 volume_dim, u32 block_size, u32 data_size, u32 tex_format,
-                                                 u8* volume_data, bool generate_mips)
+                                                 u8* volume_data, bool generate_mips, f32 sdf_band)
         {
             generated_volume gv;
 
@@ -885,37 +567,19 @@ namespace put
                 gv.texture = PEN_INVALID_HANDLE;
                 gv.tcp = tcp;
 
+                sparse::encode(gv.bricks, gv.tcp);
+
                 return gv;
             }
 
-            if (generate_mips)
-            {
-                // Mips will create their own copy of mem
-                switch (tex_format)
-                {
-                    case PEN_TEX_FORMAT_BGRA8_UNORM:
-                    {
-#if PEN_SIMD
-                        generate_mips_rgba8_simd(tcp);
+            // mips create their own copy of mem, max keeps the occupancy in the alpha of rasterised volumes
+            mips::mip_params mp;
+            mp.filter = tex_format == PEN_TEX_FORMAT_BGRA8_UNORM ? mips::FILTER_MAX : mips::FILTER_BOX;
 
-#else
-                        generate_mips_rgba8(tcp);
-#endif
-                    }
-                    break;
-                    case PEN_TEX_FORMAT_R32_FLOAT:
-                    {
-#if PEN_SIMD
-                        generate_mips_r32f_simd(tcp);
-#else
-                        generate_mips_r32f(tcp);
-#endif
-                    }
-                    break;
-                    default:
-                        PEN_ASSERT(0); // un-implemented mip map gen fucntion
-                        break;
-                }
+            mips::mip_stats ms;
+            if (generate_mips && mips::generate(tcp, mp, &ms))
+            {
+                dev_console_log("[volume] %i mips in %.2f ms", ms.num_mips, ms.ms);
             }
             else
             {
@@ -929,9 +593,30 @@ namespace put
             gv.texture = PEN_INVALID_HANDLE;
             gv.tcp = tcp;
 
+            // bricks are what is kept and saved, the dense copy goes once it is uploaded
+            sparse::encode_params ep;
+            ep.sdf_band = sdf_band;
+            sparse::encode(gv.bricks, gv.tcp, ep);
+
             return gv;
         }
 
+        void upload_volume(generated_volume& gv)
+        {
+            if (gv.texture != PEN_INVALID_HANDLE)
+                return;
+
+            gv.texture = pen::renderer_create_texture(gv.tcp);
+
+            pen::memory_free(gv.tcp.data);
+            gv.tcp.data = nullptr;
+
+            sparse::volume_stats st = sparse::get_stats(gv.bricks);
+            dev_console_log("[volume] %i bricks, %i empty, %i uniform, %i stored, %.2f mb sparse of %.2f mb dense",
+                            st.num_bricks, st.num_empty, st.num_uniform, st.num_pool,
+                            (f32)st.sparse_size / 1024.0f / 1024.0f, (f32)st.dense_size / 1024.0f / 1024.0f);
+        }
+
         void volume_raster_completed(ecs::ecs_scene* scene)
         {
             if (s_rasteriser_job.combine_in_progress == 0)
@@ -948,8 +633,7 @@ namespace put
 
             generated_volume& gv = s_generated_volumes[s_rasteriser_job.generated_volume_index];
 
-            if (gv.texture == PEN_INVALID_HANDLE)
-                gv.texture = pen::renderer_create_texture(gv.tcp);
+            upload_volume(gv);
 
             // create material for volume ray trace
             material_resource* volume_material = new material_resource;
@@ -988,13 +672,17 @@ namespace put
 
             gv.scene_node_index = new_prim;
 
-            // clean up
+            // clean up, the cpu voxeliser writes straight into the volume and has no slices
             for (u32 a = 0; a < 6; ++a)
             {
+                if (!s_rasteriser_job.volume_slices[a])
+                    continue;
+
                 for (u32 s = 0; s < s_rasteriser_job.dimension; ++s)
                     pen::memory_free(s_rasteriser_job.volume_slices[a][s]);
 
                 pen::memory_free(s_rasteriser_job.volume_slices[a]);
+                s_rasteriser_job.volume_slices[a] = nullptr;
             }
 
             // completed
@@ -1007,7 +695,10 @@ namespace put
             if (g_cancel_volume_job)
             {
                 s_rasteriser_job.rasterise_in_progress = 0;
-                if (s_rasteriser_job.current_requested_slice == s_rasteriser_job.current_slice)
+
+                // the voxelise job flags the cancel as handled itself once it has stopped
+                bool gpu = s_rasteriser_job.options.rasterise_method == RASTERISE_GPU_SLICES;
+                if (gpu && s_rasteriser_job.current_requested_slice == s_rasteriser_job.current_slice)
                     g_cancel_handled = true;
             }
 
@@ -1015,6 +706,14 @@ namespace put
             if (!s_rasteriser_job.rasterise_in_progress)
                 return;
 
+            if (s_rasteriser_job.options.rasterise_method == RASTERISE_CPU_VOXELISE)
+            {
+                if (s_rasteriser_job.combine_in_progress == 2)
+                    volume_raster_completed(scene);
+
+                return;
+            }
+
             if (s_rasteriser_job.current_requested_slice == s_rasteriser_job.current_slice)
                 return;
 
@@ -1115,16 +814,11 @@ namespace put
             u32 data_size = volume_dim * volume_dim * volume_dim * block_size;
 
             u8* volume_data = (u8*)pen::memory_alloc(data_size);
-            u32 row_pitch = volume_dim * block_size;
-            u32 slice_pitch = volume_dim * row_pitch;
 
-            std::vector<vec3f>  vertices;
-            std::vector<vec3ui> triangles;
+            sdf::bake_mesh mesh;
 
             extents ve = {vec3f(FLT_MAX), vec3f(-FLT_MAX)};
 
-            u32 index_offset = 0;
-
             for (u32 n = 0; n < sdf_job->scene->soa_size; ++n)
             {
                 if (sdf_job->scene->entities[n] & CMP_GEOMETRY)
@@ -1145,9 +839,7 @@ namespace put
 
                     geometry_resource* gr = get_geometry_resource(sdf_job->scene->id_geometry[n]);
 
-                    vec4f* vertex_positions = (vec4f*)gr->cpu_position_buffer;
-
-                    if (!gr->cpu_index_buffer || !vertex_positions)
+                    if (!sdf::add_geometry(mesh, gr, sdf_job->scene->world_matrices[n]))
                     {
                         dev_console_log_level(dev_ui::CONSOLE_ERROR,
                                               "[error] mesh %s does not have cpu vertex / triangle data",
@@ -1155,35 +847,6 @@ namespace put
 
                         continue;
                     }
-
-                    index_offset = vertices.size();
-                    for (u32 i = 0; i < gr->num_vertices; ++i)
-                    {
-                        vec3f tv = sdf_job->scene->world_matrices[n].transform_vector(vertex_positions[i].xyz);
-                        vertices.push_back(tv);
-                    }
-
-                    for (u32 i = 0; i < gr->num_indices; i += 3)
-                    {
-                        if (gr->index_type == PEN_FORMAT_R32_UINT)
-                        {
-                            u32* indices = (u32*)gr->cpu_index_buffer;
-                            u32  i0, i1, i2;
-                            i0 = index_offset + indices[i + 0];
-                            i1 = index_offset + indices[i + 1];
-                            i2 = index_offset + indices[i + 2];
-                            triangles.push_back(vec3ui(i0, i1, i2));
-                        }
-                        else
-                        {
-                            u16* indices = (u16*)gr->cpu_index_buffer;
-                            u32  i0, i1, i2;
-                            i0 = index_offset + (u32)indices[i + 0];
-                            i1 = index_offset + (u32)indices[i + 1];
-                            i2 = index_offset + (u32)indices[i + 2];
-                            triangles.push_back(vec3ui(i0, i1, i2));
-                        }
-                    }
                 }
             }
 
@@ -1200,7 +863,7 @@ namespace put
             sdf_job->volume_dim = volume_dim;
             sdf_job->data_size = data_size;
 
-            if (triangles.size() > 0)
+            if (sb_count(mesh.indices) > 0)
             {
                 f32 dx = component_wise_max(scene_dimension) / (f32)volume_dim;
 
@@ -1209,10 +872,26 @@ namespace put
 
                 vec3f grid_origin = centre - vec3f(component_wise_max(scene_dimension) / 2.0f);
 
-                Array3f phi_grid;
-                make_level_set3(triangles, vertices, grid_origin, dx, volume_dim, volume_dim, volume_dim, phi_grid);
+                // distances are baked straight into the r32 texels
+                PEN_ASSERT(block_size == sizeof(f32));
 
-                if (g_cancel_volume_job)
+                sdf::bake_params bp;
+                bp.mesh = &mesh;
+                bp.origin = grid_origin;
+                bp.dx = dx;
+                bp.nx = volume_dim;
+                bp.ny = volume_dim;
+                bp.nz = volume_dim;
+                bp.sign_mode = sdf_job->sign_mode;
+                bp.cancel = &g_cancel_volume_job;
+                bp.progress = &g_mls_progress;
+
+                sdf::bake_stats bs;
+                bool            baked = sdf::bake(bp, (f32*)volume_data, &bs);
+
+                sdf::free_mesh(mesh);
+
+                if (!baked)
                 {
                     s_sdf_job.generate_in_progress = false;
                     g_mls_progress.sweeps = 0;
@@ -1225,36 +904,21 @@ namespace put
                     return PEN_THREAD_OK;
                 }
 
-                for (u32 z = 0; z < volume_dim; ++z)
-                {
-                    for (u32 y = 0; y < volume_dim; ++y)
-                    {
-                        for (u32 x = 0; x < volume_dim; ++x)
-                        {
-                            u32 offset = z * slice_pitch + y * row_pitch + x * block_size;
-
-                            f32* f = (f32*)(&volume_data[offset + 0]);
-
-                            // non water tight meshes signs cannot be trusted
-                            f32 tsf = phi_grid(x, y, z);
-                            if (!sdf_job->trust_sign)
-                                tsf = fabs(tsf);
-
-                            *f = tsf;
-                        }
-                    }
-                }
+                dev_console_log("[sdf] %i triangles, %i^3 voxels in %.2f ms (bvh %.2f, distance %.2f, sign %.2f)",
+                                bs.num_triangles, volume_dim, bs.total_ms, bs.build_ms, bs.distance_ms, bs.sign_ms);
             }
             else
             {
+                sdf::free_mesh(mesh);
                 dev_console_log_level(dev_ui::CONSOLE_ERROR, "%s", "[error] no triangles in scene to generate sdf");
             }
 
-            // create texture
+            // create texture, the sparse band is in texels of the top level
+            f32 sdf_band = s_sdf_job.sparse_band * component_wise_max(scene_dimension) / (f32)volume_dim;
 
-            generated_volume gv =
-                create_volume_from_data(s_sdf_job.volume_dim, s_sdf_job.block_size, s_sdf_job.data_size,
-                                        s_sdf_job.texture_format, s_sdf_job.volume_data, s_sdf_job.options.generate_mips);
+            generated_volume gv = create_volume_from_data(s_sdf_job.volume_dim, s_sdf_job.block_size, s_sdf_job.data_size,
+                                                          s_sdf_job.texture_format, s_sdf_job.volume_data,
+                                                          s_sdf_job.options.generate_mips, sdf_band);
 
             pen::memory_free(s_sdf_job.volume_data); // mem is now owned by gv.tcp
 
@@ -1276,22 +940,36 @@ namespace put
 
         void rasterise_ui()
         {
-            static const c8* axis_names[] = {"z+", "y+", "x+", "z-", "y-", "x-"};
+            static const c8* method_names[] = {"CPU Voxelise", "GPU Slices"};
 
-            ImGui::Text("Rasterise Axes");
+            ImGui::Combo("Method", &s_options.rasterise_method, method_names, PEN_ARRAY_SIZE(method_names));
 
-            for (u32 a = 0; a < k_num_axes; a++)
+            if (s_options.rasterise_method == RASTERISE_GPU_SLICES)
             {
-                ImGui::CheckboxFlags(axis_names[a], &s_options.rasterise_axes, 1 << a);
+                static const c8* axis_names[] = {"z+", "y+", "x+", "z-", "y-", "x-"};
+
+                ImGui::Text("Rasterise Axes");
 
-                if (a < k_num_axes - 1)
-                    ImGui::SameLine();
+                for (u32 a = 0; a < k_num_axes; a++)
+                {
+                    ImGui::CheckboxFlags(axis_names[a], &s_options.rasterise_axes, 1 << a);
+
+                    if (a < k_num_axes - 1)
+                        ImGui::SameLine();
+                }
             }
 
             static const c8* capture_data_names[] = {"Albedo", "Normals", "Baked Lighting", "Occupancy", "Custom"};
 
             ImGui::Combo("Capture", &s_options.capture_data, capture_data_names, PEN_ARRAY_SIZE(capture_data_names));
 
+            // lighting and custom shaders only exist on the gpu, albedo on the cpu is the material colour
+            bool cpu_capture =
+                s_options.capture_data != CAPTURE_BAKED_LIGHTING && s_options.capture_data != CAPTURE_CUSTOM;
+
+            if (s_options.rasterise_method == RASTERISE_CPU_VOXELISE && !cpu_capture)
+                ImGui::Text("%s", "Capture requires GPU Slices, the GPU will be used");
+
             static u32* hidden_entities = nullptr;
 
             if (!s_rasteriser_job.rasterise_in_progress)
@@ -1300,6 +978,8 @@ namespace put
                 {
                     g_cancel_volume_job = 0;
 
+                    bool gpu = s_options.rasterise_method == RASTERISE_GPU_SLICES || !cpu_capture;
+
                     if (s_rasteriser_job.capture_type == CAPTURE_SELECTED)
                     {
                         // hide stuff we dont want
@@ -1313,6 +993,10 @@ namespace put
                             if (!(s_main_scene->state_flags[n] & SF_SELECTED) &&
                                 !(s_main_scene->state_flags[n] & SF_CHILD_SELECTED))
                             {
+                                // the voxeliser filters the selection itself
+                                if (!gpu)
+                                    continue;
+
                                 s_main_scene->state_flags[n] |= SF_HIDDEN;
                                 sb_push(hidden_entities, n);
                             }
@@ -1337,6 +1021,20 @@ namespace put
                     s_rasteriser_job.dimension = dim;
                     s_rasteriser_job.current_axis = 0;
                     s_rasteriser_job.current_slice = 0;
+                    s_rasteriser_job.scene = s_main_scene;
+
+                    if (!gpu)
+                    {
+                        // voxelise directly into the volume, completion is picked up in volume_rasteriser_update
+                        s_rasteriser_job.rasterise_in_progress = true;
+                        s_rasteriser_job.combine_in_progress = 1;
+
+                        pen::jobs_create_job(raster_voxelise, 1024 * 1024 * 1024, &s_rasteriser_job,
+                                             pen::THREAD_START_DETACHED);
+                        return;
+                    }
+
+                    s_rasteriser_job.options.rasterise_method = RASTERISE_GPU_SLICES;
 
                     // allocate cpu mem for rasterised slices
                     for (u32 a = 0; a < 6; ++a)
@@ -1418,8 +1116,12 @@ namespace put
 
             static s32 sdf_texture_format = 1;
             ImGui::Combo("Capture", &sdf_texture_format, texture_fromat, PEN_ARRAY_SIZE(texture_fromat));
-            ImGui::Checkbox("Signed (use unsigned for non water-tight meshes)", &s_sdf_job.trust_sign);
+            static const c8* sign_modes[] = {"Unsigned (not water-tight)", "Ray Parity (x)", "Ray Parity Vote (xyz)"};
+            ImGui::Combo("Sign", &s_sdf_job.sign_mode, sign_modes, PEN_ARRAY_SIZE(sign_modes));
             ImGui::InputFloat("Padding", &s_sdf_job.padding);
+            ImGui::InputFloat("Sparse Band (texels)", &s_sdf_job.sparse_band);
+            dev_ui::set_tooltip("Bricks further than this from the surface keep only their nearest distance\n"
+                                "0 keeps every distance, 32bit only");
 
             if (!s_sdf_job.generate_in_progress)
             {
@@ -1462,8 +1164,7 @@ namespace put
                 {
                     generated_volume& gv = s_generated_volumes[s_sdf_job.generated_volume_index];
 
-                    if (gv.texture == PEN_INVALID_HANDLE)
-                        gv.texture = pen::renderer_create_texture(gv.tcp);
+                    upload_volume(gv);
 
                     geometry_resource* cube = get_geometry_resource(PEN_HASH("cube"));
 
@@ -1646,10 +1347,12 @@ namespace put
                                 {
                                     Str basename = pen::str_remove_ext(save_location);
 
-                                    Str dds_file = basename;
-                                    dds_file.appendf(".dds");
+                                    Str bricks_file = basename;
+                                    bricks_file.appendf(".pmvb");
 
-                                    save_texture(dds_file.c_str(), s_generated_volumes[i].tcp);
+                                    if (!sparse::save(bricks_file.c_str(), s_generated_volumes[i].bricks))
+                                        dev_console_log_level(dev_ui::CONSOLE_ERROR, "[error] failed to write %s",
+                                                              bricks_file.c_str());
 
                                     Str json_file = basename;
                                     json_file.appendf(".pmv");
@@ -1658,7 +1361,7 @@ namespace put
                                     const c8* vol_name = sdf ? "signed_distance_field" : "volume_texture";
 
                                     pen::json j;
-                                    j.set_filename("filename", dds_file.c_str());
+                                    j.set_filename("bricks", bricks_file.c_str());
                                     j.set("volume_type", vol_name);
                                     j.set("scale_x", s_generated_volumes[i].scale.x);
                                     j.set("scale_y", s_generated_volumes[i].scale.y);
@@ -0,0 +1,450 @@
+// voxeliser.cpp
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "voxeliser.h"
+#include "ecs/ecs_resources.h"
+
+#include "data_struct.h"
+#include "memory.h"
+#include "threads.h"
+#include "timer.h"
+
+#include <algorithm>
+
+namespace put
+{
+    namespace voxel
+    {
+        namespace
+        {
+            // triangle in grid space where voxels are unit boxes, with the Schwarz-Seidel overlap terms precomputed
+            struct tri_setup
+            {
+                f32 n[3];      // plane normal
+                f32 d1, d2;    // plane distances of the critical and opposite corners
+                f32 xy[3][3];  // edge normals and distances projected onto xy, yz and zx
+                f32 yz[3][3];
+                f32 zx[3][3];
+                s32 lo[3];     // clamped voxel bounds, lo[0] > hi[0] for culled or collapsed triangles
+                s32 hi[3];
+                u8  bgra[4];
+            };
+
+            struct voxelise_context
+            {
+                const voxelise_params* params;
+                tri_setup*             tris;
+                u32*                   bin_start; // num_slabs + 1
+                u32*                   bin_tris;
+                u8*                    bgra;
+                u8*                    bricks; // 1 where a brick has any occupied voxel
+                u32                    num_bricks[3];
+            };
+
+            struct batch
+            {
+                pen::job_range_callback cb;
+                void*                   user_data;
+                u32                     offset;
+            };
+
+            inline u8 unorm8(f32 f)
+            {
+                return (u8)(std::min(std::max(f, 0.0f), 1.0f) * 255.0f + 0.5f);
+            }
+
+            // edge normals and distances for one 2d projection, a and b pick the components of the plane
+            void setup_edges(f32 out[3][3], const vec3f* g, const vec3f* e, u32 a, u32 b, f32 sign)
+            {
+                for (u32 i = 0; i < 3; ++i)
+                {
+                    f32 na = -e[i][b] * sign;
+                    f32 nb = e[i][a] * sign;
+
+                    out[i][0] = na;
+                    out[i][1] = nb;
+                    out[i][2] = -(na * g[i][a] + nb * g[i][b]) + std::max(0.0f, na) + std::max(0.0f, nb);
+                }
+            }
+
+            inline bool edges_overlap(const f32 ed[3][3], f32 pa, f32 pb)
+            {
+                for (u32 i = 0; i < 3; ++i)
+                    if (ed[i][0] * pa + ed[i][1] * pb + ed[i][2] < 0.0f)
+                        return false;
+
+                return true;
+            }
+
+            void setup_range(u32 start, u32 end, void* user_data)
+            {
+                voxelise_context&      ctx = *(voxelise_context*)user_data;
+                const voxelise_params& params = *ctx.params;
+                const voxel_mesh&      mesh = *params.mesh;
+
+                const s32 n[3] = {(s32)params.nx, (s32)params.ny, (s32)params.nz};
+
+                for (u32 t = start; t < end; ++t)
+                {
+                    tri_setup& ts = ctx.tris[t];
+
+                    vec3f w[3];
+                    vec3f g[3];
+                    for (u32 i = 0; i < 3; ++i)
+                    {
+                        w[i] = mesh.vertices[mesh.indices[t * 3 + i]];
+                        g[i] = (w[i] - params.origin) / params.cell;
+                    }
+
+                    vec3f e[3] = {g[1] - g[0], g[2] - g[1], g[0] - g[2]};
+                    vec3f nn = cross(e[0], e[1]);
+
+                    for (u32 c = 0; c < 3; ++c)
+                    {
+                        f32 mn = std::min(std::min(g[0][c], g[1][c]), g[2][c]);
+                        f32 mx = std::max(std::max(g[0][c], g[1][c]), g[2][c]);
+
+                        ts.lo[c] = std::max((s32)std::floor(mn), 0);
+                        ts.hi[c] = std::min((s32)std::floor(mx), n[c] - 1);
+                    }
+
+                    // collapsed triangles would pass every edge test and fill their whole bounds
+                    if (nn.x == 0.0f && nn.y == 0.0f && nn.z == 0.0f)
+                        ts.lo[0] = ts.hi[0] + 1;
+
+                    vec3f crit = vec3f(nn.x > 0.0f ? 1.0f : 0.0f, nn.y > 0.0f ? 1.0f : 0.0f, nn.z > 0.0f ? 1.0f : 0.0f);
+
+                    for (u32 c = 0; c < 3; ++c)
+                        ts.n[c] = nn[c];
+
+                    ts.d1 = dot(nn, crit - g[0]);
+                    ts.d2 = dot(nn, (vec3f::one() - crit) - g[0]);
+
+                    setup_edges(ts.xy, g, e, 0, 1, nn.z >= 0.0f ? 1.0f : -1.0f);
+                    setup_edges(ts.yz, g, e, 1, 2, nn.x >= 0.0f ? 1.0f : -1.0f);
+                    setup_edges(ts.zx, g, e, 2, 0, nn.y >= 0.0f ? 1.0f : -1.0f);
+
+                    vec4f rgba;
+                    if (params.colour_mode == COLOUR_NORMAL)
+                    {
+                        vec3f wn = cross(w[1] - w[0], w[2] - w[0]);
+                        f32   len = mag(wn);
+                        if (len > 0.0f)
+                            wn /= len;
+
+                        rgba = vec4f(wn * 0.5f + 0.5f, 1.0f);
+                    }
+                    else
+                    {
+                        u32 c = mesh.colours[t];
+                        rgba = vec4f((c >> 16) & 0xff, (c >> 8) & 0xff, c & 0xff, (c >> 24) & 0xff) / 255.0f;
+                    }
+
+                    // alpha 0 marks empty voxels, keep anything a triangle touched occupied
+                    ts.bgra[0] = unorm8(rgba.z);
+                    ts.bgra[1] = unorm8(rgba.y);
+                    ts.bgra[2] = unorm8(rgba.x);
+                    ts.bgra[3] = std::max<u8>(unorm8(rgba.w), 1);
+                }
+            }
+
+            void voxelise_slabs(u32 start, u32 end, void* user_data)
+            {
+                voxelise_context&      ctx = *(voxelise_context*)user_data;
+                const voxelise_params& params = *ctx.params;
+
+                u32 row_pitch = params.nx * 4;
+                u32 slice_pitch = params.ny * row_pitch;
+
+                for (u32 s = start; s < end; ++s)
+                {
+                    s32 z0 = s * k_brick_size;
+                    s32 z1 = std::min<s32>(z0 + k_brick_size, params.nz) - 1;
+
+                    u8* slab = ctx.bgra + z0 * slice_pitch;
+                    memset(slab, 0, (z1 - z0 + 1) * slice_pitch);
+
+                    u8* bricks = ctx.bricks + s * ctx.num_bricks[0] * ctx.num_bricks[1];
+
+                    // triangles are in mesh order so where they share a voxel the later one wins, as with the
+                    // slices of the gpu path the result does not depend on how the slabs were scheduled
+                    for (u32 b = ctx.bin_start[s]; b < ctx.bin_start[s + 1]; ++b)
+                    {
+                        const tri_setup& ts = ctx.tris[ctx.bin_tris[b]];
+
+                        s32 tz0 = std::max(ts.lo[2], z0);
+                        s32 tz1 = std::min(ts.hi[2], z1);
+
+                        for (s32 z = tz0; z <= tz1; ++z)
+                        {
+                            for (s32 y = ts.lo[1]; y <= ts.hi[1]; ++y)
+                            {
+                                // the yz projection is the same for the whole row
+                                if (!edges_overlap(ts.yz, (f32)y, (f32)z))
+                                    continue;
+
+                                f32 nyz = ts.n[1] * y + ts.n[2] * z;
+                                u8* row = slab + (z - z0) * slice_pitch + y * row_pitch;
+
+                                for (s32 x = ts.lo[0]; x <= ts.hi[0]; ++x)
+                                {
+                                    f32 np = ts.n[0] * x + nyz;
+                                    if ((np + ts.d1) * (np + ts.d2) > 0.0f)
+                                        continue;
+
+                                    if (!edges_overlap(ts.xy, (f32)x, (f32)y) || !edges_overlap(ts.zx, (f32)z, (f32)x))
+                                        continue;
+
+                                    memcpy(row + x * 4, ts.bgra, 4);
+                                    bricks[(y / k_brick_size) * ctx.num_bricks[0] + x / k_brick_size] = 1;
+                                }
+                            }
+                        }
+                    }
+
+                    if (params.progress)
+                        *params.progress += (z1 - z0 + 1) * params.nx * params.ny;
+                }
+            }
+
+            bool brick_near_surface(const voxelise_context& ctx, s32 bx, s32 by, s32 bz)
+            {
+                for (s32 z = std::max(bz - 1, 0); z <= std::min<s32>(bz + 1, ctx.num_bricks[2] - 1); ++z)
+                    for (s32 y = std::max(by - 1, 0); y <= std::min<s32>(by + 1, ctx.num_bricks[1] - 1); ++y)
+                        for (s32 x = std::max(bx - 1, 0); x <= std::min<s32>(bx + 1, ctx.num_bricks[0] - 1); ++x)
+                            if (ctx.bricks[(z * ctx.num_bricks[1] + y) * ctx.num_bricks[0] + x])
+                                return true;
+
+                return false;
+            }
+
+            // empty voxels take rgb from an occupied neighbour so bilinear filtering does not bleed in black.
+            // only rgb of empty voxels is written and only alpha and rgb of occupied voxels is read, so slabs can
+            // dilate in place side by side
+            void dilate_slabs(u32 start, u32 end, void* user_data)
+            {
+                voxelise_context&      ctx = *(voxelise_context*)user_data;
+                const voxelise_params& params = *ctx.params;
+
+                static const s32 nb[][3] = {
+                    {-1, -1, 0}, {-1, -1, 1}, {-1, -1, -1}, {0, -1, 0}, {0, -1, 1}, {0, -1, -1}, {1, -1, 0},
+                    {1, -1, 1},  {1, -1, -1}, {1, 0, 0},    {1, 0, 1},  {1, 0, -1}, {1, 1, 0},   {1, 1, 1},
+                    {1, 1, -1},  {0, 1, 0},   {0, 1, 1},    {0, 1, -1}, {-1, 1, 0}, {-1, 1, 1},  {-1, 1, -1},
+                    {-1, 0, 0},  {-1, 0, 1},  {-1, 0, -1},  {0, 0, 1},  {0, 0, -1},
+                };
+
+                const s32 n[3] = {(s32)params.nx, (s32)params.ny, (s32)params.nz};
+                u32       row_pitch = params.nx * 4;
+                u32       slice_pitch = params.ny * row_pitch;
+
+                for (u32 bz = start; bz < end; ++bz)
+                {
+                    for (u32 by = 0; by < ctx.num_bricks[1]; ++by)
+                    {
+                        for (u32 bx = 0; bx < ctx.num_bricks[0]; ++bx)
+                        {
+                            if (!brick_near_surface(ctx, bx, by, bz))
+                                continue;
+
+                            s32 lo[3] = {(s32)(bx * k_brick_size), (s32)(by * k_brick_size), (s32)(bz * k_brick_size)};
+                            s32 hi[3];
+                            for (u32 c = 0; c < 3; ++c)
+                                hi[c] = std::min<s32>(lo[c] + k_brick_size, n[c]);
+
+                            for (s32 z = lo[2]; z < hi[2]; ++z)
+                            {
+                                for (s32 y = lo[1]; y < hi[1]; ++y)
+                                {
+                                    for (s32 x = lo[0]; x < hi[0]; ++x)
+                                    {
+                                        u8* texel = ctx.bgra + z * slice_pitch + y * row_pitch + x * 4;
+                                        if (texel[3] != 0)
+                                            continue;
+
+                                        // last occupied neighbour in the list wins
+                                        for (s32 i = PEN_ARRAY_SIZE(nb) - 1; i >= 0; --i)
+                                        {
+                                            s32 nx = std::min(std::max(x + nb[i][0], 0), n[0] - 1);
+                                            s32 ny = std::min(std::max(y + nb[i][1], 0), n[1] - 1);
+                                            s32 nz = std::min(std::max(z + nb[i][2], 0), n[2] - 1);
+
+                                            const u8* nt = ctx.bgra + nz * slice_pitch + ny * row_pitch + nx * 4;
+                                            if (nt[3] > 0)
+                                            {
+                                                memcpy(texel, nt, 3);
+                                                break;
+                                            }
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            void batch_range(u32 start, u32 end, void* user_data)
+            {
+                batch* b = (batch*)user_data;
+                b->cb(b->offset + start, b->offset + end, b->user_data);
+            }
+
+            // runs cb over count slabs a few per worker at a time, checking cancel between batches
+            bool dispatch_slabs(voxelise_context& ctx, u32 count, pen::job_range_callback cb)
+            {
+                batch b;
+                b.cb = cb;
+                b.user_data = &ctx;
+
+                for (u32 s = 0; s < count;)
+                {
+                    if (ctx.params->cancel && *ctx.params->cancel)
+                        return false;
+
+                    u32 batch_size = (std::max<u32>(pen::jobs_get_num_workers(), 1) + 1) * 2;
+                    u32 n = std::min(batch_size, count - s);
+
+                    b.offset = s;
+                    pen::jobs_parallel_for(n, 1, batch_range, &b);
+                    s += n;
+                }
+
+                return !(ctx.params->cancel && *ctx.params->cancel);
+            }
+        } // namespace
+
+        bool add_geometry(voxel_mesh& mesh, const ecs::geometry_resource* gr, const mat4& world, const vec4f& rgba)
+        {
+            const vec4f* positions = (const vec4f*)gr->cpu_position_buffer;
+            if (!positions || !gr->cpu_index_buffer)
+                return false;
+
+            u32 base = sb_count(mesh.vertices);
+            for (u32 i = 0; i < gr->num_vertices; ++i)
+                sb_push(mesh.vertices, world.transform_vector(positions[i].xyz));
+
+            for (u32 i = 0; i < gr->num_indices; ++i)
+            {
+                u32 index;
+                if (gr->index_type == PEN_FORMAT_R32_UINT)
+                    index = ((const u32*)gr->cpu_index_buffer)[i];
+                else
+                    index = ((const u16*)gr->cpu_index_buffer)[i];
+
+                sb_push(mesh.indices, base + index);
+            }
+
+            u32 colour = (u32)unorm8(rgba.w) << 24 | (u32)unorm8(rgba.x) << 16;
+            colour |= (u32)unorm8(rgba.y) << 8 | unorm8(rgba.z);
+            for (u32 i = 0; i < gr->num_indices / 3; ++i)
+                sb_push(mesh.colours, colour);
+
+            return true;
+        }
+
+        void free_mesh(voxel_mesh& mesh)
+        {
+            sb_free(mesh.vertices);
+            sb_free(mesh.indices);
+            sb_free(mesh.colours);
+            mesh.vertices = nullptr;
+            mesh.indices = nullptr;
+            mesh.colours = nullptr;
+        }
+
+        bool voxelise(const voxelise_params& params, u8* bgra, voxelise_stats* stats)
+        {
+            f32 start = pen::get_time_ms();
+
+            voxelise_stats st;
+            st.num_triangles = sb_count(params.mesh->indices) / 3;
+            st.num_voxels = params.nx * params.ny * params.nz;
+
+            voxelise_context ctx;
+            ctx.params = &params;
+            ctx.bgra = bgra;
+            ctx.num_bricks[0] = (params.nx + k_brick_size - 1) / k_brick_size;
+            ctx.num_bricks[1] = (params.ny + k_brick_size - 1) / k_brick_size;
+            ctx.num_bricks[2] = (params.nz + k_brick_size - 1) / k_brick_size;
+
+            u32 num_slabs = ctx.num_bricks[2];
+            st.num_bricks = ctx.num_bricks[0] * ctx.num_bricks[1] * ctx.num_bricks[2];
+
+            ctx.bricks = (u8*)pen::memory_alloc(st.num_bricks);
+            memset(ctx.bricks, 0, st.num_bricks);
+
+            // per triangle setup on the pool, then bin into the slabs each triangle's bounds cover
+            ctx.tris = (tri_setup*)pen::memory_alloc(sizeof(tri_setup) * std::max<u32>(st.num_triangles, 1));
+            pen::jobs_parallel_for(st.num_triangles, 1024, setup_range, &ctx);
+
+            ctx.bin_start = (u32*)pen::memory_alloc(sizeof(u32) * (num_slabs + 1));
+            memset(ctx.bin_start, 0, sizeof(u32) * (num_slabs + 1));
+            ctx.bin_tris = nullptr;
+
+            for (u32 pass = 0; pass < 2; ++pass)
+            {
+                if (pass == 1)
+                {
+                    u32 total = 0;
+                    for (u32 s = 0; s <= num_slabs; ++s)
+                    {
+                        u32 c = ctx.bin_start[s];
+                        ctx.bin_start[s] = total;
+                        total += c;
+                    }
+                    ctx.bin_tris = (u32*)pen::memory_alloc(sizeof(u32) * std::max<u32>(total, 1));
+                }
+
+                for (u32 t = 0; t < st.num_triangles; ++t)
+                {
+                    const tri_setup& ts = ctx.tris[t];
+                    if (ts.lo[0] > ts.hi[0] || ts.lo[1] > ts.hi[1] || ts.lo[2] > ts.hi[2])
+                        continue;
+
+                    for (s32 s = ts.lo[2] / k_brick_size; s <= ts.hi[2] / (s32)k_brick_size; ++s)
+                    {
+                        if (pass == 0)
+                            ctx.bin_start[s]++;
+                        else
+                            ctx.bin_tris[ctx.bin_start[s]++] = t;
+                    }
+                }
+            }
+
+            // fill advanced each start to the next bin's
+            for (u32 s = num_slabs; s > 0; --s)
+                ctx.bin_start[s] = ctx.bin_start[s - 1];
+            ctx.bin_start[0] = 0;
+
+            st.bin_ms = pen::get_time_ms() - start;
+
+            f32  voxelise_start = pen::get_time_ms();
+            bool complete = dispatch_slabs(ctx, num_slabs, voxelise_slabs);
+            st.voxelise_ms = pen::get_time_ms() - voxelise_start;
+
+            pen::memory_free(ctx.tris);
+            pen::memory_free(ctx.bin_start);
+            pen::memory_free(ctx.bin_tris);
+
+            for (u32 b = 0; b < st.num_bricks; ++b)
+                st.num_occupied_bricks += ctx.bricks[b];
+
+            if (complete && params.dilate)
+            {
+                f32 dilate_start = pen::get_time_ms();
+                complete = dispatch_slabs(ctx, num_slabs, dilate_slabs);
+                st.dilate_ms = pen::get_time_ms() - dilate_start;
+            }
+
+            pen::memory_free(ctx.bricks);
+
+            st.total_ms = pen::get_time_ms() - start;
+
+            if (stats)
+                *stats = st;
+
+            return complete;
+        }
+    } // namespace voxel
+} // namespace put
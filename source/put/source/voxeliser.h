@@ -0,0 +1,79 @@
+// voxeliser.h
+// Copyright 2014 - 2019 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#pragma once
+
+#include "maths/mat.h"
+#include "maths/vec.h"
+#include "pen.h"
+
+#include <atomic>
+
+// Cpu surface voxelisation of triangle meshes into a bgra8 volume, no render targets or gpu read back required.
+// Triangles are binned into slabs of k_brick_size z slices and the slabs are voxelised on the worker pool, each
+// voxel a triangle touches is found with the Schwarz-Seidel triangle / box overlap test so the surface is conservative
+// and has no holes along any axis. Occupancy is tracked in bricks of k_brick_size^3 voxels so clearing and dilation
+// only visit the bricks around the surface.
+// The volume is laid out x fastest, voxel (i, j, k) is the box origin + (i, j, k) * cell to origin + (i + 1, j + 1,
+// k + 1) * cell, matching the texels of the rasterised volume generator path.
+
+namespace put
+{
+    namespace ecs
+    {
+        struct geometry_resource;
+    }
+
+    namespace voxel
+    {
+        static const u32 k_brick_size = 8;
+
+        enum e_colour_mode
+        {
+            COLOUR_TRIANGLE, // per triangle colour from add_geometry
+            COLOUR_NORMAL    // world space face normal * 0.5 + 0.5
+        };
+
+        struct voxel_mesh
+        {
+            vec3f* vertices = nullptr; // stretchy buffers
+            u32*   indices = nullptr;
+            u32*   colours = nullptr; // bgra8, one per triangle
+        };
+
+        struct voxelise_params
+        {
+            const voxel_mesh*  mesh = nullptr;
+            vec3f              origin = vec3f::zero();
+            vec3f              cell = vec3f::one();
+            u32                nx = 0;
+            u32                ny = 0;
+            u32                nz = 0;
+            u32                colour_mode = COLOUR_TRIANGLE;
+            bool               dilate = true; // copy colour into empty neighbours so bilinear filtering has no halo
+            std::atomic<bool>* cancel = nullptr;
+            a_u32*             progress = nullptr; // incremented by voxels as slabs complete, nx * ny * nz when done
+        };
+
+        struct voxelise_stats
+        {
+            u32 num_triangles = 0;
+            u32 num_voxels = 0;
+            u32 num_bricks = 0;
+            u32 num_occupied_bricks = 0;
+            f32 bin_ms = 0.0f;
+            f32 voxelise_ms = 0.0f;
+            f32 dilate_ms = 0.0f;
+            f32 total_ms = 0.0f;
+        };
+
+        // appends lod 0 of gr transformed by world with every triangle coloured rgba (0-1),
+        // returns false if gr has no cpu positions or indices
+        bool add_geometry(voxel_mesh& mesh, const ecs::geometry_resource* gr, const mat4& world, const vec4f& rgba);
+        void free_mesh(voxel_mesh& mesh);
+
+        // fills bgra with nx * ny * nz texels, alpha 0 is empty, returns false if cancelled
+        bool voxelise(const voxelise_params& params, u8* bgra, voxelise_stats* stats = nullptr);
+    } // namespace voxel
+} // namespace put
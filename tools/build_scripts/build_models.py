@@ -222,6 +222,9 @@ if "-i" in sys.argv and "-o" in sys.argv:
             # create models dir
             if not os.path.exists(helpers.build_dir):
                 os.makedirs(helpers.build_dir)
+    # lod generation is slow, only meshes with lods: true in their export.jsn pass -lods
+    if "-lods" in sys.argv:
+        helpers.generate_lods = True
 
 # build list of files
 for file in file_list:
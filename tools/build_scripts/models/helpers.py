@@ -6,10 +6,12 @@ import os
 import util as util
 
 version_number = 1
+geometry_version_number = 2
 anim_version_number = 1
 current_filename = ""
 author = ""
 log_level = "verbose"
+generate_lods = False
 
 platform = util.get_platform_name()
 build_dir = os.path.join(os.getcwd(), "bin", platform, "data", "models")
@@ -1,4 +1,5 @@
 import models.helpers as helpers
+import models.simplify_mesh as simplify_mesh
 import struct
 
 schema = "{http://www.collada.org/2005/11/COLLADASchema}"
@@ -439,7 +440,7 @@ def write_geometry_file(geom_instance):
     if num_meshes == 0:
         return
 
-    geometry_data = [struct.pack("i", (int(helpers.version_number))),
+    geometry_data = [struct.pack("i", (int(helpers.geometry_version_number))),
                      struct.pack("i", (int(num_meshes)))]
 
     for mat in geom_instance.materials:
@@ -493,13 +494,20 @@ def write_geometry_file(geom_instance):
         for index in mesh.index_buffer:
             mesh_data.append(struct.pack(index_type, (int(index))))
 
-        data_size += len(mesh.index_buffer) * 2
+        data_size += len(mesh.index_buffer) * struct.calcsize(index_type)
 
         for vertexfloat in mesh.collision_vertices:
             mesh_data.append(struct.pack("f", (float(vertexfloat))))
 
         data_size += len(mesh.collision_vertices) * 4
 
+        # simplified index buffers into the same vertices, an empty chain when lods are not enabled
+        lods = []
+        if helpers.generate_lods:
+            lods = simplify_mesh.generate_lods(mesh.vertex_elements[0].float_values, mesh.vertex_buffer,
+                                               mesh.index_buffer, mesh.min_extents, mesh.max_extents)
+        data_size += simplify_mesh.pack_lods(mesh_data, lods, index_type)
+
         for m in mesh_data:
             geometry_data.append(m)
 
@@ -1,4 +1,5 @@
 import models.helpers as helpers
+import models.simplify_mesh as simplify_mesh
 import os
 import struct
 import sys
@@ -248,7 +249,7 @@ def write_geometry(file, root):
     if cur_mesh:
         meshes.append(cur_mesh)
 
-    geometry_data = [struct.pack("i", (int(helpers.version_number))),
+    geometry_data = [struct.pack("i", (int(helpers.geometry_version_number))),
                      struct.pack("i", (int(len(meshes))))]
 
     for m in meshes:
@@ -294,13 +295,19 @@ def write_geometry(file, root):
         for index in mesh[ib]:
             mesh_data.append(struct.pack(index_type, (int(index))))
 
-        data_size += len(mesh[ib]) * 2
+        data_size += len(mesh[ib]) * struct.calcsize(index_type)
 
         for vf in mesh[cb]:
             mesh_data.append(struct.pack("f", (float(vf))))
 
         data_size += len(mesh[cb]) * 4
 
+        # simplified index buffers into the same vertices, an empty chain when lods are not enabled
+        lods = []
+        if helpers.generate_lods:
+            lods = simplify_mesh.generate_lods(mesh[pb], generated_vb, mesh[ib], min_extents, max_extents)
+        data_size += simplify_mesh.pack_lods(mesh_data, lods, index_type)
+
         for m in mesh_data:
             geometry_data.append(m)
 
@@ -0,0 +1,291 @@
+import struct
+import heapq
+import math
+
+# quadric error edge collapse lod generation, mirrors ecs_lod.cpp so files built offline match lods made at load
+# vertices are welded by position and collapses only move a vertex onto a neighbour, so each level is a list of
+# indices into the original vertex buffer
+
+max_lods = 5
+reduction = 0.5
+min_triangles = 64
+max_error = 0.25
+boundary_weight = 10.0
+flip_threshold = 0.2
+
+
+def sub(a, b):
+    return [a[0] - b[0], a[1] - b[1], a[2] - b[2]]
+
+
+def cross(a, b):
+    return [a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]]
+
+
+def dot(a, b):
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+
+
+def mag(a):
+    return math.sqrt(dot(a, a))
+
+
+def add_plane(q, n, d, weight):
+    p = [n[0], n[1], n[2], d]
+    i = 0
+    for r in range(0, 4):
+        for c in range(r, 4):
+            q[i] += p[r] * p[c] * weight
+            i += 1
+    q[10] += weight
+
+
+def eval_error(qa, qb, p):
+    a = [qa[i] + qb[i] for i in range(0, 11)]
+    x, y, z = p[0], p[1], p[2]
+    e = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x + a[4] * y * y + \
+        2.0 * a[5] * y * z + 2.0 * a[6] * y + a[7] * z * z + 2.0 * a[8] * z + a[9]
+    if a[10] <= 0.0:
+        return 0.0
+    return max(e, 0.0) / a[10]
+
+
+class simplifier:
+    def __init__(self, positions, normals, indices):
+        self.normals = normals
+
+        # weld by position
+        self.pos = []
+        self.members = []
+        weld = []
+        lookup = dict()
+        for v in range(0, len(positions)):
+            key = tuple(positions[v][0:3])
+            if key not in lookup:
+                lookup[key] = len(self.pos)
+                self.pos.append(list(key))
+                self.members.append([])
+            w = lookup[key]
+            weld.append(w)
+            self.members[w].append(v)
+
+        num_welded = len(self.pos)
+        self.quadrics = [[0.0] * 11 for i in range(0, num_welded)]
+        self.stamp = [0] * num_welded
+        self.alive = [True] * num_welded
+        self.vertex_tris = [[] for i in range(0, num_welded)]
+
+        num_tris = int(len(indices) / 3)
+        self.tris = [weld[i] for i in indices]
+        self.corners = list(indices)
+        self.tri_alive = [False] * num_tris
+        self.live_tris = 0
+        self.queue = []
+        self.max_cost = 0.0
+
+        # area weighted face planes
+        for t in range(0, num_tris):
+            tri = self.tris[t * 3:t * 3 + 3]
+            if tri[0] == tri[1] or tri[1] == tri[2] or tri[0] == tri[2]:
+                continue
+            n = self.tri_normal(tri)
+            area2 = mag(n)
+            if area2 <= 0.0:
+                continue
+            n = [n[0] / area2, n[1] / area2, n[2] / area2]
+            d = -dot(n, self.pos[tri[0]])
+            for k in range(0, 3):
+                add_plane(self.quadrics[tri[k]], n, d, area2 * 0.5)
+                self.vertex_tris[tri[k]].append(t)
+            self.tri_alive[t] = True
+            self.live_tris += 1
+
+        self.add_boundary_planes()
+
+        for v in range(0, num_welded):
+            self.push_vertex_collapses(v)
+
+    def tri_normal(self, tri):
+        p0 = self.pos[tri[0]]
+        return cross(sub(self.pos[tri[1]], p0), sub(self.pos[tri[2]], p0))
+
+    def add_boundary_planes(self):
+        # edges used by a single triangle get a plane through the edge at right angles to the surface
+        edges = dict()
+        for t in range(0, len(self.tri_alive)):
+            if not self.tri_alive[t]:
+                continue
+            for k in range(0, 3):
+                a = self.tris[t * 3 + k]
+                b = self.tris[t * 3 + (k + 1) % 3]
+                key = (min(a, b), max(a, b))
+                if key in edges:
+                    edges[key] = -1
+                else:
+                    edges[key] = t
+        for key, t in edges.items():
+            if t < 0:
+                continue
+            a, b = key
+            n = self.tri_normal(self.tris[t * 3:t * 3 + 3])
+            e = sub(self.pos[b], self.pos[a])
+            bn = cross(e, n)
+            length = mag(bn)
+            if length <= 0.0:
+                continue
+            bn = [bn[0] / length, bn[1] / length, bn[2] / length]
+            d = -dot(bn, self.pos[a])
+            weight = dot(e, e) * boundary_weight
+            add_plane(self.quadrics[a], bn, d, weight)
+            add_plane(self.quadrics[b], bn, d, weight)
+
+    def push_collapse(self, src, dst):
+        cost = eval_error(self.quadrics[src], self.quadrics[dst], self.pos[dst])
+        heapq.heappush(self.queue, (cost, src, dst, self.stamp[src], self.stamp[dst]))
+
+    def push_vertex_collapses(self, v):
+        for t in self.vertex_tris[v]:
+            if not self.tri_alive[t]:
+                continue
+            for k in range(0, 3):
+                w = self.tris[t * 3 + k]
+                if w == v:
+                    continue
+                self.push_collapse(v, w)
+                self.push_collapse(w, v)
+
+    def collapse_flips(self, src, dst):
+        # moving src onto dst must not fold any of the triangles which survive
+        for t in self.vertex_tris[src]:
+            if not self.tri_alive[t]:
+                continue
+            tri = self.tris[t * 3:t * 3 + 3]
+            if dst in tri:
+                continue
+            moved = [dst if v == src else v for v in tri]
+            n0 = self.tri_normal(tri)
+            n1 = self.tri_normal(moved)
+            l0 = mag(n0)
+            l1 = mag(n1)
+            if l1 <= 0.0:
+                return True
+            if l0 > 0.0 and dot(n0, n1) < flip_threshold * l0 * l1:
+                return True
+        return False
+
+    def pick_member(self, v, o):
+        # vertex at welded position v which best matches the normal of original vertex o
+        members = self.members[v]
+        if not self.normals:
+            return members[0]
+        n = self.normals[o]
+        best = members[0]
+        best_dot = -2.0
+        for m in members:
+            d = dot(n, self.normals[m])
+            if d > best_dot:
+                best_dot = d
+                best = m
+        return best
+
+    def apply_collapse(self, cost, src, dst):
+        for t in self.vertex_tris[src]:
+            if not self.tri_alive[t]:
+                continue
+            tri = self.tris[t * 3:t * 3 + 3]
+            if dst in tri:
+                self.tri_alive[t] = False
+                self.live_tris -= 1
+                continue
+            for k in range(0, 3):
+                if tri[k] != src:
+                    continue
+                self.tris[t * 3 + k] = dst
+                self.corners[t * 3 + k] = self.pick_member(dst, self.corners[t * 3 + k])
+            self.vertex_tris[dst].append(t)
+
+        self.alive[src] = False
+        self.vertex_tris[src] = []
+        for i in range(0, 11):
+            self.quadrics[dst][i] += self.quadrics[src][i]
+        self.stamp[dst] += 1
+        self.max_cost = max(self.max_cost, cost)
+        self.vertex_tris[dst] = [t for t in self.vertex_tris[dst] if self.tri_alive[t]]
+        self.push_vertex_collapses(dst)
+
+    def simplify_to(self, target, max_cost):
+        # returns false once nothing is left within max_cost
+        while self.live_tris > target:
+            if len(self.queue) == 0:
+                return False
+            c = self.queue[0]
+            if c[0] > max_cost:
+                return False
+            heapq.heappop(self.queue)
+            cost, src, dst, src_stamp, dst_stamp = c
+            if not self.alive[src] or not self.alive[dst]:
+                continue
+            if self.stamp[src] != src_stamp or self.stamp[dst] != dst_stamp:
+                continue
+            if self.collapse_flips(src, dst):
+                continue
+            self.apply_collapse(cost, src, dst)
+        return True
+
+    def live_indices(self):
+        out = []
+        for t in range(0, len(self.tri_alive)):
+            if self.tri_alive[t]:
+                out.extend(self.corners[t * 3:t * 3 + 3])
+        return out
+
+
+# returns a list of (error, indices) for each level after lod 0
+def generate_lods(position_floats, vertex_floats, indices, min_extents, max_extents):
+    num_tris = int(len(indices) / 3)
+    radius = mag(sub([float(f) for f in max_extents], [float(f) for f in min_extents])) * 0.5
+    if radius <= 0.0 or num_tris * reduction < min_triangles:
+        return []
+
+    num_vertices = int(len(position_floats) / 4)
+    positions = [[float(f) for f in position_floats[v * 4:v * 4 + 3]] for v in range(0, num_vertices)]
+
+    # normals follow position in the vertex buffer
+    normals = None
+    if num_vertices > 0 and len(vertex_floats) % num_vertices == 0:
+        stride = int(len(vertex_floats) / num_vertices)
+        if stride >= 8:
+            normals = [[float(f) for f in vertex_floats[v * stride + 4:v * stride + 7]] for v in range(0, num_vertices)]
+
+    s = simplifier(positions, normals, indices)
+    max_cost = (max_error * radius) ** 2
+
+    lods = []
+    prev_tris = s.live_tris
+    while len(lods) + 1 < max_lods:
+        target = int(prev_tris * reduction)
+        if target < min_triangles:
+            break
+        reached = s.simplify_to(target, max_cost)
+        # not worth another index range if it barely saves anything
+        if s.live_tris == 0 or s.live_tris > prev_tris * 0.9:
+            break
+        lods.append((math.sqrt(s.max_cost) / radius, s.live_indices()))
+        prev_tris = s.live_tris
+        if not reached:
+            break
+    return lods
+
+
+# version 2 geometry lod block, follows the collision floats of each mesh. returns the size in bytes
+def pack_lods(mesh_data, lods, index_type):
+    index_size = struct.calcsize(index_type)
+    mesh_data.append(struct.pack("i", len(lods)))
+    size = 4
+    for lod in lods:
+        mesh_data.append(struct.pack("i", len(lod[1])))
+        mesh_data.append(struct.pack("f", float(lod[0])))
+        for index in lod[1]:
+            mesh_data.append(struct.pack(index_type, int(index)))
+        size += 8 + len(lod[1]) * index_size
+    return size
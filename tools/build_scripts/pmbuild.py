@@ -260,6 +260,9 @@ def run_models(config):
         task_files = get_task_files(task)
         for f in task_files:
             cmd = " -i " + f[0] + " -o " + os.path.dirname(f[1])
+            export = export_config_for_file(f[0])
+            if "lods" in export.keys() and export["lods"]:
+                cmd += " -lods"
             subprocess.call(tool_cmd + cmd, shell=True)
     pass
 
@@ -449,6 +452,7 @@ def models_help(config):
     print("    ...")
     print("]")
     print("accepted file formats: .dae, .obj")
+    print("lod chains are generated for meshes with lods: true in their export.jsn")
     print("\n")
 
 
@@ -30,10 +30,13 @@ local function setup_osx()
 		"Cocoa.framework",
 		"GameController.framework",
 		"iconv",
-		"fmod",
 		"IOKit.framework"
 	}
 	
+	if audio_backend == "fmod" then
+		links { "fmod" }
+	end
+	
 	if renderer_dir == "metal" then
 		links 
 		{ 
@@ -60,9 +63,14 @@ local function setup_linux()
 		"GLEW",
 		"GLU",
 		"GL",
-		"X11",
-		"fmod"
+		"X11"
 	}
+	
+	if audio_backend == "fmod" then
+		links { "fmod" }
+	else
+		links { "dl" }
+	end
 end
 
 local function setup_win32()
@@ -101,9 +109,12 @@ local function setup_win32()
         "dxguid.lib",
         "winmm.lib", 
         "comctl32.lib", 
-        "fmod64_vc.lib",
         "Shlwapi.lib"	
     }
+    
+    if audio_backend == "fmod" then
+        links { "fmod64_vc.lib" }
+    end
 
 	add_pmtech_links()
 	
@@ -4,6 +4,7 @@ platform = ""
 build_cmd = ""
 link_cmd = ""
 renderer_dir = ""
+audio_backend = "fmod"
 sdk_version = ""
 shared_libs_dir = ""
 pmtech_dir = "../"
@@ -13,6 +14,10 @@ function setup_from_options()
         renderer_dir = _OPTIONS["renderer"]
     end
 
+    if _OPTIONS["audio"] then
+        audio_backend = _OPTIONS["audio"]
+    end
+
     if _OPTIONS["sdk_version"] then
         sdk_version = _OPTIONS["sdk_version"]
     end
@@ -87,6 +92,7 @@ function setup_from_action()
 	
 	print("platform: " .. platform)
 	print("renderer: " .. renderer_dir)
+	print("audio: " .. audio_backend)
 	print("pmtech dir: " .. pmtech_dir)
 	print("sdk version: " .. windows_sdk_version())
     
@@ -13,6 +13,18 @@ newoption
    }
 }
 
+newoption 
+{
+   trigger     = "audio",
+   value       = "API",
+   description = "Choose an audio backend",
+   allowed = 
+   {
+      { "fmod", "FMOD (default)" },
+      { "native",  "Built in software mixer, wav only" }
+   }
+}
+
 newoption 
 {
    trigger     = "sdk_version",